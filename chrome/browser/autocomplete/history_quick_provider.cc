@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/bind.h"
 #include "base/command_line.h"
 #include "base/i18n/break_iterator.h"
 #include "base/logging.h"
@@ -15,6 +16,7 @@
 #include "base/prefs/pref_service.h"
 #include "base/string_util.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/threading/sequenced_worker_pool.h"
 #include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autocomplete/autocomplete_field_trial.h"
@@ -44,6 +46,15 @@ using history::InMemoryURLIndex;
 using history::ScoredHistoryMatch;
 using history::ScoredHistoryMatches;
 
+namespace {
+
+// How long a search of the index may take before it is dropped. This is well
+// within the controller's expire time, so the matches for the previous input
+// stay up while the search runs.
+const int kSearchDeadlineMs = 200;
+
+}  // namespace
+
 bool HistoryQuickProvider::disabled_ = false;
 
 HistoryQuickProvider::HistoryQuickProvider(
@@ -52,7 +63,15 @@ HistoryQuickProvider::HistoryQuickProvider(
     : HistoryProvider(listener, profile,
           AutocompleteProvider::TYPE_HISTORY_QUICK),
       languages_(profile_->GetPrefs()->GetString(prefs::kAcceptLanguages)),
-      reorder_for_inlining_(false) {
+      reorder_for_inlining_(false),
+      search_deadline_(base::TimeDelta::FromMilliseconds(kSearchDeadlineMs)) {
+  base::SequencedWorkerPool* pool = content::BrowserThread::GetBlockingPool();
+  search_task_runner_ = pool->GetSequencedTaskRunnerWithShutdownBehavior(
+      pool->GetSequenceToken(), base::SequencedWorkerPool::SKIP_ON_SHUTDOWN);
+  // The scoring state shared by all matches must be set up on this thread
+  // before any search runs on the blocking pool.
+  ScoredHistoryMatch::Initialize();
+
   enum InliningOption {
     INLINING_PROHIBITED = 0,
     INLINING_ALLOWED = 1,
@@ -119,6 +138,9 @@ HistoryQuickProvider::HistoryQuickProvider(
 void HistoryQuickProvider::Start(const AutocompleteInput& input,
                                  bool minimal_changes) {
   matches_.clear();
+  search_tracker_.TryCancelAll();
+  search_deadline_timer_.Stop();
+  done_ = true;
   if (disabled_)
     return;
 
@@ -136,19 +158,34 @@ void HistoryQuickProvider::Start(const AutocompleteInput& input,
   // TODO(pkasting): We should just block here until this loads.  Any time
   // someone unloads the history backend, we'll get inconsistent inline
   // autocomplete behavior here.
-  if (GetIndex()) {
-    base::TimeTicks start_time = base::TimeTicks::Now();
-    DoAutocomplete();
-    if (input.text().length() < 6) {
-      base::TimeTicks end_time = base::TimeTicks::Now();
-      std::string name = "HistoryQuickProvider.QueryIndexTime." +
-          base::IntToString(input.text().length());
-      base::HistogramBase* counter = base::Histogram::FactoryGet(
-          name, 1, 1000, 50, base::Histogram::kUmaTargetedHistogramFlag);
-      counter->Add(static_cast<int>((end_time - start_time).InMilliseconds()));
-    }
-    UpdateStarredStateOfMatches();
+  InMemoryURLIndex* index = GetIndex();
+  if (!index)
+    return;
+
+  search_start_time_ = base::TimeTicks::Now();
+  if (input.matches_requested() != AutocompleteInput::ALL_MATCHES) {
+    // Callers asking for fewer matches need them before Start() returns.
+    SetMatches(index->HistoryItemsForTerms(
+        autocomplete_input_.text(), autocomplete_input_.cursor_position()));
+    return;
   }
+
+  // OnSearchDone() gets the matches unless the next keystroke, Stop() or the
+  // deadline cancels the search first. |search_tracker_| also drops the reply
+  // if this provider goes away.
+  done_ = false;
+  index->HistoryItemsForTermsAsync(
+      autocomplete_input_.text(), autocomplete_input_.cursor_position(),
+      search_task_runner_.get(), &search_tracker_,
+      base::Bind(&HistoryQuickProvider::OnSearchDone, base::Unretained(this)));
+  search_deadline_timer_.Start(FROM_HERE, search_deadline_, this,
+                               &HistoryQuickProvider::OnSearchDeadline);
+}
+
+void HistoryQuickProvider::Stop(bool clear_cached_results) {
+  search_tracker_.TryCancelAll();
+  search_deadline_timer_.Stop();
+  HistoryProvider::Stop(clear_cached_results);
 }
 
 void HistoryQuickProvider::DeleteMatch(const AutocompleteMatch& match) {
@@ -161,11 +198,36 @@ void HistoryQuickProvider::DeleteMatch(const AutocompleteMatch& match) {
 
 HistoryQuickProvider::~HistoryQuickProvider() {}
 
-void HistoryQuickProvider::DoAutocomplete() {
-  // Get the matching URLs from the DB.
-  ScoredHistoryMatches matches = GetIndex()->HistoryItemsForTerms(
-      autocomplete_input_.text(),
-      autocomplete_input_.cursor_position());
+void HistoryQuickProvider::OnSearchDone(const ScoredHistoryMatches& matches) {
+  search_deadline_timer_.Stop();
+  SetMatches(matches);
+  done_ = true;
+  listener_->OnProviderUpdate(!matches_.empty());
+}
+
+void HistoryQuickProvider::OnSearchDeadline() {
+  // The search's matches would arrive too late to be of use, and the
+  // controller should not wait for them.
+  search_tracker_.TryCancelAll();
+  done_ = true;
+  listener_->OnProviderUpdate(false);
+}
+
+void HistoryQuickProvider::SetMatches(const ScoredHistoryMatches& matches) {
+  DoAutocomplete(matches);
+  if (autocomplete_input_.text().length() < 6) {
+    base::TimeTicks end_time = base::TimeTicks::Now();
+    std::string name = "HistoryQuickProvider.QueryIndexTime." +
+        base::IntToString(autocomplete_input_.text().length());
+    base::HistogramBase* counter = base::Histogram::FactoryGet(
+        name, 1, 1000, 50, base::Histogram::kUmaTargetedHistogramFlag);
+    counter->Add(static_cast<int>(
+        (end_time - search_start_time_).InMilliseconds()));
+  }
+  UpdateStarredStateOfMatches();
+}
+
+void HistoryQuickProvider::DoAutocomplete(ScoredHistoryMatches matches) {
   if (matches.empty())
     return;
 
@@ -9,32 +9,46 @@
 
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
+#include "base/time.h"
+#include "base/timer.h"
 #include "chrome/browser/autocomplete/autocomplete_input.h"
 #include "chrome/browser/autocomplete/autocomplete_match.h"
 #include "chrome/browser/autocomplete/history_provider.h"
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/history/in_memory_url_index.h"
+#include "chrome/common/cancelable_task_tracker.h"
 
 class Profile;
 class TermMatches;
 
+namespace base {
+class SequencedTaskRunner;
+}  // namespace base
+
 namespace history {
 struct ScoredHistoryMatch;
 }  // namespace history
 
 // This class is an autocomplete provider (a pseudo-internal component of
-// the history system) which quickly (and synchronously) provides matching
-// results from recently or frequently visited sites in the profile's
-// history.
+// the history system) which quickly provides matching results from recently
+// or frequently visited sites in the profile's history.
+//
+// When all matches are requested the index is searched on the blocking pool
+// so that typing is not held up by scoring, and the matches are reported
+// asynchronously. Each keystroke cancels the search for the one before it,
+// and a search that has not finished within the deadline is dropped. Queries
+// for fewer matches are answered synchronously.
 class HistoryQuickProvider : public HistoryProvider {
  public:
   HistoryQuickProvider(AutocompleteProviderListener* listener,
                        Profile* profile);
 
-  // AutocompleteProvider. |minimal_changes| is ignored since there is no asynch
-  // completion performed.
+  // AutocompleteProvider. |minimal_changes| is ignored since the index is
+  // searched again on every call.
   virtual void Start(const AutocompleteInput& input,
                      bool minimal_changes) OVERRIDE;
+  virtual void Stop(bool clear_cached_results) OVERRIDE;
 
   virtual void DeleteMatch(const AutocompleteMatch& match) OVERRIDE;
 
@@ -49,11 +63,24 @@ class HistoryQuickProvider : public HistoryProvider {
   friend class HistoryQuickProviderTest;
   FRIEND_TEST_ALL_PREFIXES(HistoryQuickProviderTest, Spans);
   FRIEND_TEST_ALL_PREFIXES(HistoryQuickProviderTest, Relevance);
+  FRIEND_TEST_ALL_PREFIXES(HistoryQuickProviderTest, SupersededSearch);
+  FRIEND_TEST_ALL_PREFIXES(HistoryQuickProviderTest, SearchDeadline);
 
   virtual ~HistoryQuickProvider();
 
-  // Performs the autocomplete matching and scoring.
-  void DoAutocomplete();
+  // Called with the |matches| found by the asynchronous search of the index.
+  void OnSearchDone(const history::ScoredHistoryMatches& matches);
+
+  // Drops the search still running for the current input.
+  void OnSearchDeadline();
+
+  // Fills |matches_| from the scored history |matches| for the current input
+  // and records how long the search took.
+  void SetMatches(const history::ScoredHistoryMatches& matches);
+
+  // Turns the scored history |matches| into |matches_|, adjusting their
+  // relevance for inlining.
+  void DoAutocomplete(history::ScoredHistoryMatches matches);
 
   // Creates an AutocompleteMatch from |history_match|, assigning it
   // the score |score|.
@@ -97,6 +124,21 @@ class HistoryQuickProvider : public HistoryProvider {
   // and make the best behavior the default.)
   bool reorder_for_inlining_;
 
+  // Runs the searches of the index one after the other, so that each can
+  // build on the search term cache left by the one before.
+  scoped_refptr<base::SequencedTaskRunner> search_task_runner_;
+
+  // Tracks the search for the current input.
+  CancelableTaskTracker search_tracker_;
+
+  // Time allowed for a search before it is dropped, and the timer enforcing
+  // it.
+  base::TimeDelta search_deadline_;
+  base::OneShotTimer<HistoryQuickProvider> search_deadline_timer_;
+
+  // When the search for the current input was started.
+  base::TimeTicks search_start_time_;
+
   // Only used for testing.
   scoped_ptr<history::InMemoryURLIndex> index_for_testing_;
 
@@ -10,9 +10,14 @@
 #include <string>
 #include <vector>
 
+#include "base/command_line.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "base/prefs/pref_service.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autocomplete/autocomplete_provider_listener.h"
 #include "chrome/browser/autocomplete/autocomplete_result.h"
@@ -33,6 +38,10 @@ using base::TimeDelta;
 
 using content::BrowserThread;
 
+// Command line switch for the number of history items in the benchmark.
+static const char kBenchmarkRows[] = "history-quick-provider-benchmark-rows";
+static const int kDefaultBenchmarkRows = 1000;
+
 struct TestURLInfo {
   std::string url;
   std::string title;
@@ -85,10 +94,13 @@ class HistoryQuickProviderTest : public testing::Test,
  public:
   HistoryQuickProviderTest()
       : ui_thread_(BrowserThread::UI, &message_loop_),
-        file_thread_(BrowserThread::FILE, &message_loop_) {}
+        file_thread_(BrowserThread::FILE, &message_loop_),
+        provider_updates_(0) {}
 
   // AutocompleteProviderListener:
-  virtual void OnProviderUpdate(bool updated_matches) OVERRIDE {}
+  virtual void OnProviderUpdate(bool updated_matches) OVERRIDE {
+    ++provider_updates_;
+  }
 
  protected:
   class SetShouldContain : public std::unary_function<const std::string&,
@@ -120,6 +132,9 @@ class HistoryQuickProviderTest : public testing::Test,
                bool can_inline_top_result,
                string16 expected_fill_into_edit);
 
+  // Waits until the provider has reported the matches for the last input.
+  void WaitForSearch();
+
   // Pass-through functions to simplify our friendship with URLIndexPrivateData.
   bool UpdateURL(const history::URLRow& row);
 
@@ -132,6 +147,9 @@ class HistoryQuickProviderTest : public testing::Test,
 
   ACMatches ac_matches_;  // The resulting matches after running RunTest.
 
+  // Number of times the provider called OnProviderUpdate().
+  int provider_updates_;
+
   scoped_refptr<HistoryQuickProvider> provider_;
 };
 
@@ -146,6 +164,8 @@ void HistoryQuickProviderTest::SetUp() {
                                            Profile::EXPLICIT_ACCESS);
   EXPECT_TRUE(history_service_);
   provider_ = new HistoryQuickProvider(this, profile_.get());
+  // Slow bots must not drop searches.
+  provider_->search_deadline_ = TimeDelta::FromSeconds(30);
   FillData();
 }
 
@@ -153,6 +173,13 @@ void HistoryQuickProviderTest::TearDown() {
   provider_ = NULL;
 }
 
+void HistoryQuickProviderTest::WaitForSearch() {
+  while (!provider_->done()) {
+    BrowserThread::GetBlockingPool()->FlushForTesting();
+    MessageLoop::current()->RunUntilIdle();
+  }
+}
+
 bool HistoryQuickProviderTest::UpdateURL(const history::URLRow& row) {
   history::URLDatabase* db = history_service_->InMemoryDatabase();
   DCHECK(db);
@@ -218,7 +245,7 @@ void HistoryQuickProviderTest::RunTest(const string16 text,
   AutocompleteInput input(text, string16::npos, string16(), false, false, true,
                           AutocompleteInput::ALL_MATCHES);
   provider_->Start(input, false);
-  EXPECT_TRUE(provider_->done());
+  WaitForSearch();
 
   ac_matches_ = provider_->matches();
 
@@ -448,6 +475,52 @@ TEST_F(HistoryQuickProviderTest, DeleteMatch) {
           ASCIIToUTF16("NONE EXPECTED"));
 }
 
+// Starting a new query cancels the search for the previous one, whose
+// matches are never reported.
+TEST_F(HistoryQuickProviderTest, SupersededSearch) {
+  AutocompleteInput first(ASCIIToUTF16("foo"), string16::npos, string16(),
+                          false, false, true, AutocompleteInput::ALL_MATCHES);
+  provider_->Start(first, false);
+  EXPECT_FALSE(provider_->done());
+  AutocompleteInput second(ASCIIToUTF16("slashdot"), string16::npos,
+                           string16(), false, false, true,
+                           AutocompleteInput::ALL_MATCHES);
+  provider_->Start(second, false);
+  WaitForSearch();
+  EXPECT_EQ(1, provider_updates_);
+  ASSERT_EQ(1U, provider_->matches().size());
+  EXPECT_EQ("http://slashdot.org/favorite_page.html",
+            provider_->matches()[0].destination_url.spec());
+
+  // Stopping cancels the search as well.
+  provider_->Start(first, false);
+  provider_->Stop(false);
+  EXPECT_TRUE(provider_->done());
+  BrowserThread::GetBlockingPool()->FlushForTesting();
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(1, provider_updates_);
+  EXPECT_TRUE(provider_->matches().empty());
+}
+
+// A search which misses its deadline is dropped so the query can finish.
+TEST_F(HistoryQuickProviderTest, SearchDeadline) {
+  provider_->search_deadline_ = TimeDelta();
+  AutocompleteInput input(ASCIIToUTF16("slashdot"), string16::npos, string16(),
+                          false, false, true, AutocompleteInput::ALL_MATCHES);
+  provider_->Start(input, false);
+  WaitForSearch();
+  EXPECT_EQ(1, provider_updates_);
+  EXPECT_TRUE(provider_->matches().empty());
+
+  // Queries for the best match are answered at once, whatever the deadline.
+  AutocompleteInput best_match(ASCIIToUTF16("slashdot"), string16::npos,
+                               string16(), false, false, true,
+                               AutocompleteInput::BEST_MATCH);
+  provider_->Start(best_match, false);
+  EXPECT_TRUE(provider_->done());
+  EXPECT_EQ(1U, provider_->matches().size());
+}
+
 TEST_F(HistoryQuickProviderTest, PreventBeatingURLWhatYouTypedMatch) {
   std::vector<std::string> expected_urls;
 
@@ -514,6 +587,89 @@ TEST_F(HistoryQuickProviderTest, PreventBeatingURLWhatYouTypedMatch) {
             HistoryURLProvider::kScoreForBestInlineableResult);
 }
 
+// Benchmark replaying the typing of a query over synthetic history items.
+// Reports the time per keystroke spent in the provider on the UI thread and
+// taken until its matches are ready, searching the index on the UI thread (as
+// for best match queries) and on the blocking pool. Then replays the query as
+// a burst of keystrokes arriving faster than they can be searched. Disabled
+// by default; run with --gtest_also_run_disabled_tests
+// --history-quick-provider-benchmark-rows=N.
+TEST_F(HistoryQuickProviderTest, DISABLED_TypingBenchmark) {
+  int rows = kDefaultBenchmarkRows;
+  std::string rows_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkRows));
+  base::StringToInt(rows_switch, &rows);
+  rows = std::max(rows, 1);
+
+  static const char* kWords[] = {
+    "news", "weather", "sports", "mail", "maps", "video", "music", "shopping",
+    "travel", "search", "photos", "books", "games", "finance", "health",
+    "movies",
+  };
+  const size_t kNumWords = arraysize(kWords);
+  for (int i = 0; i < rows; ++i) {
+    history::URLRow row(GURL(base::StringPrintf(
+        "http://www.%s%d.com/%s/%d.html", kWords[i % kNumWords], i,
+        kWords[(i / 7) % kNumWords], i)));
+    row.set_id(100000 + i);
+    row.set_title(UTF8ToUTF16(base::StringPrintf(
+        "%s %s %s", kWords[i % kNumWords], kWords[(i / 3) % kNumWords],
+        kWords[(i / 11) % kNumWords])));
+    row.set_visit_count(1 + i % 20);
+    row.set_typed_count(i % 3);
+    row.set_last_visit(Time::Now() - TimeDelta::FromDays(i % 30));
+    row.set_hidden(false);
+    UpdateURL(row);
+  }
+
+  const string16 query(ASCIIToUTF16("news weather spo"));
+  printf("Typing \"%s\" over %d history items:\n", UTF16ToUTF8(query).c_str(),
+         rows);
+  for (int async = 0; async < 2; ++async) {
+    const AutocompleteInput::MatchesRequested matches_requested = async ?
+        AutocompleteInput::ALL_MATCHES : AutocompleteInput::BEST_MATCH;
+    TimeDelta ui_time;
+    TimeDelta result_time;
+    for (size_t length = 1; length <= query.length(); ++length) {
+      AutocompleteInput input(query.substr(0, length), string16::npos,
+                              string16(), false, false, true,
+                              matches_requested);
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      provider_->Start(input, false);
+      ui_time += base::TimeTicks::HighResNow() - start;
+      while (!provider_->done()) {
+        BrowserThread::GetBlockingPool()->FlushForTesting();
+        base::TimeTicks reply_start = base::TimeTicks::HighResNow();
+        MessageLoop::current()->RunUntilIdle();
+        if (provider_->done())
+          ui_time += base::TimeTicks::HighResNow() - reply_start;
+      }
+      result_time += base::TimeTicks::HighResNow() - start;
+    }
+    printf("%s: %.3f ms on the UI thread and %.3f ms to matches per "
+           "keystroke.\n", async ? "Blocking pool" : "UI thread",
+           ui_time.InMillisecondsF() / query.length(),
+           result_time.InMillisecondsF() / query.length());
+
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    base::TimeTicks last_keystroke;
+    for (size_t length = 1; length <= query.length(); ++length) {
+      AutocompleteInput input(query.substr(0, length), string16::npos,
+                              string16(), false, false, true,
+                              matches_requested);
+      last_keystroke = base::TimeTicks::HighResNow();
+      provider_->Start(input, false);
+    }
+    TimeDelta burst_time = base::TimeTicks::HighResNow() - start;
+    WaitForSearch();
+    printf("%s: burst took %.3f ms on the UI thread, last matches %.3f ms "
+           "after the last keystroke.\n", async ? "Blocking pool" : "UI thread",
+           burst_time.InMillisecondsF(),
+           (base::TimeTicks::HighResNow() - last_keystroke).InMillisecondsF());
+    EXPECT_FALSE(provider_->matches().empty());
+  }
+}
+
 // HQPOrderingTest -------------------------------------------------------------
 
 TestURLInfo ordering_test_db[] = {
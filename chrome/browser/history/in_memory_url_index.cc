@@ -4,6 +4,7 @@
 
 #include "chrome/browser/history/in_memory_url_index.h"
 
+#include "base/bind.h"
 #include "base/debug/trace_event.h"
 #include "base/file_util.h"
 #include "base/utf_string_conversions.h"
@@ -27,10 +28,15 @@ using in_memory_url_index::InMemoryURLIndexCacheItem;
 
 namespace history {
 
-// Called by DoSaveToCacheFile to delete any old cache file at |path| when
-// there is no private data to save. Runs on the FILE thread.
+// The most visited or modified rows to queue while a search reads the private
+// data; any more and the data is copied so that they can be indexed at once.
+const size_t kMaxPendingUpdates = 100;
+
+// Called by DoSaveToCacheFile to delete any old cache file at |path|, and its
+// journal, when there is no private data to save. Runs on the FILE thread.
 void DeleteCacheFile(const base::FilePath& path) {
   DCHECK(!content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
+  file_util::Delete(URLIndexPrivateData::GetJournalFilePath(path), false);
   file_util::Delete(path, false);
 }
 
@@ -48,6 +54,17 @@ void InitializeSchemeWhitelist(std::set<std::string>* whitelist) {
   whitelist->insert(std::string(chrome::kMailToScheme));
 }
 
+// Called by HistoryItemsForTermsAsync to search |private_data| off the UI
+// thread, leaving the results in |matches|.
+void SearchPrivateData(scoped_refptr<URLIndexPrivateData> private_data,
+                       const string16& term_string,
+                       size_t cursor_position,
+                       BookmarkService* bookmark_service,
+                       ScoredHistoryMatches* matches) {
+  *matches = private_data->HistoryItemsForTerms(term_string, cursor_position,
+                                                bookmark_service);
+}
+
 // Restore/SaveCacheObserver ---------------------------------------------------
 
 InMemoryURLIndex::RestoreCacheObserver::~RestoreCacheObserver() {}
@@ -138,6 +155,7 @@ void InMemoryURLIndex::ShutDown() {
   registrar_.RemoveAll();
   cache_reader_consumer_.CancelAllRequests();
   shutdown_ = true;
+  ApplyPendingUpdates();
   base::FilePath path;
   if (!GetCacheFilePath(&path))
     return;
@@ -146,7 +164,62 @@ void InMemoryURLIndex::ShutDown() {
 }
 
 void InMemoryURLIndex::ClearPrivateData() {
-  private_data_->Clear();
+  pending_updates_.clear();
+
+  // A search may still be reading the old data, in which case start afresh
+  // rather than clearing it in place.
+  if (private_data_->HasOneRef())
+    private_data_->Clear();
+  else
+    private_data_ = new URLIndexPrivateData;
+}
+
+URLIndexPrivateData* InMemoryURLIndex::MutablePrivateData() {
+  if (!private_data_->HasOneRef())
+    private_data_ = private_data_->Duplicate();
+  return private_data_.get();
+}
+
+void InMemoryURLIndex::UpdateURL(const URLRow& row) {
+  // Searches are short, so queue the row rather than copy the index for it,
+  // unless searches have been overlapping for long enough to build a backlog.
+  if (!private_data_->HasOneRef() &&
+      pending_updates_.size() < kMaxPendingUpdates) {
+    pending_updates_.push_back(row);
+    return;
+  }
+  ApplyPendingUpdates();
+  needs_to_be_cached_ |=
+      MutablePrivateData()->UpdateURL(row, languages_, scheme_whitelist_);
+}
+
+void InMemoryURLIndex::ApplyPendingUpdates() {
+  if (pending_updates_.empty())
+    return;
+  URLIndexPrivateData* private_data = MutablePrivateData();
+  for (URLRows::const_iterator row = pending_updates_.begin();
+       row != pending_updates_.end(); ++row) {
+    needs_to_be_cached_ |=
+        private_data->UpdateURL(*row, languages_, scheme_whitelist_);
+  }
+  pending_updates_.clear();
+}
+
+void InMemoryURLIndex::ApplyPendingUpdatesIfUnshared() {
+  if (private_data_->HasOneRef())
+    ApplyPendingUpdates();
+}
+
+// static
+void InMemoryURLIndex::OnSearchDone(
+    base::WeakPtr<InMemoryURLIndex> index,
+    const HistoryItemsForTermsCallback& callback,
+    const ScoredHistoryMatches* matches) {
+  // The search task, and with it its reference to the private data, has been
+  // released by now.
+  if (index)
+    index->ApplyPendingUpdatesIfUnshared();
+  callback.Run(*matches);
 }
 
 bool InMemoryURLIndex::GetCacheFilePath(base::FilePath* file_path) {
@@ -161,16 +234,41 @@ bool InMemoryURLIndex::GetCacheFilePath(base::FilePath* file_path) {
 ScoredHistoryMatches InMemoryURLIndex::HistoryItemsForTerms(
     const string16& term_string,
     size_t cursor_position) {
+  ApplyPendingUpdatesIfUnshared();
   return private_data_->HistoryItemsForTerms(
       term_string,
       cursor_position,
       BookmarkModelFactory::GetForProfile(profile_));
 }
 
+CancelableTaskTracker::TaskId InMemoryURLIndex::HistoryItemsForTermsAsync(
+    const string16& term_string,
+    size_t cursor_position,
+    base::TaskRunner* task_runner,
+    CancelableTaskTracker* tracker,
+    const HistoryItemsForTermsCallback& callback) {
+  DCHECK(content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
+  ApplyPendingUpdatesIfUnshared();
+  // Bookmarks may only be looked up off the UI thread once they are loaded;
+  // until then matches go without the bookmark boost rather than wait.
+  BookmarkModel* bookmark_model = BookmarkModelFactory::GetForProfile(profile_);
+  BookmarkService* bookmark_service =
+      (bookmark_model && bookmark_model->IsLoaded()) ? bookmark_model : NULL;
+  ScoredHistoryMatches* matches = new ScoredHistoryMatches;
+  return tracker->PostTaskAndReply(
+      task_runner, FROM_HERE,
+      base::Bind(&SearchPrivateData, private_data_, term_string,
+                 cursor_position, bookmark_service, matches),
+      base::Bind(&InMemoryURLIndex::OnSearchDone, AsWeakPtr(), callback,
+                 base::Owned(matches)));
+}
+
 // Updating --------------------------------------------------------------------
 
 void InMemoryURLIndex::DeleteURL(const GURL& url) {
-  private_data_->DeleteURL(url);
+  // Deletions are not deferred, so that no later search can return the URL.
+  ApplyPendingUpdates();
+  MutablePrivateData()->DeleteURL(url);
 }
 
 void InMemoryURLIndex::Observe(int notification_type,
@@ -201,15 +299,13 @@ void InMemoryURLIndex::Observe(int notification_type,
 }
 
 void InMemoryURLIndex::OnURLVisited(const URLVisitedDetails* details) {
-  needs_to_be_cached_ |=
-      private_data_->UpdateURL(details->row, languages_, scheme_whitelist_);
+  UpdateURL(details->row);
 }
 
 void InMemoryURLIndex::OnURLsModified(const URLsModifiedDetails* details) {
   for (URLRows::const_iterator row = details->changed_urls.begin();
        row != details->changed_urls.end(); ++row)
-    needs_to_be_cached_ |=
-        private_data_->UpdateURL(*row, languages_, scheme_whitelist_);
+    UpdateURL(*row);
 }
 
 void InMemoryURLIndex::OnURLsDeleted(const URLsDeletedDetails* details) {
@@ -217,9 +313,10 @@ void InMemoryURLIndex::OnURLsDeleted(const URLsDeletedDetails* details) {
     ClearPrivateData();
     needs_to_be_cached_ = true;
   } else {
+    ApplyPendingUpdates();
     for (URLRows::const_iterator row = details->rows.begin();
          row != details->rows.end(); ++row)
-      needs_to_be_cached_ |= private_data_->DeleteURL(row->url());
+      needs_to_be_cached_ |= MutablePrivateData()->DeleteURL(row->url());
   }
 }
 
@@ -242,7 +339,7 @@ void InMemoryURLIndex::PostRestoreFromCacheFileTask() {
   content::BrowserThread::PostTaskAndReply(
       content::BrowserThread::FILE, FROM_HERE,
       base::Bind(&URLIndexPrivateData::RestoreFromFileTask, path,
-          restored_private_data, languages_),
+          restored_private_data, languages_, scheme_whitelist_),
       base::Bind(&InMemoryURLIndex::OnCacheLoadDone, AsWeakPtr(),
           restored_private_data));
 }
@@ -294,7 +391,7 @@ void InMemoryURLIndex::DoneRebuidingPrivateDataFromHistoryDB(
     private_data_ = private_data;
     PostSaveToCacheFileTask();  // Cache the newly rebuilt index.
   } else {
-    private_data_->Clear();  // Dump the old private data.
+    ClearPrivateData();  // Dump the old private data.
     // There is no need to do anything with the cache file as it was deleted
     // when the rebuild from the history operation was kicked off.
   }
@@ -315,18 +412,24 @@ void InMemoryURLIndex::PostSaveToCacheFileTask() {
   base::FilePath path;
   if (!GetCacheFilePath(&path))
     return;
+  // Include any rows queued behind a search which has since finished.
+  ApplyPendingUpdatesIfUnshared();
   // If there is anything in our private data then make a copy of it and tell
   // it to save itself to a file.
   if (private_data_.get() && !private_data_->Empty()) {
     // Note that ownership of the copy of our private data is passed to the
-    // completion closure below.
+    // completion closure below. The changes it journals are forgotten only
+    // once it has been written.
+    int journal_id = 0;
+    size_t journal_size = 0;
     scoped_refptr<URLIndexPrivateData> private_data_copy =
-        private_data_->Duplicate();
+        private_data_->DuplicateForSave(&journal_id, &journal_size);
     content::BrowserThread::PostTaskAndReplyWithResult<bool>(
         content::BrowserThread::FILE, FROM_HERE,
         base::Bind(&URLIndexPrivateData::WritePrivateDataToCacheFileTask,
                    private_data_copy, path),
-        base::Bind(&InMemoryURLIndex::OnCacheSaveDone, AsWeakPtr()));
+        base::Bind(&InMemoryURLIndex::OnCacheSaveDone, AsWeakPtr(),
+                   journal_id, journal_size));
   } else {
     // If there is no data in our index then delete any existing cache file.
     content::BrowserThread::PostBlockingPoolTask(
@@ -335,7 +438,12 @@ void InMemoryURLIndex::PostSaveToCacheFileTask() {
   }
 }
 
-void InMemoryURLIndex::OnCacheSaveDone(bool succeeded) {
+void InMemoryURLIndex::OnCacheSaveDone(int journal_id,
+                                       size_t journal_size,
+                                       bool succeeded) {
+  // OnSaveDone() only touches the journal, which searches never read, so it
+  // is safe to call on data a search may be using and needs no copy.
+  private_data_->OnSaveDone(journal_id, journal_size, succeeded);
   if (save_cache_observer_)
     save_cache_observer_->OnCacheSaveFinished(succeeded);
 }
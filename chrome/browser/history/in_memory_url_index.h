@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/callback_forward.h"
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
@@ -24,6 +25,7 @@
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/history/in_memory_url_index_types.h"
 #include "chrome/browser/history/scored_history_match.h"
+#include "chrome/common/cancelable_task_tracker.h"
 #include "content/public/browser/notification_observer.h"
 #include "content/public/browser/notification_registrar.h"
 #include "sql/connection.h"
@@ -32,6 +34,7 @@ class HistoryQuickProviderTest;
 class Profile;
 
 namespace base {
+class TaskRunner;
 class Time;
 }
 
@@ -111,7 +114,8 @@ class InMemoryURLIndex : public content::NotificationObserver,
   void Init();
 
   // Signals that any outstanding initialization should be canceled and
-  // flushes the cache to disk.
+  // flushes the cache to disk. Usually only the changes made since the cache
+  // was restored or written are appended to its journal.
   void ShutDown();
 
   // Scans the history index and returns a vector with all scored, matching
@@ -123,6 +127,23 @@ class InMemoryURLIndex : public content::NotificationObserver,
   ScoredHistoryMatches HistoryItemsForTerms(const string16& term_string,
                                             size_t cursor_position);
 
+  // Receives the matches found by HistoryItemsForTermsAsync().
+  typedef base::Callback<void(const ScoredHistoryMatches&)>
+      HistoryItemsForTermsCallback;
+
+  // Like HistoryItemsForTerms() but scores the history items on |task_runner|
+  // and then runs |callback| with the matches on the UI thread. The search
+  // sees the index as it is now: while it may still be running, visits and
+  // deletions are applied to a copy of the index instead. Canceling the
+  // returned task through |tracker| skips the search if it has not started
+  // and drops its matches otherwise.
+  CancelableTaskTracker::TaskId HistoryItemsForTermsAsync(
+      const string16& term_string,
+      size_t cursor_position,
+      base::TaskRunner* task_runner,
+      CancelableTaskTracker* tracker,
+      const HistoryItemsForTermsCallback& callback);
+
   // Deletes the index entry, if any, for the given |url|.
   void DeleteURL(const GURL& url);
 
@@ -178,6 +199,28 @@ class InMemoryURLIndex : public content::NotificationObserver,
   // from the cache or a complete rebuild from the history database.
   void ClearPrivateData();
 
+  // Returns the private data for updating, first replacing it with a copy if
+  // a search started by HistoryItemsForTermsAsync() may still be reading it.
+  URLIndexPrivateData* MutablePrivateData();
+
+  // Indexes |row|. While a search may still be reading the private data the
+  // row is queued instead, so that visits do not copy the whole index.
+  void UpdateURL(const URLRow& row);
+
+  // Indexes the rows queued by UpdateURL(), copying the private data if a
+  // search is still reading it.
+  void ApplyPendingUpdates();
+
+  // Indexes the rows queued by UpdateURL() if no search is reading the
+  // private data any more.
+  void ApplyPendingUpdatesIfUnshared();
+
+  // Applies the updates queued during the search which produced |matches|,
+  // unless |index| is gone, and hands |matches| to |callback|.
+  static void OnSearchDone(base::WeakPtr<InMemoryURLIndex> index,
+                           const HistoryItemsForTermsCallback& callback,
+                           const ScoredHistoryMatches* matches);
+
   // Constructs a file path for the cache file within the same directory where
   // the history database is kept and saves that path to |file_path|. Returns
   // true if |file_path| can be successfully constructed. (This function
@@ -226,9 +269,12 @@ class InMemoryURLIndex : public content::NotificationObserver,
   // Provided for unit testing so that a test cache file can be used.
   void DoSaveToCacheFile(const base::FilePath& path);
 
-  // Notifies the observer, if any, of the success of the private data caching.
-  // |succeeded| is true on a successful save.
-  void OnCacheSaveDone(bool succeeded);
+  // Lets the private data forget the changes the save wrote and notifies the
+  // observer, if any, of the success of the private data caching.
+  // |journal_id| and |journal_size| come from
+  // URLIndexPrivateData::DuplicateForSave(). |succeeded| is true on a
+  // successful save.
+  void OnCacheSaveDone(int journal_id, size_t journal_size, bool succeeded);
 
   // Handles notifications of history changes.
   virtual void Observe(int notification_type,
@@ -269,6 +315,10 @@ class InMemoryURLIndex : public content::NotificationObserver,
   // The index's durable private data.
   scoped_refptr<URLIndexPrivateData> private_data_;
 
+  // Rows visited or modified while a search was reading |private_data_|, in
+  // the order they arrived.
+  URLRows pending_updates_;
+
   // Observers to notify upon restoral or save of the private data cache.
   RestoreCacheObserver* restore_cache_observer_;
   SaveCacheObserver* save_cache_observer_;
@@ -12,6 +12,7 @@
 
 #include "base/i18n/break_iterator.h"
 #include "base/i18n/case_conversion.h"
+#include "base/logging.h"
 #include "base/string_util.h"
 
 namespace history {
@@ -141,6 +142,220 @@ Char16Set Char16SetFromString16(const string16& term) {
   return characters;
 }
 
+// PackedIDSet -----------------------------------------------------------------
+
+// Appends |value| to |bytes| seven bits at a time, low bits first, with the
+// high bit set on every byte but the last.
+static void AppendVarint(uint64 value, std::string* bytes) {
+  while (value >= 0x80) {
+    bytes->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  bytes->push_back(static_cast<char>(value));
+}
+
+// Decodes the varint starting at |*offset| in |bytes| and moves |*offset|
+// past it.
+static uint64 ReadVarint(const std::string& bytes, size_t* offset) {
+  uint64 value = 0;
+  for (int shift = 0; *offset < bytes.size(); shift += 7) {
+    uint8 byte = static_cast<uint8>(bytes[(*offset)++]);
+    value |= static_cast<uint64>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  return value;
+}
+
+// Returns true if the sorted |ids| contain |id|.
+static bool SortedContains(const std::vector<uint64>& ids, uint64 id) {
+  return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+// Adds |id| to the sorted |ids|.
+static void SortedInsert(std::vector<uint64>* ids, uint64 id) {
+  ids->insert(std::lower_bound(ids->begin(), ids->end(), id), id);
+}
+
+// Removes |id| from the sorted |ids| and returns true if it was there.
+static bool SortedErase(std::vector<uint64>* ids, uint64 id) {
+  std::vector<uint64>::iterator iter =
+      std::lower_bound(ids->begin(), ids->end(), id);
+  if (iter == ids->end() || *iter != id)
+    return false;
+  ids->erase(iter);
+  return true;
+}
+
+PackedIDSet::const_iterator::const_iterator()
+    : set_(NULL),
+      offset_(0),
+      next_offset_(0),
+      packed_value_(0),
+      inserted_index_(0),
+      erased_index_(0),
+      value_(0) {
+}
+
+PackedIDSet::const_iterator::const_iterator(const PackedIDSet* set,
+                                            size_t offset,
+                                            size_t inserted_index)
+    : set_(set),
+      offset_(offset),
+      next_offset_(offset),
+      packed_value_(0),
+      inserted_index_(inserted_index),
+      erased_index_(0),
+      value_(0) {
+  if (offset_ < set_->bytes_.size())
+    packed_value_ = ReadVarint(set_->bytes_, &next_offset_);
+  Settle();
+}
+
+PackedIDSet::const_iterator& PackedIDSet::const_iterator::operator++() {
+  const std::vector<uint64>& inserted = set_->inserted_;
+  if (offset_ < set_->bytes_.size() &&
+      (inserted_index_ == inserted.size() ||
+       packed_value_ < inserted[inserted_index_]))
+    AdvancePacked();
+  else
+    ++inserted_index_;
+  Settle();
+  return *this;
+}
+
+void PackedIDSet::const_iterator::AdvancePacked() {
+  offset_ = next_offset_;
+  if (offset_ < set_->bytes_.size())
+    packed_value_ += ReadVarint(set_->bytes_, &next_offset_);
+}
+
+void PackedIDSet::const_iterator::Settle() {
+  const std::vector<uint64>& erased = set_->erased_;
+  while (offset_ < set_->bytes_.size()) {
+    while (erased_index_ < erased.size() &&
+           erased[erased_index_] < packed_value_)
+      ++erased_index_;
+    if (erased_index_ == erased.size() ||
+        erased[erased_index_] != packed_value_)
+      break;
+    ++erased_index_;
+    AdvancePacked();
+  }
+
+  const std::vector<uint64>& inserted = set_->inserted_;
+  if (offset_ < set_->bytes_.size() &&
+      (inserted_index_ == inserted.size() ||
+       packed_value_ < inserted[inserted_index_]))
+    value_ = packed_value_;
+  else if (inserted_index_ < inserted.size())
+    value_ = inserted[inserted_index_];
+}
+
+PackedIDSet::PackedIDSet() : packed_size_(0), packed_last_(0) {}
+
+PackedIDSet::~PackedIDSet() {}
+
+PackedIDSet::const_iterator PackedIDSet::begin() const {
+  return const_iterator(this, 0, 0);
+}
+
+PackedIDSet::const_iterator PackedIDSet::end() const {
+  return const_iterator(this, bytes_.size(), inserted_.size());
+}
+
+size_t PackedIDSet::count(uint64 id) const {
+  if (SortedContains(inserted_, id))
+    return 1;
+  return !SortedContains(erased_, id) && PackedContains(id) ? 1 : 0;
+}
+
+void PackedIDSet::insert(uint64 id) {
+  if ((packed_size_ == 0 || id > packed_last_) &&
+      !SortedContains(inserted_, id)) {
+    Append(id);
+    return;
+  }
+  if (SortedErase(&erased_, id) || SortedContains(inserted_, id) ||
+      PackedContains(id))
+    return;
+  SortedInsert(&inserted_, id);
+  MaybeFold();
+}
+
+void PackedIDSet::erase(uint64 id) {
+  if (SortedErase(&inserted_, id) || SortedContains(erased_, id) ||
+      !PackedContains(id))
+    return;
+  SortedInsert(&erased_, id);
+  MaybeFold();
+}
+
+void PackedIDSet::clear() {
+  bytes_.clear();
+  packed_size_ = 0;
+  packed_last_ = 0;
+  skips_.clear();
+  inserted_.clear();
+  erased_.clear();
+}
+
+size_t PackedIDSet::allocated_bytes() const {
+  return bytes_.capacity() + skips_.capacity() * sizeof(SkipEntry) +
+      (inserted_.capacity() + erased_.capacity()) * sizeof(uint64);
+}
+
+void PackedIDSet::Append(uint64 id) {
+  uint64 previous = packed_size_ == 0 ? 0 : packed_last_;
+  if (packed_size_ % kSkipInterval == 0) {
+    SkipEntry skip = { id, previous, bytes_.size() };
+    skips_.push_back(skip);
+  }
+  AppendVarint(id - previous, &bytes_);
+  packed_last_ = id;
+  ++packed_size_;
+}
+
+bool PackedIDSet::PackedContains(uint64 id) const {
+  if (packed_size_ == 0 || id > packed_last_)
+    return false;
+
+  // Start decoding from the last recorded ID not larger than |id|.
+  size_t low = 0;
+  size_t high = skips_.size();
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+    if (skips_[middle].id <= id)
+      low = middle;
+    else
+      high = middle;
+  }
+  uint64 value = skips_[low].previous;
+  size_t offset = skips_[low].offset;
+  while (offset < bytes_.size()) {
+    value += ReadVarint(bytes_, &offset);
+    if (value >= id)
+      return value == id;
+  }
+  return false;
+}
+
+void PackedIDSet::MaybeFold() {
+  size_t pending = inserted_.size() + erased_.size();
+  if (pending <= std::min<size_t>(kMaxPendingChanges, packed_size_ / 4))
+    return;
+
+  PackedIDSet folded;
+  for (const_iterator iter = begin(); iter != end(); ++iter)
+    folded.Append(*iter);
+  std::swap(bytes_, folded.bytes_);
+  std::swap(skips_, folded.skips_);
+  packed_size_ = folded.packed_size_;
+  packed_last_ = folded.packed_last_;
+  inserted_.clear();
+  erased_.clear();
+}
+
 // RowWordStarts ---------------------------------------------------------------
 
 RowWordStarts::RowWordStarts() {}
@@ -5,10 +5,14 @@
 #ifndef CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_TYPES_H_
 #define CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_TYPES_H_
 
+#include <algorithm>
+#include <iterator>
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
+#include "base/basictypes.h"
 #include "base/string16.h"
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/autocomplete/history_provider_util.h"
@@ -107,6 +111,170 @@ String16Vector String16VectorFromString16(const string16& uni_string,
 // the UI can highlight the matched sections.
 Char16Set Char16SetFromString16(const string16& uni_word);
 
+// Posting Lists ---------------------------------------------------------------
+
+// A sorted set of IDs stored as the varint encoded differences between
+// consecutive IDs. The lists of the index are dense, so most IDs take one or
+// two bytes instead of the 40 or so of a std::set node, and short lists fit
+// in the string without any allocation. Inserting an ID larger than all
+// others appends to the encoding, which is how lists are built from history
+// and restored from the cache. Other insertions and erasures are kept in
+// small sorted vectors next to the encoding and folded into it once enough
+// of them have gathered, so that updating a row does not re-encode the lists
+// of all of its words. Every kSkipInterval-th encoded ID is also recorded
+// with its offset, so a lookup decodes only a short stretch of the list.
+class PackedIDSet {
+ public:
+  typedef uint64 value_type;
+
+  // Decodes the IDs in increasing order.
+  class const_iterator
+      : public std::iterator<std::forward_iterator_tag, uint64> {
+   public:
+    const_iterator();
+
+    uint64 operator*() const { return value_; }
+    const_iterator& operator++();
+    bool operator==(const const_iterator& other) const {
+      return offset_ == other.offset_ &&
+          inserted_index_ == other.inserted_index_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class PackedIDSet;
+    const_iterator(const PackedIDSet* set, size_t offset,
+                   size_t inserted_index);
+
+    // Moves to the next encoded ID.
+    void AdvancePacked();
+
+    // Skips the encoded IDs which were erased and sets |value_|.
+    void Settle();
+
+    const PackedIDSet* set_;
+    size_t offset_;  // Start of the current encoded ID.
+    size_t next_offset_;  // Start of the following encoded ID.
+    uint64 packed_value_;  // The current encoded ID.
+    size_t inserted_index_;  // The current ID of |set_->inserted_|.
+    size_t erased_index_;  // The first ID of |set_->erased_| not passed yet.
+    uint64 value_;
+  };
+
+  PackedIDSet();
+  ~PackedIDSet();
+
+  bool empty() const { return size() == 0; }
+  size_t size() const {
+    return packed_size_ + inserted_.size() - erased_.size();
+  }
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Returns 1 if |id| is in the set, 0 otherwise.
+  size_t count(uint64 id) const;
+
+  void insert(uint64 id);
+  void erase(uint64 id);
+  void clear();
+
+  // Appends the IDs in increasing order to |ids|.
+  template <typename T>
+  void AppendTo(std::vector<T>* ids) const {
+    ids->reserve(ids->size() + size());
+    for (const_iterator iter = begin(); iter != end(); ++iter)
+      ids->push_back(static_cast<T>(*iter));
+  }
+
+  // Returns the number of bytes allocated for the encoding and the pending
+  // changes.
+  size_t allocated_bytes() const;
+
+ private:
+  struct SkipEntry {
+    uint64 id;
+    uint64 previous;  // The ID encoded before |id|, 0 for the first one.
+    size_t offset;  // Start of the encoding of |id|.
+  };
+
+  enum {
+    kSkipInterval = 64,
+    kMaxPendingChanges = 256
+  };
+
+  // Appends |id|, which must be larger than all encoded IDs, to the encoding.
+  void Append(uint64 id);
+
+  // Returns true if |id| is encoded in |bytes_|, erased or not.
+  bool PackedContains(uint64 id) const;
+
+  // Folds |inserted_| and |erased_| into the encoding once they hold more
+  // changes than are worth searching alongside it.
+  void MaybeFold();
+
+  std::string bytes_;
+  size_t packed_size_;  // The number of IDs encoded in |bytes_|.
+  uint64 packed_last_;  // The largest encoded ID, valid if |packed_size_|.
+  std::vector<SkipEntry> skips_;
+
+  // IDs in the set but not in |bytes_|, and IDs in |bytes_| but not in the
+  // set. Both are sorted.
+  std::vector<uint64> inserted_;
+  std::vector<uint64> erased_;
+};
+
+// Intersects |a| and |b|, both sorted and free of duplicates, into |result|.
+// When one is much shorter than the other its IDs are looked up in the
+// longer one by galloping search, which costs time in the length of the
+// shorter list only; otherwise the two are merged without data dependent
+// branches for the comparisons.
+template <typename T>
+void IntersectSortedIDs(const std::vector<T>& a,
+                        const std::vector<T>& b,
+                        std::vector<T>* result) {
+  result->clear();
+  const std::vector<T>& shorter = a.size() <= b.size() ? a : b;
+  const std::vector<T>& longer = a.size() <= b.size() ? b : a;
+  if (shorter.empty())
+    return;
+
+  const size_t kGallopRatio = 16;
+  const size_t longer_size = longer.size();
+  if (shorter.size() * kGallopRatio < longer_size) {
+    size_t low = 0;
+    for (size_t i = 0; i < shorter.size(); ++i) {
+      const T id = shorter[i];
+      size_t high = low;
+      for (size_t step = 1; high < longer_size && longer[high] < id;
+           step *= 2) {
+        low = high + 1;
+        high += step;
+      }
+      low = std::lower_bound(longer.begin() + low,
+                             longer.begin() + std::min(high, longer_size),
+                             id) - longer.begin();
+      if (low == longer_size)
+        break;
+      if (longer[low] == id)
+        result->push_back(longer[low++]);
+    }
+    return;
+  }
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() && j < b.size()) {
+    const T x = a[i];
+    const T y = b[j];
+    if (x == y)
+      result->push_back(x);
+    i += (x <= y);
+    j += (y <= x);
+  }
+}
+
 // Support for InMemoryURLIndex Private Data -----------------------------------
 
 // An index into a list of all of the words we have indexed.
@@ -117,14 +285,14 @@ typedef std::map<string16, WordID> WordMap;
 
 // A map from character to the word_ids of words containing that character.
 typedef std::set<WordID> WordIDSet;  // An index into the WordList.
-typedef std::map<char16, WordIDSet> CharWordIDMap;
+typedef std::vector<WordID> WordIDVector;  // Sorted.
+typedef std::map<char16, PackedIDSet> CharWordIDMap;
 
 // A map from word (by word_id) to history items containing that word.
 typedef history::URLID HistoryID;
-typedef std::set<HistoryID> HistoryIDSet;
 typedef std::vector<HistoryID> HistoryIDVector;
-typedef std::map<WordID, HistoryIDSet> WordIDHistoryMap;
-typedef std::map<HistoryID, WordIDSet> HistoryIDWordMap;
+typedef std::map<WordID, PackedIDSet> WordIDHistoryMap;
+typedef std::map<HistoryID, PackedIDSet> HistoryIDWordMap;
 
 // A map from history_id to the history's URL and title.
 typedef std::map<HistoryID, URLRow> HistoryInfoMap;
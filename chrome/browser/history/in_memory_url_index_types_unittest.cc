@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <set>
+#include <vector>
 
 #include "base/string16.h"
 #include "base/utf_string_conversions.h"
@@ -144,4 +146,102 @@ TEST_F(InMemoryURLIndexTypesTest, OffsetsAndTermMatches) {
     EXPECT_EQ(expected_offsets_b[i], matches_b[i].offset);
 }
 
+// PackedIDSet must behave like a std::set across appends, insertions in the
+// middle, erasures and IDs needing multi-byte encodings.
+TEST_F(InMemoryURLIndexTypesTest, PackedIDSet) {
+  PackedIDSet packed;
+  std::set<uint64> expected;
+  EXPECT_TRUE(packed.empty());
+  EXPECT_TRUE(packed.begin() == packed.end());
+
+  const uint64 kIDs[] = { 5, 7, 300, 1000000, 6, 0, 299, 1ULL << 40, 7, 128 };
+  for (size_t i = 0; i < arraysize(kIDs); ++i) {
+    packed.insert(kIDs[i]);
+    expected.insert(kIDs[i]);
+  }
+  const uint64 kErased[] = { 6, 1ULL << 40, 0, 12345 };
+  for (size_t i = 0; i < arraysize(kErased); ++i) {
+    packed.erase(kErased[i]);
+    expected.erase(kErased[i]);
+  }
+  packed.insert(2000000);
+  expected.insert(2000000);
+
+  ASSERT_EQ(expected.size(), packed.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), packed.begin()));
+  for (uint64 id = 0; id < 400; ++id)
+    EXPECT_EQ(expected.count(id), packed.count(id)) << id;
+  EXPECT_EQ(0U, packed.count(1ULL << 40));
+
+  std::vector<int64> ids;
+  packed.AppendTo(&ids);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), ids.begin()));
+
+  packed.clear();
+  EXPECT_TRUE(packed.empty());
+  packed.insert(3);
+  EXPECT_EQ(1U, packed.count(3));
+}
+
+// Changes in the middle of a long PackedIDSet are kept aside and folded into
+// the encoding later, which must not be observable.
+TEST_F(InMemoryURLIndexTypesTest, PackedIDSetPendingChanges) {
+  PackedIDSet packed;
+  std::set<uint64> expected;
+  for (uint64 id = 0; id < 5000; id += 3) {
+    packed.insert(id);
+    expected.insert(id);
+  }
+  for (uint64 i = 0; i < 2000; ++i) {
+    uint64 id = (i * 7919) % 6000;
+    if (i % 3 == 0) {
+      packed.erase(id);
+      expected.erase(id);
+    } else {
+      packed.insert(id);
+      expected.insert(id);
+    }
+    if (i % 97 == 0) {
+      ASSERT_EQ(expected.size(), packed.size());
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                             packed.begin()));
+    }
+  }
+  ASSERT_EQ(expected.size(), packed.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), packed.begin()));
+  for (uint64 id = 0; id < 6100; ++id)
+    ASSERT_EQ(expected.count(id), packed.count(id)) << id;
+
+  for (std::set<uint64>::const_iterator iter = expected.begin();
+       iter != expected.end(); ++iter)
+    packed.erase(*iter);
+  EXPECT_TRUE(packed.empty());
+  EXPECT_TRUE(packed.begin() == packed.end());
+}
+
+TEST_F(InMemoryURLIndexTypesTest, IntersectSortedIDs) {
+  std::vector<size_t> evens;
+  std::vector<size_t> threes;
+  for (size_t i = 0; i < 1000; ++i) {
+    evens.push_back(i * 2);
+    if (i < 20)
+      threes.push_back(i * 3);
+  }
+
+  // Lists of similar size are merged.
+  std::vector<size_t> result;
+  IntersectSortedIDs(evens, evens, &result);
+  EXPECT_TRUE(result == evens);
+
+  // A short list is searched for in a long one, from either side.
+  const size_t expected[] = { 0, 6, 12, 18, 24, 30, 36, 42, 48, 54 };
+  IntersectSortedIDs(threes, evens, &result);
+  EXPECT_TRUE(IntArraysEqual(expected, arraysize(expected), result));
+  IntersectSortedIDs(evens, threes, &result);
+  EXPECT_TRUE(IntArraysEqual(expected, arraysize(expected), result));
+
+  IntersectSortedIDs(evens, std::vector<size_t>(), &result);
+  EXPECT_TRUE(result.empty());
+}
+
 }  // namespace history
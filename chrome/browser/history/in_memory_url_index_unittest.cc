@@ -6,13 +6,18 @@
 #include <fstream>
 
 #include "base/auto_reset.h"
+#include "base/bind.h"
+#include "base/command_line.h"
 #include "base/file_util.h"
 #include "base/files/file_path.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/message_loop.h"
 #include "base/path_service.h"
 #include "base/string16.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/threading/sequenced_worker_pool.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autocomplete/autocomplete_provider.h"
 #include "chrome/browser/history/history_backend.h"
@@ -48,6 +53,10 @@ using content::BrowserThread;
 
 namespace history {
 
+// Command line switch for the number of history items in the benchmark.
+static const char kBenchmarkRows[] = "history-index-benchmark-rows";
+static const int kDefaultBenchmarkRows = 2000;
+
 // -----------------------------------------------------------------------------
 
 // Observer class so the unit tests can wait while the cache is being saved.
@@ -843,6 +852,76 @@ TEST_F(InMemoryURLIndexTest, ExpireRow) {
       ASCIIToUTF16("DrudgeReport"), string16::npos).empty());
 }
 
+static void SaveMatches(ScoredHistoryMatches* saved_matches,
+                        const ScoredHistoryMatches& matches) {
+  *saved_matches = matches;
+}
+
+// A search on the blocking pool sees the index as it was when the search was
+// started, whatever changes are made to the index in the meantime.
+TEST_F(InMemoryURLIndexTest, AsyncSearchUsesSnapshot) {
+  ScoredHistoryMatches matches = url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("DrudgeReport"), string16::npos);
+  ASSERT_EQ(1U, matches.size());
+
+  CancelableTaskTracker tracker;
+  ScoredHistoryMatches async_matches;
+  URLIndexPrivateData* searched_data = GetPrivateData();
+  url_index_->HistoryItemsForTermsAsync(
+      ASCIIToUTF16("DrudgeReport"), string16::npos,
+      BrowserThread::GetBlockingPool(), &tracker,
+      base::Bind(&SaveMatches, &async_matches));
+
+  // Deleting the row while the search is pending updates a copy of the index.
+  URLsDeletedDetails deleted_details;
+  deleted_details.all_history = false;
+  deleted_details.rows.push_back(matches[0].url_info);
+  Observe(chrome::NOTIFICATION_HISTORY_URLS_DELETED,
+          content::Source<InMemoryURLIndexTest>(this),
+          content::Details<history::HistoryDetails>(&deleted_details));
+  EXPECT_NE(searched_data, GetPrivateData());
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("DrudgeReport"), string16::npos).empty());
+
+  BrowserThread::GetBlockingPool()->FlushForTesting();
+  message_loop_.RunUntilIdle();
+  ASSERT_EQ(1U, async_matches.size());
+  EXPECT_EQ(matches[0].url_info.url(), async_matches[0].url_info.url());
+
+  // With no search pending the index is updated in place again.
+  searched_data = GetPrivateData();
+  url_index_->DeleteURL(GURL("http://www.hokeypokey.com/"));
+  EXPECT_EQ(searched_data, GetPrivateData());
+}
+
+// A visit while a search is pending is indexed once the search is done rather
+// than by copying the index.
+TEST_F(InMemoryURLIndexTest, AsyncSearchDefersVisits) {
+  CancelableTaskTracker tracker;
+  ScoredHistoryMatches async_matches;
+  URLIndexPrivateData* searched_data = GetPrivateData();
+  url_index_->HistoryItemsForTermsAsync(
+      ASCIIToUTF16("DrudgeReport"), string16::npos,
+      BrowserThread::GetBlockingPool(), &tracker,
+      base::Bind(&SaveMatches, &async_matches));
+
+  URLRow new_row(GURL("http://www.brokeandaloneinmanitoba.com/"), 87654321);
+  new_row.set_last_visit(base::Time::Now());
+  URLsModifiedDetails modified_details;
+  modified_details.changed_urls.push_back(new_row);
+  Observe(chrome::NOTIFICATION_HISTORY_URLS_MODIFIED,
+          content::Source<InMemoryURLIndexTest>(this),
+          content::Details<history::HistoryDetails>(&modified_details));
+  EXPECT_EQ(searched_data, GetPrivateData());
+
+  BrowserThread::GetBlockingPool()->FlushForTesting();
+  message_loop_.RunUntilIdle();
+  EXPECT_EQ(1U, async_matches.size());
+  EXPECT_EQ(searched_data, GetPrivateData());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("brokeandalone"), string16::npos).size());
+}
+
 TEST_F(InMemoryURLIndexTest, WhitelistedURLs) {
   struct TestData {
     const std::string url_spec;
@@ -979,6 +1058,215 @@ TEST_F(InMemoryURLIndexTest, CacheSaveRestore) {
   ExpectPrivateDataEqual(*old_data, new_data);
 }
 
+// Changes made after the cache is written are appended to its journal and
+// replayed over the cache when it is restored.
+TEST_F(InMemoryURLIndexTest, CacheJournal) {
+  base::ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  set_history_dir(temp_directory.path());
+  base::FilePath cache_path;
+  ASSERT_TRUE(GetCacheFilePath(&cache_path));
+  base::FilePath journal_path(
+      URLIndexPrivateData::GetJournalFilePath(cache_path));
+
+  // The rebuilt index is written in full.
+  CacheFileSaverObserver save_observer(&message_loop_);
+  url_index_->set_save_cache_observer(&save_observer);
+  PostSaveToCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+  EXPECT_FALSE(file_util::PathExists(journal_path));
+  int64 cache_size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(cache_path, &cache_size));
+
+  // Add a row, retitle one and delete another.
+  URLIndexPrivateData& private_data(*GetPrivateData());
+  URLRow new_row(GURL("http://www.journalentry.com/"), 5000);
+  new_row.set_title(ASCIIToUTF16("Appended Journal Entry"));
+  new_row.set_visit_count(5);
+  new_row.set_last_visit(base::Time::Now());
+  EXPECT_TRUE(UpdateURL(new_row));
+  HistoryInfoMap::const_iterator info = private_data.history_info_map_.begin();
+  URLRow retitled_row(info->second);
+  retitled_row.set_title(ASCIIToUTF16("Retitled Page"));
+  retitled_row.set_visit_count(retitled_row.visit_count() + 10);
+  EXPECT_TRUE(UpdateURL(retitled_row));
+  ++info;
+  EXPECT_TRUE(DeleteURL(info->second.url()));
+  scoped_refptr<URLIndexPrivateData> old_data(private_data.Duplicate());
+
+  // Only the changes are written.
+  PostSaveToCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+  EXPECT_TRUE(file_util::PathExists(journal_path));
+  int64 new_cache_size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(cache_path, &new_cache_size));
+  EXPECT_EQ(cache_size, new_cache_size);
+
+  ClearPrivateData();
+  HistoryIndexRestoreObserver restore_observer(
+      base::Bind(&MessageLoop::Quit, base::Unretained(&message_loop_)));
+  url_index_->set_restore_cache_observer(&restore_observer);
+  PostRestoreFromCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(restore_observer.succeeded());
+  ExpectPrivateDataEqual(*old_data, *GetPrivateData());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("journalentry"), string16::npos).size());
+
+  // Clearing the index makes the next save a full one.
+  ClearPrivateData();
+  EXPECT_TRUE(UpdateURL(new_row));
+  PostSaveToCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+  EXPECT_FALSE(file_util::PathExists(journal_path));
+  EXPECT_TRUE(GetPrivateData()->journal_.empty());
+
+  // A change made while a save is in flight is kept for the next save.
+  new_row.set_visit_count(6);
+  EXPECT_TRUE(UpdateURL(new_row));
+  PostSaveToCacheFileTask();
+  new_row.set_visit_count(7);
+  EXPECT_TRUE(UpdateURL(new_row));
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+  EXPECT_FALSE(GetPrivateData()->journal_.empty());
+  PostSaveToCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+  EXPECT_TRUE(GetPrivateData()->journal_.empty());
+}
+
+// Benchmark for an index of synthetic history items. Reports the memory held
+// by the posting lists against what std::set would take, the time to save
+// and restore the cache, and the time taken by each keystroke of a query.
+// Disabled by default; run with --gtest_also_run_disabled_tests
+// --history-index-benchmark-rows=N.
+TEST_F(InMemoryURLIndexTest, DISABLED_IndexBenchmark) {
+  int rows = kDefaultBenchmarkRows;
+  std::string rows_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkRows));
+  base::StringToInt(rows_switch, &rows);
+  if (rows < 1)
+    rows = kDefaultBenchmarkRows;
+
+  // Build words from syllables so that they share characters and prefixes
+  // like real ones do.
+  static const char* kSyllables[] = {
+    "ba", "con", "de", "fi", "go", "hum", "ka", "li", "mo", "nex",
+    "po", "qui", "ra", "sto", "tu", "vel", "wi", "xa", "yo", "zen",
+  };
+  const size_t kNumSyllables = arraysize(kSyllables);
+  std::vector<std::string> vocabulary;
+  for (size_t i = 0; i < kNumSyllables * kNumSyllables * 5; ++i) {
+    vocabulary.push_back(std::string(kSyllables[i % kNumSyllables]) +
+                         kSyllables[(i / kNumSyllables) % kNumSyllables] +
+                         kSyllables[(i * 7) % kNumSyllables]);
+  }
+
+  // Word popularity is skewed by taking the smaller of two random picks.
+  uint32 seed = 1;
+  base::Time now = base::Time::Now();
+  scoped_refptr<URLIndexPrivateData> data(new URLIndexPrivateData);
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < rows; ++i) {
+    std::string words[4];
+    for (size_t j = 0; j < arraysize(words); ++j) {
+      seed = seed * 1103515245 + 12345;
+      size_t a = (seed >> 8) % vocabulary.size();
+      seed = seed * 1103515245 + 12345;
+      size_t b = (seed >> 8) % vocabulary.size();
+      words[j] = vocabulary[std::min(a, b)];
+    }
+    URLRow row(GURL(base::StringPrintf("http://www.%s.com/%s/%d.html",
+                                       words[0].c_str(), words[1].c_str(),
+                                       i)), i + 1);
+    row.set_title(ASCIIToUTF16(words[2] + " " + words[3]));
+    row.set_visit_count(5);
+    row.set_last_visit(now);
+    data->UpdateURL(row, "en", scheme_whitelist());
+  }
+  double build_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+
+  // A std::set node holds three pointers, a color and the ID, and is rounded
+  // up by the allocator.
+  const size_t kSetNodeBytes = 48;
+  size_t ids = 0;
+  size_t packed_bytes = 0;
+  const WordIDHistoryMap& word_map = data->word_id_history_map_;
+  for (WordIDHistoryMap::const_iterator iter = word_map.begin();
+       iter != word_map.end(); ++iter) {
+    ids += iter->second.size();
+    packed_bytes += sizeof(iter->second) + iter->second.allocated_bytes();
+  }
+  const HistoryIDWordMap& history_map = data->history_id_word_map_;
+  for (HistoryIDWordMap::const_iterator iter = history_map.begin();
+       iter != history_map.end(); ++iter) {
+    ids += iter->second.size();
+    packed_bytes += sizeof(iter->second) + iter->second.allocated_bytes();
+  }
+  const CharWordIDMap& char_map = data->char_word_map_;
+  for (CharWordIDMap::const_iterator iter = char_map.begin();
+       iter != char_map.end(); ++iter) {
+    ids += iter->second.size();
+    packed_bytes += sizeof(iter->second) + iter->second.allocated_bytes();
+  }
+  size_t lists = word_map.size() + history_map.size() + char_map.size();
+  printf("Indexed %d items in %.0f ms: %d words, %d IDs in %d posting "
+         "lists.\n", rows, build_ms, static_cast<int>(data->word_map_.size()),
+         static_cast<int>(ids), static_cast<int>(lists));
+  printf("Posting lists: %d KB packed, about %d KB as std::set.\n",
+         static_cast<int>(packed_bytes / 1024),
+         static_cast<int>((ids * kSetNodeBytes +
+                           lists * sizeof(std::set<HistoryID>)) / 1024));
+
+  base::ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  base::FilePath cache_path =
+      temp_directory.path().Append(FILE_PATH_LITERAL("History Provider Cache"));
+  start = base::TimeTicks::HighResNow();
+  ASSERT_TRUE(data->SaveToFile(cache_path));
+  double save_ms = (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+
+  // Change one item in a hundred and save again.
+  for (int i = 0; i < rows; i += 100) {
+    URLRow row(data->history_info_map_[i + 1]);
+    row.set_visit_count(row.visit_count() + 1);
+    data->UpdateURL(row, "en", scheme_whitelist());
+  }
+  start = base::TimeTicks::HighResNow();
+  ASSERT_TRUE(data->SaveToFile(cache_path));
+  double append_ms = (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+
+  scoped_refptr<URLIndexPrivateData> restored(new URLIndexPrivateData);
+  start = base::TimeTicks::HighResNow();
+  ASSERT_TRUE(restored->RestoreFromFile(cache_path, "en", scheme_whitelist()));
+  double restore_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  int64 cache_size = 0;
+  file_util::GetFileSize(cache_path, &cache_size);
+  printf("Cache of %d KB saved in %.1f ms, journal of 1%% of the items in "
+         "%.1f ms, restored in %.1f ms.\n", static_cast<int>(cache_size / 1024),
+         save_ms, append_ms, restore_ms);
+
+  // Type a query one keystroke at a time, the way the omnibox asks for it.
+  string16 query(
+      ASCIIToUTF16(vocabulary[0] + " " + vocabulary[1].substr(0, 4)));
+  start = base::TimeTicks::HighResNow();
+  size_t matches = 0;
+  for (size_t i = 1; i <= query.length(); ++i) {
+    matches += restored->HistoryItemsForTerms(query.substr(0, i),
+                                              string16::npos, NULL).size();
+  }
+  double query_ms = (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  EXPECT_LT(0U, matches);
+  printf("Typed \"%s\" in %.2f ms per keystroke.\n",
+         UTF16ToUTF8(query).c_str(), query_ms / query.length());
+}
+
 class InMemoryURLIndexCacheTest : public testing::Test {
  public:
   InMemoryURLIndexCacheTest() {}
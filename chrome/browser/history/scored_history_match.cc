@@ -44,15 +44,32 @@ bool ScoredHistoryMatch::use_new_scoring = false;
 bool ScoredHistoryMatch::only_count_matches_at_word_boundaries = false;
 bool ScoredHistoryMatch::also_do_hup_like_scoring = false;
 
+// static
+void ScoredHistoryMatch::Initialize() {
+  if (initialized_)
+    return;
+  // Because the below is not thread safe, we check that we're only
+  // initializing from one thread: the UI thread.  Specifically, we check
+  // "if we've heard of the UI thread then we'd better be on it."  The first
+  // part is necessary so unit tests pass.  (Many unit tests don't set up the
+  // threading naming system; hence CurrentlyOn(UI thread) will fail.)
+  DCHECK(
+      !content::BrowserThread::IsWellKnownThread(content::BrowserThread::UI) ||
+      content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
+  InitializeNewScoringField();
+  InitializeOnlyCountMatchesAtWordBoundariesField();
+  InitializeAlsoDoHUPLikeScoringField();
+  raw_term_score_to_topicality_score = new float[kMaxRawTermScore];
+  FillInTermScoreToTopicalityScoreArray();
+  days_ago_to_recency_score = new float[kDaysToPrecomputeRecencyScoresFor];
+  FillInDaysAgoToRecencyScoreArray();
+  initialized_ = true;
+}
+
 ScoredHistoryMatch::ScoredHistoryMatch()
     : raw_score(0),
       can_inline(false) {
-  if (!initialized_) {
-    InitializeNewScoringField();
-    InitializeOnlyCountMatchesAtWordBoundariesField();
-    InitializeAlsoDoHUPLikeScoringField();
-    initialized_ = true;
-  }
+  Initialize();
 }
 
 ScoredHistoryMatch::ScoredHistoryMatch(const URLRow& row,
@@ -64,12 +81,7 @@ ScoredHistoryMatch::ScoredHistoryMatch(const URLRow& row,
     : HistoryMatch(row, 0, false, false),
       raw_score(0),
       can_inline(false) {
-  if (!initialized_) {
-    InitializeNewScoringField();
-    InitializeOnlyCountMatchesAtWordBoundariesField();
-    InitializeAlsoDoHUPLikeScoringField();
-    initialized_ = true;
-  }
+  Initialize();
 
   GURL gurl = row.url();
   if (!gurl.is_valid())
@@ -440,19 +452,7 @@ float ScoredHistoryMatch::GetTopicalityScore(
     const TermMatches& url_matches,
     const TermMatches& title_matches,
     const RowWordStarts& word_starts) {
-  // Because the below thread is not thread safe, we check that we're
-  // only calling it from one thread: the UI thread.  Specifically,
-  // we check "if we've heard of the UI thread then we'd better
-  // be on it."  The first part is necessary so unit tests pass.  (Many
-  // unit tests don't set up the threading naming system; hence
-  // CurrentlyOn(UI thread) will fail.)
-  DCHECK(
-      !content::BrowserThread::IsWellKnownThread(content::BrowserThread::UI) ||
-      content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
-  if (raw_term_score_to_topicality_score == NULL) {
-    raw_term_score_to_topicality_score = new float[kMaxRawTermScore];
-    FillInTermScoreToTopicalityScoreArray();
-  }
+  Initialize();
   // A vector that accumulates per-term scores.  The strongest match--a
   // match in the hostname at a word boundary--is worth 10 points.
   // Everything else is less.  In general, a match that's not at a word
@@ -577,19 +577,7 @@ float* ScoredHistoryMatch::days_ago_to_recency_score = NULL;
 
 // static
 float ScoredHistoryMatch::GetRecencyScore(int last_visit_days_ago) {
-  // Because the below thread is not thread safe, we check that we're
-  // only calling it from one thread: the UI thread.  Specifically,
-  // we check "if we've heard of the UI thread then we'd better
-  // be on it."  The first part is necessary so unit tests pass.  (Many
-  // unit tests don't set up the threading naming system; hence
-  // CurrentlyOn(UI thread) will fail.)
-  DCHECK(
-      !content::BrowserThread::IsWellKnownThread(content::BrowserThread::UI) ||
-      content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
-  if (days_ago_to_recency_score == NULL) {
-    days_ago_to_recency_score = new float[kDaysToPrecomputeRecencyScoresFor];
-    FillInDaysAgoToRecencyScoreArray();
-  }
+  Initialize();
   // Lookup the score in days_ago_to_recency_score, treating
   // everything older than what we've precomputed as the oldest thing
   // we've precomputed.  The std::max is to protect against corruption
@@ -38,6 +38,11 @@ struct ScoredHistoryMatch : public history::HistoryMatch {
                      BookmarkService* bookmark_service);
   ~ScoredHistoryMatch();
 
+  // Sets up the scoring parameters and lookup tables shared by all matches.
+  // Runs on first use, which must be on the UI thread; call it there before
+  // scoring matches on any other thread.
+  static void Initialize();
+
   // Calculates a component score based on position, ordering, word
   // boundaries, and total substring match size using metrics recorded
   // in |matches| and |word_starts|. |max_length| is the length of
@@ -144,8 +149,8 @@ struct ScoredHistoryMatch : public history::HistoryMatch {
   // |days_ago_to_recency_score| is a simple array mapping how long
   // ago a page was visited (in days) to the recency score we should
   // assign it.  This allows easy lookups of scores without requiring
-  // math.  This is initialized upon first use of GetRecencyScore(),
-  // which calls FillInDaysAgoToRecencyScoreArray(),
+  // math.  This is filled in by Initialize(), which calls
+  // FillInDaysAgoToRecencyScoreArray().
   static const int kDaysToPrecomputeRecencyScoresFor = 366;
   static float* days_ago_to_recency_score;
 
@@ -155,12 +160,12 @@ struct ScoredHistoryMatch : public history::HistoryMatch {
   // hits for the term, weighted by how important the hit is:
   // hostname, path, etc.) to the topicality score we should assign
   // it.  This allows easy lookups of scores without requiring math.
-  // This is initialized upon first use of GetTopicalityScore(),
-  // which calls FillInTermScoreToTopicalityScoreArray().
+  // This is filled in by Initialize(), which calls
+  // FillInTermScoreToTopicalityScoreArray().
   static const int kMaxRawTermScore = 30;
   static float* raw_term_score_to_topicality_score;
 
-  // Used so we initialize static variables only once (on first use).
+  // Used so we initialize static variables only once (see Initialize()).
   static bool initialized_;
 
   // Whether to use new-scoring or old-scoring.  Set in the
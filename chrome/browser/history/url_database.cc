@@ -244,7 +244,7 @@ bool URLDatabase::InitURLEnumeratorForSignificant(URLEnumerator* enumerator) {
   std::string sql("SELECT ");
   sql.append(kURLRowFields);
   sql.append(" FROM urls WHERE last_visit_time >= ? OR visit_count >= ? OR "
-             "typed_count >= ?");
+             "typed_count >= ? ORDER BY id");
   enumerator->statement_.Assign(GetDB().GetUniqueStatement(sql.c_str()));
   enumerator->statement_.BindInt64(
       0, AutocompleteAgeThreshold().ToInternalValue());
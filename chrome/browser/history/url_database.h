@@ -156,7 +156,7 @@ class URLDatabase {
   // Initializes the given enumerator to enumerator all URLs in the database
   // that are historically significant: ones having been visited within 3 days,
   // having their URL manually typed more than once, or having been visited
-  // more than 3 times.
+  // more than 3 times. The URLs are enumerated in order of their IDs.
   bool InitURLEnumeratorForSignificant(URLEnumerator* enumerator);
 
   // Favicons ------------------------------------------------------------------
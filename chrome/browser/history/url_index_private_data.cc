@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 
+#include "base/atomic_sequence_num.h"
 #include "base/basictypes.h"
 #include "base/file_util.h"
 #include "base/i18n/case_conversion.h"
@@ -31,14 +32,19 @@
 #include "net/base/net_util.h"
 
 #if defined(USE_SYSTEM_PROTOBUF)
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/repeated_field.h>
 #else
+#include "third_party/protobuf/src/google/protobuf/io/coded_stream.h"
 #include "third_party/protobuf/src/google/protobuf/repeated_field.h"
 #endif
 
 using google::protobuf::RepeatedField;
 using google::protobuf::RepeatedPtrField;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
 using in_memory_url_index::InMemoryURLIndexCacheItem;
+using in_memory_url_index::InMemoryURLIndexJournalEntry;
 
 namespace history {
 
@@ -60,6 +66,17 @@ typedef imui::InMemoryURLIndexCacheItem_WordStartsMapItem WordStartsMapItem;
 typedef imui::InMemoryURLIndexCacheItem_WordStartsMapItem_WordStartsMapEntry
     WordStartsMapEntry;
 
+// The journal is folded into a new cache file once it grows past this
+// fraction of the cache file's size.
+static const int kMaxJournalSizeDivisor = 4;
+
+// Past this many bytes of changes held in memory the next save writes a new
+// cache file instead.
+static const size_t kMaxPendingJournalSize = 1024 * 1024;
+
+// Hands out URLIndexPrivateData::journal_id_.
+static base::StaticAtomicSequenceNumber g_next_journal_id;
+
 // Algorithm Functions ---------------------------------------------------------
 
 // Comparison function for sorting search terms by descending length.
@@ -67,6 +84,24 @@ bool LengthGreater(const string16& string_a, const string16& string_b) {
   return string_a.length() > string_b.length();
 }
 
+// Comparison function for sorting posting lists by increasing length.
+bool SizeLess(const PackedIDSet* set_a, const PackedIDSet* set_b) {
+  return set_a->size() < set_b->size();
+}
+
+// Fills the cache protobuf |entry| describing |row| as it is indexed under
+// |history_id|.
+void RowToHistoryInfoMapEntry(HistoryID history_id,
+                              const URLRow& row,
+                              HistoryInfoMapEntry* entry) {
+  entry->set_history_id(history_id);
+  entry->set_visit_count(row.visit_count());
+  entry->set_typed_count(row.typed_count());
+  entry->set_last_visit(row.last_visit().ToInternalValue());
+  entry->set_url(row.url().spec());
+  entry->set_title(UTF16ToUTF8(row.title()));
+}
+
 // Public Functions ------------------------------------------------------------
 
 URLIndexPrivateData::URLIndexPrivateData()
@@ -75,6 +110,9 @@ URLIndexPrivateData::URLIndexPrivateData()
           AutocompleteFieldTrial::
               InHQPUseCursorPositionFieldTrialExperimentGroup()),
       restored_cache_version_(0),
+      needs_full_save_(true),
+      saving_journal_size_(0),
+      journal_id_(g_next_journal_id.GetNext()),
       saved_cache_version_(kCurrentCacheFileVersion),
       pre_filter_item_count_(0),
       post_filter_item_count_(0),
@@ -85,6 +123,8 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
     string16 search_string,
     size_t cursor_position,
     BookmarkService* bookmark_service) {
+  base::AutoLock lock(search_lock_);
+
   // If we're allowed to use the cursor position, then if cursor
   // position is set and useful (not at either end of the string),
   // allow the search string to be broken at cursor position.  We do
@@ -124,22 +164,19 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // approach.
   ResetSearchTermCache();
 
-  HistoryIDSet history_id_set = HistoryIDSetFromWords(lower_words);
+  HistoryIDVector history_ids = HistoryIDsFromWords(lower_words);
 
   // Trim the candidate pool if it is large. Note that we do not filter out
   // items that do not contain the search terms as proper substrings -- doing
   // so is the performance-costly operation we are trying to avoid in order
   // to maintain omnibox responsiveness.
   const size_t kItemsToScoreLimit = 500;
-  pre_filter_item_count_ = history_id_set.size();
+  pre_filter_item_count_ = history_ids.size();
   // If we trim the results set we do not want to cache the results for next
   // time as the user's ultimately desired result could easily be eliminated
   // in this early rough filter.
   bool was_trimmed = (pre_filter_item_count_ > kItemsToScoreLimit);
   if (was_trimmed) {
-    HistoryIDVector history_ids;
-    std::copy(history_id_set.begin(), history_id_set.end(),
-              std::back_inserter(history_ids));
     // Trim down the set by sorting by typed-count, visit-count, and last
     // visit.
     HistoryItemFactorGreater
@@ -148,10 +185,9 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
                       history_ids.begin() + kItemsToScoreLimit,
                       history_ids.end(),
                       item_factor_functor);
-    history_id_set.clear();
-    std::copy(history_ids.begin(), history_ids.begin() + kItemsToScoreLimit,
-              std::inserter(history_id_set, history_id_set.end()));
-    post_filter_item_count_ = history_id_set.size();
+    history_ids.resize(kItemsToScoreLimit);
+    std::sort(history_ids.begin(), history_ids.end());
+    post_filter_item_count_ = history_ids.size();
   }
 
   // Pass over all of the candidates filtering out any without a proper
@@ -167,7 +203,7 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // get two 'terms': "colspec=id%20mstone" and "release".
   history::String16Vector lower_raw_terms;
   Tokenize(lower_raw_string, kWhitespaceUTF16, &lower_raw_terms);
-  scored_items = std::for_each(history_id_set.begin(), history_id_set.end(),
+  scored_items = std::for_each(history_ids.begin(), history_ids.end(),
       AddHistoryMatch(*this, bookmark_service, lower_raw_string,
                       lower_raw_terms, base::Time::Now())).ScoredMatches();
 
@@ -249,8 +285,12 @@ bool URLIndexPrivateData::UpdateURL(
     RemoveRowFromIndex(row);
     row_was_updated = true;
   }
-  if (row_was_updated)
+  if (row_was_updated) {
     search_term_cache_.clear();  // This invalidates the cache.
+    InMemoryURLIndexJournalEntry entry;
+    RowToHistoryInfoMapEntry(row_id, row, entry.mutable_updated_row());
+    AddJournalEntry(entry);
+  }
   return row_was_updated;
 }
 
@@ -277,6 +317,9 @@ bool URLIndexPrivateData::DeleteURL(const GURL& url) {
     return false;
   RemoveRowFromIndex(pos->second);
   search_term_cache_.clear();  // This invalidates the cache.
+  InMemoryURLIndexJournalEntry entry;
+  entry.set_deleted_url(url.spec());
+  AddJournalEntry(entry);
   return true;
 }
 
@@ -284,8 +327,11 @@ bool URLIndexPrivateData::DeleteURL(const GURL& url) {
 void URLIndexPrivateData::RestoreFromFileTask(
     const base::FilePath& file_path,
     scoped_refptr<URLIndexPrivateData> private_data,
-    const std::string& languages) {
-  private_data = URLIndexPrivateData::RestoreFromFile(file_path, languages);
+    const std::string& languages,
+    const std::set<std::string>& scheme_whitelist) {
+  DCHECK(private_data->Empty());
+  if (!private_data->RestoreFromFile(file_path, languages, scheme_whitelist))
+    private_data->Clear();
 }
 
 // static
@@ -326,6 +372,12 @@ bool URLIndexPrivateData::WritePrivateDataToCacheFileTask(
   return private_data->SaveToFile(file_path);
 }
 
+// static
+base::FilePath URLIndexPrivateData::GetJournalFilePath(
+    const base::FilePath& cache_path) {
+  return base::FilePath(cache_path.value() + FILE_PATH_LITERAL(" Journal"));
+}
+
 scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::Duplicate() const {
   scoped_refptr<URLIndexPrivateData> data_copy = new URLIndexPrivateData;
   data_copy->word_list_ = word_list_;
@@ -336,6 +388,10 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::Duplicate() const {
   data_copy->history_id_word_map_ = history_id_word_map_;
   data_copy->history_info_map_ = history_info_map_;
   data_copy->word_starts_map_ = word_starts_map_;
+  data_copy->journal_ = journal_;
+  data_copy->needs_full_save_ = needs_full_save_;
+  data_copy->saving_journal_size_ = saving_journal_size_;
+  data_copy->journal_id_ = journal_id_;
   return data_copy;
   // Not copied:
   //    search_term_cache_
@@ -344,6 +400,36 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::Duplicate() const {
   //    post_scoring_item_count_
 };
 
+scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::DuplicateForSave(
+    int* journal_id,
+    size_t* journal_size) {
+  scoped_refptr<URLIndexPrivateData> data_copy = Duplicate();
+  data_copy->journal_.erase(0, saving_journal_size_);
+  data_copy->saving_journal_size_ = 0;
+  *journal_id = journal_id_;
+  *journal_size = data_copy->journal_.size();
+
+  // A full save covers everything recorded so far, so the changes made from
+  // now on can be journaled on top of it.
+  saving_journal_size_ = journal_.size();
+  needs_full_save_ = false;
+  return data_copy;
+}
+
+void URLIndexPrivateData::OnSaveDone(int journal_id,
+                                     size_t journal_size,
+                                     bool succeeded) {
+  if (journal_id != journal_id_)
+    return;
+  if (!succeeded) {
+    ResetJournal(true);
+    return;
+  }
+  DCHECK_LE(journal_size, saving_journal_size_);
+  journal_.erase(0, journal_size);
+  saving_journal_size_ -= journal_size;
+}
+
 bool URLIndexPrivateData::Empty() const {
   return history_info_map_.empty();
 }
@@ -357,6 +443,7 @@ void URLIndexPrivateData::Clear() {
   history_id_word_map_.clear();
   history_info_map_.clear();
   word_starts_map_.clear();
+  ResetJournal(true);
 }
 
 // Private ---------------------------------------------------------------------
@@ -366,10 +453,10 @@ URLIndexPrivateData::~URLIndexPrivateData() {}
 // SearchTermCacheItem ---------------------------------------------------------
 
 URLIndexPrivateData::SearchTermCacheItem::SearchTermCacheItem(
-    const WordIDSet& word_id_set,
-    const HistoryIDSet& history_id_set)
-    : word_id_set_(word_id_set),
-      history_id_set_(history_id_set),
+    const WordIDVector& word_ids,
+    const HistoryIDVector& history_ids)
+    : word_ids_(word_ids),
+      history_ids_(history_ids),
       used_(true) {}
 
 URLIndexPrivateData::SearchTermCacheItem::SearchTermCacheItem()
@@ -442,14 +529,14 @@ bool URLIndexPrivateData::HistoryItemFactorGreater::operator()(
 
 // Index Searching -------------------------------------------------------------
 
-HistoryIDSet URLIndexPrivateData::HistoryIDSetFromWords(
+HistoryIDVector URLIndexPrivateData::HistoryIDsFromWords(
     const String16Vector& unsorted_words) {
   // Break the terms down into individual terms (words), get the candidate
   // set for each term, and intersect each to get a final candidate list.
   // Note that a single 'term' from the user's perspective might be
   // a string like "http://www.somewebsite.com" which, from our perspective,
   // is four words: 'http', 'www', 'somewebsite', and 'com'.
-  HistoryIDSet history_id_set;
+  HistoryIDVector history_ids;
   String16Vector words(unsorted_words);
   // Sort the words into the longest first as such are likely to narrow down
   // the results quicker. Also, single character words are the most expensive
@@ -458,36 +545,33 @@ HistoryIDSet URLIndexPrivateData::HistoryIDSetFromWords(
   for (String16Vector::iterator iter = words.begin(); iter != words.end();
        ++iter) {
     string16 uni_word = *iter;
-    HistoryIDSet term_history_set = HistoryIDsForTerm(uni_word);
-    if (term_history_set.empty()) {
-      history_id_set.clear();
+    HistoryIDVector term_history_ids = HistoryIDsForTerm(uni_word);
+    if (term_history_ids.empty()) {
+      history_ids.clear();
       break;
     }
     if (iter == words.begin()) {
-      history_id_set.swap(term_history_set);
+      history_ids.swap(term_history_ids);
     } else {
-      HistoryIDSet new_history_id_set;
-      std::set_intersection(history_id_set.begin(), history_id_set.end(),
-                            term_history_set.begin(), term_history_set.end(),
-                            std::inserter(new_history_id_set,
-                                          new_history_id_set.begin()));
-      history_id_set.swap(new_history_id_set);
+      HistoryIDVector new_history_ids;
+      IntersectSortedIDs(history_ids, term_history_ids, &new_history_ids);
+      history_ids.swap(new_history_ids);
     }
   }
-  return history_id_set;
+  return history_ids;
 }
 
-HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
+HistoryIDVector URLIndexPrivateData::HistoryIDsForTerm(
     const string16& term) {
   if (term.empty())
-    return HistoryIDSet();
+    return HistoryIDVector();
 
   // TODO(mrossetti): Consider optimizing for very common terms such as
   // 'http[s]', 'www', 'com', etc. Or collect the top 100 more frequently
   // occuring words in the user's searches.
 
   size_t term_length = term.length();
-  WordIDSet word_id_set;
+  WordIDVector word_ids;
   if (term_length > 1) {
     // See if this term or a prefix thereof is present in the cache.
     SearchTermCacheMap::iterator best_prefix(search_term_cache_.end());
@@ -509,17 +593,17 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
       size_t prefix_length = best_prefix->first.length();
       if (prefix_length == term_length) {
         best_prefix->second.used_ = true;
-        return best_prefix->second.history_id_set_;
+        return best_prefix->second.history_ids_;
       }
 
       // Otherwise we have a handy starting point.
       // If there are no history results for this prefix then we can bail early
       // as there will be no history results for the full term.
-      if (best_prefix->second.history_id_set_.empty()) {
+      if (best_prefix->second.history_ids_.empty()) {
         search_term_cache_[term] = SearchTermCacheItem();
-        return HistoryIDSet();
+        return HistoryIDVector();
       }
-      word_id_set = best_prefix->second.word_id_set_;
+      word_ids = best_prefix->second.word_ids_;
       prefix_chars = Char16SetFromString16(best_prefix->first);
       leftovers = term.substr(prefix_length);
     }
@@ -533,95 +617,88 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
 
     // Reduce the word set with any leftover, unprocessed characters.
     if (!unique_chars.empty()) {
-      WordIDSet leftover_set(WordIDSetForTermChars(unique_chars));
+      WordIDVector leftover_ids(WordIDsForTermChars(unique_chars));
       // We might come up empty on the leftovers.
-      if (leftover_set.empty()) {
+      if (leftover_ids.empty()) {
         search_term_cache_[term] = SearchTermCacheItem();
-        return HistoryIDSet();
+        return HistoryIDVector();
       }
       // Or there may not have been a prefix from which to start.
       if (prefix_chars.empty()) {
-        word_id_set.swap(leftover_set);
+        word_ids.swap(leftover_ids);
       } else {
-        WordIDSet new_word_id_set;
-        std::set_intersection(word_id_set.begin(), word_id_set.end(),
-                              leftover_set.begin(), leftover_set.end(),
-                              std::inserter(new_word_id_set,
-                                            new_word_id_set.begin()));
-        word_id_set.swap(new_word_id_set);
+        WordIDVector new_word_ids;
+        IntersectSortedIDs(word_ids, leftover_ids, &new_word_ids);
+        word_ids.swap(new_word_ids);
       }
     }
 
     // We must filter the word list because the resulting word set surely
     // contains words which do not have the search term as a proper subset.
-    for (WordIDSet::iterator word_set_iter = word_id_set.begin();
-         word_set_iter != word_id_set.end(); ) {
-      if (word_list_[*word_set_iter].find(term) == string16::npos)
-        word_id_set.erase(word_set_iter++);
-      else
-        ++word_set_iter;
+    WordIDVector::iterator kept_end = word_ids.begin();
+    for (WordIDVector::const_iterator word_iter = word_ids.begin();
+         word_iter != word_ids.end(); ++word_iter) {
+      if (word_list_[*word_iter].find(term) != string16::npos)
+        *kept_end++ = *word_iter;
     }
+    word_ids.erase(kept_end, word_ids.end());
   } else {
-    word_id_set = WordIDSetForTermChars(Char16SetFromString16(term));
+    word_ids = WordIDsForTermChars(Char16SetFromString16(term));
   }
 
   // If any words resulted then we can compose a set of history IDs by unioning
-  // the sets from each word.
-  HistoryIDSet history_id_set;
-  if (!word_id_set.empty()) {
-    for (WordIDSet::iterator word_id_iter = word_id_set.begin();
-         word_id_iter != word_id_set.end(); ++word_id_iter) {
-      WordID word_id = *word_id_iter;
-      WordIDHistoryMap::iterator word_iter = word_id_history_map_.find(word_id);
-      if (word_iter != word_id_history_map_.end()) {
-        HistoryIDSet& word_history_id_set(word_iter->second);
-        history_id_set.insert(word_history_id_set.begin(),
-                              word_history_id_set.end());
-      }
-    }
+  // the lists from each word.
+  HistoryIDVector history_ids;
+  for (WordIDVector::const_iterator word_id_iter = word_ids.begin();
+       word_id_iter != word_ids.end(); ++word_id_iter) {
+    WordIDHistoryMap::const_iterator word_iter =
+        word_id_history_map_.find(*word_id_iter);
+    if (word_iter != word_id_history_map_.end())
+      word_iter->second.AppendTo(&history_ids);
+  }
+  if (word_ids.size() > 1) {
+    std::sort(history_ids.begin(), history_ids.end());
+    history_ids.erase(std::unique(history_ids.begin(), history_ids.end()),
+                      history_ids.end());
   }
 
   // Record a new cache entry for this word if the term is longer than
   // a single character.
   if (term_length > 1)
-    search_term_cache_[term] = SearchTermCacheItem(word_id_set, history_id_set);
+    search_term_cache_[term] = SearchTermCacheItem(word_ids, history_ids);
 
-  return history_id_set;
+  return history_ids;
 }
 
-WordIDSet URLIndexPrivateData::WordIDSetForTermChars(
+WordIDVector URLIndexPrivateData::WordIDsForTermChars(
     const Char16Set& term_chars) {
-  WordIDSet word_id_set;
+  // Gather the word lists of the characters and intersect them starting with
+  // the shortest.
+  std::vector<const PackedIDSet*> char_word_ids;
   for (Char16Set::const_iterator c_iter = term_chars.begin();
        c_iter != term_chars.end(); ++c_iter) {
-    CharWordIDMap::iterator char_iter = char_word_map_.find(*c_iter);
-    if (char_iter == char_word_map_.end()) {
-      // A character was not found so there are no matching results: bail.
-      word_id_set.clear();
-      break;
-    }
-    WordIDSet& char_word_id_set(char_iter->second);
-    // It is possible for there to no longer be any words associated with
-    // a particular character. Give up in that case.
-    if (char_word_id_set.empty()) {
-      word_id_set.clear();
-      break;
-    }
-
-    if (c_iter == term_chars.begin()) {
-      // First character results becomes base set of results.
-      word_id_set = char_word_id_set;
-    } else {
-      // Subsequent character results get intersected in.
-      WordIDSet new_word_id_set;
-      std::set_intersection(word_id_set.begin(), word_id_set.end(),
-                            char_word_id_set.begin(), char_word_id_set.end(),
-                            std::inserter(new_word_id_set,
-                                          new_word_id_set.begin()));
-      word_id_set.swap(new_word_id_set);
-    }
+    CharWordIDMap::const_iterator char_iter = char_word_map_.find(*c_iter);
+    // A character was not found so there are no matching results: bail. It
+    // is also possible for there to no longer be any words associated with
+    // a particular character. Give up in that case as well.
+    if (char_iter == char_word_map_.end() || char_iter->second.empty())
+      return WordIDVector();
+    char_word_ids.push_back(&char_iter->second);
   }
-  return word_id_set;
+  std::sort(char_word_ids.begin(), char_word_ids.end(), SizeLess);
+
+  WordIDVector word_ids;
+  if (char_word_ids.empty())
+    return word_ids;
+  char_word_ids[0]->AppendTo(&word_ids);
+  for (size_t i = 1; i < char_word_ids.size() && !word_ids.empty(); ++i) {
+    WordIDVector new_word_ids;
+    std::set_intersection(word_ids.begin(), word_ids.end(),
+                          char_word_ids[i]->begin(), char_word_ids[i]->end(),
+                          std::back_inserter(new_word_ids));
+    word_ids.swap(new_word_ids);
+  }
+  return word_ids;
 }
 
 // Cache Updating --------------------------------------------------------------
@@ -708,51 +785,29 @@ void URLIndexPrivateData::AddWordHistory(const string16& term,
   }
   word_map_[term] = word_id;
 
-  HistoryIDSet history_id_set;
-  history_id_set.insert(history_id);
-  word_id_history_map_[word_id] = history_id_set;
+  word_id_history_map_[word_id].insert(history_id);
   AddToHistoryIDWordMap(history_id, word_id);
 
   // For each character in the newly added word (i.e. a word that is not
-  // already in the word index), add the word to the character index.
+  // already in the word index), add the word to the character index,
+  // creating a new entry for characters not seen before.
   Char16Set characters = Char16SetFromString16(term);
   for (Char16Set::iterator uni_char_iter = characters.begin();
-       uni_char_iter != characters.end(); ++uni_char_iter) {
-    char16 uni_char = *uni_char_iter;
-    CharWordIDMap::iterator char_iter = char_word_map_.find(uni_char);
-    if (char_iter != char_word_map_.end()) {
-      // Update existing entry in the char/word index.
-      WordIDSet& word_id_set(char_iter->second);
-      word_id_set.insert(word_id);
-    } else {
-      // Create a new entry in the char/word index.
-      WordIDSet word_id_set;
-      word_id_set.insert(word_id);
-      char_word_map_[uni_char] = word_id_set;
-    }
-  }
+       uni_char_iter != characters.end(); ++uni_char_iter)
+    char_word_map_[*uni_char_iter].insert(word_id);
 }
 
 void URLIndexPrivateData::UpdateWordHistory(WordID word_id,
                                             HistoryID history_id) {
   WordIDHistoryMap::iterator history_pos = word_id_history_map_.find(word_id);
   DCHECK(history_pos != word_id_history_map_.end());
-  HistoryIDSet& history_id_set(history_pos->second);
-  history_id_set.insert(history_id);
+  history_pos->second.insert(history_id);
   AddToHistoryIDWordMap(history_id, word_id);
 }
 
 void URLIndexPrivateData::AddToHistoryIDWordMap(HistoryID history_id,
                                                 WordID word_id) {
-  HistoryIDWordMap::iterator iter = history_id_word_map_.find(history_id);
-  if (iter != history_id_word_map_.end()) {
-    WordIDSet& word_id_set(iter->second);
-    word_id_set.insert(word_id);
-  } else {
-    WordIDSet word_id_set;
-    word_id_set.insert(word_id);
-    history_id_word_map_[history_id] = word_id_set;
-  }
+  history_id_word_map_[history_id].insert(word_id);
 }
 
 void URLIndexPrivateData::RemoveRowFromIndex(const URLRow& row) {
@@ -766,12 +821,13 @@ void URLIndexPrivateData::RemoveRowWordsFromIndex(const URLRow& row) {
   // Remove the entries in history_id_word_map_ and word_id_history_map_ for
   // this row.
   HistoryID history_id = static_cast<HistoryID>(row.id());
-  WordIDSet word_id_set = history_id_word_map_[history_id];
+  WordIDVector word_ids;
+  history_id_word_map_[history_id].AppendTo(&word_ids);
   history_id_word_map_.erase(history_id);
 
   // Reconcile any changes to word usage.
-  for (WordIDSet::iterator word_id_iter = word_id_set.begin();
-       word_id_iter != word_id_set.end(); ++word_id_iter) {
+  for (WordIDVector::iterator word_id_iter = word_ids.begin();
+       word_id_iter != word_ids.end(); ++word_id_iter) {
     WordID word_id = *word_id_iter;
     word_id_history_map_[word_id].erase(history_id);
     if (!word_id_history_map_[word_id].empty())
@@ -802,10 +858,40 @@ void URLIndexPrivateData::ResetSearchTermCache() {
     iter->second.used_ = false;
 }
 
+void URLIndexPrivateData::AddJournalEntry(
+    const InMemoryURLIndexJournalEntry& entry) {
+  if (needs_full_save_)
+    return;
+  if (journal_.size() > kMaxPendingJournalSize) {
+    ResetJournal(true);
+    return;
+  }
+  std::string record;
+  entry.SerializeToString(&record);
+  uint8 size[5];  // The most a varint encoded uint32 takes.
+  uint8* size_end =
+      CodedOutputStream::WriteVarint32ToArray(record.size(), size);
+  journal_.append(reinterpret_cast<const char*>(size), size_end - size);
+  journal_.append(record);
+}
+
+void URLIndexPrivateData::ResetJournal(bool needs_full_save) {
+  journal_.clear();
+  saving_journal_size_ = 0;
+  journal_id_ = g_next_journal_id.GetNext();
+  needs_full_save_ = needs_full_save;
+}
+
 // Cache Saving ----------------------------------------------------------------
 
 bool URLIndexPrivateData::SaveToFile(const base::FilePath& file_path) {
+  if (AppendToJournal(file_path))
+    return true;
+
+  // Write a new cache file holding everything. The journal is dropped first
+  // so that it is never replayed over a cache which does not match it.
   base::TimeTicks beginning_time = base::TimeTicks::Now();
+  file_util::Delete(GetJournalFilePath(file_path), false);
   InMemoryURLIndexCacheItem index_cache;
   SavePrivateData(&index_cache);
   std::string data;
@@ -816,14 +902,47 @@ bool URLIndexPrivateData::SaveToFile(const base::FilePath& file_path) {
 
   int size = data.size();
   if (file_util::WriteFile(file_path, data.c_str(), size) != size) {
+    // Keep later saves from appending to the journal of a damaged cache.
     LOG(WARNING) << "Failed to write " << file_path.value();
+    file_util::Delete(file_path, false);
     return false;
   }
+  ResetJournal(false);
   UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexSaveCacheTime",
                       base::TimeTicks::Now() - beginning_time);
   return true;
 }
 
+bool URLIndexPrivateData::AppendToJournal(const base::FilePath& file_path) {
+  int64 cache_size = 0;
+  if (needs_full_save_ || !file_util::GetFileSize(file_path, &cache_size))
+    return false;
+  if (journal_.empty())
+    return true;
+
+  // Fold a journal grown large relative to the cache into a new cache, which
+  // also bounds the time spent replaying it.
+  base::FilePath journal_path(GetJournalFilePath(file_path));
+  int64 journal_size = 0;
+  bool journal_exists = file_util::PathExists(journal_path);
+  if (journal_exists && !file_util::GetFileSize(journal_path, &journal_size))
+    return false;
+  if ((journal_size + static_cast<int64>(journal_.size())) *
+      kMaxJournalSizeDivisor > cache_size)
+    return false;
+
+  int size = journal_.size();
+  int written = journal_exists ?
+      file_util::AppendToFile(journal_path, journal_.data(), size) :
+      file_util::WriteFile(journal_path, journal_.data(), size);
+  if (written != size) {
+    LOG(WARNING) << "Failed to append to " << journal_path.value();
+    return false;
+  }
+  ResetJournal(false);
+  return true;
+}
+
 void URLIndexPrivateData::SavePrivateData(
     InMemoryURLIndexCacheItem* cache) const {
   DCHECK(cache);
@@ -873,10 +992,10 @@ void URLIndexPrivateData::SaveCharWordMap(
        iter != char_word_map_.end(); ++iter) {
     CharWordMapEntry* map_entry = map_item->add_char_word_map_entry();
     map_entry->set_char_16(iter->first);
-    const WordIDSet& word_id_set(iter->second);
-    map_entry->set_item_count(word_id_set.size());
-    for (WordIDSet::const_iterator set_iter = word_id_set.begin();
-         set_iter != word_id_set.end(); ++set_iter)
+    const PackedIDSet& word_ids(iter->second);
+    map_entry->set_item_count(word_ids.size());
+    for (PackedIDSet::const_iterator set_iter = word_ids.begin();
+         set_iter != word_ids.end(); ++set_iter)
       map_entry->add_word_id(*set_iter);
   }
 }
@@ -892,10 +1011,10 @@ void URLIndexPrivateData::SaveWordIDHistoryMap(
     WordIDHistoryMapEntry* map_entry =
         map_item->add_word_id_history_map_entry();
     map_entry->set_word_id(iter->first);
-    const HistoryIDSet& history_id_set(iter->second);
-    map_entry->set_item_count(history_id_set.size());
-    for (HistoryIDSet::const_iterator set_iter = history_id_set.begin();
-         set_iter != history_id_set.end(); ++set_iter)
+    const PackedIDSet& history_ids(iter->second);
+    map_entry->set_item_count(history_ids.size());
+    for (PackedIDSet::const_iterator set_iter = history_ids.begin();
+         set_iter != history_ids.end(); ++set_iter)
       map_entry->add_history_id(*set_iter);
   }
 }
@@ -906,18 +1025,12 @@ void URLIndexPrivateData::SaveHistoryInfoMap(
     return;
   HistoryInfoMapItem* map_item = cache->mutable_history_info_map();
   map_item->set_item_count(history_info_map_.size());
+  // Note: We only save information that contributes to the index so there
+  // is no need to save search_term_cache_ (not persistent).
   for (HistoryInfoMap::const_iterator iter = history_info_map_.begin();
        iter != history_info_map_.end(); ++iter) {
-    HistoryInfoMapEntry* map_entry = map_item->add_history_info_map_entry();
-    map_entry->set_history_id(iter->first);
-    const URLRow& url_row(iter->second);
-    // Note: We only save information that contributes to the index so there
-    // is no need to save search_term_cache_ (not persistent).
-    map_entry->set_visit_count(url_row.visit_count());
-    map_entry->set_typed_count(url_row.typed_count());
-    map_entry->set_last_visit(url_row.last_visit().ToInternalValue());
-    map_entry->set_url(url_row.url().spec());
-    map_entry->set_title(UTF16ToUTF8(url_row.title()));
+    RowToHistoryInfoMapEntry(iter->first, iter->second,
+                             map_item->add_history_info_map_entry());
   }
 }
 
@@ -951,42 +1064,87 @@ void URLIndexPrivateData::SaveWordStartsMap(
 
 // Cache Restoring -------------------------------------------------------------
 
-// static
-scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::RestoreFromFile(
+bool URLIndexPrivateData::RestoreFromFile(
     const base::FilePath& file_path,
-    const std::string& languages) {
+    const std::string& languages,
+    const std::set<std::string>& scheme_whitelist) {
   base::TimeTicks beginning_time = base::TimeTicks::Now();
   if (!file_util::PathExists(file_path))
-    return NULL;
+    return false;
   std::string data;
   // If there is no cache file then simply give up. This will cause us to
   // attempt to rebuild from the history database.
   if (!file_util::ReadFileToString(file_path, &data))
-    return NULL;
+    return false;
 
-  scoped_refptr<URLIndexPrivateData> restored_data(new URLIndexPrivateData);
   InMemoryURLIndexCacheItem index_cache;
   if (!index_cache.ParseFromArray(data.c_str(), data.size())) {
     LOG(WARNING) << "Failed to parse URLIndexPrivateData cache data read from "
                  << file_path.value();
-    return restored_data;
+    return false;
   }
 
-  if (!restored_data->RestorePrivateData(index_cache, languages))
-    return NULL;
+  if (!RestorePrivateData(index_cache, languages))
+    return false;
+
+  // A cache written by an earlier version is rewritten on the next save.
+  needs_full_save_ = restored_cache_version_ < kCurrentCacheFileVersion;
+  ReplayJournal(file_path, languages, scheme_whitelist);
 
   UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexRestoreCacheTime",
                       base::TimeTicks::Now() - beginning_time);
   UMA_HISTOGRAM_COUNTS("History.InMemoryURLHistoryItems",
-                       restored_data->history_id_word_map_.size());
+                       history_id_word_map_.size());
   UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize", data.size());
-  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords",
-                             restored_data->word_map_.size());
+  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords", word_map_.size());
   UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLChars",
-                             restored_data->char_word_map_.size());
-  if (restored_data->Empty())
-    return NULL;  // 'No data' is the same as a failed reload.
-  return restored_data;
+                             char_word_map_.size());
+  return !Empty();  // 'No data' is the same as a failed reload.
+}
+
+void URLIndexPrivateData::ReplayJournal(
+    const base::FilePath& file_path,
+    const std::string& languages,
+    const std::set<std::string>& scheme_whitelist) {
+  std::string data;
+  if (!file_util::ReadFileToString(GetJournalFilePath(file_path), &data))
+    return;
+
+  const uint8* bytes = reinterpret_cast<const uint8*>(data.data());
+  size_t offset = 0;
+  while (offset < data.size()) {
+    CodedInputStream input(bytes + offset, data.size() - offset);
+    uint32 size = 0;
+    if (!input.ReadVarint32(&size))
+      break;
+    size_t record_offset = offset + CodedOutputStream::VarintSize32(size);
+    InMemoryURLIndexJournalEntry entry;
+    if (record_offset > data.size() || size > data.size() - record_offset ||
+        !entry.ParseFromArray(bytes + record_offset, size))
+      break;
+    offset = record_offset + size;
+
+    if (entry.has_updated_row()) {
+      const HistoryInfoMapEntry& row_entry(entry.updated_row());
+      URLRow row(GURL(row_entry.url()), row_entry.history_id());
+      row.set_visit_count(row_entry.visit_count());
+      row.set_typed_count(row_entry.typed_count());
+      row.set_last_visit(
+          base::Time::FromInternalValue(row_entry.last_visit()));
+      row.set_title(UTF8ToUTF16(row_entry.title()));
+      UpdateURL(row, languages, scheme_whitelist);
+    } else if (entry.has_deleted_url()) {
+      DeleteURL(GURL(entry.deleted_url()));
+    }
+  }
+
+  // The replayed changes are already on disk. A journal cut short by a crash
+  // while appending cannot be appended to any more.
+  journal_.clear();
+  if (offset != data.size()) {
+    LOG(WARNING) << "Ignoring the damaged end of the InMemoryURLIndex journal.";
+    needs_full_save_ = true;
+  }
 }
 
 bool URLIndexPrivateData::RestorePrivateData(
@@ -1010,8 +1168,12 @@ bool URLIndexPrivateData::RestoreWordList(
     return false;
   const RepeatedPtrField<std::string>& words(list_item.word());
   for (RepeatedPtrField<std::string>::const_iterator iter = words.begin();
-       iter != words.end(); ++iter)
+       iter != words.end(); ++iter) {
+    // Slots of removed words are saved as empty words and can be reused.
+    if (iter->empty())
+      available_words_.insert(word_list_.size());
     word_list_.push_back(UTF8ToUTF16(*iter));
+  }
   return true;
 }
 
@@ -1049,12 +1211,11 @@ bool URLIndexPrivateData::RestoreCharWordMap(
     if (actual_item_count == 0 || actual_item_count != expected_item_count)
       return false;
     char16 uni_char = static_cast<char16>(iter->char_16());
-    WordIDSet word_id_set;
+    PackedIDSet& word_id_set(char_word_map_[uni_char]);
     const RepeatedField<int32>& word_ids(iter->word_id());
     for (RepeatedField<int32>::const_iterator jiter = word_ids.begin();
          jiter != word_ids.end(); ++jiter)
       word_id_set.insert(*jiter);
-    char_word_map_[uni_char] = word_id_set;
   }
   return true;
 }
@@ -1077,14 +1238,13 @@ bool URLIndexPrivateData::RestoreWordIDHistoryMap(
     if (actual_item_count == 0 || actual_item_count != expected_item_count)
       return false;
     WordID word_id = iter->word_id();
-    HistoryIDSet history_id_set;
+    PackedIDSet& history_id_set(word_id_history_map_[word_id]);
     const RepeatedField<int64>& history_ids(iter->history_id());
     for (RepeatedField<int64>::const_iterator jiter = history_ids.begin();
          jiter != history_ids.end(); ++jiter) {
       history_id_set.insert(*jiter);
       AddToHistoryIDWordMap(*jiter, word_id);
     }
-    word_id_history_map_[word_id] = history_id_set;
   }
   return true;
 }
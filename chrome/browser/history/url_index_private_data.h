@@ -11,6 +11,7 @@
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
 #include "chrome/browser/history/in_memory_url_index_cache.pb.h"
 #include "chrome/browser/history/in_memory_url_index_types.h"
 #include "chrome/browser/history/scored_history_match.h"
@@ -21,6 +22,7 @@ class BookmarkService;
 
 namespace in_memory_url_index {
 class InMemoryURLIndexCacheItem;
+class InMemoryURLIndexJournalEntry;
 }
 
 namespace history {
@@ -64,6 +66,9 @@ class URLIndexPrivateData
   // |kItemsToScoreLimit| limit) will be retained and used for subsequent calls
   // to this function. |bookmark_service| is used to boost a result's score if
   // its URL is referenced by one or more of the user's bookmarks.
+  //
+  // This may be called on any thread as long as the index is not being
+  // updated at the same time; see InMemoryURLIndex::HistoryItemsForTermsAsync.
   ScoredHistoryMatches HistoryItemsForTerms(string16 term_string,
                                             size_t cursor_position,
                                             BookmarkService* bookmark_service);
@@ -85,13 +90,15 @@ class URLIndexPrivateData
   // was actually updated.
   bool DeleteURL(const GURL& url);
 
-  // Creates a new URLIndexPrivateData object, populates it from the contents
-  // of the cache file stored in |file_path|, and assigns it to |private_data|.
-  // |languages| will be used to break URLs and page titles into words.
+  // Populates |private_data|, which must be empty, from the contents of the
+  // cache file stored in |file_path| and then replays the journal of changes
+  // appended after it. |languages| will be used to break URLs and page titles
+  // into words and |scheme_whitelist| to filter the replayed changes.
   static void RestoreFromFileTask(
       const base::FilePath& file_path,
       scoped_refptr<URLIndexPrivateData> private_data,
-      const std::string& languages);
+      const std::string& languages,
+      const std::set<std::string>& scheme_whitelist);
 
   // Constructs a new object by rebuilding its contents from the history
   // database in |history_db|. Returns the new URLIndexPrivateData which on
@@ -104,13 +111,32 @@ class URLIndexPrivateData
       const std::set<std::string>& scheme_whitelist);
 
   // Writes |private_data| as a cache file to |file_path| and returns success.
+  // When the cache file is current except for the changes made since it was
+  // last written, only those changes are appended to the journal file.
   static bool WritePrivateDataToCacheFileTask(
       scoped_refptr<URLIndexPrivateData> private_data,
       const base::FilePath& file_path);
 
+  // Returns the path of the journal kept next to the cache file at
+  // |cache_path|.
+  static base::FilePath GetJournalFilePath(const base::FilePath& cache_path);
+
   // Creates a copy of ourself.
   scoped_refptr<URLIndexPrivateData> Duplicate() const;
 
+  // Returns a copy to be written by WritePrivateDataToCacheFileTask holding
+  // the changes recorded since the last copy was handed off. Those changes
+  // stay recorded here until OnSaveDone() reports that the copy was written.
+  // |journal_id| and |journal_size| receive the values to pass to it.
+  scoped_refptr<URLIndexPrivateData> DuplicateForSave(int* journal_id,
+                                                      size_t* journal_size);
+
+  // Called once the copy made by DuplicateForSave() has been written or has
+  // failed to be. On success the changes it held are forgotten, on failure
+  // the next save writes a whole new cache file. Does nothing if the journal
+  // was started afresh since the copy was made.
+  void OnSaveDone(int journal_id, size_t journal_size, bool succeeded);
+
   // Returns true if there is no data in the index.
   bool Empty() const;
 
@@ -125,9 +151,11 @@ class URLIndexPrivateData
   friend class AddHistoryMatch;
   friend class ::HistoryQuickProviderTest;
   friend class InMemoryURLIndexTest;
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheJournal);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheSaveRestore);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CursorPositionRetrieval);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, HugeResultSet);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, IndexBenchmark);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Scoring);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, TitleSearch);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, TypedCharacterCaching);
@@ -145,22 +173,22 @@ class URLIndexPrivateData
   // no longer needed.
   //
   // Items stored in the search term cache. If a search term exactly matches one
-  // in the cache then we can quickly supply the proper |history_id_set_| (and
+  // in the cache then we can quickly supply the proper |history_ids_| (and
   // marking the cache item as being |used_|. If we find a prefix for a search
   // term in the cache (which is very likely to occur as the user types each
   // term into the omnibox) then we can short-circuit the index search for those
-  // characters in the prefix by returning the |word_id_set|. In that case we do
+  // characters in the prefix by returning the |word_ids_|. In that case we do
   // not mark the item as being |used_|.
   struct SearchTermCacheItem {
-    SearchTermCacheItem(const WordIDSet& word_id_set,
-                        const HistoryIDSet& history_id_set);
+    SearchTermCacheItem(const WordIDVector& word_ids,
+                        const HistoryIDVector& history_ids);
     // Creates a cache item for a term which has no results.
     SearchTermCacheItem();
 
     ~SearchTermCacheItem();
 
-    WordIDSet word_id_set_;
-    HistoryIDSet history_id_set_;
+    WordIDVector word_ids_;  // Sorted.
+    HistoryIDVector history_ids_;  // Sorted.
     bool used_;  // True if this item has been used for the current term search.
   };
   typedef std::map<string16, SearchTermCacheItem> SearchTermCacheMap;
@@ -205,16 +233,17 @@ class URLIndexPrivateData
 
   // URL History indexing support functions.
 
-  // Composes a set of history item IDs by intersecting the set for each word
-  // in |unsorted_words|.
-  HistoryIDSet HistoryIDSetFromWords(const String16Vector& unsorted_words);
+  // Composes a sorted list of history item IDs by intersecting the lists for
+  // each word in |unsorted_words|.
+  HistoryIDVector HistoryIDsFromWords(const String16Vector& unsorted_words);
 
-  // Helper function to HistoryIDSetFromWords which composes a set of history
-  // ids for the given term given in |term|.
-  HistoryIDSet HistoryIDsForTerm(const string16& term);
+  // Helper function to HistoryIDsFromWords which composes a sorted list of
+  // history ids for the given term given in |term|.
+  HistoryIDVector HistoryIDsForTerm(const string16& term);
 
-  // Given a set of Char16s, finds words containing those characters.
-  WordIDSet WordIDSetForTermChars(const Char16Set& term_chars);
+  // Given a set of Char16s, finds words containing those characters and
+  // returns their sorted IDs.
+  WordIDVector WordIDsForTermChars(const Char16Set& term_chars);
 
   // Indexes one URL history item as described by |row|. Returns true if the
   // row was actually indexed. |languages| gives a list of language encodings by
@@ -257,10 +286,23 @@ class URLIndexPrivateData
   // Clears |used_| for each item in the search term cache.
   void ResetSearchTermCache();
 
+  // Records a change to the index for the journal.
+  void AddJournalEntry(const imui::InMemoryURLIndexJournalEntry& entry);
+
+  // Forgets the recorded changes, including those handed off to a save not
+  // finished yet, and sets |needs_full_save_|.
+  void ResetJournal(bool needs_full_save);
+
   // Caches the index private data and writes the cache file to the profile
-  // directory.  Called by WritePrivateDataToCacheFileTask.
+  // directory, or appends the journal when that is enough.  Called by
+  // WritePrivateDataToCacheFileTask.
   bool SaveToFile(const base::FilePath& file_path);
 
+  // Appends |journal_| to the journal file of the cache at |file_path| if the
+  // cache is up to date apart from it and the journal stays small. Returns
+  // true if the journal was written.
+  bool AppendToJournal(const base::FilePath& file_path);
+
   // Encode a data structure into the protobuf |cache|.
   void SavePrivateData(imui::InMemoryURLIndexCacheItem* cache) const;
   void SaveWordList(imui::InMemoryURLIndexCacheItem* cache) const;
@@ -270,13 +312,18 @@ class URLIndexPrivateData
   void SaveHistoryInfoMap(imui::InMemoryURLIndexCacheItem* cache) const;
   void SaveWordStartsMap(imui::InMemoryURLIndexCacheItem* cache) const;
 
-  // Constructs a new object by restoring its contents from the file at |path|.
-  // Returns the new URLIndexPrivateData which on success will contain the
-  // restored data but upon failure will be empty.  |languages| will be used to
-  // break URLs and page titles into words
-  static scoped_refptr<URLIndexPrivateData> RestoreFromFile(
-      const base::FilePath& path,
-      const std::string& languages);
+  // Restores our contents from the cache file at |path| and its journal.
+  // Returns false, possibly leaving partially restored data, upon failure.
+  // |languages| will be used to break URLs and page titles into words and
+  // |scheme_whitelist| to filter the changes replayed from the journal.
+  bool RestoreFromFile(const base::FilePath& path,
+                       const std::string& languages,
+                       const std::set<std::string>& scheme_whitelist);
+
+  // Applies the changes in the journal of the cache at |path|.
+  void ReplayJournal(const base::FilePath& path,
+                     const std::string& languages,
+                     const std::set<std::string>& scheme_whitelist);
 
   // Decode a data structure from the protobuf |cache|. Return false if there
   // is any kind of failure. |languages| will be used to break URLs and page
@@ -298,6 +345,11 @@ class URLIndexPrivateData
   // Cache of search terms.
   SearchTermCacheMap search_term_cache_;
 
+  // Held by HistoryItemsForTerms(), which updates |search_term_cache_| and
+  // the item counts and may run on the UI thread and the blocking pool at
+  // once.
+  base::Lock search_lock_;
+
   // Whether to allow breaking the input at the cursor position.  Set based
   // on whether the user is in the OmniboxHQPUseCursorPosition field trial
   // experiment group.
@@ -352,6 +404,22 @@ class URLIndexPrivateData
 
   // End of data members that are cached ---------------------------------------
 
+  // The changes made to the index since it was restored from or written to
+  // the cache, as journal records.
+  std::string journal_;
+
+  // True unless the cache file on disk plus |journal_| describes the index,
+  // in which case saving only needs to append to the journal.
+  bool needs_full_save_;
+
+  // The number of bytes at the front of |journal_| handed off to saves which
+  // have not finished yet.
+  size_t saving_journal_size_;
+
+  // Identifies |journal_| across copies, so that a save finishing after the
+  // journal was started afresh does not touch the new one.
+  int journal_id_;
+
   // For unit testing only. Specifies the version of the cache file to be saved.
   // Used only for testing upgrading of an older version of the cache upon
   // restore.
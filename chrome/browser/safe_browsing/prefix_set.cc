@@ -5,9 +5,11 @@
 #include "chrome/browser/safe_browsing/prefix_set.h"
 
 #include <algorithm>
+#include <iterator>
 #include <math.h>
 
 #include "base/file_util.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/logging.h"
 #include "base/md5.h"
 #include "base/metrics/histogram.h"
@@ -19,39 +21,99 @@ namespace {
 // md5 -qs chrome/browser/safe_browsing/prefix_set.cc | colrm 9
 static uint32 kMagic = 0x864088dd;
 
-// Current version the code writes out.
-static uint32 kVersion = 0x1;
+// Current version the code writes out.  Version 1 files are still read.
+static uint32 kVersion = 0x2;
+static uint32 kVersion1 = 0x1;
 
 typedef struct {
   uint32 magic;
   uint32 version;
   uint32 index_size;
   uint32 deltas_size;
+} FileHeaderV1;
+
+typedef struct {
+  uint32 magic;
+  uint32 version;
+  uint32 index_size;
+  uint32 deltas_size;
+  uint32 filter_blocks;
+  uint32 padding[11];
 } FileHeader;
 
-// For |std::upper_bound()| to find a prefix w/in a vector of pairs.
-bool PrefixLess(const std::pair<SBPrefix,size_t>& a,
-                const std::pair<SBPrefix,size_t>& b) {
-  return a.first < b.first;
+COMPILE_ASSERT(sizeof(FileHeader) == 64, file_header_is_a_cache_line);
+
+// Writes |size| bytes at |data| to |file| and adds them to |context|.
+bool WriteAndDigest(const void* data, size_t size, FILE* file,
+                    base::MD5Context* context) {
+  if (!size)
+    return true;
+  if (fwrite(data, 1, size, file) != size)
+    return false;
+  base::MD5Update(context,
+                  base::StringPiece(static_cast<const char*>(data), size));
+  return true;
+}
+
+// Mixes |prefix| into the hashes used by the filter.  Real prefixes
+// are uniformly distributed already, but tests and benchmarks use
+// sequential ones.
+uint32 FilterBlockHash(SBPrefix prefix) {
+  return static_cast<uint32>(prefix) * 0x9E3779B1u;
+}
+
+uint32 FilterBitsHash(SBPrefix prefix) {
+  uint32 hash = static_cast<uint32>(prefix);
+  hash = (hash ^ (hash >> 16)) * 0x85EBCA6Bu;
+  hash = (hash ^ (hash >> 13)) * 0xC2B2AE35u;
+  return hash ^ (hash >> 16);
 }
 
 }  // namespace
 
 namespace safe_browsing {
 
-PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
+PrefixSet::PrefixSet()
+    : index_prefixes_(NULL),
+      index_offsets_(NULL),
+      index_size_(0),
+      deltas_(NULL),
+      deltas_size_(0),
+      filter_(NULL),
+      filter_blocks_(0) {
+}
+
+PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes)
+    : filter_(NULL),
+      filter_blocks_(0) {
+  Init(sorted_prefixes, false);
+}
+
+PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes,
+                     bool use_filter)
+    : filter_(NULL),
+      filter_blocks_(0) {
+  Init(sorted_prefixes, use_filter);
+}
+
+PrefixSet::~PrefixSet() {}
+
+void PrefixSet::Init(const std::vector<SBPrefix>& sorted_prefixes,
+                     bool use_filter) {
   if (sorted_prefixes.size()) {
     // Estimate the resulting vector sizes.  There will be strictly
     // more than |min_runs| entries in |index_|, but there generally
     // aren't many forced breaks.
     const size_t min_runs = sorted_prefixes.size() / kMaxRun;
-    index_.reserve(min_runs);
-    deltas_.reserve(sorted_prefixes.size() - min_runs);
+    index_prefixes_storage_.reserve(min_runs);
+    index_offsets_storage_.reserve(min_runs);
+    deltas_storage_.reserve(sorted_prefixes.size() - min_runs);
 
     // Lead with the first prefix.
     SBPrefix prev_prefix = sorted_prefixes[0];
     size_t run_length = 0;
-    index_.push_back(std::make_pair(prev_prefix, deltas_.size()));
+    index_prefixes_storage_.push_back(prev_prefix);
+    index_offsets_storage_.push_back(0);
 
     for (size_t i = 1; i < sorted_prefixes.size(); ++i) {
       // Skip duplicates.
@@ -67,84 +129,156 @@ PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
       // New index ref if the delta doesn't fit, or if too many
       // consecutive deltas have been encoded.
       if (delta != static_cast<unsigned>(delta16) || run_length >= kMaxRun) {
-        index_.push_back(std::make_pair(sorted_prefixes[i], deltas_.size()));
+        index_prefixes_storage_.push_back(sorted_prefixes[i]);
+        index_offsets_storage_.push_back(
+            static_cast<uint32>(deltas_storage_.size()));
         run_length = 0;
       } else {
         // Continue the run of deltas.
-        deltas_.push_back(delta16);
-        DCHECK_EQ(static_cast<unsigned>(deltas_.back()), delta);
+        deltas_storage_.push_back(delta16);
+        DCHECK_EQ(static_cast<unsigned>(deltas_storage_.back()), delta);
         ++run_length;
       }
 
       prev_prefix = sorted_prefixes[i];
     }
 
+    // Build the filter from the unique prefixes.
+    const size_t unique_prefixes =
+        index_prefixes_storage_.size() + deltas_storage_.size();
+    if (use_filter) {
+      const size_t kFilterBlockBits = kFilterBlockWords * 32;
+      const size_t filter_blocks =
+          (unique_prefixes * kFilterBitsPerPrefix + kFilterBlockBits - 1) /
+          kFilterBlockBits;
+      const size_t filter_bytes = filter_blocks * kFilterBlockWords * 4;
+      filter_storage_.reset(static_cast<uint32*>(
+          base::AlignedAlloc(filter_bytes, kFilterBlockWords * 4)));
+      memset(filter_storage_.get(), 0, filter_bytes);
+      filter_blocks_ = filter_blocks;
+
+      std::vector<SBPrefix>::const_iterator iter = sorted_prefixes.begin();
+      for (; iter != sorted_prefixes.end(); ++iter)
+        AddToFilter(*iter, filter_storage_.get(), filter_blocks_);
+    }
+
     // Send up some memory-usage stats.  Bits because fractional bytes
     // are weird.
-    const size_t bits_used = index_.size() * sizeof(index_[0]) * CHAR_BIT +
-        deltas_.size() * sizeof(deltas_[0]) * CHAR_BIT;
-    const size_t unique_prefixes = index_.size() + deltas_.size();
+    const size_t bits_used =
+        index_prefixes_storage_.size() * sizeof(SBPrefix) * CHAR_BIT +
+        index_offsets_storage_.size() * sizeof(uint32) * CHAR_BIT +
+        deltas_storage_.size() * sizeof(uint16) * CHAR_BIT;
     static const size_t kMaxBitsPerPrefix = sizeof(SBPrefix) * CHAR_BIT;
     UMA_HISTOGRAM_ENUMERATION("SB2.PrefixSetBitsPerPrefix",
                               bits_used / unique_prefixes,
                               kMaxBitsPerPrefix);
   }
+  UseStorage();
 }
 
-PrefixSet::PrefixSet(std::vector<std::pair<SBPrefix,size_t> > *index,
-                     std::vector<uint16> *deltas) {
-  DCHECK(index && deltas);
-  index_.swap(*index);
-  deltas_.swap(*deltas);
+void PrefixSet::UseStorage() {
+  index_size_ = index_prefixes_storage_.size();
+  DCHECK_EQ(index_size_, index_offsets_storage_.size());
+  index_prefixes_ = index_size_ ? &index_prefixes_storage_[0] : NULL;
+  index_offsets_ = index_size_ ? &index_offsets_storage_[0] : NULL;
+  deltas_size_ = deltas_storage_.size();
+  deltas_ = deltas_size_ ? &deltas_storage_[0] : NULL;
+  filter_ = filter_storage_.get();
 }
 
-PrefixSet::~PrefixSet() {}
+// static
+void PrefixSet::AddToFilter(SBPrefix prefix, uint32* filter,
+                            size_t filter_blocks) {
+  uint32* block = filter + kFilterBlockWords * static_cast<size_t>(
+      (static_cast<uint64>(FilterBlockHash(prefix)) * filter_blocks) >> 32);
+  uint32 bits = FilterBitsHash(prefix);
+  for (size_t i = 0; i < kFilterHashes; ++i, bits >>= 9)
+    block[(bits >> 5) & (kFilterBlockWords - 1)] |= 1u << (bits & 31);
+}
+
+bool PrefixSet::FilterMayContain(SBPrefix prefix) const {
+  const uint32* block = filter_ + kFilterBlockWords * static_cast<size_t>(
+      (static_cast<uint64>(FilterBlockHash(prefix)) * filter_blocks_) >> 32);
+  uint32 bits = FilterBitsHash(prefix);
+  for (size_t i = 0; i < kFilterHashes; ++i, bits >>= 9) {
+    if (!(block[(bits >> 5) & (kFilterBlockWords - 1)] & (1u << (bits & 31))))
+      return false;
+  }
+  return true;
+}
 
 bool PrefixSet::Exists(SBPrefix prefix) const {
-  if (index_.empty())
+  if (!index_size_)
+    return false;
+
+  // Most prefixes looked up are not in the set, and most of those are
+  // turned away by the filter.
+  if (filter_ && !FilterMayContain(prefix))
     return false;
 
-  // Find the first position after |prefix| in |index_|.
-  std::vector<std::pair<SBPrefix,size_t> >::const_iterator
-      iter = std::upper_bound(index_.begin(), index_.end(),
-                              std::pair<SBPrefix,size_t>(prefix, 0),
-                              PrefixLess);
+  // Find the first run starting after |prefix|.
+  const SBPrefix* iter =
+      std::upper_bound(index_prefixes_, index_prefixes_ + index_size_, prefix);
 
   // |prefix| comes before anything that's in the set.
-  if (iter == index_.begin())
+  if (iter == index_prefixes_)
     return false;
 
-  // Capture the upper bound of our target entry's deltas.
-  const size_t bound = (iter == index_.end() ? deltas_.size() : iter->second);
+  // Capture the upper bound of our target run's deltas.
+  size_t ii = iter - index_prefixes_;
+  const size_t bound = (ii == index_size_ ? deltas_size_ : index_offsets_[ii]);
 
-  // Back up to the entry our target is in.
-  --iter;
+  // Back up to the run our target is in.
+  --ii;
 
-  // All prefixes in |index_| are in the set.
-  SBPrefix current = iter->first;
+  // All prefixes in the index are in the set.
+  SBPrefix current = index_prefixes_[ii];
   if (current == prefix)
     return true;
 
   // Scan forward accumulating deltas while a match is possible.
-  for (size_t di = iter->second; di < bound && current < prefix; ++di) {
+  for (size_t di = index_offsets_[ii]; di < bound && current < prefix; ++di) {
     current += deltas_[di];
   }
 
   return current == prefix;
 }
 
+PrefixSet* PrefixSet::CreateUpdated(
+    const std::vector<SBPrefix>& sorted_added,
+    const std::vector<SBPrefix>& sorted_removed) const {
+  std::vector<SBPrefix> prefixes;
+  GetPrefixes(&prefixes);
+
+  // |prefixes| is already sorted, so merging in the additions is
+  // linear.  Duplicates are dropped before the removals so that a
+  // removed prefix goes away even if it was also added.
+  std::vector<SBPrefix> merged;
+  merged.reserve(prefixes.size() + sorted_added.size());
+  std::merge(prefixes.begin(), prefixes.end(),
+             sorted_added.begin(), sorted_added.end(),
+             std::back_inserter(merged));
+  merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+
+  prefixes.clear();
+  std::set_difference(merged.begin(), merged.end(),
+                      sorted_removed.begin(), sorted_removed.end(),
+                      std::back_inserter(prefixes));
+  return new PrefixSet(prefixes, filter_ != NULL);
+}
+
 void PrefixSet::GetPrefixes(std::vector<SBPrefix>* prefixes) const {
-  prefixes->reserve(index_.size() + deltas_.size());
+  prefixes->reserve(index_size_ + deltas_size_);
 
-  for (size_t ii = 0; ii < index_.size(); ++ii) {
-    // The deltas for this |index_| entry run to the next index entry,
-    // or the end of the deltas.
+  for (size_t ii = 0; ii < index_size_; ++ii) {
+    // The deltas for this run end at the next run's offset, or the
+    // end of the deltas.
     const size_t deltas_end =
-        (ii + 1 < index_.size()) ? index_[ii + 1].second : deltas_.size();
+        (ii + 1 < index_size_) ? index_offsets_[ii + 1] : deltas_size_;
 
-    SBPrefix current = index_[ii].first;
+    SBPrefix current = index_prefixes_[ii];
     prefixes->push_back(current);
-    for (size_t di = index_[ii].second; di < deltas_end; ++di) {
+    for (size_t di = index_offsets_[ii]; di < deltas_end; ++di) {
       current += deltas_[di];
       prefixes->push_back(current);
     }
@@ -153,92 +287,128 @@ void PrefixSet::GetPrefixes(std::vector<SBPrefix>* prefixes) const {
 
 // static
 PrefixSet* PrefixSet::LoadFile(const base::FilePath& filter_name) {
-  int64 size_64;
-  if (!file_util::GetFileSize(filter_name, &size_64))
+  scoped_ptr<base::MemoryMappedFile> mapped_file(new base::MemoryMappedFile);
+  if (!mapped_file->Initialize(filter_name))
     return NULL;
+
+  const uint8* data = mapped_file->data();
+  const size_t size = mapped_file->length();
   using base::MD5Digest;
-  if (size_64 < static_cast<int64>(sizeof(FileHeader) + sizeof(MD5Digest)))
+  if (size < sizeof(FileHeaderV1) + sizeof(MD5Digest))
     return NULL;
 
-  file_util::ScopedFILE file(file_util::OpenFile(filter_name, "rb"));
-  if (!file.get())
+  // Both versions start with the magic number and the version.
+  uint32 magic, version;
+  memcpy(&magic, data, sizeof(magic));
+  memcpy(&version, data + sizeof(magic), sizeof(version));
+  if (magic != kMagic || (version != kVersion && version != kVersion1))
     return NULL;
 
-  FileHeader header;
-  size_t read = fread(&header, sizeof(header), 1, file.get());
-  if (read != 1)
-    return NULL;
-
-  if (header.magic != kMagic || header.version != kVersion)
+  // Everything but the digest at the end is covered by the digest.
+  const size_t payload_size = size - sizeof(MD5Digest);
+  base::MD5Digest calculated_digest;
+  base::MD5Sum(data, payload_size, &calculated_digest);
+  if (0 != memcmp(data + payload_size, &calculated_digest,
+                  sizeof(calculated_digest)))
     return NULL;
 
-  std::vector<std::pair<SBPrefix,size_t> > index;
-  const size_t index_bytes = sizeof(index[0]) * header.index_size;
+  scoped_ptr<PrefixSet> prefix_set(new PrefixSet());
+  if (version == kVersion1) {
+    if (!prefix_set->InitFromVersion1(data, payload_size))
+      return NULL;
+  } else {
+    if (!prefix_set->InitFromVersion2(mapped_file.Pass()))
+      return NULL;
+  }
+  return prefix_set.release();
+}
 
-  std::vector<uint16> deltas;
-  const size_t deltas_bytes = sizeof(deltas[0]) * header.deltas_size;
+bool PrefixSet::InitFromVersion1(const uint8* data, size_t size) {
+  FileHeaderV1 header;
+  memcpy(&header, data, sizeof(header));
 
-  // Check for bogus sizes before allocating any space.
-  const size_t expected_bytes =
-      sizeof(header) + index_bytes + deltas_bytes + sizeof(MD5Digest);
-  if (static_cast<int64>(expected_bytes) != size_64)
-    return NULL;
+  typedef std::pair<SBPrefix,size_t> IndexEntry;
+  const size_t index_bytes = sizeof(IndexEntry) * header.index_size;
+  const size_t deltas_bytes = sizeof(uint16) * header.deltas_size;
+  if (sizeof(header) + index_bytes + deltas_bytes != size)
+    return false;
 
-  // The file looks valid, start building the digest.
-  base::MD5Context context;
-  base::MD5Init(&context);
-  base::MD5Update(&context, base::StringPiece(reinterpret_cast<char*>(&header),
-                                              sizeof(header)));
-
-  // Read the index vector.  Herb Sutter indicates that vectors are
-  // guaranteed to be contiuguous, so reading to where element 0 lives
-  // is valid.
-  if (header.index_size) {
-    index.resize(header.index_size);
-    read = fread(&(index[0]), sizeof(index[0]), index.size(), file.get());
-    if (read != index.size())
-      return NULL;
-    base::MD5Update(&context,
-                    base::StringPiece(reinterpret_cast<char*>(&(index[0])),
-                                      index_bytes));
+  std::vector<IndexEntry> index(header.index_size);
+  if (header.index_size)
+    memcpy(&index[0], data + sizeof(header), index_bytes);
+  index_prefixes_storage_.reserve(index.size());
+  index_offsets_storage_.reserve(index.size());
+  for (size_t i = 0; i < index.size(); ++i) {
+    if (index[i].second > header.deltas_size)
+      return false;
+    index_prefixes_storage_.push_back(index[i].first);
+    index_offsets_storage_.push_back(static_cast<uint32>(index[i].second));
   }
 
-  // Read vector of deltas.
+  deltas_storage_.resize(header.deltas_size);
   if (header.deltas_size) {
-    deltas.resize(header.deltas_size);
-    read = fread(&(deltas[0]), sizeof(deltas[0]), deltas.size(), file.get());
-    if (read != deltas.size())
-      return NULL;
-    base::MD5Update(&context,
-                    base::StringPiece(reinterpret_cast<char*>(&(deltas[0])),
-                                      deltas_bytes));
+    memcpy(&deltas_storage_[0], data + sizeof(header) + index_bytes,
+           deltas_bytes);
   }
 
-  base::MD5Digest calculated_digest;
-  base::MD5Final(&calculated_digest, &context);
+  UseStorage();
+  return true;
+}
 
-  base::MD5Digest file_digest;
-  read = fread(&file_digest, sizeof(file_digest), 1, file.get());
-  if (read != 1)
-    return NULL;
+bool PrefixSet::InitFromVersion2(
+    scoped_ptr<base::MemoryMappedFile> mapped_file) {
+  const uint8* data = mapped_file->data();
+  const size_t size = mapped_file->length() - sizeof(base::MD5Digest);
+  if (size < sizeof(FileHeader))
+    return false;
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  // Check the sizes in 64 bits so that bogus counts cannot overflow.
+  const uint64 filter_bytes =
+      static_cast<uint64>(header.filter_blocks) * kFilterBlockWords * 4;
+  const uint64 index_bytes =
+      static_cast<uint64>(header.index_size) * (sizeof(SBPrefix) + 4);
+  const uint64 deltas_bytes =
+      static_cast<uint64>(header.deltas_size) * sizeof(uint16);
+  if (sizeof(header) + filter_bytes + index_bytes + deltas_bytes != size)
+    return false;
 
-  if (0 != memcmp(&file_digest, &calculated_digest, sizeof(file_digest)))
-    return NULL;
+  const uint8* ptr = data + sizeof(header);
+  filter_blocks_ = header.filter_blocks;
+  filter_ = filter_blocks_ ? reinterpret_cast<const uint32*>(ptr) : NULL;
+  ptr += filter_bytes;
+  index_size_ = header.index_size;
+  index_prefixes_ = reinterpret_cast<const SBPrefix*>(ptr);
+  ptr += index_size_ * sizeof(SBPrefix);
+  index_offsets_ = reinterpret_cast<const uint32*>(ptr);
+  ptr += index_size_ * 4;
+  deltas_size_ = header.deltas_size;
+  deltas_ = reinterpret_cast<const uint16*>(ptr);
+
+  // |Exists()| trusts the offsets to stay within |deltas_|.
+  for (size_t i = 0; i < index_size_; ++i) {
+    if (index_offsets_[i] > deltas_size_)
+      return false;
+  }
 
-  // Steals contents of |index| and |deltas| via swap().
-  return new PrefixSet(&index, &deltas);
+  mapped_file_ = mapped_file.Pass();
+  return true;
 }
 
 bool PrefixSet::WriteFile(const base::FilePath& filter_name) const {
   FileHeader header;
+  memset(&header, 0, sizeof(header));
   header.magic = kMagic;
   header.version = kVersion;
-  header.index_size = static_cast<uint32>(index_.size());
-  header.deltas_size = static_cast<uint32>(deltas_.size());
+  header.index_size = static_cast<uint32>(index_size_);
+  header.deltas_size = static_cast<uint32>(deltas_size_);
+  header.filter_blocks = static_cast<uint32>(filter_blocks_);
 
   // Sanity check that the 32-bit values never mess things up.
-  if (static_cast<size_t>(header.index_size) != index_.size() ||
-      static_cast<size_t>(header.deltas_size) != deltas_.size()) {
+  if (static_cast<size_t>(header.index_size) != index_size_ ||
+      static_cast<size_t>(header.deltas_size) != deltas_size_ ||
+      static_cast<size_t>(header.filter_blocks) != filter_blocks_) {
     NOTREACHED();
     return false;
   }
@@ -252,41 +422,20 @@ bool PrefixSet::WriteFile(const base::FilePath& filter_name) const {
 
   // TODO(shess): The I/O code in safe_browsing_store_file.cc would
   // sure be useful about now.
-  size_t written = fwrite(&header, sizeof(header), 1, file.get());
-  if (written != 1)
+  if (!WriteAndDigest(&header, sizeof(header), file.get(), &context) ||
+      !WriteAndDigest(filter_, filter_blocks_ * kFilterBlockWords * 4,
+                      file.get(), &context) ||
+      !WriteAndDigest(index_prefixes_, index_size_ * sizeof(SBPrefix),
+                      file.get(), &context) ||
+      !WriteAndDigest(index_offsets_, index_size_ * 4,
+                      file.get(), &context) ||
+      !WriteAndDigest(deltas_, deltas_size_ * sizeof(uint16),
+                      file.get(), &context))
     return false;
-  base::MD5Update(&context, base::StringPiece(reinterpret_cast<char*>(&header),
-                                              sizeof(header)));
-
-  // As for reads, the standard guarantees the ability to access the
-  // contents of the vector by a pointer to an element.
-  if (index_.size()) {
-    const size_t index_bytes = sizeof(index_[0]) * index_.size();
-    written = fwrite(&(index_[0]), sizeof(index_[0]), index_.size(),
-                     file.get());
-    if (written != index_.size())
-      return false;
-    base::MD5Update(&context,
-                    base::StringPiece(
-                        reinterpret_cast<const char*>(&(index_[0])),
-                        index_bytes));
-  }
-
-  if (deltas_.size()) {
-    const size_t deltas_bytes = sizeof(deltas_[0]) * deltas_.size();
-    written = fwrite(&(deltas_[0]), sizeof(deltas_[0]), deltas_.size(),
-                     file.get());
-    if (written != deltas_.size())
-      return false;
-    base::MD5Update(&context,
-                    base::StringPiece(
-                        reinterpret_cast<const char*>(&(deltas_[0])),
-                        deltas_bytes));
-  }
 
   base::MD5Digest digest;
   base::MD5Final(&digest, &context);
-  written = fwrite(&digest, sizeof(digest), 1, file.get());
+  size_t written = fwrite(&digest, sizeof(digest), 1, file.get());
   if (written != 1)
     return false;
 
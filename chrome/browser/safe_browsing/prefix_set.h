@@ -37,24 +37,45 @@
 // 2^16 apart, which would need 512k (versus 256k to store the raw
 // data).
 //
+// The index is kept as two parallel arrays, the run prefixes and the
+// offsets of their deltas, so that the binary search in |Exists()|
+// only touches the packed prefixes, sixteen to a cache line.
+//
+// Most lookups are for prefixes which are not in the set.  An
+// optional blocked bloom filter in front of the index rejects most of
+// those by testing a few bits of a single 64-byte block.  At
+// |kFilterBitsPerPrefix| bits per prefix it lets about 3% of absent
+// prefixes through, and adds half again to the memory footprint.
+//
 // The on-disk format looks like:
 //         4 byte magic number
 //         4 byte version number
-//         4 byte |index_.size()|
-//         4 byte |deltas_.size()|
-//     n * 8 byte |&index_[0]..&index_[n]|
-//     m * 2 byte |&deltas_[0]..&deltas_[m]|
+//         4 byte |index_size_|
+//         4 byte |deltas_size_|
+//         4 byte |filter_blocks_|
+//        44 byte padding, so that the filter starts on a cache line
+//    f * 64 byte |filter_[0]..filter_[16 * f]|
+//     n * 4 byte |index_prefixes_[0]..index_prefixes_[n]|
+//     n * 4 byte |index_offsets_[0]..index_offsets_[n]|
+//     m * 2 byte |deltas_[0]..deltas_[m]|
 //        16 byte digest
+// Every field is at its natural alignment, so |LoadFile()| maps the
+// file and uses it in place rather than reading it into memory.
+// Version 1 files, which had |std::pair<SBPrefix,size_t>| index
+// entries and no filter, are still read.
 
 #ifndef CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
 #define CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
 
 #include <vector>
 
+#include "base/memory/aligned_memory.h"
+#include "base/memory/scoped_ptr.h"
 #include "chrome/browser/safe_browsing/safe_browsing_util.h"
 
 namespace base {
 class FilePath;
+class MemoryMappedFile;
 }
 
 namespace safe_browsing {
@@ -62,11 +83,21 @@ namespace safe_browsing {
 class PrefixSet {
  public:
   explicit PrefixSet(const std::vector<SBPrefix>& sorted_prefixes);
+
+  // As above, with a filter in front of the set if |use_filter|.
+  PrefixSet(const std::vector<SBPrefix>& sorted_prefixes, bool use_filter);
   ~PrefixSet();
 
   // |true| if |prefix| was in |prefixes| passed to the constructor.
   bool Exists(SBPrefix prefix) const;
 
+  // Returns a new set holding the prefixes of this set and
+  // |sorted_added|, less those in |sorted_removed|.  This takes a
+  // pass over the set rather than the full list of prefixes from the
+  // store.  The new set has a filter if this one does.
+  PrefixSet* CreateUpdated(const std::vector<SBPrefix>& sorted_added,
+                           const std::vector<SBPrefix>& sorted_removed) const;
+
   // Persist the set on disk.
   static PrefixSet* LoadFile(const base::FilePath& filter_name);
   bool WriteFile(const base::FilePath& filter_name) const;
@@ -81,21 +112,61 @@ class PrefixSet {
   // for |Exists()| under control.
   static const size_t kMaxRun = 100;
 
-  // Helper for |LoadFile()|.  Steals the contents of |index| and
-  // |deltas| using |swap()|.
-  PrefixSet(std::vector<std::pair<SBPrefix,size_t> > *index,
-            std::vector<uint16> *deltas);
-
-  // Top-level index of prefix to offset in |deltas_|.  Each pair
-  // indicates a base prefix and where the deltas from that prefix
-  // begin in |deltas_|.  The deltas for a pair end at the next pair's
-  // index into |deltas_|.
-  std::vector<std::pair<SBPrefix,size_t> > index_;
-
-  // Deltas which are added to the prefix in |index_| to generate
-  // prefixes.  Deltas are only valid between consecutive items from
-  // |index_|, or the end of |deltas_| for the last |index_| pair.
-  std::vector<uint16> deltas_;
+  // Filter geometry.  Each prefix sets |kFilterHashes| bits in one
+  // block of |kFilterBlockWords| words, the size of a cache line.
+  static const size_t kFilterBitsPerPrefix = 8;
+  static const size_t kFilterBlockWords = 16;
+  static const size_t kFilterHashes = 3;
+
+  // Default constructor for |LoadFile()|, which fills in the members.
+  PrefixSet();
+
+  // Helper for the constructors.  Builds the index and deltas from
+  // |sorted_prefixes|, and the filter if |use_filter|.
+  void Init(const std::vector<SBPrefix>& sorted_prefixes, bool use_filter);
+
+  // Helpers for |LoadFile()| to fill in the set from the contents of
+  // a file of the respective version, which have been checked against
+  // the digest.  Return false if the contents are not consistent.
+  // The version 2 helper uses |mapped_file| in place and takes it
+  // over.
+  bool InitFromVersion1(const uint8* data, size_t size);
+  bool InitFromVersion2(scoped_ptr<base::MemoryMappedFile> mapped_file);
+
+  // Points the members below at the |*_storage_| vectors.
+  void UseStorage();
+
+  // Sets the filter bits for |prefix| in |filter|, which has
+  // |filter_blocks| blocks, or tests whether they are all set.
+  static void AddToFilter(SBPrefix prefix, uint32* filter,
+                          size_t filter_blocks);
+  bool FilterMayContain(SBPrefix prefix) const;
+
+  // Top-level index of the runs of deltas, as parallel arrays.  Run
+  // |i| starts with |index_prefixes_[i]| and continues with the deltas
+  // from |index_offsets_[i]| up to the next run's offset, or the end
+  // of |deltas_| for the last run.
+  const SBPrefix* index_prefixes_;
+  const uint32* index_offsets_;
+  size_t index_size_;
+
+  // Deltas which are added to the prefix of their run, and to each
+  // other, to generate the prefixes.
+  const uint16* deltas_;
+  size_t deltas_size_;
+
+  // |filter_blocks_| blocks of the filter in front of the set, or
+  // NULL if there is no filter.
+  const uint32* filter_;
+  size_t filter_blocks_;
+
+  // The members above point into either these, for a set built in
+  // memory or read from a version 1 file, or |mapped_file_|.
+  std::vector<SBPrefix> index_prefixes_storage_;
+  std::vector<uint32> index_offsets_storage_;
+  std::vector<uint16> deltas_storage_;
+  scoped_ptr_malloc<uint32, base::ScopedPtrAlignedFree> filter_storage_;
+  scoped_ptr<base::MemoryMappedFile> mapped_file_;
 
   DISALLOW_COPY_AND_ASSIGN(PrefixSet);
 };
@@ -7,25 +7,33 @@
 #include <algorithm>
 #include <iterator>
 
+#include "base/command_line.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/logging.h"
 #include "base/md5.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/rand_util.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
 namespace {
 
+// Command line switch for the number of prefixes in the benchmark.
+const char kBenchmarkPrefixes[] = "prefix-set-benchmark-prefixes";
+const int kDefaultBenchmarkPrefixes = 10000;
+
 class PrefixSetTest : public PlatformTest {
  protected:
-  // Constants for the v1 format.
+  // Constants for the v2 format.
   static const size_t kMagicOffset = 0 * sizeof(uint32);
   static const size_t kVersionOffset = 1 * sizeof(uint32);
   static const size_t kIndexSizeOffset = 2 * sizeof(uint32);
   static const size_t kDeltasSizeOffset = 3 * sizeof(uint32);
-  static const size_t kPayloadOffset = 4 * sizeof(uint32);
+  static const size_t kFilterBlocksOffset = 4 * sizeof(uint32);
+  static const size_t kPayloadOffset = 16 * sizeof(uint32);
 
   // Generate a set of random prefixes to share between tests.  For
   // most tests this generation was a large fraction of the test time.
@@ -69,12 +77,18 @@ class PrefixSetTest : public PlatformTest {
   // a temporary file, and return the filename in |filenamep|.
   // Returns |true| on success.
   bool GetPrefixSetFile(base::FilePath* filenamep) {
+    return GetPrefixSetFileWithFilter(false, filenamep);
+  }
+
+  // As above, with a filter in front of the set if |use_filter|.
+  bool GetPrefixSetFileWithFilter(bool use_filter,
+                                  base::FilePath* filenamep) {
     if (!temp_dir_.IsValid() && !temp_dir_.CreateUniqueTempDir())
       return false;
 
     base::FilePath filename = temp_dir_.path().AppendASCII("PrefixSetTest");
 
-    safe_browsing::PrefixSet prefix_set(shared_prefixes_);
+    safe_browsing::PrefixSet prefix_set(shared_prefixes_, use_filter);
     if (!prefix_set.WriteFile(filename))
       return false;
 
@@ -350,6 +364,91 @@ TEST_F(PrefixSetTest, ReadWrite) {
   }
 }
 
+// Test that the filter doesn't hide anything which is in the set.
+TEST_F(PrefixSetTest, Filter) {
+  safe_browsing::PrefixSet prefix_set(shared_prefixes_, true);
+  CheckPrefixes(prefix_set, shared_prefixes_);
+
+  // The filter is written out and mapped back in with the set.
+  base::FilePath filename;
+  ASSERT_TRUE(GetPrefixSetFileWithFilter(true, &filename));
+  scoped_ptr<safe_browsing::PrefixSet>
+      loaded_set(safe_browsing::PrefixSet::LoadFile(filename));
+  ASSERT_TRUE(loaded_set.get());
+  CheckPrefixes(*loaded_set, shared_prefixes_);
+}
+
+// Test updating a set with added and removed prefixes.
+TEST_F(PrefixSetTest, CreateUpdated) {
+  safe_browsing::PrefixSet prefix_set(shared_prefixes_, true);
+
+  // Remove every tenth prefix, and add a sorted batch of new ones,
+  // including one which is already there and one which is removed.
+  std::vector<SBPrefix> removed;
+  for (size_t i = 0; i < shared_prefixes_.size(); i += 10)
+    removed.push_back(shared_prefixes_[i]);
+  std::vector<SBPrefix> added;
+  for (size_t i = 0; i < 1000; ++i)
+    added.push_back(static_cast<SBPrefix>(base::RandUint64()));
+  added.push_back(shared_prefixes_[1]);
+  added.push_back(removed[1]);
+  std::sort(added.begin(), added.end());
+
+  std::set<SBPrefix> expected(shared_prefixes_.begin(),
+                              shared_prefixes_.end());
+  expected.insert(added.begin(), added.end());
+  for (size_t i = 0; i < removed.size(); ++i)
+    expected.erase(removed[i]);
+
+  scoped_ptr<safe_browsing::PrefixSet>
+      updated(prefix_set.CreateUpdated(added, removed));
+  CheckPrefixes(*updated,
+                std::vector<SBPrefix>(expected.begin(), expected.end()));
+  for (size_t i = 0; i < removed.size(); ++i)
+    EXPECT_FALSE(updated->Exists(removed[i]));
+}
+
+// Version 1 files, which were read into memory rather than mapped,
+// can still be read.
+TEST_F(PrefixSetTest, ReadVersion1) {
+  // Prefixes 10, 20 and 30 in one run, and 100000 in a second.
+  std::vector<SBPrefix> prefixes;
+  prefixes.push_back(10);
+  prefixes.push_back(20);
+  prefixes.push_back(30);
+  prefixes.push_back(100000);
+  std::vector<std::pair<SBPrefix,size_t> > index;
+  index.push_back(std::make_pair(10, 0));
+  index.push_back(std::make_pair(100000, 2));
+  std::vector<uint16> deltas;
+  deltas.push_back(10);
+  deltas.push_back(10);
+
+  const uint32 header[] = {
+    0x864088dd, 1, static_cast<uint32>(index.size()),
+    static_cast<uint32>(deltas.size()),
+  };
+  std::string contents(reinterpret_cast<const char*>(header),
+                       sizeof(header));
+  contents.append(reinterpret_cast<const char*>(&index[0]),
+                  index.size() * sizeof(index[0]));
+  contents.append(reinterpret_cast<const char*>(&deltas[0]),
+                  deltas.size() * sizeof(deltas[0]));
+  base::MD5Digest digest;
+  base::MD5Sum(contents.data(), contents.size(), &digest);
+  contents.append(reinterpret_cast<const char*>(&digest), sizeof(digest));
+
+  ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  base::FilePath filename = temp_dir_.path().AppendASCII("PrefixSetV1");
+  const int size = static_cast<int>(contents.size());
+  ASSERT_EQ(size, file_util::WriteFile(filename, contents.data(), size));
+
+  scoped_ptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+  CheckPrefixes(*prefix_set, prefixes);
+}
+
 // Check that |CleanChecksum()| makes an acceptable checksum.
 TEST_F(PrefixSetTest, CorruptionHelpers) {
   base::FilePath filename;
@@ -420,6 +519,18 @@ TEST_F(PrefixSetTest, CorruptionDeltasSize) {
   ASSERT_FALSE(prefix_set.get());
 }
 
+// Bad filter size is caught by the sanity check.
+TEST_F(PrefixSetTest, CorruptionFilterBlocks) {
+  base::FilePath filename;
+  ASSERT_TRUE(GetPrefixSetFileWithFilter(true, &filename));
+
+  ASSERT_NO_FATAL_FAILURE(
+      ModifyAndCleanChecksum(filename, kFilterBlocksOffset, 1));
+  scoped_ptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
+  ASSERT_FALSE(prefix_set.get());
+}
+
 // Test that the digest catches corruption in the middle of the file
 // (in the payload between the header and the digest).
 TEST_F(PrefixSetTest, CorruptionPayload) {
@@ -465,4 +576,84 @@ TEST_F(PrefixSetTest, CorruptionExcess) {
   ASSERT_FALSE(prefix_set.get());
 }
 
+// Benchmark for lookups, mostly of prefixes which are not in the set
+// as when browsing, with and without the filter, and for updating,
+// writing and loading a set. Pass 650000 prefixes for the size of the
+// browse list. Disabled by default; run with
+// --gtest_also_run_disabled_tests --prefix-set-benchmark-prefixes=N.
+TEST_F(PrefixSetTest, DISABLED_Benchmark) {
+  int prefix_count = kDefaultBenchmarkPrefixes;
+  std::string prefixes_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkPrefixes));
+  base::StringToInt(prefixes_switch, &prefix_count);
+  if (prefix_count < 1)
+    prefix_count = kDefaultBenchmarkPrefixes;
+
+  std::vector<SBPrefix> prefixes;
+  for (int i = 0; i < prefix_count; ++i)
+    prefixes.push_back(static_cast<SBPrefix>(base::RandUint64()));
+  std::sort(prefixes.begin(), prefixes.end());
+
+  // One lookup in twenty is for a prefix in the set.
+  const size_t kLookups = 4 * 1000 * 1000;
+  std::vector<SBPrefix> lookups;
+  for (size_t i = 0; i < kLookups; ++i) {
+    lookups.push_back(i % 20 ? static_cast<SBPrefix>(base::RandUint64()) :
+                      prefixes[static_cast<size_t>(
+                          base::RandGenerator(prefixes.size()))]);
+  }
+
+  ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  base::FilePath filename = temp_dir_.path().AppendASCII("PrefixSetBench");
+  printf("Benchmarking a set of %d prefixes:\n", prefix_count);
+  for (int use_filter = 0; use_filter < 2; ++use_filter) {
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    scoped_ptr<safe_browsing::PrefixSet> prefix_set(
+        new safe_browsing::PrefixSet(prefixes, use_filter != 0));
+    const double build_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+
+    start = base::TimeTicks::HighResNow();
+    size_t hits = 0;
+    for (size_t i = 0; i < lookups.size(); ++i) {
+      if (prefix_set->Exists(lookups[i]))
+        ++hits;
+    }
+    const double lookup_seconds =
+        (base::TimeTicks::HighResNow() - start).InSecondsF();
+    EXPECT_LE(kLookups / 20, hits);
+
+    // Update with a typical chunk of adds and subs.
+    std::vector<SBPrefix> added;
+    for (int i = 0; i < prefix_count / 100; ++i)
+      added.push_back(static_cast<SBPrefix>(base::RandUint64()));
+    std::sort(added.begin(), added.end());
+    std::vector<SBPrefix> removed;
+    for (size_t i = 0; i < prefixes.size(); i += 200)
+      removed.push_back(prefixes[i]);
+    start = base::TimeTicks::HighResNow();
+    prefix_set.reset(prefix_set->CreateUpdated(added, removed));
+    const double update_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+
+    start = base::TimeTicks::HighResNow();
+    ASSERT_TRUE(prefix_set->WriteFile(filename));
+    const double write_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+    prefix_set.reset();
+
+    start = base::TimeTicks::HighResNow();
+    prefix_set.reset(safe_browsing::PrefixSet::LoadFile(filename));
+    const double load_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+    ASSERT_TRUE(prefix_set.get());
+
+    printf("%s: %.1fM lookups/s, build %.1f ms, update %.1f ms, "
+           "write %.1f ms, load %.1f ms.\n",
+           use_filter ? "Filtered" : "Unfiltered",
+           kLookups / lookup_seconds / 1000000, build_ms, update_ms,
+           write_ms, load_ms);
+  }
+}
+
 }  // namespace
@@ -545,6 +545,13 @@ void SafeBrowsingDatabaseNew::Init(const base::FilePath& filename_base) {
 bool SafeBrowsingDatabaseNew::ResetDatabase() {
   DCHECK_EQ(creation_loop_, MessageLoop::current());
 
+  // The prefix set is mapped from its file, which has to be unmapped
+  // before it can be deleted on Windows.
+  {
+    base::AutoLock locked(lookup_lock_);
+    prefix_set_.reset();
+  }
+
   // Delete files on disk.
   // TODO(shess): Hard to see where one might want to delete without a
   // reset.  Perhaps inline |Delete()|?
@@ -557,7 +564,6 @@ bool SafeBrowsingDatabaseNew::ResetDatabase() {
     full_browse_hashes_.clear();
     pending_browse_hashes_.clear();
     prefix_miss_cache_.clear();
-    prefix_set_.reset();
   }
   // Wants to acquire the lock itself.
   WhitelistEverything(&csd_whitelist_);
@@ -1226,9 +1232,11 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
     prefixes.push_back(iter->prefix);
   }
 
+  // Most lookups are for prefixes which aren't in the set, which the
+  // filter turns away without searching the set.
   std::sort(prefixes.begin(), prefixes.end());
   scoped_ptr<safe_browsing::PrefixSet>
-      prefix_set(new safe_browsing::PrefixSet(prefixes));
+      prefix_set(new safe_browsing::PrefixSet(prefixes, true));
 
   // This needs to be in sorted order by prefix for efficient access.
   std::sort(add_full_hashes.begin(), add_full_hashes.end(),
@@ -1249,6 +1257,9 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
     prefix_set_.swap(prefix_set);
   }
 
+  // The old set may be mapped from the file about to be rewritten.
+  prefix_set.reset();
+
   DVLOG(1) << "SafeBrowsingDatabaseImpl built prefix set in "
            << (base::TimeTicks::Now() - before).InMilliseconds()
            << " ms total.  prefix count: " << add_prefixes.size();
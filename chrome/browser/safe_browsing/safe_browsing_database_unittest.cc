@@ -1654,6 +1654,8 @@ TEST_F(SafeBrowsingDatabaseTest, FilterFile) {
       &matching_list, &prefix_hits, &full_hashes, now));
 
   // If there is no filter file, the database cannot find malware urls.
+  // The database maps the file, so close it first.
+  database_.reset();
   file_util::Delete(filter_file, false);
   ASSERT_FALSE(file_util::PathExists(filter_file));
   database_.reset(new SafeBrowsingDatabaseNew);
@@ -17,6 +17,7 @@
 #include "base/bind_helpers.h"
 #include "base/containers/stack_container.h"
 #include "base/file_util.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/path_service.h"
@@ -58,6 +59,16 @@ const size_t VisitedLinkMaster::kBigDeleteThreshold = 64;
 
 namespace {
 
+// Number of slots of the current table copied by each task while the table
+// grows. Tables of up to this many slots are grown all at once.
+const int32 kTableMigrationChunk = 65536;
+
+// While the table grows, the current table keeps taking additions. Once it is
+// this full, the rest of it is copied at once rather than waiting for the
+// migration tasks, to stay well clear of the point where TryToAddURL starts
+// dropping URLs.
+const float kMaxMigrationTableLoad = 0.65f;
+
 // Fills the given salt structure with some quasi-random values
 // It is not necessary to generate a cryptographically strong random string,
 // only that it be reasonably different for different users.
@@ -186,7 +197,8 @@ VisitedLinkMaster::VisitedLinkMaster(content::BrowserContext* browser_context,
       delegate_(delegate),
       listener_(new VisitedLinkEventListener(
           ALLOW_THIS_IN_INITIALIZER_LIST(this), browser_context)),
-      persist_to_disk_(persist_to_disk) {
+      persist_to_disk_(persist_to_disk),
+      ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
   InitMembers();
 }
 
@@ -198,7 +210,8 @@ VisitedLinkMaster::VisitedLinkMaster(Listener* listener,
                                      int32 default_table_size)
     : browser_context_(NULL),
       delegate_(delegate),
-      persist_to_disk_(persist_to_disk) {
+      persist_to_disk_(persist_to_disk),
+      ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
   listener_.reset(listener);
   DCHECK(listener_.get());
   InitMembers();
@@ -226,13 +239,12 @@ void VisitedLinkMaster::InitMembers() {
   shared_memory_ = NULL;
   shared_memory_serial_ = 0;
   used_items_ = 0;
+  migration_table_ = NULL;
+  migration_table_length_ = 0;
+  migration_position_ = 0;
   table_size_override_ = 0;
   suppress_rebuild_ = false;
   sequence_token_ = BrowserThread::GetBlockingPool()->GetSequenceToken();
-
-#ifndef NDEBUG
-  posted_asynchronous_operation_ = false;
-#endif
 }
 
 bool VisitedLinkMaster::Init() {
@@ -282,7 +294,10 @@ VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
   if (used_items_ / 8 > table_length_ / 10)
     return null_hash_;  // Table is more than 80% full.
 
-  return AddFingerprint(fingerprint, true);
+  Hash index = AddFingerprint(fingerprint, true);
+  if (index != null_hash_ && migration_shared_memory_)
+    AddFingerprintToMigrationTable(fingerprint);
+  return index;
 }
 
 void VisitedLinkMaster::PostIOTask(const tracked_objects::Location& from_here,
@@ -321,6 +336,7 @@ void VisitedLinkMaster::DeleteAllURLs() {
   // Any pending modifications are invalid.
   added_since_rebuild_.clear();
   deleted_since_rebuild_.clear();
+  CancelTableMigration();
 
   // Clear the hash table.
   used_items_ = 0;
@@ -343,6 +359,7 @@ void VisitedLinkMaster::DeleteURLs(URLIterator* urls) {
     return;
 
   listener_->Reset();
+  CancelTableMigration();
 
   if (table_builder_) {
     // A rebuild is in progress, save this deletion in the temporary list so
@@ -544,23 +561,32 @@ bool VisitedLinkMaster::InitFromFile() {
 
   base::FilePath filename;
   GetDatabaseFileName(&filename);
-  ScopedFILE file_closer(OpenFile(filename, "rb+"));
-  if (!file_closer.get())
-    return false;
 
-  int32 num_entries, used_count;
-  if (!ReadFileHeader(file_closer.get(), &num_entries, &used_count, salt_))
-    return false;  // Header isn't valid.
+  {
+    // The mapping is closed before the file is reopened for writing below,
+    // which Windows would not allow while it is mapped for reading.
+    base::MemoryMappedFile mapped_file;
+    if (!mapped_file.Initialize(filename))
+      return false;
+
+    int32 num_entries, used_count;
+    if (!ReadFileHeader(mapped_file.data(), mapped_file.length(),
+                        &num_entries, &used_count, salt_))
+      return false;  // Header isn't valid.
+
+    // Allocate the table and copy it straight from the mapping.
+    if (!CreateURLTable(num_entries, false))
+      return false;
+    memcpy(hash_table_, mapped_file.data() + kFileHeaderSize,
+           num_entries * sizeof(Fingerprint));
+    used_items_ = used_count;
+  }
 
-  // Allocate and read the table.
-  if (!CreateURLTable(num_entries, false))
-    return false;
-  if (!ReadFromFile(file_closer.get(), kFileHeaderSize,
-                    hash_table_, num_entries * sizeof(Fingerprint))) {
+  ScopedFILE file_closer(OpenFile(filename, "rb+"));
+  if (!file_closer.get()) {
     FreeURLTable();
     return false;
   }
-  used_items_ = used_count;
 
 #ifndef NDEBUG
   DebugValidate();
@@ -601,26 +627,16 @@ bool VisitedLinkMaster::InitFromScratch(bool suppress_rebuild) {
   return RebuildTableFromDelegate();
 }
 
-bool VisitedLinkMaster::ReadFileHeader(FILE* file,
+bool VisitedLinkMaster::ReadFileHeader(const uint8* file_data,
+                                       size_t file_size,
                                        int32* num_entries,
                                        int32* used_count,
                                        uint8 salt[LINK_SALT_LENGTH]) {
   DCHECK(persist_to_disk_);
 
-  // Get file size.
-  // Note that there is no need to seek back to the original location in the
-  // file since ReadFromFile() [which is the next call accessing the file]
-  // seeks before reading.
-  if (fseek(file, 0, SEEK_END) == -1)
-    return false;
-  size_t file_size = ftell(file);
-
   if (file_size <= kFileHeaderSize)
     return false;
-
-  uint8 header[kFileHeaderSize];
-  if (!ReadFromFile(file, 0, &header, kFileHeaderSize))
-    return false;
+  const uint8* header = file_data;
 
   // Verify the signature.
   int32 signature;
@@ -638,7 +654,8 @@ bool VisitedLinkMaster::ReadFileHeader(FILE* file,
 
   // Read the table size and make sure it matches the file size.
   memcpy(num_entries, &header[kFileHeaderLengthOffset], sizeof(*num_entries));
-  if (*num_entries * sizeof(Fingerprint) + kFileHeaderSize != file_size)
+  if (*num_entries < 0 ||
+      *num_entries * sizeof(Fingerprint) + kFileHeaderSize != file_size)
     return false;  // Bad size.
 
   // Read the used item count.
@@ -671,36 +688,43 @@ bool VisitedLinkMaster::GetDatabaseFileName(base::FilePath* filename) {
 // Initializes the shared memory structure. The salt should already be filled
 // in so that it can be written to the shared memory
 bool VisitedLinkMaster::CreateURLTable(int32 num_entries, bool init_to_empty) {
+  Fingerprint* table;
+  base::SharedMemory* shared_memory =
+      CreateSharedTable(num_entries, init_to_empty, &table);
+  if (!shared_memory)
+    return false;
+
+  shared_memory_ = shared_memory;
+  hash_table_ = table;
+  table_length_ = num_entries;
+  if (init_to_empty)
+    used_items_ = 0;
+  return true;
+}
+
+base::SharedMemory* VisitedLinkMaster::CreateSharedTable(int32 num_entries,
+                                                         bool init_to_empty,
+                                                         Fingerprint** table) {
   // The table is the size of the table followed by the entries.
   uint32 alloc_size = num_entries * sizeof(Fingerprint) + sizeof(SharedHeader);
 
   // Create the shared memory object.
-  shared_memory_ = new base::SharedMemory();
-  if (!shared_memory_)
-    return false;
+  scoped_ptr<base::SharedMemory> shared_memory(new base::SharedMemory());
+  if (!shared_memory->CreateAndMapAnonymous(alloc_size))
+    return NULL;
 
-  if (!shared_memory_->CreateAndMapAnonymous(alloc_size)) {
-    delete shared_memory_;
-    shared_memory_ = NULL;
-    return false;
-  }
-
-  if (init_to_empty) {
-    memset(shared_memory_->memory(), 0, alloc_size);
-    used_items_ = 0;
-  }
-  table_length_ = num_entries;
+  if (init_to_empty)
+    memset(shared_memory->memory(), 0, alloc_size);
 
   // Save the header for other processes to read.
-  SharedHeader* header = static_cast<SharedHeader*>(shared_memory_->memory());
-  header->length = table_length_;
+  SharedHeader* header = static_cast<SharedHeader*>(shared_memory->memory());
+  header->length = num_entries;
   memcpy(header->salt, salt_, LINK_SALT_LENGTH);
 
-  // Our table pointer is just the data immediately following the size.
-  hash_table_ = reinterpret_cast<Fingerprint*>(
-      static_cast<char*>(shared_memory_->memory()) + sizeof(SharedHeader));
-
-  return true;
+  // The table is just the data immediately following the size.
+  *table = reinterpret_cast<Fingerprint*>(
+      static_cast<char*>(shared_memory->memory()) + sizeof(SharedHeader));
+  return shared_memory.release();
 }
 
 bool VisitedLinkMaster::BeginReplaceURLTable(int32 num_entries) {
@@ -737,6 +761,15 @@ void VisitedLinkMaster::FreeURLTable() {
 bool VisitedLinkMaster::ResizeTableIfNecessary() {
   DCHECK(table_length_ > 0) << "Must have a table";
 
+  if (migration_shared_memory_) {
+    // The table is already growing. Only step in if the current table is
+    // filling up faster than the migration tasks copy it.
+    if (ComputeTableLoad() < kMaxMigrationTableLoad)
+      return false;
+    FinishTableMigration();
+    return true;
+  }
+
   // Load limits for good performance/space. We are pretty conservative about
   // keeping the table not very full. This is because we use linear probing
   // which increases the likelihood of clumps of entries which will reduce
@@ -754,6 +787,11 @@ bool VisitedLinkMaster::ResizeTableIfNecessary() {
   int new_size = NewTableSizeForCount(used_items_);
   DCHECK(new_size > used_items_);
   DCHECK(load <= min_table_load || new_size > table_length_);
+  if (new_size > table_length_) {
+    // The new table has only been written to disk if the migration finished
+    // right away.
+    return BeginTableMigration(new_size) && !migration_shared_memory_;
+  }
   ResizeTable(new_size);
   return true;
 }
@@ -797,6 +835,97 @@ void VisitedLinkMaster::ResizeTable(int32 new_size) {
     WriteFullTable();
 }
 
+bool VisitedLinkMaster::BeginTableMigration(int32 new_size) {
+  DCHECK(!migration_shared_memory_);
+  migration_shared_memory_.reset(
+      CreateSharedTable(new_size, true, &migration_table_));
+  if (!migration_shared_memory_)
+    return false;
+  migration_table_length_ = new_size;
+  migration_position_ = 0;
+
+  // Small tables are copied right away.
+  MigrateTableChunk();
+  return true;
+}
+
+void VisitedLinkMaster::MigrateTableChunk() {
+  DCHECK(migration_shared_memory_);
+  if (table_length_ - migration_position_ <= kTableMigrationChunk) {
+    FinishTableMigration();
+    return;
+  }
+
+  int32 end = migration_position_ + kTableMigrationChunk;
+  for (; migration_position_ < end; migration_position_++) {
+    Fingerprint cur = hash_table_[migration_position_];
+    if (cur)
+      AddFingerprintToMigrationTable(cur);
+  }
+
+  BrowserThread::PostTask(
+      BrowserThread::UI, FROM_HERE,
+      base::Bind(&VisitedLinkMaster::MigrateTableChunk,
+                 weak_ptr_factory_.GetWeakPtr()));
+}
+
+void VisitedLinkMaster::FinishTableMigration() {
+  DCHECK(migration_shared_memory_);
+  weak_ptr_factory_.InvalidateWeakPtrs();
+
+  for (; migration_position_ < table_length_; migration_position_++) {
+    Fingerprint cur = hash_table_[migration_position_];
+    if (cur)
+      AddFingerprintToMigrationTable(cur);
+  }
+
+  // Everything in the current table, including what was added during the
+  // migration, is now in the new table, so |used_items_| stays the same.
+  shared_memory_serial_++;
+  delete shared_memory_;
+  shared_memory_ = migration_shared_memory_.release();
+  hash_table_ = migration_table_;
+  table_length_ = migration_table_length_;
+  migration_table_ = NULL;
+  migration_table_length_ = 0;
+
+#ifndef NDEBUG
+  DebugValidate();
+#endif
+
+  // Send an update notification to all child processes so they read the new
+  // table.
+  listener_->NewTable(shared_memory_);
+
+  // The new table needs to be written to disk.
+  if (persist_to_disk_)
+    WriteFullTable();
+}
+
+void VisitedLinkMaster::CancelTableMigration() {
+  if (!migration_shared_memory_)
+    return;
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  migration_shared_memory_.reset();
+  migration_table_ = NULL;
+  migration_table_length_ = 0;
+}
+
+void VisitedLinkMaster::AddFingerprintToMigrationTable(
+    Fingerprint fingerprint) {
+  // The new table is at most about a third full, so this always finds a free
+  // slot. See AddFingerprint for the probing.
+  Hash cur_hash = HashFingerprint(fingerprint, migration_table_length_);
+  while (migration_table_[cur_hash] != null_fingerprint_) {
+    if (migration_table_[cur_hash] == fingerprint)
+      return;  // Already copied.
+    cur_hash++;
+    if (cur_hash == migration_table_length_)
+      cur_hash = 0;
+  }
+  migration_table_[cur_hash] = fingerprint;
+}
+
 uint32 VisitedLinkMaster::NewTableSizeForCount(int32 item_count) const {
   // These table sizes are selected to be the maximum prime number less than
   // a "convenient" multiple of 1K.
@@ -844,6 +973,9 @@ void VisitedLinkMaster::OnTableRebuildComplete(
     bool success,
     const std::vector<Fingerprint>& fingerprints) {
   if (success) {
+    // The rebuilt table replaces any table we were growing into.
+    CancelTableMigration();
+
     // Replace the old table with a new blank one.
     shared_memory_serial_++;
 
@@ -893,9 +1025,6 @@ void VisitedLinkMaster::WriteToFile(FILE** file,
                                     void* data,
                                     int32 data_size) {
   DCHECK(persist_to_disk_);
-#ifndef NDEBUG
-  posted_asynchronous_operation_ = true;
-#endif
   PostIOTask(FROM_HERE,
       base::Bind(&AsyncWrite, file, offset,
                  std::string(static_cast<const char*>(data), data_size)));
@@ -930,24 +1059,6 @@ void VisitedLinkMaster::WriteHashRangeToFile(Hash first_hash, Hash last_hash) {
   }
 }
 
-bool VisitedLinkMaster::ReadFromFile(FILE* file,
-                                     off_t offset,
-                                     void* data,
-                                     size_t data_size) {
-  DCHECK(persist_to_disk_);
-#ifndef NDEBUG
-  // Since this function is synchronous, we require that no asynchronous
-  // operations could possibly be pending.
-  DCHECK(!posted_asynchronous_operation_);
-#endif
-
-  if (fseek(file, offset, SEEK_SET) != 0)
-    return false;
-
-  size_t num_read = fread(data, 1, data_size, file);
-  return num_read == data_size;
-}
-
 // VisitedLinkTableBuilder ----------------------------------------------------
 
 VisitedLinkMaster::TableBuilder::TableBuilder(
@@ -15,6 +15,8 @@
 #include "base/callback_forward.h"
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
 #include "base/shared_memory.h"
 #include "base/threading/sequenced_worker_pool.h"
 #include "components/visitedlink/common/visitedlink_common.h"
@@ -159,6 +161,8 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, Delete);
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, BigDelete);
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, BigImport);
+  FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, IncrementalResize);
+  FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, DeleteDuringIncrementalResize);
 
   // Object to rebuild the table on the history thread (see the .cc file).
   class TableBuilder;
@@ -208,17 +212,18 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   void WriteFullTable();
 
   // Try to load the table from the database file. If the file doesn't exist or
-  // is corrupt, this will return failure.
+  // is corrupt, this will return failure. The file is mapped into memory and
+  // the table copied from it in one go, rather than read through stdio.
   bool InitFromFile();
 
-  // Reads the header of the link coloring database from disk. Assumes the
-  // file pointer is at the beginning of the file and that there are no pending
-  // asynchronous I/O operations.
+  // Parses the header of the link coloring database from |file_data|, the
+  // |file_size| bytes of the mapped database file.
   //
   // Returns true on success and places the size of the table in num_entries
   // and the number of nonzero fingerprints in used_count. This will fail if
   // the version of the file is not the current version of the database.
-  bool ReadFileHeader(FILE* hfile, int32* num_entries, int32* used_count,
+  bool ReadFileHeader(const uint8* file_data, size_t file_size,
+                      int32* num_entries, int32* used_count,
                       uint8 salt[LINK_SALT_LENGTH]);
 
   // Fills *filename with the name of the link database filename
@@ -237,10 +242,6 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // wrap around at 0 and this function will handle it.
   void WriteHashRangeToFile(Hash first_hash, Hash last_hash);
 
-  // Synchronous read from the file. Assumes there are no pending asynchronous
-  // I/O functions. Returns true if the entire buffer was successfully filled.
-  bool ReadFromFile(FILE* hfile, off_t offset, void* data, size_t data_size);
-
   // General table handling
   // ----------------------
 
@@ -276,6 +277,13 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // a file).
   bool CreateURLTable(int32 num_entries, bool init_to_empty);
 
+  // Allocates a shared memory table of |num_entries| with its header filled
+  // in, and places a pointer to the first entry in |*table|. The entries are
+  // zeroed if |init_to_empty| is set. Returns NULL on failure.
+  base::SharedMemory* CreateSharedTable(int32 num_entries,
+                                        bool init_to_empty,
+                                        Fingerprint** table);
+
   // A wrapper for CreateURLTable, this will allocate a new table, initialized
   // to empty. The caller is responsible for saving the shared memory pointer
   // and handles before this call (they will be replaced with new ones) and
@@ -296,9 +304,39 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   bool ResizeTableIfNecessary();
 
   // Resizes the table (growing or shrinking) as necessary to accomodate the
-  // current count.
+  // current count. This copies the whole table at once, see
+  // BeginTableMigration for how the table is grown.
   void ResizeTable(int32 new_size);
 
+  // Incremental growing
+  // -------------------
+  // Growing a large table means rehashing millions of fingerprints, which
+  // would block the UI thread. Instead, a larger table is allocated and the
+  // fingerprints are copied to it a chunk at a time from tasks posted to the
+  // UI thread. Meanwhile the current table stays in use by us and the slaves,
+  // and added fingerprints go to both tables. Once every slot is copied, the
+  // new table replaces the current one and is sent to the slaves.
+
+  // Allocates a table of |new_size| entries and starts copying to it. Returns
+  // false if the table could not be allocated.
+  bool BeginTableMigration(int32 new_size);
+
+  // Copies the next chunk of the current table, then posts a task to copy
+  // the following one or finishes the migration if nothing is left.
+  void MigrateTableChunk();
+
+  // Copies what is left of the current table and replaces it with the new
+  // one, notifying the slaves and writing the new table to disk.
+  void FinishTableMigration();
+
+  // Drops a migration in progress. Deletions don't update the new table, so
+  // they cancel the migration instead; the next addition restarts it.
+  void CancelTableMigration();
+
+  // Adds |fingerprint| to the table being migrated to, if it is not already
+  // there.
+  void AddFingerprintToMigrationTable(Fingerprint fingerprint);
+
   // Returns the desired table size for |item_count| URLs.
   uint32 NewTableSizeForCount(int32 item_count) const;
 
@@ -337,15 +375,6 @@ class VisitedLinkMaster : public VisitedLinkCommon {
     return hash - 1;
   }
 
-#ifndef NDEBUG
-  // Indicates whether any asynchronous operation has ever been completed.
-  // We do some synchronous reads that require that no asynchronous operations
-  // are pending, yet we don't track whether they have been completed. This
-  // flag is a sanity check that these reads only happen before any
-  // asynchronous writes have been fired.
-  bool posted_asynchronous_operation_;
-#endif
-
   // Reference to the browser context that this object belongs to
   // (it knows the path to where the data is stored)
   content::BrowserContext* browser_context_;
@@ -400,6 +429,15 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // Number of non-empty items in the table, used to compute fullness.
   int32 used_items_;
 
+  // While the table is being grown, the shared memory holding the new table,
+  // its entries and length, and the index of the next slot of the current
+  // table to copy to it. |migration_shared_memory_| is NULL otherwise. See
+  // BeginTableMigration.
+  scoped_ptr<base::SharedMemory> migration_shared_memory_;
+  Fingerprint* migration_table_;
+  int32 migration_table_length_;
+  int32 migration_position_;
+
   // Testing values -----------------------------------------------------------
   //
   // The following fields exist for testing purposes. They are not used in
@@ -423,6 +461,9 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // will be false in production.
   bool suppress_rebuild_;
 
+  // Used for the tasks copying the table while it grows.
+  base::WeakPtrFactory<VisitedLinkMaster> weak_ptr_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(VisitedLinkMaster);
 };
 
@@ -8,15 +8,21 @@
 
 #include "base/file_util.h"
 #include "base/files/file_path.h"
+#include "base/message_loop.h"
 #include "base/perftimer.h"
 #include "base/shared_memory.h"
 #include "base/stringprintf.h"
 #include "base/test/test_file_util.h"
+#include "base/time.h"
 #include "components/visitedlink/browser/visitedlink_master.h"
+#include "content/public/browser/browser_thread.h"
+#include "content/public/test/test_browser_thread.h"
 #include "googleurl/src/gurl.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::TimeDelta;
+using base::TimeTicks;
+using content::BrowserThread;
 
 namespace components {
 
@@ -25,6 +31,10 @@ namespace {
 // how we generate URLs, note that the two strings should be the same length
 const int add_count = 10000;
 const int load_test_add_count = 250000;
+const int big_table_add_count = 1000000;
+
+// While filling the big table, the UI thread goes idle after this many adds.
+const int big_table_adds_per_idle = 100;
 const char added_prefix[] = "http://www.google.com/stuff/something/foo?session=85025602345625&id=1345142319023&seq=";
 const char unadded_prefix[] = "http://www.google.org/stuff/something/foo?session=39586739476365&id=2347624314402&seq=";
 
@@ -201,4 +211,79 @@ TEST_F(VisitedLink, TestLoad) {
                 hot_sum / hot_load_times.size(), "ms");
 }
 
+// Tests a history of 1M URLs: the longest the UI thread is blocked while
+// the table grows, how long the table takes to load at startup, and how long
+// a single lookup takes.
+TEST_F(VisitedLink, TestBigTable) {
+  // The table grows from tasks on the UI thread.
+  MessageLoop message_loop;
+  content::TestBrowserThread ui_thread(BrowserThread::UI, &message_loop);
+
+  {
+    VisitedLinkMaster master(DummyVisitedLinkEventListener::GetInstance(),
+                             NULL, true, true, db_path_, 0);
+    ASSERT_TRUE(master.Init());
+
+    // Adds come in between idle periods, as they do while browsing.
+    TimeDelta max_add_time;
+    TimeDelta max_idle_time;
+    PerfTimeLogger fill_timer("Visited_link_1M_fill");
+    for (int i = 0; i < big_table_add_count; i++) {
+      TimeTicks start = TimeTicks::HighResNow();
+      master.AddURL(TestURL(added_prefix, i));
+      max_add_time = std::max(max_add_time, TimeTicks::HighResNow() - start);
+
+      if (i % big_table_adds_per_idle == 0) {
+        start = TimeTicks::HighResNow();
+        message_loop.RunUntilIdle();
+        max_idle_time =
+            std::max(max_idle_time, TimeTicks::HighResNow() - start);
+      }
+    }
+    message_loop.RunUntilIdle();
+    fill_timer.Done();
+    LogPerfResult("Visited_link_1M_max_add_time",
+                  max_add_time.InMillisecondsF(), "ms");
+    LogPerfResult("Visited_link_1M_max_idle_time",
+                  max_idle_time.InMillisecondsF(), "ms");
+
+    master.RewriteFile();
+  }
+  BrowserThread::GetBlockingPool()->FlushForTesting();
+
+  // Startup with the file in the OS cache.
+  PerfTimer load_timer;
+  VisitedLinkMaster master(DummyVisitedLinkEventListener::GetInstance(),
+                           NULL, true, true, db_path_, 0);
+  ASSERT_TRUE(master.Init());
+  LogPerfResult("Visited_link_1M_hot_load_time",
+                load_timer.Elapsed().InMillisecondsF(), "ms");
+  ASSERT_EQ(big_table_add_count, master.GetUsedCount());
+
+  // Half the lookups find their URL, the other half don't. The URLs are
+  // fingerprinted up front so that only the table lookup is timed.
+  std::vector<VisitedLinkCommon::Fingerprint> fingerprints;
+  fingerprints.reserve(2 * big_table_add_count);
+  for (int i = 0; i < big_table_add_count; i++) {
+    std::string added = TestURL(added_prefix, i).spec();
+    fingerprints.push_back(
+        master.ComputeURLFingerprint(added.data(), added.size()));
+    std::string unadded = TestURL(unadded_prefix, i).spec();
+    fingerprints.push_back(
+        master.ComputeURLFingerprint(unadded.data(), unadded.size()));
+  }
+
+  int visited = 0;
+  PerfTimer lookup_timer;
+  for (size_t i = 0; i < fingerprints.size(); i++) {
+    if (master.IsVisited(fingerprints[i]))
+      visited++;
+  }
+  TimeDelta lookup_time = lookup_timer.Elapsed();
+  EXPECT_EQ(big_table_add_count, visited);
+  LogPerfResult("Visited_link_1M_lookup_time",
+                lookup_time.InMicroseconds() * 1000.0 / fingerprints.size(),
+                "ns");
+}
+
 }  // namespace components
@@ -404,6 +404,88 @@ TEST_F(VisitedLinkTest, Resizing) {
   Reload();
 }
 
+// Tests that growing a large table copies it in the background while the
+// slaves keep using the current table, and that they switch to the new table
+// once the copy is done.
+TEST_F(VisitedLinkTest, IncrementalResize) {
+  // A table larger than one migration chunk, filled to just over half.
+  const int32 initial_size = 130051;
+  const int url_count = initial_size / 2 + 1;
+  ASSERT_TRUE(InitVisited(initial_size, true));
+
+  VisitedLinkSlave slave;
+  base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
+  master_->shared_memory()->ShareToProcess(
+      base::GetCurrentProcessHandle(), &new_handle);
+  slave.OnUpdateVisitedLinks(new_handle);
+  g_slaves.push_back(&slave);
+
+  URLs urls;
+  for (int i = 0; i < url_count; i++)
+    urls.push_back(TestURL(i));
+  master_->AddURLs(urls);
+  ASSERT_TRUE(master_->migration_shared_memory_.get());
+
+  // URLs added while the table grows are visible right away.
+  master_->AddURL(TestURL(url_count));
+  EXPECT_TRUE(slave.IsVisited(TestURL(0)));
+  EXPECT_TRUE(slave.IsVisited(TestURL(url_count)));
+
+  int32 table_size;
+  VisitedLinkCommon::Fingerprint* table;
+  master_->GetUsageStatistics(&table_size, &table);
+  EXPECT_EQ(initial_size, table_size);
+
+  // Let the migration tasks run.
+  message_loop_.RunUntilIdle();
+  EXPECT_FALSE(master_->migration_shared_memory_.get());
+  master_->DebugValidate();
+  EXPECT_EQ(url_count + 1, master_->GetUsedCount());
+
+  master_->GetUsageStatistics(&table_size, &table);
+  EXPECT_GT(table_size, initial_size);
+  int32 child_table_size;
+  VisitedLinkCommon::Fingerprint* child_table;
+  slave.GetUsageStatistics(&child_table_size, &child_table);
+  ASSERT_EQ(table_size, child_table_size);
+  for (int i = 0; i <= url_count; i++)
+    ASSERT_TRUE(slave.IsVisited(TestURL(i))) << "URL " << i;
+
+  g_slaves.clear();
+}
+
+// Tests that deleting URLs while the table grows cancels the migration, and
+// that the next addition starts it again.
+TEST_F(VisitedLinkTest, DeleteDuringIncrementalResize) {
+  const int32 initial_size = 130051;
+  const int url_count = initial_size / 2 + 1;
+  ASSERT_TRUE(InitVisited(initial_size, true));
+
+  URLs urls;
+  for (int i = 0; i < url_count; i++)
+    urls.push_back(TestURL(i));
+  master_->AddURLs(urls);
+  ASSERT_TRUE(master_->migration_shared_memory_.get());
+
+  URLs urls_to_delete;
+  urls_to_delete.push_back(TestURL(0));
+  TestURLIterator iterator(urls_to_delete);
+  master_->DeleteURLs(&iterator);
+  EXPECT_FALSE(master_->migration_shared_memory_.get());
+  EXPECT_FALSE(master_->IsVisited(TestURL(0)));
+
+  master_->AddURL(TestURL(url_count));
+  master_->AddURL(TestURL(url_count + 1));
+  ASSERT_TRUE(master_->migration_shared_memory_.get());
+  message_loop_.RunUntilIdle();
+  EXPECT_FALSE(master_->migration_shared_memory_.get());
+  master_->DebugValidate();
+
+  EXPECT_FALSE(master_->IsVisited(TestURL(0)));
+  for (int i = 1; i < url_count + 2; i++)
+    ASSERT_TRUE(master_->IsVisited(TestURL(i))) << "URL " << i;
+}
+
 // Tests that if the database doesn't exist, it will be rebuilt from history.
 TEST_F(VisitedLinkTest, Rebuild) {
   // Add half of our URLs to history. This needs to be done before we
@@ -15,6 +15,7 @@
 #include "googleurl/src/gurl.h"
 #include "webkit/dom_storage/dom_storage_area.h"
 #include "webkit/dom_storage/dom_storage_host.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 #include "webkit/dom_storage/dom_storage_task_runner.h"
 
 using dom_storage::DomStorageTaskRunner;
@@ -108,13 +109,22 @@ void DOMStorageMessageFilter::OnCloseStorageArea(int connection_id) {
   host_->CloseStorageArea(connection_id);
 }
 
-void DOMStorageMessageFilter::OnLoadStorageArea(int connection_id,
-                                                dom_storage::ValuesMap* map) {
+void DOMStorageMessageFilter::OnLoadStorageArea(
+    int connection_id,
+    base::SharedMemoryHandle* snapshot_handle,
+    uint32* snapshot_size) {
   DCHECK(!BrowserThread::CurrentlyOn(BrowserThread::IO));
-  if (!host_->ExtractAreaValues(connection_id, map)) {
+  *snapshot_handle = base::SharedMemory::NULLHandle();
+  *snapshot_size = 0;
+  scoped_refptr<dom_storage::DomStorageSnapshot> snapshot;
+  if (!host_->GetAreaSnapshot(connection_id, &snapshot)) {
     RecordAction(UserMetricsAction("BadMessageTerminate_DSMF_2"));
     BadMessageReceived();
   }
+  // The snapshot is shared by every renderer loading this version of the
+  // area, each gets its own handle to it.
+  if (snapshot && snapshot->ShareToProcess(peer_handle(), snapshot_handle))
+    *snapshot_size = static_cast<uint32>(snapshot->size());
   Send(new DOMStorageMsg_AsyncOperationComplete(true));
 }
 
@@ -208,6 +218,7 @@ void DOMStorageMessageFilter::SendDomStorageEvent(
     params.new_value = new_value;
     params.old_value = old_value;
     params.namespace_id = area->namespace_id();
+    params.version = area->version();
     Send(new DOMStorageMsg_Event(params));
   }
 }
@@ -7,6 +7,7 @@
 
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/shared_memory.h"
 #include "content/public/browser/browser_message_filter.h"
 #include "third_party/WebKit/Source/Platform/chromium/public/WebStorageArea.h"
 #include "webkit/dom_storage/dom_storage_context.h"
@@ -50,7 +51,9 @@ class DOMStorageMessageFilter
   void OnOpenStorageArea(int connection_id, int64 namespace_id,
                          const GURL& origin);
   void OnCloseStorageArea(int connection_id);
-  void OnLoadStorageArea(int connection_id, dom_storage::ValuesMap* map);
+  void OnLoadStorageArea(int connection_id,
+                         base::SharedMemoryHandle* snapshot_handle,
+                         uint32* snapshot_size);
   void OnSetItem(int connection_id, const string16& key,
                  const string16& value, const GURL& page_url);
   void OnRemoveItem(int connection_id, const string16& key,
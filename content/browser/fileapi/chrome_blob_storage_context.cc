@@ -16,6 +16,12 @@ namespace content {
 
 static const char* kBlobStorageContextKeyName = "content_blob_storage_context";
 
+static const base::FilePath::CharType kBlobStorageDirectory[] =
+    FILE_PATH_LITERAL("Blob Storage");
+
+// Blob bytes held in memory before they start spilling to disk.
+static const int64 kBlobInMemoryLimit = 200 * 1024 * 1024;
+
 ChromeBlobStorageContext::ChromeBlobStorageContext() {}
 
 ChromeBlobStorageContext* ChromeBlobStorageContext::GetFor(
@@ -25,11 +31,16 @@ ChromeBlobStorageContext* ChromeBlobStorageContext::GetFor(
         new ChromeBlobStorageContext();
     context->SetUserData(kBlobStorageContextKeyName,
                          new UserDataAdapter<ChromeBlobStorageContext>(blob));
+    // Off the record blobs never touch the disk.
+    base::FilePath spill_directory;
+    if (!context->IsOffTheRecord())
+      spill_directory = context->GetPath().Append(kBlobStorageDirectory);
     // Check first to avoid memory leak in unittests.
     if (BrowserThread::IsMessageLoopValid(BrowserThread::IO)) {
       BrowserThread::PostTask(
           BrowserThread::IO, FROM_HERE,
-          base::Bind(&ChromeBlobStorageContext::InitializeOnIOThread, blob));
+          base::Bind(&ChromeBlobStorageContext::InitializeOnIOThread, blob,
+                     spill_directory));
     }
   }
 
@@ -37,9 +48,16 @@ ChromeBlobStorageContext* ChromeBlobStorageContext::GetFor(
       context, kBlobStorageContextKeyName);
 }
 
-void ChromeBlobStorageContext::InitializeOnIOThread() {
+void ChromeBlobStorageContext::InitializeOnIOThread(
+    const base::FilePath& spill_directory) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   controller_.reset(new BlobStorageController());
+  if (!spill_directory.empty()) {
+    controller_->EnableDiskSpill(
+        spill_directory,
+        BrowserThread::GetMessageLoopProxyForThread(BrowserThread::FILE).get(),
+        kBlobInMemoryLimit);
+  }
 }
 
 ChromeBlobStorageContext::~ChromeBlobStorageContext() {}
@@ -5,6 +5,7 @@
 #ifndef CONTENT_BROWSER_FILEAPI_CHROME_BLOB_STORAGE_CONTEXT_H_
 #define CONTENT_BROWSER_FILEAPI_CHROME_BLOB_STORAGE_CONTEXT_H_
 
+#include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/sequenced_task_runner_helpers.h"
@@ -34,7 +35,9 @@ class CONTENT_EXPORT ChromeBlobStorageContext
   static ChromeBlobStorageContext* GetFor(
       BrowserContext* browser_context);
 
-  void InitializeOnIOThread();
+  // Blob bytes spill to temporary files in |spill_directory| once they
+  // exceed a memory budget, they're kept in memory if it's empty.
+  void InitializeOnIOThread(const base::FilePath& spill_directory);
 
   webkit_blob::BlobStorageController* controller() const {
     return controller_.get();
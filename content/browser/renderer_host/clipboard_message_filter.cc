@@ -12,7 +12,6 @@
 #include "googleurl/src/gurl.h"
 #include "ipc/ipc_message_macros.h"
 #include "third_party/skia/include/core/SkBitmap.h"
-#include "third_party/zlib/zlib.h"
 #include "ui/gfx/codec/png_codec.h"
 #include "ui/gfx/size.h"
 
@@ -223,14 +222,14 @@ void ClipboardMessageFilter::OnReadImageReply(
   if (!bitmap.isNull()) {
     std::vector<unsigned char> png_data;
     SkAutoLockPixels lock(bitmap);
-    if (gfx::PNGCodec::EncodeWithCompressionLevel(
+    if (gfx::PNGCodec::EncodeWithSpeed(
             static_cast<const unsigned char*>(bitmap.getPixels()),
             gfx::PNGCodec::FORMAT_BGRA,
             gfx::Size(bitmap.width(), bitmap.height()),
             bitmap.rowBytes(),
             false,
             std::vector<gfx::PNGCodec::Comment>(),
-            Z_BEST_SPEED,
+            gfx::PNGCodec::SPEED_FAST,
             &png_data)) {
       base::SharedMemory buffer;
       if (buffer.CreateAndMapAnonymous(png_data.size())) {
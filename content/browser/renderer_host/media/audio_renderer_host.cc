@@ -15,6 +15,7 @@
 #include "content/common/media/audio_messages.h"
 #include "content/public/browser/content_browser_client.h"
 #include "content/public/browser/media_observer.h"
+#include "media/audio/shared_memory_ring.h"
 #include "media/audio/shared_memory_util.h"
 #include "media/base/audio_bus.h"
 #include "media/base/limits.h"
@@ -39,6 +40,9 @@ struct AudioRendererHost::AudioEntry {
   // Shared memory for transmission of the audio data.
   base::SharedMemory shared_memory;
 
+  // Size of the audio packets in |shared_memory|, as reported to the renderer.
+  uint32 packets_size;
+
   // The synchronous reader to be used by the controller. We have the
   // ownership of the reader.
   scoped_ptr<media::AudioOutputController::SyncReader> reader;
@@ -50,6 +54,7 @@ struct AudioRendererHost::AudioEntry {
 AudioRendererHost::AudioEntry::AudioEntry()
     : stream_id(0),
       render_view_id(MSG_ROUTING_NONE),
+      packets_size(0),
       pending_close(false) {
 }
 
@@ -182,7 +187,7 @@ void AudioRendererHost::DoCompleteCreation(
       entry->stream_id,
       foreign_memory_handle,
       foreign_socket_handle,
-      media::PacketSizeInBytes(entry->shared_memory.created_size())));
+      entry->packets_size));
 }
 
 void AudioRendererHost::DoSendPlayingMessage(
@@ -254,12 +259,15 @@ bool AudioRendererHost::OnMessageReceived(const IPC::Message& message,
 }
 
 void AudioRendererHost::OnCreateStream(
-    int stream_id, const media::AudioParameters& params) {
+    int stream_id, const media::AudioParameters& params, int ring_slots) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   // media::AudioParameters is validated in the deserializer.
   int input_channels = params.input_channels();
   if (input_channels < 0 ||
       input_channels > media::limits::kMaxChannels ||
+      ring_slots < 1 ||
+      ring_slots > media::limits::kMaxAudioRingSlots ||
+      (ring_slots > 1 && input_channels > 0) ||
       LookupById(stream_id) != NULL) {
     SendErrorMessage(stream_id);
     return;
@@ -281,8 +289,12 @@ void AudioRendererHost::OnCreateStream(
   // extra memory after the output data for the input data.
   uint32 io_buffer_size = output_memory_size + input_memory_size;
 
-  uint32 shared_memory_size =
+  // A ring of several packets lets the renderer render ahead, so that the
+  // controller does not have to wait on it for every packet.
+  uint32 shared_memory_size = ring_slots > 1 ?
+      media::SharedMemoryRing::TotalSizeInBytes(io_buffer_size, ring_slots) :
       media::TotalSharedMemorySizeInBytes(io_buffer_size);
+  entry->packets_size = io_buffer_size * ring_slots;
   if (!entry->shared_memory.CreateAndMapAnonymous(shared_memory_size)) {
     // If creation of shared memory failed then send an error message.
     SendErrorMessage(stream_id);
@@ -290,8 +302,8 @@ void AudioRendererHost::OnCreateStream(
   }
 
   // Create sync reader and try to initialize it.
-  scoped_ptr<AudioSyncReader> reader(
-      new AudioSyncReader(&entry->shared_memory, params, input_channels));
+  scoped_ptr<AudioSyncReader> reader(new AudioSyncReader(
+      &entry->shared_memory, params, input_channels, ring_slots));
 
   if (!reader->Init()) {
     SendErrorMessage(stream_id);
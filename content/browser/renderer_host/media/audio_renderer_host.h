@@ -107,9 +107,11 @@ class CONTENT_EXPORT AudioRendererHost
   // Audio related IPC message handlers.
   // Creates an audio output stream with the specified format. If this call is
   // successful this object would keep an internal entry of the stream for the
-  // required properties.
+  // required properties.  Audio is passed through a SharedMemoryRing if
+  // |ring_slots| is larger than one.
   void OnCreateStream(int stream_id,
-                      const media::AudioParameters& params);
+                      const media::AudioParameters& params,
+                      int ring_slots);
 
   // Track that the data for the audio stream referenced by |stream_id| is
   // produced by an entity in the render view referenced by |render_view_id|.
@@ -11,6 +11,7 @@
 #include "base/shared_memory.h"
 #include "media/audio/audio_buffers_state.h"
 #include "media/audio/audio_parameters.h"
+#include "media/audio/shared_memory_ring.h"
 #include "media/audio/shared_memory_util.h"
 
 using media::AudioBus;
@@ -19,11 +20,23 @@ namespace content {
 
 AudioSyncReader::AudioSyncReader(base::SharedMemory* shared_memory,
                                  const media::AudioParameters& params,
-                                 int input_channels)
+                                 int input_channels,
+                                 int ring_slots)
     : shared_memory_(shared_memory),
       input_channels_(input_channels),
       renderer_callback_count_(0),
       renderer_missed_callback_count_(0) {
+  if (ring_slots > 1) {
+    DCHECK_EQ(input_channels_, 0);
+    packet_size_ = AudioBus::CalculateMemorySize(params);
+    ring_.reset(new media::SharedMemoryRing(
+        shared_memory_->memory(), packet_size_, ring_slots));
+    ring_buses_.reset(new scoped_ptr<AudioBus>[ring_slots]);
+    for (int i = 0; i < ring_slots; ++i)
+      ring_buses_[i] = AudioBus::WrapMemory(params, ring_->Packet(i));
+    return;
+  }
+
   packet_size_ = media::PacketSizeInBytes(shared_memory_->created_size());
   int input_memory_size = 0;
   int output_memory_size = AudioBus::CalculateMemorySize(params);
@@ -52,12 +65,19 @@ AudioSyncReader::~AudioSyncReader() {
 }
 
 bool AudioSyncReader::DataReady() {
+  if (ring_.get())
+    return ring_->AvailableToRead() > 0;
   return !media::IsUnknownDataSize(shared_memory_, packet_size_);
 }
 
 // media::AudioOutputController::SyncReader implementations.
 void AudioSyncReader::UpdatePendingBytes(uint32 bytes) {
-  if (bytes != static_cast<uint32>(media::kPauseMark)) {
+  if (ring_.get()) {
+    // The stream has stopped pulling, so drop what the renderer rendered
+    // ahead; it must not be played after a seek or a pause.
+    if (bytes == static_cast<uint32>(media::kPauseMark))
+      ring_->Clear();
+  } else if (bytes != static_cast<uint32>(media::kPauseMark)) {
     // Store unknown length of data into buffer, so we later
     // can find out if data became available.
     media::SetUnknownDataSize(shared_memory_, packet_size_);
@@ -73,6 +93,9 @@ int AudioSyncReader::Read(AudioBus* source, AudioBus* dest) {
   if (!DataReady())
     ++renderer_missed_callback_count_;
 
+  if (ring_.get())
+    return ReadFromRing(dest);
+
   // Copy optional synchronized live audio input for consumption by renderer
   // process.
   if (source && input_bus_.get()) {
@@ -118,6 +141,25 @@ int AudioSyncReader::Read(AudioBus* source, AudioBus* dest) {
   return frames;
 }
 
+int AudioSyncReader::ReadFromRing(AudioBus* dest) {
+  // On underrun play silence rather than waiting for the renderer; the next
+  // UpdatePendingBytes() asks it to catch up.
+  if (ring_->AvailableToRead() == 0) {
+    dest->Zero();
+    return dest->frames();
+  }
+
+  AudioBus* packet = ring_buses_[ring_->ReadSlot()].get();
+  int frames = ring_->ReadDataSize() /
+      (sizeof(*packet->channel(0)) * packet->channels());
+  frames = std::min(frames, packet->frames());
+
+  packet->CopyTo(dest);
+  dest->ZeroFramesPartial(frames, dest->frames() - frames);
+  ring_->CommitRead();
+  return frames;
+}
+
 void AudioSyncReader::Close() {
   if (socket_.get()) {
     socket_->Close();
@@ -17,17 +17,26 @@ namespace base {
 class SharedMemory;
 }
 
+namespace media {
+class SharedMemoryRing;
+}
+
 namespace content {
 
 // A AudioOutputController::SyncReader implementation using SyncSocket. This
 // is used by AudioOutputController to provide a low latency data source for
 // transmitting audio packets between the browser process and the renderer
 // process.
+//
+// If |ring_slots| is larger than one, |shared_memory| holds a SharedMemoryRing
+// which the renderer keeps filled ahead of time; Read() then takes the oldest
+// packet without waiting for the renderer unless the ring has run empty.
 class AudioSyncReader : public media::AudioOutputController::SyncReader {
  public:
   AudioSyncReader(base::SharedMemory* shared_memory,
                   const media::AudioParameters& params,
-                  int input_channels);
+                  int input_channels,
+                  int ring_slots);
 
   virtual ~AudioSyncReader();
 
@@ -46,6 +55,9 @@ class AudioSyncReader : public media::AudioOutputController::SyncReader {
 #endif
 
  private:
+  // Read() for the ring mode.
+  int ReadFromRing(media::AudioBus* dest);
+
   base::SharedMemory* shared_memory_;
 
   // Number of input channels for synchronized I/O.
@@ -67,6 +79,11 @@ class AudioSyncReader : public media::AudioOutputController::SyncReader {
   // Maximum amount of audio data which can be transferred in one Read() call.
   int packet_size_;
 
+  // The ring in |shared_memory_| and a wrapper for each of its packets, if
+  // the renderer asked for more than one slot.
+  scoped_ptr<media::SharedMemoryRing> ring_;
+  scoped_array<scoped_ptr<media::AudioBus> > ring_buses_;
+
   // Track the number of times the renderer missed its real-time deadline and
   // report a UMA stat during destruction.
   size_t renderer_callback_count_;
@@ -0,0 +1,379 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/process_util.h"
+#include "base/shared_memory.h"
+#include "base/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "base/time.h"
+#include "content/browser/renderer_host/media/audio_sync_reader.h"
+#include "media/audio/audio_manager.h"
+#include "media/audio/audio_output_controller.h"
+#include "media/audio/audio_output_device.h"
+#include "media/audio/audio_output_ipc.h"
+#include "media/audio/shared_memory_ring.h"
+#include "media/audio/shared_memory_util.h"
+#include "media/base/audio_bus.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using media::AudioBus;
+using media::AudioParameters;
+using media::SharedMemoryRing;
+
+namespace content {
+
+static const int kSampleRate = 48000;
+static const int kBitsPerSample = 16;
+static const int kFramesPerBuffer = kSampleRate / 100;
+static const int kRingSlots = 4;
+
+// Seconds of audio pulled per configuration by the ring benchmark. Disabled
+// by default; run with
+// --gtest_also_run_disabled_tests --audio-ring-benchmark-seconds=N.
+static const char kBenchmarkSeconds[] = "audio-ring-benchmark-seconds";
+static const int kDefaultBenchmarkSeconds = 2;
+
+static AudioParameters TestParameters(AudioParameters::Format format) {
+  return AudioParameters(format, media::CHANNEL_LAYOUT_STEREO, kSampleRate,
+                         kBitsPerSample, kFramesPerBuffer);
+}
+
+// Returns the size of the shared memory AudioRendererHost allocates.
+static uint32 SharedMemorySize(const AudioParameters& params, int ring_slots) {
+  uint32 packet_size = AudioBus::CalculateMemorySize(params);
+  if (ring_slots > 1)
+    return SharedMemoryRing::TotalSizeInBytes(packet_size, ring_slots);
+  return media::TotalSharedMemorySizeInBytes(packet_size);
+}
+
+class AudioSyncReaderTest : public testing::Test {
+ public:
+  AudioSyncReaderTest()
+      : params_(TestParameters(AudioParameters::AUDIO_PCM_LOW_LATENCY)) {
+    CHECK(shared_memory_.CreateAndMapAnonymous(
+        SharedMemorySize(params_, kRingSlots)));
+    reader_.reset(new AudioSyncReader(&shared_memory_, params_, 0,
+                                      kRingSlots));
+    ring_.reset(new SharedMemoryRing(shared_memory_.memory(),
+                                     AudioBus::CalculateMemorySize(params_),
+                                     kRingSlots));
+    dest_ = AudioBus::Create(params_);
+  }
+
+ protected:
+  // Writes a packet of |frames| frames of |value| as the renderer would.
+  void WritePacket(float value, int frames) {
+    ASSERT_GT(ring_->AvailableToWrite(), 0);
+    scoped_ptr<AudioBus> packet =
+        AudioBus::WrapMemory(params_, ring_->Packet(ring_->WriteSlot()));
+    for (int ch = 0; ch < packet->channels(); ++ch)
+      std::fill(packet->channel(ch), packet->channel(ch) + frames, value);
+    ring_->CommitWrite(frames * sizeof(float) * packet->channels());
+  }
+
+  AudioParameters params_;
+  base::SharedMemory shared_memory_;
+  scoped_ptr<AudioSyncReader> reader_;
+  scoped_ptr<SharedMemoryRing> ring_;
+  scoped_ptr<AudioBus> dest_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AudioSyncReaderTest);
+};
+
+TEST_F(AudioSyncReaderTest, RingReadsPacketsInOrder) {
+  EXPECT_FALSE(reader_->DataReady());
+  WritePacket(1.0f, kFramesPerBuffer);
+  WritePacket(0.5f, kFramesPerBuffer / 2);
+  EXPECT_TRUE(reader_->DataReady());
+
+  EXPECT_EQ(kFramesPerBuffer, reader_->Read(NULL, dest_.get()));
+  EXPECT_EQ(1.0f, dest_->channel(0)[kFramesPerBuffer - 1]);
+
+  // The part of |dest_| not covered by the packet is zeroed.
+  EXPECT_EQ(kFramesPerBuffer / 2, reader_->Read(NULL, dest_.get()));
+  EXPECT_EQ(0.5f, dest_->channel(1)[0]);
+  EXPECT_EQ(0.0f, dest_->channel(1)[kFramesPerBuffer / 2]);
+
+  EXPECT_FALSE(reader_->DataReady());
+  EXPECT_EQ(kRingSlots, ring_->AvailableToWrite());
+}
+
+// An empty ring plays silence instead of waiting for the renderer.
+TEST_F(AudioSyncReaderTest, RingUnderrunPlaysSilence) {
+  WritePacket(1.0f, kFramesPerBuffer);
+  reader_->Read(NULL, dest_.get());
+
+  EXPECT_EQ(kFramesPerBuffer, reader_->Read(NULL, dest_.get()));
+  EXPECT_EQ(0.0f, dest_->channel(0)[0]);
+}
+
+// Packets rendered ahead must not be played after a pause.
+TEST_F(AudioSyncReaderTest, RingPauseDropsQueuedPackets) {
+  WritePacket(1.0f, kFramesPerBuffer);
+  WritePacket(1.0f, kFramesPerBuffer);
+  reader_->UpdatePendingBytes(media::kPauseMark);
+  EXPECT_FALSE(reader_->DataReady());
+  EXPECT_EQ(kRingSlots, ring_->AvailableToWrite());
+
+  // Pending bytes for playback leave the ring alone.
+  WritePacket(1.0f, kFramesPerBuffer);
+  reader_->UpdatePendingBytes(0);
+  EXPECT_TRUE(reader_->DataReady());
+}
+
+namespace {
+
+// Renders silence, stalling for |stall| every |stall_interval| calls, and
+// records the delays it's told about.
+class StallingRenderCallback : public media::AudioRendererSink::RenderCallback {
+ public:
+  StallingRenderCallback(int stall_interval, base::TimeDelta stall)
+      : stall_interval_(stall_interval),
+        stall_(stall),
+        renders_(0),
+        total_delay_milliseconds_(0) {
+  }
+
+  virtual int Render(AudioBus* dest, int audio_delay_milliseconds) OVERRIDE {
+    if (++renders_ % stall_interval_ == 0)
+      base::PlatformThread::Sleep(stall_);
+    total_delay_milliseconds_ += audio_delay_milliseconds;
+    dest->Zero();
+    return dest->frames();
+  }
+
+  virtual void RenderIO(AudioBus* source,
+                        AudioBus* dest,
+                        int audio_delay_milliseconds) OVERRIDE {
+    NOTREACHED();
+  }
+
+  virtual void OnRenderError() OVERRIDE {}
+
+  double MeanDelayMilliseconds() const {
+    return renders_ ? static_cast<double>(total_delay_milliseconds_) / renders_
+                    : 0;
+  }
+
+ private:
+  const int stall_interval_;
+  const base::TimeDelta stall_;
+  int renders_;
+  int64 total_delay_milliseconds_;
+
+  DISALLOW_COPY_AND_ASSIGN(StallingRenderCallback);
+};
+
+// Counts the pulls of AudioOutputController which found no data.
+class CountingSyncReader : public media::AudioOutputController::SyncReader {
+ public:
+  explicit CountingSyncReader(AudioSyncReader* reader)
+      : reader_(reader),
+        reads_(0),
+        underruns_(0) {
+  }
+  virtual ~CountingSyncReader() {}
+
+  virtual void UpdatePendingBytes(uint32 bytes) OVERRIDE {
+    reader_->UpdatePendingBytes(bytes);
+  }
+
+  virtual int Read(AudioBus* source, AudioBus* dest) OVERRIDE {
+    ++reads_;
+    if (!reader_->DataReady())
+      ++underruns_;
+    return reader_->Read(source, dest);
+  }
+
+  virtual void Close() OVERRIDE { reader_->Close(); }
+  virtual bool DataReady() OVERRIDE { return reader_->DataReady(); }
+
+  int reads() const { return reads_; }
+  int underruns() const { return underruns_; }
+
+ private:
+  AudioSyncReader* reader_;
+  int reads_;
+  int underruns_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingSyncReader);
+};
+
+// Plays the part of AudioMessageFilter and AudioRendererHost in one process,
+// allocating a ring of |ring_slots| packets for every stream.
+class InProcessAudioOutputIPC
+    : public media::AudioOutputIPC,
+      public media::AudioOutputController::EventHandler {
+ public:
+  InProcessAudioOutputIPC(media::AudioManager* audio_manager,
+                          const scoped_refptr<base::MessageLoopProxy>& io_loop,
+                          int ring_slots)
+      : audio_manager_(audio_manager),
+        io_loop_(io_loop),
+        ring_slots_(ring_slots),
+        delegate_(NULL),
+        length_(0),
+        closed_(false, false) {
+  }
+  virtual ~InProcessAudioOutputIPC() {}
+
+  // media::AudioOutputIPC implementation.
+  virtual int AddDelegate(media::AudioOutputIPCDelegate* delegate) OVERRIDE {
+    delegate_ = delegate;
+    return 1;
+  }
+
+  virtual void RemoveDelegate(int stream_id) OVERRIDE { delegate_ = NULL; }
+
+  virtual void CreateStream(int stream_id,
+                            const AudioParameters& params,
+                            int ring_slots) OVERRIDE {
+    // The renderer follows whatever layout the browser allocated.
+    CHECK(shared_memory_.CreateAndMapAnonymous(
+        SharedMemorySize(params, ring_slots_)));
+    length_ = AudioBus::CalculateMemorySize(params) * ring_slots_;
+    reader_.reset(new AudioSyncReader(&shared_memory_, params, 0,
+                                      ring_slots_));
+    CHECK(reader_->Init());
+    counting_reader_.reset(new CountingSyncReader(reader_.get()));
+    controller_ = media::AudioOutputController::Create(
+        audio_manager_, this, params, counting_reader_.get());
+    CHECK(controller_);
+  }
+
+  virtual void PlayStream(int stream_id) OVERRIDE { controller_->Play(); }
+  virtual void PauseStream(int stream_id) OVERRIDE { controller_->Pause(); }
+  virtual void FlushStream(int stream_id) OVERRIDE {}
+
+  virtual void CloseStream(int stream_id) OVERRIDE {
+    controller_->Close(base::Bind(&base::WaitableEvent::Signal,
+                                  base::Unretained(&closed_)));
+  }
+
+  virtual void SetVolume(int stream_id, double volume) OVERRIDE {
+    controller_->SetVolume(volume);
+  }
+
+  // media::AudioOutputController::EventHandler implementation.
+  virtual void OnCreated(media::AudioOutputController* controller) OVERRIDE {
+    base::SharedMemoryHandle memory_handle;
+    CHECK(shared_memory_.ShareToProcess(base::GetCurrentProcessHandle(),
+                                        &memory_handle));
+#if defined(OS_WIN)
+    base::SyncSocket::Handle socket_handle;
+    CHECK(reader_->PrepareForeignSocketHandle(base::GetCurrentProcessHandle(),
+                                              &socket_handle));
+#else
+    base::FileDescriptor socket_descriptor;
+    CHECK(reader_->PrepareForeignSocketHandle(base::GetCurrentProcessHandle(),
+                                              &socket_descriptor));
+    base::SyncSocket::Handle socket_handle = socket_descriptor.fd;
+#endif
+    io_loop_->PostTask(FROM_HERE, base::Bind(
+        &media::AudioOutputIPCDelegate::OnStreamCreated,
+        base::Unretained(delegate_), memory_handle, socket_handle, length_));
+  }
+
+  virtual void OnPlaying(media::AudioOutputController* controller) OVERRIDE {}
+  virtual void OnPaused(media::AudioOutputController* controller) OVERRIDE {}
+  virtual void OnError(media::AudioOutputController* controller,
+                       int error_code) OVERRIDE {}
+  virtual void OnDeviceChange(media::AudioOutputController* controller,
+                              int new_buffer_size,
+                              int new_sample_rate) OVERRIDE {}
+
+  // Waits until the controller has closed after CloseStream().
+  void WaitForClose() { closed_.Wait(); }
+
+  const CountingSyncReader* counting_reader() const {
+    return counting_reader_.get();
+  }
+
+ private:
+  media::AudioManager* audio_manager_;
+  scoped_refptr<base::MessageLoopProxy> io_loop_;
+  const int ring_slots_;
+  media::AudioOutputIPCDelegate* delegate_;
+
+  base::SharedMemory shared_memory_;
+  int length_;
+  scoped_ptr<AudioSyncReader> reader_;
+  scoped_ptr<CountingSyncReader> counting_reader_;
+  scoped_refptr<media::AudioOutputController> controller_;
+  base::WaitableEvent closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(InProcessAudioOutputIPC);
+};
+
+}  // namespace
+
+// Plays |duration| of audio through a ring of |ring_slots| packets and returns
+// the number of pulls which underran.
+static int RunRingBenchmark(media::AudioManager* audio_manager,
+                            MessageLoop* message_loop,
+                            int ring_slots,
+                            base::TimeDelta duration) {
+  // Every 50th packet, i.e. twice a second, the renderer stalls for one and a
+  // half packets.
+  const base::TimeDelta kStall = base::TimeDelta::FromMilliseconds(15);
+  StallingRenderCallback callback(50, kStall);
+
+  InProcessAudioOutputIPC ipc(audio_manager, message_loop->message_loop_proxy(),
+                              ring_slots);
+  scoped_refptr<media::AudioOutputDevice> device(new media::AudioOutputDevice(
+      &ipc, message_loop->message_loop_proxy()));
+  device->Initialize(TestParameters(AudioParameters::AUDIO_FAKE), &callback);
+  device->Start();
+  device->Play();
+
+  message_loop->PostDelayedTask(FROM_HERE, MessageLoop::QuitClosure(),
+                                duration);
+  message_loop->Run();
+
+  device->Stop();
+  message_loop->RunUntilIdle();
+  ipc.WaitForClose();
+
+  const CountingSyncReader* reader = ipc.counting_reader();
+  printf("%d slot(s): %d of %d pulls underran, mean render delay %.1f ms\n",
+         ring_slots, reader->underruns(), reader->reads(),
+         callback.MeanDelayMilliseconds());
+  return reader->underruns();
+}
+
+// Benchmark of the complete path from AudioOutputDevice to a
+// FakeAudioOutputStream, which pulls in real time.  The renderer stalls every
+// so often, as it does during garbage collection or layout; every pull which
+// finds no data is an audible glitch.
+TEST(AudioSyncReaderBenchmark, DISABLED_RingUnderruns) {
+  int seconds = 0;
+  if (!base::StringToInt(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          kBenchmarkSeconds), &seconds) || seconds < 1) {
+    seconds = kDefaultBenchmarkSeconds;
+  }
+  const base::TimeDelta duration = base::TimeDelta::FromSeconds(seconds);
+
+  MessageLoopForIO message_loop;
+  scoped_ptr<media::AudioManager> audio_manager(media::AudioManager::Create());
+
+  printf("Benchmarking pulls from a renderer stalling twice a second:\n");
+  const int single_underruns =
+      RunRingBenchmark(audio_manager.get(), &message_loop, 1, duration);
+  const int ring_underruns =
+      RunRingBenchmark(audio_manager.get(), &message_loop, kRingSlots,
+                       duration);
+
+  // The ring exists to absorb exactly these stalls.
+  EXPECT_LE(ring_underruns, single_underruns);
+}
+
+}  // namespace content
@@ -726,6 +726,7 @@ void RenderProcessHostImpl::PropagateBrowserCommandLineToRenderer(
     // We propagate the Chrome Frame command line here as well in case the
     // renderer is not run in the sandbox.
     switches::kAudioBufferSize,
+    switches::kAudioOutputRingSlots,
     switches::kAuditAllHandles,
     switches::kAuditHandles,
     switches::kChromeFrame,
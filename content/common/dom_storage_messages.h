@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 // Multiply-included message file, no traditional include guard.
+#include "base/shared_memory.h"
 #include "content/public/common/common_param_traits.h"
 #include "googleurl/src/gurl.h"
 #include "ipc/ipc_message_macros.h"
@@ -36,6 +37,10 @@ IPC_STRUCT_BEGIN(DOMStorageMsg_Event_Params)
   // The non-zero session namespace_id associated with the event or 0 if
   // this is a local storage event.
   IPC_STRUCT_MEMBER(int64, namespace_id)
+
+  // The version of the area after the change. Caches primed from a
+  // snapshot of this version or a later one already reflect the change.
+  IPC_STRUCT_MEMBER(int64, version)
 IPC_STRUCT_END()
 
 IPC_ENUM_TRAITS(WebKit::WebStorageArea::Result)
@@ -65,11 +70,14 @@ IPC_MESSAGE_CONTROL3(DOMStorageHostMsg_OpenStorageArea,
 IPC_MESSAGE_CONTROL1(DOMStorageHostMsg_CloseStorageArea,
                      int /* connection_id */)
 
-// Retrieves the set of key/value pairs for the area. Used to prime
-// the renderer-side cache. A completion notification is sent in response.
-IPC_SYNC_MESSAGE_CONTROL1_1(DOMStorageHostMsg_LoadStorageArea,
+// Retrieves a shared snapshot of the key/value pairs for the area, see
+// dom_storage::DomStorageSnapshot. Used to prime the renderer-side cache.
+// The handle is invalid if the snapshot couldn't be created. A completion
+// notification is sent in response.
+IPC_SYNC_MESSAGE_CONTROL1_2(DOMStorageHostMsg_LoadStorageArea,
                             int /* connection_id */,
-                            dom_storage::ValuesMap)
+                            base::SharedMemoryHandle /* snapshot */,
+                            uint32 /* snapshot_size */)
 
 // Set a value that's associated with a key in a storage area.
 // A completion notification is sent in response.
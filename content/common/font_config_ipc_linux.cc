@@ -10,16 +10,64 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include "base/basictypes.h"
 #include "base/pickle.h"
+#include "base/posix/eintr_wrapper.h"
 #include "base/posix/unix_domain_socket_linux.h"
 
 namespace content {
 
+namespace {
+
+// Upper bounds on the number of cached entries. Pages rarely use more than a
+// few dozen distinct families; the limits only guard against pathological
+// content. The caches are simply flushed when full.
+const size_t kMaxMatchCacheSize = 512;
+const size_t kMaxFileDescriptorCacheSize = 64;
+
+}  // namespace
+
+FontConfigIPC::MatchKey::MatchKey()
+    : filefaceid_valid(false),
+      filefaceid(0),
+      is_bold(false),
+      is_italic(false) {
+}
+
+FontConfigIPC::MatchKey::~MatchKey() {
+}
+
+bool FontConfigIPC::MatchKey::operator<(const MatchKey& other) const {
+  if (filefaceid_valid != other.filefaceid_valid)
+    return filefaceid_valid < other.filefaceid_valid;
+  if (filefaceid != other.filefaceid)
+    return filefaceid < other.filefaceid;
+  if (is_bold != other.is_bold)
+    return is_bold < other.is_bold;
+  if (is_italic != other.is_italic)
+    return is_italic < other.is_italic;
+  return family < other.family;
+}
+
+FontConfigIPC::MatchResult::MatchResult()
+    : success(false),
+      filefaceid(0),
+      is_bold(false),
+      is_italic(false) {
+}
+
+FontConfigIPC::MatchResult::~MatchResult() {
+}
+
 FontConfigIPC::FontConfigIPC(int fd)
     : fd_(fd) {
 }
 
 FontConfigIPC::~FontConfigIPC() {
+  for (FileDescriptorCache::iterator it = fd_cache_.begin();
+       it != fd_cache_.end(); ++it) {
+    close(it->second);
+  }
   close(fd_);
 }
 
@@ -32,60 +80,55 @@ bool FontConfigIPC::Match(std::string* result_family,
   if (family.length() > kMaxFontFamilyLength)
     return false;
 
-  Pickle request;
-  request.WriteInt(METHOD_MATCH);
-  request.WriteBool(filefaceid_valid);
-  if (filefaceid_valid)
-    request.WriteUInt32(filefaceid);
-
-  request.WriteBool(is_bold && *is_bold);
-  request.WriteBool(is_bold && *is_italic);
-
-  request.WriteUInt32(characters_bytes);
-  if (characters_bytes)
-    request.WriteBytes(characters, characters_bytes);
-
-  request.WriteString(family);
-
-  uint8_t reply_buf[512];
-  const ssize_t r = UnixDomainSocket::SendRecvMsg(fd_, reply_buf,
-                                                  sizeof(reply_buf), NULL,
-                                                  request);
-  if (r == -1)
-    return false;
+  MatchKey key;
+  key.filefaceid_valid = filefaceid_valid;
+  key.filefaceid = filefaceid_valid ? filefaceid : 0;
+  key.family = family;
+  key.is_bold = is_bold && *is_bold;
+  key.is_italic = is_italic && *is_italic;
+
+  MatchResult result;
+  // Requests for fonts covering specific characters are not cached: the
+  // character set makes the key effectively unique.
+  if (characters_bytes) {
+    if (!SendMatchRequest(key, characters, characters_bytes, &result))
+      return false;
+  } else if (!LookupMatch(key, &result)) {
+    // The lock is not held across the round trip, so concurrent misses for
+    // the same key may both ask the browser; they get the same answer.
+    // Failed round trips (as opposed to negative answers) are not cached.
+    if (!SendMatchRequest(key, NULL, 0, &result))
+      return false;
+    base::AutoLock lock(lock_);
+    if (match_cache_.size() >= kMaxMatchCacheSize)
+      match_cache_.clear();
+    match_cache_[key] = result;
+  }
 
-  Pickle reply(reinterpret_cast<char*>(reply_buf), r);
-  PickleIterator iter(reply);
-  bool result;
-  if (!reply.ReadBool(&iter, &result))
-    return false;
-  if (!result)
+  if (!result.success)
     return false;
 
-  uint32_t reply_filefaceid;
-  std::string reply_family;
-  bool resulting_bold, resulting_italic;
-  if (!reply.ReadUInt32(&iter, &reply_filefaceid) ||
-      !reply.ReadString(&iter, &reply_family) ||
-      !reply.ReadBool(&iter, &resulting_bold) ||
-      !reply.ReadBool(&iter, &resulting_italic)) {
-    return false;
-  }
-
   if (result_filefaceid)
-    *result_filefaceid = reply_filefaceid;
+    *result_filefaceid = result.filefaceid;
   if (result_family)
-    *result_family = reply_family;
+    *result_family = result.family;
 
   if (is_bold)
-    *is_bold = resulting_bold;
+    *is_bold = result.is_bold;
   if (is_italic)
-    *is_italic = resulting_italic;
+    *is_italic = result.is_italic;
 
   return true;
 }
 
 int FontConfigIPC::Open(unsigned filefaceid) {
+  {
+    base::AutoLock lock(lock_);
+    FileDescriptorCache::const_iterator it = fd_cache_.find(filefaceid);
+    if (it != fd_cache_.end())
+      return HANDLE_EINTR(dup(it->second));
+  }
+
   Pickle request;
   request.WriteInt(METHOD_OPEN);
   request.WriteUInt32(filefaceid);
@@ -109,7 +152,81 @@ int FontConfigIPC::Open(unsigned filefaceid) {
     return -1;
   }
 
+  // Keep our own descriptor so later opens of the same face do not need a
+  // round trip. The caller owns (and closes) the one we hand out.
+  const int cached_fd = HANDLE_EINTR(dup(result_fd));
+  if (cached_fd >= 0) {
+    base::AutoLock lock(lock_);
+    if (fd_cache_.count(filefaceid)) {
+      // Another thread opened the same face while we waited for the reply.
+      close(cached_fd);
+      return result_fd;
+    }
+    if (fd_cache_.size() >= kMaxFileDescriptorCacheSize) {
+      for (FileDescriptorCache::iterator fd_it = fd_cache_.begin();
+           fd_it != fd_cache_.end(); ++fd_it) {
+        close(fd_it->second);
+      }
+      fd_cache_.clear();
+    }
+    fd_cache_[filefaceid] = cached_fd;
+  }
+
   return result_fd;
 }
 
+bool FontConfigIPC::LookupMatch(const MatchKey& key, MatchResult* result) {
+  base::AutoLock lock(lock_);
+  MatchCache::const_iterator it = match_cache_.find(key);
+  if (it == match_cache_.end())
+    return false;
+  *result = it->second;
+  return true;
+}
+
+bool FontConfigIPC::SendMatchRequest(const MatchKey& key,
+                                     const void* characters,
+                                     size_t characters_bytes,
+                                     MatchResult* result) {
+  Pickle request;
+  request.WriteInt(METHOD_MATCH);
+  request.WriteBool(key.filefaceid_valid);
+  if (key.filefaceid_valid)
+    request.WriteUInt32(key.filefaceid);
+
+  request.WriteBool(key.is_bold);
+  request.WriteBool(key.is_italic);
+
+  request.WriteUInt32(characters_bytes);
+  if (characters_bytes)
+    request.WriteBytes(characters, characters_bytes);
+
+  request.WriteString(key.family);
+
+  uint8_t reply_buf[512];
+  const ssize_t r = UnixDomainSocket::SendRecvMsg(fd_, reply_buf,
+                                                  sizeof(reply_buf), NULL,
+                                                  request);
+  if (r == -1)
+    return false;
+
+  Pickle reply(reinterpret_cast<char*>(reply_buf), r);
+  PickleIterator iter(reply);
+  if (!reply.ReadBool(&iter, &result->success))
+    return false;
+  if (!result->success)
+    return true;
+
+  uint32_t reply_filefaceid;
+  if (!reply.ReadUInt32(&iter, &reply_filefaceid) ||
+      !reply.ReadString(&iter, &result->family) ||
+      !reply.ReadBool(&iter, &result->is_bold) ||
+      !reply.ReadBool(&iter, &result->is_italic)) {
+    return false;
+  }
+  result->filefaceid = reply_filefaceid;
+
+  return true;
+}
+
 }  // namespace content
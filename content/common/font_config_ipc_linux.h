@@ -6,14 +6,21 @@
 #define CONTENT_COMMON_FONT_CONFIG_IPC_LINUX_H_
 
 #include "base/compiler_specific.h"
+#include "base/synchronization/lock.h"
 #include "skia/ext/SkFontHost_fontconfig_impl.h"
 
+#include <map>
 #include <string>
 
 namespace content {
 
 // FontConfig implementation for Skia that proxies out of process to get out
 // of the sandbox. See http://code.google.com/p/chromium/wiki/LinuxSandboxIPC
+//
+// Every request is a synchronous round trip to the browser, so results of
+// family lookups and the descriptors of opened font files are cached in
+// process. The font configuration does not change for the lifetime of a
+// renderer, so entries are only dropped to bound the cache size.
 class FontConfigIPC : public FontConfigInterface {
  public:
   explicit FontConfigIPC(int fd);
@@ -36,7 +43,54 @@ class FontConfigIPC : public FontConfigInterface {
   };
 
  private:
+  struct MatchKey {
+    MatchKey();
+    ~MatchKey();
+
+    bool operator<(const MatchKey& other) const;
+
+    bool filefaceid_valid;
+    unsigned filefaceid;
+    std::string family;
+    bool is_bold;
+    bool is_italic;
+  };
+
+  struct MatchResult {
+    MatchResult();
+    ~MatchResult();
+
+    bool success;
+    unsigned filefaceid;
+    std::string family;
+    bool is_bold;
+    bool is_italic;
+  };
+
+  typedef std::map<MatchKey, MatchResult> MatchCache;
+  typedef std::map<unsigned, int> FileDescriptorCache;
+
+  // Copies the cached result for |key| into |result|. Returns false on a
+  // cache miss.
+  bool LookupMatch(const MatchKey& key, MatchResult* result);
+
+  // Sends a METHOD_MATCH request to the browser.
+  bool SendMatchRequest(const MatchKey& key,
+                        const void* characters,
+                        size_t characters_bytes,
+                        MatchResult* result);
+
   const int fd_;
+
+  // Protects the caches below; Skia may call in from several threads. Never
+  // held across a round trip to the browser.
+  base::Lock lock_;
+  MatchCache match_cache_;
+  // Descriptors of font files already opened by the browser, keyed by
+  // filefaceid. Callers get a dup() and close it when done.
+  FileDescriptorCache fd_cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(FontConfigIPC);
 };
 
 }  // namespace content
@@ -0,0 +1,189 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "content/common/font_config_ipc_linux.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/pickle.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/posix/unix_domain_socket_linux.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace content {
+
+namespace {
+
+const unsigned kFakeFileFaceId = 7;
+const char kFakeFamily[] = "Fake Sans";
+
+// Stands in for the browser's sandbox IPC handler. Answers every match with
+// the same face and every open with a descriptor for /dev/null, counting
+// the requests it serves until the other end of the socket is closed.
+class FakeSandboxHost : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit FakeSandboxHost(int fd)
+      : fd_(fd),
+        match_requests_(0),
+        open_requests_(0) {
+  }
+
+  virtual ~FakeSandboxHost() {
+    close(fd_);
+  }
+
+  // Only valid once the thread running this delegate has been joined.
+  int match_requests() const { return match_requests_; }
+  int open_requests() const { return open_requests_; }
+
+  // base::DelegateSimpleThread::Delegate implementation.
+  virtual void Run() OVERRIDE {
+    char buf[1024];
+    for (;;) {
+      std::vector<int> fds;
+      const ssize_t len = UnixDomainSocket::RecvMsg(fd_, buf, sizeof(buf),
+                                                    &fds);
+      if (len <= 0)
+        return;
+      if (fds.size() == 1)
+        HandleRequest(Pickle(buf, len), fds[0]);
+      for (size_t i = 0; i < fds.size(); ++i)
+        close(fds[i]);
+    }
+  }
+
+ private:
+  void HandleRequest(const Pickle& request, int reply_fd) {
+    PickleIterator iter(request);
+    int method;
+    if (!request.ReadInt(&iter, &method))
+      return;
+
+    Pickle reply;
+    std::vector<int> reply_fds;
+    int file_fd = -1;
+    if (method == FontConfigIPC::METHOD_MATCH) {
+      ++match_requests_;
+      reply.WriteBool(true);
+      reply.WriteUInt32(kFakeFileFaceId);
+      reply.WriteString(kFakeFamily);
+      reply.WriteBool(false);
+      reply.WriteBool(false);
+    } else if (method == FontConfigIPC::METHOD_OPEN) {
+      ++open_requests_;
+      file_fd = HANDLE_EINTR(open("/dev/null", O_RDONLY));
+      reply.WriteBool(file_fd >= 0);
+      if (file_fd >= 0)
+        reply_fds.push_back(file_fd);
+    } else {
+      return;
+    }
+
+    UnixDomainSocket::SendMsg(reply_fd, reply.data(), reply.size(),
+                              reply_fds);
+    if (file_fd >= 0)
+      close(file_fd);
+  }
+
+  const int fd_;
+  int match_requests_;
+  int open_requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeSandboxHost);
+};
+
+class FontConfigIPCTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+    host_.reset(new FakeSandboxHost(fds[0]));
+    host_thread_.reset(
+        new base::DelegateSimpleThread(host_.get(), "FakeSandboxHost"));
+    host_thread_->Start();
+    font_config_.reset(new FontConfigIPC(fds[1]));
+  }
+
+  // Closes the renderer end of the socket so the host thread exits, after
+  // which its request counts may be read.
+  void ShutDown() {
+    font_config_.reset();
+    host_thread_->Join();
+  }
+
+  virtual void TearDown() OVERRIDE {
+    if (font_config_.get())
+      ShutDown();
+  }
+
+  bool MatchFamily(const std::string& family, const void* characters,
+                   size_t characters_bytes, unsigned* filefaceid) {
+    bool is_bold = false;
+    bool is_italic = false;
+    std::string result_family;
+    return font_config_->Match(&result_family, filefaceid, false, 0, family,
+                               characters, characters_bytes,
+                               &is_bold, &is_italic);
+  }
+
+  scoped_ptr<FakeSandboxHost> host_;
+  scoped_ptr<base::DelegateSimpleThread> host_thread_;
+  scoped_ptr<FontConfigIPC> font_config_;
+};
+
+}  // namespace
+
+TEST_F(FontConfigIPCTest, MatchIsCached) {
+  unsigned filefaceid = 0;
+  EXPECT_TRUE(MatchFamily("sans-serif", NULL, 0, &filefaceid));
+  EXPECT_EQ(kFakeFileFaceId, filefaceid);
+
+  filefaceid = 0;
+  EXPECT_TRUE(MatchFamily("sans-serif", NULL, 0, &filefaceid));
+  EXPECT_EQ(kFakeFileFaceId, filefaceid);
+
+  // A different family is a different key.
+  EXPECT_TRUE(MatchFamily("serif", NULL, 0, &filefaceid));
+
+  ShutDown();
+  EXPECT_EQ(2, host_->match_requests());
+}
+
+TEST_F(FontConfigIPCTest, MatchWithCharactersIsNotCached) {
+  const uint16 characters[] = { 0x4e2d, 0x6587 };
+  unsigned filefaceid = 0;
+  EXPECT_TRUE(MatchFamily("sans-serif", characters, sizeof(characters),
+                          &filefaceid));
+  EXPECT_TRUE(MatchFamily("sans-serif", characters, sizeof(characters),
+                          &filefaceid));
+
+  ShutDown();
+  EXPECT_EQ(2, host_->match_requests());
+}
+
+TEST_F(FontConfigIPCTest, OpenIsCached) {
+  const int fd1 = font_config_->Open(kFakeFileFaceId);
+  ASSERT_GE(fd1, 0);
+  const int fd2 = font_config_->Open(kFakeFileFaceId);
+  ASSERT_GE(fd2, 0);
+
+  // Each caller gets its own descriptor to close.
+  EXPECT_NE(fd1, fd2);
+  EXPECT_EQ(0, close(fd1));
+  EXPECT_EQ(0, close(fd2));
+
+  ShutDown();
+  EXPECT_EQ(1, host_->open_requests());
+}
+
+}  // namespace content
@@ -92,9 +92,10 @@ IPC_MESSAGE_CONTROL2(AudioInputMsg_NotifyDeviceStarted,
 // Messages sent from the renderer to the browser.
 
 // Request that got sent to browser for creating an audio output stream
-IPC_MESSAGE_CONTROL2(AudioHostMsg_CreateStream,
+IPC_MESSAGE_CONTROL3(AudioHostMsg_CreateStream,
                      int /* stream_id */,
-                     media::AudioParameters /* params */)
+                     media::AudioParameters /* params */,
+                     int /* ring_slots */)
 
 // Request that got sent to browser for creating an audio input stream
 IPC_MESSAGE_CONTROL4(AudioInputHostMsg_CreateStream,
@@ -18,11 +18,12 @@
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebStorageEventDispatcher.h"
 #include "webkit/dom_storage/dom_storage_cached_area.h"
 #include "webkit/dom_storage/dom_storage_proxy.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 #include "webkit/dom_storage/dom_storage_types.h"
 
 using dom_storage::DomStorageCachedArea;
 using dom_storage::DomStorageProxy;
-using dom_storage::ValuesMap;
+using dom_storage::DomStorageSnapshot;
 
 namespace content {
 
@@ -111,7 +112,8 @@ class DomStorageDispatcher::ProxyImpl : public DomStorageProxy {
   void Shutdown();
 
   // DomStorageProxy interface for use by DomStorageCachedArea.
-  virtual void LoadArea(int connection_id, ValuesMap* values,
+  virtual void LoadArea(int connection_id,
+                        scoped_refptr<DomStorageSnapshot>* snapshot,
                         const CompletionCallback& callback) OVERRIDE;
   virtual void SetItem(int connection_id, const string16& key,
                        const string16& value, const GURL& page_url,
@@ -225,11 +227,15 @@ void DomStorageDispatcher::ProxyImpl::Shutdown() {
 }
 
 void DomStorageDispatcher::ProxyImpl::LoadArea(
-    int connection_id, ValuesMap* values,
+    int connection_id, scoped_refptr<DomStorageSnapshot>* snapshot,
     const CompletionCallback& callback) {
+  base::SharedMemoryHandle handle = base::SharedMemory::NULLHandle();
+  uint32 size = 0;
   PushPendingCallback(callback);
   throttling_filter_->SendThrottled(new DOMStorageHostMsg_LoadStorageArea(
-      connection_id, values));
+      connection_id, &handle, &size));
+  // Takes ownership of the handle, it is closed if the snapshot is rejected.
+  *snapshot = DomStorageSnapshot::Open(handle, size);
 }
 
 void DomStorageDispatcher::ProxyImpl::SetItem(
@@ -306,7 +312,8 @@ void DomStorageDispatcher::OnStorageEvent(
     DomStorageCachedArea* cached_area = proxy_->LookupCachedArea(
         params.namespace_id, params.origin);
     if (cached_area)
-      cached_area->ApplyMutation(params.key, params.new_value);
+      cached_area->ApplyMutation(params.key, params.new_value,
+                                 params.version);
   }
 
   if (params.namespace_id == dom_storage::kLocalStorageNamespaceId) {
@@ -42,8 +42,9 @@ void AudioMessageFilter::RemoveDelegate(int id) {
 }
 
 void AudioMessageFilter::CreateStream(int stream_id,
-                                      const media::AudioParameters& params) {
-  Send(new AudioHostMsg_CreateStream(stream_id, params));
+                                      const media::AudioParameters& params,
+                                      int ring_slots) {
+  Send(new AudioHostMsg_CreateStream(stream_id, params, ring_slots));
 }
 
 void AudioMessageFilter::AssociateStreamWithProducer(int stream_id,
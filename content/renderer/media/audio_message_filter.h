@@ -45,7 +45,8 @@ class CONTENT_EXPORT AudioMessageFilter
 
   // Methods below must be called on the provided |io_message_loop|.
   virtual void CreateStream(int stream_id,
-                            const media::AudioParameters& params) OVERRIDE;
+                            const media::AudioParameters& params,
+                            int ring_slots) OVERRIDE;
   virtual void PlayStream(int stream_id) OVERRIDE;
   virtual void PauseStream(int stream_id) OVERRIDE;
   virtual void FlushStream(int stream_id) OVERRIDE;
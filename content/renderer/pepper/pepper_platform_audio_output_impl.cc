@@ -160,7 +160,9 @@ void PepperPlatformAudioOutputImpl::InitializeOnIOThread(
   stream_id_ = ipc_->AddDelegate(this);
   DCHECK_NE(0, stream_id_);
 
-  ipc_->CreateStream(stream_id_, params);
+  // Pepper plugins fill the shared memory themselves and only understand the
+  // single packet layout.
+  ipc_->CreateStream(stream_id_, params, 1);
   ipc_->AssociateStreamWithProducer(stream_id_, source_render_view_id);
 }
 
@@ -119,6 +119,7 @@
 #include "content/renderer/websharedworker_proxy.h"
 #include "media/base/audio_renderer_mixer_input.h"
 #include "media/base/filter_collection.h"
+#include "media/base/media_scheduler.h"
 #include "media/base/media_switches.h"
 #include "media/filters/audio_renderer_impl.h"
 #include "media/filters/gpu_video_decoder.h"
@@ -748,6 +749,10 @@ void RenderViewImpl::Initialize(RenderViewImplParams* params) {
       is_hidden() ? webkit_glue::kBackgroundTabTimerInterval :
           webkit_glue::kForegroundTabTimerInterval);
 
+  // The media players of this view are keyed by their delegate.
+  media::MediaScheduler::GetInstance()->SetPageVisible(
+      static_cast<webkit_media::WebMediaPlayerDelegate*>(this), !is_hidden());
+
   OnSetRendererPrefs(params->renderer_prefs);
 
 #if defined(ENABLE_WEBRTC)
@@ -800,6 +805,9 @@ void RenderViewImpl::Initialize(RenderViewImplParams* params) {
 RenderViewImpl::~RenderViewImpl() {
   history_page_ids_.clear();
 
+  media::MediaScheduler::GetInstance()->RemovePage(
+      static_cast<webkit_media::WebMediaPlayerDelegate*>(this));
+
   if (decrement_shared_popup_at_destruction_)
     shared_popup_counter_->data--;
 
@@ -5969,6 +5977,10 @@ void RenderViewImpl::OnWasHidden() {
   // Inform PPAPI plugins that their page is no longer visible.
   pepper_helper_->PageVisibilityChanged(false);
 
+  // Let media players on the page give up their share of the cores.
+  media::MediaScheduler::GetInstance()->SetPageVisible(
+      static_cast<webkit_media::WebMediaPlayerDelegate*>(this), false);
+
 #if defined(OS_MACOSX)
   // Inform NPAPI plugins that their container is no longer visible.
   std::set<WebPluginDelegateProxy*>::iterator plugin_it;
@@ -5991,6 +6003,9 @@ void RenderViewImpl::OnWasShown(bool needs_repainting) {
   // Inform PPAPI plugins that their page is visible.
   pepper_helper_->PageVisibilityChanged(true);
 
+  media::MediaScheduler::GetInstance()->SetPageVisible(
+      static_cast<webkit_media::WebMediaPlayerDelegate*>(this), true);
+
 #if defined(OS_MACOSX)
   // Inform NPAPI plugins that their container is now visible.
   std::set<WebPluginDelegateProxy*>::iterator plugin_it;
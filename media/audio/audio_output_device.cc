@@ -10,6 +10,7 @@
 #include "base/time.h"
 #include "media/audio/audio_output_controller.h"
 #include "media/audio/audio_util.h"
+#include "media/audio/shared_memory_ring.h"
 #include "media/audio/shared_memory_util.h"
 #include "media/base/limits.h"
 
@@ -33,9 +34,17 @@ class AudioOutputDevice::AudioThreadCallback
   virtual void Process(int pending_data) OVERRIDE;
 
  private:
+  // Process() for the ring mode: renders until the ring is full.
+  void FillRing(int pending_data);
+
   AudioRendererSink::RenderCallback* render_callback_;
   scoped_ptr<AudioBus> input_bus_;
   scoped_ptr<AudioBus> output_bus_;
+
+  // Set if the browser allocated a ring of several packets, in which case
+  // there is a wrapper for each packet instead of |output_bus_|.
+  scoped_ptr<SharedMemoryRing> ring_;
+  scoped_array<scoped_ptr<AudioBus> > ring_buses_;
   DISALLOW_COPY_AND_ASSIGN(AudioThreadCallback);
 };
 
@@ -113,7 +122,11 @@ void AudioOutputDevice::CreateStreamOnIOThread(const AudioParameters& params) {
   DCHECK(message_loop()->BelongsToCurrentThread());
   if (state_ == IDLE) {
     state_ = CREATING_STREAM;
-    ipc_->CreateStream(stream_id_, params);
+    // Synchronized input is delivered one packet at a time, so it can't be
+    // rendered ahead.
+    int ring_slots =
+        params.input_channels() > 0 ? 1 : GetAudioOutputRingSlots();
+    ipc_->CreateStream(stream_id_, params, ring_slots);
   }
 }
 
@@ -265,8 +278,6 @@ AudioOutputDevice::AudioThreadCallback::~AudioThreadCallback() {
 }
 
 void AudioOutputDevice::AudioThreadCallback::MapSharedMemory() {
-  shared_memory_.Map(TotalSharedMemorySizeInBytes(memory_length_));
-
   // Calculate output and input memory size.
   int output_memory_size = AudioBus::CalculateMemorySize(audio_parameters_);
   int input_channels = audio_parameters_.input_channels();
@@ -276,7 +287,23 @@ void AudioOutputDevice::AudioThreadCallback::MapSharedMemory() {
 
   int io_size = output_memory_size + input_memory_size;
 
-  DCHECK_EQ(memory_length_, io_size);
+  // The browser reports the size of all packets; more than one means a ring.
+  DCHECK_EQ(memory_length_ % io_size, 0);
+  int ring_slots = memory_length_ / io_size;
+  if (ring_slots > 1) {
+    DCHECK_EQ(input_channels, 0);
+    shared_memory_.Map(SharedMemoryRing::TotalSizeInBytes(io_size, ring_slots));
+    ring_.reset(new SharedMemoryRing(
+        shared_memory_.memory(), io_size, ring_slots));
+    ring_buses_.reset(new scoped_ptr<AudioBus>[ring_slots]);
+    for (int i = 0; i < ring_slots; ++i) {
+      ring_buses_[i] =
+          AudioBus::WrapMemory(audio_parameters_, ring_->Packet(i));
+    }
+    return;
+  }
+
+  shared_memory_.Map(TotalSharedMemorySizeInBytes(memory_length_));
 
   output_bus_ =
       AudioBus::WrapMemory(audio_parameters_, shared_memory_.memory());
@@ -292,6 +319,13 @@ void AudioOutputDevice::AudioThreadCallback::MapSharedMemory() {
 
 // Called whenever we receive notifications about pending data.
 void AudioOutputDevice::AudioThreadCallback::Process(int pending_data) {
+  if (ring_.get()) {
+    // The browser drops the queued packets itself when pausing.
+    if (pending_data != kPauseMark)
+      FillRing(pending_data);
+    return;
+  }
+
   if (pending_data == kPauseMark) {
     memset(shared_memory_.memory(), 0, memory_length_);
     SetActualDataSizeInBytes(&shared_memory_, memory_length_, 0);
@@ -329,4 +363,21 @@ void AudioOutputDevice::AudioThreadCallback::Process(int pending_data) {
       num_frames * sizeof(*output_bus_->channel(0)) * output_bus_->channels());
 }
 
+void AudioOutputDevice::AudioThreadCallback::FillRing(int pending_data) {
+  // Packets already queued in the ring play before the ones rendered now.
+  const int bytes_per_packet = audio_parameters_.GetBytesPerBuffer();
+  int delay_bytes = pending_data + ring_->AvailableToRead() * bytes_per_packet;
+
+  while (ring_->AvailableToWrite() > 0) {
+    TRACE_EVENT0("audio", "AudioOutputDevice::FireRenderCallback");
+
+    AudioBus* packet = ring_buses_[ring_->WriteSlot()].get();
+    int num_frames =
+        render_callback_->Render(packet, delay_bytes / bytes_per_ms_);
+    ring_->CommitWrite(
+        num_frames * sizeof(*packet->channel(0)) * packet->channels());
+    delay_bytes += bytes_per_packet;
+  }
+}
+
 }  // namespace media.
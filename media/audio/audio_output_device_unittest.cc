@@ -2,17 +2,23 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <vector>
 
 #include "base/at_exit.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "base/process_util.h"
 #include "base/shared_memory.h"
 #include "base/sync_socket.h"
 #include "base/test/test_timeouts.h"
+#include "base/threading/platform_thread.h"
+#include "base/time.h"
 #include "media/audio/audio_output_device.h"
 #include "media/audio/sample_rates.h"
+#include "media/audio/shared_memory_ring.h"
 #include "media/audio/shared_memory_util.h"
+#include "media/base/audio_bus.h"
 #include "testing/gmock/include/gmock/gmock.h"
 #include "testing/gmock_mutant.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -22,6 +28,7 @@ using base::SharedMemory;
 using base::SyncSocket;
 using testing::_;
 using testing::DoAll;
+using testing::InSequence;
 using testing::Invoke;
 using testing::Return;
 using testing::WithArgs;
@@ -52,8 +59,8 @@ class MockAudioOutputIPC : public AudioOutputIPC {
   MOCK_METHOD1(AddDelegate, int(AudioOutputIPCDelegate* delegate));
   MOCK_METHOD1(RemoveDelegate, void(int stream_id));
 
-  MOCK_METHOD2(CreateStream,
-      void(int stream_id, const AudioParameters& params));
+  MOCK_METHOD3(CreateStream,
+      void(int stream_id, const AudioParameters& params, int ring_slots));
   MOCK_METHOD1(PlayStream, void(int stream_id));
   MOCK_METHOD1(CloseStream, void(int stream_id));
   MOCK_METHOD2(SetVolume, void(int stream_id, double volume));
@@ -84,6 +91,14 @@ ACTION_P2(SendPendingBytes, socket, pending_bytes) {
   socket->Send(&pending_bytes, sizeof(pending_bytes));
 }
 
+// Fills every channel of the AudioBus passed to Render() with |value| and
+// reports the whole bus as rendered.
+ACTION_P(FillBusWithValue, value) {
+  for (int ch = 0; ch < arg0->channels(); ++ch)
+    std::fill(arg0->channel(ch), arg0->channel(ch) + arg0->frames(), value);
+  return arg0->frames();
+}
+
 // Used to terminate a loop from a different thread than the loop belongs to.
 // |loop| should be a MessageLoopProxy.
 ACTION_P(QuitLoop, loop) {
@@ -100,12 +115,23 @@ class AudioOutputDeviceTest
   ~AudioOutputDeviceTest();
 
   void StartAudioDevice();
-  void CreateStream();
+  void CreateStream(int ring_slots);
   void ExpectRenderCallback();
   void WaitUntilRenderCallback();
   void StopAudioDevice();
 
  protected:
+  // Expects the device to ask for the stream to play, and answers by waking
+  // its audio thread with |pending_bytes| as the browser would.
+  void ExpectPlayStream(int pending_bytes);
+
+  // Returns a consumer view of the ring created by CreateStream(ring_slots).
+  scoped_ptr<SharedMemoryRing> CreateBrowserRing(int ring_slots);
+
+  // Waits until the audio thread has queued |packets| packets in |ring|.
+  // Returns false if that does not happen within the action timeout.
+  bool WaitForQueuedPackets(const SharedMemoryRing& ring, int packets);
+
   // Used to clean up TLS pointers that the test(s) will initialize.
   // Must remain the first member of this class.
   base::ShadowingAtExitManager at_exit_manager_;
@@ -116,7 +142,8 @@ class AudioOutputDeviceTest
   scoped_refptr<AudioOutputDevice> audio_device_;
 
  private:
-  int CalculateMemorySize();
+  int CalculateIOBufferSize();
+  int CalculateMemorySize(int ring_slots);
 
   const bool synchronized_io_;
   const int input_channels_;
@@ -129,7 +156,7 @@ class AudioOutputDeviceTest
 
 static const int kStreamId = 123;
 
-int AudioOutputDeviceTest::CalculateMemorySize() {
+int AudioOutputDeviceTest::CalculateIOBufferSize() {
   // Calculate output and input memory size.
   int output_memory_size =
       AudioBus::CalculateMemorySize(default_audio_parameters_);
@@ -138,12 +165,18 @@ int AudioOutputDeviceTest::CalculateMemorySize() {
   int input_memory_size =
       AudioBus::CalculateMemorySize(input_channels_, frames);
 
-  int io_buffer_size = output_memory_size + input_memory_size;
+  return output_memory_size + input_memory_size;
+}
+
+int AudioOutputDeviceTest::CalculateMemorySize(int ring_slots) {
+  int io_buffer_size = CalculateIOBufferSize();
 
   // This is where it gets a bit hacky.  The shared memory contract between
   // AudioOutputDevice and its browser side counter part includes a bit more
   // than just the audio data, so we must call TotalSharedMemorySizeInBytes()
   // to get the actual size needed to fit the audio data plus the extra data.
+  if (ring_slots > 1)
+    return SharedMemoryRing::TotalSizeInBytes(io_buffer_size, ring_slots);
   return TotalSharedMemorySizeInBytes(io_buffer_size);
 }
 
@@ -176,16 +209,17 @@ AudioOutputDeviceTest::~AudioOutputDeviceTest() {
 void AudioOutputDeviceTest::StartAudioDevice() {
   audio_device_->Start();
 
-  EXPECT_CALL(audio_output_ipc_, CreateStream(kStreamId, _));
+  EXPECT_CALL(audio_output_ipc_, CreateStream(kStreamId, _, 1));
 
   io_loop_.RunUntilIdle();
 }
 
-void AudioOutputDeviceTest::CreateStream() {
-  const int kMemorySize = CalculateMemorySize();
+void AudioOutputDeviceTest::CreateStream(int ring_slots) {
+  const int kMemorySize = CalculateMemorySize(ring_slots);
 
   ASSERT_TRUE(shared_memory_.CreateAndMapAnonymous(kMemorySize));
-  memset(shared_memory_.memory(), 0xff, kMemorySize);
+  // The browser hands out a ring zero-filled, i.e. empty.
+  memset(shared_memory_.memory(), ring_slots > 1 ? 0 : 0xff, kMemorySize);
 
   ASSERT_TRUE(CancelableSyncSocket::CreatePair(&browser_socket_,
                                                &renderer_socket_));
@@ -201,7 +235,7 @@ void AudioOutputDeviceTest::CreateStream() {
                                             &duplicated_memory_handle));
 
   audio_device_->OnStreamCreated(duplicated_memory_handle, audio_device_socket,
-                                 PacketSizeInBytes(kMemorySize));
+                                 CalculateIOBufferSize() * ring_slots);
   io_loop_.RunUntilIdle();
 }
 
@@ -210,10 +244,7 @@ void AudioOutputDeviceTest::ExpectRenderCallback() {
   // Respond by asking for some audio data.  This should ask our callback
   // to provide some audio data that AudioOutputDevice then writes into the
   // shared memory section.
-  const int kMemorySize = CalculateMemorySize();
-
-  EXPECT_CALL(audio_output_ipc_, PlayStream(kStreamId))
-      .WillOnce(SendPendingBytes(&browser_socket_, kMemorySize));
+  ExpectPlayStream(CalculateMemorySize(1));
 
   // We expect calls to our audio renderer callback, which returns the number
   // of frames written to the memory section.
@@ -236,6 +267,31 @@ void AudioOutputDeviceTest::ExpectRenderCallback() {
   }
 }
 
+void AudioOutputDeviceTest::ExpectPlayStream(int pending_bytes) {
+  EXPECT_CALL(audio_output_ipc_, PlayStream(kStreamId))
+      .WillOnce(SendPendingBytes(&browser_socket_, pending_bytes));
+}
+
+scoped_ptr<SharedMemoryRing> AudioOutputDeviceTest::CreateBrowserRing(
+    int ring_slots) {
+  return scoped_ptr<SharedMemoryRing>(new SharedMemoryRing(
+      shared_memory_.memory(), CalculateIOBufferSize(), ring_slots));
+}
+
+bool AudioOutputDeviceTest::WaitForQueuedPackets(const SharedMemoryRing& ring,
+                                                 int packets) {
+  // The audio thread commits a packet only after Render() returns, so there
+  // is nothing to wait on but the ring itself.
+  const base::TimeTicks deadline =
+      base::TimeTicks::Now() + TestTimeouts::action_timeout();
+  while (ring.AvailableToRead() < packets) {
+    if (base::TimeTicks::Now() > deadline)
+      return false;
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+  }
+  return true;
+}
+
 void AudioOutputDeviceTest::WaitUntilRenderCallback() {
   // Don't hang the test if we never get the Render() callback.
   io_loop_.PostDelayedTask(FROM_HERE, MessageLoop::QuitClosure(),
@@ -282,18 +338,73 @@ TEST_P(AudioOutputDeviceTest, StopBeforeRender) {
   // Expect us to shutdown IPC but not to render anything despite the stream
   // getting created.
   EXPECT_CALL(audio_output_ipc_, CloseStream(kStreamId));
-  CreateStream();
+  CreateStream(1);
 }
 
 // Full test with output only.
 TEST_P(AudioOutputDeviceTest, CreateStream) {
   StartAudioDevice();
   ExpectRenderCallback();
-  CreateStream();
+  CreateStream(1);
   WaitUntilRenderCallback();
   StopAudioDevice();
 }
 
+// If the browser allocated a ring, the first request for data fills every
+// packet, each played after the previous one.
+TEST_P(AudioOutputDeviceTest, CreateRingStream) {
+  // Synchronized input is delivered one packet at a time and can't use a ring.
+  if (GetParam())
+    return;
+
+  const int kRingSlots = 3;
+  StartAudioDevice();
+  ExpectPlayStream(0);
+
+  // Each packet is filled with its own value. 1024 frames at 48 kHz last
+  // 21 ms, so each packet is reported to play that much after the previous.
+  {
+    InSequence s;
+    EXPECT_CALL(callback_, Render(_, 0))
+        .WillOnce(FillBusWithValue(0.25f));
+    EXPECT_CALL(callback_, Render(_, 21))
+        .WillOnce(FillBusWithValue(0.5f));
+    EXPECT_CALL(callback_, Render(_, 42))
+        .WillOnce(DoAll(
+            QuitLoop(io_loop_.message_loop_proxy()),
+            FillBusWithValue(0.75f)));
+  }
+
+  CreateStream(kRingSlots);
+  WaitUntilRenderCallback();
+
+  // Read the packets back as AudioSyncReader would: all of them are queued,
+  // complete and in render order.
+  scoped_ptr<SharedMemoryRing> ring = CreateBrowserRing(kRingSlots);
+  ASSERT_TRUE(WaitForQueuedPackets(*ring, kRingSlots));
+  EXPECT_EQ(0, ring->AvailableToWrite());
+
+  const float kExpectedValues[] = { 0.25f, 0.5f, 0.75f };
+  const uint32 kPacketDataSize =
+      default_audio_parameters_.frames_per_buffer() * sizeof(float) *
+      default_audio_parameters_.channels();
+  for (int i = 0; i < kRingSlots; ++i) {
+    ASSERT_EQ(kPacketDataSize, ring->ReadDataSize());
+    scoped_ptr<AudioBus> packet = AudioBus::WrapMemory(
+        default_audio_parameters_, ring->Packet(ring->ReadSlot()));
+    for (int ch = 0; ch < packet->channels(); ++ch) {
+      EXPECT_EQ(kExpectedValues[i], packet->channel(ch)[0]);
+      EXPECT_EQ(kExpectedValues[i],
+                packet->channel(ch)[packet->frames() - 1]);
+    }
+    ring->CommitRead();
+  }
+  EXPECT_EQ(0, ring->AvailableToRead());
+  EXPECT_EQ(kRingSlots, ring->AvailableToWrite());
+
+  StopAudioDevice();
+}
+
 INSTANTIATE_TEST_CASE_P(Render, AudioOutputDeviceTest, Values(false));
 INSTANTIATE_TEST_CASE_P(RenderIO, AudioOutputDeviceTest, Values(true));
 
@@ -33,6 +33,8 @@ class MEDIA_EXPORT AudioOutputIPCDelegate {
   // The shared memory |handle| points to a memory section that's used to
   // transfer audio buffers from the AudioOutputIPCDelegate back to the
   // AudioRendererHost.  The implementation of OnStreamCreated takes ownership.
+  // |length| is the size of all audio packets in the memory section, i.e. a
+  // multiple of the packet size if a ring was requested.
   // The |socket_handle| is used by AudioRendererHost to signal requests for
   // audio data to be written into the shared memory. The AudioOutputIPCDelegate
   // must read from this socket and provide audio whenever data (search for
@@ -69,11 +71,15 @@ class MEDIA_EXPORT AudioOutputIPC {
   // Sends a request to create an AudioOutputController object in the peer
   // process, identify it by |stream_id| and configure it to use the specified
   // audio |params| including number of synchronized input channels.
+  // If |ring_slots| is larger than one, the shared memory holds a
+  // SharedMemoryRing of that many packets instead of a single packet; this
+  // requires that |params| has no input channels.
   // Once the stream has been created, the implementation must
   // generate a notification to the AudioOutputIPCDelegate and call
   // OnStreamCreated().
   virtual void CreateStream(int stream_id,
-                            const AudioParameters& params) = 0;
+                            const AudioParameters& params,
+                            int ring_slots) = 0;
 
   // Starts playing the stream.  This should generate a call to
   // AudioOutputController::Play().
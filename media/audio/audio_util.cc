@@ -24,6 +24,7 @@
 #include "base/time.h"
 #include "media/audio/audio_parameters.h"
 #include "media/base/audio_bus.h"
+#include "media/base/limits.h"
 #include "media/base/media_switches.h"
 
 #if defined(OS_MACOSX)
@@ -35,7 +36,6 @@
 #include "media/audio/win/audio_low_latency_input_win.h"
 #include "media/audio/win/audio_low_latency_output_win.h"
 #include "media/audio/win/core_audio_util_win.h"
-#include "media/base/limits.h"
 #endif
 
 namespace media {
@@ -262,6 +262,15 @@ size_t GetHighLatencyOutputBufferSize(int sample_rate) {
   return samples;
 }
 
+int GetAudioOutputRingSlots() {
+  int slots = 0;
+  std::string slots_str(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+      switches::kAudioOutputRingSlots));
+  if (base::StringToInt(slots_str, &slots) && slots > 0)
+    return std::min(slots, static_cast<int>(limits::kMaxAudioRingSlots));
+  return 1;
+}
+
 #if defined(OS_WIN)
 
 int NumberOfWaveOutBuffers() {
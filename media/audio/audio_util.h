@@ -59,6 +59,11 @@ MEDIA_EXPORT ChannelLayout GetAudioInputHardwareChannelLayout(
 // conjunction with AUDIO_PCM_LINEAR.
 MEDIA_EXPORT size_t GetHighLatencyOutputBufferSize(int sample_rate);
 
+// Returns the number of packets AudioOutputDevice should render ahead of the
+// audio output stream, as specified on the command line.  Defaults to 1, which
+// disables the shared memory ring.
+MEDIA_EXPORT int GetAudioOutputRingSlots();
+
 #if defined(OS_WIN)
 
 // Returns number of buffers to be used by wave out.
@@ -0,0 +1,115 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/audio/shared_memory_ring.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+using base::subtle::Atomic32;
+
+namespace media {
+
+// Word offsets of the counters after the packet sizes.
+enum {
+  kWrittenIndex = 0,
+  kReadIndex = 1,
+  kNumCounters = 2,
+};
+
+uint32 SharedMemoryRing::TotalSizeInBytes(uint32 packet_size, int slots) {
+  DCHECK_EQ(0u, packet_size & 3);
+  DCHECK_GT(slots, 0);
+  return (packet_size + sizeof(Atomic32)) * slots +
+      kNumCounters * sizeof(Atomic32);
+}
+
+SharedMemoryRing::SharedMemoryRing(void* memory, uint32 packet_size,
+                                   int slots)
+    : memory_(static_cast<char*>(memory)),
+      packet_size_(packet_size),
+      slots_(slots) {
+  DCHECK(memory_);
+  DCHECK_EQ(0u, packet_size_ & 3);
+  DCHECK_GT(slots_, 0);
+}
+
+SharedMemoryRing::~SharedMemoryRing() {}
+
+void* SharedMemoryRing::Packet(int slot) const {
+  DCHECK_GE(slot, 0);
+  DCHECK_LT(slot, slots_);
+  return memory_ + packet_size_ * slot;
+}
+
+int SharedMemoryRing::AvailableToWrite() const {
+  return slots_ - Queued();
+}
+
+int SharedMemoryRing::WriteSlot() const {
+  return LoadCounter(kWrittenIndex) % slots_;
+}
+
+void SharedMemoryRing::CommitWrite(uint32 data_size) {
+  DCHECK_GT(AvailableToWrite(), 0);
+  uint32 written = LoadCounter(kWrittenIndex);
+  base::subtle::NoBarrier_Store(DataSizeWord(written % slots_), data_size);
+
+  // Publish the packet and its size to the consumer.
+  StoreCounter(kWrittenIndex, written + 1);
+}
+
+int SharedMemoryRing::AvailableToRead() const {
+  return Queued();
+}
+
+int SharedMemoryRing::ReadSlot() const {
+  return LoadCounter(kReadIndex) % slots_;
+}
+
+uint32 SharedMemoryRing::ReadDataSize() const {
+  uint32 size = base::subtle::NoBarrier_Load(DataSizeWord(ReadSlot()));
+  return std::min(size, packet_size_);
+}
+
+void SharedMemoryRing::CommitRead() {
+  DCHECK_GT(AvailableToRead(), 0);
+
+  // Hand the slot back to the producer only after its data has been consumed.
+  StoreCounter(kReadIndex, LoadCounter(kReadIndex) + 1);
+}
+
+void SharedMemoryRing::Clear() {
+  StoreCounter(kReadIndex, LoadCounter(kWrittenIndex));
+}
+
+int SharedMemoryRing::Queued() const {
+  const uint32 wrap = 2 * slots_;
+  uint32 written = LoadCounter(kWrittenIndex);
+  uint32 read = LoadCounter(kReadIndex);
+
+  // The difference of the counters is the number of queued packets.  It is
+  // only larger than |slots_| if the memory was tampered with.
+  return static_cast<int>(std::min((written + wrap - read) % wrap,
+                                   static_cast<uint32>(slots_)));
+}
+
+uint32 SharedMemoryRing::LoadCounter(int index) const {
+  uint32 value = base::subtle::Acquire_Load(DataSizeWord(0) + slots_ + index);
+  return value % (2 * slots_);
+}
+
+void SharedMemoryRing::StoreCounter(int index, uint32 value) {
+  base::subtle::Release_Store(DataSizeWord(0) + slots_ + index,
+                              value % (2 * slots_));
+}
+
+volatile Atomic32* SharedMemoryRing::DataSizeWord(int slot) const {
+  char* ptr = memory_ + packet_size_ * slots_;
+  DCHECK_EQ(0u, reinterpret_cast<size_t>(ptr) & 3);
+  return reinterpret_cast<volatile Atomic32*>(ptr) + slot;
+}
+
+}  // namespace media
@@ -0,0 +1,84 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_AUDIO_SHARED_MEMORY_RING_H_
+#define MEDIA_AUDIO_SHARED_MEMORY_RING_H_
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+// A single producer, single consumer ring of audio packets in memory shared
+// between the renderer (producer) and the browser (consumer) process.  It lets
+// the renderer render several packets ahead so that the browser can pull a
+// packet without waiting for the renderer unless the ring has run empty.
+//
+// The memory holds |slots| packets of |packet_size| bytes, followed by one
+// word per packet holding the size of its data and two words counting the
+// packets written and read so far:
+//
+//   [packet 0]...[packet N-1][size 0]...[size N-1][written][read]
+//
+// The counters run modulo twice the number of slots, which tells a full ring
+// from an empty one.  Each counter is only modified by one side, so no locking
+// is needed.  Since the renderer is not trusted, all values read by the
+// consumer are clamped to valid ranges.
+class MEDIA_EXPORT SharedMemoryRing {
+ public:
+  // Returns the number of bytes of memory needed for a ring of |slots| packets
+  // of |packet_size| bytes.  |packet_size| must be a multiple of 4.
+  static uint32 TotalSizeInBytes(uint32 packet_size, int slots);
+
+  // |memory| must be at least TotalSizeInBytes(packet_size, slots) bytes long
+  // and outlive this object.  Newly created shared memory is zero-filled,
+  // which is an empty ring.
+  SharedMemoryRing(void* memory, uint32 packet_size, int slots);
+  ~SharedMemoryRing();
+
+  // Returns the memory of packet |slot|.
+  void* Packet(int slot) const;
+
+  // Producer side.  Returns the number of packets which may be written, the
+  // slot the next packet goes to, and publishes that packet holding
+  // |data_size| bytes.
+  int AvailableToWrite() const;
+  int WriteSlot() const;
+  void CommitWrite(uint32 data_size);
+
+  // Consumer side.  Returns the number of packets which may be read, the slot
+  // and data size of the next one, and releases that packet to the producer.
+  int AvailableToRead() const;
+  int ReadSlot() const;
+  uint32 ReadDataSize() const;
+  void CommitRead();
+
+  // Consumer side.  Drops all packets written so far.
+  void Clear();
+
+  int slots() const { return slots_; }
+  uint32 packet_size() const { return packet_size_; }
+
+ private:
+  // Returns the number of written packets not read yet, at most |slots_|.
+  int Queued() const;
+
+  // Loads and stores the counter at word |index| after the packet sizes.
+  uint32 LoadCounter(int index) const;
+  void StoreCounter(int index, uint32 value);
+
+  // Returns the word holding the data size of packet |slot|.
+  volatile base::subtle::Atomic32* DataSizeWord(int slot) const;
+
+  char* const memory_;
+  const uint32 packet_size_;
+  const int slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedMemoryRing);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_AUDIO_SHARED_MEMORY_RING_H_
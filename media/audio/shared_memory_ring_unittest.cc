@@ -0,0 +1,146 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+
+#include "base/memory/scoped_ptr.h"
+#include "media/audio/shared_memory_ring.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const uint32 kPacketSize = 64;
+static const int kSlots = 3;
+
+class SharedMemoryRingTest : public testing::Test {
+ public:
+  SharedMemoryRingTest()
+      : size_(SharedMemoryRing::TotalSizeInBytes(kPacketSize, kSlots)),
+        memory_(new uint32[size_ / sizeof(uint32)]) {
+    memset(memory_.get(), 0, size_);
+    producer_.reset(new SharedMemoryRing(memory_.get(), kPacketSize, kSlots));
+    consumer_.reset(new SharedMemoryRing(memory_.get(), kPacketSize, kSlots));
+  }
+
+ protected:
+  // Writes a packet filled with |value| holding |data_size| bytes.
+  void WritePacket(uint8 value, uint32 data_size) {
+    ASSERT_GT(producer_->AvailableToWrite(), 0);
+    memset(producer_->Packet(producer_->WriteSlot()), value, kPacketSize);
+    producer_->CommitWrite(data_size);
+  }
+
+  // Reads the next packet and returns its first byte.
+  uint8 ReadPacket() {
+    EXPECT_GT(consumer_->AvailableToRead(), 0);
+    uint8 value =
+        *static_cast<uint8*>(consumer_->Packet(consumer_->ReadSlot()));
+    consumer_->CommitRead();
+    return value;
+  }
+
+  // Overwrites the word |offset| words after the packet sizes.
+  void CorruptCounter(int offset, uint32 value) {
+    uint32* words =
+        memory_.get() + (kPacketSize * kSlots) / sizeof(uint32) + kSlots;
+    words[offset] = value;
+  }
+
+  uint32 size_;
+  scoped_array<uint32> memory_;
+  scoped_ptr<SharedMemoryRing> producer_;
+  scoped_ptr<SharedMemoryRing> consumer_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SharedMemoryRingTest);
+};
+
+TEST_F(SharedMemoryRingTest, TotalSize) {
+  EXPECT_EQ((kPacketSize + 4) * kSlots + 8, size_);
+}
+
+TEST_F(SharedMemoryRingTest, Empty) {
+  EXPECT_EQ(kSlots, producer_->AvailableToWrite());
+  EXPECT_EQ(0, consumer_->AvailableToRead());
+  EXPECT_EQ(0, producer_->WriteSlot());
+  EXPECT_EQ(0, consumer_->ReadSlot());
+}
+
+TEST_F(SharedMemoryRingTest, WriteAndRead) {
+  WritePacket(1, kPacketSize);
+  WritePacket(2, kPacketSize / 2);
+  EXPECT_EQ(2, consumer_->AvailableToRead());
+  EXPECT_EQ(kSlots - 2, producer_->AvailableToWrite());
+
+  EXPECT_EQ(kPacketSize, consumer_->ReadDataSize());
+  EXPECT_EQ(1, ReadPacket());
+  EXPECT_EQ(kPacketSize / 2, consumer_->ReadDataSize());
+  EXPECT_EQ(2, ReadPacket());
+
+  EXPECT_EQ(0, consumer_->AvailableToRead());
+  EXPECT_EQ(kSlots, producer_->AvailableToWrite());
+}
+
+TEST_F(SharedMemoryRingTest, Full) {
+  for (int i = 0; i < kSlots; ++i)
+    WritePacket(i, kPacketSize);
+  EXPECT_EQ(0, producer_->AvailableToWrite());
+  EXPECT_EQ(kSlots, consumer_->AvailableToRead());
+
+  EXPECT_EQ(0, ReadPacket());
+  EXPECT_EQ(1, producer_->AvailableToWrite());
+  EXPECT_EQ(0, producer_->WriteSlot());
+}
+
+// Packets must come out in order across many wraps of the slots.
+TEST_F(SharedMemoryRingTest, WrapAround) {
+  uint8 next_write = 0;
+  uint8 next_read = 0;
+  for (int i = 0; i < 100; ++i) {
+    while (producer_->AvailableToWrite() > 0)
+      WritePacket(next_write++, kPacketSize);
+    // Read one packet fewer than available so the slots keep shifting.
+    int to_read = std::max(consumer_->AvailableToRead() - (i % 2), 1);
+    for (int j = 0; j < to_read; ++j)
+      EXPECT_EQ(next_read++, ReadPacket());
+  }
+}
+
+// Any counter values left in the memory must be handled.
+TEST_F(SharedMemoryRingTest, ArbitraryCounters) {
+  CorruptCounter(0, kuint32max);
+  CorruptCounter(1, kuint32max);
+  EXPECT_EQ(0, consumer_->AvailableToRead());
+
+  for (int i = 0; i < kSlots; ++i)
+    WritePacket(i, kPacketSize);
+  EXPECT_EQ(kSlots, consumer_->AvailableToRead());
+  for (int i = 0; i < kSlots; ++i)
+    EXPECT_EQ(i, ReadPacket());
+  EXPECT_EQ(0, consumer_->AvailableToRead());
+}
+
+TEST_F(SharedMemoryRingTest, Clear) {
+  WritePacket(1, kPacketSize);
+  WritePacket(2, kPacketSize);
+  consumer_->Clear();
+  EXPECT_EQ(0, consumer_->AvailableToRead());
+  EXPECT_EQ(kSlots, producer_->AvailableToWrite());
+
+  WritePacket(3, kPacketSize);
+  EXPECT_EQ(3, ReadPacket());
+}
+
+// Values written by a misbehaving producer must be clamped.
+TEST_F(SharedMemoryRingTest, SanitizesProducerValues) {
+  WritePacket(1, kPacketSize * 10);
+  EXPECT_EQ(kPacketSize, consumer_->ReadDataSize());
+
+  CorruptCounter(0, 1000);
+  EXPECT_EQ(kSlots, consumer_->AvailableToRead());
+  EXPECT_LT(consumer_->ReadSlot(), kSlots);
+  EXPECT_LE(consumer_->ReadDataSize(), kPacketSize);
+}
+
+}  // namespace media
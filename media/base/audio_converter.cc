@@ -96,6 +96,7 @@ void AudioConverter::RemoveInput(InputCallback* input) {
   DCHECK(std::find(transform_inputs_.begin(), transform_inputs_.end(), input) !=
          transform_inputs_.end());
   transform_inputs_.remove(input);
+  last_volumes_.erase(input);
 
   if (transform_inputs_.empty())
     Reset();
@@ -106,6 +107,7 @@ void AudioConverter::Reset() {
     audio_fifo_->Clear();
   if (resampler_)
     resampler_->Flush();
+  last_volumes_.clear();
 }
 
 void AudioConverter::Convert(AudioBus* dest) {
@@ -136,12 +138,6 @@ void AudioConverter::Convert(AudioBus* dest) {
 void AudioConverter::SourceCallback(int fifo_frame_delay, AudioBus* dest) {
   bool needs_downmix = channel_mixer_ && downmix_early_;
 
-  if (!mixer_input_audio_bus_ ||
-      mixer_input_audio_bus_->frames() != dest->frames()) {
-    mixer_input_audio_bus_ =
-        AudioBus::Create(input_channel_count_, dest->frames());
-  }
-
   if (needs_downmix &&
       (!unmixed_audio_ || unmixed_audio_->frames() != dest->frames())) {
     // If we're downmixing early we need a temporary AudioBus which matches
@@ -153,8 +149,7 @@ void AudioConverter::SourceCallback(int fifo_frame_delay, AudioBus* dest) {
   AudioBus* temp_dest = needs_downmix ? unmixed_audio_.get() : dest;
 
   // Sanity check our inputs.
-  DCHECK_EQ(temp_dest->frames(), mixer_input_audio_bus_->frames());
-  DCHECK_EQ(temp_dest->channels(), mixer_input_audio_bus_->channels());
+  DCHECK_EQ(temp_dest->channels(), input_channel_count_);
 
   // Calculate the buffer delay for this callback.
   base::TimeDelta buffer_delay;
@@ -167,41 +162,89 @@ void AudioConverter::SourceCallback(int fifo_frame_delay, AudioBus* dest) {
         fifo_frame_delay * input_frame_duration_.InMicroseconds());
   }
 
-  // Have each mixer render its data into an output buffer then mix the result.
+  // Have each input render its data into the next free bus, then mix the
+  // buses into |temp_dest| a batch at a time. Silent inputs don't take up a
+  // bus, so they cost nothing beyond rendering.
+  bool first_mix = true;
+  int batch_size = 0;
   for (InputCallbackSet::iterator it = transform_inputs_.begin();
        it != transform_inputs_.end(); ++it) {
     InputCallback* input = *it;
 
-    float volume = input->ProvideInput(
-        mixer_input_audio_bus_.get(), buffer_delay);
-
-    // Optimize the most common single input, full volume case.
-    if (it == transform_inputs_.begin()) {
-      if (volume == 1.0f) {
-        mixer_input_audio_bus_->CopyTo(temp_dest);
-        continue;
-      }
-
-      // Zero |temp_dest| otherwise, so we're mixing into a clean buffer.
-      temp_dest->Zero();
+    const float volume = input->ProvideInput(
+        GetMixerInputAudioBus(batch_size, temp_dest->frames()), buffer_delay);
+
+    // Ramp from the volume this input was last mixed at. There's no need to
+    // ramp from or to silence: a silent input was either just started or had
+    // nothing to play.
+    float start_volume = volume;
+    std::pair<VolumeMap::iterator, bool> last_volume =
+        last_volumes_.insert(std::make_pair(input, volume));
+    if (!last_volume.second) {
+      if (volume > 0 && last_volume.first->second > 0)
+        start_volume = last_volume.first->second;
+      last_volume.first->second = volume;
     }
 
-    // Volume adjust and mix each mixer input into |temp_dest| after rendering.
-    if (volume > 0) {
-      for (int i = 0; i < mixer_input_audio_bus_->channels(); ++i) {
-        vector_math::FMAC(
-            mixer_input_audio_bus_->channel(i), volume,
-            mixer_input_audio_bus_->frames(), temp_dest->channel(i));
-      }
+    if (volume <= 0)
+      continue;
+
+    start_volumes_[batch_size] = start_volume;
+    end_volumes_[batch_size] = volume;
+    if (++batch_size == kMaxInputsPerMix) {
+      MixInputs(batch_size, first_mix, temp_dest);
+      first_mix = false;
+      batch_size = 0;
     }
   }
 
+  if (batch_size > 0 || first_mix)
+    MixInputs(batch_size, first_mix, temp_dest);
+
   if (needs_downmix) {
     DCHECK_EQ(temp_dest->frames(), dest->frames());
     channel_mixer_->Transform(temp_dest, dest);
   }
 }
 
+AudioBus* AudioConverter::GetMixerInputAudioBus(int index, int frames) {
+  scoped_ptr<AudioBus>& bus = mixer_input_audio_buses_[index];
+  if (!bus || bus->frames() != frames)
+    bus = AudioBus::Create(input_channel_count_, frames);
+  return bus.get();
+}
+
+void AudioConverter::MixInputs(int count, bool first_mix, AudioBus* dest) {
+  int first_input = 0;
+  if (first_mix) {
+    // Optimize the most common single input, full volume case.
+    if (count > 0 && start_volumes_[0] == 1.0f && end_volumes_[0] == 1.0f) {
+      mixer_input_audio_buses_[0]->CopyTo(dest);
+      first_input = 1;
+    } else {
+      // Zero |dest| otherwise, so we're mixing into a clean buffer.
+      dest->Zero();
+    }
+  }
+
+  if (first_input == count)
+    return;
+
+  // Volume adjust and mix the remaining inputs into |dest| in one pass per
+  // channel.
+  const float* input_channels[kMaxInputsPerMix];
+  for (int ch = 0; ch < dest->channels(); ++ch) {
+    for (int i = first_input; i < count; ++i) {
+      const AudioBus* input_bus = mixer_input_audio_buses_[i].get();
+      DCHECK_EQ(dest->frames(), input_bus->frames());
+      input_channels[i - first_input] = input_bus->channel(ch);
+    }
+    vector_math::FMACMulti(input_channels, &start_volumes_[first_input],
+                           &end_volumes_[first_input], count - first_input,
+                           dest->frames(), dest->channel(ch));
+  }
+}
+
 void AudioConverter::ProvideInput(int resampler_frame_delay, AudioBus* dest) {
   resampler_frame_delay_ = resampler_frame_delay;
   if (audio_fifo_)
@@ -6,6 +6,7 @@
 #define MEDIA_BASE_AUDIO_CONVERTER_H_
 
 #include <list>
+#include <map>
 
 #include "base/callback.h"
 #include "base/time.h"
@@ -64,12 +65,24 @@ class MEDIA_EXPORT AudioConverter {
   void Reset();
 
  private:
+  // Number of inputs rendered before they are mixed into the destination in a
+  // single pass with vector_math::FMACMulti().
+  enum { kMaxInputsPerMix = 8 };
+
   // Called by MultiChannelResampler when more data is necessary.
   void ProvideInput(int resampler_frame_delay, AudioBus* audio_bus);
 
   // Called by AudioPullFifo when more data is necessary.
   void SourceCallback(int fifo_frame_delay, AudioBus* audio_bus);
 
+  // Returns the |index|th temporary input bus, sized to |frames|.
+  AudioBus* GetMixerInputAudioBus(int index, int frames);
+
+  // Mixes the first |count| buses in |mixer_input_audio_buses_| into |dest|
+  // using the gains in |start_volumes_| and |end_volumes_|. If |first_mix| is
+  // true |dest| holds no data yet and is overwritten.
+  void MixInputs(int count, bool first_mix, AudioBus* dest);
+
   // Set of inputs for Convert().
   typedef std::list<InputCallback*> InputCallbackSet;
   InputCallbackSet transform_inputs_;
@@ -86,8 +99,18 @@ class MEDIA_EXPORT AudioConverter {
   scoped_ptr<ChannelMixer> channel_mixer_;
   scoped_ptr<AudioBus> unmixed_audio_;
 
-  // Temporary AudioBus destination for mixing inputs.
-  scoped_ptr<AudioBus> mixer_input_audio_bus_;
+  // Temporary AudioBus destinations for mixing inputs. Inputs are rendered
+  // into these in batches which are then mixed in a single pass.
+  scoped_ptr<AudioBus> mixer_input_audio_buses_[kMaxInputsPerMix];
+
+  // Gains used to mix each bus in |mixer_input_audio_buses_|.
+  float start_volumes_[kMaxInputsPerMix];
+  float end_volumes_[kMaxInputsPerMix];
+
+  // The volume each input was mixed at last. Used to ramp between volumes
+  // rather than jumping, which causes audible clicks.
+  typedef std::map<InputCallback*, float> VolumeMap;
+  VolumeMap last_volumes_;
 
   // Since resampling is expensive, figure out if we should downmix channels
   // before resampling.
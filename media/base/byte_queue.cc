@@ -4,23 +4,54 @@
 
 #include "media/base/byte_queue.h"
 
+#include <algorithm>
+
 #include "base/logging.h"
+#include "media/base/decoder_buffer.h"
 
 namespace media {
 
 // Default starting size for the queue.
 enum { kDefaultQueueSize = 1024 };
 
+// A block of memory followed by DecoderBuffer::kPaddingSize zeroed bytes so
+// that slices of it can be handed to decoders directly.
+class ByteQueue::Segment : public base::RefCountedMemory {
+ public:
+  explicit Segment(size_t capacity)
+      : data_(new uint8[capacity + DecoderBuffer::kPaddingSize]),
+        capacity_(capacity) {
+    memset(data_.get() + capacity_, 0, DecoderBuffer::kPaddingSize);
+  }
+
+  // base::RefCountedMemory implementation.
+  virtual const unsigned char* front() const OVERRIDE { return data_.get(); }
+  virtual size_t size() const OVERRIDE {
+    return capacity_ + DecoderBuffer::kPaddingSize;
+  }
+
+  uint8* data() const { return data_.get(); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  virtual ~Segment() {}
+
+  scoped_array<uint8> data_;
+  const size_t capacity_;
+
+  DISALLOW_COPY_AND_ASSIGN(Segment);
+};
+
 ByteQueue::ByteQueue()
-    : buffer_(new uint8[kDefaultQueueSize]),
-      size_(kDefaultQueueSize),
-      offset_(0),
+    : offset_(0),
       used_(0) {
 }
 
 ByteQueue::~ByteQueue() {}
 
 void ByteQueue::Reset() {
+  // Buffers may still refer to the segment, so it must not be written again.
+  segment_ = NULL;
   offset_ = 0;
   used_ = 0;
 }
@@ -30,28 +61,37 @@ void ByteQueue::Push(const uint8* data, int size) {
   DCHECK_GT(size, 0);
 
   size_t size_needed = used_ + size;
+  size_t capacity = segment_ ? segment_->capacity() : 0;
 
-  // Check to see if we need a bigger buffer.
-  if (size_needed > size_) {
-    size_t new_size = 2 * size_;
-    while (size_needed > new_size && new_size > size_)
-      new_size *= 2;
+  // Buffers referring to the segment may be read by decoders on other
+  // threads, including the padding past their data, so a segment referenced
+  // elsewhere is never written again.
+  bool writable = segment_ && segment_->HasOneRef();
+  if (writable && used_ == 0 && size_needed <= capacity) {
+    offset_ = 0;
+  } else if (!writable || offset_ + size_needed > capacity) {
+    // Start a new segment rather than moving the queue within this one.
+    // Grow geometrically while the bytes at the front fill most of the
+    // segment waiting for more data, so that appending in small pieces stays
+    // linear; otherwise size the segment to fit, as buffers may keep it alive
+    // for a long time.
+    size_t new_size = std::max(size_needed,
+                               static_cast<size_t>(kDefaultQueueSize));
+    if (2 * static_cast<size_t>(used_) > capacity)
+      new_size = std::max(new_size, 2 * capacity);
 
     // Sanity check to make sure we didn't overflow.
-    CHECK_GT(new_size, size_);
+    CHECK_GE(new_size, size_needed);
 
-    scoped_array<uint8> new_buffer(new uint8[new_size]);
-
-    // Copy the data from the old buffer to the start of the new one.
+    scoped_refptr<Segment> new_segment(new Segment(new_size));
     if (used_ > 0)
-      memcpy(new_buffer.get(), front(), used_);
+      memcpy(new_segment->data(), front(), used_);
 
-    buffer_.reset(new_buffer.release());
-    size_ = new_size;
-    offset_ = 0;
-  } else if ((offset_ + used_ + size) > size_) {
-    // The buffer is big enough, but we need to move the data in the queue.
-    memmove(buffer_.get(), front(), used_);
+    // Keep the bytes past the queue zeroed, so that slices ending at the back
+    // of the queue are padded like an allocated DecoderBuffer.
+    memset(new_segment->data() + size_needed, 0, new_size - size_needed);
+
+    segment_ = new_segment;
     offset_ = 0;
   }
 
@@ -62,7 +102,7 @@ void ByteQueue::Push(const uint8* data, int size) {
 void ByteQueue::Peek(const uint8** data, int* size) const {
   DCHECK(data);
   DCHECK(size);
-  *data = front();
+  *data = segment_ ? front() : NULL;
   *size = used_;
 }
 
@@ -71,14 +111,12 @@ void ByteQueue::Pop(int count) {
 
   offset_ += count;
   used_ -= count;
+}
 
-  // Move the offset back to 0 if we have reached the end of the buffer.
-  if (offset_ == size_) {
-    DCHECK_EQ(used_, 0);
-    offset_ = 0;
-  }
+scoped_refptr<base::RefCountedMemory> ByteQueue::segment() const {
+  return segment_;
 }
 
-uint8* ByteQueue::front() const { return buffer_.get() + offset_; }
+uint8* ByteQueue::front() const { return segment_->data() + offset_; }
 
 }  // namespace media
@@ -6,7 +6,8 @@
 #define MEDIA_BASE_BYTE_QUEUE_H_
 
 #include "base/basictypes.h"
-#include "base/memory/scoped_ptr.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "media/base/media_export.h"
 
 namespace media {
@@ -16,6 +17,12 @@ namespace media {
 // Pop(). The contents of the queue can be observed via the Peek() method.
 // This class manages the underlying storage of the queue and tries to minimize
 // the number of buffer copies when data is appended and removed.
+//
+// The bytes are stored in reference counted segments which are never moved
+// or reused while referenced elsewhere.  When the current segment is full, the
+// bytes not popped yet are copied to a new segment along with the new bytes
+// and the old segment is dropped.  Parsers may keep a reference to segment()
+// to hand out buffers which refer to the queue's memory instead of copying it.
 class MEDIA_EXPORT ByteQueue {
  public:
   ByteQueue();
@@ -35,16 +42,23 @@ class MEDIA_EXPORT ByteQueue {
   // Remove |count| bytes from the front of the queue.
   void Pop(int count);
 
+  // Returns the memory the data returned by Peek() lies in, NULL if nothing
+  // was pushed since the last Reset().  Holding a reference keeps that data
+  // valid across later calls, as the queue never writes to a segment
+  // referenced elsewhere.  The memory extends at least
+  // DecoderBuffer::kPaddingSize bytes past the end of the queue, and the bytes
+  // past the end of the queue are zero until the next Push().
+  scoped_refptr<base::RefCountedMemory> segment() const;
+
  private:
+  class Segment;
+
   // Returns a pointer to the front of the queue.
   uint8* front() const;
 
-  scoped_array<uint8> buffer_;
-
-  // Size of |buffer_|.
-  size_t size_;
+  scoped_refptr<Segment> segment_;
 
-  // Offset from the start of |buffer_| that marks the front of the queue.
+  // Offset from the start of |segment_| that marks the front of the queue.
   size_t offset_;
 
   // Number of bytes stored in the queue.
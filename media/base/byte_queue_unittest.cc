@@ -0,0 +1,152 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "media/base/byte_queue.h"
+#include "media/base/decoder_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+// Returns |size| bytes counting up from |first|.
+static std::vector<uint8> MakeData(uint8 first, int size) {
+  std::vector<uint8> data(size);
+  for (int i = 0; i < size; ++i)
+    data[i] = first + i;
+  return data;
+}
+
+static void Push(ByteQueue* queue, const std::vector<uint8>& data) {
+  queue->Push(&data[0], data.size());
+}
+
+TEST(ByteQueueTest, PushPeekPop) {
+  ByteQueue queue;
+  const uint8* data;
+  int size;
+  queue.Peek(&data, &size);
+  EXPECT_EQ(0, size);
+  EXPECT_FALSE(queue.segment());
+
+  std::vector<uint8> bytes = MakeData(0, 100);
+  Push(&queue, bytes);
+  queue.Peek(&data, &size);
+  ASSERT_EQ(100, size);
+  EXPECT_EQ(0, memcmp(&bytes[0], data, size));
+
+  queue.Pop(40);
+  queue.Peek(&data, &size);
+  ASSERT_EQ(60, size);
+  EXPECT_EQ(0, memcmp(&bytes[40], data, size));
+
+  queue.Reset();
+  queue.Peek(&data, &size);
+  EXPECT_EQ(0, size);
+  EXPECT_FALSE(queue.segment());
+}
+
+// Bytes not popped yet must stay contiguous with bytes pushed later, however
+// many segments that takes.
+TEST(ByteQueueTest, ContiguousAcrossSegments) {
+  ByteQueue queue;
+  std::vector<uint8> expected;
+  for (int i = 0; i < 50; ++i) {
+    std::vector<uint8> bytes = MakeData(i, 7 + i * 13);
+    Push(&queue, bytes);
+    expected.insert(expected.end(), bytes.begin(), bytes.end());
+
+    // Consume a little less than was pushed so the front keeps waiting.
+    int pop = bytes.size() / 2;
+    queue.Pop(pop);
+    expected.erase(expected.begin(), expected.begin() + pop);
+
+    const uint8* data;
+    int size;
+    queue.Peek(&data, &size);
+    ASSERT_EQ(static_cast<int>(expected.size()), size);
+    EXPECT_EQ(0, memcmp(&expected[0], data, size));
+  }
+}
+
+// A held segment must not be written again, whether the queue is popped,
+// pushed to or reset.
+TEST(ByteQueueTest, HeldSegmentIsNotOverwritten) {
+  ByteQueue queue;
+  std::vector<uint8> bytes = MakeData(0, 100);
+  Push(&queue, bytes);
+
+  const uint8* data;
+  int size;
+  queue.Peek(&data, &size);
+  scoped_refptr<base::RefCountedMemory> segment = queue.segment();
+  ASSERT_TRUE(segment);
+
+  queue.Pop(size);
+  Push(&queue, MakeData(200, 50));
+  queue.Reset();
+  Push(&queue, MakeData(100, 100));
+  EXPECT_EQ(0, memcmp(&bytes[0], data, bytes.size()));
+}
+
+// Bytes pushed while a segment is held go to a new segment, even when the
+// held one has room, so the zeroed bytes past the old end stay zero.
+TEST(ByteQueueTest, HeldSegmentIsNotAppendedTo) {
+  ByteQueue queue;
+  Push(&queue, MakeData(1, 100));
+
+  const uint8* data;
+  int size;
+  queue.Peek(&data, &size);
+  scoped_refptr<base::RefCountedMemory> segment = queue.segment();
+  ASSERT_LE(data + size + DecoderBuffer::kPaddingSize,
+            segment->front() + segment->size());
+
+  std::vector<uint8> more = MakeData(101, 50);
+  Push(&queue, more);
+  for (int i = 0; i < DecoderBuffer::kPaddingSize; ++i)
+    EXPECT_EQ(0, data[size + i]);
+
+  const uint8* new_data;
+  int new_size;
+  queue.Peek(&new_data, &new_size);
+  EXPECT_NE(data, new_data);
+  ASSERT_EQ(150, new_size);
+  EXPECT_EQ(0, memcmp(data, new_data, size));
+  EXPECT_EQ(0, memcmp(&more[0], new_data + size, more.size()));
+}
+
+// A segment nobody else refers to is refilled instead of reallocated.
+TEST(ByteQueueTest, UnheldSegmentIsReused) {
+  ByteQueue queue;
+  Push(&queue, MakeData(0, 100));
+  const uint8* first_data;
+  int size;
+  queue.Peek(&first_data, &size);
+  queue.Pop(size);
+
+  Push(&queue, MakeData(0, 100));
+  const uint8* data;
+  queue.Peek(&data, &size);
+  EXPECT_EQ(first_data, data);
+}
+
+// Data returned by Peek() must be followed by readable, zeroed bytes up to
+// the end of the segment and its padding.
+TEST(ByteQueueTest, SegmentPadding) {
+  ByteQueue queue;
+  Push(&queue, MakeData(1, 5000));
+  Push(&queue, MakeData(1, 3000));
+
+  const uint8* data;
+  int size;
+  queue.Peek(&data, &size);
+  scoped_refptr<base::RefCountedMemory> segment = queue.segment();
+  const uint8* end = segment->front() + segment->size();
+  ASSERT_LE(data + size + DecoderBuffer::kPaddingSize, end);
+  for (const uint8* p = data + size; p < end; ++p)
+    EXPECT_EQ(0, *p);
+}
+
+}  // namespace media
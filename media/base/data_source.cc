@@ -25,6 +25,8 @@ void DataSource::set_host(DataSourceHost* host) {
 
 void DataSource::SetPlaybackRate(float playback_rate) {}
 
+void DataSource::Prefetch(int64 position) {}
+
 DataSourceHost* DataSource::host() { return host_; }
 
 }  // namespace media
@@ -49,6 +49,11 @@ class MEDIA_EXPORT DataSource : public base::RefCountedThreadSafe<DataSource> {
   // Notifies the DataSource of a change in the current playback rate.
   virtual void SetPlaybackRate(float playback_rate);
 
+  // Hints that Read() calls will soon start at |position|, e.g. because the
+  // demuxer is about to seek there. Implementations may use it to start
+  // fetching data ahead of the first Read(). The default does nothing.
+  virtual void Prefetch(int64 position);
+
   // Stops the DataSource. Once this is called all future Read() calls will
   // return an error.
   virtual void Stop(const base::Closure& callback) = 0;
@@ -10,12 +10,14 @@
 namespace media {
 
 DecoderBuffer::DecoderBuffer(int size)
-    : size_(size) {
+    : size_(size),
+      slice_(NULL) {
   Initialize();
 }
 
 DecoderBuffer::DecoderBuffer(const uint8* data, int size)
-    : size_(size) {
+    : size_(size),
+      slice_(NULL) {
   if (!data) {
     CHECK_EQ(size_, 0);
     return;
@@ -25,6 +27,19 @@ DecoderBuffer::DecoderBuffer(const uint8* data, int size)
   memcpy(data_.get(), data, size_);
 }
 
+DecoderBuffer::DecoderBuffer(
+    const scoped_refptr<base::RefCountedMemory>& memory,
+    const uint8* data, int size)
+    : size_(size),
+      memory_(memory),
+      slice_(data) {
+  CHECK(memory_);
+  CHECK_GE(size_, 0);
+  CHECK(slice_ >= memory_->front());
+  CHECK(slice_ + size_ + kPaddingSize <= memory_->front() + memory_->size());
+  DCHECK(CanSlice(*memory_, slice_, size_));
+}
+
 DecoderBuffer::~DecoderBuffer() {}
 
 void DecoderBuffer::Initialize() {
@@ -47,6 +62,15 @@ scoped_refptr<DecoderBuffer> DecoderBuffer::CreateEOSBuffer() {
   return make_scoped_refptr(new DecoderBuffer(NULL, 0));
 }
 
+// static
+bool DecoderBuffer::CanSlice(const base::RefCountedMemory& memory,
+                             const uint8* data, int size) {
+  const uint8* begin = memory.front();
+  const uint8* end = begin + memory.size();
+  return data && size >= 0 && data >= begin &&
+      size + kPaddingSize <= end - data;
+}
+
 base::TimeDelta DecoderBuffer::GetTimestamp() const {
   DCHECK(!IsEndOfStream());
   return timestamp_;
@@ -69,12 +93,14 @@ void DecoderBuffer::SetDuration(const base::TimeDelta& duration) {
 
 const uint8* DecoderBuffer::GetData() const {
   DCHECK(!IsEndOfStream());
-  return data_.get();
+  return memory_ ? slice_ : data_.get();
 }
 
 uint8* DecoderBuffer::GetWritableData() const {
   DCHECK(!IsEndOfStream());
-  return data_.get();
+  // The slice belongs to this buffer alone, so writing to it is safe even
+  // though the memory around it is shared.
+  return memory_ ? const_cast<uint8*>(slice_) : data_.get();
 }
 
 int DecoderBuffer::GetDataSize() const {
@@ -93,7 +119,7 @@ void DecoderBuffer::SetDecryptConfig(scoped_ptr<DecryptConfig> decrypt_config) {
 }
 
 bool DecoderBuffer::IsEndOfStream() const {
-  return data_ == NULL;
+  return data_ == NULL && !memory_;
 }
 
 std::string DecoderBuffer::AsHumanReadableString() {
@@ -9,6 +9,7 @@
 
 #include "base/memory/aligned_memory.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/time.h"
 #include "build/build_config.h"
@@ -26,6 +27,9 @@ class DecryptConfig;
 //
 // Also includes decoder specific functionality for decryption.
 //
+// A buffer may also refer to a slice of memory it does not own, see the
+// protected constructor below.
+//
 // NOTE: It is illegal to call any method when IsEndOfStream() is true.
 class MEDIA_EXPORT DecoderBuffer
     : public base::RefCountedThreadSafe<DecoderBuffer> {
@@ -67,6 +71,15 @@ class MEDIA_EXPORT DecoderBuffer
   const DecryptConfig* GetDecryptConfig() const;
   void SetDecryptConfig(scoped_ptr<DecryptConfig> decrypt_config);
 
+  // Returns true if a buffer may refer to the |size| bytes at |data| inside
+  // |memory| instead of copying them, see the protected constructor below.
+  // This requires the kPaddingSize bytes past the slice to lie in |memory|,
+  // so that decoders may read past the data as with an allocated buffer.
+  // Unlike the padding of an allocated buffer, those bytes are usually the
+  // start of whatever follows the slice rather than zeroes.
+  static bool CanSlice(const base::RefCountedMemory& memory,
+                       const uint8* data, int size);
+
   // If there's no data in this buffer, it represents end of stream.
   bool IsEndOfStream() const;
 
@@ -80,6 +93,13 @@ class MEDIA_EXPORT DecoderBuffer
   // will be padded and aligned as necessary.  If |data| is NULL then |data_| is
   // set to NULL and |buffer_size_| to 0.
   DecoderBuffer(const uint8* data, int size);
+
+  // Refers to the |size| bytes at |data| inside |memory| instead of copying
+  // them, and keeps all of |memory| alive.  CanSlice() must return true for
+  // the slice.  The owner of |memory| must not write to it any more.  The
+  // slice is not aligned.
+  DecoderBuffer(const scoped_refptr<base::RefCountedMemory>& memory,
+                const uint8* data, int size);
   virtual ~DecoderBuffer();
 
  private:
@@ -88,6 +108,10 @@ class MEDIA_EXPORT DecoderBuffer
 
   int size_;
   scoped_ptr<uint8, base::ScopedPtrAlignedFree> data_;
+
+  // Set instead of |data_| for a buffer referring to a slice of |memory_|.
+  scoped_refptr<base::RefCountedMemory> memory_;
+  const uint8* slice_;
   scoped_ptr<DecryptConfig> decrypt_config_;
 
   // Constructor helper method for memory allocations.
@@ -2,6 +2,9 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <vector>
+
+#include "base/memory/ref_counted_memory.h"
 #include "base/string_util.h"
 #include "media/base/decoder_buffer.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -81,6 +84,24 @@ TEST(DecoderBufferTest, ReadingWriting) {
   EXPECT_FALSE(buffer->IsEndOfStream());
 }
 
+TEST(DecoderBufferTest, CanSlice) {
+  const int kDataSize = 64;
+  std::vector<uint8> bytes(kDataSize + DecoderBuffer::kPaddingSize, 0);
+  memset(&bytes[0], 0xff, kDataSize);
+  scoped_refptr<base::RefCountedBytes> memory(
+      new base::RefCountedBytes(bytes));
+  const uint8* data = memory->front();
+
+  EXPECT_TRUE(DecoderBuffer::CanSlice(*memory, data, kDataSize));
+
+  // The padding may overlap whatever follows the slice, but must lie inside
+  // |memory|.
+  EXPECT_TRUE(DecoderBuffer::CanSlice(*memory, data, kDataSize / 2));
+  EXPECT_TRUE(DecoderBuffer::CanSlice(*memory, data + 1, kDataSize - 1));
+  EXPECT_FALSE(DecoderBuffer::CanSlice(*memory, data + 1, kDataSize));
+  EXPECT_FALSE(DecoderBuffer::CanSlice(*memory, data - 1, kDataSize));
+}
+
 TEST(DecoderBufferTest, GetDecryptConfig) {
   scoped_refptr<DecoderBuffer> buffer(new DecoderBuffer(0));
   EXPECT_FALSE(buffer->GetDecryptConfig());
@@ -41,6 +41,10 @@ enum {
 
   // This limit is used by ParamTraits<VideoCaptureParams>.
   kMaxFramesPerSecond = 1000,
+
+  // Maximum number of packets in the ring between AudioOutputDevice and
+  // AudioOutputController.
+  kMaxAudioRingSlots = 8,
 };
 
 }  // namespace limits
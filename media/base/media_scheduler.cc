@@ -0,0 +1,154 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/base/media_scheduler.h"
+
+#include <algorithm>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/sys_info.h"
+
+namespace media {
+
+static base::LazyInstance<MediaScheduler>::Leaky g_media_scheduler =
+    LAZY_INSTANCE_INITIALIZER;
+
+MediaScheduler::Player::Player(MediaScheduler* scheduler, const void* page)
+    : scheduler_(scheduler),
+      page_(page),
+      playing_(false),
+      decode_policy_(DECODE_ALL),
+      max_decode_threads_(1) {
+}
+
+MediaScheduler::Player::~Player() {
+  scheduler_->RemovePlayer(this);
+}
+
+void MediaScheduler::Player::SetPlaying(bool playing) {
+  base::AutoLock auto_lock(scheduler_->lock_);
+  if (playing_ == playing)
+    return;
+  playing_ = playing;
+  scheduler_->Schedule();
+}
+
+void MediaScheduler::Player::SetSize(const gfx::Size& size) {
+  base::AutoLock auto_lock(scheduler_->lock_);
+  if (size_ == size)
+    return;
+  size_ = size;
+  scheduler_->Schedule();
+}
+
+MediaScheduler::DecodePolicy MediaScheduler::Player::decode_policy() const {
+  base::AutoLock auto_lock(scheduler_->lock_);
+  return decode_policy_;
+}
+
+int MediaScheduler::Player::max_decode_threads() const {
+  base::AutoLock auto_lock(scheduler_->lock_);
+  return max_decode_threads_;
+}
+
+MediaScheduler::MediaScheduler()
+    : num_cores_(base::SysInfo::NumberOfProcessors()) {
+}
+
+MediaScheduler::MediaScheduler(int num_cores)
+    : num_cores_(std::max(num_cores, 1)) {
+}
+
+MediaScheduler::~MediaScheduler() {
+  DCHECK(players_.empty());
+}
+
+// static
+MediaScheduler* MediaScheduler::GetInstance() {
+  return g_media_scheduler.Pointer();
+}
+
+scoped_refptr<MediaScheduler::Player> MediaScheduler::AddPlayer(
+    const void* page) {
+  scoped_refptr<Player> player(new Player(this, page));
+  base::AutoLock auto_lock(lock_);
+  players_.push_back(player.get());
+  Schedule();
+  return player;
+}
+
+void MediaScheduler::SetPageVisible(const void* page, bool visible) {
+  base::AutoLock auto_lock(lock_);
+  if (visible)
+    hidden_pages_.erase(page);
+  else
+    hidden_pages_.insert(page);
+  Schedule();
+}
+
+void MediaScheduler::RemovePage(const void* page) {
+  SetPageVisible(page, true);
+}
+
+void MediaScheduler::RemovePlayer(Player* player) {
+  base::AutoLock auto_lock(lock_);
+  std::vector<Player*>::iterator it =
+      std::find(players_.begin(), players_.end(), player);
+  DCHECK(it != players_.end());
+  players_.erase(it);
+  Schedule();
+}
+
+// static
+bool MediaScheduler::HasHigherPriority(const Player* a, const Player* b) {
+  if (a->playing_ != b->playing_)
+    return a->playing_;
+  return a->size_.GetArea() > b->size_.GetArea();
+}
+
+void MediaScheduler::Schedule() {
+  lock_.AssertAcquired();
+
+  // Players on hidden pages are not seen, so they only decode what is needed
+  // to stay roughly in sync and don't count against the cores.
+  std::vector<Player*> visible;
+  int64 total_area = 0;
+  for (size_t i = 0; i < players_.size(); ++i) {
+    Player* player = players_[i];
+    if (hidden_pages_.count(player->page_)) {
+      player->decode_policy_ =
+          player->playing_ ? DECODE_KEYFRAMES_ONLY : DECODE_ALL;
+      player->max_decode_threads_ = 1;
+      continue;
+    }
+    visible.push_back(player);
+    total_area += player->size_.GetArea();
+  }
+
+  // Players of equal priority keep the order they were added in.
+  std::stable_sort(visible.begin(), visible.end(),
+                   &MediaScheduler::HasHigherPriority);
+
+  int cores_left = num_cores_;
+  for (size_t i = 0; i < visible.size(); ++i) {
+    Player* player = visible[i];
+    if (cores_left <= 0) {
+      // Paused players only decode while seeking, which is worth doing well.
+      player->decode_policy_ = player->playing_ ? DECODE_REDUCED : DECODE_ALL;
+      player->max_decode_threads_ = 1;
+      continue;
+    }
+
+    int threads = total_area > 0 ?
+        static_cast<int>(num_cores_ * player->size_.GetArea() / total_area) :
+        num_cores_ / static_cast<int>(visible.size());
+    threads = std::min(std::max(threads, 1), cores_left);
+    cores_left -= threads;
+    player->decode_policy_ = DECODE_ALL;
+    player->max_decode_threads_ = threads;
+  }
+}
+
+}  // namespace media
@@ -0,0 +1,127 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_BASE_MEDIA_SCHEDULER_H_
+#define MEDIA_BASE_MEDIA_SCHEDULER_H_
+
+#include <set>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "media/base/media_export.h"
+#include "ui/gfx/size.h"
+
+namespace media {
+
+// MediaScheduler shares the cores of the process between the players decoding
+// video in software.  Each player reports whether it is playing and the size
+// it is drawn at, and the embedder reports which pages are hidden.  From that
+// the scheduler ranks the players and gives each a DecodePolicy and a cap on
+// its decode threads:
+//
+// - Playing players on hidden pages only decode keyframes on a single thread.
+// - Visible players are ranked playing first and then by size on screen, and
+//   get threads in proportion to their area until the cores run out.
+// - Visible playing players ranked after that decode on a single thread and
+//   skip the loop filter on interframes.
+//
+// Players are rescheduled whenever any of them changes, so decoders should
+// look up their policy before each frame.  The thread cap is only applied when
+// a decoder (re)configures its codec.
+//
+// All methods are thread safe.
+class MEDIA_EXPORT MediaScheduler {
+ public:
+  enum DecodePolicy {
+    // Decode every frame at full quality.
+    DECODE_ALL,
+
+    // Skip the loop filter on interframes.  Cheaper but shows some blocking,
+    // which lasts until the next keyframe.
+    DECODE_REDUCED,
+
+    // Only decode keyframes.
+    DECODE_KEYFRAMES_ONLY,
+  };
+
+  // Handle through which a player reports its state and its decoder reads the
+  // policy.  Releasing the last reference unregisters the player.
+  class MEDIA_EXPORT Player : public base::RefCountedThreadSafe<Player> {
+   public:
+    void SetPlaying(bool playing);
+
+    // Sets the size the video is drawn at on screen.
+    void SetSize(const gfx::Size& size);
+
+    DecodePolicy decode_policy() const;
+
+    // Returns the maximum number of threads the decoder should use.
+    int max_decode_threads() const;
+
+   private:
+    friend class base::RefCountedThreadSafe<Player>;
+    friend class MediaScheduler;
+
+    Player(MediaScheduler* scheduler, const void* page);
+    ~Player();
+
+    MediaScheduler* const scheduler_;
+    const void* const page_;
+
+    // Guarded by |scheduler_->lock_|.
+    bool playing_;
+    gfx::Size size_;
+    DecodePolicy decode_policy_;
+    int max_decode_threads_;
+
+    DISALLOW_COPY_AND_ASSIGN(Player);
+  };
+
+  // Creates a scheduler sharing all the processors of the machine.
+  MediaScheduler();
+
+  // Creates a scheduler sharing |num_cores| cores.
+  explicit MediaScheduler(int num_cores);
+
+  ~MediaScheduler();
+
+  // Returns the scheduler shared by the players of the process.
+  static MediaScheduler* GetInstance();
+
+  // Registers a paused player on |page|, an opaque key for the page hosting
+  // the player as passed to SetPageVisible().
+  scoped_refptr<Player> AddPlayer(const void* page);
+
+  // Sets whether |page| is visible.  Pages are visible until told otherwise.
+  void SetPageVisible(const void* page, bool visible);
+
+  // Forgets the visibility of |page| once it goes away.
+  void RemovePage(const void* page);
+
+ private:
+  void RemovePlayer(Player* player);
+
+  // Orders visible players by decreasing priority: playing ones first, then
+  // the larger ones.
+  static bool HasHigherPriority(const Player* a, const Player* b);
+
+  // Assigns the policy and threads of every player.  |lock_| must be held.
+  void Schedule();
+
+  const int num_cores_;
+
+  base::Lock lock_;
+
+  // Registered players in the order they were added.
+  std::vector<Player*> players_;
+  std::set<const void*> hidden_pages_;
+
+  DISALLOW_COPY_AND_ASSIGN(MediaScheduler);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_BASE_MEDIA_SCHEDULER_H_
@@ -0,0 +1,292 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/memory/scoped_vector.h"
+#include "base/string_number_conversions.h"
+#include "base/sys_info.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "base/time.h"
+#include "media/base/media_scheduler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const int kNumCores = 8;
+
+// Opaque keys for two pages.
+static const int kPage = 1;
+static const int kOtherPage = 2;
+
+// Number of players in the benchmark, by default enough to oversubscribe the
+// machine. Disabled by default; run with
+// --gtest_also_run_disabled_tests --media-scheduler-players=N.
+static const char kBenchmarkPlayers[] = "media-scheduler-players";
+
+class MediaSchedulerTest : public testing::Test {
+ public:
+  MediaSchedulerTest() : scheduler_(kNumCores) {}
+
+ protected:
+  scoped_refptr<MediaScheduler::Player> AddPlayer(const void* page,
+                                                  int width, int height,
+                                                  bool playing) {
+    scoped_refptr<MediaScheduler::Player> player =
+        scheduler_.AddPlayer(page);
+    player->SetSize(gfx::Size(width, height));
+    player->SetPlaying(playing);
+    return player;
+  }
+
+  MediaScheduler scheduler_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MediaSchedulerTest);
+};
+
+TEST_F(MediaSchedulerTest, SinglePlayerGetsAllCores) {
+  scoped_refptr<MediaScheduler::Player> player =
+      AddPlayer(&kPage, 1280, 720, true);
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, player->decode_policy());
+  EXPECT_EQ(kNumCores, player->max_decode_threads());
+}
+
+TEST_F(MediaSchedulerTest, ThreadsFollowSizeOnScreen) {
+  scoped_refptr<MediaScheduler::Player> small =
+      AddPlayer(&kPage, 320, 180, true);
+  scoped_refptr<MediaScheduler::Player> large =
+      AddPlayer(&kPage, 960, 180, true);
+  EXPECT_EQ(2, small->max_decode_threads());
+  EXPECT_EQ(6, large->max_decode_threads());
+
+  // Releasing a player hands its cores back.
+  small = NULL;
+  EXPECT_EQ(kNumCores, large->max_decode_threads());
+}
+
+// Once the cores are handed out the remaining players decode cheaply.
+TEST_F(MediaSchedulerTest, PlayersBeyondCoresAreReduced) {
+  std::vector<scoped_refptr<MediaScheduler::Player> > players;
+  for (int i = 0; i < kNumCores + 2; ++i)
+    players.push_back(AddPlayer(&kPage, 320, 180, true));
+
+  for (int i = 0; i < kNumCores; ++i) {
+    EXPECT_EQ(MediaScheduler::DECODE_ALL, players[i]->decode_policy());
+    EXPECT_EQ(1, players[i]->max_decode_threads());
+  }
+  for (size_t i = kNumCores; i < players.size(); ++i) {
+    EXPECT_EQ(MediaScheduler::DECODE_REDUCED, players[i]->decode_policy());
+    EXPECT_EQ(1, players[i]->max_decode_threads());
+  }
+
+  // Growing the last player moves it to the front.
+  players.back()->SetSize(gfx::Size(1920, 1080));
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, players.back()->decode_policy());
+  EXPECT_LT(1, players.back()->max_decode_threads());
+}
+
+// Paused players neither take cores from playing ones nor decode badly.
+TEST_F(MediaSchedulerTest, PausedPlayers) {
+  scoped_refptr<MediaScheduler::Player> paused =
+      AddPlayer(&kPage, 1920, 1080, false);
+  std::vector<scoped_refptr<MediaScheduler::Player> > players;
+  for (int i = 0; i < kNumCores; ++i)
+    players.push_back(AddPlayer(&kPage, 320, 180, true));
+
+  for (size_t i = 0; i < players.size(); ++i)
+    EXPECT_EQ(MediaScheduler::DECODE_ALL, players[i]->decode_policy());
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, paused->decode_policy());
+  EXPECT_EQ(1, paused->max_decode_threads());
+}
+
+TEST_F(MediaSchedulerTest, HiddenPage) {
+  scoped_refptr<MediaScheduler::Player> background =
+      AddPlayer(&kOtherPage, 1920, 1080, true);
+  scoped_refptr<MediaScheduler::Player> foreground =
+      AddPlayer(&kPage, 320, 180, true);
+
+  scheduler_.SetPageVisible(&kOtherPage, false);
+  EXPECT_EQ(MediaScheduler::DECODE_KEYFRAMES_ONLY,
+            background->decode_policy());
+  EXPECT_EQ(1, background->max_decode_threads());
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, foreground->decode_policy());
+  EXPECT_EQ(kNumCores, foreground->max_decode_threads());
+
+  // Paused players on hidden pages may still be seeked.
+  background->SetPlaying(false);
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, background->decode_policy());
+
+  background->SetPlaying(true);
+  scheduler_.SetPageVisible(&kOtherPage, true);
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, background->decode_policy());
+  EXPECT_LT(foreground->max_decode_threads(),
+            background->max_decode_threads());
+}
+
+TEST_F(MediaSchedulerTest, PlayerAddedToHiddenPage) {
+  scheduler_.SetPageVisible(&kPage, false);
+  scoped_refptr<MediaScheduler::Player> player =
+      AddPlayer(&kPage, 640, 360, true);
+  EXPECT_EQ(MediaScheduler::DECODE_KEYFRAMES_ONLY, player->decode_policy());
+
+  // Removed pages are visible again.
+  scheduler_.RemovePage(&kPage);
+  EXPECT_EQ(MediaScheduler::DECODE_ALL, player->decode_policy());
+}
+
+// Stands in for a decoder playing a 30 fps stream with a keyframe every
+// second.  Each frame costs a fixed amount of computation, less under the
+// reduced policy, and is decoded at most a few frames ahead of its display
+// time; frames finished after their display time count as dropped.
+class SimulatedDecoder : public base::DelegateSimpleThread::Delegate {
+ public:
+  SimulatedDecoder(const scoped_refptr<MediaScheduler::Player>& player,
+                   bool use_policy, int work_per_frame,
+                   base::TimeTicks start, base::TimeTicks end)
+      : player_(player),
+        use_policy_(use_policy),
+        work_per_frame_(work_per_frame),
+        start_(start),
+        end_(end),
+        frames_(0),
+        dropped_(0),
+        sink_(0) {
+  }
+  virtual ~SimulatedDecoder() {}
+
+  virtual void Run() OVERRIDE {
+    const base::TimeDelta kFrameDuration =
+        base::TimeDelta::FromMicroseconds(base::Time::kMicrosecondsPerSecond /
+                                          kFramesPerSecond);
+    for (int frame = 0;; ++frame) {
+      base::TimeTicks deadline = start_ + kFrameDuration * frame;
+      if (deadline >= end_)
+        break;
+      base::TimeTicks decode_time = deadline - kFrameDuration * kLookahead;
+      base::TimeTicks now = base::TimeTicks::HighResNow();
+      if (now < decode_time)
+        base::PlatformThread::Sleep(decode_time - now);
+
+      MediaScheduler::DecodePolicy policy = use_policy_ ?
+          player_->decode_policy() : MediaScheduler::DECODE_ALL;
+      bool keyframe = frame % kFramesPerSecond == 0;
+      if (policy == MediaScheduler::DECODE_KEYFRAMES_ONLY && !keyframe)
+        continue;
+      int work = work_per_frame_;
+      if (policy == MediaScheduler::DECODE_REDUCED && !keyframe)
+        work = work * kReducedWorkPercent / 100;
+      sink_ += DoWork(work);
+
+      ++frames_;
+      if (base::TimeTicks::HighResNow() > deadline)
+        ++dropped_;
+    }
+  }
+
+  // Burns CPU for |units| of work and returns a value to keep it from being
+  // optimized away.
+  static uint32 DoWork(int units) {
+    uint32 value = 0;
+    for (int i = 0; i < units; ++i) {
+      for (int j = 0; j < 1000; ++j)
+        value = value * 1103515245 + 12345 + j;
+    }
+    return value;
+  }
+
+  int frames() const { return frames_; }
+  int dropped() const { return dropped_; }
+
+  static const int kFramesPerSecond = 30;
+
+ private:
+  static const int kLookahead = 3;
+
+  // Share of the work done on interframes when the loop filter is skipped.
+  static const int kReducedWorkPercent = 70;
+
+  scoped_refptr<MediaScheduler::Player> player_;
+  const bool use_policy_;
+  const int work_per_frame_;
+  const base::TimeTicks start_;
+  const base::TimeTicks end_;
+  int frames_;
+  int dropped_;
+  uint32 sink_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedDecoder);
+};
+
+// Benchmark for one visible player competing with players on a hidden page,
+// each costing half a core.  Reports the frames dropped by the visible player
+// with every decoder ignoring the scheduler and with all of them following it.
+// The savings of each policy are modelled by SimulatedDecoder, so this does
+// not measure them; it checks that the policies the scheduler hands out while
+// the players run are enough to keep the visible player on time.
+TEST(MediaSchedulerBenchmark, DISABLED_VisiblePlayerDrops) {
+  const int num_cores = base::SysInfo::NumberOfProcessors();
+  int num_players = 0;
+  if (!base::StringToInt(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          kBenchmarkPlayers), &num_players) || num_players < 1) {
+    num_players = 2 * num_cores + 1;
+  }
+
+  // Calibrate the work for a frame to take half of a frame's duration.
+  const int kCalibrationUnits = 10000;
+  base::TimeTicks calibration_start = base::TimeTicks::HighResNow();
+  EXPECT_NE(1u, SimulatedDecoder::DoWork(kCalibrationUnits));
+  double unit_seconds =
+      (base::TimeTicks::HighResNow() - calibration_start).InSecondsF() /
+      kCalibrationUnits;
+  int work_per_frame = std::max(1, static_cast<int>(
+      0.5 / SimulatedDecoder::kFramesPerSecond / unit_seconds));
+
+  printf("Benchmarking 1 visible and %d hidden players on %d cores:\n",
+         num_players - 1, num_cores);
+  int visible_dropped[2] = { 0, 0 };
+  for (int use_policy = 0; use_policy < 2; ++use_policy) {
+    MediaScheduler scheduler(num_cores);
+    scheduler.SetPageVisible(&kOtherPage, false);
+
+    base::TimeTicks start =
+        base::TimeTicks::HighResNow() + base::TimeDelta::FromMilliseconds(100);
+    base::TimeTicks end = start + base::TimeDelta::FromSeconds(2);
+    ScopedVector<SimulatedDecoder> decoders;
+    for (int i = 0; i < num_players; ++i) {
+      scoped_refptr<MediaScheduler::Player> player =
+          scheduler.AddPlayer(i == 0 ? &kPage : &kOtherPage);
+      player->SetSize(gfx::Size(1280, 720));
+      player->SetPlaying(true);
+      decoders.push_back(new SimulatedDecoder(
+          player, use_policy != 0, work_per_frame, start, end));
+    }
+
+    base::DelegateSimpleThreadPool pool("SimulatedDecoder", num_players);
+    for (size_t i = 0; i < decoders.size(); ++i)
+      pool.AddWork(decoders[i]);
+    pool.Start();
+    pool.JoinAll();
+
+    int total_frames = 0;
+    for (size_t i = 0; i < decoders.size(); ++i)
+      total_frames += decoders[i]->frames();
+    printf("%s: visible player dropped %d of %d frames, %d frames decoded "
+           "in total.\n", use_policy ? "Scheduled" : "Unscheduled",
+           decoders[0]->dropped(), decoders[0]->frames(), total_frames);
+    visible_dropped[use_policy] = decoders[0]->dropped();
+    decoders.clear();
+  }
+
+  // With too few players to oversubscribe the machine neither run drops.
+  if (visible_dropped[0] > 0)
+    EXPECT_LT(visible_dropped[1], visible_dropped[0]);
+  else
+    EXPECT_EQ(0, visible_dropped[1]);
+}
+
+}  // namespace media
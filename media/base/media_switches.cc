@@ -9,6 +9,11 @@ namespace switches {
 // Allow users to specify a custom buffer size for debugging purpose.
 const char kAudioBufferSize[] = "audio-buffer-size";
 
+// Number of packets the renderer may render ahead of an audio output stream.
+// With more than one the browser pulls audio from a ring in shared memory
+// instead of waiting on the renderer for every packet.
+const char kAudioOutputRingSlots[] = "audio-output-ring-slots";
+
 #if defined(OS_LINUX) || defined(OS_FREEBSD) || defined(OS_SOLARIS)
 // The Alsa device to use when opening an audio stream.
 const char kAlsaOutputDevice[] = "alsa-output-device";
@@ -19,6 +19,8 @@ extern const char kAlsaInputDevice[];
 
 MEDIA_EXPORT extern const char kAudioBufferSize[];
 
+MEDIA_EXPORT extern const char kAudioOutputRingSlots[];
+
 #if defined(USE_CRAS)
 MEDIA_EXPORT extern const char kUseCras[];
 #endif
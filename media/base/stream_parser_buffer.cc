@@ -19,6 +19,13 @@ scoped_refptr<StreamParserBuffer> StreamParserBuffer::CopyFrom(
       new StreamParserBuffer(data, data_size, is_keyframe));
 }
 
+scoped_refptr<StreamParserBuffer> StreamParserBuffer::CreateSlice(
+    const scoped_refptr<base::RefCountedMemory>& memory,
+    const uint8* data, int data_size, bool is_keyframe) {
+  return make_scoped_refptr(
+      new StreamParserBuffer(memory, data, data_size, is_keyframe));
+}
+
 base::TimeDelta StreamParserBuffer::GetDecodeTimestamp() const {
   if (decode_timestamp_ == kNoTimestamp())
     return GetTimestamp();
@@ -43,6 +50,16 @@ StreamParserBuffer::StreamParserBuffer(const uint8* data, int data_size,
   }
 }
 
+StreamParserBuffer::StreamParserBuffer(
+    const scoped_refptr<base::RefCountedMemory>& memory,
+    const uint8* data, int data_size, bool is_keyframe)
+    : DecoderBuffer(memory, data, data_size),
+      is_keyframe_(is_keyframe),
+      decode_timestamp_(kNoTimestamp()),
+      config_id_(kInvalidConfigId) {
+  SetDuration(kNoTimestamp());
+}
+
 StreamParserBuffer::~StreamParserBuffer() {
 }
 
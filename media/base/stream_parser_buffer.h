@@ -18,6 +18,14 @@ class MEDIA_EXPORT StreamParserBuffer : public DecoderBuffer {
   static scoped_refptr<StreamParserBuffer> CreateEOSBuffer();
   static scoped_refptr<StreamParserBuffer> CopyFrom(
       const uint8* data, int data_size, bool is_keyframe);
+
+  // Creates a buffer referring to the |data_size| bytes at |data| inside
+  // |memory| without copying them.  DecoderBuffer::CanSlice() must return
+  // true for the slice.
+  static scoped_refptr<StreamParserBuffer> CreateSlice(
+      const scoped_refptr<base::RefCountedMemory>& memory,
+      const uint8* data, int data_size, bool is_keyframe);
+
   bool IsKeyframe() const { return is_keyframe_; }
 
   // Decode timestamp. If not explicitly set, or set to kNoTimestamp(), the
@@ -32,6 +40,8 @@ class MEDIA_EXPORT StreamParserBuffer : public DecoderBuffer {
 
  private:
   StreamParserBuffer(const uint8* data, int data_size, bool is_keyframe);
+  StreamParserBuffer(const scoped_refptr<base::RefCountedMemory>& memory,
+                     const uint8* data, int data_size, bool is_keyframe);
   virtual ~StreamParserBuffer();
 
   bool is_keyframe_;
@@ -5,6 +5,8 @@
 #include "media/base/vector_math.h"
 #include "media/base/vector_math_testing.h"
 
+#include <algorithm>
+
 #include "base/cpu.h"
 #include "base/logging.h"
 #include "build/build_config.h"
@@ -16,6 +18,31 @@
 namespace media {
 namespace vector_math {
 
+// Number of elements of |dest| FMACMulti() mixes at a time.  A block of |dest|
+// and the matching blocks of every input in a pass comfortably fit in L1.
+static const int kMixBlockSize = 256;
+
+// Number of inputs FMACMulti() accumulates per load and store of |dest|.
+static const int kMaxInputsPerPass = 4;
+
+static bool IsSilent(float start_scale, float end_scale) {
+  return start_scale == 0 && end_scale == 0;
+}
+
+// Mixes elements [|begin|, |len|) of each input in |src| into |dest|.
+static void FMACMultiRange_C(const float* const src[],
+                             const float start_scale[],
+                             const float end_scale[], int count, int begin,
+                             int len, float dest[]) {
+  for (int k = 0; k < count; ++k) {
+    if (IsSilent(start_scale[k], end_scale[k]))
+      continue;
+    const float step = (end_scale[k] - start_scale[k]) / len;
+    for (int i = begin; i < len; ++i)
+      dest[i] += src[k][i] * (start_scale[k] + step * i);
+  }
+}
+
 void FMAC(const float src[], float scale, int len, float dest[]) {
   // Ensure |src| and |dest| are 16-byte aligned.
   DCHECK_EQ(0u, reinterpret_cast<uintptr_t>(src) & (kRequiredAlignment - 1));
@@ -35,11 +62,66 @@ void FMAC(const float src[], float scale, int len, float dest[]) {
   return kVectorFMACProc(src, scale, len, dest);
 }
 
+void FMACMulti(const float* const src[], const float start_scale[],
+               const float end_scale[], int count, int len, float dest[]) {
+  // Ensure |src| and |dest| are 16-byte aligned.
+  DCHECK_EQ(0u, reinterpret_cast<uintptr_t>(dest) & (kRequiredAlignment - 1));
+  for (int k = 0; k < count; ++k) {
+    DCHECK_EQ(0u,
+              reinterpret_cast<uintptr_t>(src[k]) & (kRequiredAlignment - 1));
+  }
+
+  if (len <= 0)
+    return;
+
+  // Rely on function level static initialization to keep VectorFMACMultiProc
+  // selection thread safe.
+  typedef void (*VectorFMACMultiProc)(const float* const src[],
+                                      const float start_scale[],
+                                      const float end_scale[], int count,
+                                      int len, float dest[]);
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+  static const VectorFMACMultiProc kVectorFMACMultiProc =
+      base::CPU().has_sse() ? FMACMulti_SSE : FMACMulti_C;
+#else
+  static const VectorFMACMultiProc kVectorFMACMultiProc = FMACMulti_C;
+#endif
+
+  return kVectorFMACMultiProc(src, start_scale, end_scale, count, len, dest);
+}
+
+float DotProduct(const float a[], const float b[], int len) {
+  // Rely on function level static initialization to keep VectorDotProductProc
+  // selection thread safe.
+  typedef float (*VectorDotProductProc)(const float a[], const float b[],
+                                        int len);
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+  static const VectorDotProductProc kVectorDotProductProc =
+      base::CPU().has_sse() ? DotProduct_SSE : DotProduct_C;
+#else
+  static const VectorDotProductProc kVectorDotProductProc = DotProduct_C;
+#endif
+
+  return kVectorDotProductProc(a, b, len);
+}
+
 void FMAC_C(const float src[], float scale, int len, float dest[]) {
   for (int i = 0; i < len; ++i)
     dest[i] += src[i] * scale;
 }
 
+void FMACMulti_C(const float* const src[], const float start_scale[],
+                 const float end_scale[], int count, int len, float dest[]) {
+  FMACMultiRange_C(src, start_scale, end_scale, count, 0, len, dest);
+}
+
+float DotProduct_C(const float a[], const float b[], int len) {
+  float sum = 0;
+  for (int i = 0; i < len; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
+
 #if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
 void FMAC_SSE(const float src[], float scale, int len, float dest[]) {
   __m128 m_scale = _mm_set_ps1(scale);
@@ -53,6 +135,172 @@ void FMAC_SSE(const float src[], float scale, int len, float dest[]) {
   if (rem)
     FMAC_C(src + len - rem, scale, rem, dest + len - rem);
 }
+
+// Accumulates four inputs into elements [|begin|, |end|) of |dest| with a
+// single load and store of |dest| per four elements.  Gains are advanced by
+// |m_gain_step| every four elements when |kRamp| is true.
+template <bool kRamp>
+static void Mix4_SSE(const float* const src[], const __m128 m_gain[],
+                     const __m128 m_gain_step[], int begin, int end,
+                     float dest[]) {
+  // Keep everything in locals so the compiler can hold it in registers.
+  const float* src0 = src[0];
+  const float* src1 = src[1];
+  const float* src2 = src[2];
+  const float* src3 = src[3];
+  __m128 m_gain0 = m_gain[0];
+  __m128 m_gain1 = m_gain[1];
+  __m128 m_gain2 = m_gain[2];
+  __m128 m_gain3 = m_gain[3];
+  for (int i = begin; i < end; i += 4) {
+    __m128 m_dest = _mm_load_ps(dest + i);
+    m_dest = _mm_add_ps(m_dest, _mm_mul_ps(_mm_load_ps(src0 + i), m_gain0));
+    m_dest = _mm_add_ps(m_dest, _mm_mul_ps(_mm_load_ps(src1 + i), m_gain1));
+    m_dest = _mm_add_ps(m_dest, _mm_mul_ps(_mm_load_ps(src2 + i), m_gain2));
+    m_dest = _mm_add_ps(m_dest, _mm_mul_ps(_mm_load_ps(src3 + i), m_gain3));
+    _mm_store_ps(dest + i, m_dest);
+    if (kRamp) {
+      m_gain0 = _mm_add_ps(m_gain0, m_gain_step[0]);
+      m_gain1 = _mm_add_ps(m_gain1, m_gain_step[1]);
+      m_gain2 = _mm_add_ps(m_gain2, m_gain_step[2]);
+      m_gain3 = _mm_add_ps(m_gain3, m_gain_step[3]);
+    }
+  }
+}
+
+// Two input version of Mix4_SSE().
+template <bool kRamp>
+static void Mix2_SSE(const float* const src[], const __m128 m_gain[],
+                     const __m128 m_gain_step[], int begin, int end,
+                     float dest[]) {
+  const float* src0 = src[0];
+  const float* src1 = src[1];
+  __m128 m_gain0 = m_gain[0];
+  __m128 m_gain1 = m_gain[1];
+  for (int i = begin; i < end; i += 4) {
+    __m128 m_dest = _mm_load_ps(dest + i);
+    m_dest = _mm_add_ps(m_dest, _mm_mul_ps(_mm_load_ps(src0 + i), m_gain0));
+    m_dest = _mm_add_ps(m_dest, _mm_mul_ps(_mm_load_ps(src1 + i), m_gain1));
+    _mm_store_ps(dest + i, m_dest);
+    if (kRamp) {
+      m_gain0 = _mm_add_ps(m_gain0, m_gain_step[0]);
+      m_gain1 = _mm_add_ps(m_gain1, m_gain_step[1]);
+    }
+  }
+}
+
+// Single input version of Mix4_SSE().
+template <bool kRamp>
+static void Mix1_SSE(const float src[], __m128 m_gain, __m128 m_gain_step,
+                     int begin, int end, float dest[]) {
+  for (int i = begin; i < end; i += 4) {
+    _mm_store_ps(dest + i, _mm_add_ps(_mm_load_ps(dest + i),
+                 _mm_mul_ps(_mm_load_ps(src + i), m_gain)));
+    if (kRamp)
+      m_gain = _mm_add_ps(m_gain, m_gain_step);
+  }
+}
+
+void FMACMulti_SSE(const float* const src[], const float start_scale[],
+                   const float end_scale[], int count, int len,
+                   float dest[]) {
+  const __m128 m_index_offsets = _mm_set_ps(3, 2, 1, 0);
+  const int rem = len % 4;
+  const int last_index = len - rem;
+
+  // Work through |dest| one block at a time so that each block is loaded and
+  // stored once per kMaxInputsPerPass inputs while it is still in cache.
+  for (int block = 0; block < last_index; block += kMixBlockSize) {
+    const int block_end = std::min(block + kMixBlockSize, last_index);
+    const __m128 m_block_index = _mm_add_ps(
+        _mm_set_ps1(static_cast<float>(block)), m_index_offsets);
+
+    int k = 0;
+    while (k < count) {
+      // Gather the next group of audible inputs along with their gain for
+      // the first four elements of this block and the per-iteration step.
+      const float* group[kMaxInputsPerPass];
+      __m128 m_gain[kMaxInputsPerPass];
+      __m128 m_gain_step[kMaxInputsPerPass];
+      bool ramp = false;
+      int group_size = 0;
+      for (; k < count && group_size < kMaxInputsPerPass; ++k) {
+        if (IsSilent(start_scale[k], end_scale[k]))
+          continue;
+        const float step = (end_scale[k] - start_scale[k]) / len;
+        ramp |= step != 0;
+        group[group_size] = src[k];
+        m_gain[group_size] = _mm_add_ps(
+            _mm_set_ps1(start_scale[k]),
+            _mm_mul_ps(_mm_set_ps1(step), m_block_index));
+        m_gain_step[group_size] = _mm_set_ps1(4 * step);
+        ++group_size;
+      }
+
+      if (group_size == kMaxInputsPerPass) {
+        if (ramp)
+          Mix4_SSE<true>(group, m_gain, m_gain_step, block, block_end, dest);
+        else
+          Mix4_SSE<false>(group, m_gain, m_gain_step, block, block_end, dest);
+        continue;
+      }
+
+      // Fewer than four audible inputs remain; mix them two at a time.
+      int j = 0;
+      for (; j + 1 < group_size; j += 2) {
+        if (ramp) {
+          Mix2_SSE<true>(group + j, m_gain + j, m_gain_step + j, block,
+                         block_end, dest);
+        } else {
+          Mix2_SSE<false>(group + j, m_gain + j, m_gain_step + j, block,
+                          block_end, dest);
+        }
+      }
+      if (j < group_size) {
+        if (ramp) {
+          Mix1_SSE<true>(group[j], m_gain[j], m_gain_step[j], block,
+                         block_end, dest);
+        } else {
+          Mix1_SSE<false>(group[j], m_gain[j], m_gain_step[j], block,
+                          block_end, dest);
+        }
+      }
+    }
+  }
+
+  // Handle any remaining values that wouldn't fit in an SSE pass.
+  if (rem) {
+    FMACMultiRange_C(src, start_scale, end_scale, count, last_index, len,
+                     dest);
+  }
+}
+
+float DotProduct_SSE(const float a[], const float b[], int len) {
+  const int rem = len % 8;
+  const int last_index = len - rem;
+
+  // Use two accumulators to hide the latency of the additions.
+  __m128 m_sum0 = _mm_setzero_ps();
+  __m128 m_sum1 = _mm_setzero_ps();
+  for (int i = 0; i < last_index; i += 8) {
+    m_sum0 = _mm_add_ps(m_sum0, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                           _mm_loadu_ps(b + i)));
+    m_sum1 = _mm_add_ps(m_sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+                                           _mm_loadu_ps(b + i + 4)));
+  }
+
+  // Sum the four lanes of the accumulator.
+  m_sum0 = _mm_add_ps(m_sum0, m_sum1);
+  m_sum0 = _mm_add_ps(m_sum0, _mm_movehl_ps(m_sum0, m_sum0));
+  m_sum0 = _mm_add_ss(m_sum0, _mm_shuffle_ps(m_sum0, m_sum0, 1));
+  float sum;
+  _mm_store_ss(&sum, m_sum0);
+
+  // Handle any remaining values that wouldn't fit in an SSE pass.
+  if (rem)
+    sum += DotProduct_C(a + last_index, b + last_index, rem);
+  return sum;
+}
 #endif
 
 }  // namespace vector_math
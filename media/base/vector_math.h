@@ -17,6 +17,21 @@ enum { kRequiredAlignment = 16 };
 // |src| and |dest| must be aligned by kRequiredAlignment.
 MEDIA_EXPORT void FMAC(const float src[], float scale, int len, float dest[]);
 
+// Sums |count| vectors from |src| (each of length |len|) into |dest| in as few
+// passes over |dest| as possible.  Each input is multiplied by a gain which
+// moves linearly from |start_scale[k]| at the first element towards
+// |end_scale[k]| over |len| elements, so volume changes may be ramped without
+// an extra pass.  Inputs with zero start and end scale are skipped.  All
+// vectors in |src| and |dest| must be aligned by kRequiredAlignment.
+MEDIA_EXPORT void FMACMulti(const float* const src[], const float start_scale[],
+                            const float end_scale[], int count, int len,
+                            float dest[]);
+
+// Returns the sum of |a[i]| * |b[i]| over the first |len| elements.  Unlike the
+// other functions here, |a| and |b| need not be aligned, so that callers may
+// slide one vector along the other.
+MEDIA_EXPORT float DotProduct(const float a[], const float b[], int len);
+
 }  // namespace vector_math
 }  // namespace media
 
@@ -16,6 +16,22 @@ MEDIA_EXPORT void FMAC_C(const float src[], float scale, int len, float dest[]);
 MEDIA_EXPORT void FMAC_SSE(const float src[], float scale, int len,
                            float dest[]);
 
+// Optimized versions of FMACMulti() function exposed for testing.  See
+// vector_math.h for details.
+MEDIA_EXPORT void FMACMulti_C(const float* const src[],
+                              const float start_scale[],
+                              const float end_scale[], int count, int len,
+                              float dest[]);
+MEDIA_EXPORT void FMACMulti_SSE(const float* const src[],
+                                const float start_scale[],
+                                const float end_scale[], int count, int len,
+                                float dest[]);
+
+// Optimized versions of DotProduct() function exposed for testing.  See
+// vector_math.h for details.
+MEDIA_EXPORT float DotProduct_C(const float a[], const float b[], int len);
+MEDIA_EXPORT float DotProduct_SSE(const float a[], const float b[], int len);
+
 }  // namespace vector_math
 }  // namespace media
 
@@ -5,6 +5,7 @@
 // MSVC++ requires this to be set before any other includes to get M_PI.
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <vector>
 
 #include "base/command_line.h"
 #include "base/memory/aligned_memory.h"
@@ -27,6 +28,9 @@ static const float kScale = 0.5;
 static const float kInputFillValue = 1.0;
 static const float kOutputFillValue = 3.0;
 
+// Number of inputs mixed by the FMACMulti() tests.
+static const int kMaxMixInputs = 32;
+
 namespace media {
 
 class VectorMathTest : public testing::Test {
@@ -41,6 +45,41 @@ class VectorMathTest : public testing::Test {
         sizeof(float) * kVectorSize, vector_math::kRequiredAlignment)));
   }
 
+  virtual ~VectorMathTest() {
+    for (size_t i = 0; i < mix_inputs.size(); ++i)
+      base::AlignedFree(mix_inputs[i]);
+  }
+
+  // Allocates |count| input vectors for FMACMulti() where input |k| is filled
+  // with |k + 1|. Input |k| ramps from a scale of |k / count| to |kScale|,
+  // except that every third input is silent.
+  void CreateMixInputs(int count) {
+    for (int k = 0; k < count; ++k) {
+      float* input = static_cast<float*>(base::AlignedAlloc(
+          sizeof(float) * kVectorSize, vector_math::kRequiredAlignment));
+      fill(input, input + kVectorSize, static_cast<float>(k + 1));
+      mix_inputs.push_back(input);
+      bool silent = k % 3 == 2;
+      mix_start_scales.push_back(
+          silent ? 0 : static_cast<float>(k) / count);
+      mix_end_scales.push_back(silent ? 0 : kScale);
+    }
+  }
+
+  // Verifies |output_vector| against a scalar computation of FMACMulti() over
+  // the first |len| elements.
+  void VerifyMixOutput(int len) {
+    for (int i = 0; i < len; ++i) {
+      double expected = kOutputFillValue;
+      for (size_t k = 0; k < mix_inputs.size(); ++k) {
+        double step = (mix_end_scales[k] - mix_start_scales[k]) / len;
+        expected += mix_inputs[k][i] * (mix_start_scales[k] + step * i);
+      }
+      ASSERT_NEAR(expected, output_vector.get()[i], fabs(expected) * 1e-4)
+          << "i=" << i;
+    }
+  }
+
   void FillTestVectors(float input, float output) {
     // Setup input and output vectors.
     fill(input_vector.get(), input_vector.get() + kVectorSize, input);
@@ -66,6 +105,9 @@ class VectorMathTest : public testing::Test {
   int benchmark_iterations;
   scoped_ptr_malloc<float, base::ScopedPtrAlignedFree> input_vector;
   scoped_ptr_malloc<float, base::ScopedPtrAlignedFree> output_vector;
+  std::vector<float*> mix_inputs;
+  std::vector<float> mix_start_scales;
+  std::vector<float> mix_end_scales;
 
   DISALLOW_COPY_AND_ASSIGN(VectorMathTest);
 };
@@ -152,4 +194,110 @@ TEST_F(VectorMathTest, FMACBenchmark) {
 #endif
 }
 
+// Ensure each optimized vector_math::FMACMulti() method mixes and ramps
+// inputs correctly, including sizes which aren't a multiple of the SSE width
+// or the block size.
+TEST_F(VectorMathTest, FMACMulti) {
+  CreateMixInputs(kMaxMixInputs);
+  const int kSizes[] = { kVectorSize, kVectorSize - 1, 255, 3 };
+
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    SCOPED_TRACE(kSizes[i]);
+    {
+      SCOPED_TRACE("FMACMulti");
+      FillTestVectors(kInputFillValue, kOutputFillValue);
+      vector_math::FMACMulti(
+          &mix_inputs[0], &mix_start_scales[0], &mix_end_scales[0],
+          static_cast<int>(mix_inputs.size()), kSizes[i],
+          output_vector.get());
+      VerifyMixOutput(kSizes[i]);
+    }
+
+    {
+      SCOPED_TRACE("FMACMulti_C");
+      FillTestVectors(kInputFillValue, kOutputFillValue);
+      vector_math::FMACMulti_C(
+          &mix_inputs[0], &mix_start_scales[0], &mix_end_scales[0],
+          static_cast<int>(mix_inputs.size()), kSizes[i],
+          output_vector.get());
+      VerifyMixOutput(kSizes[i]);
+    }
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+    {
+      SCOPED_TRACE("FMACMulti_SSE");
+      FillTestVectors(kInputFillValue, kOutputFillValue);
+      vector_math::FMACMulti_SSE(
+          &mix_inputs[0], &mix_start_scales[0], &mix_end_scales[0],
+          static_cast<int>(mix_inputs.size()), kSizes[i],
+          output_vector.get());
+      VerifyMixOutput(kSizes[i]);
+    }
+#endif
+  }
+}
+
+// Ensure each optimized vector_math::DotProduct() method returns the same
+// value, including for unaligned inputs and lengths which aren't a multiple of
+// the SSE width.
+TEST_F(VectorMathTest, DotProduct) {
+  FillTestVectors(kInputFillValue, kOutputFillValue);
+  const int kSizes[] = { kVectorSize - 1, 13, 3, 0 };
+
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    SCOPED_TRACE(kSizes[i]);
+    const float kResult = kSizes[i] * kInputFillValue * kOutputFillValue;
+
+    EXPECT_FLOAT_EQ(kResult, vector_math::DotProduct(
+        input_vector.get() + 1, output_vector.get(), kSizes[i]));
+    EXPECT_FLOAT_EQ(kResult, vector_math::DotProduct_C(
+        input_vector.get() + 1, output_vector.get(), kSizes[i]));
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+    EXPECT_FLOAT_EQ(kResult, vector_math::DotProduct_SSE(
+        input_vector.get() + 1, output_vector.get(), kSizes[i]));
+#endif
+  }
+}
+
+// Benchmark for mixing an increasing number of inputs with one FMAC() call
+// per input versus a single FMACMulti() call.
+TEST_F(VectorMathTest, FMACMultiBenchmark) {
+  static const int kBenchmarkIterations = BenchmarkIterations();
+  CreateMixInputs(kMaxMixInputs);
+  // Mix at constant volume so FMAC() does the same work as FMACMulti().
+  std::copy(mix_end_scales.begin(), mix_end_scales.end(),
+            mix_start_scales.begin());
+
+  printf("Benchmarking %d iterations:\n", kBenchmarkIterations);
+
+  for (int inputs = 1; inputs <= kMaxMixInputs; inputs *= 2) {
+    FillTestVectors(kInputFillValue, kOutputFillValue);
+    TimeTicks start = TimeTicks::HighResNow();
+    for (int i = 0; i < kBenchmarkIterations; ++i) {
+      for (int k = 0; k < inputs; ++k) {
+        if (mix_end_scales[k] == 0)
+          continue;
+        vector_math::FMAC(mix_inputs[k], mix_end_scales[k], kVectorSize,
+                          output_vector.get());
+      }
+    }
+    double total_time_fmac_ms =
+        (TimeTicks::HighResNow() - start).InMillisecondsF();
+
+    FillTestVectors(kInputFillValue, kOutputFillValue);
+    start = TimeTicks::HighResNow();
+    for (int i = 0; i < kBenchmarkIterations; ++i) {
+      vector_math::FMACMulti(
+          &mix_inputs[0], &mix_start_scales[0], &mix_end_scales[0], inputs,
+          kVectorSize, output_vector.get());
+    }
+    double total_time_multi_ms =
+        (TimeTicks::HighResNow() - start).InMillisecondsF();
+
+    printf("%2d inputs: FMAC took %.2fms; FMACMulti took %.2fms, which is "
+           "%.2fx faster.\n", inputs, total_time_fmac_ms, total_time_multi_ms,
+           total_time_fmac_ms / total_time_multi_ms);
+  }
+}
+
 }  // namespace media
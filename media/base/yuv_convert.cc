@@ -17,9 +17,15 @@
 
 #include "media/base/yuv_convert.h"
 
+#include "base/atomicops.h"
+#include "base/bind.h"
 #include "base/cpu.h"
+#include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/worker_pool.h"
 #include "build/build_config.h"
 #include "media/base/simd/convert_rgb_to_yuv.h"
 #include "media/base/simd/convert_yuv_to_rgb.h"
@@ -122,21 +128,241 @@ const int kFractionBits = 16;
 const int kFractionMax = 1 << kFractionBits;
 const int kFractionMask = ((1 << kFractionBits) - 1);
 
-// Scale a frame of YUV to 32 bit ARGB.
-void ScaleYUVToRGB32(const uint8* y_buf,
-                     const uint8* u_buf,
-                     const uint8* v_buf,
-                     uint8* rgb_buf,
-                     int source_width,
-                     int source_height,
-                     int width,
-                     int height,
-                     int y_pitch,
-                     int uv_pitch,
-                     int rgb_pitch,
-                     YUVType yuv_type,
-                     Rotate view_rotate,
-                     ScaleFilter filter) {
+// Converts the destination rows [|begin|, |end|) of a frame; called with a
+// sub-range of the rows for each band of a multi-threaded conversion.
+typedef base::Callback<void(int, int)> ConvertRowsCallback;
+
+// The bands of one multi-threaded conversion. Each thread that runs
+// ConvertBands() converts bands nobody has claimed yet until none are left,
+// so the calling thread never waits for a worker that hasn't started; it
+// converts the remaining bands itself and only waits for the ones that are
+// being converted. Workers that start after that find nothing to do.
+class ConvertBandsJob : public base::RefCountedThreadSafe<ConvertBandsJob> {
+ public:
+  ConvertBandsJob(const ConvertRowsCallback& convert_rows,
+                  int rows,
+                  int band_rows,
+                  int num_bands)
+      : convert_rows_(convert_rows),
+        rows_(rows),
+        band_rows_(band_rows),
+        num_bands_(num_bands),
+        next_band_(0),
+        remaining_bands_(num_bands),
+        done_(false, false) {
+  }
+
+  void ConvertBands() {
+    for (;;) {
+      const int band =
+          base::subtle::NoBarrier_AtomicIncrement(&next_band_, 1) - 1;
+      if (band >= num_bands_)
+        return;
+      const int begin = band * band_rows_;
+      convert_rows_.Run(begin, std::min(begin + band_rows_, rows_));
+      EmptyRegisterState();
+      if (base::subtle::Barrier_AtomicIncrement(&remaining_bands_, -1) == 0)
+        done_.Signal();
+    }
+  }
+
+  // Returns once every band has been converted.
+  void Wait() {
+    done_.Wait();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ConvertBandsJob>;
+  ~ConvertBandsJob() {}
+
+  // Only run for claimed bands, so the frame it points to need not outlive
+  // the conversion.
+  const ConvertRowsCallback convert_rows_;
+  const int rows_;
+  const int band_rows_;
+  const int num_bands_;
+  base::subtle::Atomic32 next_band_;
+  base::subtle::Atomic32 remaining_bands_;
+  base::WaitableEvent done_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConvertBandsJob);
+};
+
+// Splits |rows| destination rows into up to |num_bands| bands, each starting
+// on a multiple of |row_alignment|, and runs |convert_rows| on every band,
+// on the calling thread and up to |num_bands| - 1 base::WorkerPool threads.
+// Returns once all bands are done.
+static void ConvertRowsInBands(int rows,
+                               int num_bands,
+                               int row_alignment,
+                               const ConvertRowsCallback& convert_rows) {
+  // Bands smaller than this do not amortize the cost of the thread hop.
+  const int kMinRowsPerBand = 32;
+  num_bands = std::min(num_bands, rows / kMinRowsPerBand);
+  if (num_bands <= 1) {
+    convert_rows.Run(0, rows);
+    return;
+  }
+
+  int band_rows = (rows + num_bands - 1) / num_bands;
+  band_rows = (band_rows + row_alignment - 1) / row_alignment * row_alignment;
+
+  num_bands = (rows + band_rows - 1) / band_rows;
+
+  scoped_refptr<ConvertBandsJob> job(
+      new ConvertBandsJob(convert_rows, rows, band_rows, num_bands));
+  for (int i = 1; i < num_bands; ++i) {
+    base::WorkerPool::PostTask(
+        FROM_HERE, base::Bind(&ConvertBandsJob::ConvertBands, job), false);
+  }
+  job->ConvertBands();
+  job->Wait();
+}
+
+// Everything ScaleYUVToRGB32Rows() needs to convert any row of the
+// destination, after rotation has been folded into the pointers and pitches.
+struct ScaleRowsParams {
+  const uint8* y_buf;
+  const uint8* u_buf;
+  const uint8* v_buf;
+  uint8* rgb_buf;
+  int source_width;
+  int source_height;
+  int width;
+  int y_pitch;
+  int uv_pitch;
+  int rgb_pitch;
+  unsigned int y_shift;
+  int source_dx;
+  int source_y_subpixel_start;
+  int source_y_subpixel_delta;
+  ScaleFilter filter;
+  FilterYUVRowsProc filter_proc;
+  ConvertYUVToRGB32RowProc convert_proc;
+  ScaleYUVToRGB32RowProc scale_proc;
+  ScaleYUVToRGB32RowProc linear_scale_proc;
+};
+
+// 4096 allows 3 buffers to fit in 12k.
+// Helps performance on CPU with 16K L1 cache.
+// Large enough for 3830x2160 and 30" displays which are 2560x1600.
+const int kFilterBufferSize = 4096;
+
+// Converts the destination rows [|y_begin|, |y_end|) described by |p|.
+static void ScaleYUVToRGB32Rows(const ScaleRowsParams& p,
+                                int y_begin,
+                                int y_end) {
+  const uint8* y_buf = p.y_buf;
+  const uint8* u_buf = p.u_buf;
+  const uint8* v_buf = p.v_buf;
+  const int source_width = p.source_width;
+  const int source_height = p.source_height;
+  const int y_pitch = p.y_pitch;
+  const int uv_pitch = p.uv_pitch;
+  const unsigned int y_shift = p.y_shift;
+  const int width = p.width;
+
+  // Need padding because FilterRows() will write 1 to 16 extra pixels
+  // after the end for SSE2 version.
+  uint8 yuvbuf[16 + kFilterBufferSize * 3 + 16];
+  uint8* ybuf =
+      reinterpret_cast<uint8*>(reinterpret_cast<uintptr_t>(yuvbuf + 15) & ~15);
+  uint8* ubuf = ybuf + kFilterBufferSize;
+  uint8* vbuf = ubuf + kFilterBufferSize;
+
+  // TODO(fbarchard): Split this into separate function for better efficiency.
+  for (int y = y_begin; y < y_end; ++y) {
+    uint8* dest_pixel = p.rgb_buf + y * p.rgb_pitch;
+    int source_y_subpixel =
+        p.source_y_subpixel_start + y * p.source_y_subpixel_delta;
+    if (source_y_subpixel < 0)
+      source_y_subpixel = 0;
+    else if (source_y_subpixel > ((source_height - 1) << kFractionBits))
+      source_y_subpixel = (source_height - 1) << kFractionBits;
+
+    const uint8* y_ptr = NULL;
+    const uint8* u_ptr = NULL;
+    const uint8* v_ptr = NULL;
+    // Apply vertical filtering if necessary.
+    // TODO(fbarchard): Remove memcpy when not necessary.
+    if (p.filter & media::FILTER_BILINEAR_V) {
+      int source_y = source_y_subpixel >> kFractionBits;
+      y_ptr = y_buf + source_y * y_pitch;
+      u_ptr = u_buf + (source_y >> y_shift) * uv_pitch;
+      v_ptr = v_buf + (source_y >> y_shift) * uv_pitch;
+
+      // Vertical scaler uses 16.8 fixed point.
+      int source_y_fraction =
+          (source_y_subpixel & kFractionMask) >> 8;
+      if (source_y_fraction != 0) {
+        p.filter_proc(ybuf, y_ptr, y_ptr + y_pitch, source_width,
+                      source_y_fraction);
+      } else {
+        memcpy(ybuf, y_ptr, source_width);
+      }
+      y_ptr = ybuf;
+      ybuf[source_width] = ybuf[source_width-1];
+
+      int uv_source_width = (source_width + 1) / 2;
+      int source_uv_fraction;
+
+      // For formats with half-height UV planes, each even-numbered pixel row
+      // should not interpolate, since the next row to interpolate from should
+      // be a duplicate of the current row.
+      if (y_shift && (source_y & 0x1) == 0)
+        source_uv_fraction = 0;
+      else
+        source_uv_fraction = source_y_fraction;
+
+      if (source_uv_fraction != 0) {
+        p.filter_proc(ubuf, u_ptr, u_ptr + uv_pitch, uv_source_width,
+                      source_uv_fraction);
+        p.filter_proc(vbuf, v_ptr, v_ptr + uv_pitch, uv_source_width,
+                      source_uv_fraction);
+      } else {
+        memcpy(ubuf, u_ptr, uv_source_width);
+        memcpy(vbuf, v_ptr, uv_source_width);
+      }
+      u_ptr = ubuf;
+      v_ptr = vbuf;
+      ubuf[uv_source_width] = ubuf[uv_source_width - 1];
+      vbuf[uv_source_width] = vbuf[uv_source_width - 1];
+    } else {
+      // Offset by 1/2 pixel for center sampling.
+      int source_y = (source_y_subpixel + (kFractionMax / 2)) >> kFractionBits;
+      y_ptr = y_buf + source_y * y_pitch;
+      u_ptr = u_buf + (source_y >> y_shift) * uv_pitch;
+      v_ptr = v_buf + (source_y >> y_shift) * uv_pitch;
+    }
+    if (p.source_dx == kFractionMax) {  // Not scaled
+      p.convert_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width);
+    } else {
+      if (p.filter & FILTER_BILINEAR_H) {
+        p.linear_scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width,
+                            p.source_dx);
+      } else {
+        p.scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width, p.source_dx);
+      }
+    }
+  }
+}
+
+// Shared implementation of ScaleYUVToRGB32 and ScaleYUVToRGB32Threaded.
+static void ScaleYUVToRGB32Impl(const uint8* y_buf,
+                                const uint8* u_buf,
+                                const uint8* v_buf,
+                                uint8* rgb_buf,
+                                int source_width,
+                                int source_height,
+                                int width,
+                                int height,
+                                int y_pitch,
+                                int uv_pitch,
+                                int rgb_pitch,
+                                YUVType yuv_type,
+                                Rotate view_rotate,
+                                ScaleFilter filter,
+                                int num_threads) {
   static FilterYUVRowsProc filter_proc = NULL;
   static ConvertYUVToRGB32RowProc convert_proc = NULL;
   static ScaleYUVToRGB32RowProc scale_proc = NULL;
@@ -157,10 +383,6 @@ void ScaleYUVToRGB32(const uint8* y_buf,
       width == 0 || height == 0)
     return;
 
-  // 4096 allows 3 buffers to fit in 12k.
-  // Helps performance on CPU with 16K L1 cache.
-  // Large enough for 3830x2160 and 30" displays which are 2560x1600.
-  const int kFilterBufferSize = 4096;
   // Disable filtering if the screen is too big (to avoid buffer overflows).
   // This should never happen to regular users: they don't have monitors
   // wider than 4096 pixels.
@@ -218,14 +440,6 @@ void ScaleYUVToRGB32(const uint8* y_buf,
     }
   }
 
-  // Need padding because FilterRows() will write 1 to 16 extra pixels
-  // after the end for SSE2 version.
-  uint8 yuvbuf[16 + kFilterBufferSize * 3 + 16];
-  uint8* ybuf =
-      reinterpret_cast<uint8*>(reinterpret_cast<uintptr_t>(yuvbuf + 15) & ~15);
-  uint8* ubuf = ybuf + kFilterBufferSize;
-  uint8* vbuf = ubuf + kFilterBufferSize;
-
   // TODO(fbarchard): Fixed point math is off by 1 on negatives.
 
   // We take a y-coordinate in [0,1] space in the source image space, and
@@ -235,90 +449,85 @@ void ScaleYUVToRGB32(const uint8* y_buf,
   // 0.75.  The formula is as follows (in fixed-point arithmetic):
   //   y_dst = dst_height * ((y_src + 0.5) / src_height)
   //   dst_pixel = clamp([0, dst_height - 1], floor(y_dst - 0.5))
-  // Implement this here as an accumulator + delta, to avoid expensive math
-  // in the loop.
+  // Implement this here as a start value + row * delta, so that any band of
+  // rows can be converted independently.
   int source_y_subpixel_accum =
     ((kFractionMax / 2) * source_height) / height - (kFractionMax / 2);
   int source_y_subpixel_delta = ((1 << kFractionBits) * source_height) / height;
 
-  // TODO(fbarchard): Split this into separate function for better efficiency.
-  for (int y = 0; y < height; ++y) {
-    uint8* dest_pixel = rgb_buf + y * rgb_pitch;
-    int source_y_subpixel = source_y_subpixel_accum;
-    source_y_subpixel_accum += source_y_subpixel_delta;
-    if (source_y_subpixel < 0)
-      source_y_subpixel = 0;
-    else if (source_y_subpixel > ((source_height - 1) << kFractionBits))
-      source_y_subpixel = (source_height - 1) << kFractionBits;
-
-    const uint8* y_ptr = NULL;
-    const uint8* u_ptr = NULL;
-    const uint8* v_ptr = NULL;
-    // Apply vertical filtering if necessary.
-    // TODO(fbarchard): Remove memcpy when not necessary.
-    if (filter & media::FILTER_BILINEAR_V) {
-      int source_y = source_y_subpixel >> kFractionBits;
-      y_ptr = y_buf + source_y * y_pitch;
-      u_ptr = u_buf + (source_y >> y_shift) * uv_pitch;
-      v_ptr = v_buf + (source_y >> y_shift) * uv_pitch;
-
-      // Vertical scaler uses 16.8 fixed point.
-      int source_y_fraction =
-          (source_y_subpixel & kFractionMask) >> 8;
-      if (source_y_fraction != 0) {
-        filter_proc(ybuf, y_ptr, y_ptr + y_pitch, source_width,
-                    source_y_fraction);
-      } else {
-        memcpy(ybuf, y_ptr, source_width);
-      }
-      y_ptr = ybuf;
-      ybuf[source_width] = ybuf[source_width-1];
-
-      int uv_source_width = (source_width + 1) / 2;
-      int source_uv_fraction;
-
-      // For formats with half-height UV planes, each even-numbered pixel row
-      // should not interpolate, since the next row to interpolate from should
-      // be a duplicate of the current row.
-      if (y_shift && (source_y & 0x1) == 0)
-        source_uv_fraction = 0;
-      else
-        source_uv_fraction = source_y_fraction;
-
-      if (source_uv_fraction != 0) {
-        filter_proc(ubuf, u_ptr, u_ptr + uv_pitch, uv_source_width,
-            source_uv_fraction);
-        filter_proc(vbuf, v_ptr, v_ptr + uv_pitch, uv_source_width,
-            source_uv_fraction);
-      } else {
-        memcpy(ubuf, u_ptr, uv_source_width);
-        memcpy(vbuf, v_ptr, uv_source_width);
-      }
-      u_ptr = ubuf;
-      v_ptr = vbuf;
-      ubuf[uv_source_width] = ubuf[uv_source_width - 1];
-      vbuf[uv_source_width] = vbuf[uv_source_width - 1];
-    } else {
-      // Offset by 1/2 pixel for center sampling.
-      int source_y = (source_y_subpixel + (kFractionMax / 2)) >> kFractionBits;
-      y_ptr = y_buf + source_y * y_pitch;
-      u_ptr = u_buf + (source_y >> y_shift) * uv_pitch;
-      v_ptr = v_buf + (source_y >> y_shift) * uv_pitch;
-    }
-    if (source_dx == kFractionMax) {  // Not scaled
-      convert_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width);
-    } else {
-      if (filter & FILTER_BILINEAR_H) {
-        linear_scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width, source_dx);
-      } else {
-        scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width, source_dx);
-      }
-    }
+  ScaleRowsParams params;
+  params.y_buf = y_buf;
+  params.u_buf = u_buf;
+  params.v_buf = v_buf;
+  params.rgb_buf = rgb_buf;
+  params.source_width = source_width;
+  params.source_height = source_height;
+  params.width = width;
+  params.y_pitch = y_pitch;
+  params.uv_pitch = uv_pitch;
+  params.rgb_pitch = rgb_pitch;
+  params.y_shift = y_shift;
+  params.source_dx = source_dx;
+  params.source_y_subpixel_start = source_y_subpixel_accum;
+  params.source_y_subpixel_delta = source_y_subpixel_delta;
+  params.filter = filter;
+  params.filter_proc = filter_proc;
+  params.convert_proc = convert_proc;
+  params.scale_proc = scale_proc;
+  params.linear_scale_proc = linear_scale_proc;
+
+  if (num_threads > 1) {
+    // Every destination row is computed independently from the source, so
+    // bands need no alignment.
+    ConvertRowsInBands(height, num_threads, 1,
+                       base::Bind(&ScaleYUVToRGB32Rows, params));
+  } else {
+    ScaleYUVToRGB32Rows(params, 0, height);
   }
 
   EmptyRegisterState();
 }
 
+// Scale a frame of YUV to 32 bit ARGB.
+void ScaleYUVToRGB32(const uint8* y_buf,
+                     const uint8* u_buf,
+                     const uint8* v_buf,
+                     uint8* rgb_buf,
+                     int source_width,
+                     int source_height,
+                     int width,
+                     int height,
+                     int y_pitch,
+                     int uv_pitch,
+                     int rgb_pitch,
+                     YUVType yuv_type,
+                     Rotate view_rotate,
+                     ScaleFilter filter) {
+  ScaleYUVToRGB32Impl(y_buf, u_buf, v_buf, rgb_buf, source_width,
+                      source_height, width, height, y_pitch, uv_pitch,
+                      rgb_pitch, yuv_type, view_rotate, filter, 1);
+}
+
+void ScaleYUVToRGB32Threaded(const uint8* y_buf,
+                             const uint8* u_buf,
+                             const uint8* v_buf,
+                             uint8* rgb_buf,
+                             int source_width,
+                             int source_height,
+                             int width,
+                             int height,
+                             int y_pitch,
+                             int uv_pitch,
+                             int rgb_pitch,
+                             YUVType yuv_type,
+                             Rotate view_rotate,
+                             ScaleFilter filter,
+                             int num_threads) {
+  ScaleYUVToRGB32Impl(y_buf, u_buf, v_buf, rgb_buf, source_width,
+                      source_height, width, height, y_pitch, uv_pitch,
+                      rgb_pitch, yuv_type, view_rotate, filter, num_threads);
+}
+
 // Scale a frame of YV12 to 32 bit ARGB for a specific rectangle.
 void ScaleYUVToRGB32WithRect(const uint8* y_buf,
                              const uint8* u_buf,
@@ -603,4 +812,57 @@ void ConvertYUVToRGB32(const uint8* yplane,
 #endif
 }
 
+// Arguments of a ConvertYUVToRGB32 call, for converting it in bands.
+struct ConvertRowsParams {
+  const uint8* yplane;
+  const uint8* uplane;
+  const uint8* vplane;
+  uint8* rgbframe;
+  int width;
+  int ystride;
+  int uvstride;
+  int rgbstride;
+  YUVType yuv_type;
+};
+
+static void ConvertYUVToRGB32Rows(const ConvertRowsParams& p,
+                                  int begin,
+                                  int end) {
+  unsigned int y_shift = p.yuv_type;
+  ConvertYUVToRGB32(p.yplane + begin * p.ystride,
+                    p.uplane + (begin >> y_shift) * p.uvstride,
+                    p.vplane + (begin >> y_shift) * p.uvstride,
+                    p.rgbframe + begin * p.rgbstride,
+                    p.width, end - begin,
+                    p.ystride, p.uvstride, p.rgbstride, p.yuv_type);
+}
+
+void ConvertYUVToRGB32Threaded(const uint8* yplane,
+                               const uint8* uplane,
+                               const uint8* vplane,
+                               uint8* rgbframe,
+                               int width,
+                               int height,
+                               int ystride,
+                               int uvstride,
+                               int rgbstride,
+                               YUVType yuv_type,
+                               int num_threads) {
+  ConvertRowsParams params;
+  params.yplane = yplane;
+  params.uplane = uplane;
+  params.vplane = vplane;
+  params.rgbframe = rgbframe;
+  params.width = width;
+  params.ystride = ystride;
+  params.uvstride = uvstride;
+  params.rgbstride = rgbstride;
+  params.yuv_type = yuv_type;
+
+  // Bands of YV12 frames must start on even rows so that they begin on a
+  // chroma row boundary.
+  ConvertRowsInBands(height, num_threads, 1 << yuv_type,
+                     base::Bind(&ConvertYUVToRGB32Rows, params));
+}
+
 }  // namespace media
@@ -60,6 +60,25 @@ void ConvertYUVToRGB32(const uint8* yplane,
                        int rgbstride,
                        YUVType yuv_type);
 
+// Same as ConvertYUVToRGB32, but splits the frame into horizontal bands that
+// are converted concurrently by the calling thread and up to
+// |num_threads| - 1 base::WorkerPool threads. Blocks until the whole frame is
+// converted, but the calling thread converts every band that no worker has
+// started yet itself, so a busy pool never holds it up for longer than the
+// bands already in progress. Small frames are converted on the calling thread
+// only.
+void ConvertYUVToRGB32Threaded(const uint8* yplane,
+                               const uint8* uplane,
+                               const uint8* vplane,
+                               uint8* rgbframe,
+                               int width,
+                               int height,
+                               int ystride,
+                               int uvstride,
+                               int rgbstride,
+                               YUVType yuv_type,
+                               int num_threads);
+
 // Scale a frame of YUV to 32 bit ARGB.
 // Supports rotation and mirroring.
 void ScaleYUVToRGB32(const uint8* yplane,
@@ -77,6 +96,24 @@ void ScaleYUVToRGB32(const uint8* yplane,
                      Rotate view_rotate,
                      ScaleFilter filter);
 
+// Same as ScaleYUVToRGB32, but converts bands of destination rows
+// concurrently, as ConvertYUVToRGB32Threaded does.
+void ScaleYUVToRGB32Threaded(const uint8* yplane,
+                             const uint8* uplane,
+                             const uint8* vplane,
+                             uint8* rgbframe,
+                             int source_width,
+                             int source_height,
+                             int width,
+                             int height,
+                             int ystride,
+                             int uvstride,
+                             int rgbstride,
+                             YUVType yuv_type,
+                             Rotate view_rotate,
+                             ScaleFilter filter,
+                             int num_threads);
+
 // Biliner Scale a frame of YV12 to 32 bits ARGB on a specified rectangle.
 // |yplane|, etc and |rgbframe| should point to the top-left pixels of the
 // source and destination buffers.
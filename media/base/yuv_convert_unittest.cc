@@ -3,10 +3,13 @@
 // found in the LICENSE file.
 
 #include "base/base_paths.h"
+#include "base/command_line.h"
 #include "base/cpu.h"
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/path_service.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
 #include "media/base/djb2.h"
 #include "media/base/simd/convert_rgb_to_yuv.h"
 #include "media/base/simd/convert_yuv_to_rgb.h"
@@ -36,6 +39,11 @@ static const int kRGBSizeScaled = kScaledWidth * kScaledHeight * kBpp;
 static const int kRGB24Size = kSourceYSize * 3;
 static const int kRGBSizeConverted = kSourceYSize * kBpp;
 
+// Command line switch for the number of frames converted per configuration
+// in the conversion benchmark.
+static const char kBenchmarkIterations[] = "yuv-convert-iterations";
+static const int kDefaultIterations = 10;
+
 // Helper for reading test data into a scoped_array<uint8>.
 static void ReadData(const base::FilePath::CharType* filename,
                      int expected_size,
@@ -101,6 +109,80 @@ TEST(YUVConvertTest, YV12) {
   EXPECT_EQ(2413171226u, rgb_hash);
 }
 
+TEST(YUVConvertTest, YV12Threaded) {
+  scoped_array<uint8> yuv_bytes;
+  scoped_array<uint8> rgb_converted_bytes(new uint8[kRGBSizeConverted]);
+  ReadYV12Data(&yuv_bytes);
+
+  // Use a thread count that does not divide the height evenly.
+  media::ConvertYUVToRGB32Threaded(yuv_bytes.get(),
+                                   yuv_bytes.get() + kSourceUOffset,
+                                   yuv_bytes.get() + kSourceVOffset,
+                                   rgb_converted_bytes.get(),
+                                   kSourceWidth, kSourceHeight,
+                                   kSourceWidth,
+                                   kSourceWidth / 2,
+                                   kSourceWidth * kBpp,
+                                   media::YV12,
+                                   7);
+
+  uint32 rgb_hash = DJB2Hash(rgb_converted_bytes.get(), kRGBSizeConverted,
+                             kDJB2HashSeed);
+  EXPECT_EQ(2413171226u, rgb_hash);
+}
+
+// Reports frames per second converting YV12 frames to RGB at common video
+// sizes across thread counts. Disabled by default; run with
+// --gtest_also_run_disabled_tests --yuv-convert-iterations=N.
+TEST(YUVConvertTest, DISABLED_ConvertBenchmark) {
+  int iterations = kDefaultIterations;
+  std::string iterations_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkIterations));
+  base::StringToInt(iterations_switch, &iterations);
+  if (iterations < 1)
+    iterations = kDefaultIterations;
+
+  static const struct {
+    const char* name;
+    int width;
+    int height;
+  } kSizes[] = {
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "4K", 3840, 2160 },
+  };
+  static const int kThreadCounts[] = { 1, 2, 4, 8 };
+
+  printf("Benchmarking %d conversions per configuration:\n", iterations);
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    const int width = kSizes[i].width;
+    const int height = kSizes[i].height;
+    const int y_size = width * height;
+    scoped_array<uint8> yuv_bytes(new uint8[y_size * 3 / 2]);
+    for (int j = 0; j < y_size * 3 / 2; ++j)
+      yuv_bytes[j] = static_cast<uint8>(j * 7);
+    scoped_array<uint8> rgb_bytes(new uint8[y_size * kBpp]);
+
+    for (size_t j = 0; j < arraysize(kThreadCounts); ++j) {
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      for (int k = 0; k < iterations; ++k) {
+        media::ConvertYUVToRGB32Threaded(yuv_bytes.get(),
+                                         yuv_bytes.get() + y_size,
+                                         yuv_bytes.get() + y_size * 5 / 4,
+                                         rgb_bytes.get(),
+                                         width, height,
+                                         width, width / 2, width * kBpp,
+                                         media::YV12,
+                                         kThreadCounts[j]);
+      }
+      const double elapsed_ms =
+          (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+      printf("  %-5s %d threads: %7.1f frames/s\n", kSizes[i].name,
+             kThreadCounts[j], iterations * 1000 / elapsed_ms);
+    }
+  }
+}
+
 TEST(YUVConvertTest, YV16) {
   // Allocate all surfaces.
   scoped_array<uint8> yuv_bytes;
@@ -268,6 +350,26 @@ TEST_P(YUVScaleTest, OddWidthAndHeightNotCrash) {
                          GetParam().scale_filter);
 }
 
+TEST_P(YUVScaleTest, Threaded) {
+  media::ScaleYUVToRGB32Threaded(y_plane(),                    // Y
+                                 u_plane(),                    // U
+                                 v_plane(),                    // V
+                                 rgb_bytes_.get(),             // RGB output
+                                 kSourceWidth, kSourceHeight,  // Dimensions
+                                 kScaledWidth, kScaledHeight,  // Dimensions
+                                 kSourceWidth,                 // YStride
+                                 kSourceWidth / 2,             // UvStride
+                                 kScaledWidth * kBpp,          // RgbStride
+                                 GetParam().yuv_type,
+                                 media::ROTATE_0,
+                                 GetParam().scale_filter,
+                                 4);                           // Threads
+
+  // Banded conversion must produce exactly the single threaded output.
+  uint32 rgb_hash = DJB2Hash(rgb_bytes_.get(), kRGBSizeScaled, kDJB2HashSeed);
+  EXPECT_EQ(GetParam().rgb_hash, rgb_hash);
+}
+
 INSTANTIATE_TEST_CASE_P(
     YUVScaleFormats, YUVScaleTest,
     ::testing::Values(
@@ -9,8 +9,10 @@
 
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
-#include "media/audio/audio_util.h"
+#include "media/base/audio_bus.h"
+#include "media/base/buffers.h"
 #include "media/base/data_buffer.h"
+#include "media/filters/wsola_internals.h"
 
 namespace media {
 
@@ -23,30 +25,44 @@ static const int kStartingBufferSizeInBytes = 65536;
 // This number represents 3 seconds of 96kHz/16 bit 7.1 surround sound.
 static const int kMaxBufferSizeInBytes = 4608000;
 
-// Duration of audio segments used for crossfading (in seconds).
-static const double kWindowDuration = 0.08;
-
-// Duration of crossfade between audio segments (in seconds).
-static const double kCrossfadeDuration = 0.008;
-
 // Max/min supported playback rates for fast/slow audio. Audio outside of these
 // ranges are muted.
 // Audio at these speeds would sound better under a frequency domain algorithm.
 static const float kMinPlaybackRate = 0.5f;
 static const float kMaxPlaybackRate = 4.0f;
 
+// Overlap-and-add window size in milliseconds.
+static const int kOlaWindowSizeMs = 20;
+
+// Size of search interval in milliseconds. The search interval is
+// [-delta delta] around |output_time_| * |playback_rate_|. So the search
+// interval is 2 * delta.
+static const int kWsolaSearchIntervalMs = 30;
+
+// Width, in milliseconds, of the interval around the previous optimal block
+// which is excluded from the search.
+static const int kExcludeIntervalMs = 4;
+
 AudioRendererAlgorithm::AudioRendererAlgorithm()
     : channels_(0),
       samples_per_second_(0),
       bytes_per_channel_(0),
       playback_rate_(0.0f),
       audio_buffer_(0, kStartingBufferSizeInBytes),
-      bytes_in_crossfade_(0),
       bytes_per_frame_(0),
-      index_into_window_(0),
-      crossfade_frame_number_(0),
       muted_(false),
-      window_size_(0) {
+      muted_partial_frame_(0),
+      end_of_stream_(false),
+      end_of_stream_padding_frames_(0),
+      output_time_(0),
+      search_block_center_offset_(0),
+      search_block_index_(0),
+      num_candidate_blocks_(0),
+      target_block_index_(0),
+      ola_window_size_(0),
+      ola_hop_size_(0),
+      num_complete_frames_(0),
+      exclude_interval_half_width_(0) {
 }
 
 AudioRendererAlgorithm::~AudioRendererAlgorithm() {}
@@ -61,297 +77,325 @@ void AudioRendererAlgorithm::Initialize(float initial_playback_rate,
   bytes_per_frame_ = params.GetBytesPerFrame();
   SetPlaybackRate(initial_playback_rate);
 
-  window_size_ =
-      samples_per_second_ * bytes_per_channel_ * channels_ * kWindowDuration;
-  AlignToFrameBoundary(&window_size_);
+  num_candidate_blocks_ = (kWsolaSearchIntervalMs * samples_per_second_) / 1000;
+  ola_window_size_ = kOlaWindowSizeMs * samples_per_second_ / 1000;
 
-  bytes_in_crossfade_ =
-      samples_per_second_ * bytes_per_channel_ * channels_ * kCrossfadeDuration;
-  AlignToFrameBoundary(&bytes_in_crossfade_);
+  // Make sure window size in an even number.
+  ola_window_size_ += ola_window_size_ & 1;
+  ola_hop_size_ = ola_window_size_ / 2;
 
-  crossfade_buffer_.reset(new uint8[bytes_in_crossfade_]);
+  // |num_candidate_blocks_| / 2 is the offset of the center of the search
+  // block to the center of the first (left most) candidate block. The offset
+  // of the center of a candidate block to its left most point is
+  // |ola_window_size_| / 2 - 1. Note that |ola_window_size_| is even and in
+  // our convention the center belongs to the left half, so we need to subtract
+  // one frame to get the correct offset.
+  //
+  //                             Search Block
+  //              <------------------------------------------->
+  //
+  //   |ola_window_size_| / 2 - 1
+  //              <----
+  //
+  //             |num_candidate_blocks_| / 2
+  //                   <----------------
+  //                                     center
+  //              X----X----------------X---------------X-----X
+  //              <---------->                     <---------->
+  //                Candidate      ...               Candidate
+  //                   1,          ...         |num_candidate_blocks_|
+  search_block_center_offset_ = num_candidate_blocks_ / 2 +
+      (ola_window_size_ / 2 - 1);
+
+  exclude_interval_half_width_ =
+      kExcludeIntervalMs * samples_per_second_ / 1000 / 2;
+
+  ola_window_.reset(new float[ola_window_size_]);
+  internal::GetSymmetricHanningWindow(ola_window_size_, ola_window_.get());
+
+  transition_window_.reset(new float[ola_window_size_ * 2]);
+  internal::GetSymmetricHanningWindow(2 * ola_window_size_,
+                                      transition_window_.get());
+
+  wsola_output_ = AudioBus::Create(channels_, ola_window_size_ + ola_hop_size_);
+
+  // Auxiliary containers.
+  optimal_block_ = AudioBus::Create(channels_, ola_window_size_);
+  search_block_ = AudioBus::Create(
+      channels_, num_candidate_blocks_ + (ola_window_size_ - 1));
+  target_block_ = AudioBus::Create(channels_, ola_window_size_);
+  peek_buffer_.reset(new uint8[search_block_->frames() * bytes_per_frame_]);
+
+  ResetWsola();
 }
 
-int AudioRendererAlgorithm::FillBuffer(
-    uint8* dest, int requested_frames) {
+int AudioRendererAlgorithm::FillBuffer(uint8* dest, int requested_frames) {
   DCHECK_NE(bytes_per_frame_, 0);
 
   if (playback_rate_ == 0.0f)
     return 0;
 
-  int slower_step = ceil(window_size_ * playback_rate_);
-  int faster_step = ceil(window_size_ / playback_rate_);
-  AlignToFrameBoundary(&slower_step);
-  AlignToFrameBoundary(&faster_step);
-
-  int total_frames_rendered = 0;
-  uint8* output_ptr = dest;
-  while (total_frames_rendered < requested_frames) {
-    if (index_into_window_ == window_size_)
-      ResetWindow();
-
-    bool rendered_frame = true;
-    if (window_size_ > faster_step) {
-      rendered_frame = OutputFasterPlayback(
-          output_ptr, window_size_, faster_step);
-    } else if (slower_step < window_size_) {
-      rendered_frame = OutputSlowerPlayback(
-          output_ptr, slower_step, window_size_);
-    } else {
-      rendered_frame = OutputNormalPlayback(output_ptr);
-    }
+  if (muted_)
+    return OutputMutedPlayback(dest, requested_frames);
 
-    if (!rendered_frame)
-      break;
+  // Output whatever is left over from earlier calls first.
+  int rendered_frames = WriteCompletedFramesTo(requested_frames, dest);
 
-    output_ptr += bytes_per_frame_;
-    total_frames_rendered++;
+  // Playing at normal speed needs no stretching, so copy the input directly.
+  if (playback_rate_ == 1.0f) {
+    if (rendered_frames < requested_frames) {
+      rendered_frames += OutputNormalPlayback(
+          dest + rendered_frames * bytes_per_frame_,
+          requested_frames - rendered_frames);
+    }
+    return rendered_frames;
   }
-  return total_frames_rendered;
-}
 
-void AudioRendererAlgorithm::ResetWindow() {
-  DCHECK_LE(index_into_window_, window_size_);
-  index_into_window_ = 0;
-  crossfade_frame_number_ = 0;
+  while (rendered_frames < requested_frames && !RenderedEndOfStream()) {
+    if (!RunOneWsolaIteration()) {
+      // Without more input the last search region can only be completed
+      // with silence.
+      if (!end_of_stream_ || end_of_stream_padding_frames_ > 0)
+        break;
+      PadEndOfStream();
+      continue;
+    }
+    rendered_frames += WriteCompletedFramesTo(
+        requested_frames - rendered_frames,
+        dest + rendered_frames * bytes_per_frame_);
+  }
+  return rendered_frames;
 }
 
-bool AudioRendererAlgorithm::OutputFasterPlayback(uint8* dest,
-                                                  int input_step,
-                                                  int output_step) {
-  // Ensure we don't run into OOB read/write situation.
-  CHECK_GT(input_step, output_step);
-  DCHECK_LT(index_into_window_, window_size_);
-  DCHECK_GT(playback_rate_, 1.0);
+int AudioRendererAlgorithm::OutputMutedPlayback(uint8* dest,
+                                                int requested_frames) {
+  ResetWsola();
 
-  if (audio_buffer_.forward_bytes() < bytes_per_frame_)
-    return false;
+  const int frames_available = audio_buffer_.forward_bytes() / bytes_per_frame_;
+  const int rendered_frames = std::min(
+      requested_frames, static_cast<int>(frames_available / playback_rate_));
 
-  // The audio data is output in a series of windows. For sped-up playback,
-  // the window is comprised of the following phases:
-  //
-  //  a) Output raw data.
-  //  b) Save bytes for crossfade in |crossfade_buffer_|.
-  //  c) Drop data.
-  //  d) Output crossfaded audio leading up to the next window.
-  //
-  // The duration of each phase is computed below based on the |window_size_|
-  // and |playback_rate_|.
-  int bytes_to_crossfade = bytes_in_crossfade_;
-  if (muted_ || bytes_to_crossfade > output_step)
-    bytes_to_crossfade = 0;
-
-  // This is the index of the end of phase a, beginning of phase b.
-  int outtro_crossfade_begin = output_step - bytes_to_crossfade;
-
-  // This is the index of the end of phase b, beginning of phase c.
-  int outtro_crossfade_end = output_step;
-
-  // This is the index of the end of phase c, beginning of phase d.
-  // This phase continues until |index_into_window_| reaches |window_size_|, at
-  // which point the window restarts.
-  int intro_crossfade_begin = input_step - bytes_to_crossfade;
-
-  // a) Output a raw frame if we haven't reached the crossfade section.
-  if (index_into_window_ < outtro_crossfade_begin) {
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
-    return true;
-  }
+  // Consume input in proportion to the playback rate, carrying fractions of a
+  // frame over to the next call.
+  muted_partial_frame_ += rendered_frames * playback_rate_;
+  const int frames_to_skip = std::min(
+      static_cast<int>(muted_partial_frame_), frames_available);
+  audio_buffer_.Seek(frames_to_skip * bytes_per_frame_);
+  muted_partial_frame_ -= frames_to_skip;
 
-  // b) Save outtro crossfade frames into intermediate buffer, but do not output
-  //    anything to |dest|.
-  while (index_into_window_ < outtro_crossfade_end) {
-    if (audio_buffer_.forward_bytes() < bytes_per_frame_)
-      return false;
-
-    // This phase only applies if there are bytes to crossfade.
-    DCHECK_GT(bytes_to_crossfade, 0);
-    uint8* place_to_copy = crossfade_buffer_.get() +
-        (index_into_window_ - outtro_crossfade_begin);
-    CopyWithAdvance(place_to_copy);
-    index_into_window_ += bytes_per_frame_;
-  }
+  memset(dest, 0, rendered_frames * bytes_per_frame_);
+  return rendered_frames;
+}
 
-  // c) Drop frames until we reach the intro crossfade section.
-  while (index_into_window_ < intro_crossfade_begin) {
-    if (audio_buffer_.forward_bytes() < bytes_per_frame_)
-      return false;
+int AudioRendererAlgorithm::OutputNormalPlayback(uint8* dest,
+                                                 int requested_frames) {
+  DCHECK_EQ(num_complete_frames_, 0);
+  ResetWsola();
 
-    DropFrame();
-    index_into_window_ += bytes_per_frame_;
-  }
+  const int bytes_read =
+      audio_buffer_.Read(dest, requested_frames * bytes_per_frame_);
+  DCHECK_EQ(bytes_read % bytes_per_frame_, 0);
+  return bytes_read / bytes_per_frame_;
+}
 
-  // Return if we have run out of data after Phase c).
-  if (audio_buffer_.forward_bytes() < bytes_per_frame_)
+bool AudioRendererAlgorithm::RunOneWsolaIteration() {
+  if (!CanPerformWsola())
     return false;
 
-  // Phase d) doesn't apply if there are no bytes to crossfade.
-  if (bytes_to_crossfade == 0) {
-    DCHECK_EQ(index_into_window_, window_size_);
-    return false;
+  GetOptimalBlock();
+
+  // Right after a reset there is no previous block to fade out of, so the
+  // first block is used as is rather than faded in from silence.
+  const bool first_block = output_time_ == 0;
+
+  // Overlap-and-add.  The first half of the optimal block is windowed and
+  // added to the second half of the previous block, windowed likewise; the
+  // windows sum to one.  The second half is stored as is, to be windowed by
+  // the next iteration.
+  DCHECK_LE(num_complete_frames_ + ola_window_size_, wsola_output_->frames());
+  for (int k = 0; k < channels_; ++k) {
+    const float* ch_opt_frame = optimal_block_->channel(k);
+    float* ch_output = wsola_output_->channel(k) + num_complete_frames_;
+    if (first_block) {
+      memcpy(ch_output, ch_opt_frame, sizeof(*ch_opt_frame) * ola_hop_size_);
+    } else {
+      for (int n = 0; n < ola_hop_size_; ++n) {
+        ch_output[n] = ch_output[n] * ola_window_[ola_hop_size_ + n] +
+            ch_opt_frame[n] * ola_window_[n];
+      }
+    }
+
+    memcpy(&ch_output[ola_hop_size_], &ch_opt_frame[ola_hop_size_],
+           sizeof(*ch_opt_frame) * ola_hop_size_);
   }
 
-  // d) Crossfade and output a frame.
-  DCHECK_LT(index_into_window_, window_size_);
-  int offset_into_buffer = index_into_window_ - intro_crossfade_begin;
-  memcpy(dest, crossfade_buffer_.get() + offset_into_buffer,
-         bytes_per_frame_);
-  scoped_array<uint8> intro_frame_ptr(new uint8[bytes_per_frame_]);
-  audio_buffer_.Read(intro_frame_ptr.get(), bytes_per_frame_);
-  OutputCrossfadedFrame(dest, intro_frame_ptr.get());
-  index_into_window_ += bytes_per_frame_;
+  num_complete_frames_ += ola_hop_size_;
+  UpdateOutputTime(ola_hop_size_);
+  RemoveOldInputFrames();
   return true;
 }
 
-bool AudioRendererAlgorithm::OutputSlowerPlayback(uint8* dest,
-                                                  int input_step,
-                                                  int output_step) {
-  // Ensure we don't run into OOB read/write situation.
-  CHECK_LT(input_step, output_step);
-  DCHECK_LT(index_into_window_, window_size_);
-  DCHECK_LT(playback_rate_, 1.0);
-  DCHECK_NE(playback_rate_, 0.0);
+bool AudioRendererAlgorithm::CanPerformWsola() {
+  const int search_block_size = num_candidate_blocks_ + (ola_window_size_ - 1);
+  const int frames = audio_buffer_.forward_bytes() / bytes_per_frame_;
+  return target_block_index_ + ola_window_size_ <= frames &&
+      search_block_index_ + search_block_size <= frames;
+}
 
-  if (audio_buffer_.forward_bytes() < bytes_per_frame_)
+bool AudioRendererAlgorithm::RenderedEndOfStream() {
+  if (end_of_stream_padding_frames_ == 0)
     return false;
 
-  // The audio data is output in a series of windows. For slowed down playback,
-  // the window is comprised of the following phases:
-  //
-  //  a) Output raw data.
-  //  b) Output and save bytes for crossfade in |crossfade_buffer_|.
-  //  c) Output* raw data.
-  //  d) Output* crossfaded audio leading up to the next window.
-  //
-  // * Phases c) and d) do not progress |audio_buffer_|'s cursor so that the
-  // |audio_buffer_|'s cursor is in the correct place for the next window.
-  //
-  // The duration of each phase is computed below based on the |window_size_|
-  // and |playback_rate_|.
-  int bytes_to_crossfade = bytes_in_crossfade_;
-  if (muted_ || bytes_to_crossfade > input_step)
-    bytes_to_crossfade = 0;
-
-  // This is the index of the end of phase a, beginning of phase b.
-  int intro_crossfade_begin = input_step - bytes_to_crossfade;
-
-  // This is the index of the end of phase b, beginning of phase c.
-  int intro_crossfade_end = input_step;
-
-  // This is the index of the end of phase c,  beginning of phase d.
-  // This phase continues until |index_into_window_| reaches |window_size_|, at
-  // which point the window restarts.
-  int outtro_crossfade_begin = output_step - bytes_to_crossfade;
-
-  // a) Output a raw frame.
-  if (index_into_window_ < intro_crossfade_begin) {
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
-    return true;
-  }
-
-  // b) Save the raw frame for the intro crossfade section, then output the
-  //    frame to |dest|.
-  if (index_into_window_ < intro_crossfade_end) {
-    int offset = index_into_window_ - intro_crossfade_begin;
-    uint8* place_to_copy = crossfade_buffer_.get() + offset;
-    CopyWithoutAdvance(place_to_copy);
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
-    return true;
-  }
+  // |output_time_| is the input position of the first incomplete output
+  // frame; once it reaches the padding all real input has been rendered.
+  const int frames = audio_buffer_.forward_bytes() / bytes_per_frame_;
+  return output_time_ >= frames - end_of_stream_padding_frames_;
+}
 
-  int audio_buffer_offset = index_into_window_ - intro_crossfade_end;
+void AudioRendererAlgorithm::PadEndOfStream() {
+  DCHECK(end_of_stream_);
+  DCHECK_EQ(end_of_stream_padding_frames_, 0);
+
+  // Enough for a whole search region and target block past the last frame.
+  const int padding_frames = num_candidate_blocks_ + ola_window_size_;
+  const int padding_bytes = padding_frames * bytes_per_frame_;
+  scoped_array<uint8> silence(new uint8[padding_bytes]);
+  memset(silence.get(), 0, padding_bytes);
+  audio_buffer_.Append(silence.get(), padding_bytes);
+  end_of_stream_padding_frames_ = padding_frames;
+}
 
-  if (audio_buffer_.forward_bytes() < audio_buffer_offset + bytes_per_frame_)
-    return false;
+bool AudioRendererAlgorithm::TargetIsWithinSearchRegion() const {
+  const int search_block_size = num_candidate_blocks_ + (ola_window_size_ - 1);
+  return target_block_index_ >= search_block_index_ &&
+      target_block_index_ + ola_window_size_ <=
+      search_block_index_ + search_block_size;
+}
 
-  // c) Output a raw frame into |dest| without advancing the |audio_buffer_|
-  //    cursor. See function-level comment.
-  DCHECK_GE(index_into_window_, intro_crossfade_end);
-  CopyWithoutAdvance(dest, audio_buffer_offset);
-
-  // d) Crossfade the next frame of |crossfade_buffer_| into |dest| if we've
-  //    reached the outtro crossfade section of the window.
-  if (index_into_window_ >= outtro_crossfade_begin) {
-    int offset_into_crossfade_buffer =
-        index_into_window_ - outtro_crossfade_begin;
-    uint8* intro_frame_ptr =
-        crossfade_buffer_.get() + offset_into_crossfade_buffer;
-    OutputCrossfadedFrame(dest, intro_frame_ptr);
+void AudioRendererAlgorithm::GetOptimalBlock() {
+  int optimal_index = 0;
+
+  if (TargetIsWithinSearchRegion()) {
+    // The block which follows the previous one is as good a match as there
+    // can be, so there is nothing to search for.
+    optimal_index = target_block_index_;
+    PeekAudioWithZeroPrepend(optimal_index, optimal_block_.get());
+  } else {
+    PeekAudioWithZeroPrepend(target_block_index_, target_block_.get());
+    PeekAudioWithZeroPrepend(search_block_index_, search_block_.get());
+
+    // Exclude the neighbourhood of the previous optimal block.
+    const int last_optimal =
+        target_block_index_ - ola_hop_size_ - search_block_index_;
+    const internal::Interval exclude_interval = std::make_pair(
+        last_optimal - exclude_interval_half_width_,
+        last_optimal + exclude_interval_half_width_);
+
+    optimal_index = internal::OptimalIndex(
+        search_block_.get(), target_block_.get(), exclude_interval);
+    optimal_index += search_block_index_;
+    PeekAudioWithZeroPrepend(optimal_index, optimal_block_.get());
+
+    // The target block is the best continuation of the output so far and the
+    // optimal block the closest match to it, which may still not line up
+    // perfectly.  Fade from the former into the latter over the block.
+    for (int k = 0; k < channels_; ++k) {
+      float* ch_opt = optimal_block_->channel(k);
+      const float* const ch_target = target_block_->channel(k);
+      for (int n = 0; n < ola_window_size_; ++n) {
+        ch_opt[n] = ch_opt[n] * transition_window_[n] +
+            ch_target[n] * transition_window_[ola_window_size_ + n];
+      }
+    }
   }
 
-  index_into_window_ += bytes_per_frame_;
-  return true;
+  // Next target is one hop ahead of the current optimal.
+  target_block_index_ = optimal_index + ola_hop_size_;
 }
 
-bool AudioRendererAlgorithm::OutputNormalPlayback(uint8* dest) {
-  if (audio_buffer_.forward_bytes() >= bytes_per_frame_) {
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
-    return true;
-  }
-  return false;
+void AudioRendererAlgorithm::UpdateOutputTime(double time_change) {
+  output_time_ += time_change * playback_rate_;
+  const int search_block_center_index = static_cast<int>(output_time_ + 0.5);
+  search_block_index_ = search_block_center_index - search_block_center_offset_;
 }
 
-void AudioRendererAlgorithm::CopyWithAdvance(uint8* dest) {
-  CopyWithoutAdvance(dest);
-  DropFrame();
-}
+void AudioRendererAlgorithm::RemoveOldInputFrames() {
+  const int earliest_used_index = std::min(target_block_index_,
+                                           search_block_index_);
+  if (earliest_used_index <= 0)
+    return;  // Nothing to remove.
+
+  audio_buffer_.Seek(earliest_used_index * bytes_per_frame_);
 
-void AudioRendererAlgorithm::CopyWithoutAdvance(uint8* dest) {
-  CopyWithoutAdvance(dest, 0);
+  // Adjust the indices which are relative to the current position.
+  output_time_ -= earliest_used_index;
+  target_block_index_ -= earliest_used_index;
+  search_block_index_ -= earliest_used_index;
 }
 
-void AudioRendererAlgorithm::CopyWithoutAdvance(
-    uint8* dest, int offset) {
-  if (muted_) {
-    memset(dest, 0, bytes_per_frame_);
-    return;
+int AudioRendererAlgorithm::WriteCompletedFramesTo(int requested_frames,
+                                                   uint8* dest) {
+  const int rendered_frames = std::min(num_complete_frames_, requested_frames);
+  if (rendered_frames == 0)
+    return 0;
+
+  wsola_output_->ToInterleavedPartial(0, rendered_frames, bytes_per_channel_,
+                                      dest);
+
+  // Remove the frames which are read.
+  const int frames_to_move = wsola_output_->frames() - rendered_frames;
+  for (int k = 0; k < channels_; ++k) {
+    float* ch = wsola_output_->channel(k);
+    memmove(ch, &ch[rendered_frames], sizeof(*ch) * frames_to_move);
   }
-  int copied = audio_buffer_.Peek(dest, bytes_per_frame_, offset);
-  DCHECK_EQ(bytes_per_frame_, copied);
+  num_complete_frames_ -= rendered_frames;
+  return rendered_frames;
 }
 
-void AudioRendererAlgorithm::DropFrame() {
-  audio_buffer_.Seek(bytes_per_frame_);
+void AudioRendererAlgorithm::PeekAudioWithZeroPrepend(int read_offset_frames,
+                                                      AudioBus* dest) {
+  int write_offset = 0;
+  int num_frames_to_read = dest->frames();
+  if (read_offset_frames < 0) {
+    const int num_zero_frames =
+        std::min(-read_offset_frames, num_frames_to_read);
+    dest->ZeroFrames(num_zero_frames);
+    write_offset = num_zero_frames;
+    num_frames_to_read -= num_zero_frames;
+    read_offset_frames = 0;
+  }
+  if (num_frames_to_read == 0)
+    return;
+
+  const int bytes_to_read = num_frames_to_read * bytes_per_frame_;
+  const int bytes_read = audio_buffer_.Peek(
+      peek_buffer_.get(), bytes_to_read, read_offset_frames * bytes_per_frame_);
+  DCHECK_EQ(bytes_to_read, bytes_read);
+  dest->FromInterleavedPartial(peek_buffer_.get(), write_offset,
+                               num_frames_to_read, bytes_per_channel_);
 }
 
-void AudioRendererAlgorithm::OutputCrossfadedFrame(
-    uint8* outtro, const uint8* intro) {
-  DCHECK_LE(index_into_window_, window_size_);
-  DCHECK(!muted_);
-
-  switch (bytes_per_channel_) {
-    case 4:
-      CrossfadeFrame<int32>(outtro, intro);
-      break;
-    case 2:
-      CrossfadeFrame<int16>(outtro, intro);
-      break;
-    case 1:
-      CrossfadeFrame<uint8>(outtro, intro);
-      break;
-    default:
-      NOTREACHED() << "Unsupported audio bit depth in crossfade.";
-  }
+void AudioRendererAlgorithm::ResetWsola() {
+  // Skip the input which has already been played, so that the timeline is
+  // unaffected by dropping the pending output.
+  if (output_time_ > 0)
+    audio_buffer_.Seek(GetPlayedFrames() * bytes_per_frame_);
+
+  output_time_ = 0;
+  search_block_index_ = 0;
+  target_block_index_ = 0;
+  num_complete_frames_ = 0;
+  if (wsola_output_)
+    wsola_output_->Zero();
 }
 
-template <class Type>
-void AudioRendererAlgorithm::CrossfadeFrame(
-    uint8* outtro_bytes, const uint8* intro_bytes) {
-  Type* outtro = reinterpret_cast<Type*>(outtro_bytes);
-  const Type* intro = reinterpret_cast<const Type*>(intro_bytes);
-
-  int frames_in_crossfade = bytes_in_crossfade_ / bytes_per_frame_;
-  float crossfade_ratio =
-      static_cast<float>(crossfade_frame_number_) / frames_in_crossfade;
-  for (int channel = 0; channel < channels_; ++channel) {
-    *outtro *= 1.0 - crossfade_ratio;
-    *outtro++ += (*intro++) * crossfade_ratio;
-  }
-  crossfade_frame_number_++;
+int AudioRendererAlgorithm::GetPlayedFrames() {
+  // |output_time_| is the input position of the first frame which is not yet
+  // complete; the complete frames ahead of it are still to be played.
+  const int frames = audio_buffer_.forward_bytes() / bytes_per_frame_;
+  const int played_frames = static_cast<int>(
+      output_time_ - num_complete_frames_ * playback_rate_);
+  return std::max(0, std::min(played_frames, frames));
 }
 
 void AudioRendererAlgorithm::SetPlaybackRate(float new_rate) {
@@ -359,31 +403,45 @@ void AudioRendererAlgorithm::SetPlaybackRate(float new_rate) {
   playback_rate_ = new_rate;
   muted_ =
       playback_rate_ < kMinPlaybackRate || playback_rate_ > kMaxPlaybackRate;
-
-  ResetWindow();
-}
-
-void AudioRendererAlgorithm::AlignToFrameBoundary(int* value) {
-  (*value) -= ((*value) % bytes_per_frame_);
 }
 
 void AudioRendererAlgorithm::FlushBuffers() {
-  ResetWindow();
-
   // Clear the queue of decoded packets (releasing the buffers).
   audio_buffer_.Clear();
+
+  ResetWsola();
+  muted_partial_frame_ = 0;
+  end_of_stream_ = false;
+  end_of_stream_padding_frames_ = 0;
+}
+
+void AudioRendererAlgorithm::MarkEndOfStream() {
+  end_of_stream_ = true;
 }
 
 base::TimeDelta AudioRendererAlgorithm::GetTime() {
-  return audio_buffer_.current_time();
+  // Account for the input which is only kept around for the WSOLA search.
+  const base::TimeDelta time = audio_buffer_.current_time();
+  if (time == kNoTimestamp() || !samples_per_second_)
+    return time;
+  return time + base::TimeDelta::FromMicroseconds(
+      GetPlayedFrames() * base::Time::kMicrosecondsPerSecond /
+      samples_per_second_);
 }
 
 void AudioRendererAlgorithm::EnqueueBuffer(
     const scoped_refptr<DataBuffer>& buffer_in) {
   DCHECK(!buffer_in->IsEndOfStream());
+  DCHECK(!end_of_stream_);
   audio_buffer_.Append(buffer_in);
 }
 
+int AudioRendererAlgorithm::bytes_buffered() {
+  if (!bytes_per_frame_)
+    return audio_buffer_.forward_bytes();
+  return audio_buffer_.forward_bytes() - GetPlayedFrames() * bytes_per_frame_;
+}
+
 bool AudioRendererAlgorithm::IsQueueFull() {
   return audio_buffer_.forward_bytes() >= audio_buffer_.forward_capacity();
 }
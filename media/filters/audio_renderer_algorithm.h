@@ -12,9 +12,14 @@
 // This class is *not* thread-safe. Calls to enqueue and retrieve data must be
 // locked if called from multiple threads.
 //
-// AudioRendererAlgorithm uses a simple pitch-preservation algorithm to
-// stretch and compress audio data to meet playback speeds less than and
-// greater than the natural playback of the audio stream.
+// AudioRendererAlgorithm uses WSOLA (waveform similarity based overlap-add)
+// to stretch and compress audio data to meet playback speeds less than and
+// greater than the natural playback of the audio stream while preserving
+// pitch.  Output is built from overlapping windowed blocks of input; each
+// block is chosen from a small search region around the input position which
+// corresponds to the output position such that it best continues the audio
+// already output, which avoids the phase cancellation and clicks of plain
+// overlap-add.
 //
 // Audio at very low or very high playback rates are muted to preserve quality.
 
@@ -28,6 +33,7 @@
 
 namespace media {
 
+class AudioBus;
 class DataBuffer;
 
 class MEDIA_EXPORT AudioRendererAlgorithm {
@@ -40,7 +46,7 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
 
   // Tries to fill |requested_frames| frames into |dest| with possibly scaled
   // data from our |audio_buffer_|. Data is scaled based on the playback rate,
-  // using a variation of the Overlap-Add method to combine sample windows.
+  // using WSOLA to combine sample windows.
   //
   // Data from |audio_buffer_| is consumed in proportion to the playback rate.
   //
@@ -51,6 +57,11 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   // Clears |audio_buffer_|.
   void FlushBuffers();
 
+  // Tells the algorithm that no more input will be enqueued before the next
+  // FlushBuffers().  Stretched playback then renders the last buffered frames
+  // against silence instead of waiting for a search region that never fills.
+  void MarkEndOfStream();
+
   // Returns the time of the next byte in our data or kNoTimestamp() if current
   // time is unknown.
   base::TimeDelta GetTime();
@@ -71,10 +82,12 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   // Increase the capacity of |audio_buffer_| if possible.
   void IncreaseQueueCapacity();
 
-  // Returns the number of bytes left in |audio_buffer_|, which may be larger
-  // than QueueCapacity() in the event that EnqueueBuffer() delivered more data
-  // than |audio_buffer_| was intending to hold.
-  int bytes_buffered() { return audio_buffer_.forward_bytes(); }
+  // Returns the number of bytes left in |audio_buffer_| which have not been
+  // played out yet, which may be larger than QueueCapacity() in the event that
+  // EnqueueBuffer() delivered more data than |audio_buffer_| was intending to
+  // hold.  Input which has already been played but is kept around for the
+  // WSOLA search is not included.
+  int bytes_buffered();
 
   int bytes_per_frame() { return bytes_per_frame_; }
 
@@ -85,55 +98,64 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   bool is_muted() { return muted_; }
 
  private:
-  // Fills |dest| with one frame of audio data at normal speed. Returns true if
-  // a frame was rendered, false otherwise.
-  bool OutputNormalPlayback(uint8* dest);
+  // Returns the number of frames in |audio_buffer_| before the input position
+  // of the next frame to be output; see bytes_buffered().
+  int GetPlayedFrames();
 
-  // Fills |dest| with one frame of audio data at faster than normal speed.
-  // Returns true if a frame was rendered, false otherwise.
-  //
-  // When the audio playback is > 1.0, we use a variant of Overlap-Add to squish
-  // audio output while preserving pitch. Essentially, we play a bit of audio
-  // data at normal speed, then we "fast forward" by dropping the next bit of
-  // audio data, and then we stich the pieces together by crossfading from one
-  // audio chunk to the next.
-  bool OutputFasterPlayback(uint8* dest, int input_step, int output_step);
-
-  // Fills |dest| with one frame of audio data at slower than normal speed.
-  // Returns true if a frame was rendered, false otherwise.
-  //
-  // When the audio playback is < 1.0, we use a variant of Overlap-Add to
-  // stretch audio output while preserving pitch. This works by outputting a
-  // segment of audio data at normal speed. The next audio segment then starts
-  // by repeating some of the audio data from the previous audio segment.
-  // Segments are stiched together by crossfading from one audio chunk to the
-  // next.
-  bool OutputSlowerPlayback(uint8* dest, int input_step, int output_step);
-
-  // Resets the window state to the start of a new window.
-  void ResetWindow();
-
-  // Copies a raw frame from |audio_buffer_| into |dest| without progressing
-  // |audio_buffer_|'s internal "current" cursor. Optionally peeks at a forward
-  // byte |offset|.
-  void CopyWithoutAdvance(uint8* dest);
-  void CopyWithoutAdvance(uint8* dest, int offset);
-
-  // Copies a raw frame from |audio_buffer_| into |dest| and progresses the
-  // |audio_buffer_| forward.
-  void CopyWithAdvance(uint8* dest);
-
-  // Moves the |audio_buffer_| forward by one frame.
-  void DropFrame();
-
-  // Does a linear crossfade from |intro| into |outtro| for one frame.
-  // Assumes pointers are valid and are at least size of |bytes_per_frame_|.
-  void OutputCrossfadedFrame(uint8* outtro, const uint8* intro);
-  template <class Type>
-  void CrossfadeFrame(uint8* outtro, const uint8* intro);
-
-  // Rounds |*value| down to the nearest frame boundary.
-  void AlignToFrameBoundary(int* value);
+  // Fills |dest| with up to |requested_frames| frames of silence while
+  // consuming input in proportion to |playback_rate_|.  Returns the number of
+  // frames rendered.
+  int OutputMutedPlayback(uint8* dest, int requested_frames);
+
+  // Copies up to |requested_frames| frames from |audio_buffer_| into |dest|
+  // unmodified.  Returns the number of frames rendered.
+  int OutputNormalPlayback(uint8* dest, int requested_frames);
+
+  // Runs one iteration of WSOLA, adding |ola_hop_size_| complete frames to
+  // |wsola_output_|.  Returns false if there is not enough input to do so.
+  bool RunOneWsolaIteration();
+
+  // Returns true if |audio_buffer_| holds enough frames for both the target
+  // and the search block of the next WSOLA iteration.
+  bool CanPerformWsola();
+
+  // Returns true if, at end of stream, the complete output already covers
+  // every frame of real input, so the iterations left would only render
+  // the silence appended by PadEndOfStream().
+  bool RenderedEndOfStream();
+
+  // Appends enough silence to |audio_buffer_| for WSOLA to run past the last
+  // frame of real input.  Only done once per end of stream.
+  void PadEndOfStream();
+
+  // Returns true if the target block lies entirely within the search region,
+  // in which case it is the natural continuation and no search is needed.
+  bool TargetIsWithinSearchRegion() const;
+
+  // Finds the block to overlap-add next and stores it in |optimal_block_|,
+  // then moves |target_block_index_| to the block which naturally follows it.
+  void GetOptimalBlock();
+
+  // Advances the input position of the next block by |time_change| output
+  // frames and moves the search region with it.
+  void UpdateOutputTime(double time_change);
+
+  // Drops frames from |audio_buffer_| which no later WSOLA iteration can use.
+  void RemoveOldInputFrames();
+
+  // Copies up to |requested_frames| complete frames from |wsola_output_| into
+  // |dest| and removes them.  Returns the number of frames copied.
+  int WriteCompletedFramesTo(int requested_frames, uint8* dest);
+
+  // Deinterleaves |dest->frames()| frames of |audio_buffer_| starting
+  // |read_offset_frames| frames after the current position into |dest|,
+  // without advancing.  A negative offset is treated as zeros preceding the
+  // buffered data.
+  void PeekAudioWithZeroPrepend(int read_offset_frames, AudioBus* dest);
+
+  // Drops any WSOLA state and pending output, and moves |audio_buffer_|
+  // forward to the input which follows the last complete output frame.
+  void ResetWsola();
 
   // Number of channels in audio stream.
   int channels_;
@@ -150,28 +172,73 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   // Buffered audio data.
   SeekableBuffer audio_buffer_;
 
-  // Length for crossfade in bytes.
-  int bytes_in_crossfade_;
-
   // Length of frame in bytes.
   int bytes_per_frame_;
 
-  // The current location in the audio window, between 0 and |window_size_|.
-  // When |index_into_window_| reaches |window_size_|, the window resets.
-  // Indexed by byte.
-  int index_into_window_;
-
-  // The frame number in the crossfade.
-  int crossfade_frame_number_;
-
   // True if the audio should be muted.
   bool muted_;
 
-  // Temporary buffer to hold crossfade data.
-  scoped_array<uint8> crossfade_buffer_;
+  // Fraction of a frame of input left over after the last muted FillBuffer().
+  double muted_partial_frame_;
+
+  // True once MarkEndOfStream() has been called, and the number of frames of
+  // silence PadEndOfStream() appended to |audio_buffer_| since then.
+  bool end_of_stream_;
+  int end_of_stream_padding_frames_;
+
+  // Input position, in frames relative to the current position of
+  // |audio_buffer_|, which corresponds to the center of the next block to be
+  // overlap-added.  Advances by |playback_rate_| frames per output frame.
+  // Should only be changed via UpdateOutputTime() and RemoveOldInputFrames()
+  // so that |search_block_index_| stays in step.  It is zero exactly when no
+  // block has been overlap-added since the last reset.
+  double output_time_;
+
+  // The offset of the center frame of the search region from its first frame.
+  int search_block_center_offset_;
+
+  // Index of the first frame of the search region, relative to the current
+  // position of |audio_buffer_|.  May be negative at the start of playback.
+  int search_block_index_;
+
+  // Number of blocks, i.e. starting positions, in the search region.
+  int num_candidate_blocks_;
+
+  // Index of the block which naturally follows the last block overlap-added,
+  // relative to the current position of |audio_buffer_|.
+  int target_block_index_;
+
+  // Overlap-and-add window size, in frames, and the distance between
+  // consecutive windows in the output, which is half the window.
+  int ola_window_size_;
+  int ola_hop_size_;
+
+  // Frames at the start of |wsola_output_| which are ready to be output.
+  int num_complete_frames_;
+
+  // Half-built WSOLA output: |num_complete_frames_| complete frames followed
+  // by the unwindowed second half of the last block overlap-added.
+  scoped_ptr<AudioBus> wsola_output_;
+
+  // Overlap-and-add window.
+  scoped_array<float> ola_window_;
+
+  // Window, twice as long as |ola_window_|, used to cross-fade from the target
+  // block into the optimal block.
+  scoped_array<float> transition_window_;
+
+  // Scratch buffers for the block overlap-added next, the search region and
+  // the block the search tries to match.
+  scoped_ptr<AudioBus> optimal_block_;
+  scoped_ptr<AudioBus> search_block_;
+  scoped_ptr<AudioBus> target_block_;
+
+  // Interleaved scratch buffer large enough for |search_block_|.
+  scoped_array<uint8> peek_buffer_;
 
-  // Window size, in bytes (calculated from audio properties).
-  int window_size_;
+  // Number of frames on either side of the previous optimal block excluded
+  // from the search; re-using the same input over and over sounds buzzy.
+  int exclude_interval_half_width_;
 
   DISALLOW_COPY_AND_ASSIGN(AudioRendererAlgorithm);
 };
@@ -8,13 +8,22 @@
 // correct rate.  We always pass in a very large destination buffer with the
 // expectation that FillBuffer() will fill as much as it can but no more.
 
+// MSVC++ requires this to be set before any other includes to get M_PI.
+#define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/callback.h"
+#include "base/command_line.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "media/base/audio_bus.h"
 #include "media/base/channel_layout.h"
 #include "media/base/data_buffer.h"
 #include "media/filters/audio_renderer_algorithm.h"
+#include "media/filters/wsola_internals.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace media {
@@ -24,10 +33,28 @@ static const int kSamplesPerSecond = 3000;
 static const ChannelLayout kDefaultChannelLayout = CHANNEL_LAYOUT_STEREO;
 static const int kDefaultSampleBits = 16;
 
+// Pure tone used to measure the quality of stretched audio.
+static const int kToneSamplesPerSecond = 44100;
+static const double kToneFrequency = 440.0;
+static const int16 kToneAmplitude = 16000;
+
+// Command line switch for runtime adjustment of benchmark iterations. Each
+// iteration renders one second of audio at every stretched rate.
+static const char kBenchmarkIterations[] =
+    "audio-renderer-algorithm-iterations";
+static const int kDefaultIterations = 1;
+
+// Playback rates which are stretched rather than muted.
+static const float kStretchedRates[] = {
+  0.5f, 0.75f, 1.25f, 1.5f, 2.0f, 3.0f, 4.0f
+};
+
 class AudioRendererAlgorithmTest : public testing::Test {
  public:
   AudioRendererAlgorithmTest()
-      : bytes_enqueued_(0) {
+      : bytes_enqueued_(0),
+        tone_frequency_(0),
+        tone_phase_(0) {
   }
 
   virtual ~AudioRendererAlgorithmTest() {}
@@ -53,9 +80,13 @@ class AudioRendererAlgorithmTest : public testing::Test {
       scoped_array<uint8> audio_data(new uint8[kRawDataSize]);
       CHECK_EQ(kRawDataSize % algorithm_.bytes_per_channel(), 0u);
       CHECK_EQ(kRawDataSize % algorithm_.bytes_per_frame(), 0u);
-      // The value of the data is meaningless; we just want non-zero data to
-      // differentiate it from muted data.
-      memset(audio_data.get(), 1, kRawDataSize);
+      if (tone_frequency_ > 0) {
+        GenerateTone(audio_data.get());
+      } else {
+        // The value of the data is meaningless; we just want non-zero data to
+        // differentiate it from muted data.
+        memset(audio_data.get(), 1, kRawDataSize);
+      }
       algorithm_.EnqueueBuffer(new DataBuffer(audio_data.Pass(), kRawDataSize));
       bytes_enqueued_ += kRawDataSize;
     }
@@ -72,6 +103,52 @@ class AudioRendererAlgorithmTest : public testing::Test {
       ASSERT_NE(sum, 0);
   }
 
+  // Fills |audio_data| with |kRawDataSize| bytes of a sine wave at
+  // |tone_frequency_| on every channel, continuing from the previous call.
+  void GenerateTone(uint8* audio_data) {
+    CHECK_EQ(algorithm_.bytes_per_channel(), 2);
+    int16* samples = reinterpret_cast<int16*>(audio_data);
+    const int channels = algorithm_.bytes_per_frame() / 2;
+    const int frames = kRawDataSize / algorithm_.bytes_per_frame();
+    const double phase_step =
+        2 * M_PI * tone_frequency_ / algorithm_.samples_per_second();
+    for (int i = 0; i < frames; ++i) {
+      const int16 sample = static_cast<int16>(kToneAmplitude * sin(tone_phase_));
+      for (int ch = 0; ch < channels; ++ch)
+        samples[i * channels + ch] = sample;
+      tone_phase_ = fmod(tone_phase_ + phase_step, 2 * M_PI);
+    }
+  }
+
+  // Plays |seconds| of output at |playback_rate| and returns the first channel
+  // of it in |output|.  Returns the time spent in FillBuffer().
+  base::TimeDelta RenderChannel(float playback_rate, double seconds,
+                                std::vector<int16>* output) {
+    CHECK_EQ(algorithm_.bytes_per_channel(), 2);
+    algorithm_.SetPlaybackRate(playback_rate);
+
+    const int channels = algorithm_.bytes_per_frame() / 2;
+    const int frames_per_fill = algorithm_.samples_per_second() / 100;
+    const int total_frames =
+        static_cast<int>(seconds * algorithm_.samples_per_second());
+    scoped_array<int16> buffer(new int16[frames_per_fill * channels]);
+
+    base::TimeDelta fill_time;
+    output->clear();
+    while (static_cast<int>(output->size()) < total_frames) {
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      int frames_written = algorithm_.FillBuffer(
+          reinterpret_cast<uint8*>(buffer.get()), frames_per_fill);
+      fill_time += base::TimeTicks::HighResNow() - start;
+      CHECK_GT(frames_written, 0);
+
+      for (int i = 0; i < frames_written; ++i)
+        output->push_back(buffer[i * channels]);
+      FillAlgorithmQueue();
+    }
+    return fill_time;
+  }
+
   int ComputeConsumedBytes(int initial_bytes_enqueued,
                            int initial_bytes_buffered) {
     int byte_delta = bytes_enqueued_ - initial_bytes_enqueued;
@@ -151,6 +228,11 @@ class AudioRendererAlgorithmTest : public testing::Test {
  protected:
   AudioRendererAlgorithm algorithm_;
   int bytes_enqueued_;
+
+  // Frequency of the tone enqueued by FillAlgorithmQueue(), or zero for
+  // constant data.
+  double tone_frequency_;
+  double tone_phase_;
 };
 
 TEST_F(AudioRendererAlgorithmTest, FillBuffer_NormalRate) {
@@ -271,4 +353,178 @@ TEST_F(AudioRendererAlgorithmTest, FillBuffer_HigherQualityAudio) {
   TestPlaybackRate(1.5);
 }
 
+// At end of stream the last buffered input must be rendered even though the
+// WSOLA search region behind it can no longer be filled.
+TEST_F(AudioRendererAlgorithmTest, FillBuffer_EndOfStream) {
+  Initialize();
+
+  // Overlap-and-add hop size at |kSamplesPerSecond|: a 20ms window, halved.
+  static const int kHopFrames = kSamplesPerSecond * 20 / 1000 / 2;
+  static const float kRates[] = { 0.5f, 1.5f, 2.0f };
+  for (size_t i = 0; i < arraysize(kRates); ++i) {
+    SCOPED_TRACE(kRates[i]);
+    algorithm_.FlushBuffers();
+    FillAlgorithmQueue();
+    algorithm_.SetPlaybackRate(kRates[i]);
+    algorithm_.MarkEndOfStream();
+
+    const int input_frames =
+        algorithm_.bytes_buffered() / algorithm_.bytes_per_frame();
+    static const int kBufferSizeInFrames = 100;
+    scoped_array<uint8> buffer(
+        new uint8[kBufferSizeInFrames * algorithm_.bytes_per_frame()]);
+    int output_frames = 0;
+    int frames_written = 0;
+    while ((frames_written = algorithm_.FillBuffer(
+                buffer.get(), kBufferSizeInFrames)) > 0) {
+      CheckFakeData(buffer.get(), frames_written);
+      output_frames += frames_written;
+    }
+
+    // Every input frame is played, followed by at most one hop of output
+    // overlapping the silence after the end.
+    EXPECT_GE(output_frames * kRates[i], input_frames);
+    EXPECT_LT(output_frames, input_frames / kRates[i] + kHopFrames);
+  }
+}
+
+// Stretches a pure tone and checks that the output is still the same tone:
+// the pitch is unchanged and every period is as long as in the input.  Blocks
+// which are overlap-added out of phase show up as periods which are too short
+// or too long.
+TEST_F(AudioRendererAlgorithmTest, Quality_PureTone) {
+  tone_frequency_ = kToneFrequency;
+  Initialize(kDefaultChannelLayout, kDefaultSampleBits, kToneSamplesPerSecond);
+
+  const double kPeriod = kToneSamplesPerSecond / kToneFrequency;
+  for (size_t i = 0; i < arraysize(kStretchedRates); ++i) {
+    SCOPED_TRACE(kStretchedRates[i]);
+    algorithm_.FlushBuffers();
+    FillAlgorithmQueue();
+
+    std::vector<int16> output;
+    RenderChannel(kStretchedRates[i], 1.0, &output);
+
+    // Measure the length of every period from one rising zero crossing to the
+    // next.
+    int periods = 0;
+    int last_crossing = -1;
+    double max_period_error = 0;
+    for (size_t n = 1; n < output.size(); ++n) {
+      if (output[n - 1] >= 0 || output[n] < 0)
+        continue;
+      if (last_crossing >= 0) {
+        max_period_error = std::max(max_period_error,
+                                    std::abs((n - last_crossing) - kPeriod));
+        ++periods;
+      }
+      last_crossing = n;
+    }
+
+    const double frequency =
+        periods * kToneSamplesPerSecond / static_cast<double>(output.size());
+    EXPECT_NEAR(kToneFrequency, frequency, kToneFrequency * 0.01);
+
+    // Zero crossings fall between samples, so allow up to two samples.
+    EXPECT_LT(max_period_error, 2.0);
+  }
+}
+
+// Benchmark for FillBuffer() at each stretched playback rate.  Reports the CPU
+// time needed to produce a second of 44.1kHz stereo audio.  Make sure to build
+// with branding=Chrome so that DCHECKs are compiled out when benchmarking.
+// Original benchmarks were run with --audio-renderer-algorithm-iterations=10.
+TEST_F(AudioRendererAlgorithmTest, FillBufferBenchmark) {
+  int iterations = kDefaultIterations;
+  std::string iterations_string(
+      CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          kBenchmarkIterations));
+  if (!iterations_string.empty())
+    base::StringToInt(iterations_string, &iterations);
+  const double kSeconds = std::max(iterations, 1);
+
+  tone_frequency_ = kToneFrequency;
+  Initialize(kDefaultChannelLayout, kDefaultSampleBits, kToneSamplesPerSecond);
+
+  for (size_t i = 0; i < arraysize(kStretchedRates); ++i) {
+    algorithm_.FlushBuffers();
+    FillAlgorithmQueue();
+
+    std::vector<int16> output;
+    base::TimeDelta fill_time =
+        RenderChannel(kStretchedRates[i], kSeconds, &output);
+    printf("FillBuffer() at %.2fx took %.2fms per second of audio.\n",
+           kStretchedRates[i], fill_time.InMillisecondsF() / kSeconds);
+  }
+}
+
+TEST(WsolaInternalsTest, MovingBlockEnergies) {
+  const int kChannels = 2;
+  const int kFrames = 20;
+  const int kFramesPerBlock = 5;
+  const int kNumBlocks = kFrames - (kFramesPerBlock - 1);
+  scoped_ptr<AudioBus> input = AudioBus::Create(kChannels, kFrames);
+  for (int k = 0; k < kChannels; ++k) {
+    for (int n = 0; n < kFrames; ++n)
+      input->channel(k)[n] = sin(0.3 * n * (k + 1));
+  }
+
+  float energies[kChannels * kNumBlocks];
+  internal::MultiChannelMovingBlockEnergies(input.get(), kFramesPerBlock,
+                                            energies);
+
+  float dot_product[kChannels];
+  for (int m = 0; m < kNumBlocks; ++m) {
+    internal::MultiChannelDotProduct(input.get(), m, input.get(), m,
+                                     kFramesPerBlock, dot_product);
+    for (int k = 0; k < kChannels; ++k)
+      EXPECT_NEAR(dot_product[k], energies[m * kChannels + k], 1e-5);
+  }
+}
+
+// OptimalIndex() should find a block embedded in noise, and avoid it when it
+// is excluded.
+TEST(WsolaInternalsTest, OptimalIndex) {
+  const int kChannels = 2;
+  const int kTargetFrames = 64;
+  const int kSearchFrames = 256;
+  const int kTargetIndex = 97;
+
+  scoped_ptr<AudioBus> search_block = AudioBus::Create(kChannels,
+                                                       kSearchFrames);
+  scoped_ptr<AudioBus> target_block = AudioBus::Create(kChannels,
+                                                       kTargetFrames);
+  for (int k = 0; k < kChannels; ++k) {
+    // Low-pass filtered pseudo-random noise, so that only one block matches
+    // but, like real audio, the match is wider than the search decimation.
+    unsigned int seed = 1 + k;
+    float filtered = 0;
+    for (int n = 0; n < kSearchFrames; ++n) {
+      seed = seed * 1103515245 + 12345;
+      const float noise =
+          static_cast<float>((seed >> 16) & 0x7fff) / 0x4000 - 1.0f;
+      filtered = 0.8f * filtered + 0.2f * noise;
+      search_block->channel(k)[n] = filtered;
+    }
+    memcpy(target_block->channel(k), search_block->channel(k) + kTargetIndex,
+           sizeof(float) * kTargetFrames);
+  }
+
+  EXPECT_EQ(kTargetIndex, internal::OptimalIndex(
+      search_block.get(), target_block.get(), std::make_pair(-10, -1)));
+
+  int index = internal::OptimalIndex(
+      search_block.get(), target_block.get(),
+      std::make_pair(kTargetIndex - 5, kTargetIndex + 5));
+  EXPECT_TRUE(index < kTargetIndex - 5 || index > kTargetIndex + 5);
+}
+
+TEST(WsolaInternalsTest, SymmetricHanningWindowOverlapAddsToOne) {
+  const int kWindowLength = 40;
+  float window[kWindowLength];
+  internal::GetSymmetricHanningWindow(kWindowLength, window);
+  for (int n = 0; n < kWindowLength / 2; ++n)
+    EXPECT_NEAR(1.0f, window[n] + window[n + kWindowLength / 2], 1e-6);
+}
+
 }  // namespace media
@@ -373,6 +373,7 @@ bool AudioRendererImpl::HandleSplicerBuffer(
     const scoped_refptr<DataBuffer>& buffer) {
   if (buffer->IsEndOfStream()) {
     received_end_of_stream_ = true;
+    algorithm_->MarkEndOfStream();
 
     // Transition to kPlaying if we are currently handling an underflow since
     // no more data will be arriving.
@@ -17,6 +17,7 @@
 #include "media/base/audio_decoder_config.h"
 #include "media/base/stream_parser_buffer.h"
 #include "media/base/video_decoder_config.h"
+#include "media/filters/source_buffer_memory_manager.h"
 #if defined(GOOGLE_CHROME_BUILD) || defined(USE_PROPRIETARY_CODECS)
 #include "media/mp4/es_descriptor.h"
 #include "media/mp4/mp4_stream_parser.h"
@@ -298,6 +299,7 @@ ChunkDemuxerStream::ChunkDemuxerStream(const AudioDecoderConfig& audio_config,
       state_(RETURNING_DATA_FOR_READS),
       end_of_stream_(false) {
   stream_.reset(new SourceBufferStream(audio_config, log_cb));
+  stream_->SetMemoryManager(SourceBufferMemoryManager::GetInstance());
 }
 
 ChunkDemuxerStream::ChunkDemuxerStream(const VideoDecoderConfig& video_config,
@@ -306,6 +308,7 @@ ChunkDemuxerStream::ChunkDemuxerStream(const VideoDecoderConfig& video_config,
       state_(RETURNING_DATA_FOR_READS),
       end_of_stream_(false) {
   stream_.reset(new SourceBufferStream(video_config, log_cb));
+  stream_->SetMemoryManager(SourceBufferMemoryManager::GetInstance());
 }
 
 void ChunkDemuxerStream::StartWaitingForSeek() {
@@ -5,6 +5,7 @@
 #include "media/filters/ffmpeg_demuxer.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <string>
 
 #include "base/bind.h"
@@ -229,6 +230,33 @@ base::TimeDelta FFmpegDemuxerStream::ConvertStreamTimestamp(
 //
 // FFmpegDemuxer
 //
+
+// Length of the media time over which the bitrate of demuxed packets is
+// measured, and how far the measurement must be from the last reported
+// bitrate before the data source is told about it.
+static const int kBitrateMeasurementSeconds = 2;
+static const double kBitrateChangeThreshold = 0.25;
+
+// Looks up the byte position of the keyframe av_seek_frame() will land on for
+// |time| in the index of the default stream, and hints it to |data_source| so
+// that fetching can start while FFmpeg is still seeking. Must run on the
+// blocking thread since av_read_frame() may add to the index.
+static void PrefetchSeekPosition(AVFormatContext* format_context,
+                                 const scoped_refptr<DataSource>& data_source,
+                                 base::TimeDelta time) {
+  int stream_index = av_find_default_stream_index(format_context);
+  if (stream_index < 0)
+    return;
+
+  AVStream* stream = format_context->streams[stream_index];
+  int index = av_index_search_timestamp(
+      stream, ConvertToTimeBase(stream->time_base, time), AVSEEK_FLAG_BACKWARD);
+  if (index < 0)
+    return;
+
+  data_source->Prefetch(stream->index_entries[index].pos);
+}
+
 FFmpegDemuxer::FFmpegDemuxer(
     const scoped_refptr<base::MessageLoopProxy>& message_loop,
     const scoped_refptr<DataSource>& data_source)
@@ -239,6 +267,8 @@ FFmpegDemuxer::FFmpegDemuxer(
       pending_seek_(false),
       data_source_(data_source),
       bitrate_(0),
+      bitrate_measurement_start_(kNoTimestamp()),
+      bitrate_measurement_bytes_(0),
       start_time_(kNoTimestamp()),
       audio_disabled_(false),
       duration_known_(false),
@@ -268,10 +298,19 @@ void FFmpegDemuxer::Seek(base::TimeDelta time, const PipelineStatusCB& cb) {
   // Always seek to a timestamp less than or equal to the desired timestamp.
   int flags = AVSEEK_FLAG_BACKWARD;
 
+  // Start fetching the data at the seek target using the container index, if
+  // there is one, instead of waiting for FFmpeg's first read after seeking.
+  if (!data_source_->IsStreaming()) {
+    blocking_thread_.message_loop_proxy()->PostTask(FROM_HERE, base::Bind(
+        &PrefetchSeekPosition, glue_->format_context(), data_source_, time));
+  }
+
   // Passing -1 as our stream index lets FFmpeg pick a default stream.  FFmpeg
   // will attempt to use the lowest-index video stream, if present, followed by
   // the lowest-index audio stream.
   pending_seek_ = true;
+  bitrate_measurement_start_ = kNoTimestamp();
+  bitrate_measurement_bytes_ = 0;
   base::PostTaskAndReplyWithResult(
       blocking_thread_.message_loop_proxy(), FROM_HERE,
       base::Bind(&av_seek_frame, glue_->format_context(), -1,
@@ -613,6 +652,13 @@ void FFmpegDemuxer::OnReadFrameDone(ScopedAVPacket packet, int result) {
       packet.swap(new_packet);
     }
 
+    if (packet->pts != static_cast<int64>(AV_NOPTS_VALUE)) {
+      AVStream* stream = glue_->format_context()->streams[packet->stream_index];
+      UpdateMeasuredBitrate(packet->size,
+                            ConvertFromTimeBase(stream->time_base,
+                                                packet->pts));
+    }
+
     FFmpegDemuxerStream* demuxer_stream = streams_[packet->stream_index];
     demuxer_stream->EnqueuePacket(packet.Pass());
   }
@@ -621,6 +667,37 @@ void FFmpegDemuxer::OnReadFrameDone(ScopedAVPacket packet, int result) {
   ReadFrameIfNeeded();
 }
 
+void FFmpegDemuxer::UpdateMeasuredBitrate(int packet_size,
+                                          base::TimeDelta timestamp) {
+  DCHECK(message_loop_->BelongsToCurrentThread());
+  bitrate_measurement_bytes_ += packet_size;
+  if (bitrate_measurement_start_ == kNoTimestamp()) {
+    bitrate_measurement_start_ = timestamp;
+    return;
+  }
+
+  // Packets of different streams are interleaved, so |timestamp| is only
+  // approximately increasing; that is fine over a measurement interval.
+  base::TimeDelta elapsed = timestamp - bitrate_measurement_start_;
+  if (elapsed < base::TimeDelta::FromSeconds(kBitrateMeasurementSeconds))
+    return;
+
+  int measured_bitrate = static_cast<int>(
+      bitrate_measurement_bytes_ * 8 * base::Time::kMicrosecondsPerSecond /
+      elapsed.InMicroseconds());
+  bitrate_measurement_start_ = timestamp;
+  bitrate_measurement_bytes_ = 0;
+
+  if (measured_bitrate <= 0 ||
+      std::abs(measured_bitrate - bitrate_) <=
+          kBitrateChangeThreshold * bitrate_) {
+    return;
+  }
+
+  bitrate_ = measured_bitrate;
+  data_source_->SetBitrate(bitrate_);
+}
+
 void FFmpegDemuxer::OnDataSourceStopped(const base::Closure& callback) {
   // This will block until all tasks complete. Note that after this returns it's
   // possible for reply tasks (e.g., OnReadFrameDone()) to be queued on this
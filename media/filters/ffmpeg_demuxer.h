@@ -162,6 +162,12 @@ class MEDIA_EXPORT FFmpegDemuxer : public Demuxer {
   void ReadFrameIfNeeded();
   void OnReadFrameDone(ScopedAVPacket packet, int result);
 
+  // Accounts |packet_size| bytes of media at |timestamp| towards the measured
+  // bitrate and tells |data_source_| about it once it has drifted away from
+  // |bitrate_|, so that buffering follows the actual rate of variable bitrate
+  // content.
+  void UpdateMeasuredBitrate(int packet_size, base::TimeDelta timestamp);
+
   // DataSource callbacks during stopping.
   void OnDataSourceStopped(const base::Closure& callback);
 
@@ -213,9 +219,15 @@ class MEDIA_EXPORT FFmpegDemuxer : public Demuxer {
   // this object.
   scoped_refptr<DataSource> data_source_;
 
-  // Derived bitrate after initialization has completed.
+  // Derived bitrate after initialization has completed, updated with the
+  // measured bitrate as packets are demuxed.
   int bitrate_;
 
+  // Timestamp of the first packet and number of bytes demuxed in the current
+  // bitrate measurement interval. Reset on every seek.
+  base::TimeDelta bitrate_measurement_start_;
+  int64 bitrate_measurement_bytes_;
+
   // The first timestamp of the opened media file. This is used to set the
   // starting clock value to match the timestamps in the media file. Default
   // is 0.
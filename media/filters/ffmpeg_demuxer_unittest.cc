@@ -5,11 +5,13 @@
 #include <algorithm>
 #include <deque>
 #include <string>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/file_util.h"
 #include "base/files/file_path.h"
 #include "base/path_service.h"
+#include "base/synchronization/lock.h"
 #include "base/threading/thread.h"
 #include "media/base/mock_demuxer_host.h"
 #include "media/base/test_helpers.h"
@@ -53,6 +55,40 @@ static void EosOnReadDone(bool* got_eos_buffer,
   *got_eos_buffer = false;
 };
 
+// A FileDataSource which records the hints FFmpegDemuxer gives it.
+class HintRecordingDataSource : public FileDataSource {
+ public:
+  HintRecordingDataSource() : bitrate_(0) {}
+
+  virtual void Prefetch(int64 position) OVERRIDE {
+    base::AutoLock auto_lock(lock_);
+    prefetch_positions_.push_back(position);
+  }
+
+  virtual void SetBitrate(int bitrate) OVERRIDE {
+    base::AutoLock auto_lock(lock_);
+    bitrate_ = bitrate;
+  }
+
+  std::vector<int64> prefetch_positions() {
+    base::AutoLock auto_lock(lock_);
+    return prefetch_positions_;
+  }
+
+  int bitrate() {
+    base::AutoLock auto_lock(lock_);
+    return bitrate_;
+  }
+
+ private:
+  virtual ~HintRecordingDataSource() {}
+
+  base::Lock lock_;
+  std::vector<int64> prefetch_positions_;
+  int bitrate_;
+
+  DISALLOW_COPY_AND_ASSIGN(HintRecordingDataSource);
+};
 
 // Fixture class to facilitate writing tests.  Takes care of setting up the
 // FFmpeg, pipeline and filter host mocks.
@@ -126,6 +162,10 @@ class FFmpegDemuxerTest : public testing::Test {
     demuxer_->duration_known_ = duration_known;
   }
 
+  void set_bitrate(int bitrate) {
+    demuxer_->bitrate_ = bitrate;
+  }
+
   bool IsStreamStopped(DemuxerStream::Type type) {
     DemuxerStream* stream = demuxer_->GetStream(type);
     CHECK(stream);
@@ -133,7 +173,7 @@ class FFmpegDemuxerTest : public testing::Test {
   }
 
   // Fixture members.
-  scoped_refptr<FileDataSource> data_source_;
+  scoped_refptr<HintRecordingDataSource> data_source_;
   scoped_refptr<FFmpegDemuxer> demuxer_;
   StrictMock<MockDemuxerHost> host_;
   MessageLoop message_loop_;
@@ -169,7 +209,7 @@ class FFmpegDemuxerTest : public testing::Test {
         .Append(FILE_PATH_LITERAL("data"))
         .AppendASCII(name);
 
-    data_source_ = new FileDataSource();
+    data_source_ = new HintRecordingDataSource();
     EXPECT_TRUE(data_source_->Initialize(file_path));
   }
 
@@ -568,6 +608,41 @@ TEST_F(FFmpegDemuxerTest, SeekWithCuesBeforeFirstCluster) {
   message_loop_.Run();
 }
 
+// Verify that seeking hints the data source to start fetching at the keyframe
+// found in the index, before FFmpeg issues any reads for the seek.
+TEST_F(FFmpegDemuxerTest, SeekPrefetchesFromIndex) {
+  CreateDemuxer("bear-320x240-cues-in-front.webm");
+  InitializeDemuxer();
+  EXPECT_TRUE(data_source_->prefetch_positions().empty());
+
+  WaitableMessageLoopEvent event;
+  demuxer_->Seek(base::TimeDelta::FromMicroseconds(2500000),
+                 event.GetPipelineStatusCB());
+  event.RunAndWaitForStatus(PIPELINE_OK);
+
+  std::vector<int64> positions = data_source_->prefetch_positions();
+  ASSERT_EQ(1u, positions.size());
+  int64 file_size = 0;
+  ASSERT_TRUE(data_source_->GetSize(&file_size));
+  EXPECT_GT(positions[0], 0);
+  EXPECT_LT(positions[0], file_size);
+}
+
+// Verify that the bitrate measured from demuxed packets replaces an inaccurate
+// bitrate derived from the container.
+TEST_F(FFmpegDemuxerTest, MeasuredBitrate) {
+  CreateDemuxer("bear-320x240.webm");
+  InitializeDemuxer();
+  int initial_bitrate = data_source_->bitrate();
+  EXPECT_GT(initial_bitrate, 0);
+
+  // Pretend the container claimed a far lower bitrate.
+  set_bitrate(initial_bitrate / 10);
+  ReadUntilEndOfStream();
+
+  EXPECT_GT(data_source_->bitrate(), initial_bitrate / 10);
+}
+
 // Ensure ID3v1 tag reading is disabled.  id3_test.mp3 has an ID3v1 tag with the
 // field "title" set to "sample for id3 test".
 TEST_F(FFmpegDemuxerTest, NoID3TagData) {
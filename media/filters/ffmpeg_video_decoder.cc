@@ -9,58 +9,30 @@
 
 #include "base/bind.h"
 #include "base/callback_helpers.h"
-#include "base/command_line.h"
 #include "base/location.h"
 #include "base/message_loop_proxy.h"
-#include "base/string_number_conversions.h"
 #include "media/base/bind_to_loop.h"
 #include "media/base/decoder_buffer.h"
 #include "media/base/demuxer_stream.h"
 #include "media/base/limits.h"
-#include "media/base/media_switches.h"
 #include "media/base/pipeline.h"
 #include "media/base/video_decoder_config.h"
 #include "media/base/video_frame.h"
 #include "media/base/video_util.h"
 #include "media/ffmpeg/ffmpeg_common.h"
 #include "media/filters/ffmpeg_glue.h"
+#include "media/filters/video_decode_threads.h"
 
 namespace media {
 
-// Always try to use three threads for video decoding.  There is little reason
-// not to since current day CPUs tend to be multi-core and we measured
-// performance benefits on older machines such as P4s with hyperthreading.
-//
-// Handling decoding on separate threads also frees up the pipeline thread to
-// continue processing. Although it'd be nice to have the option of a single
-// decoding thread, FFmpeg treats having one thread the same as having zero
-// threads (i.e., avcodec_decode_video() will execute on the calling thread).
-// Yet another reason for having two threads :)
-static const int kDecodeThreads = 2;
-static const int kMaxDecodeThreads = 16;
-
-// Returns the number of threads given the FFmpeg CodecID. Also inspects the
-// command line for a valid --video-threads flag.
-static int GetThreadCount(CodecID codec_id) {
-  // Refer to http://crbug.com/93932 for tsan suppressions on decoding.
-  int decode_threads = kDecodeThreads;
-
-  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
-  std::string threads(cmd_line->GetSwitchValueASCII(switches::kVideoThreads));
-  if (threads.empty() || !base::StringToInt(threads, &decode_threads))
-    return decode_threads;
-
-  decode_threads = std::max(decode_threads, 0);
-  decode_threads = std::min(decode_threads, kMaxDecodeThreads);
-  return decode_threads;
-}
-
 FFmpegVideoDecoder::FFmpegVideoDecoder(
     const scoped_refptr<base::MessageLoopProxy>& message_loop)
     : message_loop_(message_loop),
       state_(kUninitialized),
       codec_context_(NULL),
-      av_frame_(NULL) {
+      av_frame_(NULL),
+      decode_policy_(MediaScheduler::DECODE_ALL),
+      awaiting_keyframe_(false) {
 }
 
 int FFmpegVideoDecoder::GetVideoBuffer(AVCodecContext* codec_context,
@@ -86,14 +58,14 @@ int FFmpegVideoDecoder::GetVideoBuffer(AVCodecContext* codec_context,
                                   codec_context->sample_aspect_ratio.num,
                                   codec_context->sample_aspect_ratio.den);
   } else {
-    natural_size = demuxer_stream_->video_decoder_config().natural_size();
+    natural_size = config_natural_size_;
   }
 
   if (!VideoFrame::IsValidConfig(format, size, gfx::Rect(size), natural_size))
     return AVERROR(EINVAL);
 
   scoped_refptr<VideoFrame> video_frame =
-      VideoFrame::CreateFrame(format, size, gfx::Rect(size), natural_size,
+      frame_pool_.CreateFrame(format, size, gfx::Rect(size), natural_size,
                               kNoTimestamp());
 
   for (int i = 0; i < 3; i++) {
@@ -364,6 +336,9 @@ bool FFmpegVideoDecoder::Decode(
   // Reset frame to default values.
   avcodec_get_frame_defaults(av_frame_);
 
+  if (scheduler_player_ && !buffer->IsEndOfStream())
+    UpdateDecodePolicy();
+
   // Create a packet for input data.
   // Due to FFmpeg API changes we no longer have const read-only pointers.
   AVPacket packet;
@@ -388,6 +363,13 @@ bool FFmpegVideoDecoder::Decode(
                                      av_frame_,
                                      &frame_decoded,
                                      &packet);
+  // Interframes referring to frames dropped by avcodec_flush_buffers() may
+  // fail to decode until the next keyframe.
+  if (result < 0 && awaiting_keyframe_) {
+    *video_frame = NULL;
+    return true;
+  }
+
   // Log the problem if we can't decode a video frame and exit early.
   if (result < 0) {
     LOG(ERROR) << "Error decoding video: " << buffer->AsHumanReadableString();
@@ -404,6 +386,15 @@ bool FFmpegVideoDecoder::Decode(
     return true;
   }
 
+  // Frames decoded without their references are garbage, drop them.
+  if (awaiting_keyframe_) {
+    if (!av_frame_->key_frame) {
+      *video_frame = NULL;
+      return true;
+    }
+    awaiting_keyframe_ = false;
+  }
+
   // TODO(fbarchard): Work around for FFmpeg http://crbug.com/27675
   // The decoder is in a bad state and not decoding correctly.
   // Checking for NULL avoids a crash in CopyPlane().
@@ -427,6 +418,29 @@ bool FFmpegVideoDecoder::Decode(
   return true;
 }
 
+void FFmpegVideoDecoder::UpdateDecodePolicy() {
+  MediaScheduler::DecodePolicy policy = scheduler_player_->decode_policy();
+  if (policy == decode_policy_)
+    return;
+
+  // Skipped interframes leave the decoder without the references of the ones
+  // to come.  Rather than showing corrupt frames, drop all references and
+  // discard the output until the next keyframe.  This has to happen at the
+  // output: with frame threading, interframes following a keyframe are
+  // already being decoded by the time the keyframe comes out.
+  if (decode_policy_ == MediaScheduler::DECODE_KEYFRAMES_ONLY) {
+    avcodec_flush_buffers(codec_context_);
+    awaiting_keyframe_ = true;
+  }
+
+  decode_policy_ = policy;
+  codec_context_->skip_loop_filter = policy == MediaScheduler::DECODE_ALL ?
+      AVDISCARD_DEFAULT : AVDISCARD_NONKEY;
+  codec_context_->skip_frame =
+      policy == MediaScheduler::DECODE_KEYFRAMES_ONLY ?
+      AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+}
+
 void FFmpegVideoDecoder::ReleaseFFmpegResources() {
   if (codec_context_) {
     av_free(codec_context_->extradata);
@@ -438,6 +452,7 @@ void FFmpegVideoDecoder::ReleaseFFmpegResources() {
     av_free(av_frame_);
     av_frame_ = NULL;
   }
+  decode_threads_.Release();
 }
 
 bool FFmpegVideoDecoder::ConfigureDecoder() {
@@ -456,6 +471,10 @@ bool FFmpegVideoDecoder::ConfigureDecoder() {
   // Release existing decoder resources if necessary.
   ReleaseFFmpegResources();
 
+  // Captured here, while no FFmpeg threads are running, so GetVideoBuffer()
+  // never has to touch |demuxer_stream_| from a frame thread.
+  config_natural_size_ = config.natural_size();
+
   // Initialize AVCodecContext structure.
   codec_context_ = avcodec_alloc_context3(NULL);
   VideoDecoderConfigToAVCodecContext(config, codec_context_);
@@ -463,7 +482,20 @@ bool FFmpegVideoDecoder::ConfigureDecoder() {
   // Enable motion vector search (potentially slow), strong deblocking filter
   // for damaged macroblocks, and set our error detection sensitivity.
   codec_context_->error_concealment = FF_EC_GUESS_MVS | FF_EC_DEBLOCK;
-  codec_context_->thread_count = GetThreadCount(codec_context_->codec_id);
+  if (scheduler_player_) {
+    decode_threads_.set_max_threads(
+        scheduler_player_->max_decode_threads());
+  }
+  codec_context_->thread_count = decode_threads_.Reserve(config.coded_size());
+  // Decode independent frames in parallel where the codec supports it, and
+  // fall back to slice threading otherwise.
+  codec_context_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  // GetVideoBuffer() only reads the AVCodecContext it is handed and
+  // |config_natural_size_|, which does not change while the codec is open,
+  // and allocates from |frame_pool_|, which may be called from any thread.
+  // FFmpeg may therefore call the buffer callbacks from its frame threads
+  // directly instead of serializing them through the decoding thread.
+  codec_context_->thread_safe_callbacks = 1;
   codec_context_->opaque = this;
   codec_context_->flags |= CODEC_FLAG_EMU_EDGE;
   codec_context_->get_buffer = GetVideoBufferImpl;
@@ -476,6 +508,10 @@ bool FFmpegVideoDecoder::ConfigureDecoder() {
   }
 
   av_frame_ = avcodec_alloc_frame();
+
+  // The new codec decodes everything until told otherwise.
+  decode_policy_ = MediaScheduler::DECODE_ALL;
+  awaiting_keyframe_ = false;
   return true;
 }
 
@@ -10,7 +10,11 @@
 #include "base/callback.h"
 #include "base/memory/ref_counted.h"
 #include "media/base/demuxer_stream.h"
+#include "media/base/media_scheduler.h"
 #include "media/base/video_decoder.h"
+#include "media/base/video_frame_pool.h"
+#include "media/filters/video_decode_threads.h"
+#include "ui/gfx/size.h"
 
 struct AVCodecContext;
 struct AVFrame;
@@ -36,6 +40,13 @@ class MEDIA_EXPORT FFmpegVideoDecoder : public VideoDecoder {
   virtual void Reset(const base::Closure& closure) OVERRIDE;
   virtual void Stop(const base::Closure& closure) OVERRIDE;
 
+  // Makes the decoder follow the decode policy and thread cap the scheduler
+  // gives |player|.  Must be called before Initialize().
+  void set_scheduler_player(
+      const scoped_refptr<MediaScheduler::Player>& player) {
+    scheduler_player_ = player;
+  }
+
   // Callback called from within FFmpeg to allocate a buffer based on
   // the dimensions of |codec_context|. See AVCodecContext.get_buffer
   // documentation inside FFmpeg.
@@ -66,6 +77,9 @@ class MEDIA_EXPORT FFmpegVideoDecoder : public VideoDecoder {
   // Returns true if initialization was successful.
   bool ConfigureDecoder();
 
+  // Applies the current decode policy of |scheduler_player_| to the codec.
+  void UpdateDecodePolicy();
+
   // Releases resources associated with |codec_context_| and |av_frame_|
   // and resets them to NULL.
   void ReleaseFFmpegResources();
@@ -91,6 +105,25 @@ class MEDIA_EXPORT FFmpegVideoDecoder : public VideoDecoder {
 
   std::list<scoped_refptr<VideoFrame> > decoded_frames_;
 
+  // Natural size from the config the codec was opened with. Set by
+  // ConfigureDecoder() before any FFmpeg thread starts and read by
+  // GetVideoBuffer() on those threads.
+  gfx::Size config_natural_size_;
+
+  // Recycles the planes of decoded frames once the renderer drops them.
+  VideoFramePool frame_pool_;
+
+  // Decode threads held against the process-wide budget.
+  VideoDecodeThreads decode_threads_;
+
+  // Optional scheduler entry of the player this decoder belongs to, and the
+  // policy last applied to |codec_context_|.
+  scoped_refptr<MediaScheduler::Player> scheduler_player_;
+  MediaScheduler::DecodePolicy decode_policy_;
+
+  // Set when leaving DECODE_KEYFRAMES_ONLY until a keyframe is output.
+  bool awaiting_keyframe_;
+
   DISALLOW_COPY_AND_ASSIGN(FFmpegVideoDecoder);
 };
 
@@ -2,13 +2,18 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <string>
 
 #include "base/bind.h"
 #include "base/callback_helpers.h"
+#include "base/command_line.h"
 #include "base/message_loop.h"
 #include "base/memory/singleton.h"
+#include "base/process_util.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
+#include "base/time.h"
 #include "media/base/decoder_buffer.h"
 #include "media/base/gmock_callback_support.h"
 #include "media/base/limits.h"
@@ -43,6 +48,11 @@ static const gfx::Size kInitCodedSize(100, 100);
 static const gfx::Rect kInitVisibleRect(100, 100);
 static const gfx::Size kInitNaturalSize(100, 100);
 
+// Number of frames decoded by the benchmark. Disabled by default; run with
+// --gtest_also_run_disabled_tests --video-decode-benchmark-frames=N.
+static const char kBenchmarkFrames[] = "video-decode-benchmark-frames";
+static const int kDefaultBenchmarkFrames = 3000;
+
 ACTION_P(ReturnBuffer, buffer) {
   arg0.Run(buffer ? DemuxerStream::kOk : DemuxerStream::kAborted, buffer);
 }
@@ -668,4 +678,71 @@ TEST_F(FFmpegVideoDecoderTest, DemuxerRead_ConfigChangeFailedDuringReset) {
   message_loop_.RunUntilIdle();
 }
 
+// Decodes the same I-frame repeatedly, dropping each output frame before the
+// next read the way the renderer does, and reports decode throughput and how
+// far the process working set moved after the first tenth of the run. With
+// output frames coming from the decoder's VideoFramePool the working set
+// should stay flat once the pool has warmed up.
+TEST_F(FFmpegVideoDecoderTest, DISABLED_DecodeBenchmark) {
+  int frames = 0;
+  if (!base::StringToInt(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          kBenchmarkFrames), &frames) || frames < 1) {
+    frames = kDefaultBenchmarkFrames;
+  }
+  const int warm_up_frames = std::max(1, frames / 10);
+
+  Initialize();
+
+  EXPECT_CALL(*demuxer_, Read(_))
+      .WillRepeatedly(ReturnBuffer(i_frame_buffer_));
+  EXPECT_CALL(statistics_cb_, OnStatistics(_))
+      .Times(AtLeast(1));
+
+  VideoDecoder::Status status = VideoDecoder::kOk;
+  scoped_refptr<VideoFrame> video_frame;
+  EXPECT_CALL(*this, FrameReady(_, _))
+      .WillRepeatedly(DoAll(SaveArg<0>(&status), SaveArg<1>(&video_frame)));
+
+#if defined(OS_MACOSX) && !defined(OS_IOS)
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle(), NULL));
+#else
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+#endif
+
+  size_t warm_rss = 0;
+  size_t peak_rss = 0;
+  base::TimeTicks start;
+  for (int i = 0; i < warm_up_frames + frames; ++i) {
+    if (i == warm_up_frames) {
+      warm_rss = metrics->GetWorkingSetSize();
+      peak_rss = warm_rss;
+      start = base::TimeTicks::HighResNow();
+    }
+
+    video_frame = NULL;
+    decoder_->Read(read_cb_);
+    message_loop_.RunUntilIdle();
+    ASSERT_EQ(VideoDecoder::kOk, status);
+    ASSERT_TRUE(video_frame);
+
+    if (i >= warm_up_frames && i % 100 == 0)
+      peak_rss = std::max(peak_rss, metrics->GetWorkingSetSize());
+  }
+  const double elapsed_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  const size_t final_rss = metrics->GetWorkingSetSize();
+  peak_rss = std::max(peak_rss, final_rss);
+  video_frame = NULL;
+
+  printf("%d frames: %.1f frames/s, RSS %.1f MB after warm-up, "
+         "%.1f MB peak, %.1f MB at end\n",
+         frames, frames * 1000.0 / std::max(elapsed_ms, 0.001),
+         warm_rss / (1024.0 * 1024.0), peak_rss / (1024.0 * 1024.0),
+         final_rss / (1024.0 * 1024.0));
+}
+
 }  // namespace media
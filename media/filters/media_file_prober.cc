@@ -0,0 +1,278 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/filters/media_file_prober.h"
+
+#include <algorithm>
+
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/simple_thread.h"
+#include "media/base/video_frame.h"
+#include "media/base/yuv_convert.h"
+#include "media/ffmpeg/ffmpeg_common.h"
+#include "media/filters/ffmpeg_glue.h"
+#include "media/filters/in_memory_url_protocol.h"
+
+namespace media {
+
+// Packets of the video stream decoded before giving up on a thumbnail.  Bounds
+// the work spent on files whose video never produces a frame.
+static const int kMaxThumbnailPackets = 256;
+
+// Packets of any stream read while looking for a thumbnail.  Bounds the work
+// spent on files whose video has no keyframe, or which interleave it with a
+// great deal of other data.
+static const int kMaxReadPackets = 4096;
+
+MediaFileInfo::MediaFileInfo() : parsed(false) {}
+
+MediaFileInfo::~MediaFileInfo() {}
+
+MediaFileProber::MediaFileProber(FFmpegURLProtocol* protocol)
+    : protocol_(protocol),
+      codec_context_(NULL) {
+}
+
+MediaFileProber::~MediaFileProber() {
+  if (codec_context_)
+    avcodec_close(codec_context_);
+}
+
+bool MediaFileProber::Probe(int thumbnail_size, MediaFileInfo* info) {
+  DCHECK(info);
+  DCHECK(!glue_) << "Probe() may only be called once.";
+  *info = MediaFileInfo();
+
+  glue_.reset(new FFmpegGlue(protocol_));
+  AVFormatContext* format_context = glue_->format_context();
+  if (!glue_->OpenContext())
+    return false;
+
+  if (avformat_find_stream_info(format_context, NULL) < 0) {
+    DLOG(WARNING) << "MediaFileProber : error in avformat_find_stream_info()";
+    return false;
+  }
+
+  info->parsed = true;
+  info->container = format_context->iformat->name;
+  if (format_context->duration != static_cast<int64>(AV_NOPTS_VALUE)) {
+    const AVRational av_time_base = {1, AV_TIME_BASE};
+    info->duration =
+        ConvertFromTimeBase(av_time_base, format_context->duration);
+  }
+
+  AVDictionaryEntry* tag = NULL;
+  while ((tag = av_dict_get(format_context->metadata, "", tag,
+                            AV_DICT_IGNORE_SUFFIX))) {
+    info->tags[tag->key] = tag->value;
+  }
+
+  int video_stream_index = -1;
+  for (size_t i = 0; i < format_context->nb_streams; ++i) {
+    AVCodecContext* codec_context = format_context->streams[i]->codec;
+    AVCodec* codec = avcodec_find_decoder(codec_context->codec_id);
+    if (codec_context->codec_type == AVMEDIA_TYPE_AUDIO &&
+        info->audio_codec.empty()) {
+      if (codec)
+        info->audio_codec = codec->name;
+    } else if (codec_context->codec_type == AVMEDIA_TYPE_VIDEO &&
+               video_stream_index < 0) {
+      video_stream_index = i;
+      if (codec)
+        info->video_codec = codec->name;
+      info->video_size.SetSize(codec_context->width, codec_context->height);
+    }
+  }
+
+  if (thumbnail_size > 0 && video_stream_index >= 0 &&
+      !ExtractThumbnail(video_stream_index, thumbnail_size, info)) {
+    DVLOG(1) << "MediaFileProber : no thumbnail for " << info->container
+             << " file with " << info->video_codec << " video";
+  }
+  return true;
+}
+
+bool MediaFileProber::ExtractThumbnail(int stream_index, int thumbnail_size,
+                                       MediaFileInfo* info) {
+  AVFormatContext* format_context = glue_->format_context();
+  AVCodecContext* codec_context = format_context->streams[stream_index]->codec;
+  AVCodec* codec = avcodec_find_decoder(codec_context->codec_id);
+  if (!codec)
+    return false;
+
+  // Files are probed in parallel, so keep each decoder on a single thread.
+  codec_context->thread_count = 1;
+  if (avcodec_open2(codec_context, codec, NULL) < 0)
+    return false;
+  codec_context_ = codec_context;
+
+  scoped_ptr_malloc<AVFrame, ScopedPtrAVFree> av_frame(avcodec_alloc_frame());
+  AVPacket packet;
+  bool seen_keyframe = false;
+  int packets = 0;
+  int read_packets = 0;
+  while (packets < kMaxThumbnailPackets &&
+         read_packets++ < kMaxReadPackets &&
+         av_read_frame(format_context, &packet) >= 0) {
+    if (packet.stream_index != stream_index ||
+        (!seen_keyframe && !(packet.flags & AV_PKT_FLAG_KEY))) {
+      av_free_packet(&packet);
+      continue;
+    }
+    seen_keyframe = true;
+    ++packets;
+
+    avcodec_get_frame_defaults(av_frame.get());
+    int frame_decoded = 0;
+    int result = avcodec_decode_video2(
+        codec_context, av_frame.get(), &frame_decoded, &packet);
+    av_free_packet(&packet);
+    if (result < 0)
+      return false;
+    if (frame_decoded)
+      return ConvertFrame(av_frame.get(), thumbnail_size, info);
+  }
+
+  // Drain frames held back by decoders with a delay.
+  if (!seen_keyframe)
+    return false;
+  av_init_packet(&packet);
+  packet.data = NULL;
+  packet.size = 0;
+  avcodec_get_frame_defaults(av_frame.get());
+  int frame_decoded = 0;
+  if (avcodec_decode_video2(
+          codec_context, av_frame.get(), &frame_decoded, &packet) < 0 ||
+      !frame_decoded) {
+    return false;
+  }
+  return ConvertFrame(av_frame.get(), thumbnail_size, info);
+}
+
+bool MediaFileProber::ConvertFrame(const AVFrame* frame, int thumbnail_size,
+                                   MediaFileInfo* info) {
+  VideoFrame::Format format =
+      PixelFormatToVideoFormat(codec_context_->pix_fmt);
+  if (format != VideoFrame::YV12 && format != VideoFrame::YV16)
+    return false;
+
+  int width = codec_context_->width;
+  int height = codec_context_->height;
+  if (width <= 0 || height <= 0 ||
+      !frame->data[VideoFrame::kYPlane] ||
+      !frame->data[VideoFrame::kUPlane] ||
+      !frame->data[VideoFrame::kVPlane]) {
+    return false;
+  }
+
+  // Fit the thumbnail in a |thumbnail_size| square keeping the aspect ratio;
+  // frames smaller than that are not scaled up.
+  int thumbnail_width = width;
+  int thumbnail_height = height;
+  if (std::max(width, height) > thumbnail_size) {
+    if (width >= height) {
+      thumbnail_width = thumbnail_size;
+      thumbnail_height = std::max(1, height * thumbnail_size / width);
+    } else {
+      thumbnail_height = thumbnail_size;
+      thumbnail_width = std::max(1, width * thumbnail_size / height);
+    }
+  }
+
+  info->thumbnail_size.SetSize(thumbnail_width, thumbnail_height);
+  info->thumbnail.resize(thumbnail_width * thumbnail_height * 4);
+  ScaleYUVToRGB32(frame->data[VideoFrame::kYPlane],
+                  frame->data[VideoFrame::kUPlane],
+                  frame->data[VideoFrame::kVPlane],
+                  &info->thumbnail[0],
+                  width,
+                  height,
+                  thumbnail_width,
+                  thumbnail_height,
+                  frame->linesize[VideoFrame::kYPlane],
+                  frame->linesize[VideoFrame::kUPlane],
+                  thumbnail_width * 4,
+                  format == VideoFrame::YV12 ? YV12 : YV16,
+                  ROTATE_0,
+                  FILTER_BILINEAR);
+  EmptyRegisterState();
+  return true;
+}
+
+namespace {
+
+// Runs on each thread of the pool and probes files until none are left.
+class ProbeWorker : public base::DelegateSimpleThread::Delegate {
+ public:
+  ProbeWorker(const std::vector<base::FilePath>& paths, int thumbnail_size,
+              std::vector<MediaFileInfo>* infos)
+      : paths_(paths),
+        thumbnail_size_(thumbnail_size),
+        infos_(infos),
+        next_index_(0) {
+  }
+  virtual ~ProbeWorker() {}
+
+  virtual void Run() OVERRIDE {
+    size_t index;
+    while (NextIndex(&index))
+      ProbeFile(paths_[index], &(*infos_)[index]);
+  }
+
+ private:
+  bool NextIndex(size_t* index) {
+    base::AutoLock auto_lock(lock_);
+    if (next_index_ >= paths_.size())
+      return false;
+    *index = next_index_++;
+    return true;
+  }
+
+  void ProbeFile(const base::FilePath& path, MediaFileInfo* info) {
+    // Map the file instead of reading it so only the pages FFmpeg touches
+    // are brought in; the mapping is released before the next file.
+    base::MemoryMappedFile file;
+    if (!file.Initialize(path))
+      return;
+    InMemoryUrlProtocol protocol(file.data(), file.length(), false);
+    MediaFileProber prober(&protocol);
+    prober.Probe(thumbnail_size_, info);
+  }
+
+  const std::vector<base::FilePath>& paths_;
+  const int thumbnail_size_;
+  std::vector<MediaFileInfo>* infos_;
+
+  base::Lock lock_;
+  size_t next_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProbeWorker);
+};
+
+}  // namespace
+
+void ProbeMediaFiles(const std::vector<base::FilePath>& paths,
+                     int thumbnail_size,
+                     int num_threads,
+                     std::vector<MediaFileInfo>* infos) {
+  DCHECK(infos);
+  infos->clear();
+  infos->resize(paths.size());
+
+  ProbeWorker worker(paths, thumbnail_size, infos);
+  num_threads = std::min(num_threads, static_cast<int>(paths.size()));
+  if (num_threads <= 1) {
+    worker.Run();
+    return;
+  }
+
+  base::DelegateSimpleThreadPool pool("MediaFileProber", num_threads);
+  pool.AddWork(&worker, num_threads);
+  pool.Start();
+  pool.JoinAll();
+}
+
+}  // namespace media
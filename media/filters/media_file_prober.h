@@ -0,0 +1,99 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// MediaFileProber extracts the metadata of a media file and a thumbnail of its
+// first video keyframe without setting up a pipeline.  ProbeMediaFiles() runs
+// probers over a batch of files on a pool of threads.  Since it parses
+// untrusted files with FFmpeg it is meant to run in a sandboxed process which
+// initialized the media library before its sandbox was engaged.
+
+#ifndef MEDIA_FILTERS_MEDIA_FILE_PROBER_H_
+#define MEDIA_FILTERS_MEDIA_FILE_PROBER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time.h"
+#include "media/base/media_export.h"
+#include "ui/gfx/size.h"
+
+struct AVCodecContext;
+struct AVFrame;
+
+namespace media {
+
+class FFmpegGlue;
+class FFmpegURLProtocol;
+
+struct MEDIA_EXPORT MediaFileInfo {
+  MediaFileInfo();
+  ~MediaFileInfo();
+
+  // True if the container could be parsed.  The other fields are only valid
+  // if it is set.
+  bool parsed;
+
+  // FFmpeg's short name of the container format, e.g. "matroska,webm".
+  std::string container;
+  base::TimeDelta duration;
+
+  // FFmpeg's name of the decoder for the first audio and video stream, empty
+  // if there is no such stream or no decoder for it.
+  std::string audio_codec;
+  std::string video_codec;
+  gfx::Size video_size;
+
+  // Container level tags such as "title" or "artist".
+  std::map<std::string, std::string> tags;
+
+  // Thumbnail of the first video keyframe as 32 bit ARGB pixels, empty if the
+  // file has no decodable video.
+  gfx::Size thumbnail_size;
+  std::vector<uint8> thumbnail;
+};
+
+class MEDIA_EXPORT MediaFileProber {
+ public:
+  // |protocol| must outlive the prober.
+  explicit MediaFileProber(FFmpegURLProtocol* protocol);
+  ~MediaFileProber();
+
+  // Fills |info| with the metadata of the file.  If |thumbnail_size| is
+  // positive the first video keyframe is decoded and scaled to fit in a square
+  // of that many pixels.  Returns false if the container could not be parsed;
+  // a file whose video fails to decode still succeeds without a thumbnail.
+  bool Probe(int thumbnail_size, MediaFileInfo* info);
+
+ private:
+  // Decodes the first keyframe of stream |stream_index| into |info|.
+  bool ExtractThumbnail(int stream_index, int thumbnail_size,
+                        MediaFileInfo* info);
+
+  // Scales the decoded |frame| into the thumbnail of |info|.
+  bool ConvertFrame(const AVFrame* frame, int thumbnail_size,
+                    MediaFileInfo* info);
+
+  FFmpegURLProtocol* protocol_;
+  scoped_ptr<FFmpegGlue> glue_;
+  AVCodecContext* codec_context_;
+
+  DISALLOW_COPY_AND_ASSIGN(MediaFileProber);
+};
+
+// Probes each of |paths| on up to |num_threads| threads and stores the result
+// for paths[i] in (*infos)[i].  Each thread maps one file at a time and holds
+// at most one decoded frame, so memory use is bounded by the number of threads
+// rather than by the size of the batch.  Blocks until all files are probed.
+MEDIA_EXPORT void ProbeMediaFiles(const std::vector<base::FilePath>& paths,
+                                  int thumbnail_size,
+                                  int num_threads,
+                                  std::vector<MediaFileInfo>* infos);
+
+}  // namespace media
+
+#endif  // MEDIA_FILTERS_MEDIA_FILE_PROBER_H_
@@ -0,0 +1,156 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/sys_info.h"
+#include "base/time.h"
+#include "media/base/decoder_buffer.h"
+#include "media/base/test_data_util.h"
+#include "media/filters/in_memory_url_protocol.h"
+#include "media/filters/media_file_prober.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const int kThumbnailSize = 64;
+
+// Number of copies of each test file probed by the benchmark. Disabled by
+// default; run with
+// --gtest_also_run_disabled_tests --media-file-prober-copies=N.
+static const char kBenchmarkCopies[] = "media-file-prober-copies";
+static const int kDefaultCopies = 20;
+
+class MediaFileProberTest : public testing::Test {
+ public:
+  MediaFileProberTest() {}
+  virtual ~MediaFileProberTest() {}
+
+  bool Probe(const char* filename, MediaFileInfo* info) {
+    data_ = ReadTestDataFile(filename);
+    protocol_.reset(new InMemoryUrlProtocol(
+        data_->GetData(), data_->GetDataSize(), false));
+    prober_.reset(new MediaFileProber(protocol_.get()));
+    return prober_->Probe(kThumbnailSize, info);
+  }
+
+ protected:
+  scoped_refptr<DecoderBuffer> data_;
+  scoped_ptr<InMemoryUrlProtocol> protocol_;
+  scoped_ptr<MediaFileProber> prober_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MediaFileProberTest);
+};
+
+TEST_F(MediaFileProberTest, InvalidFile) {
+  MediaFileInfo info;
+  EXPECT_FALSE(Probe("ten_byte_file", &info));
+  EXPECT_FALSE(info.parsed);
+}
+
+TEST_F(MediaFileProberTest, AudioAndVideo) {
+  MediaFileInfo info;
+  ASSERT_TRUE(Probe("bear-320x240.webm", &info));
+  EXPECT_TRUE(info.parsed);
+  EXPECT_EQ("matroska,webm", info.container);
+  EXPECT_EQ(2744, info.duration.InMilliseconds());
+  EXPECT_EQ("vorbis", info.audio_codec);
+  EXPECT_EQ("vp8", info.video_codec);
+  EXPECT_EQ(gfx::Size(320, 240), info.video_size);
+
+  // The thumbnail keeps the 4:3 aspect ratio.
+  EXPECT_EQ(gfx::Size(kThumbnailSize, kThumbnailSize * 3 / 4),
+            info.thumbnail_size);
+  EXPECT_EQ(static_cast<size_t>(info.thumbnail_size.GetArea() * 4),
+            info.thumbnail.size());
+}
+
+TEST_F(MediaFileProberTest, AudioOnly) {
+  MediaFileInfo info;
+  ASSERT_TRUE(Probe("sfx.ogg", &info));
+  EXPECT_EQ("ogg", info.container);
+  EXPECT_EQ("vorbis", info.audio_codec);
+  EXPECT_TRUE(info.video_codec.empty());
+  EXPECT_TRUE(info.thumbnail.empty());
+}
+
+TEST_F(MediaFileProberTest, NoThumbnailRequested) {
+  data_ = ReadTestDataFile("bear-320x240.webm");
+  protocol_.reset(new InMemoryUrlProtocol(
+      data_->GetData(), data_->GetDataSize(), false));
+  prober_.reset(new MediaFileProber(protocol_.get()));
+
+  MediaFileInfo info;
+  ASSERT_TRUE(prober_->Probe(0, &info));
+  EXPECT_EQ("vp8", info.video_codec);
+  EXPECT_TRUE(info.thumbnail.empty());
+}
+
+// Results must be stored in the order of the paths whatever the number of
+// threads, and missing files must not stop the batch.
+TEST(ProbeMediaFilesTest, Batch) {
+  std::vector<base::FilePath> paths;
+  paths.push_back(GetTestDataFilePath("bear-320x240.webm"));
+  paths.push_back(GetTestDataFilePath("does_not_exist.webm"));
+  paths.push_back(GetTestDataFilePath("sfx.ogg"));
+  paths.push_back(GetTestDataFilePath("ten_byte_file"));
+
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    SCOPED_TRACE(threads);
+    std::vector<MediaFileInfo> infos;
+    ProbeMediaFiles(paths, kThumbnailSize, threads, &infos);
+    ASSERT_EQ(paths.size(), infos.size());
+    EXPECT_EQ("vp8", infos[0].video_codec);
+    EXPECT_FALSE(infos[0].thumbnail.empty());
+    EXPECT_FALSE(infos[1].parsed);
+    EXPECT_EQ("vorbis", infos[2].audio_codec);
+    EXPECT_FALSE(infos[3].parsed);
+  }
+}
+
+// Benchmark for ProbeMediaFiles() over a corpus of copies of the test files,
+// reporting files per second with one thread and with one per processor.
+TEST(ProbeMediaFilesTest, DISABLED_Benchmark) {
+  int copies = 0;
+  if (!base::StringToInt(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          kBenchmarkCopies), &copies) || copies < 1) {
+    copies = kDefaultCopies;
+  }
+
+  static const char* kFiles[] = {
+    "bear-320x240.webm", "bear.ogv", "sfx.mp3", "sfx.ogg", "sfx_s16le.wav",
+  };
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  std::vector<base::FilePath> paths;
+  for (int i = 0; i < copies; ++i) {
+    for (size_t j = 0; j < arraysize(kFiles); ++j) {
+      base::FilePath path = temp_dir.path().AppendASCII(
+          base::StringPrintf("%d_%s", i, kFiles[j]));
+      ASSERT_TRUE(file_util::CopyFile(GetTestDataFilePath(kFiles[j]), path));
+      paths.push_back(path);
+    }
+  }
+
+  int max_threads = base::SysInfo::NumberOfProcessors();
+  printf("Benchmarking %d files:\n", static_cast<int>(paths.size()));
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<MediaFileInfo> infos;
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    ProbeMediaFiles(paths, kThumbnailSize, threads, &infos);
+    double seconds = (base::TimeTicks::HighResNow() - start).InSecondsF();
+    printf("%d thread(s): %.1f files/sec.\n", threads, paths.size() / seconds);
+
+    for (size_t i = 0; i < infos.size(); ++i)
+      EXPECT_TRUE(infos[i].parsed) << paths[i].value();
+  }
+}
+
+}  // namespace media
@@ -4,7 +4,10 @@
 
 #include "media/filters/skcanvas_video_renderer.h"
 
+#include <algorithm>
+
 #include "base/logging.h"
+#include "base/sys_info.h"
 #include "media/base/video_frame.h"
 #include "media/base/yuv_convert.h"
 #include "third_party/skia/include/core/SkCanvas.h"
@@ -21,6 +24,13 @@ static bool IsEitherYV12OrYV16OrNative(media::VideoFrame::Format format) {
       format == media::VideoFrame::NATIVE_TEXTURE;
 }
 
+// Returns the number of threads used to convert frames to RGB. Conversion is
+// memory bound, so more than a few threads do not help.
+static int GetConversionThreadCount() {
+  static const int kMaxConversionThreads = 4;
+  return std::min(base::SysInfo::NumberOfProcessors(), kMaxConversionThreads);
+}
+
 // CanFastPaint is a helper method to determine the conditions for fast
 // painting. The conditions are:
 // 1. No skew in canvas matrix.
@@ -147,20 +157,22 @@ static void FastPaint(
   // TODO(hclam): do rotation and mirroring here.
   // TODO(fbarchard): switch filtering based on performance.
   bitmap.lockPixels();
-  media::ScaleYUVToRGB32(frame_clip_y,
-                         frame_clip_u,
-                         frame_clip_v,
-                         dest_rect_pointer,
-                         frame_clip_width,
-                         frame_clip_height,
-                         local_dest_irect.width(),
-                         local_dest_irect.height(),
-                         video_frame->stride(media::VideoFrame::kYPlane),
-                         video_frame->stride(media::VideoFrame::kUPlane),
-                         bitmap.rowBytes(),
-                         yuv_type,
-                         media::ROTATE_0,
-                         media::FILTER_BILINEAR);
+  media::ScaleYUVToRGB32Threaded(
+      frame_clip_y,
+      frame_clip_u,
+      frame_clip_v,
+      dest_rect_pointer,
+      frame_clip_width,
+      frame_clip_height,
+      local_dest_irect.width(),
+      local_dest_irect.height(),
+      video_frame->stride(media::VideoFrame::kYPlane),
+      video_frame->stride(media::VideoFrame::kUPlane),
+      bitmap.rowBytes(),
+      yuv_type,
+      media::ROTATE_0,
+      media::FILTER_BILINEAR,
+      GetConversionThreadCount());
   bitmap.unlockPixels();
 }
 
@@ -215,16 +227,18 @@ static void ConvertVideoFrameToBitmap(
     uint8* frame_clip_v =
         video_frame->data(media::VideoFrame::kVPlane) + uv_offset;
 
-    media::ConvertYUVToRGB32(frame_clip_y,
-                             frame_clip_u,
-                             frame_clip_v,
-                             static_cast<uint8*>(bitmap->getPixels()),
-                             video_frame->visible_rect().width(),
-                             video_frame->visible_rect().height(),
-                             video_frame->stride(media::VideoFrame::kYPlane),
-                             video_frame->stride(media::VideoFrame::kUPlane),
-                             bitmap->rowBytes(),
-                             yuv_type);
+    media::ConvertYUVToRGB32Threaded(
+        frame_clip_y,
+        frame_clip_u,
+        frame_clip_v,
+        static_cast<uint8*>(bitmap->getPixels()),
+        video_frame->visible_rect().width(),
+        video_frame->visible_rect().height(),
+        video_frame->stride(media::VideoFrame::kYPlane),
+        video_frame->stride(media::VideoFrame::kUPlane),
+        bitmap->rowBytes(),
+        yuv_type,
+        GetConversionThreadCount());
   } else {
     DCHECK_EQ(video_frame->format(), media::VideoFrame::NATIVE_TEXTURE);
     video_frame->ReadPixelsFromNativeTexture(bitmap->getPixels());
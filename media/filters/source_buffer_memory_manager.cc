@@ -0,0 +1,141 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/filters/source_buffer_memory_manager.h"
+
+#include <algorithm>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/sys_info.h"
+
+namespace media {
+
+// The process-wide budget is an eighth of physical memory, but never less
+// than what a single audio/video player may keep on its own (see the default
+// limits in source_buffer_stream.cc) and never more than 512MB.
+static const int64 kMinGlobalBudget = (12 + 150) * 1024 * 1024;
+static const int64 kMaxGlobalBudget = 512 * 1024 * 1024;
+
+namespace {
+
+class GlobalMemoryManager : public SourceBufferMemoryManager {
+ public:
+  GlobalMemoryManager() : SourceBufferMemoryManager(GetDefaultBudget()) {}
+
+ private:
+  static int GetDefaultBudget() {
+    int64 budget = base::SysInfo::AmountOfPhysicalMemory() / 8;
+    budget = std::max(budget, kMinGlobalBudget);
+    budget = std::min(budget, kMaxGlobalBudget);
+    return static_cast<int>(budget);
+  }
+};
+
+base::LazyInstance<GlobalMemoryManager>::Leaky g_memory_manager =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+SourceBufferMemoryManager::SourceBufferMemoryManager(int budget_in_bytes)
+    : budget_in_bytes_(budget_in_bytes),
+      total_buffered_bytes_(0),
+      total_played_bytes_(0),
+      under_pressure_(false) {
+  DCHECK_GT(budget_in_bytes_, 0);
+}
+
+SourceBufferMemoryManager::~SourceBufferMemoryManager() {
+  DCHECK(streams_.empty());
+}
+
+// static
+SourceBufferMemoryManager* SourceBufferMemoryManager::GetInstance() {
+  return g_memory_manager.Pointer();
+}
+
+void SourceBufferMemoryManager::AddStream(const SourceBufferStream* stream) {
+  base::AutoLock auto_lock(lock_);
+  DCHECK(streams_.find(stream) == streams_.end());
+  streams_[stream] = StreamUsage();
+}
+
+void SourceBufferMemoryManager::RemoveStream(const SourceBufferStream* stream) {
+  base::AutoLock auto_lock(lock_);
+  StreamMap::iterator it = streams_.find(stream);
+  DCHECK(it != streams_.end());
+  total_buffered_bytes_ -= it->second.buffered_bytes;
+  total_played_bytes_ -= it->second.played_bytes;
+  streams_.erase(it);
+}
+
+void SourceBufferMemoryManager::UpdateStream(const SourceBufferStream* stream,
+                                             int buffered_bytes,
+                                             int played_bytes) {
+  DCHECK_GE(buffered_bytes, played_bytes);
+  DCHECK_GE(played_bytes, 0);
+
+  base::AutoLock auto_lock(lock_);
+  StreamMap::iterator it = streams_.find(stream);
+  DCHECK(it != streams_.end());
+  total_buffered_bytes_ += buffered_bytes - it->second.buffered_bytes;
+  total_played_bytes_ += played_bytes - it->second.played_bytes;
+  it->second.buffered_bytes = buffered_bytes;
+  it->second.played_bytes = played_bytes;
+}
+
+int SourceBufferMemoryManager::GetStreamLimit(
+    const SourceBufferStream* stream) const {
+  base::AutoLock auto_lock(lock_);
+  StreamMap::const_iterator it = streams_.find(stream);
+  DCHECK(it != streams_.end());
+
+  const int64 budget = GetBudget_Locked();
+  if (total_buffered_bytes_ <= budget)
+    return kint32max;
+
+  const StreamUsage& usage = it->second;
+  const int64 unplayed_bytes = usage.buffered_bytes - usage.played_bytes;
+  const int64 total_unplayed_bytes =
+      total_buffered_bytes_ - total_played_bytes_;
+
+  int64 limit = 0;
+  if (total_unplayed_bytes >= budget) {
+    // Not even the unplayed data fits: drop all played data and split the
+    // budget according to how much unplayed data each stream holds.
+    limit = budget * unplayed_bytes / total_unplayed_bytes;
+  } else {
+    // Every stream keeps its unplayed data. Whatever is left of the budget is
+    // split according to how much played data each stream holds.
+    limit = unplayed_bytes;
+    if (total_played_bytes_ > 0) {
+      limit += (budget - total_unplayed_bytes) * usage.played_bytes /
+          total_played_bytes_;
+    }
+  }
+
+  return static_cast<int>(std::min<int64>(limit, kint32max));
+}
+
+void SourceBufferMemoryManager::SetMemoryPressure(bool under_pressure) {
+  base::AutoLock auto_lock(lock_);
+  under_pressure_ = under_pressure;
+}
+
+int SourceBufferMemoryManager::GetBudget() const {
+  base::AutoLock auto_lock(lock_);
+  return GetBudget_Locked();
+}
+
+int SourceBufferMemoryManager::GetTotalBufferedBytes() const {
+  base::AutoLock auto_lock(lock_);
+  return static_cast<int>(total_buffered_bytes_);
+}
+
+int SourceBufferMemoryManager::GetBudget_Locked() const {
+  lock_.AssertAcquired();
+  return under_pressure_ ? budget_in_bytes_ / 2 : budget_in_bytes_;
+}
+
+}  // namespace media
@@ -0,0 +1,90 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_FILTERS_SOURCE_BUFFER_MEMORY_MANAGER_H_
+#define MEDIA_FILTERS_SOURCE_BUFFER_MEMORY_MANAGER_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+class SourceBufferStream;
+
+// Enforces a single memory budget across every SourceBufferStream in the
+// process, so that a page with many Media Source players does not hold many
+// times the per-stream limit.
+//
+// Streams report how many bytes they hold, and how many of those bytes lie
+// before their current playback position, each time they append. When the
+// total exceeds the budget, already played data is given up first: every
+// stream keeps its unplayed data, and whatever is left of the budget is split
+// in proportion to how much played data each stream holds. Only if the
+// unplayed data alone does not fit is the budget split in proportion to each
+// stream's unplayed data. Each stream frees its excess on its own thread the
+// next time it garbage collects, starting with the data furthest from its
+// playback position.
+//
+// All methods are thread safe.
+class MEDIA_EXPORT SourceBufferMemoryManager {
+ public:
+  explicit SourceBufferMemoryManager(int budget_in_bytes);
+  ~SourceBufferMemoryManager();
+
+  // Returns the manager shared by all ChunkDemuxers in the process. Its budget
+  // scales with the amount of physical memory.
+  static SourceBufferMemoryManager* GetInstance();
+
+  // Adds or removes |stream| from the set of streams sharing the budget.
+  void AddStream(const SourceBufferStream* stream);
+  void RemoveStream(const SourceBufferStream* stream);
+
+  // Records that |stream| currently holds |buffered_bytes|, |played_bytes| of
+  // which lie before its playback position.
+  void UpdateStream(const SourceBufferStream* stream,
+                    int buffered_bytes,
+                    int played_bytes);
+
+  // Returns the number of bytes |stream| may keep given the usage most
+  // recently reported by all streams.
+  int GetStreamLimit(const SourceBufferStream* stream) const;
+
+  // Halves the effective budget while |under_pressure| is true. Streams shrink
+  // to the reduced budget as they next append.
+  void SetMemoryPressure(bool under_pressure);
+
+  // Returns the current budget, taking memory pressure into account.
+  int GetBudget() const;
+
+  // Returns the total number of bytes reported by all streams.
+  int GetTotalBufferedBytes() const;
+
+ private:
+  struct StreamUsage {
+    StreamUsage() : buffered_bytes(0), played_bytes(0) {}
+
+    int buffered_bytes;
+    int played_bytes;
+  };
+  typedef std::map<const SourceBufferStream*, StreamUsage> StreamMap;
+
+  int GetBudget_Locked() const;
+
+  const int budget_in_bytes_;
+
+  mutable base::Lock lock_;
+  StreamMap streams_;
+  int64 total_buffered_bytes_;
+  int64 total_played_bytes_;
+  bool under_pressure_;
+
+  DISALLOW_COPY_AND_ASSIGN(SourceBufferMemoryManager);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_FILTERS_SOURCE_BUFFER_MEMORY_MANAGER_H_
@@ -0,0 +1,236 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/filters/source_buffer_memory_manager.h"
+
+#include <algorithm>
+
+#include "base/memory/scoped_vector.h"
+#include "media/base/stream_parser_buffer.h"
+#include "media/base/video_decoder_config.h"
+#include "media/filters/source_buffer_stream.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const int kFramesPerSecond = 30;
+static const int kKeyframeInterval = 5;
+static const int kBufferSize = 1000;
+static const gfx::Size kCodedSize(320, 240);
+
+class SourceBufferMemoryManagerTest : public testing::Test {
+ protected:
+  // A simulated Media Source player: appends frames ahead of its playback
+  // position and then consumes them.
+  struct Player {
+    explicit Player(SourceBufferStream* stream)
+        : stream(stream),
+          frames_appended(0),
+          frames_played(0),
+          rebuffers(0) {
+    }
+
+    scoped_ptr<SourceBufferStream> stream;
+    int frames_appended;
+    int frames_played;
+    int rebuffers;
+  };
+
+  SourceBufferMemoryManagerTest() : peak_bytes_(0) {
+    config_.Initialize(kCodecVP8, VIDEO_CODEC_PROFILE_UNKNOWN,
+                       VideoFrame::YV12, kCodedSize, gfx::Rect(kCodedSize),
+                       kCodedSize, NULL, 0, false, false);
+    data_.reset(new uint8[kBufferSize]);
+    memset(data_.get(), 0, kBufferSize);
+  }
+
+  SourceBufferStream* CreateStream() {
+    return new SourceBufferStream(config_, LogCB());
+  }
+
+  void CreatePlayers(SourceBufferMemoryManager* manager, int count) {
+    for (int i = 0; i < count; ++i) {
+      Player* player = new Player(CreateStream());
+      player->stream->SetMemoryManager(manager);
+      player->stream->Seek(base::TimeDelta());
+      players_.push_back(player);
+    }
+  }
+
+  void DestroyPlayers() {
+    players_.clear();
+  }
+
+  // Appends |count| frames after the last frame appended to |player|.
+  void AppendFrames(SourceBufferMemoryManager* manager, Player* player,
+                    int count) {
+    const base::TimeDelta frame_duration =
+        base::TimeDelta::FromMicroseconds(
+            base::Time::kMicrosecondsPerSecond / kFramesPerSecond);
+    if (player->frames_appended == 0)
+      player->stream->OnNewMediaSegment(base::TimeDelta());
+
+    SourceBufferStream::BufferQueue queue;
+    for (int i = 0; i < count; ++i) {
+      int position = player->frames_appended + i;
+      scoped_refptr<StreamParserBuffer> buffer = StreamParserBuffer::CopyFrom(
+          data_.get(), kBufferSize, position % kKeyframeInterval == 0);
+      buffer->SetDecodeTimestamp(frame_duration * position);
+      buffer->SetTimestamp(frame_duration * position);
+      queue.push_back(buffer);
+    }
+    EXPECT_TRUE(player->stream->Append(queue));
+    player->frames_appended += count;
+    peak_bytes_ = std::max(peak_bytes_, manager->GetTotalBufferedBytes());
+  }
+
+  // Plays up to |count| frames, counting a rebuffer for every frame that had
+  // been appended but was no longer available.
+  void PlayFrames(Player* player, int count) {
+    for (int i = 0; i < count; ++i) {
+      if (player->frames_played >= player->frames_appended)
+        return;
+
+      scoped_refptr<StreamParserBuffer> buffer;
+      if (player->stream->GetNextBuffer(&buffer) !=
+          SourceBufferStream::kSuccess) {
+        ++player->rebuffers;
+        return;
+      }
+      ++player->frames_played;
+    }
+  }
+
+  // Runs |rounds| rounds in which every player appends |frames_per_round|
+  // frames and then plays the same number.
+  void RunPlayers(SourceBufferMemoryManager* manager, int rounds,
+                  int frames_per_round) {
+    for (int round = 0; round < rounds; ++round) {
+      for (size_t i = 0; i < players_.size(); ++i)
+        AppendFrames(manager, players_[i], frames_per_round);
+      for (size_t i = 0; i < players_.size(); ++i)
+        PlayFrames(players_[i], frames_per_round);
+    }
+  }
+
+  int TotalRebuffers() const {
+    int rebuffers = 0;
+    for (size_t i = 0; i < players_.size(); ++i)
+      rebuffers += players_[i]->rebuffers;
+    return rebuffers;
+  }
+
+  VideoDecoderConfig config_;
+  scoped_ptr<uint8[]> data_;
+  ScopedVector<Player> players_;
+  int peak_bytes_;
+};
+
+TEST_F(SourceBufferMemoryManagerTest, UnderBudget) {
+  SourceBufferMemoryManager manager(1000);
+  scoped_ptr<SourceBufferStream> stream(CreateStream());
+  manager.AddStream(stream.get());
+
+  manager.UpdateStream(stream.get(), 1000, 500);
+  EXPECT_EQ(1000, manager.GetTotalBufferedBytes());
+  EXPECT_EQ(kint32max, manager.GetStreamLimit(stream.get()));
+
+  manager.RemoveStream(stream.get());
+  EXPECT_EQ(0, manager.GetTotalBufferedBytes());
+}
+
+TEST_F(SourceBufferMemoryManagerTest, EvictsPlayedDataFirst) {
+  SourceBufferMemoryManager manager(1000);
+  scoped_ptr<SourceBufferStream> stream_a(CreateStream());
+  scoped_ptr<SourceBufferStream> stream_b(CreateStream());
+  manager.AddStream(stream_a.get());
+  manager.AddStream(stream_b.get());
+
+  // 400 bytes over budget, all of which can come from |stream_a|'s played
+  // data. |stream_b| has not played anything and keeps everything.
+  manager.UpdateStream(stream_a.get(), 800, 600);
+  manager.UpdateStream(stream_b.get(), 600, 0);
+  EXPECT_EQ(400, manager.GetStreamLimit(stream_a.get()));
+  EXPECT_EQ(600, manager.GetStreamLimit(stream_b.get()));
+
+  manager.RemoveStream(stream_a.get());
+  manager.RemoveStream(stream_b.get());
+}
+
+TEST_F(SourceBufferMemoryManagerTest, SplitsBudgetByUnplayedData) {
+  SourceBufferMemoryManager manager(1000);
+  scoped_ptr<SourceBufferStream> stream_a(CreateStream());
+  scoped_ptr<SourceBufferStream> stream_b(CreateStream());
+  manager.AddStream(stream_a.get());
+  manager.AddStream(stream_b.get());
+
+  // The 1300 unplayed bytes alone exceed the budget, so all played data goes
+  // and the budget is split 700:600.
+  manager.UpdateStream(stream_a.get(), 800, 100);
+  manager.UpdateStream(stream_b.get(), 600, 0);
+  EXPECT_EQ(1000 * 700 / 1300, manager.GetStreamLimit(stream_a.get()));
+  EXPECT_EQ(1000 * 600 / 1300, manager.GetStreamLimit(stream_b.get()));
+
+  manager.RemoveStream(stream_a.get());
+  manager.RemoveStream(stream_b.get());
+}
+
+TEST_F(SourceBufferMemoryManagerTest, MemoryPressureHalvesBudget) {
+  SourceBufferMemoryManager manager(1000);
+  scoped_ptr<SourceBufferStream> stream(CreateStream());
+  manager.AddStream(stream.get());
+  manager.UpdateStream(stream.get(), 800, 0);
+  EXPECT_EQ(kint32max, manager.GetStreamLimit(stream.get()));
+
+  manager.SetMemoryPressure(true);
+  EXPECT_EQ(500, manager.GetBudget());
+  EXPECT_EQ(500, manager.GetStreamLimit(stream.get()));
+
+  manager.SetMemoryPressure(false);
+  EXPECT_EQ(1000, manager.GetBudget());
+  EXPECT_EQ(kint32max, manager.GetStreamLimit(stream.get()));
+
+  manager.RemoveStream(stream.get());
+}
+
+// Simulates many players appending and playing at the same time and checks
+// that peak memory stays near the shared budget without starving any player.
+TEST_F(SourceBufferMemoryManagerTest, ManyPlayersStayWithinBudget) {
+  const int kPlayers = 16;
+  const int kFramesPerRound = 2 * kKeyframeInterval;
+  const int kBudget = kPlayers * 10 * kFramesPerRound * kBufferSize;
+  SourceBufferMemoryManager manager(kBudget);
+  CreatePlayers(&manager, kPlayers);
+
+  RunPlayers(&manager, 100, kFramesPerRound);
+
+  // Without the manager every player would hold all 1000 frames it appended.
+  // Streams only shrink when they next append, so allow one round of appends
+  // on top of the budget.
+  EXPECT_LE(peak_bytes_, kBudget + kPlayers * kFramesPerRound * kBufferSize);
+  EXPECT_EQ(0, TotalRebuffers());
+
+  DestroyPlayers();
+  EXPECT_EQ(0, manager.GetTotalBufferedBytes());
+}
+
+TEST_F(SourceBufferMemoryManagerTest, ManyPlayersUnderMemoryPressure) {
+  const int kPlayers = 16;
+  const int kFramesPerRound = 2 * kKeyframeInterval;
+  const int kBudget = kPlayers * 10 * kFramesPerRound * kBufferSize;
+  SourceBufferMemoryManager manager(kBudget);
+  CreatePlayers(&manager, kPlayers);
+
+  RunPlayers(&manager, 50, kFramesPerRound);
+  manager.SetMemoryPressure(true);
+  RunPlayers(&manager, 2, kFramesPerRound);
+
+  EXPECT_LE(manager.GetTotalBufferedBytes(),
+            kBudget / 2 + kPlayers * kFramesPerRound * kBufferSize);
+  EXPECT_EQ(0, TotalRebuffers());
+
+  DestroyPlayers();
+}
+
+}  // namespace media
@@ -11,6 +11,7 @@
 #include "base/debug/trace_event.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
+#include "media/filters/source_buffer_memory_manager.h"
 namespace media {
 // Helper class representing a range of buffered data. All buffers in a
 // SourceBufferRange are ordered sequentially in presentation order with no
@@ -163,6 +164,10 @@ class SourceBufferRange {
 
   int size_in_bytes() const { return size_in_bytes_; }
 
+  // Returns the size in bytes of the buffers before the next buffer position,
+  // or 0 if there is no next buffer position.
+  int GetSizeInBytesBeforeNextBufferPosition() const;
+
  private:
   typedef std::map<base::TimeDelta, int> KeyframeMap;
 
@@ -303,6 +308,7 @@ SourceBufferStream::SourceBufferStream(const AudioDecoderConfig& audio_config,
       last_output_buffer_timestamp_(kNoTimestamp()),
       max_interbuffer_distance_(kNoTimestamp()),
       memory_limit_(kDefaultAudioMemoryLimit),
+      memory_manager_(NULL),
       config_change_pending_(false) {
   DCHECK(audio_config.IsValidConfig());
   audio_configs_.push_back(new AudioDecoderConfig());
@@ -324,6 +330,7 @@ SourceBufferStream::SourceBufferStream(const VideoDecoderConfig& video_config,
       last_output_buffer_timestamp_(kNoTimestamp()),
       max_interbuffer_distance_(kNoTimestamp()),
       memory_limit_(kDefaultVideoMemoryLimit),
+      memory_manager_(NULL),
       config_change_pending_(false) {
   DCHECK(video_config.IsValidConfig());
   video_configs_.push_back(new VideoDecoderConfig());
@@ -331,6 +338,8 @@ SourceBufferStream::SourceBufferStream(const VideoDecoderConfig& video_config,
 }
 
 SourceBufferStream::~SourceBufferStream() {
+  SetMemoryManager(NULL);
+
   while (!ranges_.empty()) {
     delete ranges_.front();
     ranges_.pop_front();
@@ -528,24 +537,62 @@ void SourceBufferStream::SetConfigIds(const BufferQueue& buffers) {
   }
 }
 
+void SourceBufferStream::SetMemoryManager(
+    SourceBufferMemoryManager* memory_manager) {
+  if (memory_manager_)
+    memory_manager_->RemoveStream(this);
+  memory_manager_ = memory_manager;
+  if (memory_manager_)
+    memory_manager_->AddStream(this);
+}
+
 void SourceBufferStream::GarbageCollectIfNeeded() {
   // Compute size of |ranges_|.
   int ranges_size = 0;
   for (RangeList::iterator itr = ranges_.begin(); itr != ranges_.end(); ++itr)
     ranges_size += (*itr)->size_in_bytes();
 
+  int memory_limit = memory_limit_;
+  if (memory_manager_) {
+    memory_manager_->UpdateStream(this, ranges_size, GetPlayedBytes());
+    memory_limit =
+        std::min(memory_limit, memory_manager_->GetStreamLimit(this));
+  }
+
   // Return if we're under or at the memory limit.
-  if (ranges_size <= memory_limit_)
+  if (ranges_size <= memory_limit)
     return;
 
-  int bytes_to_free = ranges_size - memory_limit_;
+  int bytes_to_free = ranges_size - memory_limit;
 
-  // Begin deleting from the front.
+  // Begin deleting from the front, which holds already played data and data
+  // furthest behind the playback position.
   int bytes_freed = FreeBuffers(bytes_to_free, false);
 
-  // Begin deleting from the back.
+  // Begin deleting from the back, which holds the data furthest ahead of the
+  // playback position.
   if (bytes_to_free - bytes_freed > 0)
-    FreeBuffers(bytes_to_free - bytes_freed, true);
+    bytes_freed += FreeBuffers(bytes_to_free - bytes_freed, true);
+
+  if (memory_manager_) {
+    memory_manager_->UpdateStream(this, ranges_size - bytes_freed,
+                                  GetPlayedBytes());
+  }
+}
+
+int SourceBufferStream::GetPlayedBytes() const {
+  if (!selected_range_)
+    return 0;
+
+  int played_bytes = 0;
+  for (RangeList::const_iterator itr = ranges_.begin();
+       itr != ranges_.end(); ++itr) {
+    if (*itr == selected_range_)
+      return played_bytes + (*itr)->GetSizeInBytesBeforeNextBufferPosition();
+    played_bytes += (*itr)->size_in_bytes();
+  }
+  NOTREACHED();
+  return 0;
 }
 
 int SourceBufferStream::FreeBuffers(int total_bytes_to_free,
@@ -1578,6 +1625,18 @@ bool SourceBufferRange::HasNextBufferPosition() const {
   return next_buffer_index_ >= 0;
 }
 
+int SourceBufferRange::GetSizeInBytesBeforeNextBufferPosition() const {
+  if (!HasNextBufferPosition())
+    return 0;
+
+  int size = 0;
+  int end_index =
+      std::min(next_buffer_index_, static_cast<int>(buffers_.size()));
+  for (int i = 0; i < end_index; ++i)
+    size += buffers_[i]->GetDataSize();
+  return size;
+}
+
 void SourceBufferRange::ResetNextBufferPosition() {
   next_buffer_index_ = -1;
 }
@@ -25,6 +25,7 @@
 
 namespace media {
 
+class SourceBufferMemoryManager;
 class SourceBufferRange;
 
 // See file-level comment for complete description.
@@ -106,6 +107,12 @@ class MEDIA_EXPORT SourceBufferStream {
   // yet.
   base::TimeDelta GetMaxInterbufferDistance() const;
 
+  // Shares |memory_manager|'s process-wide budget with the other streams
+  // registered with it, in addition to this stream's own memory limit.
+  // |memory_manager| must outlive this object. Passing NULL detaches the
+  // stream.
+  void SetMemoryManager(SourceBufferMemoryManager* memory_manager);
+
  private:
   friend class SourceBufferStreamTest;
   typedef std::list<SourceBufferRange*> RangeList;
@@ -115,6 +122,10 @@ class MEDIA_EXPORT SourceBufferStream {
   // Frees up space if the SourceBufferStream is taking up too much memory.
   void GarbageCollectIfNeeded();
 
+  // Returns the number of bytes in |ranges_| that lie before the next buffer
+  // position, i.e. data that has already been played.
+  int GetPlayedBytes() const;
+
   // Attempts to delete approximately |total_bytes_to_free| amount of data
   // |ranges_|, starting at the front of |ranges_| and moving linearly forward
   // through the buffers. Deletes starting from the back if |reverse_direction|
@@ -309,6 +320,10 @@ class MEDIA_EXPORT SourceBufferStream {
   // The maximum amount of data in bytes the stream will keep in memory.
   int memory_limit_;
 
+  // Shared budget across all streams in the process, or NULL if this stream is
+  // only bound by |memory_limit_|.
+  SourceBufferMemoryManager* memory_manager_;
+
   // Indicates that a kConfigChanged status has been reported by GetNextBuffer()
   // and GetCurrentXXXDecoderConfig() must be called to update the current
   // config. GetNextBuffer() must not be called again until
@@ -0,0 +1,145 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/filters/video_decode_threads.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/command_line.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
+#include "media/base/media_switches.h"
+#include "ui/gfx/size.h"
+
+namespace media {
+
+// Try to use at least two threads for video decoding wherever there are two
+// cores to run them on. We measured performance benefits even on older
+// machines such as P4s with hyperthreading. On a single core machine one
+// thread is used, which FFmpeg and libvpx treat as decoding on the calling
+// thread; extra threads could only add context switches there.
+static const int kMinDecodeThreads = 2;
+static const int kMaxDecodeThreads = 16;
+
+// Area thresholds, in pixels, above which a stream asks for more threads.
+// Both libvpx and FFmpeg split work across tiles/slices/rows, so there is
+// little to be gained from more threads on small frames.
+static const int kSDArea = 640 * 480;
+static const int kHDArea = 1280 * 720;
+static const int kFullHDArea = 1920 * 1088;
+
+namespace {
+
+// Process-wide count of decode threads handed out by VideoDecodeThreads.
+class ThreadBudget {
+ public:
+  ThreadBudget()
+      : total_(std::max(base::SysInfo::NumberOfProcessors(), 1)),
+        reserved_(0) {
+  }
+
+  // Grants up to |desired| threads but never fewer than |minimum|.
+  int Reserve(int desired, int minimum) {
+    base::AutoLock auto_lock(lock_);
+    int granted = std::min(desired, std::max(total_ - reserved_, 0));
+    granted = std::max(granted, minimum);
+    reserved_ += granted;
+    return granted;
+  }
+
+  void Release(int threads) {
+    base::AutoLock auto_lock(lock_);
+    reserved_ -= threads;
+    DCHECK_GE(reserved_, 0);
+  }
+
+  int reserved() {
+    base::AutoLock auto_lock(lock_);
+    return reserved_;
+  }
+
+ private:
+  const int total_;
+  int reserved_;
+  base::Lock lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadBudget);
+};
+
+base::LazyInstance<ThreadBudget>::Leaky g_thread_budget =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Returns true and sets |threads| if a valid --video-threads flag is present.
+bool GetThreadCountFromCommandLine(int* threads) {
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  std::string value(cmd_line->GetSwitchValueASCII(switches::kVideoThreads));
+  if (value.empty() || !base::StringToInt(value, threads))
+    return false;
+
+  *threads = std::max(*threads, 0);
+  *threads = std::min(*threads, kMaxDecodeThreads);
+  return true;
+}
+
+}  // namespace
+
+VideoDecodeThreads::VideoDecodeThreads() : reserved_(0), max_threads_(0) {}
+
+VideoDecodeThreads::~VideoDecodeThreads() {
+  Release();
+}
+
+int VideoDecodeThreads::Reserve(const gfx::Size& coded_size) {
+  Release();
+
+  // Refer to http://crbug.com/93932 for tsan suppressions on decoding.
+  int threads = 0;
+  if (GetThreadCountFromCommandLine(&threads))
+    return threads;
+
+  const int num_cores = base::SysInfo::NumberOfProcessors();
+  int desired = GetDesiredThreadCount(coded_size, num_cores);
+  if (max_threads_ > 0)
+    desired = std::min(desired, max_threads_);
+  reserved_ = g_thread_budget.Get().Reserve(
+      desired, std::min(desired, std::min(num_cores, kMinDecodeThreads)));
+  return reserved_;
+}
+
+void VideoDecodeThreads::Release() {
+  if (!reserved_)
+    return;
+  g_thread_budget.Get().Release(reserved_);
+  reserved_ = 0;
+}
+
+// static
+int VideoDecodeThreads::GetDesiredThreadCount(const gfx::Size& coded_size,
+                                              int num_cores) {
+  const int area = coded_size.GetArea();
+  int threads;
+  if (area <= kSDArea)
+    threads = kMinDecodeThreads;
+  else if (area <= kHDArea)
+    threads = 4;
+  else if (area <= kFullHDArea)
+    threads = 6;
+  else
+    threads = 8;
+
+  threads = std::min(threads, num_cores);
+  threads = std::min(threads, kMaxDecodeThreads);
+  return std::max(threads, 1);
+}
+
+// static
+int VideoDecodeThreads::GetReservedThreadsForTesting() {
+  return g_thread_budget.Get().reserved();
+}
+
+}  // namespace media
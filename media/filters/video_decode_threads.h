@@ -0,0 +1,61 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_FILTERS_VIDEO_DECODE_THREADS_H_
+#define MEDIA_FILTERS_VIDEO_DECODE_THREADS_H_
+
+#include "base/basictypes.h"
+#include "media/base/media_export.h"
+
+namespace gfx {
+class Size;
+}
+
+namespace media {
+
+// Picks the number of threads a software video decoder should use and
+// accounts for them against a process-wide budget shared by all players.
+// The number of threads requested scales with the coded resolution and the
+// number of cores; once the budget is exhausted additional decoders fall back
+// to the historical default of two threads (one on single core machines) so
+// that many concurrent players do not oversubscribe the CPU.  A decoder may
+// also be capped below that, see set_max_threads().
+//
+// Each decoder owns one VideoDecodeThreads and calls Reserve() whenever it
+// (re)configures its codec. Threads are returned to the budget on Release()
+// or destruction.
+class MEDIA_EXPORT VideoDecodeThreads {
+ public:
+  VideoDecodeThreads();
+  ~VideoDecodeThreads();
+
+  // Releases any threads previously held and returns the number of decode
+  // threads to use for a stream of |coded_size|. A valid --video-threads
+  // switch overrides the computed value and bypasses the budget.
+  int Reserve(const gfx::Size& coded_size);
+
+  // Returns any held threads to the process-wide budget.
+  void Release();
+
+  // Limits the threads requested by later calls to Reserve() to
+  // |max_threads|, e.g. as told by MediaScheduler.  Zero removes the limit.
+  void set_max_threads(int max_threads) { max_threads_ = max_threads; }
+
+  // Returns the number of threads a stream of |coded_size| would like to use
+  // on a machine with |num_cores| cores, ignoring the shared budget.
+  static int GetDesiredThreadCount(const gfx::Size& coded_size, int num_cores);
+
+  // Returns the number of threads currently held by all decoders.
+  static int GetReservedThreadsForTesting();
+
+ private:
+  int reserved_;
+  int max_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(VideoDecodeThreads);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_FILTERS_VIDEO_DECODE_THREADS_H_
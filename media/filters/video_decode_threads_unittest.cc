@@ -0,0 +1,90 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+
+#include "base/sys_info.h"
+#include "media/filters/video_decode_threads.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "ui/gfx/size.h"
+
+namespace media {
+
+TEST(VideoDecodeThreadsTest, DesiredThreadCountScalesWithResolution) {
+  const int kManyCores = 32;
+  EXPECT_EQ(2, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(320, 240), kManyCores));
+  EXPECT_EQ(2, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(640, 480), kManyCores));
+  EXPECT_EQ(4, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(1280, 720), kManyCores));
+  EXPECT_EQ(6, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(1920, 1080), kManyCores));
+  EXPECT_EQ(8, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(3840, 2160), kManyCores));
+}
+
+TEST(VideoDecodeThreadsTest, DesiredThreadCountLimitedByCores) {
+  EXPECT_EQ(4, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(3840, 2160), 4));
+
+  // Single core machines decode on one thread.
+  EXPECT_EQ(1, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(3840, 2160), 1));
+  EXPECT_EQ(1, VideoDecodeThreads::GetDesiredThreadCount(
+      gfx::Size(320, 240), 1));
+}
+
+TEST(VideoDecodeThreadsTest, ReserveAndRelease) {
+  const int initial = VideoDecodeThreads::GetReservedThreadsForTesting();
+  const gfx::Size kSize(1920, 1080);
+  const int kMinThreads = std::min(2, base::SysInfo::NumberOfProcessors());
+
+  VideoDecodeThreads first;
+  int first_threads = first.Reserve(kSize);
+  EXPECT_GE(first_threads, kMinThreads);
+  EXPECT_LE(first_threads, VideoDecodeThreads::GetDesiredThreadCount(
+      kSize, base::SysInfo::NumberOfProcessors()));
+  EXPECT_EQ(initial + first_threads,
+            VideoDecodeThreads::GetReservedThreadsForTesting());
+
+  {
+    // A second player always gets at least the minimum, even if the budget
+    // has been used up by the first.
+    VideoDecodeThreads second;
+    int second_threads = second.Reserve(kSize);
+    EXPECT_GE(second_threads, kMinThreads);
+    EXPECT_EQ(initial + first_threads + second_threads,
+              VideoDecodeThreads::GetReservedThreadsForTesting());
+  }
+
+  // Destroying the second returns its threads.
+  EXPECT_EQ(initial + first_threads,
+            VideoDecodeThreads::GetReservedThreadsForTesting());
+
+  // Reserving again replaces the previous reservation rather than adding to
+  // it.
+  first_threads = first.Reserve(gfx::Size(320, 240));
+  EXPECT_EQ(kMinThreads, first_threads);
+  EXPECT_EQ(initial + first_threads,
+            VideoDecodeThreads::GetReservedThreadsForTesting());
+
+  first.Release();
+  EXPECT_EQ(initial, VideoDecodeThreads::GetReservedThreadsForTesting());
+}
+
+// A cap from the scheduler may go below the usual minimum.
+TEST(VideoDecodeThreadsTest, MaxThreads) {
+  const int initial = VideoDecodeThreads::GetReservedThreadsForTesting();
+  VideoDecodeThreads threads;
+  threads.set_max_threads(1);
+  EXPECT_EQ(1, threads.Reserve(gfx::Size(1920, 1080)));
+  EXPECT_EQ(initial + 1, VideoDecodeThreads::GetReservedThreadsForTesting());
+
+  threads.set_max_threads(0);
+  EXPECT_GE(threads.Reserve(gfx::Size(1920, 1080)),
+            std::min(2, base::SysInfo::NumberOfProcessors()));
+}
+
+}  // namespace media
@@ -6,19 +6,17 @@
 
 #include "base/bind.h"
 #include "base/callback_helpers.h"
-#include "base/command_line.h"
 #include "base/location.h"
 #include "base/logging.h"
 #include "base/message_loop_proxy.h"
-#include "base/string_number_conversions.h"
 #include "media/base/bind_to_loop.h"
 #include "media/base/decoder_buffer.h"
 #include "media/base/demuxer_stream.h"
-#include "media/base/media_switches.h"
 #include "media/base/pipeline.h"
 #include "media/base/video_decoder_config.h"
 #include "media/base/video_frame.h"
 #include "media/base/video_util.h"
+#include "media/filters/video_decode_threads.h"
 
 // Include libvpx header files.
 // VPX_CODEC_DISABLE_COMPAT excludes parts of the libvpx API that provide
@@ -31,30 +29,6 @@ extern "C" {
 
 namespace media {
 
-// Always try to use three threads for video decoding.  There is little reason
-// not to since current day CPUs tend to be multi-core and we measured
-// performance benefits on older machines such as P4s with hyperthreading.
-static const int kDecodeThreads = 2;
-static const int kMaxDecodeThreads = 16;
-
-// Returns the number of threads.
-static int GetThreadCount() {
-  // TODO(scherkus): De-duplicate this function and the one used by
-  // FFmpegVideoDecoder.
-
-  // Refer to http://crbug.com/93932 for tsan suppressions on decoding.
-  int decode_threads = kDecodeThreads;
-
-  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
-  std::string threads(cmd_line->GetSwitchValueASCII(switches::kVideoThreads));
-  if (threads.empty() || !base::StringToInt(threads, &decode_threads))
-    return decode_threads;
-
-  decode_threads = std::max(decode_threads, 0);
-  decode_threads = std::min(decode_threads, kMaxDecodeThreads);
-  return decode_threads;
-}
-
 VpxVideoDecoder::VpxVideoDecoder(
     const scoped_refptr<base::MessageLoopProxy>& message_loop)
     : message_loop_(message_loop),
@@ -109,7 +83,7 @@ bool VpxVideoDecoder::ConfigureDecoder() {
   vpx_codec_dec_cfg_t vpx_config = {0};
   vpx_config.w = config.coded_size().width();
   vpx_config.h = config.coded_size().height();
-  vpx_config.threads = GetThreadCount();
+  vpx_config.threads = decode_threads_.Reserve(config.coded_size());
 
   vpx_codec_err_t status = vpx_codec_dec_init(vpx_codec_,
                                               vpx_codec_vp9_dx(),
@@ -119,6 +93,7 @@ bool VpxVideoDecoder::ConfigureDecoder() {
     LOG(ERROR) << "vpx_codec_dec_init failed, status=" << status;
     delete vpx_codec_;
     vpx_codec_ = NULL;
+    decode_threads_.Release();
     return false;
   }
 
@@ -131,6 +106,7 @@ void VpxVideoDecoder::CloseDecoder() {
     delete vpx_codec_;
     vpx_codec_ = NULL;
   }
+  decode_threads_.Release();
 }
 
 void VpxVideoDecoder::Read(const ReadCB& read_cb) {
@@ -319,7 +295,7 @@ void VpxVideoDecoder::CopyVpxImageTo(
   gfx::Size natural_size =
       demuxer_stream_->video_decoder_config().natural_size();
 
-  *video_frame = VideoFrame::CreateFrame(VideoFrame::YV12,
+  *video_frame = frame_pool_.CreateFrame(VideoFrame::YV12,
                                          size,
                                          gfx::Rect(size),
                                          natural_size,
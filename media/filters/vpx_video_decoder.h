@@ -9,6 +9,8 @@
 #include "base/memory/ref_counted.h"
 #include "media/base/demuxer_stream.h"
 #include "media/base/video_decoder.h"
+#include "media/base/video_frame_pool.h"
+#include "media/filters/video_decode_threads.h"
 
 struct vpx_codec_ctx;
 struct vpx_image;
@@ -78,6 +80,12 @@ class MEDIA_EXPORT VpxVideoDecoder : public VideoDecoder {
 
   vpx_codec_ctx* vpx_codec_;
 
+  // Recycles the planes of decoded frames once the renderer drops them.
+  VideoFramePool frame_pool_;
+
+  // Decode threads held against the process-wide budget.
+  VideoDecodeThreads decode_threads_;
+
   DISALLOW_COPY_AND_ASSIGN(VpxVideoDecoder);
 };
 
@@ -0,0 +1,192 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// MSVC++ requires this to be set before any other includes to get M_PI.
+#define _USE_MATH_DEFINES
+
+#include "media/filters/wsola_internals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "media/base/audio_bus.h"
+#include "media/base/vector_math.h"
+
+namespace media {
+
+namespace internal {
+
+// Lower bound of the product of two energies in the similarity measure, so
+// that silent blocks do not divide by zero.
+static const float kMinEnergyProduct = 1e-12f;
+
+static bool InInterval(int n, Interval q) {
+  return n >= q.first && n <= q.second;
+}
+
+void MultiChannelDotProduct(const AudioBus* a,
+                            int frame_offset_a,
+                            const AudioBus* b,
+                            int frame_offset_b,
+                            int num_frames,
+                            float* dot_product) {
+  DCHECK_EQ(a->channels(), b->channels());
+  DCHECK_GE(frame_offset_a, 0);
+  DCHECK_GE(frame_offset_b, 0);
+  DCHECK_LE(frame_offset_a + num_frames, a->frames());
+  DCHECK_LE(frame_offset_b + num_frames, b->frames());
+
+  for (int k = 0; k < a->channels(); ++k) {
+    dot_product[k] = vector_math::DotProduct(
+        a->channel(k) + frame_offset_a, b->channel(k) + frame_offset_b,
+        num_frames);
+  }
+}
+
+void MultiChannelMovingBlockEnergies(const AudioBus* input,
+                                     int frames_per_block,
+                                     float* energy) {
+  const int num_blocks = input->frames() - (frames_per_block - 1);
+  const int channels = input->channels();
+  DCHECK_GT(num_blocks, 0);
+
+  for (int k = 0; k < channels; ++k) {
+    const float* input_channel = input->channel(k);
+
+    energy[k] = vector_math::DotProduct(input_channel, input_channel,
+                                        frames_per_block);
+
+    // Slide the block one frame at a time, removing the frame which drops out
+    // and adding the one which comes in.
+    for (int m = 1; m < num_blocks; ++m) {
+      const float outgoing = input_channel[m - 1];
+      const float incoming = input_channel[m + frames_per_block - 1];
+      energy[k + m * channels] = std::max(0.0f,
+          energy[k + (m - 1) * channels] - outgoing * outgoing +
+          incoming * incoming);
+    }
+  }
+}
+
+float MultiChannelSimilarityMeasure(const AudioBus* target_block,
+                                    const float* energy_target_block,
+                                    const AudioBus* search_segment,
+                                    const float* energy_candidate_blocks,
+                                    int index) {
+  const int channels = target_block->channels();
+  const int frames = target_block->frames();
+  const float* energy_candidate_block =
+      energy_candidate_blocks + index * channels;
+
+  float similarity_measure = 0.0f;
+  for (int k = 0; k < channels; ++k) {
+    const float dot_product = vector_math::DotProduct(
+        target_block->channel(k), search_segment->channel(k) + index, frames);
+    similarity_measure += dot_product / sqrt(std::max(
+        energy_target_block[k] * energy_candidate_block[k],
+        kMinEnergyProduct));
+  }
+  return similarity_measure;
+}
+
+int DecimatedSearch(int decimation,
+                    Interval exclude_interval,
+                    const AudioBus* target_block,
+                    const AudioBus* search_segment,
+                    const float* energy_target_block,
+                    const float* energy_candidate_blocks) {
+  const int num_candidate_blocks =
+      search_segment->frames() - (target_block->frames() - 1);
+
+  int optimal_index = -1;
+  float best_similarity = -std::numeric_limits<float>::max();
+  for (int n = 0; n < num_candidate_blocks; n += decimation) {
+    if (InInterval(n, exclude_interval))
+      continue;
+
+    const float similarity = MultiChannelSimilarityMeasure(
+        target_block, energy_target_block, search_segment,
+        energy_candidate_blocks, n);
+    if (similarity > best_similarity) {
+      best_similarity = similarity;
+      optimal_index = n;
+    }
+  }
+
+  // Every decimated candidate was excluded; fall back to the first one
+  // outside of |exclude_interval|.
+  if (optimal_index < 0) {
+    optimal_index = exclude_interval.first > 0 ? 0 :
+        std::min(exclude_interval.second + 1, num_candidate_blocks - 1);
+  }
+  return optimal_index;
+}
+
+int FullSearch(int low_limit,
+               int high_limit,
+               Interval exclude_interval,
+               const AudioBus* target_block,
+               const AudioBus* search_segment,
+               const float* energy_target_block,
+               const float* energy_candidate_blocks) {
+  int optimal_index = low_limit;
+  float best_similarity = -std::numeric_limits<float>::max();
+  for (int n = low_limit; n <= high_limit; ++n) {
+    if (InInterval(n, exclude_interval))
+      continue;
+
+    const float similarity = MultiChannelSimilarityMeasure(
+        target_block, energy_target_block, search_segment,
+        energy_candidate_blocks, n);
+    if (similarity > best_similarity) {
+      best_similarity = similarity;
+      optimal_index = n;
+    }
+  }
+  return optimal_index;
+}
+
+int OptimalIndex(const AudioBus* search_block,
+                 const AudioBus* target_block,
+                 Interval exclude_interval) {
+  const int channels = search_block->channels();
+  DCHECK_EQ(channels, target_block->channels());
+  const int target_size = target_block->frames();
+  const int num_candidate_blocks = search_block->frames() - (target_size - 1);
+
+  scoped_array<float> energy_candidate_blocks(
+      new float[channels * num_candidate_blocks]);
+  MultiChannelMovingBlockEnergies(search_block, target_size,
+                                  energy_candidate_blocks.get());
+
+  scoped_array<float> energy_target_block(new float[channels]);
+  MultiChannelDotProduct(target_block, 0, target_block, 0, target_size,
+                         energy_target_block.get());
+
+  // Find the neighbourhood of the best match cheaply, then search it fully.
+  const int decimated_index = DecimatedSearch(
+      kSearchDecimation, exclude_interval, target_block, search_block,
+      energy_target_block.get(), energy_candidate_blocks.get());
+
+  const int low_limit = std::max(0, decimated_index - kSearchDecimation + 1);
+  const int high_limit = std::min(num_candidate_blocks - 1,
+                                  decimated_index + kSearchDecimation - 1);
+  return FullSearch(low_limit, high_limit, exclude_interval, target_block,
+                    search_block, energy_target_block.get(),
+                    energy_candidate_blocks.get());
+}
+
+void GetSymmetricHanningWindow(int window_length, float* window) {
+  DCHECK_EQ(window_length % 2, 0);
+  const float scale = 2.0f * M_PI / window_length;
+  for (int n = 0; n < window_length; ++n)
+    window[n] = 0.5f * (1.0f - cosf((n + 1) * scale));
+}
+
+}  // namespace internal
+
+}  // namespace media
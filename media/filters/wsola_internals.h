@@ -0,0 +1,97 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A set of utility functions to perform WSOLA (waveform similarity based
+// overlap-add) for AudioRendererAlgorithm.  They are exposed here for testing.
+
+#ifndef MEDIA_FILTERS_WSOLA_INTERNALS_H_
+#define MEDIA_FILTERS_WSOLA_INTERNALS_H_
+
+#include <utility>
+
+#include "media/base/media_export.h"
+
+namespace media {
+
+class AudioBus;
+
+namespace internal {
+
+// Number of frames by which the coarse search of OptimalIndex() steps through
+// the candidate blocks before refining around the best match.
+enum { kSearchDecimation = 5 };
+
+// A closed interval of candidate block indices.
+typedef std::pair<int, int> Interval;
+
+// Computes, for every channel, the dot product of |num_frames| frames of |a|
+// starting at |frame_offset_a| with |num_frames| frames of |b| starting at
+// |frame_offset_b|.  |a| and |b| must have the same number of channels and
+// |dot_product| must have room for one value per channel.
+MEDIA_EXPORT void MultiChannelDotProduct(const AudioBus* a,
+                                         int frame_offset_a,
+                                         const AudioBus* b,
+                                         int frame_offset_b,
+                                         int num_frames,
+                                         float* dot_product);
+
+// Computes the energy of every channel of every block of |frames_per_block|
+// frames in |input|; i.e. of the blocks starting at frame 0, 1, ... up to
+// |input->frames() - frames_per_block|.  The energy of channel |c| of the
+// block starting at frame |k| is stored at |energy[k * channels + c]|.
+MEDIA_EXPORT void MultiChannelMovingBlockEnergies(const AudioBus* input,
+                                                  int frames_per_block,
+                                                  float* energy);
+
+// Returns the normalized cross-correlation of |target_block| with the block
+// of |search_segment| starting at frame |index|, summed over all channels.
+// |energy_target_block| and |energy_candidate_blocks| are the energies
+// computed by MultiChannelDotProduct() and MultiChannelMovingBlockEnergies().
+MEDIA_EXPORT float MultiChannelSimilarityMeasure(
+    const AudioBus* target_block,
+    const float* energy_target_block,
+    const AudioBus* search_segment,
+    const float* energy_candidate_blocks,
+    int index);
+
+// Searches every |decimation|-th block of |search_segment| and returns the
+// index of the one most similar to |target_block|.  Candidates inside
+// |exclude_interval| are skipped.
+MEDIA_EXPORT int DecimatedSearch(int decimation,
+                                 Interval exclude_interval,
+                                 const AudioBus* target_block,
+                                 const AudioBus* search_segment,
+                                 const float* energy_target_block,
+                                 const float* energy_candidate_blocks);
+
+// Searches every block of |search_segment| starting between |low_limit| and
+// |high_limit|, inclusive, and returns the index of the one most similar to
+// |target_block|.  Candidates inside |exclude_interval| are skipped.
+MEDIA_EXPORT int FullSearch(int low_limit,
+                            int high_limit,
+                            Interval exclude_interval,
+                            const AudioBus* target_block,
+                            const AudioBus* search_segment,
+                            const float* energy_target_block,
+                            const float* energy_candidate_blocks);
+
+// Returns the index of the block of |search_block| most similar to
+// |target_block|, where blocks are |target_block->frames()| long.  A coarse
+// decimated search finds the neighbourhood of the best match, which is then
+// refined with a full search.  Candidates inside |exclude_interval| are never
+// chosen.
+MEDIA_EXPORT int OptimalIndex(const AudioBus* search_block,
+                              const AudioBus* target_block,
+                              Interval exclude_interval);
+
+// Fills |window| with a Hann window of |window_length| frames whose first and
+// second halves sum to one when overlap-added, i.e. w[n] + w[n + L/2] == 1.
+// |window_length| must be even.
+MEDIA_EXPORT void GetSymmetricHanningWindow(int window_length, float* window);
+
+}  // namespace internal
+
+}  // namespace media
+
+#endif  // MEDIA_FILTERS_WSOLA_INTERNALS_H_
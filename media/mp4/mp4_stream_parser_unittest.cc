@@ -7,8 +7,10 @@
 
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/command_line.h"
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
+#include "base/string_number_conversions.h"
 #include "base/time.h"
 #include "media/base/audio_decoder_config.h"
 #include "media/base/decoder_buffer.h"
@@ -27,6 +29,10 @@ namespace mp4 {
 // TODO(xhwang): Figure out the init data type appropriately once it's spec'ed.
 static const char kMp4InitDataType[] = "video/mp4";
 
+// Command line switch for the number of times the benchmark parses each file.
+static const char kBenchmarkIterations[] = "mp4-parser-iterations";
+static const int kDefaultIterations = 20;
+
 class MP4StreamParserTest : public testing::Test {
  public:
   MP4StreamParserTest()
@@ -174,6 +180,43 @@ TEST_F(MP4StreamParserTest, TestMPEG2_AAC_LC) {
   ParseMP4File("bear-mpeg2-aac-only_frag.mp4", 512);
 }
 
+// Benchmark for appending fragmented MP4 files, either whole or in network
+// sized pieces.
+TEST_F(MP4StreamParserTest, AppendBenchmark) {
+  int iterations = kDefaultIterations;
+  std::string iterations_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkIterations));
+  base::StringToInt(iterations_switch, &iterations);
+  if (iterations < 1)
+    iterations = kDefaultIterations;
+
+  static const char* kFiles[] = {
+    "bear-640x360-av_frag.mp4", "bear-1280x720-av_frag.mp4",
+  };
+
+  // Whole file appends and network sized ones.
+  static const int kPieceSizes[] = { 0, 64 * 1024 };
+
+  std::set<int> audio_object_types;
+  audio_object_types.insert(kISO_14496_3);
+  for (size_t i = 0; i < arraysize(kFiles); ++i) {
+    scoped_refptr<DecoderBuffer> file = ReadTestDataFile(kFiles[i]);
+    for (size_t j = 0; j < arraysize(kPieceSizes); ++j) {
+      int piece_size = kPieceSizes[j] ? kPieceSizes[j] : file->GetDataSize();
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      for (int k = 0; k < iterations; ++k) {
+        parser_.reset(new MP4StreamParser(audio_object_types, false));
+        InitializeParser();
+        ASSERT_TRUE(AppendDataInPieces(file->GetData(), file->GetDataSize(),
+                                       piece_size));
+      }
+      double seconds = (base::TimeTicks::HighResNow() - start).InSecondsF();
+      printf("%s in %d byte appends: %.1f MB/s.\n", kFiles[i], piece_size,
+             iterations * file->GetDataSize() / seconds / (1024 * 1024));
+    }
+  }
+}
+
 // TODO(strobe): Create and test media which uses CENC auxiliary info stored
 // inside a private box
 
@@ -5,7 +5,14 @@
 // demuxer_bench is a standalone benchmarking tool for FFmpegDemuxer. It
 // simulates the reading requirements for playback by reading from the stream
 // that has the earliest timestamp.
+//
+// With --latency-ms and --bandwidth-kbps the file is read as if it were
+// fetched over a network, see ThrottledDataSource, and the time to the first
+// packet after startup and after each of --seeks seeks is reported as well.
+// --disable-prefetch ignores the read-ahead hints the demuxer gives the data
+// source when seeking.
 
+#include <algorithm>
 #include <iostream>
 
 #include "base/at_exit.h"
@@ -17,12 +24,22 @@
 #include "media/base/media.h"
 #include "media/filters/ffmpeg_demuxer.h"
 #include "media/filters/file_data_source.h"
+#include "media/tools/demuxer_bench/throttled_data_source.h"
+
+namespace switches {
+const char kLatencyMs[] = "latency-ms";
+const char kBandwidthKbps[] = "bandwidth-kbps";
+const char kSeeks[] = "seeks";
+const char kDisablePrefetch[] = "disable-prefetch";
+}  // namespace switches
 
 class DemuxerHostImpl : public media::DemuxerHost {
  public:
   DemuxerHostImpl() {}
   virtual ~DemuxerHostImpl() {}
 
+  base::TimeDelta duration() const { return duration_; }
+
   // DataSourceHost implementation.
   virtual void SetTotalBytes(int64 total_bytes) OVERRIDE {}
   virtual void AddBufferedByteRange(int64 start, int64 end) OVERRIDE {}
@@ -30,10 +47,14 @@ class DemuxerHostImpl : public media::DemuxerHost {
                                     base::TimeDelta end) OVERRIDE {}
 
   // DemuxerHost implementation.
-  virtual void SetDuration(base::TimeDelta duration) OVERRIDE {}
+  virtual void SetDuration(base::TimeDelta duration) OVERRIDE {
+    duration_ = duration;
+  }
   virtual void OnDemuxerError(media::PipelineStatus error) OVERRIDE {}
 
  private:
+  base::TimeDelta duration_;
+
   DISALLOW_COPY_AND_ASSIGN(DemuxerHostImpl);
 };
 
@@ -156,6 +177,28 @@ int StreamReader::GetNextStreamIndexToRead() {
   return index;
 }
 
+static void QuitLoopOnRead(MessageLoop* message_loop,
+                           media::DemuxerStream::Status status,
+                           const scoped_refptr<media::DecoderBuffer>& buffer) {
+  CHECK_EQ(status, media::DemuxerStream::kOk);
+  message_loop->PostTask(FROM_HERE, MessageLoop::QuitWhenIdleClosure());
+}
+
+// Reads one packet from every stream, i.e. waits until playback could start.
+static void ReadFirstPackets(const Streams& streams) {
+  for (size_t i = 0; i < streams.size(); ++i) {
+    streams[i]->Read(base::Bind(&QuitLoopOnRead, MessageLoop::current()));
+    MessageLoop::current()->Run();
+  }
+}
+
+static int GetIntSwitch(const CommandLine* cmd_line, const char* name) {
+  int value = 0;
+  if (cmd_line->HasSwitch(name))
+    CHECK(base::StringToInt(cmd_line->GetSwitchValueASCII(name), &value));
+  return value;
+}
+
 int main(int argc, char** argv) {
   base::AtExitManager at_exit;
   media::InitializeMediaLibraryForTesting();
@@ -164,27 +207,75 @@ int main(int argc, char** argv) {
   CommandLine* cmd_line = CommandLine::ForCurrentProcess();
 
   if (cmd_line->GetArgs().empty()) {
-    std::cerr << "Usage: " << argv[0] << " [file]" << std::endl;
+    std::cerr << "Usage: " << argv[0] << " [--latency-ms=N] "
+              << "[--bandwidth-kbps=N] [--seeks=N] [--disable-prefetch] [file]"
+              << std::endl;
     return 1;
   }
 
+  int latency_ms = GetIntSwitch(cmd_line, switches::kLatencyMs);
+  int bandwidth_kbps = GetIntSwitch(cmd_line, switches::kBandwidthKbps);
+  int seeks = GetIntSwitch(cmd_line, switches::kSeeks);
+  bool throttled = latency_ms > 0 || bandwidth_kbps > 0;
+
   MessageLoop message_loop;
   DemuxerHostImpl demuxer_host;
   base::FilePath file_path(cmd_line->GetArgs()[0]);
 
   // Setup.
-  scoped_refptr<media::FileDataSource> data_source =
+  scoped_refptr<media::FileDataSource> file_data_source =
       new media::FileDataSource();
-  CHECK(data_source->Initialize(file_path));
+  CHECK(file_data_source->Initialize(file_path));
+
+  scoped_refptr<media::DataSource> data_source = file_data_source;
+  scoped_refptr<ThrottledDataSource> throttled_data_source;
+  if (throttled) {
+    throttled_data_source = new ThrottledDataSource(
+        file_data_source, base::TimeDelta::FromMilliseconds(latency_ms),
+        bandwidth_kbps * 1000 / 8,
+        !cmd_line->HasSwitch(switches::kDisablePrefetch));
+    data_source = throttled_data_source;
+  }
 
   scoped_refptr<media::FFmpegDemuxer> demuxer =
       new media::FFmpegDemuxer(message_loop.message_loop_proxy(), data_source);
 
+  base::TimeTicks startup_start = base::TimeTicks::HighResNow();
   demuxer->Initialize(&demuxer_host, base::Bind(
       &QuitLoopWithStatus, &message_loop));
   message_loop.Run();
 
   StreamReader stream_reader(demuxer);
+  ReadFirstPackets(stream_reader.streams());
+  base::TimeDelta startup_time =
+      base::TimeTicks::HighResNow() - startup_start;
+  std::cout << "Startup: " << startup_time.InMillisecondsF() << " ms\n";
+
+  // Seek backwards from the end so that no seek lands in data fetched for the
+  // previous one.
+  if (seeks > 0) {
+    base::TimeDelta total_seek_time;
+    base::TimeDelta max_seek_time;
+    for (int i = seeks; i > 0; --i) {
+      base::TimeDelta target = demuxer_host.duration() * i / (seeks + 1);
+      base::TimeTicks seek_start = base::TimeTicks::HighResNow();
+      demuxer->Seek(target, base::Bind(&QuitLoopWithStatus, &message_loop));
+      message_loop.Run();
+      ReadFirstPackets(stream_reader.streams());
+
+      base::TimeDelta seek_time = base::TimeTicks::HighResNow() - seek_start;
+      total_seek_time += seek_time;
+      max_seek_time = std::max(max_seek_time, seek_time);
+    }
+    std::cout << "Seek: " << (total_seek_time / seeks).InMillisecondsF()
+              << " ms mean, " << max_seek_time.InMillisecondsF()
+              << " ms max over " << seeks << " seeks\n";
+
+    // Restart from the beginning for the read benchmark.
+    demuxer->Seek(base::TimeDelta(),
+                  base::Bind(&QuitLoopWithStatus, &message_loop));
+    message_loop.Run();
+  }
 
   // Benchmark.
   base::TimeTicks start = base::TimeTicks::HighResNow();
@@ -210,6 +301,9 @@ int main(int argc, char** argv) {
     std::cout << ", " << stream_reader.counts()[i] << " packets" << std::endl;
   }
 
+  if (throttled_data_source)
+    std::cout << "Requests: " << throttled_data_source->requests() << "\n";
+
   // Teardown.
   demuxer->Stop(base::Bind(
       &QuitLoopWithStatus, &message_loop, media::PIPELINE_OK));
@@ -0,0 +1,134 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/tools/demuxer_bench/throttled_data_source.h"
+
+#include <algorithm>
+
+#include "base/threading/platform_thread.h"
+
+// Reads this far ahead of what a request has delivered wait for the request
+// instead of starting a new one. Matches BufferedResourceLoader.
+static const int64 kForwardWaitThreshold = 2 * 1024 * 1024;
+
+ThrottledDataSource::Request::Request()
+    : active(false),
+      position(0) {
+}
+
+ThrottledDataSource::ThrottledDataSource(
+    const scoped_refptr<media::DataSource>& data_source,
+    base::TimeDelta latency,
+    int bytes_per_second,
+    bool honor_prefetch)
+    : data_source_(data_source),
+      latency_(latency),
+      bytes_per_second_(bytes_per_second),
+      honor_prefetch_(honor_prefetch),
+      requests_(0) {
+}
+
+ThrottledDataSource::~ThrottledDataSource() {}
+
+int ThrottledDataSource::requests() {
+  base::AutoLock auto_lock(lock_);
+  return requests_;
+}
+
+void ThrottledDataSource::set_host(media::DataSourceHost* host) {
+  data_source_->set_host(host);
+}
+
+void ThrottledDataSource::Stop(const base::Closure& closure) {
+  data_source_->Stop(closure);
+}
+
+void ThrottledDataSource::Read(
+    int64 position, int size, uint8* data,
+    const media::DataSource::ReadCB& read_cb) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeTicks ready;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!CanServe(current_request_, position, now)) {
+      if (CanServe(prefetch_request_, position, now)) {
+        current_request_ = prefetch_request_;
+        prefetch_request_ = Request();
+      } else {
+        current_request_ = StartRequest_Locked(position, now);
+      }
+    }
+    ready = ArrivalTime(current_request_, position + size);
+  }
+
+  // Reads are issued from FFmpegDemuxer's blocking thread, so blocking here
+  // is what a slow network read looks like to the demuxer.
+  if (ready > now)
+    base::PlatformThread::Sleep(ready - now);
+
+  data_source_->Read(position, size, data, read_cb);
+}
+
+bool ThrottledDataSource::GetSize(int64* size_out) {
+  return data_source_->GetSize(size_out);
+}
+
+bool ThrottledDataSource::IsStreaming() {
+  return data_source_->IsStreaming();
+}
+
+void ThrottledDataSource::SetBitrate(int bitrate) {
+  data_source_->SetBitrate(bitrate);
+}
+
+void ThrottledDataSource::Prefetch(int64 position) {
+  if (!honor_prefetch_)
+    return;
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::AutoLock auto_lock(lock_);
+  if (CanServe(current_request_, position, now) ||
+      CanServe(prefetch_request_, position, now)) {
+    return;
+  }
+  prefetch_request_ = StartRequest_Locked(position, now);
+}
+
+bool ThrottledDataSource::CanServe(const Request& request, int64 position,
+                                   base::TimeTicks now) const {
+  if (!request.active || position < request.position)
+    return false;
+
+  int64 delivered = 0;
+  if (bytes_per_second_ <= 0) {
+    delivered = kint64max / 2;
+  } else if (now > request.first_byte_time) {
+    delivered = (now - request.first_byte_time).InSecondsF() *
+        bytes_per_second_;
+  }
+  return position - request.position < delivered + kForwardWaitThreshold;
+}
+
+base::TimeTicks ThrottledDataSource::ArrivalTime(const Request& request,
+                                                 int64 end_position) const {
+  if (bytes_per_second_ <= 0)
+    return request.first_byte_time;
+
+  int64 bytes = std::max(end_position - request.position,
+                         static_cast<int64>(0));
+  return request.first_byte_time + base::TimeDelta::FromMicroseconds(
+      bytes * base::Time::kMicrosecondsPerSecond / bytes_per_second_);
+}
+
+ThrottledDataSource::Request ThrottledDataSource::StartRequest_Locked(
+    int64 position, base::TimeTicks now) {
+  lock_.AssertAcquired();
+  ++requests_;
+
+  Request request;
+  request.active = true;
+  request.position = position;
+  request.first_byte_time = now + latency_;
+  return request;
+}
@@ -0,0 +1,84 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_TOOLS_DEMUXER_BENCH_THROTTLED_DATA_SOURCE_H_
+#define MEDIA_TOOLS_DEMUXER_BENCH_THROTTLED_DATA_SOURCE_H_
+
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+#include "media/base/data_source.h"
+
+// Delays reads from another DataSource as if they were fetched over a network
+// connection, modelled after BufferedDataSource: a read continues the current
+// request if it lies within what the request has delivered or will deliver
+// shortly, otherwise a new request is started, which takes |latency| before
+// its first byte arrives. Data arrives at |bytes_per_second| per request.
+//
+// Prefetch() starts a second request in parallel which later reads may
+// continue from, the same way BufferedDataSource does.
+class ThrottledDataSource : public media::DataSource {
+ public:
+  // |data_source| must be initialized in advance. Prefetch() hints are
+  // ignored if |honor_prefetch| is false.
+  ThrottledDataSource(const scoped_refptr<media::DataSource>& data_source,
+                      base::TimeDelta latency,
+                      int bytes_per_second,
+                      bool honor_prefetch);
+
+  // Returns the number of requests started so far.
+  int requests();
+
+  // media::DataSource implementation.
+  virtual void set_host(media::DataSourceHost* host) OVERRIDE;
+  virtual void Stop(const base::Closure& closure) OVERRIDE;
+  virtual void Read(
+      int64 position, int size, uint8* data,
+      const media::DataSource::ReadCB& read_cb) OVERRIDE;
+  virtual bool GetSize(int64* size_out) OVERRIDE;
+  virtual bool IsStreaming() OVERRIDE;
+  virtual void SetBitrate(int bitrate) OVERRIDE;
+  virtual void Prefetch(int64 position) OVERRIDE;
+
+ protected:
+  virtual ~ThrottledDataSource();
+
+ private:
+  // A simulated request for the resource starting at |position| whose first
+  // byte arrives at |first_byte_time|.
+  struct Request {
+    Request();
+
+    bool active;
+    int64 position;
+    base::TimeTicks first_byte_time;
+  };
+
+  // Returns true if a read at |position| at time |now| can be served by
+  // |request| without starting a new one.
+  bool CanServe(const Request& request, int64 position,
+                base::TimeTicks now) const;
+
+  // Returns the time at which |request| has delivered the byte preceding
+  // |end_position|.
+  base::TimeTicks ArrivalTime(const Request& request,
+                              int64 end_position) const;
+
+  // Starts a new request at |position|.
+  Request StartRequest_Locked(int64 position, base::TimeTicks now);
+
+  scoped_refptr<media::DataSource> data_source_;
+  const base::TimeDelta latency_;
+  const int bytes_per_second_;
+  const bool honor_prefetch_;
+
+  // Protects the members below.
+  base::Lock lock_;
+  Request current_request_;
+  Request prefetch_request_;
+  int requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThrottledDataSource);
+};
+
+#endif  // MEDIA_TOOLS_DEMUXER_BENCH_THROTTLED_DATA_SOURCE_H_
@@ -22,6 +22,7 @@
 #include "base/path_service.h"
 #include "base/string_number_conversions.h"
 #include "base/string_util.h"
+#include "base/sys_info.h"
 #include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "build/build_config.h"
@@ -31,6 +32,8 @@
 #include "media/filters/ffmpeg_glue.h"
 #include "media/filters/ffmpeg_video_decoder.h"
 #include "media/filters/in_memory_url_protocol.h"
+#include "media/filters/video_decode_threads.h"
+#include "ui/gfx/size.h"
 
 // For pipe _setmode to binary
 #if defined(OS_WIN)
@@ -41,6 +44,7 @@
 namespace switches {
 const char kStream[]       = "stream";
 const char kVideoThreads[] = "video-threads";
+const char kThreadType[]   = "thread-type";
 const char kFast2[]        = "fast2";
 const char kErrorCorrection[] = "error-correction";
 const char kSkip[]         = "skip";
@@ -107,6 +111,10 @@ int main(int argc, const char** argv) {
               << "Benchmark either the audio or video stream\n"
               << "  --video-threads=N               "
               << "Decode video using N threads\n"
+              << "  --video-threads=auto            "
+              << "Pick threads from resolution and cores\n"
+              << "  --thread-type=[frame|slice]     "
+              << "Restrict FFmpeg to frame or slice threading\n"
               << "  --frames=N                      "
               << "Decode N frames\n"
               << "  --loop=N                        "
@@ -156,12 +164,29 @@ int main(int argc, const char** argv) {
 
   // Determine number of threads to use for video decoding (optional).
   int video_threads = 0;
+  bool auto_threads = false;
   std::string threads(cmd_line->GetSwitchValueASCII(switches::kVideoThreads));
-  if (!threads.empty() &&
-      !base::StringToInt(threads, &video_threads)) {
+  if (threads == "auto") {
+    auto_threads = true;
+  } else if (!threads.empty() &&
+             !base::StringToInt(threads, &video_threads)) {
     video_threads = 0;
   }
 
+  // Determine which kind of threading FFmpeg may use (optional).
+  int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  std::string thread_type_opt(
+      cmd_line->GetSwitchValueASCII(switches::kThreadType));
+  if (thread_type_opt == "frame") {
+    thread_type = FF_THREAD_FRAME;
+  } else if (thread_type_opt == "slice") {
+    thread_type = FF_THREAD_SLICE;
+  } else if (!thread_type_opt.empty()) {
+    std::cerr << "Unknown --thread-type option " << thread_type_opt
+              << std::endl;
+    return 1;
+  }
+
   // Determine number of frames to decode (optional).
   int max_frames = 0;
   std::string frames_opt(cmd_line->GetSwitchValueASCII(switches::kFrames));
@@ -321,8 +346,14 @@ int main(int argc, const char** argv) {
   }
 
   // Initialize threaded decode.
+  if (target_codec == AVMEDIA_TYPE_VIDEO && auto_threads) {
+    video_threads = media::VideoDecodeThreads::GetDesiredThreadCount(
+        gfx::Size(codec_context->width, codec_context->height),
+        base::SysInfo::NumberOfProcessors());
+  }
   if (target_codec == AVMEDIA_TYPE_VIDEO && video_threads > 0) {
     codec_context->thread_count = video_threads;
+    codec_context->thread_type = thread_type;
   }
 
   // Initialize our codec.
@@ -559,6 +590,7 @@ int main(int argc, const char** argv) {
   *log_out << "     Frames:" << std::setw(11) << frames << std::endl;
   *log_out << "      Width:" << std::setw(11) << video_width << std::endl;
   *log_out << "     Height:" << std::setw(11) << video_height << std::endl;
+  *log_out << "    Threads:" << std::setw(11) << video_threads << std::endl;
   *log_out << "      Total:" << std::setw(11) << total.InMillisecondsF()
            << " ms" << std::endl;
   *log_out << "  Summation:" << std::setw(11) << sum
@@ -97,11 +97,19 @@ void WebMClusterParser::Reset() {
 }
 
 int WebMClusterParser::Parse(const uint8* buf, int size) {
+  return Parse(buf, size, NULL);
+}
+
+int WebMClusterParser::Parse(
+    const uint8* buf, int size,
+    const scoped_refptr<base::RefCountedMemory>& memory) {
   audio_.Reset();
   video_.Reset();
   ResetTextTracks();
 
+  memory_ = memory;
   int result = parser_.Parse(buf, size);
+  memory_ = NULL;
 
   if (result < 0) {
     cluster_ended_ = false;
@@ -287,8 +295,14 @@ bool WebMClusterParser::OnBlock(bool is_simple_block, int track_num,
   bool is_keyframe =
       is_simple_block ? (flags & 0x80) != 0 : track->IsKeyframe(data, size);
 
-  scoped_refptr<StreamParserBuffer> buffer =
-      StreamParserBuffer::CopyFrom(data, size, is_keyframe);
+  // Refer to the appended data directly.  Only blocks which were not parsed
+  // from |memory_|, such as those of a BlockGroup, are copied.
+  scoped_refptr<StreamParserBuffer> buffer;
+  if (memory_ && DecoderBuffer::CanSlice(*memory_, data, size)) {
+    buffer = StreamParserBuffer::CreateSlice(memory_, data, size, is_keyframe);
+  } else {
+    buffer = StreamParserBuffer::CopyFrom(data, size, is_keyframe);
+  }
 
   // Every encrypted Block has a signal byte and IV prepended to it. Current
   // encrypted WebM request for comments specification is here
@@ -10,6 +10,7 @@
 #include <set>
 #include <string>
 
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "media/base/media_export.h"
 #include "media/base/media_log.h"
@@ -62,6 +63,12 @@ class MEDIA_EXPORT WebMClusterParser : public WebMParserClient {
   // Returns the number of bytes parsed on success.
   int Parse(const uint8* buf, int size);
 
+  // Same as above, but |buf| lies in |memory| and the buffers created may
+  // refer to it instead of copying the block data, see
+  // DecoderBuffer::CanSlice().  |memory| must not be written to afterwards.
+  int Parse(const uint8* buf, int size,
+            const scoped_refptr<base::RefCountedMemory>& memory);
+
   base::TimeDelta cluster_start_time() const { return cluster_start_time_; }
   const BufferQueue& audio_buffers() const { return audio_.buffers(); }
   const BufferQueue& video_buffers() const { return video_.buffers(); }
@@ -125,6 +132,9 @@ class MEDIA_EXPORT WebMClusterParser : public WebMParserClient {
 
   WebMListParser parser_;
 
+  // Memory holding the data passed to the current Parse() call, if any.
+  scoped_refptr<base::RefCountedMemory> memory_;
+
   int64 last_block_timecode_;
   scoped_array<uint8> block_data_;
   int block_data_size_;
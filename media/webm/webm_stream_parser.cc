@@ -441,7 +441,8 @@ int WebMStreamParser::ParseCluster(const uint8* data, int size) {
     return 0;
   }
 
-  int bytes_parsed = cluster_parser_->Parse(data, size);
+  int bytes_parsed =
+      cluster_parser_->Parse(data, size, byte_queue_.segment());
 
   if (bytes_parsed <= 0)
     return bytes_parsed;
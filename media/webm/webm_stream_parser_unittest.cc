@@ -0,0 +1,171 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "media/base/audio_decoder_config.h"
+#include "media/base/decoder_buffer.h"
+#include "media/base/stream_parser_buffer.h"
+#include "media/base/test_data_util.h"
+#include "media/base/video_decoder_config.h"
+#include "media/webm/webm_stream_parser.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+// Command line switch for the number of times the benchmark parses each file.
+static const char kBenchmarkIterations[] = "webm-parser-iterations";
+static const int kDefaultIterations = 20;
+
+class WebMStreamParserTest : public testing::Test {
+ public:
+  WebMStreamParserTest() : keep_buffers_(false) {}
+
+ protected:
+  void InitializeParser() {
+    parser_.reset(new WebMStreamParser());
+    parser_->Init(
+        base::Bind(&WebMStreamParserTest::InitF, base::Unretained(this)),
+        base::Bind(&WebMStreamParserTest::NewConfigF, base::Unretained(this)),
+        base::Bind(&WebMStreamParserTest::NewBuffersF, base::Unretained(this)),
+        base::Bind(&WebMStreamParserTest::NewBuffersF, base::Unretained(this)),
+        base::Bind(&WebMStreamParserTest::KeyNeededF, base::Unretained(this)),
+        base::Bind(&WebMStreamParserTest::NewSegmentF, base::Unretained(this)),
+        base::Bind(&WebMStreamParserTest::EndOfSegmentF,
+                   base::Unretained(this)),
+        LogCB());
+  }
+
+  bool AppendDataInPieces(const uint8* data, size_t length, size_t piece_size) {
+    const uint8* start = data;
+    const uint8* end = data + length;
+    while (start < end) {
+      size_t append_size = std::min(piece_size,
+                                    static_cast<size_t>(end - start));
+      if (!parser_->Parse(start, append_size))
+        return false;
+      start += append_size;
+    }
+    return true;
+  }
+
+  bool ParseWebMFile(const std::string& filename, size_t piece_size) {
+    InitializeParser();
+    scoped_refptr<DecoderBuffer> buffer = ReadTestDataFile(filename);
+    return AppendDataInPieces(buffer->GetData(), buffer->GetDataSize(),
+                              piece_size);
+  }
+
+  void InitF(bool init_ok, base::TimeDelta duration) {
+    EXPECT_TRUE(init_ok);
+  }
+
+  bool NewConfigF(const AudioDecoderConfig& ac, const VideoDecoderConfig& vc) {
+    return true;
+  }
+
+  bool NewBuffersF(const StreamParser::BufferQueue& bufs) {
+    if (!keep_buffers_)
+      return true;
+    for (StreamParser::BufferQueue::const_iterator buf = bufs.begin();
+         buf != bufs.end(); ++buf) {
+      buffers_.push_back(*buf);
+      contents_.push_back(std::vector<uint8>(
+          (*buf)->GetData(), (*buf)->GetData() + (*buf)->GetDataSize()));
+    }
+    return true;
+  }
+
+  bool KeyNeededF(const std::string& type,
+                  scoped_array<uint8> init_data, int init_data_size) {
+    return true;
+  }
+
+  void NewSegmentF(base::TimeDelta start_dts) {}
+
+  void EndOfSegmentF() {}
+
+  scoped_ptr<WebMStreamParser> parser_;
+
+  // Buffers emitted by the parser and a copy of their data at that time, if
+  // |keep_buffers_| is set.
+  bool keep_buffers_;
+  std::vector<scoped_refptr<StreamParserBuffer> > buffers_;
+  std::vector<std::vector<uint8> > contents_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(WebMStreamParserTest);
+};
+
+// Buffers refer to the appended data, which must stay intact after the parser
+// has moved on and been destroyed.
+TEST_F(WebMStreamParserTest, BuffersOutliveParser) {
+  keep_buffers_ = true;
+  ASSERT_TRUE(ParseWebMFile("bear-320x240.webm", 4096));
+  parser_.reset();
+
+  ASSERT_FALSE(buffers_.empty());
+  for (size_t i = 0; i < buffers_.size(); ++i) {
+    ASSERT_EQ(contents_[i].size(),
+              static_cast<size_t>(buffers_[i]->GetDataSize()));
+    EXPECT_EQ(0, memcmp(&contents_[i][0], buffers_[i]->GetData(),
+                        contents_[i].size())) << "buffer " << i;
+  }
+}
+
+// The buffers must not depend on how the data was split into appends.
+TEST_F(WebMStreamParserTest, AppendSizesGiveSameBuffers) {
+  keep_buffers_ = true;
+  ASSERT_TRUE(ParseWebMFile("bear-320x240.webm", 1 << 20));
+  std::vector<std::vector<uint8> > expected;
+  expected.swap(contents_);
+  buffers_.clear();
+
+  ASSERT_TRUE(ParseWebMFile("bear-320x240.webm", 7));
+  EXPECT_TRUE(expected == contents_);
+}
+
+// Benchmark for appending WebM files, either whole or in network sized
+// pieces.
+TEST_F(WebMStreamParserTest, AppendBenchmark) {
+  int iterations = kDefaultIterations;
+  std::string iterations_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkIterations));
+  base::StringToInt(iterations_switch, &iterations);
+  if (iterations < 1)
+    iterations = kDefaultIterations;
+
+  static const char* kFiles[] = {
+    "bear-320x240.webm", "bear-640x360.webm", "bear-320x240-av-enc_av.webm",
+  };
+
+  // Whole file appends and network sized ones.
+  static const int kPieceSizes[] = { 0, 64 * 1024 };
+
+  for (size_t i = 0; i < arraysize(kFiles); ++i) {
+    scoped_refptr<DecoderBuffer> file = ReadTestDataFile(kFiles[i]);
+    for (size_t j = 0; j < arraysize(kPieceSizes); ++j) {
+      int piece_size = kPieceSizes[j] ? kPieceSizes[j] : file->GetDataSize();
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      for (int k = 0; k < iterations; ++k) {
+        InitializeParser();
+        ASSERT_TRUE(AppendDataInPieces(file->GetData(), file->GetDataSize(),
+                                       piece_size));
+      }
+      double seconds = (base::TimeTicks::HighResNow() - start).InSecondsF();
+      printf("%s in %d byte appends: %.1f MB/s.\n", kFiles[i], piece_size,
+             iterations * file->GetDataSize() / seconds / (1024 * 1024));
+    }
+  }
+}
+
+}  // namespace media
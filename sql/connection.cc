@@ -6,9 +6,14 @@
 
 #include <string.h>
 
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
 #include "base/files/file_path.h"
+#include "base/format_macros.h"
 #include "base/logging.h"
+#include "base/message_loop_proxy.h"
 #include "base/metrics/histogram.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
@@ -22,6 +27,10 @@ namespace {
 // TODO(shess): Better story on this.  http://crbug.com/56559
 const int kBusyTimeoutSeconds = 1;
 
+// Size of the write-ahead log, in pages, past which a checkpoint is
+// scheduled.  This is SQLite's default autocheckpoint threshold.
+const int kWalCheckpointPages = 1000;
+
 class ScopedBusyTimeout {
  public:
   explicit ScopedBusyTimeout(sqlite3* db)
@@ -71,6 +80,22 @@ bool StatementID::operator<(const StatementID& other) const {
   return strcmp(str_, other.str_) < 0;
 }
 
+std::string StatementID::ToString() const {
+  if (number_ == -1)
+    return str_;
+  return base::StringPrintf("%s:%d", str_, number_);
+}
+
+StatementProfile::StatementProfile()
+    : steps(0),
+      rows(0),
+      fullscan_steps(0),
+      sorts(0) {
+}
+
+StatementProfile::~StatementProfile() {
+}
+
 ErrorDelegate::~ErrorDelegate() {
 }
 
@@ -79,7 +104,8 @@ Connection::StatementRef::StatementRef(Connection* connection,
                                        bool was_valid)
     : connection_(connection),
       stmt_(stmt),
-      was_valid_(was_valid) {
+      was_valid_(was_valid),
+      profile_(NULL) {
   if (connection)
     connection_->StatementRefCreated(this);
 }
@@ -104,6 +130,7 @@ void Connection::StatementRef::Close(bool forced) {
     stmt_ = NULL;
   }
   connection_ = NULL;  // The connection may be getting deleted.
+  profile_ = NULL;  // And the profile with it.
 
   // Forced close is expected to happen from a statement error
   // handler.  In that case maintain the sense of |was_valid_| which
@@ -116,11 +143,16 @@ Connection::Connection()
       page_size_(0),
       cache_size_(0),
       exclusive_locking_(false),
+      write_ahead_log_(false),
+      mmap_size_(0),
+      checkpoint_pending_(false),
       transaction_nesting_(0),
       needs_rollback_(false),
       in_memory_(false),
       poisoned_(false),
-      error_delegate_(NULL) {
+      error_delegate_(NULL),
+      statement_profiling_(false),
+      ALLOW_THIS_IN_INITIALIZER_LIST(weak_factory_(this)) {
 }
 
 Connection::~Connection() {
@@ -146,6 +178,13 @@ void Connection::CloseInternal(bool forced) {
   // embedded systems, this is probably not appropriate, whereas on
   // desktop it might make some sense.
 
+  if (statement_profiling_)
+    TraceStatementProfiles();
+
+  // sqlite3_close() checkpoints the log itself.
+  weak_factory_.InvalidateWeakPtrs();
+  checkpoint_pending_ = false;
+
   // sqlite3_close() needs all prepared statements to be finalized.
 
   // Release cached statements.
@@ -457,8 +496,11 @@ scoped_refptr<Connection::StatementRef> Connection::GetCachedStatement(
   }
 
   scoped_refptr<StatementRef> statement = GetUniqueStatement(sql);
-  if (statement->is_valid())
+  if (statement->is_valid()) {
     statement_cache_[id] = statement;  // Only cache valid statements.
+    if (statement_profiling_)
+      ProfileStatement(id, statement.get());
+  }
   return statement;
 }
 
@@ -499,6 +541,31 @@ scoped_refptr<Connection::StatementRef> Connection::GetUntrackedStatement(
   return new StatementRef(NULL, stmt, true);
 }
 
+void Connection::EnableStatementProfiling() {
+  if (statement_profiling_)
+    return;
+  statement_profiling_ = true;
+  for (CachedStatementMap::iterator i = statement_cache_.begin();
+       i != statement_cache_.end(); ++i) {
+    ProfileStatement(i->first, i->second.get());
+  }
+}
+
+void Connection::TraceStatementProfiles() const {
+  for (StatementProfileMap::const_iterator i = statement_profiles_.begin();
+       i != statement_profiles_.end(); ++i) {
+    const StatementProfile& profile = i->second;
+    TRACE_EVENT_COPY_INSTANT2(
+        "sql", "StatementProfile",
+        "statement", i->first.ToString() + " " + profile.sql,
+        "profile", base::StringPrintf(
+            "steps=%" PRId64 " rows=%" PRId64 " time_us=%" PRId64
+            " fullscan_steps=%" PRId64 " sorts=%" PRId64,
+            profile.steps, profile.rows, profile.time.InMicroseconds(),
+            profile.fullscan_steps, profile.sorts));
+  }
+}
+
 bool Connection::IsSQLValid(const char* sql) {
   AssertIOAllowed();
   if (!db_) {
@@ -650,11 +717,17 @@ bool Connection::OpenInternal(const std::string& file_name) {
   // DELETE (default) - delete -journal file to commit.
   // TRUNCATE - truncate -journal file to commit.
   // PERSIST - zero out header of -journal file to commit.
-  // journal_size_limit provides size to trim to in PERSIST.
+  // WAL - append to the -wal file, see EnableWriteAheadLog().
+  // journal_size_limit provides size to trim to in PERSIST and WAL.
   // TODO(shess): Figure out if PERSIST and journal_size_limit really
   // matter.  In theory, it keeps pages pre-allocated, so if
   // transactions usually fit, it should be faster.
-  ignore_result(Execute("PRAGMA journal_mode = PERSIST"));
+  //
+  // WAL is entered after the page size is set, as the page size of a
+  // WAL database cannot change.
+  const bool use_wal = write_ahead_log_ && !in_memory_;
+  if (!use_wal)
+    ignore_result(Execute("PRAGMA journal_mode = PERSIST"));
   ignore_result(Execute("PRAGMA journal_size_limit = 16384"));
 
   const base::TimeDelta kBusyTimeout =
@@ -677,6 +750,20 @@ bool Connection::OpenInternal(const std::string& file_name) {
       DLOG(FATAL) << "Could not set cache size: " << GetErrorMessage();
   }
 
+  // Unknown pragmas are ignored, so this is harmless with versions of SQLite
+  // which cannot memory map.
+  if (mmap_size_ != 0 && !in_memory_) {
+    const std::string sql =
+        "PRAGMA mmap_size=" + base::Int64ToString(mmap_size_);
+    if (!ExecuteWithTimeout(sql.c_str(), kBusyTimeout))
+      DLOG(FATAL) << "Could not set mmap size: " << GetErrorMessage();
+  }
+
+  if (use_wal && !EnableWriteAheadLog()) {
+    DLOG(ERROR) << "Could not enable write-ahead log: " << GetErrorMessage();
+    ignore_result(Execute("PRAGMA journal_mode = PERSIST"));
+  }
+
   if (!ExecuteWithTimeout("PRAGMA secure_delete=ON", kBusyTimeout)) {
     DLOG(FATAL) << "Could not enable secure_delete: " << GetErrorMessage();
     Close();
@@ -692,6 +779,74 @@ void Connection::DoRollback() {
   needs_rollback_ = false;
 }
 
+bool Connection::EnableWriteAheadLog() {
+  // The pragma returns the journal mode in effect, which is unchanged if
+  // the log could not be set up (for instance on a filesystem without
+  // shared memory support).
+  std::string mode;
+  {
+    Statement statement(GetUniqueStatement("PRAGMA journal_mode = WAL"));
+    if (!statement.Step())
+      return false;
+    mode = StringToLowerASCII(statement.ColumnString(0));
+  }
+  if (mode != "wal")
+    return false;
+
+  // With a log, NORMAL only syncs at checkpoints and is still durable
+  // against application crashes.  A power loss can roll back the last
+  // transactions but cannot corrupt the database.
+  ignore_result(Execute("PRAGMA synchronous = NORMAL"));
+
+  // This replaces SQLite's autocheckpoint, which would run the checkpoint
+  // inside the commit crossing the threshold.
+  sqlite3_wal_hook(db_, &Connection::OnWalCommit, this);
+  return true;
+}
+
+// static
+int Connection::OnWalCommit(void* connection, sqlite3* db,
+                            const char* db_name, int pages) {
+  Connection* self = static_cast<Connection*>(connection);
+  if (pages < kWalCheckpointPages || self->checkpoint_pending_)
+    return SQLITE_OK;
+
+  // Connections used off a message loop checkpoint right away.
+  scoped_refptr<base::MessageLoopProxy> loop =
+      base::MessageLoopProxy::current();
+  if (!loop) {
+    self->Checkpoint();
+    return SQLITE_OK;
+  }
+
+  self->checkpoint_pending_ = true;
+  loop->PostTask(FROM_HERE, base::Bind(&Connection::Checkpoint,
+                                       self->weak_factory_.GetWeakPtr()));
+  return SQLITE_OK;
+}
+
+void Connection::Checkpoint() {
+  checkpoint_pending_ = false;
+
+  // The next commit schedules another checkpoint if the log is still large.
+  if (!db_ || transaction_nesting_)
+    return;
+
+  AssertIOAllowed();
+  TRACE_EVENT0("sql", "Connection::Checkpoint");
+  int rc = sqlite3_wal_checkpoint_v2(db_, NULL, SQLITE_CHECKPOINT_PASSIVE,
+                                     NULL, NULL);
+  if (rc != SQLITE_OK)
+    UMA_HISTOGRAM_ENUMERATION("Sqlite.CheckpointFailure", rc & 0xff, 50);
+}
+
+void Connection::ProfileStatement(const StatementID& id, StatementRef* ref) {
+  StatementProfile* profile = &statement_profiles_[id];
+  if (profile->sql.empty())
+    profile->sql = sqlite3_sql(ref->stmt());
+  ref->set_profile(profile);
+}
+
 void Connection::StatementRefCreated(StatementRef* ref) {
   DCHECK(open_statements_.find(ref) == open_statements_.end());
   open_statements_.insert(ref);
@@ -13,6 +13,7 @@
 #include "base/compiler_specific.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/time.h"
 #include "sql/sql_export.h"
@@ -67,6 +68,9 @@ class StatementID {
   // We need this to insert into our map.
   bool operator<(const StatementID& other) const;
 
+  // Returns "file:line" or the unique name, for diagnostics.
+  std::string ToString() const;
+
  private:
   int number_;
   const char* str_;
@@ -76,6 +80,30 @@ class StatementID {
 
 class Connection;
 
+// Cost of a cached statement, accumulated while statement profiling is
+// enabled.  See Connection::EnableStatementProfiling().
+struct SQL_EXPORT StatementProfile {
+  StatementProfile();
+  ~StatementProfile();
+
+  // The SQL the statement was compiled from.
+  std::string sql;
+
+  // Number of calls to sqlite3_step(), and how many of them returned a row.
+  int64 steps;
+  int64 rows;
+
+  // Total time spent in sqlite3_step().
+  base::TimeDelta time;
+
+  // Rows visited by full table scans, and sorts done because no index could
+  // be used, as counted by sqlite3_stmt_status().
+  int64 fullscan_steps;
+  int64 sorts;
+};
+
+typedef std::map<StatementID, StatementProfile> StatementProfileMap;
+
 // ErrorDelegate defines the interface to implement error handling and recovery
 // for sqlite operations. This allows the rest of the classes to return true or
 // false while the actual error code and causing statement are delivered using
@@ -138,6 +166,25 @@ class SQL_EXPORT Connection {
   // This must be called before Open() to have an effect.
   void set_exclusive_locking() { exclusive_locking_ = true; }
 
+  // Call to put the database in write-ahead log mode instead of the default
+  // rollback journal.  Commits then append to the -wal file and only need to
+  // sync it, and readers are not blocked by a writer.  The log is written
+  // back to the database by a passive checkpoint posted to the current
+  // message loop once it grows past a threshold, rather than by whichever
+  // commit crosses it.
+  //
+  // The mode is stored in the database, so older code opening the file must
+  // support WAL too.  Has no effect on in-memory databases.  This must be
+  // called before Open() to have an effect.
+  void set_write_ahead_log() { write_ahead_log_ = true; }
+
+  // Sets the number of bytes of the database file that SQLite may map into
+  // memory and read from directly instead of through read() calls.  Zero
+  // means use the default value.  Memory mapping needs SQLite 3.7.17; older
+  // versions, including the bundled one, ignore the setting.  This must be
+  // called before Open() to have an effect.
+  void set_mmap_size(int64 mmap_size) { mmap_size_ = mmap_size; }
+
   // Sets the object that will handle errors. Recomended that it should be set
   // before calling Open(). If not set, the default is to ignore errors on
   // release and assert on debug builds.
@@ -308,6 +355,23 @@ class SQL_EXPORT Connection {
   // See GetCachedStatement above for examples and error information.
   scoped_refptr<StatementRef> GetUniqueStatement(const char* sql);
 
+  // Profiling -----------------------------------------------------------------
+
+  // Starts accumulating a StatementProfile for each cached statement,
+  // including the ones already cached.  Profiling adds a clock read around
+  // each step, so it should only be enabled while investigating performance.
+  void EnableStatementProfiling();
+
+  // Returns the profiles accumulated so far, keyed by statement ID.  They
+  // are kept after the database is closed.
+  const StatementProfileMap& statement_profiles() const {
+    return statement_profiles_;
+  }
+
+  // Emits an instant trace event in the "sql" category for each profiled
+  // statement.  Called when the database is closed.
+  void TraceStatementProfiles() const;
+
   // Info querying -------------------------------------------------------------
 
   // Returns true if the given table exists.
@@ -415,6 +479,11 @@ class SQL_EXPORT Connection {
     // if database wasn't open in memory.
     void AssertIOAllowed() { if (connection_) connection_->AssertIOAllowed(); }
 
+    // The profile the statement's cost is added to, or NULL when the
+    // statement is not profiled.  Owned by the connection.
+    StatementProfile* profile() const { return profile_; }
+    void set_profile(StatementProfile* profile) { profile_ = profile; }
+
    private:
     friend class base::RefCounted<StatementRef>;
 
@@ -423,6 +492,7 @@ class SQL_EXPORT Connection {
     Connection* connection_;
     sqlite3_stmt* stmt_;
     bool was_valid_;
+    StatementProfile* profile_;
 
     DISALLOW_COPY_AND_ASSIGN(StatementRef);
   };
@@ -432,6 +502,22 @@ class SQL_EXPORT Connection {
   // internally in the transaction management code.
   void DoRollback();
 
+  // Switches a file database to write-ahead logging.  Returns false if
+  // SQLite refused, leaving the rollback journal in use.
+  bool EnableWriteAheadLog();
+
+  // sqlite3_wal_hook() callback, run after each commit with the number of
+  // pages in the log.  |connection| is the Connection.
+  static int OnWalCommit(void* connection, sqlite3* db, const char* db_name,
+                         int pages);
+
+  // Runs a passive checkpoint, copying as much of the log as possible back
+  // into the database without waiting for readers.
+  void Checkpoint();
+
+  // Starts accumulating the cost of |ref|, cached under |id|.
+  void ProfileStatement(const StatementID& id, StatementRef* ref);
+
   // Called by a StatementRef when it's being created or destroyed. See
   // open_statements_ below.
   void StatementRefCreated(StatementRef* ref);
@@ -462,6 +548,11 @@ class SQL_EXPORT Connection {
   int page_size_;
   int cache_size_;
   bool exclusive_locking_;
+  bool write_ahead_log_;
+  int64 mmap_size_;
+
+  // True once a checkpoint has been posted and has not run yet.
+  bool checkpoint_pending_;
 
   // All cached statements. Keeping a reference to these statements means that
   // they'll remain active.
@@ -500,6 +591,13 @@ class SQL_EXPORT Connection {
   // Auxiliary error-code histogram.
   std::string error_histogram_name_;
 
+  // True if cached statements are profiled into |statement_profiles_|.
+  bool statement_profiling_;
+  StatementProfileMap statement_profiles_;
+
+  // Used to post checkpoints, invalidated when the database is closed.
+  base::WeakPtrFactory<Connection> weak_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(Connection);
 };
 
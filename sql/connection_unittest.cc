@@ -2,15 +2,37 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string>
+
+#include "base/command_line.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
 #include "sql/connection.h"
 #include "sql/meta_table.h"
 #include "sql/statement.h"
+#include "sql/transaction.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "third_party/sqlite/sqlite3.h"
 
+namespace {
+
+// Command line switch for the number of visits in the benchmark.
+const char kBenchmarkRows[] = "sql-benchmark-rows";
+const int kDefaultBenchmarkRows = 100;
+
+std::string GetJournalMode(sql::Connection* db) {
+  sql::Statement s(db->GetUniqueStatement("PRAGMA journal_mode"));
+  EXPECT_TRUE(s.Step());
+  return s.ColumnString(0);
+}
+
+}  // namespace
+
 class SQLConnectionTest : public testing::Test {
  public:
   SQLConnectionTest() {}
@@ -385,6 +407,187 @@ TEST_F(SQLConnectionTest, RazeAndCloseDiagnostics) {
 // closely match real life.  That would also allow testing
 // RazeWithTimeout().
 
+TEST_F(SQLConnectionTest, WriteAheadLog) {
+  EXPECT_EQ("persist", GetJournalMode(&db()));
+  db().Close();
+
+  db().set_write_ahead_log();
+  ASSERT_TRUE(db().Open(db_path()));
+  EXPECT_EQ("wal", GetJournalMode(&db()));
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a, b)"));
+  ASSERT_TRUE(db().Execute("INSERT INTO foo VALUES (1, 2)"));
+  db().Close();
+
+  // The mode persists in the file, but is only kept if asked for.
+  sql::Connection other_db;
+  ASSERT_TRUE(other_db.Open(db_path()));
+  EXPECT_EQ("persist", GetJournalMode(&other_db));
+  sql::Statement s(other_db.GetUniqueStatement("SELECT b FROM foo"));
+  ASSERT_TRUE(s.Step());
+  EXPECT_EQ(2, s.ColumnInt(0));
+}
+
+// A large log is checkpointed by a task rather than by the commit.
+TEST_F(SQLConnectionTest, WalCheckpointIsPosted) {
+  MessageLoop message_loop;
+  db().Close();
+  db().set_write_ahead_log();
+  ASSERT_TRUE(db().Open(db_path()));
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a BLOB)"));
+
+  // Each row takes a few pages, so this logs well past the threshold.
+  const std::string blob(4096, 'x');
+  for (int i = 0; i < 400; ++i) {
+    sql::Statement s(db().GetCachedStatement(SQL_FROM_HERE,
+                                             "INSERT INTO foo VALUES (?)"));
+    s.BindBlob(0, blob.data(), blob.size());
+    ASSERT_TRUE(s.Run());
+  }
+
+  int64 size_before = 0;
+  ASSERT_TRUE(file_util::GetFileSize(db_path(), &size_before));
+  EXPECT_LT(size_before, 400 * 4096);
+
+  message_loop.RunUntilIdle();
+  int64 size_after = 0;
+  ASSERT_TRUE(file_util::GetFileSize(db_path(), &size_after));
+  EXPECT_GT(size_after, 400 * 4096);
+}
+
+TEST_F(SQLConnectionTest, StatementProfiling) {
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a)"));
+  sql::StatementID insert_id("insert");
+  sql::StatementID select_id("select");
+
+  // Statements cached before profiling starts are picked up.
+  {
+    sql::Statement s(db().GetCachedStatement(insert_id,
+                                             "INSERT INTO foo VALUES (?)"));
+    s.BindInt(0, 0);
+    ASSERT_TRUE(s.Run());
+  }
+  db().EnableStatementProfiling();
+
+  for (int i = 1; i < 10; ++i) {
+    sql::Statement s(db().GetCachedStatement(insert_id,
+                                             "INSERT INTO foo VALUES (?)"));
+    s.BindInt(0, i);
+    ASSERT_TRUE(s.Run());
+  }
+  {
+    sql::Statement s(db().GetCachedStatement(select_id,
+                                             "SELECT a FROM foo ORDER BY a"));
+    while (s.Step()) {}
+  }
+
+  const sql::StatementProfileMap& profiles = db().statement_profiles();
+  ASSERT_EQ(2u, profiles.size());
+
+  const sql::StatementProfile& insert = profiles.find(insert_id)->second;
+  EXPECT_EQ("INSERT INTO foo VALUES (?)", insert.sql);
+  EXPECT_EQ(9, insert.steps);
+  EXPECT_EQ(0, insert.rows);
+  EXPECT_EQ(0, insert.sorts);
+
+  // Without an index the select scans the table and sorts it.
+  const sql::StatementProfile& select = profiles.find(select_id)->second;
+  EXPECT_EQ(11, select.steps);
+  EXPECT_EQ(10, select.rows);
+  EXPECT_LT(0, select.fullscan_steps);
+  EXPECT_EQ(1, select.sorts);
+
+  // Profiles outlive the connection.
+  db().Close();
+  EXPECT_EQ(2u, db().statement_profiles().size());
+}
+
+// Benchmark for a database shaped like the history database, adding one
+// visit per transaction as browsing does and then looking URLs up, with the
+// rollback journal and with the write-ahead log. Disabled by default; run
+// with --gtest_also_run_disabled_tests --sql-benchmark-rows=N.
+TEST_F(SQLConnectionTest, DISABLED_HistoryBenchmark) {
+  int rows = kDefaultBenchmarkRows;
+  std::string rows_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkRows));
+  base::StringToInt(rows_switch, &rows);
+  if (rows < 1)
+    rows = kDefaultBenchmarkRows;
+
+  db().Close();
+  for (int use_wal = 0; use_wal < 2; ++use_wal) {
+    base::FilePath path = db_path().InsertBeforeExtensionASCII(
+        use_wal ? "_wal" : "_persist");
+    sql::Connection db;
+    db.set_cache_size(6000);
+    if (use_wal)
+      db.set_write_ahead_log();
+    ASSERT_TRUE(db.Open(path));
+    db.EnableStatementProfiling();
+    ASSERT_TRUE(db.Execute(
+        "CREATE TABLE urls (id INTEGER PRIMARY KEY, url LONGVARCHAR,"
+        "title LONGVARCHAR, visit_count INTEGER DEFAULT 0 NOT NULL,"
+        "typed_count INTEGER DEFAULT 0 NOT NULL,"
+        "last_visit_time INTEGER NOT NULL,"
+        "hidden INTEGER DEFAULT 0 NOT NULL)"));
+    ASSERT_TRUE(db.Execute("CREATE INDEX urls_url_index ON urls (url)"));
+    ASSERT_TRUE(db.Execute(
+        "CREATE TABLE visits (id INTEGER PRIMARY KEY, url INTEGER NOT NULL,"
+        "visit_time INTEGER NOT NULL, from_visit INTEGER,"
+        "transition INTEGER DEFAULT 0 NOT NULL)"));
+    ASSERT_TRUE(db.Execute("CREATE INDEX visits_url_index ON visits (url)"));
+    ASSERT_TRUE(db.Execute(
+        "CREATE INDEX visits_time_index ON visits (visit_time)"));
+
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (int i = 0; i < rows; ++i) {
+      sql::Transaction transaction(&db);
+      ASSERT_TRUE(transaction.Begin());
+      sql::Statement url(db.GetCachedStatement(SQL_FROM_HERE,
+          "INSERT INTO urls (url, title, visit_count, last_visit_time) "
+          "VALUES (?, ?, 1, ?)"));
+      url.BindString(0, base::StringPrintf("http://www.example%d.com/page%d",
+                                           i % 97, i));
+      url.BindString(1, base::StringPrintf("Example page %d", i));
+      url.BindInt64(2, i);
+      ASSERT_TRUE(url.Run());
+
+      sql::Statement visit(db.GetCachedStatement(SQL_FROM_HERE,
+          "INSERT INTO visits (url, visit_time, from_visit) VALUES (?, ?, ?)"));
+      visit.BindInt64(0, db.GetLastInsertRowId());
+      visit.BindInt64(1, i);
+      visit.BindInt64(2, i - 1);
+      ASSERT_TRUE(visit.Run());
+      ASSERT_TRUE(transaction.Commit());
+    }
+    base::TimeDelta insert_time = base::TimeTicks::HighResNow() - start;
+
+    start = base::TimeTicks::HighResNow();
+    for (int i = 0; i < rows; ++i) {
+      int page = (i * 7) % rows;
+      sql::Statement s(db.GetCachedStatement(SQL_FROM_HERE,
+          "SELECT urls.id, visit_time FROM urls "
+          "JOIN visits ON visits.url = urls.id WHERE urls.url = ?"));
+      s.BindString(0, base::StringPrintf("http://www.example%d.com/page%d",
+                                         page % 97, page));
+      ASSERT_TRUE(s.Step());
+    }
+    base::TimeDelta lookup_time = base::TimeTicks::HighResNow() - start;
+
+    int64 fullscan_steps = 0;
+    const sql::StatementProfileMap& profiles = db.statement_profiles();
+    for (sql::StatementProfileMap::const_iterator it = profiles.begin();
+         it != profiles.end(); ++it) {
+      fullscan_steps += it->second.fullscan_steps;
+    }
+
+    printf("%s: %d visit transactions at %.1f us each, lookups at %.1f us "
+           "each, %d fullscan steps.\n", use_wal ? "WAL" : "Rollback journal",
+           rows, insert_time.InSecondsF() * 1e6 / rows,
+           lookup_time.InSecondsF() * 1e6 / rows,
+           static_cast<int>(fullscan_steps));
+  }
+}
+
 #if defined(OS_ANDROID)
 TEST_F(SQLConnectionTest, SetTempDirForSQL) {
 
@@ -49,12 +49,26 @@ bool Statement::CheckValid() const {
   return is_valid();
 }
 
+int Statement::StepInternal() {
+  StatementProfile* profile = ref_->profile();
+  if (!profile)
+    return CheckError(sqlite3_step(ref_->stmt()));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  int rc = sqlite3_step(ref_->stmt());
+  profile->time += base::TimeTicks::Now() - start;
+  profile->steps++;
+  if (rc == SQLITE_ROW)
+    profile->rows++;
+  return CheckError(rc);
+}
+
 bool Statement::Run() {
   ref_->AssertIOAllowed();
   if (!CheckValid())
     return false;
 
-  return CheckError(sqlite3_step(ref_->stmt())) == SQLITE_DONE;
+  return StepInternal() == SQLITE_DONE;
 }
 
 bool Statement::Step() {
@@ -62,7 +76,7 @@ bool Statement::Step() {
   if (!CheckValid())
     return false;
 
-  return CheckError(sqlite3_step(ref_->stmt())) == SQLITE_ROW;
+  return StepInternal() == SQLITE_ROW;
 }
 
 void Statement::Reset(bool clear_bound_vars) {
@@ -74,6 +88,15 @@ void Statement::Reset(bool clear_bound_vars) {
     if (clear_bound_vars)
       sqlite3_clear_bindings(ref_->stmt());
     sqlite3_reset(ref_->stmt());
+
+    // Collect the counters of the run that just ended and zero them.
+    StatementProfile* profile = ref_->profile();
+    if (profile) {
+      profile->fullscan_steps += sqlite3_stmt_status(
+          ref_->stmt(), SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+      profile->sorts +=
+          sqlite3_stmt_status(ref_->stmt(), SQLITE_STMTSTATUS_SORT, 1);
+    }
   }
 
   succeeded_ = false;
@@ -173,6 +173,10 @@ class SQL_EXPORT Statement {
   // ensuring that contracts are honored in error edge cases.
   bool CheckValid() const;
 
+  // Steps the statement, adding to its profile if it has one, and returns
+  // the result of CheckError().
+  int StepInternal();
+
   // The actual sqlite statement. This may be unique to us, or it may be cached
   // by the connection, which is why it's refcounted. This pointer is
   // guaranteed non-NULL.
@@ -12,6 +12,7 @@
 #include "base/memory/ref_counted_memory.h"
 #include "base/metrics/histogram.h"
 #include "base/string_piece.h"
+#include "third_party/zlib/zlib.h"
 
 // For details of the file layout, see
 // http://dev.chromium.org/developers/design-documents/linuxresourcesandlocalizedstrings
@@ -19,6 +20,10 @@
 namespace {
 
 static const uint32 kFileFormatVersion = 4;
+// Version 5 is identical to version 4, except that every entry's data starts
+// with a one byte EntryStorage tag. Compressed entries continue with the
+// uint32 uncompressed length and a zlib stream.
+static const uint32 kCompressedFileFormatVersion = 5;
 // Length of file header: version, entry count and text encoding type.
 static const size_t kHeaderLength = 2 * sizeof(uint32) + sizeof(uint8);
 
@@ -44,6 +49,26 @@ struct DataPackEntry {
 
 COMPILE_ASSERT(sizeof(DataPackEntry) == 6, size_of_entry_must_be_six);
 
+// Per-entry storage tag of version 5 packs.
+enum EntryStorage {
+  ENTRY_STORED = 0,
+  ENTRY_ZLIB = 1,
+};
+
+// Length of the storage tag and of the uncompressed length that follows the
+// tag of compressed entries.
+static const size_t kStorageTagLength = sizeof(uint8);
+static const size_t kCompressedHeaderLength =
+    kStorageTagLength + sizeof(uint32);
+
+// zlib's deflate format cannot compress by more than this ratio, so it bounds
+// the uncompressed length a compressed entry may claim.
+static const size_t kMaxZlibExpansion = 1032;
+
+// Entries smaller than this are always stored; the zlib stream overhead eats
+// most of the savings and they are cheaper to keep uncompressed.
+static const size_t kMinCompressedEntrySize = 128;
+
 // We're crashing when trying to load a pak file on Windows.  Add some error
 // codes for logging.
 // http://crbug.com/58056
@@ -59,12 +84,40 @@ enum LoadErrors {
   LOAD_ERRORS_COUNT,
 };
 
+// Returns in |out| the version 5 representation of |data|: compressed if that
+// makes it meaningfully smaller, stored otherwise.
+void EncodeEntry(const base::StringPiece& data, std::string* out) {
+  out->clear();
+  if (data.length() >= kMinCompressedEntrySize) {
+    uLongf compressed_length = compressBound(data.length());
+    out->resize(kCompressedHeaderLength + compressed_length);
+    if (compress2(reinterpret_cast<Bytef*>(&(*out)[kCompressedHeaderLength]),
+                  &compressed_length,
+                  reinterpret_cast<const Bytef*>(data.data()), data.length(),
+                  Z_BEST_COMPRESSION) == Z_OK &&
+        // Require a 1/8 saving so that already compressed images, which
+        // would only pay the decompression cost, are stored.
+        compressed_length < data.length() - data.length() / 8) {
+      (*out)[0] = static_cast<char>(ENTRY_ZLIB);
+      uint32 uncompressed_length = data.length();
+      memcpy(&(*out)[kStorageTagLength], &uncompressed_length,
+             sizeof(uncompressed_length));
+      out->resize(kCompressedHeaderLength + compressed_length);
+      return;
+    }
+    out->clear();
+  }
+  out->push_back(static_cast<char>(ENTRY_STORED));
+  data.AppendToString(out);
+}
+
 }  // namespace
 
 namespace ui {
 
 DataPack::DataPack(ui::ScaleFactor scale_factor)
     : resource_count_(0),
+      has_entry_storage_tags_(false),
       text_encoding_type_(BINARY),
       scale_factor_(scale_factor) {
 }
@@ -110,14 +163,17 @@ bool DataPack::LoadImpl() {
   // First uint32: version; second: resource count;
   const uint32* ptr = reinterpret_cast<const uint32*>(mmap_->data());
   uint32 version = ptr[0];
-  if (version != kFileFormatVersion) {
+  if (version != kFileFormatVersion &&
+      version != kCompressedFileFormatVersion) {
     LOG(ERROR) << "Bad data pack version: got " << version << ", expected "
-               << kFileFormatVersion;
+               << kFileFormatVersion << " or "
+               << kCompressedFileFormatVersion;
     UMA_HISTOGRAM_ENUMERATION("DataPack.Load", BAD_VERSION,
                               LOAD_ERRORS_COUNT);
     mmap_.reset();
     return false;
   }
+  has_entry_storage_tags_ = version == kCompressedFileFormatVersion;
   resource_count_ = ptr[1];
 
   // third: text encoding.
@@ -190,7 +246,70 @@ bool DataPack::GetStringPiece(uint16 resource_id,
   const DataPackEntry* next_entry = target + 1;
   size_t length = next_entry->file_offset - target->file_offset;
 
-  data->set(mmap_->data() + target->file_offset, length);
+  if (!has_entry_storage_tags_) {
+    data->set(mmap_->data() + target->file_offset, length);
+    return true;
+  }
+
+  return GetTaggedEntry(resource_id,
+                        mmap_->data() + target->file_offset, length, data);
+}
+
+bool DataPack::GetTaggedEntry(uint16 resource_id,
+                              const uint8* entry,
+                              size_t length,
+                              base::StringPiece* data) const {
+  if (length < kStorageTagLength) {
+    LOG(ERROR) << "Data pack entry " << resource_id << " has no storage tag.";
+    return false;
+  }
+
+  if (entry[0] == ENTRY_STORED) {
+    data->set(entry + kStorageTagLength, length - kStorageTagLength);
+    return true;
+  }
+
+  if (entry[0] != ENTRY_ZLIB || length < kCompressedHeaderLength) {
+    LOG(ERROR) << "Data pack entry " << resource_id << " is corrupt.";
+    return false;
+  }
+
+  base::AutoLock lock(decompressed_entries_lock_);
+  DecompressedEntries::const_iterator it =
+      decompressed_entries_.find(resource_id);
+  if (it != decompressed_entries_.end()) {
+    data->set(it->second.data(), it->second.length());
+    return true;
+  }
+
+  // Validate the stored length before allocating for it. The writer never
+  // compresses empty entries, and zlib cannot expand data by more than
+  // kMaxZlibExpansion, so other claims mean the pack is corrupt.
+  uint32 uncompressed_length;
+  memcpy(&uncompressed_length, entry + kStorageTagLength,
+         sizeof(uncompressed_length));
+  const size_t compressed_length = length - kCompressedHeaderLength;
+  if (uncompressed_length == 0 ||
+      uncompressed_length / kMaxZlibExpansion > compressed_length) {
+    LOG(ERROR) << "Data pack entry " << resource_id << " is corrupt.";
+    return false;
+  }
+
+  std::string decompressed(uncompressed_length, '\0');
+  uLongf decompressed_length = uncompressed_length;
+  if (uncompress(reinterpret_cast<Bytef*>(&decompressed[0]),
+                 &decompressed_length,
+                 reinterpret_cast<const Bytef*>(
+                     entry + kCompressedHeaderLength),
+                 compressed_length) != Z_OK ||
+      decompressed_length != uncompressed_length) {
+    LOG(ERROR) << "Failed to decompress data pack entry " << resource_id;
+    return false;
+  }
+
+  std::string& stored = decompressed_entries_[resource_id];
+  stored.swap(decompressed);
+  data->set(stored.data(), stored.length());
   return true;
 }
 
@@ -216,11 +335,40 @@ ui::ScaleFactor DataPack::GetScaleFactor() const {
 bool DataPack::WritePack(const base::FilePath& path,
                          const std::map<uint16, base::StringPiece>& resources,
                          TextEncodingType textEncodingType) {
+  return WritePackImpl(path, resources, textEncodingType, false);
+}
+
+// static
+bool DataPack::WriteCompressedPack(
+    const base::FilePath& path,
+    const std::map<uint16, base::StringPiece>& resources,
+    TextEncodingType textEncodingType) {
+  return WritePackImpl(path, resources, textEncodingType, true);
+}
+
+// static
+bool DataPack::WritePackImpl(
+    const base::FilePath& path,
+    const std::map<uint16, base::StringPiece>& resources,
+    TextEncodingType textEncodingType,
+    bool compress) {
+  // Encode all entries up front; the index needs their final lengths.
+  std::map<uint16, std::string> encoded_resources;
+  if (compress) {
+    for (std::map<uint16, base::StringPiece>::const_iterator it =
+             resources.begin();
+         it != resources.end(); ++it) {
+      EncodeEntry(it->second, &encoded_resources[it->first]);
+    }
+  }
+
   FILE* file = file_util::OpenFile(path, "wb");
   if (!file)
     return false;
 
-  if (fwrite(&kFileFormatVersion, sizeof(kFileFormatVersion), 1, file) != 1) {
+  const uint32 version =
+      compress ? kCompressedFileFormatVersion : kFileFormatVersion;
+  if (fwrite(&version, sizeof(version), 1, file) != 1) {
     LOG(ERROR) << "Failed to write file version";
     file_util::CloseFile(file);
     return false;
@@ -270,7 +418,8 @@ bool DataPack::WritePack(const base::FilePath& path,
       return false;
     }
 
-    data_offset += it->second.length();
+    data_offset += compress ? encoded_resources[resource_id].length() :
+                              it->second.length();
   }
 
   // We place an extra entry after the last item that allows us to read the
@@ -291,7 +440,10 @@ bool DataPack::WritePack(const base::FilePath& path,
   for (std::map<uint16, base::StringPiece>::const_iterator it =
            resources.begin();
        it != resources.end(); ++it) {
-    if (fwrite(it->second.data(), it->second.length(), 1, file) != 1) {
+    base::StringPiece data = it->second;
+    if (compress)
+      data = encoded_resources[it->first];
+    if (!data.empty() && fwrite(data.data(), data.length(), 1, file) != 1) {
       LOG(ERROR) << "Failed to write data for " << it->first;
       file_util::CloseFile(file);
       return false;
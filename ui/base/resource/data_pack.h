@@ -10,11 +10,13 @@
 #define UI_BASE_RESOURCE_DATA_PACK_H_
 
 #include <map>
+#include <string>
 
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/platform_file.h"
 #include "base/string_piece.h"
+#include "base/synchronization/lock.h"
 #include "ui/base/layout.h"
 #include "ui/base/resource/resource_handle.h"
 #include "ui/base/ui_export.h"
@@ -46,6 +48,17 @@ class UI_EXPORT DataPack : public ResourceHandle {
                         const std::map<uint16, base::StringPiece>& resources,
                         TextEncodingType textEncodingType);
 
+  // Like WritePack, but writes the version 5 format in which entries that
+  // compress well are stored zlib-compressed. Such entries are decompressed
+  // on first access and kept in memory for the lifetime of the pack, like
+  // the mapped data of stored entries, so the data returned for them stays
+  // valid as long as the pack. This suits packs of text resources that are
+  // only partly used, such as locale packs.
+  static bool WriteCompressedPack(
+      const base::FilePath& path,
+      const std::map<uint16, base::StringPiece>& resources,
+      TextEncodingType textEncodingType);
+
   // ResourceHandle implementation:
   virtual bool HasResource(uint16 resource_id) const OVERRIDE;
   virtual bool GetStringPiece(uint16 resource_id,
@@ -59,12 +72,37 @@ class UI_EXPORT DataPack : public ResourceHandle {
   // Does the actual loading of a pack file. Called by Load and LoadFromFile.
   bool LoadImpl();
 
+  // Shared implementation of WritePack and WriteCompressedPack.
+  static bool WritePackImpl(
+      const base::FilePath& path,
+      const std::map<uint16, base::StringPiece>& resources,
+      TextEncodingType textEncodingType,
+      bool compress);
+
+  // Returns in |data| the contents of the version 5 |entry| of |length|
+  // bytes, decompressing it if needed.
+  bool GetTaggedEntry(uint16 resource_id,
+                      const uint8* entry,
+                      size_t length,
+                      base::StringPiece* data) const;
+
   // The memory-mapped data.
   scoped_ptr<base::MemoryMappedFile> mmap_;
 
   // Number of resources in the data.
   size_t resource_count_;
 
+  // True for version 5 packs, whose entries start with a storage tag.
+  bool has_entry_storage_tags_;
+
+  // Decompressed contents of the compressed entries accessed so far. They
+  // are never modified or dropped once added, since callers hold on to
+  // pointers into them. Entries are looked up from several threads, hence
+  // the lock.
+  typedef std::map<uint16, std::string> DecompressedEntries;
+  mutable base::Lock decompressed_entries_lock_;
+  mutable DecompressedEntries decompressed_entries_;
+
   // Type of encoding for text resources.
   TextEncodingType text_encoding_type_;
 
@@ -147,4 +147,110 @@ TEST_P(DataPackTest, Write) {
   EXPECT_EQ(fifteen, data);
 }
 
+TEST_P(DataPackTest, WriteCompressed) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  base::FilePath file = dir.path().Append(FILE_PATH_LITERAL("data.pak"));
+
+  // Long repetitive data is compressed, short data is stored as is.
+  std::string empty;
+  std::string one("one");
+  std::string repeated(4096, 'x');
+  std::string text;
+  for (int i = 0; i < 100; ++i)
+    text.append("<div class=\"entry\">some localized text</div>\n");
+
+  std::map<uint16, base::StringPiece> resources;
+  resources.insert(std::make_pair(1, base::StringPiece(one)));
+  resources.insert(std::make_pair(2, base::StringPiece(empty)));
+  resources.insert(std::make_pair(3, base::StringPiece(repeated)));
+  resources.insert(std::make_pair(4, base::StringPiece(text)));
+  ASSERT_TRUE(DataPack::WriteCompressedPack(file, resources, GetParam()));
+
+  int64 file_size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(file, &file_size));
+  EXPECT_LT(file_size, static_cast<int64>(repeated.size() + text.size()));
+
+  DataPack pack(SCALE_FACTOR_100P);
+  ASSERT_TRUE(pack.LoadFromPath(file));
+  EXPECT_EQ(pack.GetTextEncodingType(), GetParam());
+
+  base::StringPiece data;
+  ASSERT_TRUE(pack.GetStringPiece(1, &data));
+  EXPECT_EQ(one, data);
+  ASSERT_TRUE(pack.GetStringPiece(2, &data));
+  EXPECT_EQ(0U, data.length());
+  ASSERT_TRUE(pack.GetStringPiece(3, &data));
+  EXPECT_EQ(repeated, data);
+  ASSERT_TRUE(pack.GetStringPiece(4, &data));
+  EXPECT_EQ(text, data);
+
+  // A second lookup returns the same decompressed copy.
+  base::StringPiece data_again;
+  ASSERT_TRUE(pack.GetStringPiece(4, &data_again));
+  EXPECT_EQ(data.data(), data_again.data());
+
+  ASSERT_FALSE(pack.HasResource(5));
+  ASSERT_FALSE(pack.GetStringPiece(5, &data));
+}
+
+TEST(DataPackTest, CompressedEntriesStayValid) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  base::FilePath file = dir.path().Append(FILE_PATH_LITERAL("data.pak"));
+
+  // Callers keep the data of an entry indefinitely, so reading other large
+  // entries must not free it.
+  std::string first(3 * 1024 * 1024, 'a');
+  std::string second(3 * 1024 * 1024, 'b');
+  std::map<uint16, base::StringPiece> resources;
+  resources.insert(std::make_pair(1, base::StringPiece(first)));
+  resources.insert(std::make_pair(2, base::StringPiece(second)));
+  ASSERT_TRUE(DataPack::WriteCompressedPack(file, resources,
+                                            DataPack::BINARY));
+
+  DataPack pack(SCALE_FACTOR_100P);
+  ASSERT_TRUE(pack.LoadFromPath(file));
+
+  base::StringPiece first_data;
+  ASSERT_TRUE(pack.GetStringPiece(1, &first_data));
+  base::StringPiece second_data;
+  ASSERT_TRUE(pack.GetStringPiece(2, &second_data));
+  EXPECT_TRUE(second_data == second);
+  EXPECT_TRUE(first_data == first);
+
+  base::StringPiece data;
+  ASSERT_TRUE(pack.GetStringPiece(1, &data));
+  EXPECT_EQ(first_data.data(), data.data());
+}
+
+TEST(DataPackTest, CompressedEntryWithBadLength) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  base::FilePath file = dir.path().Append(FILE_PATH_LITERAL("data.pak"));
+
+  std::string repeated(4096, 'x');
+  std::map<uint16, base::StringPiece> resources;
+  resources.insert(std::make_pair(1, base::StringPiece(repeated)));
+  ASSERT_TRUE(DataPack::WriteCompressedPack(file, resources,
+                                            DataPack::BINARY));
+
+  // Overwrite the uncompressed length that follows the entry's storage tag.
+  // The file holds a 9 byte header and two 6 byte index entries, the second
+  // of which is the end marker, so the entry data starts at byte 21.
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(file, &contents));
+  ASSERT_GT(contents.size(), 26U);
+  const size_t kLengthOffset = 9 + 2 * 6 + 1;
+  const uint32 bad_length = 0x7fffffff;
+  memcpy(&contents[kLengthOffset], &bad_length, sizeof(bad_length));
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            file_util::WriteFile(file, contents.data(), contents.size()));
+
+  DataPack pack(SCALE_FACTOR_100P);
+  ASSERT_TRUE(pack.LoadFromPath(file));
+  base::StringPiece data;
+  EXPECT_FALSE(pack.GetStringPiece(1, &data));
+}
+
 }  // namespace ui
@@ -204,6 +204,14 @@ class CompressDestroyer {
 bool JPEGCodec::Encode(const unsigned char* input, ColorFormat format,
                        int w, int h, int row_byte_width,
                        int quality, std::vector<unsigned char>* output) {
+  return EncodeWithSpeed(input, format, w, h, row_byte_width, quality,
+                         SPEED_DEFAULT, output);
+}
+
+bool JPEGCodec::EncodeWithSpeed(const unsigned char* input, ColorFormat format,
+                                int w, int h, int row_byte_width,
+                                int quality, EncodeSpeed speed,
+                                std::vector<unsigned char>* output) {
   jpeg_compress_struct cinfo;
   CompressDestroyer destroyer;
   destroyer.SetManagedObject(&cinfo);
@@ -267,6 +275,8 @@ bool JPEGCodec::Encode(const unsigned char* input, ColorFormat format,
 
   jpeg_set_defaults(&cinfo);
   jpeg_set_quality(&cinfo, quality, 1);  // quality here is 0-100
+  if (speed == SPEED_FAST)
+    cinfo.dct_method = JDCT_IFAST;
 
   // set up the destination manager
   jpeg_destination_mgr destmgr;
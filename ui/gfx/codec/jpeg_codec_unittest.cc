@@ -164,6 +164,31 @@ TEST(JPEGCodec, EncodeDecodeRGBA) {
   ASSERT_GE(jpeg_equality_threshold, AveragePixelDelta(original, decoded));
 }
 
+TEST(JPEGCodec, EncodeDecodeRGBWithFastSpeed) {
+  int w = 20, h = 20;
+
+  std::vector<unsigned char> original;
+  MakeRGBImage(w, h, &original);
+
+  std::vector<unsigned char> encoded;
+  EXPECT_TRUE(JPEGCodec::EncodeWithSpeed(&original[0], JPEGCodec::FORMAT_RGB,
+                                         w, h, w * 3, jpeg_quality,
+                                         JPEGCodec::SPEED_FAST, &encoded));
+  EXPECT_GT(original.size(), encoded.size());
+
+  std::vector<unsigned char> decoded;
+  int outw, outh;
+  EXPECT_TRUE(JPEGCodec::Decode(&encoded[0], encoded.size(),
+                                JPEGCodec::FORMAT_RGB, &decoded,
+                                &outw, &outh));
+  ASSERT_EQ(w, outw);
+  ASSERT_EQ(h, outh);
+  ASSERT_EQ(original.size(), decoded.size());
+
+  // The fast DCT stays within the same tolerance at this quality.
+  ASSERT_GE(jpeg_equality_threshold, AveragePixelDelta(original, decoded));
+}
+
 // Test that corrupted data decompression causes failures.
 TEST(JPEGCodec, DecodeCorrupted) {
   int w = 20, h = 20;
@@ -4,8 +4,13 @@
 
 #include "ui/gfx/codec/png_codec.h"
 
+#include "base/bind.h"
+#include "base/callback.h"
+#include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/string_util.h"
+#include "base/threading/worker_pool.h"
 #include "ui/gfx/size.h"
 #include "ui/gfx/skia_util.h"
 #include "third_party/libpng/png.h"
@@ -587,6 +592,10 @@ class CommentWriter {
 };
 #endif  // PNG_TEXT_SUPPORTED
 
+// Passed as the zlib strategy or row filter set to leave libpng's own choice
+// in place (Z_FILTERED and adaptive filtering for truecolor images).
+const int kLibpngDefault = -1;
+
 // The type of functions usable for converting between pixel formats.
 typedef void (*FormatConverter)(const unsigned char* in, int w,
                                 unsigned char* out, bool* is_opaque);
@@ -599,6 +608,7 @@ bool DoLibpngWrite(png_struct* png_ptr, png_info* info_ptr,
                    PngEncoderState* state,
                    int width, int height, int row_byte_width,
                    const unsigned char* input, int compression_level,
+                   int compression_strategy, int row_filters,
                    int png_output_color_type, int output_color_components,
                    FormatConverter converter,
                    const std::vector<PNGCodec::Comment>& comments) {
@@ -616,6 +626,10 @@ bool DoLibpngWrite(png_struct* png_ptr, png_info* info_ptr,
   }
 
   png_set_compression_level(png_ptr, compression_level);
+  if (compression_strategy != kLibpngDefault)
+    png_set_compression_strategy(png_ptr, compression_strategy);
+  if (row_filters != kLibpngDefault)
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, row_filters);
 
   // Set our callback for libpng to give us the data.
   png_set_write_fn(png_ptr, state, EncoderWriteCallback, FakeFlushCallback);
@@ -654,29 +668,15 @@ bool DoLibpngWrite(png_struct* png_ptr, png_info* info_ptr,
   return true;
 }
 
-}  // namespace
-
-// static
-bool PNGCodec::Encode(const unsigned char* input, ColorFormat format,
-                      const Size& size, int row_byte_width,
+bool EncodeWithParams(const unsigned char* input,
+                      PNGCodec::ColorFormat format, const Size& size,
+                      int row_byte_width,
                       bool discard_transparency,
-                      const std::vector<Comment>& comments,
+                      const std::vector<PNGCodec::Comment>& comments,
+                      int compression_level,
+                      int compression_strategy,
+                      int row_filters,
                       std::vector<unsigned char>* output) {
-  return PNGCodec::EncodeWithCompressionLevel(input, format, size,
-                                              row_byte_width,
-                                              discard_transparency,
-                                              comments, Z_DEFAULT_COMPRESSION,
-                                              output);
-}
-
-// static
-bool PNGCodec::EncodeWithCompressionLevel(const unsigned char* input,
-                                          ColorFormat format, const Size& size,
-                                          int row_byte_width,
-                                          bool discard_transparency,
-                                          const std::vector<Comment>& comments,
-                                          int compression_level,
-                                          std::vector<unsigned char>* output) {
   // Run to convert an input row into the output row format, NULL means no
   // conversion is necessary.
   FormatConverter converter = NULL;
@@ -684,13 +684,13 @@ bool PNGCodec::EncodeWithCompressionLevel(const unsigned char* input,
   int input_color_components, output_color_components;
   int png_output_color_type;
   switch (format) {
-    case FORMAT_RGB:
+    case PNGCodec::FORMAT_RGB:
       input_color_components = 3;
       output_color_components = 3;
       png_output_color_type = PNG_COLOR_TYPE_RGB;
       break;
 
-    case FORMAT_RGBA:
+    case PNGCodec::FORMAT_RGBA:
       input_color_components = 4;
       if (discard_transparency) {
         output_color_components = 3;
@@ -703,7 +703,7 @@ bool PNGCodec::EncodeWithCompressionLevel(const unsigned char* input,
       }
       break;
 
-    case FORMAT_BGRA:
+    case PNGCodec::FORMAT_BGRA:
       input_color_components = 4;
       if (discard_transparency) {
         output_color_components = 3;
@@ -716,7 +716,7 @@ bool PNGCodec::EncodeWithCompressionLevel(const unsigned char* input,
       }
       break;
 
-    case FORMAT_SkBitmap:
+    case PNGCodec::FORMAT_SkBitmap:
       input_color_components = 4;
       if (discard_transparency) {
         output_color_components = 3;
@@ -752,12 +752,64 @@ bool PNGCodec::EncodeWithCompressionLevel(const unsigned char* input,
   PngEncoderState state(output);
   bool success = DoLibpngWrite(png_ptr, info_ptr, &state,
                                size.width(), size.height(), row_byte_width,
-                               input, compression_level, png_output_color_type,
+                               input, compression_level, compression_strategy,
+                               row_filters, png_output_color_type,
                                output_color_components, converter, comments);
 
   return success;
 }
 
+}  // namespace
+
+// static
+bool PNGCodec::Encode(const unsigned char* input, ColorFormat format,
+                      const Size& size, int row_byte_width,
+                      bool discard_transparency,
+                      const std::vector<Comment>& comments,
+                      std::vector<unsigned char>* output) {
+  return PNGCodec::EncodeWithCompressionLevel(input, format, size,
+                                              row_byte_width,
+                                              discard_transparency,
+                                              comments, Z_DEFAULT_COMPRESSION,
+                                              output);
+}
+
+// static
+bool PNGCodec::EncodeWithCompressionLevel(const unsigned char* input,
+                                          ColorFormat format, const Size& size,
+                                          int row_byte_width,
+                                          bool discard_transparency,
+                                          const std::vector<Comment>& comments,
+                                          int compression_level,
+                                          std::vector<unsigned char>* output) {
+  return EncodeWithParams(input, format, size, row_byte_width,
+                          discard_transparency, comments, compression_level,
+                          kLibpngDefault, kLibpngDefault, output);
+}
+
+// static
+bool PNGCodec::EncodeWithSpeed(const unsigned char* input,
+                               ColorFormat format, const Size& size,
+                               int row_byte_width,
+                               bool discard_transparency,
+                               const std::vector<Comment>& comments,
+                               EncodeSpeed speed,
+                               std::vector<unsigned char>* output) {
+  if (speed == SPEED_DEFAULT) {
+    return EncodeWithCompressionLevel(input, format, size, row_byte_width,
+                                      discard_transparency, comments,
+                                      Z_DEFAULT_COMPRESSION, output);
+  }
+
+  // The SUB filter only looks at the pixel to the left, so it is nearly free
+  // to compute and turns the flat regions and gradients common in UI
+  // screenshots into long runs of identical bytes, which Z_RLE matches
+  // without searching its hash chains.
+  return EncodeWithParams(input, format, size, row_byte_width,
+                          discard_transparency, comments, Z_BEST_SPEED,
+                          Z_RLE, PNG_FILTER_SUB, output);
+}
+
 // static
 bool PNGCodec::EncodeBGRASkBitmap(const SkBitmap& input,
                                   bool discard_transparency,
@@ -775,6 +827,93 @@ bool PNGCodec::EncodeBGRASkBitmap(const SkBitmap& input,
                 std::vector<Comment>(), output);
 }
 
+// static
+bool PNGCodec::EncodeBGRASkBitmapWithSpeed(const SkBitmap& input,
+                                           bool discard_transparency,
+                                           EncodeSpeed speed,
+                                           std::vector<unsigned char>* output) {
+  static const int bbp = 4;
+
+  SkAutoLockPixels lock_input(input);
+  if (input.empty())
+    return false;
+  DCHECK(input.bytesPerPixel() == bbp);
+
+  return EncodeWithSpeed(
+      reinterpret_cast<unsigned char*>(input.getAddr32(0, 0)),
+      FORMAT_SkBitmap, Size(input.width(), input.height()),
+      input.rowBytes(), discard_transparency, std::vector<Comment>(), speed,
+      output);
+}
+
+namespace {
+
+// Collects the outputs of one EncodeBGRASkBitmapsInParallel call. Each worker
+// task writes only its own slot of |results_|, which is sized up front, and
+// the replies all run on the calling thread, so no lock is needed.
+class ParallelEncodeState
+    : public base::RefCountedThreadSafe<ParallelEncodeState> {
+ public:
+  ParallelEncodeState(size_t count,
+                      const PNGCodec::EncodedImagesCallback& callback)
+      : results_(count),
+        pending_(count),
+        callback_(callback) {
+  }
+
+  void Encode(const SkBitmap& input,
+              bool discard_transparency,
+              PNGCodec::EncodeSpeed speed,
+              size_t index) {
+    std::vector<unsigned char>* output = &results_[index];
+    if (!PNGCodec::EncodeBGRASkBitmapWithSpeed(input, discard_transparency,
+                                               speed, output)) {
+      output->clear();
+    }
+  }
+
+  void OnEncoded() {
+    DCHECK_GT(pending_, 0u);
+    if (--pending_ == 0)
+      callback_.Run(results_);
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ParallelEncodeState>;
+  ~ParallelEncodeState() {}
+
+  PNGCodec::EncodedImages results_;
+  size_t pending_;
+  PNGCodec::EncodedImagesCallback callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelEncodeState);
+};
+
+}  // namespace
+
+// static
+void PNGCodec::EncodeBGRASkBitmapsInParallel(
+    const std::vector<SkBitmap>& inputs,
+    bool discard_transparency,
+    EncodeSpeed speed,
+    const EncodedImagesCallback& callback) {
+  if (inputs.empty()) {
+    callback.Run(EncodedImages());
+    return;
+  }
+
+  scoped_refptr<ParallelEncodeState> state(
+      new ParallelEncodeState(inputs.size(), callback));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    base::WorkerPool::PostTaskAndReply(
+        FROM_HERE,
+        base::Bind(&ParallelEncodeState::Encode, state, inputs[i],
+                   discard_transparency, speed, i),
+        base::Bind(&ParallelEncodeState::OnEncoded, state),
+        true /* task_is_slow */);
+  }
+}
+
 PNGCodec::Comment::Comment(const std::string& k, const std::string& t)
     : key(k), text(t) {
 }
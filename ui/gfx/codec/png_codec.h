@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/callback_forward.h"
 #include "ui/base/ui_export.h"
 
 class SkBitmap;
@@ -51,6 +52,19 @@ class UI_EXPORT PNGCodec {
     std::string text;
   };
 
+  // Trade-off between encode time and output size.
+  enum EncodeSpeed {
+    // zlib's default level and libpng's adaptive per-row filter selection.
+    // Produces the smallest files.
+    SPEED_DEFAULT,
+
+    // Fastest zlib level with run-length matching and a single cheap row
+    // filter. Output is somewhat larger but encodes several times faster,
+    // which suits transient images such as screenshots, thumbnails and
+    // clipboard exports.
+    SPEED_FAST
+  };
+
   // Calls PNGCodec::EncodeWithCompressionLevel with the default compression
   // level.
   static bool Encode(const unsigned char* input,
@@ -89,6 +103,17 @@ class UI_EXPORT PNGCodec {
                                          int compression_level,
                                          std::vector<unsigned char>* output);
 
+  // Like EncodeWithCompressionLevel, but picks the zlib level, strategy and
+  // row filters from |speed| instead of taking an explicit level.
+  static bool EncodeWithSpeed(const unsigned char* input,
+                              ColorFormat format,
+                              const Size& size,
+                              int row_byte_width,
+                              bool discard_transparency,
+                              const std::vector<Comment>& comments,
+                              EncodeSpeed speed,
+                              std::vector<unsigned char>* output);
+
   // Call PNGCodec::Encode on the supplied SkBitmap |input|, which is assumed
   // to be BGRA, 32 bits per pixel. The params |discard_transparency| and
   // |output| are passed directly to Encode; refer to Encode for more
@@ -97,6 +122,28 @@ class UI_EXPORT PNGCodec {
                                  bool discard_transparency,
                                  std::vector<unsigned char>* output);
 
+  // Same as EncodeBGRASkBitmap, but encodes with the given |speed|.
+  static bool EncodeBGRASkBitmapWithSpeed(const SkBitmap& input,
+                                          bool discard_transparency,
+                                          EncodeSpeed speed,
+                                          std::vector<unsigned char>* output);
+
+  // Results of EncodeBGRASkBitmapsInParallel, one entry per input bitmap in
+  // input order. An entry is empty if that bitmap failed to encode.
+  typedef std::vector<std::vector<unsigned char> > EncodedImages;
+  typedef base::Callback<void(const EncodedImages&)> EncodedImagesCallback;
+
+  // Encodes each of |inputs| with EncodeBGRASkBitmapWithSpeed on its own
+  // base::WorkerPool task, so independent images (e.g. a batch of
+  // thumbnails) encode concurrently. |callback| runs on the calling thread,
+  // which must have a MessageLoop, once every image is done. The bitmaps'
+  // pixels must not be modified until then.
+  static void EncodeBGRASkBitmapsInParallel(
+      const std::vector<SkBitmap>& inputs,
+      bool discard_transparency,
+      EncodeSpeed speed,
+      const EncodedImagesCallback& callback);
+
   // Decodes the PNG data contained in input of length input_size. The
   // decoded data will be placed in *output with the dimensions in *w and *h
   // on success (returns true). This data will be written in the 'format'
@@ -5,13 +5,20 @@
 #include <algorithm>
 #include <cmath>
 
+#include "base/bind.h"
+#include "base/command_line.h"
 #include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/run_loop.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "third_party/libpng/png.h"
 #include "third_party/skia/include/core/SkBitmap.h"
 #include "third_party/skia/include/core/SkColorPriv.h"
 #include "third_party/skia/include/core/SkUnPreMultiply.h"
 #include "third_party/zlib/zlib.h"
+#include "ui/gfx/codec/jpeg_codec.h"
 #include "ui/gfx/codec/png_codec.h"
 #include "ui/gfx/size.h"
 
@@ -19,6 +26,10 @@ namespace gfx {
 
 namespace {
 
+// Command line switch for the number of encodes per image in the encode
+// benchmark.
+const char kBenchmarkIterations[] = "codec-benchmark-iterations";
+
 void MakeRGBImage(int w, int h, std::vector<unsigned char>* data) {
   data->resize(w * h * 3);
   for (int y = 0; y < h; y++) {
@@ -1116,5 +1127,155 @@ TEST(PNGCodec, EncodeDecodeWithVaryingCompressionLevels) {
   ASSERT_TRUE(original == decoded);
 }
 
+TEST(PNGCodec, EncodeDecodeWithFastSpeed) {
+  const int w = 64, h = 48;
+
+  std::vector<unsigned char> original;
+  MakeRGBAImage(w, h, true, &original);
+
+  std::vector<unsigned char> encoded_fast;
+  EXPECT_TRUE(PNGCodec::EncodeWithSpeed(
+        &original[0], PNGCodec::FORMAT_RGBA, Size(w, h), w * 4, false,
+        std::vector<PNGCodec::Comment>(), PNGCodec::SPEED_FAST,
+        &encoded_fast));
+
+  std::vector<unsigned char> encoded_default;
+  EXPECT_TRUE(PNGCodec::EncodeWithSpeed(
+        &original[0], PNGCodec::FORMAT_RGBA, Size(w, h), w * 4, false,
+        std::vector<PNGCodec::Comment>(), PNGCodec::SPEED_DEFAULT,
+        &encoded_default));
+
+  // The default speed must match the plain Encode() output.
+  std::vector<unsigned char> encoded_plain;
+  EXPECT_TRUE(PNGCodec::Encode(
+        &original[0], PNGCodec::FORMAT_RGBA, Size(w, h), w * 4, false,
+        std::vector<PNGCodec::Comment>(), &encoded_plain));
+  EXPECT_TRUE(encoded_default == encoded_plain);
+
+  // The fast encoding is lossless.
+  std::vector<unsigned char> decoded;
+  int outw, outh;
+  EXPECT_TRUE(PNGCodec::Decode(&encoded_fast[0], encoded_fast.size(),
+                               PNGCodec::FORMAT_RGBA, &decoded,
+                               &outw, &outh));
+  ASSERT_EQ(w, outw);
+  ASSERT_EQ(h, outh);
+  ASSERT_TRUE(original == decoded);
+}
+
+TEST(PNGCodec, EncodeBGRASkBitmapWithFastSpeed) {
+  const int w = 20, h = 20;
+
+  SkBitmap original_bitmap;
+  MakeTestSkBitmap(w, h, &original_bitmap);
+
+  std::vector<unsigned char> encoded;
+  EXPECT_TRUE(PNGCodec::EncodeBGRASkBitmapWithSpeed(
+      original_bitmap, false, PNGCodec::SPEED_FAST, &encoded));
+
+  SkBitmap decoded_bitmap;
+  EXPECT_TRUE(PNGCodec::Decode(&encoded.front(), encoded.size(),
+                               &decoded_bitmap));
+
+  for (int x = 0; x < w; x++) {
+    for (int y = 0; y < h; y++) {
+      uint32_t original_pixel = original_bitmap.getAddr32(0, y)[x];
+      uint32_t decoded_pixel = decoded_bitmap.getAddr32(0, y)[x];
+      EXPECT_TRUE(ColorsClose(original_pixel, decoded_pixel));
+    }
+  }
+}
+
+void SaveEncodedImages(PNGCodec::EncodedImages* out,
+                       const base::Closure& quit_closure,
+                       const PNGCodec::EncodedImages& results) {
+  *out = results;
+  quit_closure.Run();
+}
+
+TEST(PNGCodec, EncodeBGRASkBitmapsInParallel) {
+  MessageLoop message_loop;
+
+  std::vector<SkBitmap> bitmaps(4);
+  for (size_t i = 0; i < bitmaps.size(); ++i)
+    MakeTestSkBitmap(16 + i * 8, 16, &bitmaps[i]);
+
+  PNGCodec::EncodedImages results;
+  base::RunLoop run_loop;
+  PNGCodec::EncodeBGRASkBitmapsInParallel(
+      bitmaps, false, PNGCodec::SPEED_FAST,
+      base::Bind(&SaveEncodedImages, &results, run_loop.QuitClosure()));
+  run_loop.Run();
+
+  // The results come back in input order and match a serial encode.
+  ASSERT_EQ(bitmaps.size(), results.size());
+  for (size_t i = 0; i < bitmaps.size(); ++i) {
+    std::vector<unsigned char> expected;
+    EXPECT_TRUE(PNGCodec::EncodeBGRASkBitmapWithSpeed(
+        bitmaps[i], false, PNGCodec::SPEED_FAST, &expected));
+    EXPECT_TRUE(expected == results[i]);
+  }
+}
+
+// Reports encode time and output size for PNG and JPEG at each speed over a
+// thumbnail-sized and a screenshot-sized image. Disabled by default; run
+// with --gtest_also_run_disabled_tests --codec-benchmark-iterations=N.
+TEST(PNGCodec, DISABLED_EncodeBenchmark) {
+  int iterations = 1;
+  std::string iterations_string(
+      CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          kBenchmarkIterations));
+  if (!iterations_string.empty())
+    base::StringToInt(iterations_string, &iterations);
+  iterations = std::max(iterations, 1);
+
+  static const struct {
+    const char* name;
+    int width;
+    int height;
+  } kImages[] = {
+    { "thumbnail", 212, 132 },
+    { "screenshot", 1280, 800 },
+  };
+
+  printf("Benchmarking %d iterations:\n", iterations);
+  for (size_t i = 0; i < arraysize(kImages); ++i) {
+    SkBitmap bitmap;
+    MakeTestSkBitmap(kImages[i].width, kImages[i].height, &bitmap);
+    SkAutoLockPixels lock(bitmap);
+    const unsigned char* pixels =
+        reinterpret_cast<const unsigned char*>(bitmap.getAddr32(0, 0));
+
+    for (int fast = 0; fast < 2; ++fast) {
+      std::vector<unsigned char> encoded;
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      for (int j = 0; j < iterations; ++j) {
+        ASSERT_TRUE(PNGCodec::EncodeBGRASkBitmapWithSpeed(
+            bitmap, false,
+            fast ? PNGCodec::SPEED_FAST : PNGCodec::SPEED_DEFAULT, &encoded));
+      }
+      double elapsed_ms =
+          (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+      printf("PNG  %-10s %-7s %8.2fms/encode %8lu bytes\n",
+             kImages[i].name, fast ? "fast" : "default",
+             elapsed_ms / iterations,
+             static_cast<unsigned long>(encoded.size()));
+
+      start = base::TimeTicks::HighResNow();
+      for (int j = 0; j < iterations; ++j) {
+        ASSERT_TRUE(JPEGCodec::EncodeWithSpeed(
+            pixels, JPEGCodec::FORMAT_SkBitmap, bitmap.width(),
+            bitmap.height(), static_cast<int>(bitmap.rowBytes()), 90,
+            fast ? JPEGCodec::SPEED_FAST : JPEGCodec::SPEED_DEFAULT,
+            &encoded));
+      }
+      elapsed_ms = (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+      printf("JPEG %-10s %-7s %8.2fms/encode %8lu bytes\n",
+             kImages[i].name, fast ? "fast" : "default",
+             elapsed_ms / iterations,
+             static_cast<unsigned long>(encoded.size()));
+    }
+  }
+}
 
 }  // namespace gfx
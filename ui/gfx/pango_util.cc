@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "base/logging.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "ui/gfx/canvas.h"
 #include "ui/gfx/font.h"
@@ -143,6 +144,17 @@ double GetPangoResolution() {
   return resolution;
 }
 
+std::string GetPangoFontSettingsKey() {
+  // A new fontconfig configuration is created when the font configuration is
+  // reloaded, and toolkits install a new default font map when theirs change.
+  return base::StringPrintf(
+      "%lu|%f|%p|%p",
+      cairo_font_options_hash(GetCairoFontOptions()),
+      GetPangoResolution(),
+      static_cast<void*>(pango_cairo_font_map_get_default()),
+      static_cast<void*>(FcConfigGetCurrent()));
+}
+
 void DrawTextOntoCairoSurface(cairo_t* cr,
                               const string16& text,
                               const gfx::Font& font,
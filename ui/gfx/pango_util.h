@@ -30,6 +30,11 @@ PangoContext* GetPangoContext();
 // resolution hasn't been set.
 double GetPangoResolution();
 
+// Returns a string that changes whenever the font options, the resolution or
+// the font configuration used by SetupPangoLayout() do. Layouts that were set
+// up under a different value may use stale fonts or metrics.
+std::string GetPangoFontSettingsKey();
+
 // Utility class to ensure that PangoFontDescription is freed.
 class ScopedPangoFontDescription {
  public:
@@ -9,8 +9,12 @@
 #include <string>
 #include <vector>
 
+#include "base/containers/mru_cache.h"
 #include "base/i18n/break_iterator.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/threading/thread_checker.h"
 #include "third_party/skia/include/core/SkTypeface.h"
 #include "ui/base/text/utf16_indexing.h"
 #include "ui/gfx/canvas.h"
@@ -61,6 +65,68 @@ void SetPangoUnderlineMetrics(PangoFontDescription *desc,
                                 PANGO_PIXELS(position));
 }
 
+// Maximum number of laid out strings kept by LayoutCache. Tab strips, menus
+// and the omnibox popup together show a few hundred strings at most.
+const size_t kMaxCachedLayouts = 256;
+
+// Releases the reference LayoutCache holds on an evicted layout.
+class LayoutUnrefDeletor {
+ public:
+  void operator()(PangoLayout* layout) {
+    g_object_unref(layout);
+  }
+};
+
+// Itemizing, shaping and line breaking a string is the expensive part of
+// RenderTextLinux, and list-heavy UIs create many RenderText instances that
+// lay out the same strings with the same fonts. Finished layouts are never
+// modified afterwards (colors, selection and composition are applied while
+// drawing), so they can be shared between instances. Pango layouts are not
+// thread-safe, so the cache is bound to the first thread that uses it (the UI
+// thread).
+class LayoutCache {
+ public:
+  LayoutCache() : cache_(kMaxCachedLayouts) {}
+
+  // Returns a new reference to the layout stored under |key|, or NULL.
+  PangoLayout* Get(const std::string& key) {
+    DCHECK(thread_checker_.CalledOnValidThread());
+    Cache::iterator it = cache_.Get(key);
+    if (it == cache_.end())
+      return NULL;
+    g_object_ref(it->second);
+    return it->second;
+  }
+
+  // Stores |layout| under |key|, taking a new reference to it.
+  void Put(const std::string& key, PangoLayout* layout) {
+    DCHECK(thread_checker_.CalledOnValidThread());
+    g_object_ref(layout);
+    cache_.Put(key, layout);
+  }
+
+ private:
+  typedef base::MRUCacheBase<std::string, PangoLayout*, LayoutUnrefDeletor>
+      Cache;
+  Cache cache_;
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(LayoutCache);
+};
+
+base::LazyInstance<LayoutCache>::Leaky g_layout_cache =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Appends the breaks of |style| to |key|.
+void AppendStyleBreaksToKey(const BreakList<bool>& style, std::string* key) {
+  for (BreakList<bool>::const_iterator it = style.breaks().begin();
+       it != style.breaks().end(); ++it) {
+    key->append(base::Uint64ToString(it->first));
+    key->push_back(it->second ? '+' : '-');
+  }
+  key->push_back('|');
+}
+
 }  // namespace
 
 // TODO(xji): index saved in upper layer is utf16 index. Pango uses utf8 index.
@@ -286,6 +352,17 @@ void RenderTextLinux::ResetLayout() {
 
 void RenderTextLinux::EnsureLayout() {
   if (layout_ == NULL) {
+    const std::string cache_key = GetLayoutCacheKey();
+    layout_ = g_layout_cache.Get().Get(cache_key);
+    if (layout_) {
+      layout_text_ = pango_layout_get_text(layout_);
+      layout_text_len_ = strlen(layout_text_);
+      current_line_ = pango_layout_get_line_readonly(layout_, 0);
+      pango_layout_line_ref(current_line_);
+      pango_layout_get_log_attrs(layout_, &log_attrs_, &num_log_attrs_);
+      return;
+    }
+
     cairo_surface_t* surface =
         cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 0, 0);
     cairo_t* cr = cairo_create(surface);
@@ -319,9 +396,32 @@ void RenderTextLinux::EnsureLayout() {
     pango_layout_line_ref(current_line_);
 
     pango_layout_get_log_attrs(layout_, &log_attrs_, &num_log_attrs_);
+
+    g_layout_cache.Get().Put(cache_key, layout_);
   }
 }
 
+std::string RenderTextLinux::GetLayoutCacheKey() {
+  // Everything that EnsureLayout() feeds into Pango must be part of the key,
+  // including the font settings, which can change while the process runs.
+  // The text may contain any character, including the separators, so it is
+  // prefixed with its length to keep the key unambiguous.
+  const string16& text = GetLayoutText();
+  std::string key(GetPangoFontSettingsKey());
+  key.push_back('|');
+  key.append(base::Uint64ToString(text.size()));
+  key.push_back(':');
+  key.append(reinterpret_cast<const char*>(text.data()),
+             text.size() * sizeof(char16));
+  key.append(font_list().GetFontDescriptionString());
+  key.push_back('\0');
+  key.append(base::IntToString(GetTextDirection()));
+  key.push_back('|');
+  AppendStyleBreaksToKey(styles()[BOLD], &key);
+  AppendStyleBreaksToKey(styles()[ITALIC], &key);
+  return key;
+}
+
 void RenderTextLinux::SetupPangoAttributes(PangoLayout* layout) {
   PangoAttrList* attrs = pango_attr_list_new();
 
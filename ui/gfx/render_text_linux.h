@@ -6,6 +6,7 @@
 #define UI_GFX_RENDER_TEXT_LINUX_H_
 
 #include <pango/pango.h>
+#include <string>
 #include <vector>
 
 #include "ui/gfx/render_text.h"
@@ -47,6 +48,7 @@ class RenderTextLinux : public RenderText {
  private:
   friend class RenderTextTest;
   FRIEND_TEST_ALL_PREFIXES(RenderTextTest, PangoAttributes);
+  FRIEND_TEST_ALL_PREFIXES(RenderTextTest, PangoLayoutCache);
 
   // Returns the run that contains the character attached to the caret in the
   // given selection model. Return NULL if not found.
@@ -58,6 +60,10 @@ class RenderTextLinux : public RenderText {
   SelectionModel FirstSelectionModelInsideRun(const PangoItem* run);
   SelectionModel LastSelectionModelInsideRun(const PangoItem* run);
 
+  // Returns the key identifying this instance's layout in the process-wide
+  // cache of laid out strings shared by all RenderTextLinux instances.
+  std::string GetLayoutCacheKey();
+
   // Setup pango attribute: foreground, background, font, strike.
   void SetupPangoAttributes(PangoLayout* layout);
 
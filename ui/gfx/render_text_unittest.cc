@@ -4,7 +4,11 @@
 
 #include "ui/gfx/render_text.h"
 
+#include "base/command_line.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "ui/gfx/break_list.h"
@@ -34,6 +38,10 @@ const wchar_t kRtl[] =       L"\x5d0\x5d1\x5d2";
 const wchar_t kRtlLtr[] =    L"\x5d0\x5d1"L"a";
 const wchar_t kRtlLtrRtl[] = L"\x5d0"L"a"L"\x5d1";
 
+// Command line switch for the number of strings in the layout benchmark.
+const char kBenchmarkStrings[] = "render-text-benchmark-strings";
+const int kDefaultBenchmarkStrings = 200;
+
 // Checks whether |range| contains |index|. This is not the same as calling
 // |range.Contains(ui::Range(index))| - as that would return true when
 // |index| == |range.end()|.
@@ -202,6 +210,82 @@ TEST_F(RenderTextTest, PangoAttributes) {
   EXPECT_FALSE(pango_attr_iterator_next(iter));
   pango_attr_iterator_destroy(iter);
 }
+
+TEST_F(RenderTextTest, PangoLayoutCache) {
+  scoped_ptr<RenderText> render_text1(RenderText::CreateInstance());
+  scoped_ptr<RenderText> render_text2(RenderText::CreateInstance());
+  render_text1->SetText(ASCIIToUTF16("layout cache"));
+  render_text2->SetText(ASCIIToUTF16("layout cache"));
+
+  // Identical text, fonts and styles share a single Pango layout.
+  RenderTextLinux* rt_linux1 =
+      static_cast<RenderTextLinux*>(render_text1.get());
+  RenderTextLinux* rt_linux2 =
+      static_cast<RenderTextLinux*>(render_text2.get());
+  rt_linux1->EnsureLayout();
+  rt_linux2->EnsureLayout();
+  EXPECT_EQ(rt_linux1->layout_, rt_linux2->layout_);
+  EXPECT_EQ(render_text1->GetStringSize(), render_text2->GetStringSize());
+
+  // A style change is part of the key and must not reuse the plain layout.
+  render_text2->ApplyStyle(BOLD, true, ui::Range(0, 6));
+  rt_linux2->EnsureLayout();
+  EXPECT_NE(rt_linux1->layout_, rt_linux2->layout_);
+
+  // Neither does different text.
+  render_text2->SetText(ASCIIToUTF16("layout cachf"));
+  render_text2->SetStyle(BOLD, false);
+  rt_linux2->EnsureLayout();
+  EXPECT_NE(rt_linux1->layout_, rt_linux2->layout_);
+
+  // The cached layout outlives the instance that created it.
+  PangoLayout* shared_layout = rt_linux1->layout_;
+  render_text1.reset();
+  render_text2->SetText(ASCIIToUTF16("layout cache"));
+  rt_linux2->EnsureLayout();
+  EXPECT_EQ(shared_layout, rt_linux2->layout_);
+}
+
+// Measures laying out a list of strings the way a menu or the omnibox popup
+// does: fresh RenderText instances for each showing of the same items. The
+// first pass shapes every string, later ones find them in the layout cache.
+// Disabled by default; run with
+// --gtest_also_run_disabled_tests --render-text-benchmark-strings=N.
+TEST_F(RenderTextTest, DISABLED_PangoLayoutBenchmark) {
+  int string_count = kDefaultBenchmarkStrings;
+  std::string strings_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkStrings));
+  base::StringToInt(strings_switch, &string_count);
+  if (string_count < 1)
+    string_count = kDefaultBenchmarkStrings;
+
+  // Make the strings unique to this run so that the first pass is cold.
+  const std::string run_prefix = base::Int64ToString(
+      base::TimeTicks::HighResNow().ToInternalValue());
+  std::vector<string16> strings;
+  for (int i = 0; i < string_count; ++i) {
+    strings.push_back(ASCIIToUTF16(base::StringPrintf(
+        "%s Bookmark item %d - Example page title", run_prefix.c_str(), i)));
+  }
+
+  printf("Benchmarking layout of %d strings:\n", string_count);
+  const int kPasses = 5;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    int total_width = 0;
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (int i = 0; i < string_count; ++i) {
+      scoped_ptr<RenderText> render_text(RenderText::CreateInstance());
+      render_text->SetText(strings[i]);
+      total_width += render_text->GetStringSize().width();
+    }
+    const double elapsed_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+    EXPECT_GT(total_width, 0);
+    printf("  pass %d (%s): %.2f ms, %.1f us per string\n", pass,
+           pass == 0 ? "cold" : "cached", elapsed_ms,
+           elapsed_ms * 1000 / string_count);
+  }
+}
 #endif
 
 // TODO(asvitkine): Cursor movements tests disabled on Mac because RenderTextMac
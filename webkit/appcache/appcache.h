@@ -7,6 +7,7 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "base/gtest_prod_util.h"
@@ -31,6 +32,7 @@ class WEBKIT_STORAGE_EXPORT AppCache : public base::RefCounted<AppCache> {
  public:
   typedef std::map<GURL, AppCacheEntry> EntryMap;
   typedef std::set<AppCacheHost*> AppCacheHosts;
+  typedef std::map<int64, std::string> ResponseHashMap;
 
   AppCache(AppCacheStorage* storage, int64 cache_id);
 
@@ -58,6 +60,14 @@ class WEBKIT_STORAGE_EXPORT AppCache : public base::RefCounted<AppCache> {
 
   const EntryMap& entries() const { return entries_; }
 
+  // Hashes of the responses written for this cache by an update, keyed by
+  // response id. Storage uses them to share identical responses.
+  void AddResponseHash(int64 response_id, const std::string& hash) {
+    response_hashes_[response_id] = hash;
+  }
+  const ResponseHashMap& response_hashes() const { return response_hashes_; }
+  void ClearResponseHashes() { response_hashes_.clear(); }
+
   // Returns the URL of the resource used as entry for 'namespace_url'.
   GURL GetFallbackEntryUrl(const GURL& namespace_url) const {
     return GetNamespaceEntryUrl(fallback_namespaces_, namespace_url);
@@ -157,6 +167,7 @@ class WEBKIT_STORAGE_EXPORT AppCache : public base::RefCounted<AppCache> {
   AppCacheHosts associated_hosts_;
 
   EntryMap entries_;    // contains entries of all types
+  ResponseHashMap response_hashes_;
 
   NamespaceVector intercept_namespaces_;
   NamespaceVector fallback_namespaces_;
@@ -18,8 +18,8 @@
 // Schema -------------------------------------------------------------------
 namespace {
 
-const int kCurrentVersion = 4;
-const int kCompatibleVersion = 4;
+const int kCurrentVersion = 5;
+const int kCompatibleVersion = 5;
 
 const char kGroupsTable[] = "Groups";
 const char kCachesTable[] = "Caches";
@@ -27,6 +27,7 @@ const char kEntriesTable[] = "Entries";
 const char kNamespacesTable[] = "Namespaces";
 const char kOnlineWhiteListsTable[] = "OnlineWhiteLists";
 const char kDeletableResponseIdsTable[] = "DeletableResponseIds";
+const char kResponseHashesTable[] = "ResponseHashes";
 
 struct TableInfo {
   const char* table_name;
@@ -75,6 +76,12 @@ const TableInfo kTables[] = {
 
   { kDeletableResponseIdsTable,
     "(response_id INTEGER NOT NULL)" },
+
+  { kResponseHashesTable,
+    "(response_id INTEGER PRIMARY KEY,"
+    " origin TEXT,"
+    " response_hash TEXT,"
+    " response_size INTEGER)" },
 };
 
 const IndexInfo kIndexes[] = {
@@ -103,10 +110,11 @@ const IndexInfo kIndexes[] = {
     "(cache_id, url)",
     true },
 
+  // Not unique, entries of different caches may share a response.
   { "EntriesResponseIdIndex",
     kEntriesTable,
     "(response_id)",
-    true },
+    false },
 
   { "NamespacesCacheIndex",
     kNamespacesTable,
@@ -132,6 +140,11 @@ const IndexInfo kIndexes[] = {
     kDeletableResponseIdsTable,
     "(response_id)",
     true },
+
+  { "ResponseHashesOriginIndex",
+    kResponseHashesTable,
+    "(origin, response_hash)",
+    false },
 };
 
 const int kTableCount = ARRAYSIZE_UNSAFE(kTables);
@@ -814,7 +827,38 @@ bool AppCacheDatabase::InsertDeletableResponseIds(
     const std::vector<int64>& response_ids) {
   const char* kSql =
       "INSERT INTO DeletableResponseIds (response_id) VALUES (?)";
-  return RunCachedStatementWithIds(SQL_FROM_HERE, kSql, response_ids);
+  // Responses on their way out must not be shared by new entries.
+  const char* kHashesSql =
+      "DELETE FROM ResponseHashes WHERE response_id = ?";
+  return RunCachedStatementWithIds(SQL_FROM_HERE, kSql, response_ids) &&
+         RunCachedStatementWithIds(SQL_FROM_HERE, kHashesSql, response_ids);
+}
+
+bool AppCacheDatabase::RemoveResponseIdsInUse(
+    std::vector<int64>* response_ids) {
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql =
+      "SELECT 1 FROM Entries WHERE response_id = ? LIMIT 1";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+
+  std::vector<int64> unused_ids;
+  std::vector<int64>::const_iterator iter = response_ids->begin();
+  while (iter != response_ids->end()) {
+    statement.BindInt64(0, *iter);
+    bool in_use = statement.Step();
+    if (!statement.Succeeded())
+      return false;
+    if (!in_use)
+      unused_ids.push_back(*iter);
+    statement.Reset(true);
+    ++iter;
+  }
+
+  response_ids->swap(unused_ids);
+  return true;
 }
 
 bool AppCacheDatabase::DeleteDeletableResponseIds(
@@ -824,6 +868,50 @@ bool AppCacheDatabase::DeleteDeletableResponseIds(
   return RunCachedStatementWithIds(SQL_FROM_HERE, kSql, response_ids);
 }
 
+bool AppCacheDatabase::FindResponseWithHash(
+    const GURL& origin, const std::string& response_hash,
+    int64 response_size, int64* response_id) {
+  DCHECK(response_id);
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql =
+      "SELECT response_id FROM ResponseHashes"
+      "  WHERE origin = ? AND response_hash = ? AND response_size = ?"
+      "  LIMIT 1";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindString(0, origin.spec());
+  statement.BindString(1, response_hash);
+  statement.BindInt64(2, response_size);
+
+  if (!statement.Step())
+    return false;
+
+  *response_id = statement.ColumnInt64(0);
+  return true;
+}
+
+bool AppCacheDatabase::InsertResponseHash(
+    int64 response_id, const GURL& origin,
+    const std::string& response_hash, int64 response_size) {
+  if (!LazyOpen(true))
+    return false;
+
+  const char* kSql =
+      "INSERT OR REPLACE INTO ResponseHashes"
+      "  (response_id, origin, response_hash, response_size)"
+      "  VALUES(?, ?, ?, ?)";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindInt64(0, response_id);
+  statement.BindString(1, origin.spec());
+  statement.BindString(2, response_hash);
+  statement.BindInt64(3, response_size);
+
+  return statement.Run();
+}
+
 bool AppCacheDatabase::RunCachedStatementWithIds(
     const sql::StatementID& statement_id, const char* sql,
     const std::vector<int64>& ids) {
@@ -1082,6 +1170,28 @@ bool AppCacheDatabase::UpgradeSchema() {
     // Finally bump the version numbers and commit it.
     meta_table_->SetVersionNumber(4);
     meta_table_->SetCompatibleVersionNumber(4);
+    if (!transaction.Commit())
+      return false;
+  }
+
+  if (meta_table_->GetVersionNumber() == 4) {
+    DCHECK_EQ(strcmp(kResponseHashesTable, kTables[6].table_name), 0);
+    DCHECK_EQ(strcmp(kEntriesTable, kIndexes[5].table_name), 0);
+    DCHECK_EQ(strcmp(kResponseHashesTable, kIndexes[11].table_name), 0);
+
+    // Add the "ResponseHashes" table used to share identical responses and
+    // relax the response id index of the "Entries" table accordingly.
+    sql::Transaction transaction(db_.get());
+    if (!transaction.Begin() ||
+        !CreateTable(db_.get(), kTables[6]) ||
+        !CreateIndex(db_.get(), kIndexes[11]) ||
+        !db_->Execute("DROP INDEX EntriesResponseIdIndex") ||
+        !CreateIndex(db_.get(), kIndexes[5])) {
+      return false;
+    }
+
+    meta_table_->SetVersionNumber(5);
+    meta_table_->SetCompatibleVersionNumber(5);
     return transaction.Commit();
   }
 
@@ -7,6 +7,7 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -158,6 +159,19 @@ class WEBKIT_STORAGE_EXPORT AppCacheDatabase {
   bool InsertDeletableResponseIds(const std::vector<int64>& response_ids);
   bool DeleteDeletableResponseIds(const std::vector<int64>& response_ids);
 
+  // Removes the ids still referred to by an entry from |response_ids|,
+  // responses can be shared by the entries of several caches.
+  bool RemoveResponseIdsInUse(std::vector<int64>* response_ids);
+
+  // Responses are identified by a hash of their body and headers so that
+  // identical responses within an origin are only stored once.
+  bool FindResponseWithHash(const GURL& origin,
+                            const std::string& response_hash,
+                            int64 response_size, int64* response_id);
+  bool InsertResponseHash(int64 response_id, const GURL& origin,
+                          const std::string& response_hash,
+                          int64 response_size);
+
   // So our callers can wrap operations in transactions.
   sql::Connection* db_connection() {
     LazyOpen(true);
@@ -215,7 +229,9 @@ class WEBKIT_STORAGE_EXPORT AppCacheDatabase {
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, ReCreate);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, DeletableResponseIds);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, OriginUsage);
+  FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, ResponseHashes);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, UpgradeSchema3to4);
+  FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, UpgradeSchema4to5);
 
   DISALLOW_COPY_AND_ASSIGN(AppCacheDatabase);
 };
@@ -545,6 +545,66 @@ TEST(AppCacheDatabaseTest, DeletableResponseIds) {
     EXPECT_EQ(i + 5, ids[i]);
 }
 
+TEST(AppCacheDatabaseTest, ResponseHashes) {
+  const base::FilePath kEmptyPath;
+  AppCacheDatabase db(kEmptyPath);
+  EXPECT_TRUE(db.LazyOpen(true));
+
+  db.db_->set_error_delegate(new TestErrorDelegate());
+
+  const GURL kOrigin("http://blah/");
+  const GURL kOtherOrigin("http://other/");
+  const std::string kHash("0123456789abcdef0123456789abcdef");
+  const int64 kSize = 1000;
+
+  int64 response_id = 0;
+  EXPECT_FALSE(db.FindResponseWithHash(kOrigin, kHash, kSize, &response_id));
+
+  EXPECT_TRUE(db.InsertResponseHash(1, kOrigin, kHash, kSize));
+  EXPECT_TRUE(db.FindResponseWithHash(kOrigin, kHash, kSize, &response_id));
+  EXPECT_EQ(1, response_id);
+
+  // The size and the origin have to match too.
+  EXPECT_FALSE(db.FindResponseWithHash(kOrigin, kHash, kSize + 1,
+                                       &response_id));
+  EXPECT_FALSE(db.FindResponseWithHash(kOtherOrigin, kHash, kSize,
+                                       &response_id));
+
+  // Entries of different caches may refer to the same response.
+  AppCacheDatabase::EntryRecord entry;
+  entry.cache_id = 1;
+  entry.url = GURL("http://blah/1");
+  entry.flags = AppCacheEntry::EXPLICIT;
+  entry.response_id = 1;
+  entry.response_size = kSize;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+  entry.cache_id = 2;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+
+  // Ids still in use are not deletable.
+  std::vector<int64> ids;
+  ids.push_back(1);
+  ids.push_back(2);
+  EXPECT_TRUE(db.RemoveResponseIdsInUse(&ids));
+  ASSERT_EQ(1U, ids.size());
+  EXPECT_EQ(2, ids[0]);
+
+  EXPECT_TRUE(db.DeleteEntriesForCache(1));
+  ids.clear();
+  ids.push_back(1);
+  EXPECT_TRUE(db.RemoveResponseIdsInUse(&ids));
+  EXPECT_TRUE(ids.empty());
+
+  EXPECT_TRUE(db.DeleteEntriesForCache(2));
+  ids.push_back(1);
+  EXPECT_TRUE(db.RemoveResponseIdsInUse(&ids));
+  EXPECT_EQ(1U, ids.size());
+
+  // Deletable responses can no longer be found by their hash.
+  EXPECT_TRUE(db.InsertDeletableResponseIds(ids));
+  EXPECT_FALSE(db.FindResponseWithHash(kOrigin, kHash, kSize, &response_id));
+}
+
 TEST(AppCacheDatabaseTest, OriginUsage) {
   const GURL kManifestUrl("http://blah/manifest");
   const GURL kManifestUrl2("http://blah/manifest2");
@@ -809,8 +869,10 @@ TEST(AppCacheDatabaseTest, UpgradeSchema3to4) {
   EXPECT_TRUE(db.db_->DoesIndexExist("NamespacesOriginIndex"));
   EXPECT_TRUE(db.db_->DoesIndexExist("NamespacesCacheAndUrlIndex"));
 
-  EXPECT_EQ(4, db.meta_table_->GetVersionNumber());
-  EXPECT_EQ(4, db.meta_table_->GetCompatibleVersionNumber());
+  // The upgrade continues on to the current version.
+  EXPECT_TRUE(db.db_->DoesTableExist("ResponseHashes"));
+  EXPECT_EQ(5, db.meta_table_->GetVersionNumber());
+  EXPECT_EQ(5, db.meta_table_->GetCompatibleVersionNumber());
 
   std::vector<AppCacheDatabase::NamespaceRecord> intercepts;
   std::vector<AppCacheDatabase::NamespaceRecord> fallbacks;
@@ -833,4 +895,54 @@ TEST(AppCacheDatabaseTest, UpgradeSchema3to4) {
   }
 }
 
+TEST(AppCacheDatabaseTest, UpgradeSchema4to5) {
+  // Real file on disk for this test.
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath kDbFile = temp_dir.path().AppendASCII("upgrade.db");
+
+  // Create a current database with an entry, then turn it back into a v4
+  // schema based database.
+  {
+    AppCacheDatabase db(kDbFile);
+    EXPECT_TRUE(db.LazyOpen(true));
+
+    AppCacheDatabase::EntryRecord entry;
+    entry.cache_id = 1;
+    entry.url = GURL("http://blah/1");
+    entry.flags = AppCacheEntry::EXPLICIT;
+    entry.response_id = 1;
+    entry.response_size = 100;
+    EXPECT_TRUE(db.InsertEntry(&entry));
+
+    sql::Transaction transaction(db.db_.get());
+    EXPECT_TRUE(transaction.Begin());
+    EXPECT_TRUE(db.db_->Execute("DROP TABLE ResponseHashes"));
+    EXPECT_TRUE(db.db_->Execute("DROP INDEX EntriesResponseIdIndex"));
+    EXPECT_TRUE(db.db_->Execute(
+        "CREATE UNIQUE INDEX EntriesResponseIdIndex ON Entries(response_id)"));
+    db.meta_table_->SetVersionNumber(4);
+    db.meta_table_->SetCompatibleVersionNumber(4);
+    EXPECT_TRUE(transaction.Commit());
+  }
+
+  // Open that database and verify that it got updated.
+  AppCacheDatabase db(kDbFile);
+  EXPECT_TRUE(db.LazyOpen(true));
+
+  EXPECT_TRUE(db.db_->DoesTableExist("ResponseHashes"));
+  EXPECT_TRUE(db.db_->DoesIndexExist("ResponseHashesOriginIndex"));
+  EXPECT_TRUE(db.db_->DoesIndexExist("EntriesResponseIdIndex"));
+  EXPECT_EQ(5, db.meta_table_->GetVersionNumber());
+  EXPECT_EQ(5, db.meta_table_->GetCompatibleVersionNumber());
+
+  // The existing entry survived and its response can now be shared.
+  std::vector<AppCacheDatabase::EntryRecord> entries;
+  EXPECT_TRUE(db.FindEntriesForCache(1, &entries));
+  EXPECT_EQ(1U, entries.size());
+  AppCacheDatabase::EntryRecord entry = entries[0];
+  entry.cache_id = 2;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+}
+
 }  // namespace appcache
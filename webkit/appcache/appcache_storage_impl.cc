@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -59,6 +60,7 @@ bool DeleteGroupAndRelatedRecords(AppCacheDatabase* database,
         database->DeleteEntriesForCache(cache_record.cache_id) &&
         database->DeleteNamespacesForCache(cache_record.cache_id) &&
         database->DeleteOnlineWhiteListForCache(cache_record.cache_id) &&
+        database->RemoveResponseIdsInUse(deletable_response_ids) &&
         database->InsertDeletableResponseIds(*deletable_response_ids);
   } else {
     NOTREACHED() << "A existing group without a cache is unexpected";
@@ -586,6 +588,11 @@ class AppCacheStorageImpl::StoreGroupAndCacheTask : public StoreOrLoadTask {
   virtual ~StoreGroupAndCacheTask() {}
 
  private:
+  // Points the entry records at previously stored responses of the origin
+  // that are identical to the ones written for the new cache, the written
+  // copies become deletable.
+  bool ShareIdenticalResponses();
+
   scoped_refptr<AppCacheGroup> group_;
   scoped_refptr<AppCache> cache_;
   bool success_;
@@ -593,6 +600,8 @@ class AppCacheStorageImpl::StoreGroupAndCacheTask : public StoreOrLoadTask {
   int64 space_available_;
   int64 new_origin_usage_;
   std::vector<int64> newly_deletable_response_ids_;
+  AppCache::ResponseHashMap response_hashes_;
+  std::map<GURL, int64> shared_response_ids_;
 };
 
 AppCacheStorageImpl::StoreGroupAndCacheTask::StoreGroupAndCacheTask(
@@ -609,6 +618,11 @@ AppCacheStorageImpl::StoreGroupAndCacheTask::StoreGroupAndCacheTask(
       &intercept_namespace_records_,
       &fallback_namespace_records_,
       &online_whitelist_records_);
+
+  // The entries of the newest complete cache may be in use already, only
+  // the responses of a cache that is about to become the newest are shared.
+  if (newest_cache != group->newest_complete_cache())
+    response_hashes_ = newest_cache->response_hashes();
 }
 
 void AppCacheStorageImpl::StoreGroupAndCacheTask::GetQuotaThenSchedule() {
@@ -658,6 +672,9 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
 
   int64 old_origin_usage = database_->GetOriginUsage(group_record_.origin);
 
+  if (!ShareIdenticalResponses())
+    return;
+
   AppCacheDatabase::GroupRecord existing_group;
   success_ = database_->FindGroup(group_record_.group_id, &existing_group);
   if (!success_) {
@@ -698,9 +715,7 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
           database_->DeleteCache(cache.cache_id) &&
           database_->DeleteEntriesForCache(cache.cache_id) &&
           database_->DeleteNamespacesForCache(cache.cache_id) &&
-          database_->DeleteOnlineWhiteListForCache(cache.cache_id) &&
-          database_->InsertDeletableResponseIds(newly_deletable_response_ids_);
-          // TODO(michaeln): store group_id too with deletable ids
+          database_->DeleteOnlineWhiteListForCache(cache.cache_id);
     } else {
       NOTREACHED() << "A existing group without a cache is unexpected";
     }
@@ -712,7 +727,10 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
       database_->InsertEntryRecords(entry_records_) &&
       database_->InsertNamespaceRecords(intercept_namespace_records_) &&
       database_->InsertNamespaceRecords(fallback_namespace_records_) &&
-      database_->InsertOnlineWhiteListRecords(online_whitelist_records_);
+      database_->InsertOnlineWhiteListRecords(online_whitelist_records_) &&
+      database_->RemoveResponseIdsInUse(&newly_deletable_response_ids_) &&
+      database_->InsertDeletableResponseIds(newly_deletable_response_ids_);
+      // TODO(michaeln): store group_id too with deletable ids
 
   if (!success_)
     return;
@@ -748,10 +766,49 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
   success_ = transaction.Commit();
 }
 
+bool AppCacheStorageImpl::StoreGroupAndCacheTask::ShareIdenticalResponses() {
+  std::vector<AppCacheDatabase::EntryRecord>::iterator iter =
+      entry_records_.begin();
+  for (; iter != entry_records_.end(); ++iter) {
+    AppCache::ResponseHashMap::const_iterator found =
+        response_hashes_.find(iter->response_id);
+    if (found == response_hashes_.end())
+      continue;
+
+    int64 shared_response_id = kNoResponseId;
+    if (database_->FindResponseWithHash(
+            group_record_.origin, found->second, iter->response_size,
+            &shared_response_id) &&
+        shared_response_id != iter->response_id) {
+      if (std::find(newly_deletable_response_ids_.begin(),
+                    newly_deletable_response_ids_.end(),
+                    iter->response_id) ==
+          newly_deletable_response_ids_.end()) {
+        newly_deletable_response_ids_.push_back(iter->response_id);
+      }
+      shared_response_ids_[iter->url] = shared_response_id;
+      iter->response_id = shared_response_id;
+    } else if (!database_->InsertResponseHash(
+                   iter->response_id, group_record_.origin, found->second,
+                   iter->response_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void AppCacheStorageImpl::StoreGroupAndCacheTask::RunCompleted() {
   if (success_) {
     storage_->UpdateUsageMapAndNotify(
         group_->manifest_url().GetOrigin(), new_origin_usage_);
+    for (std::map<GURL, int64>::const_iterator iter =
+             shared_response_ids_.begin();
+         iter != shared_response_ids_.end(); ++iter) {
+      AppCacheEntry* entry = cache_->GetEntry(iter->first);
+      DCHECK(entry);
+      entry->set_response_id(iter->second);
+    }
+    cache_->ClearResponseHashes();
     if (cache_ != group_->newest_complete_cache()) {
       cache_->set_complete(true);
       group_->AddCache(cache_);
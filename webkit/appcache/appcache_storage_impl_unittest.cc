@@ -2,14 +2,19 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <set>
 #include <stack>
 
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/callback.h"
+#include "base/command_line.h"
 #include "base/message_loop.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
 #include "base/threading/thread.h"
 #include "base/synchronization/waitable_event.h"
+#include "base/time.h"
 #include "net/base/net_errors.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "webkit/appcache/appcache.h"
@@ -50,6 +55,14 @@ const int kDefaultEntryIdOffset = 12345;
 
 const int kMockQuota = 5000;
 
+const char kResponseHash[] = "0123456789abcdef0123456789abcdef";
+const char kResponseHash2[] = "fedcba9876543210fedcba9876543210";
+
+const char kBenchmarkEntries[] = "appcache-benchmark-entries";
+const int kDefaultBenchmarkEntries = 50;
+const int kBenchmarkGroups = 4;
+const int kBenchmarkEntrySize = 10 * 1024;
+
 scoped_ptr<base::Thread> io_thread;
 scoped_ptr<base::Thread> db_thread;
 
@@ -140,7 +153,7 @@ class AppCacheStorageImplTest : public testing::Test {
                      io_thread->message_loop_proxy(),
                      db_thread->message_loop_proxy(),
                      NULL),
-        async_(false) {}
+        async_(false), quota_(kMockQuota) {}
 
     virtual void GetUsageAndQuota(
         const GURL& origin,
@@ -158,10 +171,11 @@ class AppCacheStorageImplTest : public testing::Test {
     }
 
     void CallCallback(const GetUsageAndQuotaCallback& callback) {
-      callback.Run(quota::kQuotaStatusOk, 0, kMockQuota);
+      callback.Run(quota::kQuotaStatusOk, 0, quota_);
     }
 
     bool async_;
+    int64 quota_;
 
    protected:
     virtual ~MockQuotaManager() {}
@@ -251,7 +265,7 @@ class AppCacheStorageImplTest : public testing::Test {
 
   // Test harness --------------------------------------------------
 
-  AppCacheStorageImplTest() {
+  AppCacheStorageImplTest() : benchmark_entries_(0) {
   }
 
   template <class Method>
@@ -277,8 +291,10 @@ class AppCacheStorageImplTest : public testing::Test {
     DCHECK(MessageLoop::current() == io_thread->message_loop());
     storage()->CancelDelegateCallbacks(delegate());
     group_ = NULL;
+    group2_ = NULL;
     cache_ = NULL;
     cache2_ = NULL;
+    benchmark_groups_.clear();
     mock_quota_manager_proxy_ = NULL;
     delegate_.reset();
     service_.reset();
@@ -725,6 +741,168 @@ class AppCacheStorageImplTest : public testing::Test {
     TestFinished();
   }
 
+  // StoreSharesIdenticalResponses  -------------------------------
+
+  void StoreSharesIdenticalResponses() {
+    PushNextTask(base::Bind(
+        &AppCacheStorageImplTest::Verify_StoreSharesIdenticalResponses,
+        base::Unretained(this)));
+
+    // Setup some preconditions. Create a group and complete cache that
+    // appear to be "stored", along with the hash of their response.
+    MakeCacheAndGroup(kManifestUrl, 1, 1, true);
+    EXPECT_TRUE(database()->InsertResponseHash(
+        1 + kDefaultEntryIdOffset, kOrigin, kResponseHash, kDefaultEntrySize));
+
+    // And an unstored group in the same origin whose new cache was written
+    // with an identical response and a different one.
+    group2_ = new AppCacheGroup(storage(), kManifestUrl2, 2);
+    cache2_ = new AppCache(storage(), 2);
+    cache2_->AddEntry(kEntryUrl, AppCacheEntry(AppCacheEntry::EXPLICIT, 2,
+                                               kDefaultEntrySize));
+    cache2_->AddResponseHash(2, kResponseHash);
+    cache2_->AddEntry(kEntryUrl2, AppCacheEntry(AppCacheEntry::EXPLICIT, 3,
+                                                kDefaultEntrySize));
+    cache2_->AddResponseHash(3, kResponseHash2);
+
+    // Conduct the test.
+    storage()->StoreGroupAndNewestCache(group2_, cache2_, delegate());
+    EXPECT_FALSE(delegate()->stored_group_success_);
+  }
+
+  void Verify_StoreSharesIdenticalResponses() {
+    const int64 kSharedResponseId = 1 + kDefaultEntryIdOffset;
+    EXPECT_TRUE(delegate()->stored_group_success_);
+    EXPECT_EQ(cache2_.get(), group2_->newest_complete_cache());
+    EXPECT_TRUE(cache2_->response_hashes().empty());
+
+    // The identical response is shared by both caches.
+    EXPECT_EQ(kSharedResponseId, cache2_->GetEntry(kEntryUrl)->response_id());
+    EXPECT_EQ(3, cache2_->GetEntry(kEntryUrl2)->response_id());
+    AppCacheDatabase::EntryRecord entry_record;
+    EXPECT_TRUE(database()->FindEntry(2, kEntryUrl, &entry_record));
+    EXPECT_EQ(kSharedResponseId, entry_record.response_id);
+
+    // Only the copy written for the new cache is left unreferenced.
+    std::vector<int64> response_ids;
+    response_ids.push_back(kSharedResponseId);
+    response_ids.push_back(2);
+    response_ids.push_back(3);
+    EXPECT_TRUE(database()->RemoveResponseIdsInUse(&response_ids));
+    ASSERT_EQ(1U, response_ids.size());
+    EXPECT_EQ(2, response_ids[0]);
+
+    // The other response can be shared from now on.
+    int64 response_id = kNoResponseId;
+    EXPECT_TRUE(database()->FindResponseWithHash(
+        kOrigin, kResponseHash2, kDefaultEntrySize, &response_id));
+    EXPECT_EQ(3, response_id);
+
+    // Usage is still accounted per cache.
+    EXPECT_EQ(3 * kDefaultEntrySize, storage()->usage_map_[kOrigin]);
+
+    // Making the first group obsolete keeps the shared response around.
+    PushNextTask(base::Bind(
+        &AppCacheStorageImplTest::Verify_SharedResponseOutlivesGroup,
+        base::Unretained(this)));
+    storage()->MakeGroupObsolete(group_, delegate());
+  }
+
+  void Verify_SharedResponseOutlivesGroup() {
+    const int64 kSharedResponseId = 1 + kDefaultEntryIdOffset;
+    EXPECT_TRUE(delegate()->obsoleted_success_);
+    EXPECT_TRUE(group_->is_obsolete());
+
+    std::vector<AppCacheDatabase::EntryRecord> entry_records;
+    EXPECT_TRUE(database()->FindEntriesForUrl(kEntryUrl, &entry_records));
+    ASSERT_EQ(1U, entry_records.size());
+    EXPECT_EQ(kSharedResponseId, entry_records[0].response_id);
+
+    int64 response_id = kNoResponseId;
+    EXPECT_TRUE(database()->FindResponseWithHash(
+        kOrigin, kResponseHash, kDefaultEntrySize, &response_id));
+    EXPECT_EQ(kSharedResponseId, response_id);
+
+    EXPECT_EQ(2 * kDefaultEntrySize, storage()->usage_map_[kOrigin]);
+
+    TestFinished();
+  }
+
+  // BenchmarkStoreSharedResponses  -------------------------------
+
+  void BenchmarkStoreSharedResponses() {
+    benchmark_entries_ = kDefaultBenchmarkEntries;
+    std::string entries_switch(CommandLine::ForCurrentProcess()->
+        GetSwitchValueASCII(kBenchmarkEntries));
+    base::StringToInt(entries_switch, &benchmark_entries_);
+    if (benchmark_entries_ < 1)
+      benchmark_entries_ = kDefaultBenchmarkEntries;
+
+    // Every group is a large manifest listing the same resources, each of
+    // them written anew by the update of the group.
+    mock_quota_manager_proxy_->mock_manager_->quota_ = kint64max;
+    printf("Benchmarking storing %d groups of %d entries:\n",
+           kBenchmarkGroups, benchmark_entries_);
+    benchmark_store_time_ = base::TimeDelta();
+    StoreNextBenchmarkGroup();
+  }
+
+  void StoreNextBenchmarkGroup() {
+    const int64 group_id = benchmark_groups_.size() + 1;
+    scoped_refptr<AppCacheGroup> group(new AppCacheGroup(
+        storage(),
+        kOrigin.Resolve(base::StringPrintf("manifest%d",
+                                           static_cast<int>(group_id))),
+        group_id));
+    scoped_refptr<AppCache> cache(new AppCache(storage(), group_id));
+    for (int i = 0; i < benchmark_entries_; ++i) {
+      const int64 response_id = (group_id - 1) * benchmark_entries_ + i + 1;
+      cache->AddEntry(kOrigin.Resolve(base::StringPrintf("entry%d", i)),
+                      AppCacheEntry(AppCacheEntry::EXPLICIT, response_id,
+                                    kBenchmarkEntrySize));
+      cache->AddResponseHash(response_id, base::IntToString(i));
+    }
+    benchmark_groups_.push_back(group);
+
+    PushNextTask(base::Bind(
+        &AppCacheStorageImplTest::Continue_BenchmarkStoreSharedResponses,
+        base::Unretained(this)));
+    benchmark_store_start_ = base::TimeTicks::HighResNow();
+    storage()->StoreGroupAndNewestCache(group, cache, delegate());
+  }
+
+  void Continue_BenchmarkStoreSharedResponses() {
+    benchmark_store_time_ +=
+        base::TimeTicks::HighResNow() - benchmark_store_start_;
+    EXPECT_TRUE(delegate()->stored_group_success_);
+    delegate()->stored_group_success_ = false;
+    if (static_cast<int>(benchmark_groups_.size()) < kBenchmarkGroups) {
+      StoreNextBenchmarkGroup();
+      return;
+    }
+
+    // Count the responses that are still referenced.
+    std::set<int64> kept_response_ids;
+    for (int64 cache_id = 1; cache_id <= kBenchmarkGroups; ++cache_id)
+      database()->FindResponseIdsForCacheAsSet(cache_id, &kept_response_ids);
+    EXPECT_EQ(static_cast<size_t>(benchmark_entries_),
+              kept_response_ids.size());
+
+    const int64 written_bytes =
+        static_cast<int64>(kBenchmarkGroups) * benchmark_entries_ *
+        kBenchmarkEntrySize;
+    const int64 kept_bytes =
+        static_cast<int64>(kept_response_ids.size()) * kBenchmarkEntrySize;
+    const double store_ms = benchmark_store_time_.InMillisecondsF();
+    printf("  store:  %.1f ms (%.3f ms per entry)\n",
+           store_ms, store_ms / (kBenchmarkGroups * benchmark_entries_));
+    printf("  disk:   %lld of %lld response bytes kept\n",
+           static_cast<long long>(kept_bytes),
+           static_cast<long long>(written_bytes));
+
+    TestFinished();
+  }
+
   // MarkEntryAsForeign  -------------------------------
 
   void MarkEntryAsForeign() {
@@ -1316,8 +1494,13 @@ class AppCacheStorageImplTest : public testing::Test {
   scoped_ptr<MockStorageDelegate> delegate_;
   scoped_refptr<MockQuotaManagerProxy> mock_quota_manager_proxy_;
   scoped_refptr<AppCacheGroup> group_;
+  scoped_refptr<AppCacheGroup> group2_;
   scoped_refptr<AppCache> cache_;
   scoped_refptr<AppCache> cache2_;
+  std::vector<scoped_refptr<AppCacheGroup> > benchmark_groups_;
+  int benchmark_entries_;
+  base::TimeTicks benchmark_store_start_;
+  base::TimeDelta benchmark_store_time_;
 };
 
 
@@ -1361,6 +1544,16 @@ TEST_F(AppCacheStorageImplTest, MakeGroupObsolete) {
   RunTestOnIOThread(&AppCacheStorageImplTest::MakeGroupObsolete);
 }
 
+TEST_F(AppCacheStorageImplTest, StoreSharesIdenticalResponses) {
+  RunTestOnIOThread(&AppCacheStorageImplTest::StoreSharesIdenticalResponses);
+}
+
+// Disabled by default; run with
+// --gtest_also_run_disabled_tests --appcache-benchmark-entries=N.
+TEST_F(AppCacheStorageImplTest, DISABLED_BenchmarkStoreSharedResponses) {
+  RunTestOnIOThread(&AppCacheStorageImplTest::BenchmarkStoreSharedResponses);
+}
+
 TEST_F(AppCacheStorageImplTest, MarkEntryAsForeign) {
   RunTestOnIOThread(&AppCacheStorageImplTest::MarkEntryAsForeign);
 }
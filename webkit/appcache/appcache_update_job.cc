@@ -22,9 +22,30 @@
 namespace appcache {
 
 static const int kBufferSize = 32768;
-static const size_t kMaxConcurrentUrlFetches = 2;
 static const int kMax503Retries = 3;
 
+// Headers that differ between otherwise identical responses and don't change
+// how a cached response is served. Every other header is part of the hash of
+// a response, so responses that only differ in these are considered
+// identical.
+static const char* const kUnhashedResponseHeaders[] = {
+  "age",
+  "connection",
+  "date",
+  "expires",
+  "keep-alive",
+  "proxy-connection",
+  "transfer-encoding",
+};
+
+static bool IsHashedResponseHeader(const std::string& lower_name) {
+  for (size_t i = 0; i < arraysize(kUnhashedResponseHeaders); ++i) {
+    if (lower_name == kUnhashedResponseHeaders[i])
+      return false;
+  }
+  return true;
+}
+
 // Helper class for collecting hosts per frontend when sending notifications
 // so that only one notification is sent for all hosts using the same frontend.
 class HostNotifier {
@@ -149,6 +170,20 @@ void AppCacheUpdateJob::URLFetcher::OnResponseStarted(
     // completion before reading any response data.
     if (fetch_type_ == URL_FETCH || fetch_type_ == MASTER_ENTRY_FETCH) {
       response_writer_.reset(job_->CreateResponseWriter());
+      base::MD5Init(&response_hash_context_);
+      base::MD5Update(&response_hash_context_, base::StringPrintf(
+          "%d\n", request->GetResponseCode()));
+      void* iter = NULL;
+      std::string name;
+      std::string value;
+      while (request->response_headers()->EnumerateHeaderLines(
+                 &iter, &name, &value)) {
+        StringToLowerASCII(&name);
+        if (!IsHashedResponseHeader(name))
+          continue;
+        base::MD5Update(&response_hash_context_, base::StringPrintf(
+            "%s: %s\n", name.c_str(), value.c_str()));
+      }
       scoped_refptr<HttpResponseInfoIOBuffer> io_buffer(
           new HttpResponseInfoIOBuffer(
               new net::HttpResponseInfo(request->response_info())));
@@ -243,6 +278,8 @@ bool AppCacheUpdateJob::URLFetcher::ConsumeResponseData(int bytes_read) {
     case URL_FETCH:
     case MASTER_ENTRY_FETCH:
       DCHECK(response_writer_.get());
+      base::MD5Update(&response_hash_context_,
+                      base::StringPiece(buffer_->data(), bytes_read));
       response_writer_->WriteData(
           buffer_, bytes_read,
           base::Bind(&URLFetcher::OnWriteComplete, base::Unretained(this)));
@@ -261,6 +298,12 @@ void AppCacheUpdateJob::URLFetcher::OnResponseCompleted() {
     return;
   }
 
+  if (response_writer_.get() && request_->status().is_success()) {
+    base::MD5Digest digest;
+    base::MD5Final(&digest, &response_hash_context_);
+    response_hash_ = base::MD5DigestToBase16(digest);
+  }
+
   switch (fetch_type_) {
     case MANIFEST_FETCH:
       job_->HandleManifestFetchCompleted(this);
@@ -287,6 +330,7 @@ bool AppCacheUpdateJob::URLFetcher::MaybeRetryRequest() {
     return false;
   }
   ++retry_503_attempts_;
+  job_->AdjustUrlFetchLimit(503);
   request_.reset(job_->service_->request_context()->CreateRequest(url_, this));
   Start();
   return true;
@@ -302,6 +346,7 @@ AppCacheUpdateJob::AppCacheUpdateJob(AppCacheService* service,
       master_entries_completed_(0),
       url_fetches_completed_(0),
       manifest_fetcher_(NULL),
+      url_fetch_limit_(kInitialConcurrentUrlFetches),
       stored_state_(UNSTORED) {
 }
 
@@ -542,6 +587,7 @@ void AppCacheUpdateJob::HandleUrlFetchCompleted(URLFetcher* fetcher) {
   int response_code = request->status().is_success()
       ? request->GetResponseCode() : -1;
   AppCacheEntry& entry = url_file_list_.find(url)->second;
+  AdjustUrlFetchLimit(response_code);
 
   if (response_code / 100 == 2) {
     // Associate storage with the new entry.
@@ -550,6 +596,9 @@ void AppCacheUpdateJob::HandleUrlFetchCompleted(URLFetcher* fetcher) {
     entry.set_response_size(fetcher->response_writer()->amount_written());
     if (!inprogress_cache_->AddOrModifyEntry(url, entry))
       duplicate_response_ids_.push_back(entry.response_id());
+    else if (!fetcher->response_hash().empty())
+      inprogress_cache_->AddResponseHash(entry.response_id(),
+                                         fetcher->response_hash());
 
     // TODO(michaeln): Check for <html manifest=xxx>
     // See http://code.google.com/p/chromium/issues/detail?id=97930
@@ -614,6 +663,7 @@ void AppCacheUpdateJob::HandleMasterEntryFetchCompleted(
 
   int response_code = request->status().is_success()
       ? request->GetResponseCode() : -1;
+  AdjustUrlFetchLimit(response_code);
 
   PendingMasters::iterator found = pending_master_entries_.find(url);
   DCHECK(found != pending_master_entries_.end());
@@ -628,10 +678,16 @@ void AppCacheUpdateJob::HandleMasterEntryFetchCompleted(
     AppCacheEntry master_entry(AppCacheEntry::MASTER,
                                fetcher->response_writer()->response_id(),
                                fetcher->response_writer()->amount_written());
-    if (cache->AddOrModifyEntry(url, master_entry))
+    if (cache->AddOrModifyEntry(url, master_entry)) {
       added_master_entries_.push_back(url);
-    else
+      if (cache == inprogress_cache_.get() &&
+          !fetcher->response_hash().empty()) {
+        cache->AddResponseHash(master_entry.response_id(),
+                               fetcher->response_hash());
+      }
+    } else {
       duplicate_response_ids_.push_back(master_entry.response_id());
+    }
 
     // In no-update case, associate host with the newest cache.
     if (!inprogress_cache_) {
@@ -682,6 +738,16 @@ void AppCacheUpdateJob::HandleMasterEntryFetchCompleted(
   MaybeCompleteUpdate();
 }
 
+void AppCacheUpdateJob::AdjustUrlFetchLimit(int response_code) {
+  if (response_code == -1 || response_code / 100 == 5) {
+    url_fetch_limit_ /= 2;
+    if (url_fetch_limit_ < kMinConcurrentUrlFetches)
+      url_fetch_limit_ = kMinConcurrentUrlFetches;
+  } else if (url_fetch_limit_ < kMaxConcurrentUrlFetches) {
+    ++url_fetch_limit_;
+  }
+}
+
 void AppCacheUpdateJob::HandleManifestRefetchCompleted(
     URLFetcher* fetcher) {
   DCHECK(internal_state_ == REFETCH_MANIFEST);
@@ -929,9 +995,9 @@ void AppCacheUpdateJob::FetchUrls() {
   DCHECK(internal_state_ == DOWNLOADING);
 
   // Fetch each URL in the list according to section 6.9.4 step 17.1-17.3.
-  // Fetch up to the concurrent limit. Other fetches will be triggered as each
-  // each fetch completes.
-  while (pending_url_fetches_.size() < kMaxConcurrentUrlFetches &&
+  // Fetch up to the concurrent limit, which adapts to how the server copes.
+  // Other fetches will be triggered as each each fetch completes.
+  while (pending_url_fetches_.size() < url_fetch_limit_ &&
          !urls_to_fetch_.empty()) {
     UrlToFetch url_to_fetch = urls_to_fetch_.front();
     urls_to_fetch_.pop_front();
@@ -1049,7 +1115,7 @@ void AppCacheUpdateJob::FetchMasterEntries() {
 
   // Fetch each master entry in the list, up to the concurrent limit.
   // Additional fetches will be triggered as each fetch completes.
-  while (master_entry_fetches_.size() < kMaxConcurrentUrlFetches &&
+  while (master_entry_fetches_.size() < url_fetch_limit_ &&
          !master_entries_to_fetch_.empty()) {
     const GURL& url = *master_entries_to_fetch_.begin();
 
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "base/gtest_prod_util.h"
+#include "base/md5.h"
 #include "base/memory/ref_counted.h"
 #include "googleurl/src/gurl.h"
 #include "net/base/completion_callback.h"
@@ -53,6 +54,12 @@ class WEBKIT_STORAGE_EXPORT AppCacheUpdateJob
 
   static const int kRerunDelayMs = 1000;
 
+  // Bounds of the number of resources fetched at the same time. The limit
+  // grows as fetches succeed and is halved when the server struggles.
+  static const size_t kMinConcurrentUrlFetches = 2;
+  static const size_t kInitialConcurrentUrlFetches = 4;
+  static const size_t kMaxConcurrentUrlFetches = 16;
+
   // TODO(michaeln): Rework the set of states vs update types vs stored states.
   // The NO_UPDATE state is really more of an update type. For all update types
   // storing the results is relevant.
@@ -110,6 +117,10 @@ class WEBKIT_STORAGE_EXPORT AppCacheUpdateJob
     AppCacheResponseWriter* response_writer() const {
       return response_writer_.get();
     }
+    // Hash of the status, the headers that affect how the response is
+    // served and the body written by |response_writer_|, empty until the
+    // whole response has been written.
+    const std::string& response_hash() const { return response_hash_; }
     void set_existing_response_headers(net::HttpResponseHeaders* headers) {
       existing_response_headers_ = headers;
     }
@@ -143,6 +154,8 @@ class WEBKIT_STORAGE_EXPORT AppCacheUpdateJob
     scoped_refptr<net::HttpResponseHeaders> existing_response_headers_;
     std::string manifest_data_;
     scoped_ptr<AppCacheResponseWriter> response_writer_;
+    base::MD5Context response_hash_context_;
+    std::string response_hash_;
   };  // class URLFetcher
 
   AppCacheResponseWriter* CreateResponseWriter();
@@ -169,6 +182,10 @@ class WEBKIT_STORAGE_EXPORT AppCacheUpdateJob
   void HandleUrlFetchCompleted(URLFetcher* fetcher);
   void HandleMasterEntryFetchCompleted(URLFetcher* fetcher);
 
+  // Grows or shrinks |url_fetch_limit_| based on how a fetch went, -1 is
+  // passed for network errors.
+  void AdjustUrlFetchLimit(int response_code);
+
   void HandleManifestRefetchCompleted(URLFetcher* fetcher);
   void OnManifestInfoWriteComplete(int result);
   void OnManifestDataWriteComplete(int result);
@@ -274,6 +291,9 @@ class WEBKIT_STORAGE_EXPORT AppCacheUpdateJob
   URLFetcher* manifest_fetcher_;
   PendingUrlFetches pending_url_fetches_;
 
+  // How many URL and master entry fetches may be pending at the same time.
+  size_t url_fetch_limit_;
+
   // Temporary storage of manifest response data for parsing and comparison.
   std::string manifest_data_;
   scoped_ptr<net::HttpResponseInfo> manifest_response_info_;
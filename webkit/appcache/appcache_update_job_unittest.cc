@@ -650,6 +650,45 @@ class AppCacheUpdateJobTest : public testing::Test,
     UpdateFinished();
   }
 
+  void AdaptiveFetchLimitTest() {
+    ASSERT_EQ(MessageLoop::TYPE_IO, MessageLoop::current()->type());
+
+    MakeService();
+    group_ = new AppCacheGroup(service_->storage(), GURL("http://failme"),
+                               service_->storage()->NewGroupId());
+
+    AppCacheUpdateJob* update = new AppCacheUpdateJob(service_.get(), group_);
+    group_->update_job_ = update;
+
+    const size_t kMin = AppCacheUpdateJob::kMinConcurrentUrlFetches;
+    const size_t kInitial = AppCacheUpdateJob::kInitialConcurrentUrlFetches;
+    const size_t kMax = AppCacheUpdateJob::kMaxConcurrentUrlFetches;
+    EXPECT_EQ(kInitial, update->url_fetch_limit_);
+
+    // Completed fetches raise the limit up to the maximum, including the
+    // ones that didn't succeed due to the resource.
+    update->AdjustUrlFetchLimit(200);
+    EXPECT_EQ(kInitial + 1, update->url_fetch_limit_);
+    update->AdjustUrlFetchLimit(404);
+    EXPECT_EQ(kInitial + 2, update->url_fetch_limit_);
+    for (size_t i = 0; i < kMax; ++i)
+      update->AdjustUrlFetchLimit(304);
+    EXPECT_EQ(kMax, update->url_fetch_limit_);
+
+    // Server and network errors halve it down to the minimum.
+    update->AdjustUrlFetchLimit(503);
+    EXPECT_EQ(kMax / 2, update->url_fetch_limit_);
+    update->AdjustUrlFetchLimit(-1);
+    EXPECT_EQ(kMax / 4, update->url_fetch_limit_);
+    for (size_t i = 0; i < kMax; ++i)
+      update->AdjustUrlFetchLimit(500);
+    EXPECT_EQ(kMin, update->url_fetch_limit_);
+
+    // Abort as we're not testing actual URL fetches in this test.
+    delete update;
+    UpdateFinished();
+  }
+
   void StartUpgradeAttemptTest() {
     ASSERT_EQ(MessageLoop::TYPE_IO, MessageLoop::current()->type());
 
@@ -3420,6 +3459,10 @@ TEST_F(AppCacheUpdateJobTest, StartCacheAttempt) {
   RunTestOnIOThread(&AppCacheUpdateJobTest::StartCacheAttemptTest);
 }
 
+TEST_F(AppCacheUpdateJobTest, AdaptiveFetchLimit) {
+  RunTestOnIOThread(&AppCacheUpdateJobTest::AdaptiveFetchLimitTest);
+}
+
 TEST_F(AppCacheUpdateJobTest, StartUpgradeAttempt) {
   RunTestOnIOThread(&AppCacheUpdateJobTest::StartUpgradeAttemptTest);
 }
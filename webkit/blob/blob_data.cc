@@ -17,8 +17,20 @@ BlobData::~BlobData() {}
 
 void BlobData::AppendData(const char* data, size_t length) {
   DCHECK(length > 0);
+  std::vector<unsigned char> bytes(data, data + length);
+  AppendSharedData(base::RefCountedBytes::TakeVector(&bytes), 0, length);
+}
+
+void BlobData::AppendSharedData(base::RefCountedMemory* buffer,
+                                size_t offset, size_t length) {
+  DCHECK(length > 0);
+  DCHECK_LE(offset + length, buffer->size());
   items_.push_back(Item());
-  items_.back().SetToBytes(data, length);
+  items_.back().SetToSharedBytes(
+      reinterpret_cast<const char*>(buffer->front()) + offset,
+      static_cast<int>(length));
+  item_buffers_.resize(items_.size());
+  item_buffers_.back() = buffer;
 }
 
 void BlobData::AppendFile(const base::FilePath& file_path,
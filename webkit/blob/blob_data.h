@@ -10,6 +10,7 @@
 #include "base/basictypes.h"
 #include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/time.h"
 #include "googleurl/src/gurl.h"
 #include "webkit/base/data_element.h"
@@ -28,8 +29,15 @@ class WEBKIT_STORAGE_EXPORT BlobData : public base::RefCounted<BlobData> {
     AppendData(data.c_str(), data.size());
   }
 
+  // Copies |data| into a new buffer owned by the blob.
   void AppendData(const char* data, size_t length);
 
+  // Appends |length| bytes at |offset| in |buffer| without copying them.
+  // Buffers are never modified once they hold blob data, so blobs that are
+  // slices of other blobs share the buffers of their source.
+  void AppendSharedData(base::RefCountedMemory* buffer,
+                        size_t offset, size_t length);
+
   void AppendFile(const base::FilePath& file_path, uint64 offset, uint64 length,
                   const base::Time& expected_modification_time);
 
@@ -44,6 +52,12 @@ class WEBKIT_STORAGE_EXPORT BlobData : public base::RefCounted<BlobData> {
 
   const std::vector<Item>& items() const { return items_; }
 
+  // Returns the buffer that holds the bytes of the item at |index|, or NULL
+  // if the item isn't of TYPE_BYTES.
+  base::RefCountedMemory* GetItemBuffer(size_t index) const {
+    return index < item_buffers_.size() ? item_buffers_[index].get() : NULL;
+  }
+
   const std::string& content_type() const { return content_type_; }
   void set_content_type(const std::string& content_type) {
     content_type_ = content_type;
@@ -65,6 +79,10 @@ class WEBKIT_STORAGE_EXPORT BlobData : public base::RefCounted<BlobData> {
   std::string content_type_;
   std::string content_disposition_;
   std::vector<Item> items_;
+  // The buffers backing the TYPE_BYTES items, indexed like |items_| and
+  // NULL for the other types. Shorter than |items_| if it ends with items
+  // of other types.
+  std::vector<scoped_refptr<base::RefCountedMemory> > item_buffers_;
   std::vector<scoped_refptr<ShareableFileReference> > shareable_files_;
 
   DISALLOW_COPY_AND_ASSIGN(BlobData);
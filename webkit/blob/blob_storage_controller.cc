@@ -4,7 +4,13 @@
 
 #include "webkit/blob/blob_storage_controller.h"
 
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/sequenced_task_runner.h"
+#include "base/task_runner_util.h"
 #include "googleurl/src/gurl.h"
 #include "webkit/blob/blob_data.h"
 
@@ -30,15 +36,69 @@ GURL ClearBlobUrlRef(const GURL& url) {
 
 static const int64 kMaxMemoryUsage = 1024 * 1024 * 1024;  // 1G
 
+// Blobs holding less than this in memory aren't worth a file of their own.
+static const int64 kMinSpillBytes = 1024 * 1024;  // 1M
+
+// A slice of a buffer to be written to a spill file.
+struct SpillChunk {
+  scoped_refptr<base::RefCountedMemory> buffer;
+  const char* data;
+  size_t length;
+};
+
+void ResetSpillDirectory(const base::FilePath& directory) {
+  file_util::Delete(directory, true);
+  file_util::CreateDirectory(directory);
+}
+
+// Writes |chunks| one after the other to a new file in |directory|. Returns
+// the path of the file, or an empty path on failure.
+base::FilePath WriteSpillFile(const base::FilePath& directory,
+                              const std::vector<SpillChunk>& chunks) {
+  base::FilePath file_path;
+  if (!file_util::CreateTemporaryFileInDir(directory, &file_path))
+    return base::FilePath();
+  FILE* file = file_util::OpenFile(file_path, "wb");
+  bool success = file != NULL;
+  for (size_t i = 0; success && i < chunks.size(); ++i) {
+    success = fwrite(chunks[i].data, 1, chunks[i].length, file) ==
+        chunks[i].length;
+  }
+  if (file && !file_util::CloseFile(file))
+    success = false;
+  if (!success) {
+    file_util::Delete(file_path, false);
+    return base::FilePath();
+  }
+  return file_path;
+}
+
 }  // namespace
 
 BlobStorageController::BlobStorageController()
-    : memory_usage_(0) {
+    : memory_usage_(0),
+      in_memory_limit_(kMaxMemoryUsage),
+      pending_spill_bytes_(0),
+      weak_factory_(this) {
 }
 
 BlobStorageController::~BlobStorageController() {
 }
 
+void BlobStorageController::EnableDiskSpill(
+    const base::FilePath& directory,
+    base::SequencedTaskRunner* file_task_runner,
+    int64 in_memory_limit) {
+  DCHECK(!directory.empty());
+  DCHECK(file_task_runner);
+  spill_directory_ = directory;
+  file_task_runner_ = file_task_runner;
+  in_memory_limit_ = in_memory_limit;
+  // Spill files are only referred to by the blobs of this session.
+  file_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResetSpillDirectory, spill_directory_));
+}
+
 void BlobStorageController::StartBuildingBlob(const GURL& url) {
   DCHECK(url.SchemeIs("blob"));
   DCHECK(!BlobUrlHasRef(url));
@@ -57,8 +117,6 @@ void BlobStorageController::AppendBlobDataItem(
   BlobData* target_blob_data = found->second;
   DCHECK(target_blob_data);
 
-  memory_usage_ -= target_blob_data->GetMemoryUsage();
-
   // The blob data is stored in the "canonical" way. That is, it only contains a
   // list of Data and File items.
   // 1) The Data item is denoted by the raw data and the range.
@@ -71,10 +129,15 @@ void BlobStorageController::AppendBlobDataItem(
 
   DCHECK(item.length() > 0);
   switch (item.type()) {
-    case BlobData::Item::TYPE_BYTES:
+    case BlobData::Item::TYPE_BYTES: {
       DCHECK(!item.offset());
-      target_blob_data->AppendData(item.bytes(), item.length());
+      // |item| belongs to the caller, copy it into a buffer of its own.
+      std::vector<unsigned char> bytes(item.bytes(),
+                                       item.bytes() + item.length());
+      AppendBuffer(target_blob_data, base::RefCountedBytes::TakeVector(&bytes),
+                   0, static_cast<size_t>(item.length()));
       break;
+    }
     case BlobData::Item::TYPE_FILE:
       AppendFileItem(target_blob_data,
                      item.path(),
@@ -104,13 +167,14 @@ void BlobStorageController::AppendBlobDataItem(
       break;
   }
 
-  memory_usage_ += target_blob_data->GetMemoryUsage();
-
-  // If we're using too much memory, drop this blob.
-  // TODO(michaeln): Blob memory storage does not yet spill over to disk,
-  // until it does, we'll prevent memory usage over a max amount.
-  if (memory_usage_ > kMaxMemoryUsage)
+  // If we're using too much memory, drop this blob. Spilling is asynchronous
+  // and may be disabled or failing, this bounds what it can fall behind.
+  if (memory_usage_ > kMaxMemoryUsage) {
     RemoveBlob(url);
+    return;
+  }
+
+  SpillIfNeeded();
 }
 
 void BlobStorageController::FinishBuildingBlob(
@@ -164,12 +228,11 @@ bool BlobStorageController::RemoveFromMapHelper(
   if (found == map->end())
     return false;
   if (DecrementBlobDataUsage(found->second))
-    memory_usage_ -= found->second->GetMemoryUsage();
+    ReleaseBuffers(found->second);
   map->erase(found);
   return true;
 }
 
-
 BlobData* BlobStorageController::GetBlobDataFromUrl(const GURL& url) {
   BlobMap::iterator found = blob_map_.find(
       BlobUrlHasRef(url) ? ClearBlobUrlRef(url).spec() : url.spec());
@@ -182,24 +245,24 @@ void BlobStorageController::AppendStorageItems(
   DCHECK(target_blob_data && src_blob_data &&
          length != static_cast<uint64>(-1));
 
-  std::vector<BlobData::Item>::const_iterator iter =
-      src_blob_data->items().begin();
+  const std::vector<BlobData::Item>& items = src_blob_data->items();
+  size_t index = 0;
   if (offset) {
-    for (; iter != src_blob_data->items().end(); ++iter) {
-      if (offset >= iter->length())
-        offset -= iter->length();
+    for (; index < items.size(); ++index) {
+      if (offset >= items[index].length())
+        offset -= items[index].length();
       else
         break;
     }
   }
 
-  for (; iter != src_blob_data->items().end() && length > 0; ++iter) {
+  for (; index < items.size() && length > 0; ++index) {
+    const BlobData::Item* iter = &items[index];
     uint64 current_length = iter->length() - offset;
     uint64 new_length = current_length > length ? length : current_length;
     if (iter->type() == BlobData::Item::TYPE_BYTES) {
-      target_blob_data->AppendData(
-          iter->bytes() + static_cast<size_t>(iter->offset() + offset),
-          static_cast<uint32>(new_length));
+      AppendSharedBytesItem(target_blob_data, src_blob_data, index,
+                            offset, new_length);
     } else if (iter->type() == BlobData::Item::TYPE_FILE) {
       AppendFileItem(target_blob_data,
                      iter->path(),
@@ -219,6 +282,35 @@ void BlobStorageController::AppendStorageItems(
   }
 }
 
+void BlobStorageController::AppendSharedBytesItem(
+    BlobData* target_blob_data, BlobData* src_blob_data,
+    size_t index, uint64 offset, uint64 length) {
+  const BlobData::Item& item = src_blob_data->items()[index];
+  DCHECK_EQ(BlobData::Item::TYPE_BYTES, item.type());
+  const char* data = item.bytes() + static_cast<size_t>(item.offset() + offset);
+  base::RefCountedMemory* buffer = src_blob_data->GetItemBuffer(index);
+  // Copy slices taking up less than half of their buffer. Otherwise a small
+  // blob could keep a large buffer in memory once the blobs using the rest of
+  // it are gone or spilled, and it would never be spilled itself for holding
+  // so few bytes.
+  if (!buffer || length < buffer->size() - length) {
+    std::vector<unsigned char> bytes(data, data + length);
+    AppendBuffer(target_blob_data, base::RefCountedBytes::TakeVector(&bytes),
+                 0, static_cast<size_t>(length));
+    return;
+  }
+  AppendBuffer(target_blob_data, buffer,
+               data - reinterpret_cast<const char*>(buffer->front()),
+               static_cast<size_t>(length));
+}
+
+void BlobStorageController::AppendBuffer(BlobData* target_blob_data,
+                                         base::RefCountedMemory* buffer,
+                                         size_t offset, size_t length) {
+  target_blob_data->AppendSharedData(buffer, offset, length);
+  IncrementBufferUsage(buffer);
+}
+
 void BlobStorageController::AppendFileItem(
     BlobData* target_blob_data,
     const base::FilePath& file_path, uint64 offset, uint64 length,
@@ -254,4 +346,173 @@ bool BlobStorageController::DecrementBlobDataUsage(BlobData* blob_data) {
   return true;
 }
 
+void BlobStorageController::IncrementBufferUsage(
+    base::RefCountedMemory* buffer) {
+  if (!buffer_usage_count_[buffer]++)
+    memory_usage_ += buffer->size();
+}
+
+void BlobStorageController::DecrementBufferUsage(
+    base::RefCountedMemory* buffer) {
+  BufferUsageMap::iterator found = buffer_usage_count_.find(buffer);
+  DCHECK(found != buffer_usage_count_.end());
+  if (--(found->second))
+    return;
+  memory_usage_ -= buffer->size();
+  buffer_usage_count_.erase(found);
+}
+
+void BlobStorageController::ReleaseBuffers(BlobData* blob_data) {
+  for (size_t i = 0; i < blob_data->items().size(); ++i) {
+    if (base::RefCountedMemory* buffer = blob_data->GetItemBuffer(i))
+      DecrementBufferUsage(buffer);
+  }
+}
+
+void BlobStorageController::SpillIfNeeded() {
+  if (!file_task_runner_)
+    return;
+  while (memory_usage_ - pending_spill_bytes_ > in_memory_limit_) {
+    // Pick the blob with the most bytes in memory that isn't being spilled
+    // already.
+    BlobData* largest_blob_data = NULL;
+    int64 largest_memory_usage = 0;
+    for (BlobDataUsageMap::const_iterator iter =
+             blob_data_usage_count_.begin();
+         iter != blob_data_usage_count_.end(); ++iter) {
+      if (blobs_being_spilled_.count(iter->first))
+        continue;
+      int64 blob_memory_usage = iter->first->GetMemoryUsage();
+      if (blob_memory_usage > largest_memory_usage) {
+        largest_blob_data = iter->first;
+        largest_memory_usage = blob_memory_usage;
+      }
+    }
+    if (largest_memory_usage < kMinSpillBytes)
+      return;
+    SpillBlobData(largest_blob_data);
+  }
+}
+
+void BlobStorageController::SpillBlobData(BlobData* blob_data) {
+  // The items are copied out since the blob may keep growing on this thread
+  // while the file is written. The buffers themselves never change.
+  std::vector<SpillChunk> chunks;
+  int64 spilled_bytes = 0;
+  const std::vector<BlobData::Item>& items = blob_data->items();
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (items[i].type() != BlobData::Item::TYPE_BYTES)
+      continue;
+    SpillChunk chunk;
+    chunk.buffer = blob_data->GetItemBuffer(i);
+    chunk.data = items[i].bytes() + static_cast<size_t>(items[i].offset());
+    chunk.length = static_cast<size_t>(items[i].length());
+    chunks.push_back(chunk);
+    spilled_bytes += chunk.length;
+  }
+  DCHECK(spilled_bytes);
+
+  blobs_being_spilled_.insert(blob_data);
+  pending_spill_bytes_ += spilled_bytes;
+  base::PostTaskAndReplyWithResult(
+      file_task_runner_.get(), FROM_HERE,
+      base::Bind(&WriteSpillFile, spill_directory_, chunks),
+      base::Bind(&BlobStorageController::DidSpillBlobData,
+                 weak_factory_.GetWeakPtr(),
+                 make_scoped_refptr(blob_data), items.size(), spilled_bytes));
+}
+
+void BlobStorageController::DidSpillBlobData(
+    scoped_refptr<BlobData> blob_data,
+    size_t item_count,
+    int64 spilled_bytes,
+    const base::FilePath& file_path) {
+  blobs_being_spilled_.erase(blob_data.get());
+  pending_spill_bytes_ -= spilled_bytes;
+
+  if (file_path.empty()) {
+    LOG(WARNING) << "Failed to spill blob data to "
+                 << spill_directory_.value() << ", keeping it in memory.";
+    file_task_runner_ = NULL;
+    return;
+  }
+
+  // Deletes the file once no blob refers to it, right away if |blob_data|
+  // was removed meanwhile.
+  scoped_refptr<ShareableFileReference> spill_file =
+      ShareableFileReference::GetOrCreate(
+          file_path, ShareableFileReference::DELETE_ON_FINAL_RELEASE,
+          file_task_runner_.get());
+
+  BlobDataUsageMap::iterator found = blob_data_usage_count_.find(blob_data);
+  if (found == blob_data_usage_count_.end())
+    return;
+
+  // Whoever holds |blob_data| keeps using it, the urls get a copy that reads
+  // the spilled items from the file. Items appended since the spill started
+  // are carried over as they are.
+  scoped_refptr<BlobData> new_blob_data(new BlobData);
+  new_blob_data->set_content_type(blob_data->content_type());
+  new_blob_data->set_content_disposition(blob_data->content_disposition());
+  blob_data_usage_count_[new_blob_data] = found->second;
+  blob_data_usage_count_.erase(found);
+
+  // Runs of spilled items are contiguous in the file, each run becomes a
+  // single file item so that reading it opens the file only once.
+  const std::vector<BlobData::Item>& items = blob_data->items();
+  uint64 file_offset = 0;
+  uint64 run_length = 0;
+  for (size_t i = 0; i < items.size(); ++i) {
+    const BlobData::Item& item = items[i];
+    if (i < item_count && item.type() == BlobData::Item::TYPE_BYTES) {
+      run_length += item.length();
+      continue;
+    }
+    if (run_length) {
+      AppendFileItem(new_blob_data, file_path, file_offset, run_length,
+                     base::Time());
+      file_offset += run_length;
+      run_length = 0;
+    }
+    switch (item.type()) {
+      case BlobData::Item::TYPE_BYTES:
+        AppendSharedBytesItem(new_blob_data, blob_data, i, 0, item.length());
+        break;
+      case BlobData::Item::TYPE_FILE:
+        AppendFileItem(new_blob_data, item.path(), item.offset(),
+                       item.length(), item.expected_modification_time());
+        break;
+      case BlobData::Item::TYPE_FILE_FILESYSTEM:
+        AppendFileSystemFileItem(new_blob_data, item.url(), item.offset(),
+                                 item.length(),
+                                 item.expected_modification_time());
+        break;
+      default:
+        NOTREACHED();
+        break;
+    }
+  }
+  if (run_length) {
+    AppendFileItem(new_blob_data, file_path, file_offset, run_length,
+                   base::Time());
+    file_offset += run_length;
+  }
+  DCHECK_EQ(static_cast<uint64>(spilled_bytes), file_offset);
+
+  ReplaceInMap(&blob_map_, blob_data, new_blob_data);
+  ReplaceInMap(&unfinalized_blob_map_, blob_data, new_blob_data);
+  ReleaseBuffers(blob_data);
+
+  SpillIfNeeded();
+}
+
+void BlobStorageController::ReplaceInMap(BlobMap* map,
+                                         BlobData* old_blob_data,
+                                         BlobData* new_blob_data) {
+  for (BlobMap::iterator iter = map->begin(); iter != map->end(); ++iter) {
+    if (iter->second == old_blob_data)
+      iter->second = new_blob_data;
+  }
+}
+
 }  // namespace webkit_blob
@@ -6,10 +6,14 @@
 #define WEBKIT_BLOB_BLOB_STORAGE_CONTROLLER_H_
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
+#include "base/files/file_path.h"
 #include "base/hash_tables.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
 #include "base/process.h"
 #include "webkit/blob/blob_data.h"
 #include "webkit/storage/webkit_storage_export.h"
@@ -17,18 +21,33 @@
 class GURL;
 
 namespace base {
-class FilePath;
+class RefCountedMemory;
+class SequencedTaskRunner;
 class Time;
 }
 
 namespace webkit_blob {
 
 // This class handles the logistics of blob Storage within the browser process.
+//
+// The bytes of blobs live in refcounted buffers that are never modified once
+// appended, blobs built from other blobs share them rather than copying.
+// Once spilling is enabled and the buffers in use exceed the in-memory limit,
+// the bytes of the largest blobs are written to temporary files and the blobs
+// are replaced by copies that refer to those files. Anyone still holding the
+// previous BlobData keeps reading it from memory.
 class WEBKIT_STORAGE_EXPORT BlobStorageController {
  public:
   BlobStorageController();
   ~BlobStorageController();
 
+  // Spills blob bytes to temporary files in |directory|, written on
+  // |file_task_runner|, once more than |in_memory_limit| bytes of buffers are
+  // in use. Anything left in |directory| by a previous session is deleted.
+  void EnableDiskSpill(const base::FilePath& directory,
+                       base::SequencedTaskRunner* file_task_runner,
+                       int64 in_memory_limit);
+
   void StartBuildingBlob(const GURL& url);
   void AppendBlobDataItem(const GURL& url, const BlobData::Item& data_item);
   void FinishBuildingBlob(const GURL& url, const std::string& content_type);
@@ -37,11 +56,24 @@ class WEBKIT_STORAGE_EXPORT BlobStorageController {
   void RemoveBlob(const GURL& url);
   BlobData* GetBlobDataFromUrl(const GURL& url);
 
+  // Bytes of the buffers held by registered blobs.
+  int64 memory_usage() const { return memory_usage_; }
+
  private:
   friend class ViewBlobInternalsJob;
 
   typedef base::hash_map<std::string, scoped_refptr<BlobData> > BlobMap;
   typedef std::map<BlobData*, int> BlobDataUsageMap;
+  typedef std::map<base::RefCountedMemory*, int> BufferUsageMap;
+
+  // Appends a slice of the TYPE_BYTES item at |index| of |src_blob_data|,
+  // without copying it unless it is small next to its buffer.
+  void AppendSharedBytesItem(BlobData* target_blob_data,
+                             BlobData* src_blob_data,
+                             size_t index, uint64 offset, uint64 length);
+  void AppendBuffer(BlobData* target_blob_data,
+                    base::RefCountedMemory* buffer,
+                    size_t offset, size_t length);
 
   void AppendStorageItems(BlobData* target_blob_data,
                           BlobData* src_blob_data,
@@ -62,18 +94,49 @@ class WEBKIT_STORAGE_EXPORT BlobStorageController {
   // Returns true if no longer in use.
   bool DecrementBlobDataUsage(BlobData* blob_data);
 
+  void IncrementBufferUsage(base::RefCountedMemory* buffer);
+  void DecrementBufferUsage(base::RefCountedMemory* buffer);
+  // Drops the buffers of a BlobData that is no longer in use.
+  void ReleaseBuffers(BlobData* blob_data);
+
+  // Starts spilling blobs until the buffers that stay in memory fit within
+  // |in_memory_limit_|.
+  void SpillIfNeeded();
+  void SpillBlobData(BlobData* blob_data);
+  // Replaces |blob_data| by a copy whose first |item_count| items refer to
+  // |file_path| instead of memory. |file_path| is empty if writing failed.
+  void DidSpillBlobData(scoped_refptr<BlobData> blob_data,
+                        size_t item_count,
+                        int64 spilled_bytes,
+                        const base::FilePath& file_path);
+  void ReplaceInMap(BlobMap* map, BlobData* old_blob_data,
+                    BlobData* new_blob_data);
+
   BlobMap blob_map_;
   BlobMap unfinalized_blob_map_;
 
   // Used to keep track of how much memory is being utitlized for blob data,
-  // we count only the items of TYPE_DATA which are held in memory and not
-  // items of TYPE_FILE.
+  // we count the buffers backing the items of TYPE_BYTES once no matter how
+  // many blobs share them, and not items of TYPE_FILE.
   int64 memory_usage_;
 
   // Multiple urls can refer to the same blob data, this map keeps track of
   // how many urls refer to a BlobData.
   BlobDataUsageMap blob_data_usage_count_;
 
+  // How many items of the blobs in use refer to each buffer.
+  BufferUsageMap buffer_usage_count_;
+
+  // Disk spill, |file_task_runner_| is NULL while it's disabled.
+  base::FilePath spill_directory_;
+  scoped_refptr<base::SequencedTaskRunner> file_task_runner_;
+  int64 in_memory_limit_;
+  // Bytes being written by spills that haven't completed yet.
+  int64 pending_spill_bytes_;
+  std::set<BlobData*> blobs_being_spilled_;
+
+  base::WeakPtrFactory<BlobStorageController> weak_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(BlobStorageController);
 };
 
@@ -14,6 +14,7 @@
 #include "webkit/database/database_util.h"
 #include "webkit/dom_storage/dom_storage_map.h"
 #include "webkit/dom_storage/dom_storage_namespace.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 #include "webkit/dom_storage/dom_storage_task_runner.h"
 #include "webkit/dom_storage/dom_storage_types.h"
 #include "webkit/dom_storage/local_storage_database_adapter.h"
@@ -37,6 +38,10 @@ DomStorageArea::CommitBatch::~CommitBatch() {}
 const base::FilePath::CharType DomStorageArea::kDatabaseFileExtension[] =
     FILE_PATH_LITERAL(".localstorage");
 
+// static
+const base::FilePath::CharType DomStorageArea::kLevelDBDirectoryExtension[] =
+    FILE_PATH_LITERAL(".leveldb");
+
 // static
 base::FilePath DomStorageArea::DatabaseFileNameFromOrigin(const GURL& origin) {
   std::string filename = fileapi::GetOriginIdentifierFromURL(origin);
@@ -47,9 +52,18 @@ base::FilePath DomStorageArea::DatabaseFileNameFromOrigin(const GURL& origin) {
       InsertBeforeExtensionASCII(filename);
 }
 
+// static
+base::FilePath DomStorageArea::LevelDBDirectoryNameFromOrigin(
+    const GURL& origin) {
+  std::string directory_name = fileapi::GetOriginIdentifierFromURL(origin);
+  return base::FilePath().Append(kLevelDBDirectoryExtension).
+      InsertBeforeExtensionASCII(directory_name);
+}
+
 // static
 GURL DomStorageArea::OriginFromDatabaseFileName(const base::FilePath& name) {
-  DCHECK(name.MatchesExtension(kDatabaseFileExtension));
+  DCHECK(name.MatchesExtension(kDatabaseFileExtension) ||
+         name.MatchesExtension(kLevelDBDirectoryExtension));
   WebKit::WebString origin_id = webkit_base::FilePathToWebString(
       name.BaseName().RemoveExtension());
   return DatabaseUtil::GetOriginFromIdentifier(origin_id);
@@ -61,12 +75,14 @@ DomStorageArea::DomStorageArea(const GURL& origin, const base::FilePath& directo
       directory_(directory),
       task_runner_(task_runner),
       map_(new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance)),
+      version_(0),
       is_initial_import_done_(true),
       is_shutdown_(false),
       commit_batches_in_flight_(0) {
   if (!directory.empty()) {
-    base::FilePath path = directory.Append(DatabaseFileNameFromOrigin(origin_));
-    backing_.reset(new LocalStorageDatabaseAdapter(path));
+    backing_.reset(new LocalStorageDatabaseAdapter(
+        directory.Append(LevelDBDirectoryNameFromOrigin(origin_)),
+        directory.Append(DatabaseFileNameFromOrigin(origin_))));
     is_initial_import_done_ = false;
   }
 }
@@ -82,6 +98,7 @@ DomStorageArea::DomStorageArea(
       origin_(origin),
       task_runner_(task_runner),
       map_(new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance)),
+      version_(0),
       session_storage_backing_(session_storage_backing),
       is_initial_import_done_(true),
       is_shutdown_(false),
@@ -104,6 +121,15 @@ void DomStorageArea::ExtractValues(ValuesMap* map) {
   map_->ExtractValues(map);
 }
 
+scoped_refptr<DomStorageSnapshot> DomStorageArea::GetSnapshot() {
+  if (is_shutdown_)
+    return NULL;
+  InitialImportIfNeeded();
+  if (!snapshot_)
+    snapshot_ = map_->CreateSnapshot(version_);
+  return snapshot_;
+}
+
 unsigned DomStorageArea::Length() {
   if (is_shutdown_)
     return 0;
@@ -134,6 +160,8 @@ bool DomStorageArea::SetItem(const string16& key,
   if (!map_->HasOneRef())
     map_ = map_->DeepCopy();
   bool success = map_->SetItem(key, value, old_value);
+  if (success)
+    OnValuesChanged();
   if (success && backing_.get()) {
     CommitBatch* commit_batch = CreateCommitBatchIfNeeded();
     commit_batch->changed_values[key] = NullableString16(value, false);
@@ -148,6 +176,8 @@ bool DomStorageArea::RemoveItem(const string16& key, string16* old_value) {
   if (!map_->HasOneRef())
     map_ = map_->DeepCopy();
   bool success = map_->RemoveItem(key, old_value);
+  if (success)
+    OnValuesChanged();
   if (success && backing_.get()) {
     CommitBatch* commit_batch = CreateCommitBatchIfNeeded();
     commit_batch->changed_values[key] = NullableString16(true);
@@ -163,6 +193,7 @@ bool DomStorageArea::Clear() {
     return false;
 
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
+  OnValuesChanged();
 
   if (backing_.get()) {
     CommitBatch* commit_batch = CreateCommitBatchIfNeeded();
@@ -181,6 +212,7 @@ void DomStorageArea::FastClear() {
     return;
 
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
+  OnValuesChanged();
   // This ensures no import will happen while we're waiting to clear the data
   // from the database. This mechanism fails if PurgeMemory is called.
   is_initial_import_done_ = true;
@@ -233,6 +265,7 @@ void DomStorageArea::DeleteOrigin() {
     return;
   }
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
+  OnValuesChanged();
   if (backing_.get()) {
     is_initial_import_done_ = false;
     backing_->Reset();
@@ -249,12 +282,14 @@ void DomStorageArea::PurgeMemory() {
       HasUncommittedChanges())  // We leave things alone with changes pending.
     return;
 
-  // Drop the in memory cache, we'll reload when needed.
+  // Drop the in memory cache, we'll reload when needed. The values are
+  // unchanged, so the version stays.
   is_initial_import_done_ = false;
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
+  snapshot_ = NULL;
 
-  // Recreate the database object, this frees up the open sqlite connection
-  // and its page cache.
+  // Recreate the database object, this frees up the open leveldb database
+  // and its caches.
   backing_->Reset();
 }
 
@@ -262,6 +297,7 @@ void DomStorageArea::Shutdown() {
   DCHECK(!is_shutdown_);
   is_shutdown_ = true;
   map_ = NULL;
+  snapshot_ = NULL;
   if (!backing_.get())
     return;
 
@@ -376,6 +412,11 @@ void DomStorageArea::OnCommitComplete() {
   }
 }
 
+void DomStorageArea::OnValuesChanged() {
+  ++version_;
+  snapshot_ = NULL;
+}
+
 void DomStorageArea::ShutdownInCommitSequence() {
   // This method executes on the commit sequence.
   DCHECK(task_runner_->IsRunningOnCommitSequence());
@@ -19,6 +19,7 @@ namespace dom_storage {
 
 class DomStorageDatabaseAdapter;
 class DomStorageMap;
+class DomStorageSnapshot;
 class DomStorageTaskRunner;
 class SessionStorageDatabase;
 
@@ -29,8 +30,16 @@ class WEBKIT_STORAGE_EXPORT DomStorageArea
     : public base::RefCountedThreadSafe<DomStorageArea> {
 
  public:
+  // Local storage used to live in a sqlite file per origin, named with
+  // kDatabaseFileExtension. It now lives in a leveldb directory per origin,
+  // named with kLevelDBDirectoryExtension, and the old files are imported
+  // when their area is first read.
   static const base::FilePath::CharType kDatabaseFileExtension[];
+  static const base::FilePath::CharType kLevelDBDirectoryExtension[];
   static base::FilePath DatabaseFileNameFromOrigin(const GURL& origin);
+  static base::FilePath LevelDBDirectoryNameFromOrigin(const GURL& origin);
+
+  // Returns the origin of a file or directory named by one of the above.
   static GURL OriginFromDatabaseFileName(const base::FilePath& file_name);
 
   // Local storage. Backed on disk if directory is nonempty.
@@ -48,9 +57,18 @@ class WEBKIT_STORAGE_EXPORT DomStorageArea
   const GURL& origin() const { return origin_; }
   int64 namespace_id() const { return namespace_id_; }
 
+  // Incremented by every change to the values. Mutation events carry it
+  // so that renderers can tell which ones their snapshot already reflects.
+  int64 version() const { return version_; }
+
   // Writes a copy of the current set of values in the area to the |map|.
   void ExtractValues(ValuesMap* map);
 
+  // Returns a snapshot of the current set of values. The snapshot is
+  // kept and handed out again until the values change. Returns NULL if
+  // the area is shut down or the snapshot can't be created.
+  scoped_refptr<DomStorageSnapshot> GetSnapshot();
+
   unsigned Length();
   NullableString16 Key(unsigned index);
   NullableString16 GetItem(const string16& key);
@@ -88,7 +106,9 @@ class WEBKIT_STORAGE_EXPORT DomStorageArea
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, CommitTasks);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, CommitChangesAtShutdown);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, DeleteOrigin);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, ImportLegacyDatabase);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, PurgeMemory);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, Snapshots);
   FRIEND_TEST_ALL_PREFIXES(DomStorageContextTest, PersistentIds);
   friend class base::RefCountedThreadSafe<DomStorageArea>;
 
@@ -116,12 +136,17 @@ class WEBKIT_STORAGE_EXPORT DomStorageArea
 
   void ShutdownInCommitSequence();
 
+  // Moves to the next version after a change to the values.
+  void OnValuesChanged();
+
   int64 namespace_id_;
   std::string persistent_namespace_id_;
   GURL origin_;
   base::FilePath directory_;
   scoped_refptr<DomStorageTaskRunner> task_runner_;
   scoped_refptr<DomStorageMap> map_;
+  int64 version_;
+  scoped_refptr<DomStorageSnapshot> snapshot_;
   scoped_ptr<DomStorageDatabaseAdapter> backing_;
   scoped_refptr<SessionStorageDatabase> session_storage_backing_;
   bool is_initial_import_done_;
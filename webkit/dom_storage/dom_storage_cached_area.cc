@@ -9,6 +9,7 @@
 #include "base/metrics/histogram.h"
 #include "webkit/dom_storage/dom_storage_map.h"
 #include "webkit/dom_storage/dom_storage_proxy.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 
 namespace dom_storage {
 
@@ -16,7 +17,8 @@ DomStorageCachedArea::DomStorageCachedArea(
     int64 namespace_id, const GURL& origin, DomStorageProxy* proxy)
     : ignore_all_mutations_(false),
       namespace_id_(namespace_id), origin_(origin),
-      proxy_(proxy), weak_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)) {
+      snapshot_version_(0), proxy_(proxy),
+      weak_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)) {
 }
 
 DomStorageCachedArea::~DomStorageCachedArea() {
@@ -24,19 +26,19 @@ DomStorageCachedArea::~DomStorageCachedArea() {
 
 unsigned DomStorageCachedArea::GetLength(int connection_id) {
   PrimeIfNeeded(connection_id);
-  return map_->Length();
+  return snapshot_ ? snapshot_->Length() : map_->Length();
 }
 
 NullableString16 DomStorageCachedArea::GetKey(
     int connection_id, unsigned index) {
   PrimeIfNeeded(connection_id);
-  return map_->Key(index);
+  return snapshot_ ? snapshot_->Key(index) : map_->Key(index);
 }
 
 NullableString16 DomStorageCachedArea::GetItem(
     int connection_id, const string16& key) {
   PrimeIfNeeded(connection_id);
-  return map_->GetItem(key);
+  return snapshot_ ? snapshot_->GetItem(key) : map_->GetItem(key);
 }
 
 bool DomStorageCachedArea::SetItem(
@@ -48,6 +50,7 @@ bool DomStorageCachedArea::SetItem(
     return false;
 
   PrimeIfNeeded(connection_id);
+  DetachFromSnapshot();
   NullableString16 unused;
   if (!map_->SetItem(key, value, &unused))
     return false;
@@ -64,6 +67,7 @@ bool DomStorageCachedArea::SetItem(
 void DomStorageCachedArea::RemoveItem(
     int connection_id, const string16& key, const GURL& page_url) {
   PrimeIfNeeded(connection_id);
+  DetachFromSnapshot();
   string16 unused;
   if (!map_->RemoveItem(key, &unused))
     return;
@@ -90,12 +94,19 @@ void DomStorageCachedArea::Clear(int connection_id, const GURL& page_url) {
 }
 
 void DomStorageCachedArea::ApplyMutation(
-    const NullableString16& key, const NullableString16& new_value) {
-  if (!map_ || ignore_all_mutations_)
+    const NullableString16& key, const NullableString16& new_value,
+    int64 version) {
+  if ((!map_ && !snapshot_) || ignore_all_mutations_)
+    return;
+
+  // The events of the mutations made before the snapshot was taken may
+  // still be in flight, the snapshot already reflects them.
+  if (version <= snapshot_version_)
     return;
 
   if (key.is_null()) {
     // It's a clear event.
+    DetachFromSnapshot();
     scoped_refptr<DomStorageMap> old = map_;
     map_ = new DomStorageMap(dom_storage::kPerAreaQuota);
 
@@ -117,6 +128,7 @@ void DomStorageCachedArea::ApplyMutation(
   if (should_ignore_key_mutation(key.string()))
     return;
 
+  DetachFromSnapshot();
   if (new_value.is_null()) {
     // It's a remove item event.
     string16 unused;
@@ -134,24 +146,22 @@ void DomStorageCachedArea::ApplyMutation(
 }
 
 size_t DomStorageCachedArea::MemoryBytesUsedByCache() const {
+  if (snapshot_)
+    return snapshot_->size();
   return map_ ? map_->bytes_used() : 0;
 }
 
 void DomStorageCachedArea::Prime(int connection_id) {
   DCHECK(!map_);
+  DCHECK(!snapshot_);
 
-  // The LoadArea method is actually synchronous, but we have to
-  // wait for an asyncly delivered message to know when incoming
-  // mutation events should be applied. Our valuemap is plucked
-  // from ipc stream out of order, mutations in front if it need
-  // to be ignored.
-
-  // Ignore all mutations until OnLoadComplete time.
-  ignore_all_mutations_ = true;
-  ValuesMap values;
+  // The LoadArea method is synchronous. Mutation events that were queued
+  // in front of the reply are ignored by comparing their version with the
+  // version of the snapshot, so there is no need to wait for the
+  // completion notification before applying them.
   base::TimeTicks before = base::TimeTicks::Now();
   proxy_->LoadArea(
-      connection_id, &values,
+      connection_id, &snapshot_,
       base::Bind(&DomStorageCachedArea::OnLoadComplete,
                  weak_factory_.GetWeakPtr()));
   base::TimeDelta time_to_prime = base::TimeTicks::Now() - before;
@@ -159,10 +169,16 @@ void DomStorageCachedArea::Prime(int connection_id) {
   // to maintain histogram continuity.
   UMA_HISTOGRAM_TIMES("LocalStorage.TimeToPrimeLocalStorage",
                       time_to_prime);
-  map_ = new DomStorageMap(dom_storage::kPerAreaQuota);
-  map_->SwapValues(&values);
+  size_t bytes_used = 0;
+  if (snapshot_) {
+    snapshot_version_ = snapshot_->version();
+    bytes_used = snapshot_->bytes_used();
+  } else {
+    // The load failed, carry on with an empty cache.
+    map_ = new DomStorageMap(dom_storage::kPerAreaQuota);
+  }
 
-  size_t local_storage_size_kb = map_->bytes_used() / 1024;
+  size_t local_storage_size_kb = bytes_used / 1024;
   // Track localStorage size, from 0-6MB. Note that the maximum size should be
   // 5MB, but we add some slop since we want to make sure the max size is always
   // above what we see in practice, since histograms can't change.
@@ -184,7 +200,19 @@ void DomStorageCachedArea::Prime(int connection_id) {
   }
 }
 
+void DomStorageCachedArea::DetachFromSnapshot() {
+  if (!snapshot_)
+    return;
+  ValuesMap values;
+  snapshot_->ExtractValues(&values);
+  map_ = new DomStorageMap(dom_storage::kPerAreaQuota);
+  map_->SwapValues(&values);
+  snapshot_ = NULL;
+}
+
 void DomStorageCachedArea::Reset() {
+  snapshot_ = NULL;
+  snapshot_version_ = 0;
   map_ = NULL;
   weak_factory_.InvalidateWeakPtrs();
   ignore_key_mutations_.clear();
@@ -193,8 +221,6 @@ void DomStorageCachedArea::Reset() {
 
 void DomStorageCachedArea::OnLoadComplete(bool success) {
   DCHECK(success);
-  DCHECK(ignore_all_mutations_);
-  ignore_all_mutations_ = false;
 }
 
 void DomStorageCachedArea::OnSetItemComplete(
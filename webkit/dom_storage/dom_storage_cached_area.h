@@ -17,13 +17,15 @@ namespace dom_storage {
 
 class DomStorageMap;
 class DomStorageProxy;
+class DomStorageSnapshot;
 
 // Unlike the other classes in the dom_storage library, this one is intended
 // for use in renderer processes. It maintains a complete cache of the
 // origin's Map of key/value pairs for fast access. The cache is primed on
-// first access and changes are written to the backend thru the |proxy|.
-// Mutations originating in other processes are applied to the cache via
-// the ApplyMutation method.
+// first access from a shared snapshot of the area, which serves reads until
+// the cache is first changed, and changes are written to the backend thru
+// the |proxy|. Mutations originating in other processes are applied to the
+// cache via the ApplyMutation method.
 class WEBKIT_STORAGE_EXPORT DomStorageCachedArea :
       public base::RefCounted<DomStorageCachedArea> {
  public:
@@ -42,8 +44,11 @@ class WEBKIT_STORAGE_EXPORT DomStorageCachedArea :
                   const GURL& page_url);
   void Clear(int connection_id, const GURL& page_url);
 
+  // |version| is the version of the area after the mutation, mutations
+  // the snapshot the cache was primed from already reflects are ignored.
   void ApplyMutation(const NullableString16& key,
-                     const NullableString16& new_value);
+                     const NullableString16& new_value,
+                     int64 version);
 
   size_t MemoryBytesUsedByCache() const;
 
@@ -55,10 +60,14 @@ class WEBKIT_STORAGE_EXPORT DomStorageCachedArea :
   // Primes the cache, loading all values for the area.
   void Prime(int connection_id);
   void PrimeIfNeeded(int connection_id) {
-    if (!map_)
+    if (!map_ && !snapshot_)
       Prime(connection_id);
   }
 
+  // Copies the values of |snapshot_| into |map_| before the cache is
+  // changed.
+  void DetachFromSnapshot();
+
   // Resets the object back to its newly constructed state.
   void Reset();
 
@@ -80,6 +89,9 @@ class WEBKIT_STORAGE_EXPORT DomStorageCachedArea :
 
   int64 namespace_id_;
   GURL origin_;
+  // Only one of |snapshot_| and |map_| is set once the cache is primed.
+  scoped_refptr<DomStorageSnapshot> snapshot_;
+  int64 snapshot_version_;
   scoped_refptr<DomStorageMap> map_;
   scoped_refptr<DomStorageProxy> proxy_;
   base::WeakPtrFactory<DomStorageCachedArea> weak_factory_;
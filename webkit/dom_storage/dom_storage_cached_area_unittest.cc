@@ -9,6 +9,7 @@
 #include "testing/gtest/include/gtest/gtest.h"
 #include "webkit/dom_storage/dom_storage_cached_area.h"
 #include "webkit/dom_storage/dom_storage_proxy.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 
 namespace dom_storage {
 
@@ -16,18 +17,20 @@ namespace {
 // A mock implementation of the DomStorageProxy interface.
 class MockProxy : public DomStorageProxy {
  public:
-  MockProxy() {
+  MockProxy() : load_area_return_version_(0) {
     ResetObservations();
   }
 
   // DomStorageProxy interface for use by DomStorageCachedArea.
 
-  virtual void LoadArea(int connection_id, ValuesMap* values,
+  virtual void LoadArea(int connection_id,
+                        scoped_refptr<DomStorageSnapshot>* snapshot,
                         const CompletionCallback& callback) OVERRIDE {
     pending_callbacks_.push_back(callback);
     observed_load_area_ = true;
     observed_connection_id_ = connection_id;
-    *values = load_area_return_values_;
+    *snapshot = DomStorageSnapshot::Create(load_area_return_values_,
+                                           load_area_return_version_);
   }
 
   virtual void SetItem(int connection_id, const string16& key,
@@ -87,6 +90,7 @@ class MockProxy : public DomStorageProxy {
   typedef std::list<CompletionCallback> CallbackList;
 
   ValuesMap load_area_return_values_;
+  int64 load_area_return_version_;
   CallbackList pending_callbacks_;
   bool observed_load_area_;
   bool observed_set_item_;
@@ -123,7 +127,11 @@ class DomStorageCachedAreaTest : public testing::Test {
   }
 
   bool IsPrimed(DomStorageCachedArea* cached_area) {
-    return cached_area->map_.get();
+    return cached_area->map_.get() || cached_area->snapshot_.get();
+  }
+
+  bool IsReadingFromSnapshot(DomStorageCachedArea* cached_area) {
+    return cached_area->snapshot_.get() != NULL;
   }
 
   bool IsIgnoringAllMutations(DomStorageCachedArea* cached_area) {
@@ -157,7 +165,7 @@ TEST_F(DomStorageCachedAreaTest, Basics) {
   EXPECT_EQ(kOrigin, cached_area->origin());
   EXPECT_FALSE(mock_proxy_->HasOneRef());
   cached_area->ApplyMutation(NullableString16(kKey, false),
-                             NullableString16(kValue, false));
+                             NullableString16(kValue, false), 1);
   EXPECT_FALSE(IsPrimed(cached_area));
 
   ResetAll(cached_area);
@@ -186,7 +194,7 @@ TEST_F(DomStorageCachedAreaTest, Getters) {
   EXPECT_TRUE(mock_proxy_->observed_load_area_);
   EXPECT_EQ(kConnectionId, mock_proxy_->observed_connection_id_);
   EXPECT_EQ(1u, mock_proxy_->pending_callbacks_.size());
-  EXPECT_TRUE(IsIgnoringAllMutations(cached_area));
+  EXPECT_FALSE(IsIgnoringAllMutations(cached_area));
   mock_proxy_->CompleteAllPendingCallbacks();
   EXPECT_FALSE(IsIgnoringAllMutations(cached_area));
 
@@ -263,27 +271,63 @@ TEST_F(DomStorageCachedAreaTest, Setters) {
   EXPECT_EQ(2u, mock_proxy_->pending_callbacks_.size());
 }
 
-TEST_F(DomStorageCachedAreaTest, MutationsAreIgnoredUntilLoadCompletion) {
+TEST_F(DomStorageCachedAreaTest, ReadsAreServedFromSnapshot) {
+  const int kConnectionId = 7;
+  const string16 kKey2(ASCIIToUTF16("key2"));
+  mock_proxy_->load_area_return_values_[kKey] = NullableString16(kValue, false);
+  mock_proxy_->load_area_return_values_[kKey2] =
+      NullableString16(kValue, false);
+  scoped_refptr<DomStorageCachedArea> cached_area =
+      new DomStorageCachedArea(kNamespaceId, kOrigin, mock_proxy_);
+
+  // Reads don't copy the snapshot.
+  EXPECT_EQ(2u, cached_area->GetLength(kConnectionId));
+  EXPECT_TRUE(IsReadingFromSnapshot(cached_area));
+  EXPECT_EQ(kKey, cached_area->GetKey(kConnectionId, 0).string());
+  EXPECT_EQ(kKey2, cached_area->GetKey(kConnectionId, 1).string());
+  EXPECT_TRUE(cached_area->GetKey(kConnectionId, 2).is_null());
+  EXPECT_EQ(kValue, cached_area->GetItem(kConnectionId, kKey).string());
+  EXPECT_TRUE(cached_area->GetItem(kConnectionId, kValue).is_null());
+  EXPECT_TRUE(IsReadingFromSnapshot(cached_area));
+  EXPECT_LT(0u, cached_area->MemoryBytesUsedByCache());
+
+  // The first change copies it into the map.
+  cached_area->RemoveItem(kConnectionId, kKey, kPageUrl);
+  EXPECT_FALSE(IsReadingFromSnapshot(cached_area));
+  EXPECT_TRUE(IsPrimed(cached_area));
+  EXPECT_EQ(1u, cached_area->GetLength(kConnectionId));
+  EXPECT_EQ(kKey2, cached_area->GetKey(kConnectionId, 0).string());
+  EXPECT_EQ(kValue, cached_area->GetItem(kConnectionId, kKey2).string());
+}
+
+TEST_F(DomStorageCachedAreaTest, MutationsReflectedInSnapshotAreIgnored) {
   const int kConnectionId = 7;
+  const string16 kValue2(ASCIIToUTF16("value2"));
+  mock_proxy_->load_area_return_version_ = 5;
   scoped_refptr<DomStorageCachedArea> cached_area =
       new DomStorageCachedArea(kNamespaceId, kOrigin, mock_proxy_);
   EXPECT_TRUE(cached_area->GetItem(kConnectionId, kKey).is_null());
   EXPECT_TRUE(IsPrimed(cached_area));
-  EXPECT_TRUE(IsIgnoringAllMutations(cached_area));
+  EXPECT_FALSE(IsIgnoringAllMutations(cached_area));
 
-  // Before load completion, the mutation should be ignored.
+  // Mutations up to the version of the snapshot are ignored, whether or
+  // not the load has completed.
   cached_area->ApplyMutation(NullableString16(kKey, false),
-                             NullableString16(kValue, false));
+                             NullableString16(kValue, false), 5);
   EXPECT_TRUE(cached_area->GetItem(kConnectionId, kKey).is_null());
+  EXPECT_TRUE(IsReadingFromSnapshot(cached_area));
 
-  // Call the load completion callback.
+  // Later ones are applied.
+  cached_area->ApplyMutation(NullableString16(kKey, false),
+                             NullableString16(kValue2, false), 6);
+  EXPECT_EQ(kValue2, cached_area->GetItem(kConnectionId, kKey).string());
   mock_proxy_->CompleteOnePendingCallback(true);
-  EXPECT_FALSE(IsIgnoringAllMutations(cached_area));
-
-  // Verify that mutations are now applied.
   cached_area->ApplyMutation(NullableString16(kKey, false),
-                             NullableString16(kValue, false));
+                             NullableString16(kValue, false), 7);
   EXPECT_EQ(kValue, cached_area->GetItem(kConnectionId, kKey).string());
+  cached_area->ApplyMutation(NullableString16(true),
+                             NullableString16(true), 8);
+  EXPECT_EQ(0u, cached_area->GetLength(kConnectionId));
 }
 
 TEST_F(DomStorageCachedAreaTest, MutationsAreIgnoredUntilClearCompletion) {
@@ -319,7 +363,7 @@ TEST_F(DomStorageCachedAreaTest, KeyMutationsAreIgnoredUntilCompletion) {
   EXPECT_FALSE(IsIgnoringAllMutations(cached_area));
   EXPECT_TRUE(IsIgnoringKeyMutations(cached_area, kKey));
   cached_area->ApplyMutation(NullableString16(kKey, false),
-                             NullableString16(true));
+                             NullableString16(true), 1);
   EXPECT_EQ(kValue, cached_area->GetItem(kConnectionId, kKey).string());
   mock_proxy_->CompleteOnePendingCallback(true);  // set completion
   EXPECT_FALSE(IsIgnoringKeyMutations(cached_area, kKey));
@@ -4,6 +4,8 @@
 
 #include "webkit/dom_storage/dom_storage_context.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/file_util.h"
@@ -24,6 +26,22 @@ namespace dom_storage {
 
 static const int kSessionStoraceScavengingSeconds = 60;
 
+// Returns the size and the time of the last write of a leveldb directory.
+static void GetDirectoryInfo(const base::FilePath& path,
+                             size_t* size,
+                             base::Time* last_modified) {
+  *size = 0;
+  FileEnumerator enumerator(path, false, FileEnumerator::FILES);
+  for (base::FilePath file = enumerator.Next(); !file.empty();
+       file = enumerator.Next()) {
+    FileEnumerator::FindInfo find_info;
+    enumerator.GetFindInfo(&find_info);
+    *size += FileEnumerator::GetFilesize(find_info);
+    *last_modified = std::max(*last_modified,
+                              FileEnumerator::GetLastModifiedTime(find_info));
+  }
+}
+
 DomStorageContext::DomStorageContext(
     const base::FilePath& localstorage_directory,
     const base::FilePath& sessionstorage_directory,
@@ -87,21 +105,43 @@ void DomStorageContext::GetLocalStorageUsage(
     bool include_file_info) {
   if (localstorage_directory_.empty())
     return;
+  // An origin whose sqlite file hasn't been imported yet, or failed to
+  // be, may have both a file and a leveldb directory.
+  std::map<GURL, size_t> origin_indices;
   FileEnumerator enumerator(localstorage_directory_, false,
-                            FileEnumerator::FILES);
+                            FileEnumerator::FILES |
+                            FileEnumerator::DIRECTORIES);
   for (base::FilePath path = enumerator.Next(); !path.empty();
        path = enumerator.Next()) {
-    if (path.MatchesExtension(DomStorageArea::kDatabaseFileExtension)) {
-      LocalStorageUsageInfo info;
-      info.origin = DomStorageArea::OriginFromDatabaseFileName(path);
-      if (include_file_info) {
+    bool is_leveldb =
+        path.MatchesExtension(DomStorageArea::kLevelDBDirectoryExtension);
+    if (!is_leveldb &&
+        !path.MatchesExtension(DomStorageArea::kDatabaseFileExtension)) {
+      continue;
+    }
+    LocalStorageUsageInfo info;
+    info.origin = DomStorageArea::OriginFromDatabaseFileName(path);
+    if (include_file_info) {
+      if (is_leveldb) {
+        GetDirectoryInfo(path, &info.data_size, &info.last_modified);
+      } else {
         FileEnumerator::FindInfo find_info;
         enumerator.GetFindInfo(&find_info);
         info.data_size = FileEnumerator::GetFilesize(find_info);
         info.last_modified = FileEnumerator::GetLastModifiedTime(find_info);
       }
+    }
+    std::map<GURL, size_t>::iterator found =
+        origin_indices.find(info.origin);
+    if (found == origin_indices.end()) {
+      origin_indices[info.origin] = infos->size();
       infos->push_back(info);
+      continue;
     }
+    LocalStorageUsageInfo& existing = (*infos)[found->second];
+    existing.data_size += info.data_size;
+    existing.last_modified =
+        std::max(existing.last_modified, info.last_modified);
   }
 }
 
@@ -313,12 +353,16 @@ void DomStorageContext::ClearSessionOnlyOrigins() {
         continue;
 
       const bool kNotRecursive = false;
+      const bool kRecursive = true;
       base::FilePath database_file_path = localstorage_directory_.Append(
           DomStorageArea::DatabaseFileNameFromOrigin(origin));
       file_util::Delete(database_file_path, kNotRecursive);
       file_util::Delete(
           DomStorageDatabase::GetJournalFilePath(database_file_path),
           kNotRecursive);
+      file_util::Delete(localstorage_directory_.Append(
+          DomStorageArea::LevelDBDirectoryNameFromOrigin(origin)),
+          kRecursive);
     }
   }
   if (session_storage_database_.get()) {
@@ -8,6 +8,7 @@
 #include "webkit/dom_storage/dom_storage_area.h"
 #include "webkit/dom_storage/dom_storage_context.h"
 #include "webkit/dom_storage/dom_storage_namespace.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 #include "webkit/dom_storage/dom_storage_types.h"
 
 namespace dom_storage {
@@ -51,17 +52,17 @@ void DomStorageHost::CloseStorageArea(int connection_id) {
   connections_.erase(found);
 }
 
-bool DomStorageHost::ExtractAreaValues(
-    int connection_id, ValuesMap* map) {
-  map->clear();
+bool DomStorageHost::GetAreaSnapshot(
+    int connection_id, scoped_refptr<DomStorageSnapshot>* snapshot) {
   DomStorageArea* area = GetOpenArea(connection_id);
   if (!area) {
     // TODO(michaeln): Fix crbug/134003 and return false here.
-    // Until then return true to avoid crashing the renderer
+    // Until then hand out an empty snapshot to avoid crashing the renderer
     // for sending a bad message.
+    *snapshot = DomStorageSnapshot::Create(ValuesMap(), 0);
     return true;
   }
-  area->ExtractValues(map);
+  *snapshot = area->GetSnapshot();
   return true;
 }
 
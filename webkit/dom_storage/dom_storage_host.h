@@ -21,6 +21,7 @@ class DomStorageContext;
 class DomStorageHost;
 class DomStorageNamespace;
 class DomStorageArea;
+class DomStorageSnapshot;
 
 // One instance is allocated in the main process for each client process.
 // Used by DomStorageMessageFilter in Chrome and by SimpleDomStorage in DRT.
@@ -35,7 +36,10 @@ class WEBKIT_STORAGE_EXPORT DomStorageHost {
   bool OpenStorageArea(int connection_id, int namespace_id,
                        const GURL& origin);
   void CloseStorageArea(int connection_id);
-  bool ExtractAreaValues(int connection_id, ValuesMap* map);
+  // Sets |snapshot| to the current snapshot of the area, which may be NULL
+  // if it can't be created.
+  bool GetAreaSnapshot(int connection_id,
+                       scoped_refptr<DomStorageSnapshot>* snapshot);
   unsigned GetAreaLength(int connection_id);
   NullableString16 GetAreaKey(int connection_id, unsigned index);
   NullableString16 GetAreaItem(int connection_id, const string16& key);
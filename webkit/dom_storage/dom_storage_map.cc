@@ -5,6 +5,7 @@
 #include "webkit/dom_storage/dom_storage_map.h"
 
 #include "base/logging.h"
+#include "webkit/dom_storage/dom_storage_snapshot.h"
 
 namespace {
 
@@ -114,6 +115,11 @@ DomStorageMap* DomStorageMap::DeepCopy() const {
   return copy;
 }
 
+scoped_refptr<DomStorageSnapshot> DomStorageMap::CreateSnapshot(
+    int64 version) const {
+  return DomStorageSnapshot::Create(values_, version);
+}
+
 void DomStorageMap::ResetKeyIterator() {
   key_iterator_ = values_.begin();
   last_key_index_ = 0;
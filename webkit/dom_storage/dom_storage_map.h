@@ -15,6 +15,8 @@
 
 namespace dom_storage {
 
+class DomStorageSnapshot;
+
 // A wrapper around a std::map that adds refcounting and
 // tracks the size in bytes of the keys/values, enforcing a quota.
 // See class comments for DomStorageContext for a larger overview.
@@ -42,6 +44,10 @@ class WEBKIT_STORAGE_EXPORT DomStorageMap
   // a deep copy of values_.
   DomStorageMap* DeepCopy() const;
 
+  // Returns a snapshot of values_ tagged with |version|, or NULL if
+  // the snapshot can't be created.
+  scoped_refptr<DomStorageSnapshot> CreateSnapshot(int64 version) const;
+
   size_t bytes_used() const { return bytes_used_; }
   size_t quota() const { return quota_; }
   void set_quota(size_t quota) { quota_ = quota; }
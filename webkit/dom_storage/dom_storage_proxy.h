@@ -14,12 +14,16 @@
 
 namespace dom_storage {
 
+class DomStorageSnapshot;
+
 // Abstract interface for cached area, renderer to browser communications.
 class DomStorageProxy : public base::RefCounted<DomStorageProxy> {
  public:
   typedef base::Callback<void(bool)> CompletionCallback;
 
-  virtual void LoadArea(int connection_id, ValuesMap* values,
+  // Sets |snapshot| to the values of the area, or to NULL on failure.
+  virtual void LoadArea(int connection_id,
+                        scoped_refptr<DomStorageSnapshot>* snapshot,
                         const CompletionCallback& callback) = 0;
 
   virtual void SetItem(int connection_id, const string16& key,
@@ -0,0 +1,195 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/dom_storage/dom_storage_snapshot.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace dom_storage {
+
+namespace {
+
+const uint32 kSnapshotMagic = 0x44535331;  // "DSS1"
+
+struct Header {
+  uint32 magic;
+  uint32 length;
+  int64 version;
+  uint64 bytes_used;
+};
+
+COMPILE_ASSERT(sizeof(Header) == 24, snapshot_header_size_mismatch);
+
+}  // namespace
+
+// static
+scoped_refptr<DomStorageSnapshot> DomStorageSnapshot::Create(
+    const ValuesMap& values, int64 version) {
+  // Areas are limited to a few megabytes by their quota, so the offsets
+  // always fit in 32 bits.
+  size_t data_chars = 0;
+  for (ValuesMap::const_iterator it = values.begin(); it != values.end();
+       ++it) {
+    DCHECK(!it->second.is_null());
+    data_chars += it->first.size() + it->second.string().size();
+  }
+
+  size_t size = sizeof(Header) + values.size() * sizeof(Entry) +
+      data_chars * sizeof(char16);
+  scoped_ptr<base::SharedMemory> shared_memory(new base::SharedMemory);
+  if (!shared_memory->CreateAndMapAnonymous(size))
+    return NULL;
+
+  char* base = static_cast<char*>(shared_memory->memory());
+  Header* header = reinterpret_cast<Header*>(base);
+  header->magic = kSnapshotMagic;
+  header->length = static_cast<uint32>(values.size());
+  header->version = version;
+  header->bytes_used = data_chars * sizeof(char16);
+  Entry* entries = reinterpret_cast<Entry*>(base + sizeof(Header));
+  char16* data = reinterpret_cast<char16*>(entries + values.size());
+  uint32 offset = 0;
+  for (ValuesMap::const_iterator it = values.begin(); it != values.end();
+       ++it, ++entries) {
+    const string16& key = it->first;
+    const string16& value = it->second.string();
+    entries->key_offset = offset;
+    entries->key_length = static_cast<uint32>(key.size());
+    std::copy(key.begin(), key.end(), data + offset);
+    offset += entries->key_length;
+    entries->value_offset = offset;
+    entries->value_length = static_cast<uint32>(value.size());
+    std::copy(value.begin(), value.end(), data + offset);
+    offset += entries->value_length;
+  }
+
+  scoped_refptr<DomStorageSnapshot> snapshot(
+      new DomStorageSnapshot(shared_memory.release()));
+  bool success = snapshot->Init(size);
+  DCHECK(success);
+  return snapshot;
+}
+
+// static
+scoped_refptr<DomStorageSnapshot> DomStorageSnapshot::Open(
+    base::SharedMemoryHandle handle, size_t size) {
+  if (!base::SharedMemory::IsHandleValid(handle))
+    return NULL;
+  const bool kReadOnly = true;
+  scoped_ptr<base::SharedMemory> shared_memory(
+      new base::SharedMemory(handle, kReadOnly));
+  if (!shared_memory->Map(size))
+    return NULL;
+  scoped_refptr<DomStorageSnapshot> snapshot(
+      new DomStorageSnapshot(shared_memory.release()));
+  if (!snapshot->Init(size))
+    return NULL;
+  return snapshot;
+}
+
+bool DomStorageSnapshot::ShareToProcess(
+    base::ProcessHandle process, base::SharedMemoryHandle* new_handle) {
+  return shared_memory_->ShareToProcess(process, new_handle);
+}
+
+NullableString16 DomStorageSnapshot::Key(unsigned index) const {
+  if (index >= length_)
+    return NullableString16(true);
+  return NullableString16(KeyAt(index), false);
+}
+
+NullableString16 DomStorageSnapshot::GetItem(const string16& key) const {
+  unsigned low = 0;
+  unsigned high = length_;
+  while (low < high) {
+    unsigned middle = low + (high - low) / 2;
+    int result = KeyAt(middle).compare(key);
+    if (result == 0)
+      return NullableString16(ValueAt(middle), false);
+    if (result < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return NullableString16(true);
+}
+
+void DomStorageSnapshot::ExtractValues(ValuesMap* map) const {
+  map->clear();
+  for (unsigned i = 0; i < length_; ++i) {
+    // The entries are in key order, so every insertion is at the end.
+    map->insert(map->end(), std::make_pair(
+        KeyAt(i), NullableString16(ValueAt(i), false)));
+  }
+}
+
+DomStorageSnapshot::DomStorageSnapshot(base::SharedMemory* shared_memory)
+    : shared_memory_(shared_memory),
+      size_(0),
+      version_(0),
+      bytes_used_(0),
+      length_(0),
+      data_(NULL),
+      data_chars_(0) {
+}
+
+DomStorageSnapshot::~DomStorageSnapshot() {
+}
+
+bool DomStorageSnapshot::Init(size_t size) {
+  if (size < sizeof(Header))
+    return false;
+  const char* base = static_cast<const char*>(shared_memory_->memory());
+  // Read every field once; a renderer may be changing them underneath us.
+  Header header_copy = *reinterpret_cast<const Header*>(base);
+  if (header_copy.magic != kSnapshotMagic ||
+      header_copy.length > (size - sizeof(Header)) / sizeof(Entry)) {
+    return false;
+  }
+
+  size_t data_offset = sizeof(Header) + header_copy.length * sizeof(Entry);
+  size_t data_chars = (size - data_offset) / sizeof(char16);
+  const Entry* shared_entries =
+      reinterpret_cast<const Entry*>(base + sizeof(Header));
+  std::vector<Entry> entries(shared_entries,
+                             shared_entries + header_copy.length);
+  for (uint32 i = 0; i < header_copy.length; ++i) {
+    const Entry& entry = entries[i];
+    if (entry.key_offset > data_chars ||
+        entry.key_length > data_chars - entry.key_offset ||
+        entry.value_offset > data_chars ||
+        entry.value_length > data_chars - entry.value_offset) {
+      return false;
+    }
+  }
+
+  size_ = size;
+  version_ = header_copy.version;
+  bytes_used_ = static_cast<size_t>(header_copy.bytes_used);
+  length_ = header_copy.length;
+  entries_.swap(entries);
+  data_ = reinterpret_cast<const char16*>(base + data_offset);
+  data_chars_ = data_chars;
+  return true;
+}
+
+string16 DomStorageSnapshot::KeyAt(unsigned index) const {
+  CHECK_LT(index, entries_.size());
+  return DataAt(entries_[index].key_offset, entries_[index].key_length);
+}
+
+string16 DomStorageSnapshot::ValueAt(unsigned index) const {
+  CHECK_LT(index, entries_.size());
+  return DataAt(entries_[index].value_offset, entries_[index].value_length);
+}
+
+string16 DomStorageSnapshot::DataAt(uint32 offset, uint32 length) const {
+  if (offset > data_chars_ || length > data_chars_ - offset)
+    return string16();
+  return string16(data_ + offset, length);
+}
+
+}  // namespace dom_storage
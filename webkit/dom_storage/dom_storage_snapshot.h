@@ -0,0 +1,104 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef WEBKIT_DOM_STORAGE_DOM_STORAGE_SNAPSHOT_H_
+#define WEBKIT_DOM_STORAGE_DOM_STORAGE_SNAPSHOT_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/nullable_string16.h"
+#include "base/process.h"
+#include "base/shared_memory.h"
+#include "base/string16.h"
+#include "webkit/dom_storage/dom_storage_types.h"
+#include "webkit/storage/webkit_storage_export.h"
+
+namespace dom_storage {
+
+// An immutable copy of the values of an area in shared memory, tagged with
+// the version of the area it was taken at. The main process takes one
+// snapshot per version of an area and shares it with every renderer that
+// primes its cache, so loading an area no longer copies and serializes the
+// whole map once per renderer. Renderers serve reads straight from it.
+//
+// The segment holds a header, an array of entries in key order and the
+// UTF-16 data of the keys and values the entries point into. Every renderer
+// sharing the segment can write to it, so the header and the entries are
+// copied out once they have been checked and only the data is read from the
+// segment.
+class WEBKIT_STORAGE_EXPORT DomStorageSnapshot
+    : public base::RefCountedThreadSafe<DomStorageSnapshot> {
+ public:
+  // Serializes |values| into a new segment. Returns NULL if the segment
+  // can't be created.
+  static scoped_refptr<DomStorageSnapshot> Create(const ValuesMap& values,
+                                                  int64 version);
+
+  // Maps a segment created by Create() in another process. Returns NULL if
+  // |handle| can't be mapped or doesn't hold a well formed snapshot.
+  static scoped_refptr<DomStorageSnapshot> Open(
+      base::SharedMemoryHandle handle, size_t size);
+
+  // Duplicates the handle of the segment for |process|.
+  bool ShareToProcess(base::ProcessHandle process,
+                      base::SharedMemoryHandle* new_handle);
+
+  int64 version() const { return version_; }
+
+  // Size of the segment.
+  size_t size() const { return size_; }
+
+  // Size of the keys and values, as counted by DomStorageMap.
+  size_t bytes_used() const { return bytes_used_; }
+
+  unsigned Length() const { return length_; }
+  NullableString16 Key(unsigned index) const;
+  NullableString16 GetItem(const string16& key) const;
+
+  // Writes a copy of the values to |map|.
+  void ExtractValues(ValuesMap* map) const;
+
+ private:
+  friend class base::RefCountedThreadSafe<DomStorageSnapshot>;
+
+  // Offsets and lengths are in characters, relative to the start of the data.
+  struct Entry {
+    uint32 key_offset;
+    uint32 key_length;
+    uint32 value_offset;
+    uint32 value_length;
+  };
+
+  explicit DomStorageSnapshot(base::SharedMemory* shared_memory);
+  ~DomStorageSnapshot();
+
+  // Checks that every entry lies within the segment and copies the header
+  // and the entries out of it.
+  bool Init(size_t size);
+
+  string16 KeyAt(unsigned index) const;
+  string16 ValueAt(unsigned index) const;
+
+  // Returns the |length| characters at |offset| in the data, or an empty
+  // string if they don't lie within it.
+  string16 DataAt(uint32 offset, uint32 length) const;
+
+  scoped_ptr<base::SharedMemory> shared_memory_;
+  size_t size_;
+  int64 version_;
+  size_t bytes_used_;
+  unsigned length_;
+  std::vector<Entry> entries_;
+  const char16* data_;
+  size_t data_chars_;
+
+  DISALLOW_COPY_AND_ASSIGN(DomStorageSnapshot);
+};
+
+}  // namespace dom_storage
+
+#endif  // WEBKIT_DOM_STORAGE_DOM_STORAGE_SNAPSHOT_H_
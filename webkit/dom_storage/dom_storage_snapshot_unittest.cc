@@ -0,0 +1,136 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/dom_storage/dom_storage_snapshot.h"
+
+#include "base/process_util.h"
+#include "base/utf_string_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/dom_storage/dom_storage_map.h"
+
+namespace dom_storage {
+
+TEST(DomStorageSnapshotTest, Empty) {
+  scoped_refptr<DomStorageSnapshot> snapshot =
+      DomStorageSnapshot::Create(ValuesMap(), 0);
+  ASSERT_TRUE(snapshot.get());
+  EXPECT_EQ(0u, snapshot->Length());
+  EXPECT_EQ(0, snapshot->version());
+  EXPECT_EQ(0u, snapshot->bytes_used());
+  EXPECT_TRUE(snapshot->Key(0).is_null());
+  EXPECT_TRUE(snapshot->GetItem(string16()).is_null());
+  ValuesMap values;
+  values[string16()] = NullableString16(string16(), false);
+  snapshot->ExtractValues(&values);
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(DomStorageSnapshotTest, MatchesMap) {
+  const char* kKeys[] = { "", "a", "aa", "ab", "b", "key", "key2", "z" };
+  scoped_refptr<DomStorageMap> map(new DomStorageMap(kPerAreaQuota));
+  for (size_t i = 0; i < arraysize(kKeys); ++i) {
+    NullableString16 old_value;
+    EXPECT_TRUE(map->SetItem(ASCIIToUTF16(kKeys[i]),
+                             ASCIIToUTF16(std::string(i, 'v')), &old_value));
+  }
+  // Keys that aren't valid UTF-16 are ordered by code unit, like in the map.
+  const char16 kNonAscii[] = { 0xd800, 0xffff, 0 };
+  NullableString16 old_value;
+  EXPECT_TRUE(map->SetItem(string16(kNonAscii), ASCIIToUTF16("surrogate"),
+                           &old_value));
+
+  const int64 kVersion = 42;
+  scoped_refptr<DomStorageSnapshot> snapshot = map->CreateSnapshot(kVersion);
+  ASSERT_TRUE(snapshot.get());
+  EXPECT_EQ(kVersion, snapshot->version());
+  EXPECT_EQ(map->Length(), snapshot->Length());
+  EXPECT_EQ(map->bytes_used(), snapshot->bytes_used());
+  for (unsigned i = 0; i <= map->Length(); ++i) {
+    NullableString16 key = map->Key(i);
+    EXPECT_EQ(key.is_null(), snapshot->Key(i).is_null());
+    EXPECT_EQ(key.string(), snapshot->Key(i).string());
+    if (!key.is_null())
+      EXPECT_EQ(map->GetItem(key.string()).string(),
+                snapshot->GetItem(key.string()).string());
+  }
+  EXPECT_TRUE(snapshot->GetItem(ASCIIToUTF16("missing")).is_null());
+  EXPECT_TRUE(snapshot->GetItem(ASCIIToUTF16("k")).is_null());
+  EXPECT_TRUE(snapshot->GetItem(ASCIIToUTF16("zz")).is_null());
+
+  ValuesMap expected;
+  map->ExtractValues(&expected);
+  ValuesMap values;
+  snapshot->ExtractValues(&values);
+  EXPECT_EQ(expected.size(), values.size());
+  for (ValuesMap::const_iterator it = expected.begin(); it != expected.end();
+       ++it) {
+    EXPECT_EQ(it->second.string(), values[it->first].string());
+  }
+}
+
+TEST(DomStorageSnapshotTest, ShareAndOpen) {
+  ValuesMap values;
+  values[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                 false);
+  scoped_refptr<DomStorageSnapshot> snapshot =
+      DomStorageSnapshot::Create(values, 7);
+  ASSERT_TRUE(snapshot.get());
+
+  base::SharedMemoryHandle handle;
+  ASSERT_TRUE(snapshot->ShareToProcess(base::GetCurrentProcessHandle(),
+                                       &handle));
+  scoped_refptr<DomStorageSnapshot> opened =
+      DomStorageSnapshot::Open(handle, snapshot->size());
+  ASSERT_TRUE(opened.get());
+  EXPECT_EQ(7, opened->version());
+  EXPECT_EQ(1u, opened->Length());
+  EXPECT_EQ(ASCIIToUTF16("value"),
+            opened->GetItem(ASCIIToUTF16("key")).string());
+  EXPECT_EQ(snapshot->bytes_used(), opened->bytes_used());
+
+  // Segments that are too small to hold what the header claims are
+  // rejected.
+  ASSERT_TRUE(snapshot->ShareToProcess(base::GetCurrentProcessHandle(),
+                                       &handle));
+  EXPECT_FALSE(DomStorageSnapshot::Open(handle, snapshot->size() - 2).get());
+  ASSERT_TRUE(snapshot->ShareToProcess(base::GetCurrentProcessHandle(),
+                                       &handle));
+  EXPECT_FALSE(DomStorageSnapshot::Open(handle, 8).get());
+  EXPECT_FALSE(DomStorageSnapshot::Open(base::SharedMemory::NULLHandle(),
+                                        0).get());
+}
+
+// Another process writing to the segment after it was opened can't make the
+// snapshot read outside of it.
+TEST(DomStorageSnapshotTest, IgnoresLaterWrites) {
+  ValuesMap values;
+  values[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                 false);
+  scoped_refptr<DomStorageSnapshot> snapshot =
+      DomStorageSnapshot::Create(values, 7);
+  ASSERT_TRUE(snapshot.get());
+
+  base::SharedMemoryHandle handle;
+  ASSERT_TRUE(snapshot->ShareToProcess(base::GetCurrentProcessHandle(),
+                                       &handle));
+  scoped_refptr<DomStorageSnapshot> opened =
+      DomStorageSnapshot::Open(handle, snapshot->size());
+  ASSERT_TRUE(opened.get());
+
+  ASSERT_TRUE(snapshot->ShareToProcess(base::GetCurrentProcessHandle(),
+                                       &handle));
+  base::SharedMemory writer(handle, false);
+  ASSERT_TRUE(writer.Map(snapshot->size()));
+  // Overwrite the header and the entry table, but not the data.
+  const size_t kHeaderAndEntrySize = 24 + 16;
+  memset(writer.memory(), 0xff, kHeaderAndEntrySize);
+
+  EXPECT_EQ(7, opened->version());
+  EXPECT_EQ(1u, opened->Length());
+  EXPECT_EQ(ASCIIToUTF16("key"), opened->Key(0).string());
+  EXPECT_EQ(ASCIIToUTF16("value"),
+            opened->GetItem(ASCIIToUTF16("key")).string());
+}
+
+}  // namespace dom_storage
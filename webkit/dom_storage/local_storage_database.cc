@@ -0,0 +1,231 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/dom_storage/local_storage_database.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/utf_string_conversions.h"
+#include "third_party/leveldatabase/src/helpers/memenv/memenv.h"
+#include "third_party/leveldatabase/src/include/leveldb/db.h"
+#include "third_party/leveldatabase/src/include/leveldb/env.h"
+#include "third_party/leveldatabase/src/include/leveldb/iterator.h"
+#include "third_party/leveldatabase/src/include/leveldb/options.h"
+#include "third_party/leveldatabase/src/include/leveldb/write_batch.h"
+
+namespace dom_storage {
+
+namespace {
+
+const char kVersionKey[] = "VERSION";
+const char kVersion[] = "1";
+const char kValuePrefix[] = "_";
+
+// Name of the in-memory database within its Env.
+const char kInMemoryPath[] = "/local-storage";
+
+std::string ValueKey(const string16& key) {
+  std::string result(kValuePrefix);
+  result.append(reinterpret_cast<const char*>(key.data()),
+                key.size() * sizeof(char16));
+  return result;
+}
+
+leveldb::Slice ValueSlice(const string16& value) {
+  return leveldb::Slice(reinterpret_cast<const char*>(value.data()),
+                        value.size() * sizeof(char16));
+}
+
+// Converts the raw UTF-16 bytes stored in |slice| to a string16.
+bool SliceToString16(const leveldb::Slice& slice, string16* result) {
+  if (slice.size() % sizeof(char16))
+    return false;
+  result->assign(reinterpret_cast<const char16*>(slice.data()),
+                 slice.size() / sizeof(char16));
+  return true;
+}
+
+}  // namespace
+
+LocalStorageDatabase::LocalStorageDatabase(
+    const base::FilePath& directory_path)
+    : directory_path_(directory_path),
+      failed_to_open_(false),
+      known_to_be_empty_(false) {
+  DCHECK(!directory_path.empty());
+}
+
+LocalStorageDatabase::LocalStorageDatabase()
+    : env_(leveldb::NewMemEnv(leveldb::Env::Default())),
+      failed_to_open_(false),
+      known_to_be_empty_(false) {
+}
+
+LocalStorageDatabase::~LocalStorageDatabase() {
+  // The database has to go before the Env it lives in.
+  db_.reset();
+  if (known_to_be_empty_ && !directory_path_.empty()) {
+    // Delete the empty database from disk.
+    file_util::Delete(directory_path_, true);
+  }
+}
+
+void LocalStorageDatabase::ReadAllValues(ValuesMap* result) {
+  if (!LazyOpen(false))
+    return;
+
+  scoped_ptr<leveldb::Iterator> it(db_->NewIterator(leveldb::ReadOptions()));
+  for (it->Seek(kValuePrefix); it->Valid(); it->Next()) {
+    leveldb::Slice key = it->key();
+    if (!key.starts_with(kValuePrefix))
+      break;
+    key.remove_prefix(sizeof(kValuePrefix) - 1);
+    string16 key16;
+    string16 value16;
+    if (!SliceToString16(key, &key16) ||
+        !SliceToString16(it->value(), &value16)) {
+      LOG(WARNING) << "Skipping a malformed localStorage entry in "
+                   << directory_path_.value();
+      continue;
+    }
+    (*result)[key16] = NullableString16(value16, false);
+  }
+  DCHECK(it->status().ok());
+  known_to_be_empty_ = result->empty();
+}
+
+bool LocalStorageDatabase::CommitChanges(bool clear_all_first,
+                                         const ValuesMap& changes) {
+  if (!LazyOpen(!changes.empty())) {
+    // If we're being asked to commit changes that will result in an
+    // empty database, we return true if the database file doesn't exist.
+    return clear_all_first && changes.empty() && !Exists();
+  }
+
+  bool old_known_to_be_empty = known_to_be_empty_;
+  leveldb::WriteBatch batch;
+  if (clear_all_first) {
+    scoped_ptr<leveldb::Iterator> it(
+        db_->NewIterator(leveldb::ReadOptions()));
+    for (it->Seek(kValuePrefix); it->Valid(); it->Next()) {
+      if (!it->key().starts_with(kValuePrefix))
+        break;
+      batch.Delete(it->key());
+    }
+    if (!it->status().ok())
+      return false;
+    known_to_be_empty_ = true;
+  }
+
+  bool did_delete = false;
+  bool did_insert = false;
+  for (ValuesMap::const_iterator it = changes.begin(); it != changes.end();
+       ++it) {
+    if (it->second.is_null()) {
+      batch.Delete(ValueKey(it->first));
+      did_delete = true;
+    } else {
+      batch.Put(ValueKey(it->first), ValueSlice(it->second.string()));
+      known_to_be_empty_ = false;
+      did_insert = true;
+    }
+  }
+
+  leveldb::Status s = db_->Write(leveldb::WriteOptions(), &batch);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to commit localStorage changes to "
+                 << directory_path_.value() << ", error: " << s.ToString();
+    known_to_be_empty_ = old_known_to_be_empty;
+    return false;
+  }
+
+  if (!known_to_be_empty_ && did_delete && !did_insert) {
+    scoped_ptr<leveldb::Iterator> it(
+        db_->NewIterator(leveldb::ReadOptions()));
+    it->Seek(kValuePrefix);
+    known_to_be_empty_ = it->status().ok() &&
+        (!it->Valid() || !it->key().starts_with(kValuePrefix));
+  }
+  return true;
+}
+
+bool LocalStorageDatabase::Exists() const {
+  if (directory_path_.empty())
+    return IsOpen();
+  return file_util::PathExists(directory_path_) &&
+         !file_util::IsDirectoryEmpty(directory_path_);
+}
+
+bool LocalStorageDatabase::LazyOpen(bool create_if_needed) {
+  if (failed_to_open_) {
+    // Don't try to open a database that we know has failed
+    // already.
+    return false;
+  }
+  if (IsOpen())
+    return true;
+
+  if (!create_if_needed && !Exists()) {
+    // If the directory doesn't exist already and we haven't been asked to
+    // create a database on disk, then we don't bother opening the database.
+    // This means we wait until we absolutely need to put something onto disk
+    // before we do so.
+    return false;
+  }
+
+  leveldb::DB* db = NULL;
+  leveldb::Status s = TryToOpen(&db);
+  if (!s.ok() && !directory_path_.empty()) {
+    LOG(WARNING) << "Failed to open leveldb in " << directory_path_.value()
+                 << ", error: " << s.ToString();
+    DCHECK(db == NULL);
+
+    // Clear the directory and try again.
+    file_util::Delete(directory_path_, true);
+    s = TryToOpen(&db);
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to open leveldb in " << directory_path_.value()
+                 << ", error: " << s.ToString();
+    DCHECK(db == NULL);
+    failed_to_open_ = true;
+    return false;
+  }
+  db_.reset(db);
+  return true;
+}
+
+leveldb::Status LocalStorageDatabase::TryToOpen(leveldb::DB** db) {
+  leveldb::Options options;
+  // The directory exists but a valid leveldb database might not exist inside
+  // it (e.g., a subset of the needed files might be missing). Handle this
+  // situation gracefully by creating the database now.
+  options.create_if_missing = true;
+  options.env = env_.get() ? env_.get() : leveldb::Env::Default();
+#if defined(OS_WIN)
+  std::string path = WideToUTF8(directory_path_.value());
+#elif defined(OS_POSIX)
+  std::string path = directory_path_.value();
+#endif
+  if (directory_path_.empty())
+    path = kInMemoryPath;
+  leveldb::Status s = leveldb::DB::Open(options, path, db);
+  if (!s.ok())
+    return s;
+
+  // Databases written by a newer schema are treated like corrupt ones.
+  std::string version;
+  s = (*db)->Get(leveldb::ReadOptions(), kVersionKey, &version);
+  if (s.IsNotFound())
+    s = (*db)->Put(leveldb::WriteOptions(), kVersionKey, kVersion);
+  else if (s.ok() && version != kVersion)
+    s = leveldb::Status::Corruption("Unknown localStorage schema", version);
+  if (!s.ok()) {
+    delete *db;
+    *db = NULL;
+  }
+  return s;
+}
+
+}  // namespace dom_storage
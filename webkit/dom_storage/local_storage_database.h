@@ -0,0 +1,92 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef WEBKIT_DOM_STORAGE_LOCAL_STORAGE_DATABASE_H_
+#define WEBKIT_DOM_STORAGE_LOCAL_STORAGE_DATABASE_H_
+
+#include "base/files/file_path.h"
+#include "base/gtest_prod_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "third_party/leveldatabase/src/include/leveldb/status.h"
+#include "webkit/dom_storage/dom_storage_types.h"
+#include "webkit/storage/webkit_storage_export.h"
+
+namespace leveldb {
+class DB;
+class Env;
+}  // namespace leveldb
+
+namespace dom_storage {
+
+// Represents a leveldb based backing for the localStorage of one origin.
+// Replaces the per-origin sqlite files of DomStorageDatabase, whose single
+// row updates and journal syncs made every commit batch expensive; a batch
+// is now a single leveldb::WriteBatch appended to the log. This class is
+// designed to be used on a single thread.
+//
+// Layout of the database:
+// | key                     | value                              |
+// ----------------------------------------------------------------
+// | VERSION                 | 1                                  |
+// | _<key as UTF-16 bytes>  | <value as UTF-16 bytes>            |
+class WEBKIT_STORAGE_EXPORT LocalStorageDatabase {
+ public:
+  explicit LocalStorageDatabase(const base::FilePath& directory_path);
+  virtual ~LocalStorageDatabase();  // virtual for unit testing
+
+  // Reads all the key, value pairs stored in the database and returns
+  // them. |result| is assumed to be empty and any duplicate keys will
+  // be overwritten. If the database exists on disk then it will be
+  // opened. If it does not exist then it will not be created and
+  // |result| will be unmodified.
+  void ReadAllValues(ValuesMap* result);
+
+  // Updates the backing database. Will remove all keys before updating
+  // the database if |clear_all_first| is set. Then all entries in
+  // |changes| will be examined - keys mapped to a null NullableString16
+  // will be removed and all others will be inserted/updated as appropriate.
+  // All of it is applied atomically.
+  bool CommitChanges(bool clear_all_first, const ValuesMap& changes);
+
+  // Returns true if there is a database on disk for this origin.
+  bool Exists() const;
+
+  // Simple getter for the path we were constructed with.
+  const base::FilePath& directory_path() const { return directory_path_; }
+
+ protected:
+  // Constructor that uses an in-memory leveldb database, for testing.
+  LocalStorageDatabase();
+
+ private:
+  friend class LocalStorageDatabaseAdapter;
+  FRIEND_TEST_ALL_PREFIXES(LocalStorageDatabaseTest, LazyOpenIsLazy);
+  FRIEND_TEST_ALL_PREFIXES(LocalStorageDatabaseTest, CorruptDatabase);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, BackingDatabaseOpened);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, PurgeMemory);
+
+  // Opens the database at directory_path_ if it exists already and creates
+  // it if |create_if_needed| is true. Returns false on failure or if there
+  // is nothing to open.
+  bool LazyOpen(bool create_if_needed);
+
+  // Tries to open the database at directory_path_, assigns |db| to point to
+  // the opened leveldb::DB instance.
+  leveldb::Status TryToOpen(leveldb::DB** db);
+
+  bool IsOpen() const { return db_.get() != NULL; }
+
+  // Path to the database on disk, empty for the in-memory database.
+  const base::FilePath directory_path_;
+  scoped_ptr<leveldb::Env> env_;
+  scoped_ptr<leveldb::DB> db_;
+  bool failed_to_open_;
+  bool known_to_be_empty_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalStorageDatabase);
+};
+
+}  // namespace dom_storage
+
+#endif  // WEBKIT_DOM_STORAGE_LOCAL_STORAGE_DATABASE_H_
@@ -6,37 +6,66 @@
 
 #include "base/file_util.h"
 #include "webkit/dom_storage/dom_storage_database.h"
+#include "webkit/dom_storage/local_storage_database.h"
 
 namespace dom_storage {
 
 LocalStorageDatabaseAdapter::LocalStorageDatabaseAdapter(
-    const base::FilePath& path)
-    : db_(new DomStorageDatabase(path)) {
+    const base::FilePath& path, const base::FilePath& legacy_path)
+    : db_(new LocalStorageDatabase(path)),
+      legacy_path_(legacy_path) {
 }
 
 LocalStorageDatabaseAdapter::~LocalStorageDatabaseAdapter() { }
 
 void LocalStorageDatabaseAdapter::ReadAllValues(ValuesMap* result) {
+  ImportLegacyDatabase();
   db_->ReadAllValues(result);
 }
 
 bool LocalStorageDatabaseAdapter::CommitChanges(
     bool clear_all_first, const ValuesMap& changes) {
+  // Areas are always read, and the legacy database imported, before they
+  // are changed.
   return db_->CommitChanges(clear_all_first, changes);
 }
 
 void LocalStorageDatabaseAdapter::DeleteFiles() {
-  file_util::Delete(db_->file_path(), false);
-  file_util::Delete(
-      DomStorageDatabase::GetJournalFilePath(db_->file_path()), false);
+  if (!db_->directory_path().empty())
+    file_util::Delete(db_->directory_path(), true);
+  if (!legacy_path_.empty()) {
+    file_util::Delete(legacy_path_, false);
+    file_util::Delete(DomStorageDatabase::GetJournalFilePath(legacy_path_),
+                      false);
+  }
 }
 
 void LocalStorageDatabaseAdapter::Reset() {
-  db_.reset(new DomStorageDatabase(db_->file_path()));
+  if (db_->directory_path().empty())
+    db_.reset(new LocalStorageDatabase());
+  else
+    db_.reset(new LocalStorageDatabase(db_->directory_path()));
 }
 
 LocalStorageDatabaseAdapter::LocalStorageDatabaseAdapter()
-    : db_(new DomStorageDatabase()) {
+    : db_(new LocalStorageDatabase()) {
+}
+
+void LocalStorageDatabaseAdapter::ImportLegacyDatabase() {
+  if (legacy_path_.empty() || !file_util::PathExists(legacy_path_))
+    return;
+
+  ValuesMap values;
+  {
+    DomStorageDatabase legacy_db(legacy_path_);
+    legacy_db.ReadAllValues(&values);
+  }
+  const bool kClearAllFirst = true;
+  if (!values.empty() && !db_->CommitChanges(kClearAllFirst, values))
+    return;
+  file_util::Delete(legacy_path_, false);
+  file_util::Delete(DomStorageDatabase::GetJournalFilePath(legacy_path_),
+                    false);
 }
 
 }  // namespace dom_storage
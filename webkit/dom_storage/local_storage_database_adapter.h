@@ -5,23 +5,24 @@
 #ifndef WEBKIT_DOM_STORAGE_LOCAL_STORAGE_DATABASE_ADAPTER_H_
 #define WEBKIT_DOM_STORAGE_LOCAL_STORAGE_DATABASE_ADAPTER_H_
 
+#include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
 #include "webkit/dom_storage/dom_storage_database_adapter.h"
 #include "webkit/storage/webkit_storage_export.h"
 
-namespace base {
-class FilePath;
-}
-
 namespace dom_storage {
 
-class DomStorageDatabase;
+class LocalStorageDatabase;
 
+// Backs a localStorage area with a LocalStorageDatabase at |path|. Values
+// found in the sqlite DomStorageDatabase at |legacy_path|, where earlier
+// versions kept them, are moved into it the first time the area is read.
 class WEBKIT_STORAGE_EXPORT LocalStorageDatabaseAdapter :
       public DomStorageDatabaseAdapter {
  public:
-  explicit LocalStorageDatabaseAdapter(const base::FilePath& path);
+  LocalStorageDatabaseAdapter(const base::FilePath& path,
+                              const base::FilePath& legacy_path);
   virtual ~LocalStorageDatabaseAdapter();
   virtual void ReadAllValues(ValuesMap* result) OVERRIDE;
   virtual bool CommitChanges(bool clear_all_first,
@@ -30,7 +31,7 @@ class WEBKIT_STORAGE_EXPORT LocalStorageDatabaseAdapter :
   virtual void Reset() OVERRIDE;
 
  protected:
-  // Constructor that uses an in-memory sqlite database, for testing.
+  // Constructor that uses an in-memory leveldb database, for testing.
   LocalStorageDatabaseAdapter();
 
  private:
@@ -38,9 +39,15 @@ class WEBKIT_STORAGE_EXPORT LocalStorageDatabaseAdapter :
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, CommitChangesAtShutdown);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, CommitTasks);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, DeleteOrigin);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, ImportLegacyDatabase);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, PurgeMemory);
 
-  scoped_ptr<DomStorageDatabase> db_;
+  // Moves the values of the legacy database into |db_| and deletes its
+  // files. Leaves them alone if the values can't be committed.
+  void ImportLegacyDatabase();
+
+  scoped_ptr<LocalStorageDatabase> db_;
+  base::FilePath legacy_path_;
 
   DISALLOW_COPY_AND_ASSIGN(LocalStorageDatabaseAdapter);
 };
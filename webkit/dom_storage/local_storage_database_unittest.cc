@@ -0,0 +1,241 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/dom_storage/local_storage_database.h"
+
+#include "base/file_util.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/utf_string_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/leveldatabase/src/include/leveldb/db.h"
+#include "third_party/leveldatabase/src/include/leveldb/options.h"
+
+namespace dom_storage {
+
+namespace {
+
+void CheckValuesMatch(LocalStorageDatabase* db,
+                      const ValuesMap& expected) {
+  ValuesMap values_read;
+  db->ReadAllValues(&values_read);
+  EXPECT_EQ(expected.size(), values_read.size());
+
+  ValuesMap::const_iterator it = values_read.begin();
+  for (; it != values_read.end(); ++it) {
+    ValuesMap::const_iterator found = expected.find(it->first);
+    ASSERT_TRUE(found != expected.end());
+    EXPECT_EQ(found->second.string(), it->second.string());
+    EXPECT_FALSE(it->second.is_null());
+  }
+}
+
+void CreateMapWithValues(ValuesMap* values) {
+  string16 kCannedKeys[] = {
+      ASCIIToUTF16("test"),
+      ASCIIToUTF16("company"),
+      ASCIIToUTF16("date"),
+      ASCIIToUTF16("empty")
+  };
+  NullableString16 kCannedValues[] = {
+      NullableString16(ASCIIToUTF16("123"), false),
+      NullableString16(ASCIIToUTF16("Google"), false),
+      NullableString16(ASCIIToUTF16("18-01-2012"), false),
+      NullableString16(string16(), false)
+  };
+  for (unsigned i = 0; i < arraysize(kCannedKeys); i++)
+    (*values)[kCannedKeys[i]] = kCannedValues[i];
+}
+
+}  // namespace
+
+TEST(LocalStorageDatabaseTest, LazyOpenIsLazy) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.path().AppendASCII("test.leveldb");
+
+  LocalStorageDatabase db(path);
+  EXPECT_FALSE(db.IsOpen());
+  ValuesMap values;
+  db.ReadAllValues(&values);
+  // Reading an empty db should not open the database.
+  EXPECT_FALSE(db.IsOpen());
+  EXPECT_FALSE(db.Exists());
+
+  // Committing nothing with clear_all_first succeeds without creating it.
+  EXPECT_TRUE(db.CommitChanges(true, values));
+  EXPECT_FALSE(db.IsOpen());
+  EXPECT_FALSE(file_util::PathExists(path));
+
+  values[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                 false);
+  EXPECT_TRUE(db.CommitChanges(false, values));
+  // Writing content should open the database.
+  EXPECT_TRUE(db.IsOpen());
+  EXPECT_TRUE(db.Exists());
+  CheckValuesMatch(&db, values);
+}
+
+TEST(LocalStorageDatabaseTest, SimpleWriteAndReadBack) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.path().AppendASCII("test.leveldb");
+
+  ValuesMap storage;
+  CreateMapWithValues(&storage);
+  {
+    LocalStorageDatabase db(path);
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+    CheckValuesMatch(&db, storage);
+  }
+
+  // The values survive reopening the database.
+  LocalStorageDatabase db(path);
+  CheckValuesMatch(&db, storage);
+}
+
+TEST(LocalStorageDatabaseTest, WriteWithClearAndRemove) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  LocalStorageDatabase db(temp_dir.path().AppendASCII("test.leveldb"));
+
+  ValuesMap storage;
+  CreateMapWithValues(&storage);
+  EXPECT_TRUE(db.CommitChanges(false, storage));
+  CheckValuesMatch(&db, storage);
+
+  // Insert some values, clearing the database first.
+  storage.clear();
+  storage[ASCIIToUTF16("another_key")] =
+      NullableString16(ASCIIToUTF16("test"), false);
+  EXPECT_TRUE(db.CommitChanges(true, storage));
+  CheckValuesMatch(&db, storage);
+
+  // Now clear the values and insert more.
+  storage.clear();
+  storage[ASCIIToUTF16("test")] =
+      NullableString16(ASCIIToUTF16("123"), false);
+  storage[ASCIIToUTF16("remove")] =
+      NullableString16(ASCIIToUTF16("me"), false);
+  EXPECT_TRUE(db.CommitChanges(true, storage));
+  CheckValuesMatch(&db, storage);
+
+  // Null values remove keys.
+  ValuesMap changes;
+  changes[ASCIIToUTF16("remove")] = NullableString16(true);
+  EXPECT_TRUE(db.CommitChanges(false, changes));
+  storage.erase(ASCIIToUTF16("remove"));
+  CheckValuesMatch(&db, storage);
+}
+
+TEST(LocalStorageDatabaseTest, CloseEmptyDatabaseDeletesDirectory) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.path().AppendASCII("test.leveldb");
+  ValuesMap storage;
+  CreateMapWithValues(&storage);
+
+  // Explicitly clearing the database deletes it once it's closed.
+  {
+    LocalStorageDatabase db(path);
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+    EXPECT_TRUE(db.CommitChanges(true, ValuesMap()));
+    EXPECT_TRUE(file_util::PathExists(path));
+  }
+  EXPECT_FALSE(file_util::PathExists(path));
+
+  // So does removing every key one by one.
+  {
+    LocalStorageDatabase db(path);
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+    ValuesMap changes;
+    for (ValuesMap::const_iterator it = storage.begin(); it != storage.end();
+         ++it) {
+      changes[it->first] = NullableString16(true);
+    }
+    EXPECT_TRUE(db.CommitChanges(false, changes));
+  }
+  EXPECT_FALSE(file_util::PathExists(path));
+
+  // A database that still has values is kept.
+  {
+    LocalStorageDatabase db(path);
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+  }
+  EXPECT_TRUE(file_util::PathExists(path));
+  {
+    LocalStorageDatabase db(path);
+    ValuesMap values;
+    db.ReadAllValues(&values);
+    EXPECT_EQ(storage.size(), values.size());
+  }
+  EXPECT_TRUE(file_util::PathExists(path));
+}
+
+TEST(LocalStorageDatabaseTest, KeysAreStoredAsRawUTF16) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.path().AppendASCII("test.leveldb");
+
+  // Scripts may store strings that aren't valid UTF-16, they have to
+  // round trip unchanged.
+  const char16 kUnpairedSurrogate[] = { 0xd800, 'k', 0 };
+  const char16 kEmbeddedNull[] = { 'v', 0, 'v' };
+  ValuesMap storage;
+  storage[string16(kUnpairedSurrogate)] = NullableString16(
+      string16(kEmbeddedNull, arraysize(kEmbeddedNull)), false);
+  storage[string16()] = NullableString16(ASCIIToUTF16("empty key"), false);
+  {
+    LocalStorageDatabase db(path);
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+  }
+  LocalStorageDatabase db(path);
+  CheckValuesMatch(&db, storage);
+}
+
+TEST(LocalStorageDatabaseTest, CorruptDatabase) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path = temp_dir.path().AppendASCII("test.leveldb");
+  ValuesMap storage;
+  CreateMapWithValues(&storage);
+  {
+    LocalStorageDatabase db(path);
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+  }
+
+  // A database written by an unknown schema is thrown away.
+  {
+    leveldb::DB* raw_db = NULL;
+    leveldb::Options options;
+    ASSERT_TRUE(leveldb::DB::Open(options, path.AsUTF8Unsafe(),
+                                  &raw_db).ok());
+    ASSERT_TRUE(raw_db->Put(leveldb::WriteOptions(), "VERSION", "2").ok());
+    delete raw_db;
+  }
+  {
+    LocalStorageDatabase db(path);
+    ValuesMap values;
+    db.ReadAllValues(&values);
+    EXPECT_TRUE(db.IsOpen());
+    EXPECT_FALSE(db.failed_to_open_);
+    EXPECT_TRUE(values.empty());
+    EXPECT_TRUE(db.CommitChanges(false, storage));
+  }
+
+  // So is one whose files can't be read.
+  const char kGarbage[] = "not a manifest";
+  ASSERT_EQ(static_cast<int>(sizeof(kGarbage)),
+            file_util::WriteFile(path.AppendASCII("CURRENT"), kGarbage,
+                                 sizeof(kGarbage)));
+  LocalStorageDatabase db(path);
+  ValuesMap values;
+  db.ReadAllValues(&values);
+  EXPECT_TRUE(db.IsOpen());
+  EXPECT_TRUE(values.empty());
+  EXPECT_TRUE(db.CommitChanges(false, storage));
+  CheckValuesMatch(&db, storage);
+}
+
+}  // namespace dom_storage
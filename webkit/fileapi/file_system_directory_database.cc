@@ -22,14 +22,17 @@
 
 namespace {
 
+// Round off here to match the behavior of the filesystem on real files.
+base::Time TruncateToSeconds(const base::Time& time) {
+  return base::Time::FromDoubleT(floor(time.ToDoubleT()));
+}
+
 bool PickleFromFileInfo(
     const fileapi::FileSystemDirectoryDatabase::FileInfo& info,
     Pickle* pickle) {
   DCHECK(pickle);
   std::string data_path;
-  // Round off here to match the behavior of the filesystem on real files.
-  base::Time time =
-      base::Time::FromDoubleT(floor(info.modification_time.ToDoubleT()));
+  base::Time time = TruncateToSeconds(info.modification_time);
   std::string name;
 
   data_path = fileapi::FilePathToString(info.data_path);
@@ -73,6 +76,10 @@ const char kLastFileIdKey[] = "LAST_FILE_ID";
 const char kLastIntegerKey[] = "LAST_INTEGER";
 const int64 kMinimumReportIntervalHours = 1;
 const char kInitStatusHistogramLabel[] = "FileSystem.DirectoryDatabaseInit";
+// Each cache is simply dropped once it grows past this many entries.
+const size_t kMaxCachedEntries = 10000;
+// Deferred modification times are written out once this many pile up.
+const size_t kMaxPendingModificationTimes = 100;
 
 enum InitStatus {
   INIT_STATUS_OK = 0,
@@ -406,6 +413,7 @@ FileSystemDirectoryDatabase::FileSystemDirectoryDatabase(
 }
 
 FileSystemDirectoryDatabase::~FileSystemDirectoryDatabase() {
+  FlushPendingModificationTimes();
 }
 
 bool FileSystemDirectoryDatabase::GetChildWithName(
@@ -414,6 +422,11 @@ bool FileSystemDirectoryDatabase::GetChildWithName(
     return false;
   DCHECK(child_id);
   std::string child_key = GetChildLookupKey(parent_id, name);
+  ChildCache::const_iterator found = child_cache_.find(child_key);
+  if (found != child_cache_.end()) {
+    *child_id = found->second;
+    return true;
+  }
   std::string child_id_string;
   leveldb::Status status =
       db_->Get(leveldb::ReadOptions(), child_key, &child_id_string);
@@ -424,6 +437,9 @@ bool FileSystemDirectoryDatabase::GetChildWithName(
       LOG(ERROR) << "Hit database corruption!";
       return false;
     }
+    if (child_cache_.size() >= kMaxCachedEntries)
+      child_cache_.clear();
+    child_cache_[child_key] = *child_id;
     return true;
   }
   HandleError(FROM_HERE, status);
@@ -477,6 +493,17 @@ bool FileSystemDirectoryDatabase::GetFileInfo(FileId file_id, FileInfo* info) {
   if (!Init(REPAIR_ON_CORRUPTION))
     return false;
   DCHECK(info);
+  FileInfoCache::const_iterator found =
+      pending_modification_times_.find(file_id);
+  if (found != pending_modification_times_.end()) {
+    *info = found->second;
+    return true;
+  }
+  found = file_info_cache_.find(file_id);
+  if (found != file_info_cache_.end()) {
+    *info = found->second;
+    return true;
+  }
   std::string file_key = GetFileLookupKey(file_id);
   std::string file_data_string;
   leveldb::Status status =
@@ -491,6 +518,9 @@ bool FileSystemDirectoryDatabase::GetFileInfo(FileId file_id, FileInfo* info) {
                  << info->data_path.value();
       return false;
     }
+    if (file_info_cache_.size() >= kMaxCachedEntries)
+      file_info_cache_.clear();
+    file_info_cache_[file_id] = *info;
     return true;
   }
   // Special-case the root, for databases that haven't been initialized yet.
@@ -541,11 +571,8 @@ bool FileSystemDirectoryDatabase::AddFileInfo(
     return false;
 
   batch.Put(LastFileIdKey(), base::Int64ToString(temp_id));
-  status = db_->Write(leveldb::WriteOptions(), &batch);
-  if (!status.ok()) {
-    HandleError(FROM_HERE, status);
+  if (!CommitBatch(&batch))
     return false;
-  }
   *file_id = temp_id;
   return true;
 }
@@ -556,12 +583,7 @@ bool FileSystemDirectoryDatabase::RemoveFileInfo(FileId file_id) {
   leveldb::WriteBatch batch;
   if (!RemoveFileInfoHelper(file_id, &batch))
     return false;
-  leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch);
-  if (!status.ok()) {
-    HandleError(FROM_HERE, status);
-    return false;
-  }
-  return true;
+  return CommitBatch(&batch);
 }
 
 bool FileSystemDirectoryDatabase::UpdateFileInfo(
@@ -590,12 +612,7 @@ bool FileSystemDirectoryDatabase::UpdateFileInfo(
   if (!RemoveFileInfoHelper(file_id, &batch) ||
       !AddFileInfoHelper(new_info, file_id, &batch))
     return false;
-  leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch);
-  if (!status.ok()) {
-    HandleError(FROM_HERE, status);
-    return false;
-  }
-  return true;
+  return CommitBatch(&batch);
 }
 
 bool FileSystemDirectoryDatabase::UpdateModificationTime(
@@ -603,20 +620,12 @@ bool FileSystemDirectoryDatabase::UpdateModificationTime(
   FileInfo info;
   if (!GetFileInfo(file_id, &info))
     return false;
-  info.modification_time = modification_time;
-  Pickle pickle;
-  if (!PickleFromFileInfo(info, &pickle))
-    return false;
-  leveldb::Status status = db_->Put(
-      leveldb::WriteOptions(),
-      GetFileLookupKey(file_id),
-      leveldb::Slice(reinterpret_cast<const char *>(pickle.data()),
-                     pickle.size()));
-  if (!status.ok()) {
-    HandleError(FROM_HERE, status);
-    return false;
-  }
-  return true;
+  info.modification_time = TruncateToSeconds(modification_time);
+  file_info_cache_.erase(file_id);
+  pending_modification_times_[file_id] = info;
+  if (pending_modification_times_.size() < kMaxPendingModificationTimes)
+    return true;
+  return FlushPendingModificationTimes();
 }
 
 bool FileSystemDirectoryDatabase::OverwritingMoveFile(
@@ -643,12 +652,9 @@ bool FileSystemDirectoryDatabase::OverwritingMoveFile(
       GetFileLookupKey(dest_file_id),
       leveldb::Slice(reinterpret_cast<const char *>(pickle.data()),
                      pickle.size()));
-  leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch);
-  if (!status.ok()) {
-    HandleError(FROM_HERE, status);
-    return false;
-  }
-  return true;
+  file_info_cache_.erase(dest_file_id);
+  pending_modification_times_.erase(dest_file_id);
+  return CommitBatch(&batch);
 }
 
 bool FileSystemDirectoryDatabase::GetNextInteger(int64* next) {
@@ -665,12 +671,10 @@ bool FileSystemDirectoryDatabase::GetNextInteger(int64* next) {
       return false;
     }
     ++temp;
-    status = db_->Put(leveldb::WriteOptions(), LastIntegerKey(),
-        base::Int64ToString(temp));
-    if (!status.ok()) {
-      HandleError(FROM_HERE, status);
+    leveldb::WriteBatch batch;
+    batch.Put(LastIntegerKey(), base::Int64ToString(temp));
+    if (!CommitBatch(&batch))
       return false;
-    }
     *next = temp;
     return true;
   }
@@ -710,6 +714,7 @@ bool FileSystemDirectoryDatabase::Init(RecoveryOption recovery_option) {
   ReportInitStatus(status);
   if (status.ok()) {
     db_.reset(db);
+    ClearCaches();
     return true;
   }
   HandleError(FROM_HERE, status);
@@ -755,6 +760,11 @@ bool FileSystemDirectoryDatabase::RepairDatabase(const std::string& db_path) {
 bool FileSystemDirectoryDatabase::IsFileSystemConsistent() {
   if (!Init(FAIL_ON_CORRUPTION))
     return false;
+  // The check reads the database directly, so it has to see every deferred
+  // write, and whatever it finds wrong may be cached.
+  if (!FlushPendingModificationTimes())
+    return false;
+  ClearCaches();
   DatabaseCheckHelper helper(this, db_.get(), filesystem_data_directory_);
   return helper.IsFileSystemConsistent();
 }
@@ -870,6 +880,9 @@ bool FileSystemDirectoryDatabase::AddFileInfoHelper(
       id_string,
       leveldb::Slice(reinterpret_cast<const char *>(pickle.data()),
                      pickle.size()));
+  // |info| replaces whatever was cached or pending for |file_id|.
+  file_info_cache_.erase(file_id);
+  pending_modification_times_.erase(file_id);
   return true;
 }
 
@@ -890,16 +903,60 @@ bool FileSystemDirectoryDatabase::RemoveFileInfoHelper(
       return false;
     }
   }
-  batch->Delete(GetChildLookupKey(info.parent_id, info.name));
+  std::string child_key = GetChildLookupKey(info.parent_id, info.name);
+  batch->Delete(child_key);
   batch->Delete(GetFileLookupKey(file_id));
+  child_cache_.erase(child_key);
+  file_info_cache_.erase(file_id);
+  pending_modification_times_.erase(file_id);
   return true;
 }
 
+bool FileSystemDirectoryDatabase::CommitBatch(leveldb::WriteBatch* batch) {
+  DCHECK(db_.get());
+  FileInfoCache::const_iterator iter;
+  for (iter = pending_modification_times_.begin();
+       iter != pending_modification_times_.end(); ++iter) {
+    Pickle pickle;
+    if (!PickleFromFileInfo(iter->second, &pickle))
+      return false;
+    batch->Put(
+        GetFileLookupKey(iter->first),
+        leveldb::Slice(reinterpret_cast<const char *>(pickle.data()),
+                       pickle.size()));
+  }
+  leveldb::Status status = db_->Write(leveldb::WriteOptions(), batch);
+  if (!status.ok()) {
+    HandleError(FROM_HERE, status);
+    return false;
+  }
+  for (iter = pending_modification_times_.begin();
+       iter != pending_modification_times_.end(); ++iter) {
+    file_info_cache_[iter->first] = iter->second;
+  }
+  pending_modification_times_.clear();
+  return true;
+}
+
+bool FileSystemDirectoryDatabase::FlushPendingModificationTimes() {
+  if (pending_modification_times_.empty())
+    return true;
+  leveldb::WriteBatch batch;
+  return CommitBatch(&batch);
+}
+
+void FileSystemDirectoryDatabase::ClearCaches() {
+  child_cache_.clear();
+  file_info_cache_.clear();
+}
+
 void FileSystemDirectoryDatabase::HandleError(
     const tracked_objects::Location& from_here,
     const leveldb::Status& status) {
   LOG(ERROR) << "FileSystemDirectoryDatabase failed at: "
              << from_here.ToString() << " with error: " << status.ToString();
+  ClearCaches();
+  pending_modification_times_.clear();
   db_.reset();
 }
 
@@ -5,6 +5,7 @@
 #ifndef WEBKIT_FILEAPI_FILE_SYSTEM_DIRECTORY_DATABASE_H_
 #define WEBKIT_FILEAPI_FILE_SYSTEM_DIRECTORY_DATABASE_H_
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -31,6 +32,15 @@ namespace fileapi {
 // that involved with talking to its underlying database.  It does not create or
 // in any way touch real files; it only creates path entries in its database.
 
+// Lookups of children and file infos are served from small in-memory caches
+// that are kept in sync with every write, so resolving a deep path doesn't hit
+// leveldb once per component.  Modification time updates are deferred and
+// folded into the write batch of the next structural change (or flushed once
+// enough of them pile up), so creating or deleting a file in a directory
+// costs a single leveldb write instead of two.  The deferred times are lost
+// on a crash, so the owner should call FlushPendingModificationTimes() soon
+// after making changes.
+
 // TODO(ericu): Safe mode, which does more checks such as the above on debug
 // builds.
 // TODO(ericu): Add a method that will give a unique filename for a data file.
@@ -72,8 +82,12 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE FileSystemDirectoryDatabase {
   // and renames.  If you just want to update the modification_time, use
   // UpdateModificationTime.
   bool UpdateFileInfo(FileId file_id, const FileInfo& info);
+  // The new time is visible to GetFileInfo right away but is only written out
+  // with the next write to the database.
   bool UpdateModificationTime(
       FileId file_id, const base::Time& modification_time);
+  // Writes out the modification times deferred by UpdateModificationTime.
+  bool FlushPendingModificationTimes();
   // This is used for an overwriting move of a file [not a directory] on top of
   // another file [also not a directory]; we need to alter two files' info in a
   // single transaction to avoid weird backing file references in the event of a
@@ -99,6 +113,9 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE FileSystemDirectoryDatabase {
 
   friend class FileSystemDirectoryDatabaseTest;
 
+  typedef std::map<std::string, FileId> ChildCache;
+  typedef std::map<FileId, FileInfo> FileInfoCache;
+
   bool Init(RecoveryOption recovery_option);
   bool RepairDatabase(const std::string& db_path);
   void ReportInitStatus(const leveldb::Status& status);
@@ -108,12 +125,19 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE FileSystemDirectoryDatabase {
   bool AddFileInfoHelper(
       const FileInfo& info, FileId file_id, leveldb::WriteBatch* batch);
   bool RemoveFileInfoHelper(FileId file_id, leveldb::WriteBatch* batch);
+  // Appends the pending modification times to |batch| and writes it.
+  bool CommitBatch(leveldb::WriteBatch* batch);
+  void ClearCaches();
   void HandleError(const tracked_objects::Location& from_here,
                    const leveldb::Status& status);
 
   const base::FilePath filesystem_data_directory_;
   scoped_ptr<leveldb::DB> db_;
   base::Time last_reported_time_;
+  ChildCache child_cache_;
+  FileInfoCache file_info_cache_;
+  // Infos whose modification time was updated but not written yet.
+  FileInfoCache pending_modification_times_;
   DISALLOW_COPY_AND_ASSIGN(FileSystemDirectoryDatabase);
 };
 
@@ -114,6 +114,14 @@ class FileSystemDirectoryDatabaseTest : public testing::Test {
     return base_.path();
   }
 
+  size_t pending_modification_time_count() {
+    return db()->pending_modification_times_.size();
+  }
+
+  size_t cached_child_count() {
+    return db()->child_cache_.size();
+  }
+
   // Makes link from |parent_id| to |child_id| with |name|.
   void MakeHierarchyLink(FileId parent_id,
                          FileId child_id,
@@ -401,6 +409,72 @@ TEST_F(FileSystemDirectoryDatabaseTest, TestUpdateModificationTime) {
   EXPECT_FALSE(db()->UpdateModificationTime(999, base::Time::UnixEpoch()));
 }
 
+TEST_F(FileSystemDirectoryDatabaseTest, TestDeferredModificationTime) {
+  FileId dir_id;
+  CreateDirectory(0, FPL("dir"), &dir_id);
+  const base::Time kTime = base::Time::UnixEpoch();
+  EXPECT_TRUE(db()->UpdateModificationTime(dir_id, kTime));
+  EXPECT_EQ(1u, pending_modification_time_count());
+
+  // The next structural change carries the pending time along.
+  FileId file_id;
+  CreateFile(dir_id, FPL("file"), FPL("data"), &file_id);
+  EXPECT_FALSE(pending_modification_time_count());
+
+  // The owner can write them out on its own.
+  EXPECT_TRUE(db()->UpdateModificationTime(dir_id, kTime));
+  EXPECT_TRUE(db()->FlushPendingModificationTimes());
+  EXPECT_FALSE(pending_modification_time_count());
+
+  // So does closing the database.
+  EXPECT_TRUE(db()->UpdateModificationTime(file_id, kTime));
+  InitDatabase();
+  FileInfo info;
+  EXPECT_TRUE(db()->GetFileInfo(dir_id, &info));
+  EXPECT_EQ(kTime, info.modification_time);
+  EXPECT_TRUE(db()->GetFileInfo(file_id, &info));
+  EXPECT_EQ(kTime, info.modification_time);
+
+  // A pending time of a removed file is dropped rather than resurrecting it.
+  EXPECT_TRUE(db()->UpdateModificationTime(file_id, base::Time::Now()));
+  EXPECT_TRUE(db()->RemoveFileInfo(file_id));
+  InitDatabase();
+  EXPECT_FALSE(db()->GetFileInfo(file_id, &info));
+  EXPECT_FALSE(db()->GetChildWithName(dir_id, FPL("file"), &file_id));
+  EXPECT_TRUE(db()->IsFileSystemConsistent());
+}
+
+TEST_F(FileSystemDirectoryDatabaseTest, TestLookupCacheFollowsWrites) {
+  FileId dir_id;
+  FileId file_id;
+  CreateDirectory(0, FPL("dir"), &dir_id);
+  CreateFile(dir_id, FPL("a"), FPL("data"), &file_id);
+
+  FileId found_id;
+  EXPECT_TRUE(db()->GetFileWithPath(
+      base::FilePath(FPL("dir/a")), &found_id));
+  EXPECT_EQ(file_id, found_id);
+  EXPECT_TRUE(cached_child_count());
+
+  // Renames and removals aren't hidden by the cached lookups.
+  FileInfo info;
+  EXPECT_TRUE(db()->GetFileInfo(file_id, &info));
+  info.name = FPL("b");
+  EXPECT_TRUE(db()->UpdateFileInfo(file_id, info));
+  EXPECT_FALSE(db()->GetFileWithPath(
+      base::FilePath(FPL("dir/a")), &found_id));
+  EXPECT_TRUE(db()->GetFileWithPath(
+      base::FilePath(FPL("dir/b")), &found_id));
+  EXPECT_EQ(file_id, found_id);
+  EXPECT_TRUE(db()->GetFileInfo(file_id, &info));
+  EXPECT_EQ(FPL("b"), info.name);
+
+  EXPECT_TRUE(db()->RemoveFileInfo(file_id));
+  EXPECT_FALSE(db()->GetFileWithPath(
+      base::FilePath(FPL("dir/b")), &found_id));
+  EXPECT_FALSE(db()->GetFileInfo(file_id, &info));
+}
+
 TEST_F(FileSystemDirectoryDatabaseTest, TestSimpleFileOperations) {
   FileId file_id = 888;
   FileInfo info0;
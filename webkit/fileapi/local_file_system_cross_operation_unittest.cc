@@ -7,10 +7,14 @@
 
 #include "base/basictypes.h"
 #include "base/bind.h"
+#include "base/command_line.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/message_loop.h"
 #include "base/run_loop.h"
 #include "base/stl_util.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "webkit/fileapi/async_file_test_helper.h"
 #include "webkit/fileapi/external_mount_points.h"
@@ -30,6 +34,15 @@ namespace fileapi {
 
 typedef FileSystemOperation::FileEntryList FileEntryList;
 
+namespace {
+
+// Command line switch for the number of files in the benchmark.
+const char kBenchmarkFiles[] = "fileapi-benchmark-files";
+const int kDefaultBenchmarkFiles = 1000;
+const int kBenchmarkFilesPerDirectory = 100;
+
+}  // namespace
+
 class CrossOperationTestHelper {
  public:
   CrossOperationTestHelper(
@@ -88,6 +101,15 @@ class CrossOperationTestHelper {
                              1024 * 1024);
   }
 
+  void SetQuota(int64 quota) {
+    quota_manager_->SetQuota(origin_,
+                             FileSystemTypeToQuotaStorageType(src_type_),
+                             quota);
+    quota_manager_->SetQuota(origin_,
+                             FileSystemTypeToQuotaStorageType(dest_type_),
+                             quota);
+  }
+
   int64 GetSourceUsage() {
     int64 usage = 0;
     GetUsageAndQuota(src_type_, &usage, NULL);
@@ -120,6 +142,10 @@ class CrossOperationTestHelper {
     return AsyncFileTestHelper::Move(file_system_context_, src, dest);
   }
 
+  base::PlatformFileError Remove(const FileSystemURL& url, bool recursive) {
+    return AsyncFileTestHelper::Remove(file_system_context_, url, recursive);
+  }
+
   base::PlatformFileError SetUpTestCaseFiles(
       const FileSystemURL& root,
       const test::TestCaseRecord* const test_cases,
@@ -422,4 +448,62 @@ TEST(LocalFileSystemCrossOperationTest, MoveDirectory) {
   ASSERT_EQ(src_increase, dest_increase);
 }
 
+// Measures recursive copies and removals of many files. Disabled by
+// default; run with
+// --gtest_also_run_disabled_tests --fileapi-benchmark-files=N.
+TEST(LocalFileSystemCrossOperationTest, DISABLED_Benchmark) {
+  int file_count = kDefaultBenchmarkFiles;
+  std::string files_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkFiles));
+  base::StringToInt(files_switch, &file_count);
+  if (file_count < 1)
+    file_count = kDefaultBenchmarkFiles;
+
+  CrossOperationTestHelper helper(GURL("http://foo"),
+                                  kFileSystemTypeTemporary,
+                                  kFileSystemTypePersistent);
+  helper.SetUp();
+  helper.SetQuota(kint64max);
+
+  // Spread the files over sibling directories, so that the recursive
+  // operations have independent subtrees to work on.
+  FileSystemURL src = helper.SourceURL("a");
+  ASSERT_EQ(base::PLATFORM_FILE_OK, helper.CreateDirectory(src));
+  FileSystemURL dir;
+  for (int i = 0; i < file_count; ++i) {
+    if (i % kBenchmarkFilesPerDirectory == 0) {
+      dir = helper.SourceURL(base::StringPrintf(
+          "a/dir%d", i / kBenchmarkFilesPerDirectory));
+      ASSERT_EQ(base::PLATFORM_FILE_OK, helper.CreateDirectory(dir));
+    }
+    ASSERT_EQ(base::PLATFORM_FILE_OK, helper.CreateFile(
+        helper.SourceURL(base::StringPrintf(
+            "a/dir%d/file%d", i / kBenchmarkFilesPerDirectory, i)), 1));
+  }
+  printf("Benchmarking recursive operations on %d files:\n", file_count);
+
+  FileSystemURL dest = helper.DestURL("b");
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  ASSERT_EQ(base::PLATFORM_FILE_OK, helper.Copy(src, dest));
+  const double copy_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  EXPECT_TRUE(helper.FileExists(
+      helper.DestURL(base::StringPrintf(
+          "b/dir%d/file%d", (file_count - 1) / kBenchmarkFilesPerDirectory,
+          file_count - 1)), 1));
+  EXPECT_EQ(helper.GetSourceUsage(), helper.GetDestUsage());
+
+  start = base::TimeTicks::HighResNow();
+  ASSERT_EQ(base::PLATFORM_FILE_OK, helper.Remove(src, true /* recursive */));
+  const double remove_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  EXPECT_FALSE(helper.DirectoryExists(src));
+  EXPECT_TRUE(helper.DirectoryExists(dest));
+
+  printf("  copy:   %.1f ms (%.3f ms per file)\n",
+         copy_ms, copy_ms / file_count);
+  printf("  remove: %.1f ms (%.3f ms per file)\n",
+         remove_ms, remove_ms / file_count);
+}
+
 }  // namespace fileapi
@@ -43,6 +43,9 @@ typedef FileSystemDirectoryDatabase::FileId FileId;
 typedef FileSystemDirectoryDatabase::FileInfo FileInfo;
 
 const int64 kFlushDelaySeconds = 10 * 60;  // 10 minutes
+// The directory databases defer modification time updates; this bounds how
+// many of them a crash can lose.
+const int64 kModificationTimeFlushDelaySeconds = 1;
 
 void InitFileInfo(
     FileSystemDirectoryDatabase::FileInfo* file_info,
@@ -1279,6 +1282,19 @@ void ObfuscatedFileUtil::MarkUsed() {
   else
     timer_.Start(FROM_HERE, base::TimeDelta::FromSeconds(kFlushDelaySeconds),
                  this, &ObfuscatedFileUtil::DropDatabases);
+  if (!modification_time_flush_timer_.IsRunning()) {
+    modification_time_flush_timer_.Start(
+        FROM_HERE,
+        base::TimeDelta::FromSeconds(kModificationTimeFlushDelaySeconds),
+        this, &ObfuscatedFileUtil::FlushModificationTimes);
+  }
+}
+
+void ObfuscatedFileUtil::FlushModificationTimes() {
+  for (DirectoryMap::iterator iter = directories_.begin();
+       iter != directories_.end(); ++iter) {
+    iter->second->FlushPendingModificationTimes();
+  }
 }
 
 void ObfuscatedFileUtil::DropDatabases() {
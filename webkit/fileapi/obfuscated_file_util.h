@@ -226,6 +226,7 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE ObfuscatedFileUtil
 
   void MarkUsed();
   void DropDatabases();
+  void FlushModificationTimes();
   bool InitOriginDatabase(bool create);
 
   base::PlatformFileError GenerateNewLocalPath(
@@ -240,6 +241,7 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE ObfuscatedFileUtil
   scoped_ptr<FileSystemOriginDatabase> origin_database_;
   base::FilePath file_system_directory_;
   base::OneShotTimer<ObfuscatedFileUtil> timer_;
+  base::OneShotTimer<ObfuscatedFileUtil> modification_time_flush_timer_;
 
   DISALLOW_COPY_AND_ASSIGN(ObfuscatedFileUtil);
 };
@@ -12,7 +12,8 @@
 namespace fileapi {
 
 namespace {
-// Don't start too many inflight operations.
+// Don't start too many inflight operations.  Both files and directories
+// count towards the limit.
 const int kMaxInflightOperations = 5;
 }
 
@@ -29,7 +30,7 @@ void RecursiveOperationDelegate::StartRecursiveOperation(
     const StatusCallback& callback) {
   callback_ = callback;
   pending_directories_.push(root);
-  ProcessNextDirectory();
+  ProcessPendingOperations();
 }
 
 LocalFileSystemOperation* RecursiveOperationDelegate::NewOperation(
@@ -64,61 +65,68 @@ const FileSystemContext* RecursiveOperationDelegate::file_system_context()
   return original_operation_->file_system_context();
 }
 
-void RecursiveOperationDelegate::ProcessNextDirectory() {
-  DCHECK(pending_files_.empty());
-  if (inflight_operations_ > 0)
-    return;
-  if (pending_directories_.empty()) {
-    callback_.Run(base::PLATFORM_FILE_OK);
-    return;
-  }
-  FileSystemURL url = pending_directories_.front();
-  pending_directories_.pop();
-  inflight_operations_++;
-  ProcessDirectory(
-      url, base::Bind(&RecursiveOperationDelegate::DidProcessDirectory,
-                      AsWeakPtr(), url));
-}
-
-void RecursiveOperationDelegate::ProcessPendingFiles() {
-  if (pending_files_.empty()) {
-    ProcessNextDirectory();
-    return;
-  }
-  while (!pending_files_.empty() &&
-         inflight_operations_ < kMaxInflightOperations) {
-    FileSystemURL url = pending_files_.front();
-    pending_files_.pop();
-    inflight_operations_++;
-    base::MessageLoopProxy::current()->PostTask(
-        FROM_HERE,
-        base::Bind(&RecursiveOperationDelegate::ProcessFile,
-                   AsWeakPtr(), url,
-                   base::Bind(&RecursiveOperationDelegate::DidProcessFile,
-                              AsWeakPtr())));
+void RecursiveOperationDelegate::ProcessPendingOperations() {
+  // Directories are only queued once their parent has been processed and
+  // read, so whatever is queued can run in any order, and independent
+  // subtrees are walked side by side.  Files go first to keep the queues
+  // short.
+  while (inflight_operations_ < kMaxInflightOperations) {
+    FileSystemURL url;
+    if (!pending_files_.empty()) {
+      url = pending_files_.front();
+      pending_files_.pop();
+      inflight_operations_++;
+      base::MessageLoopProxy::current()->PostTask(
+          FROM_HERE,
+          base::Bind(&RecursiveOperationDelegate::ProcessFile,
+                     AsWeakPtr(), url,
+                     base::Bind(&RecursiveOperationDelegate::DidProcessFile,
+                                AsWeakPtr())));
+    } else if (!pending_directories_.empty()) {
+      url = pending_directories_.front();
+      pending_directories_.pop();
+      inflight_operations_++;
+      base::MessageLoopProxy::current()->PostTask(
+          FROM_HERE,
+          base::Bind(&RecursiveOperationDelegate::ProcessDirectory,
+                     AsWeakPtr(), url,
+                     base::Bind(
+                         &RecursiveOperationDelegate::DidProcessDirectory,
+                         AsWeakPtr(), url)));
+    } else {
+      break;
+    }
   }
+  if (!inflight_operations_)
+    Done(base::PLATFORM_FILE_OK);
 }
 
 void RecursiveOperationDelegate::DidProcessFile(base::PlatformFileError error) {
   inflight_operations_--;
   DCHECK_GE(inflight_operations_, 0);
+  if (callback_.is_null())
+    return;
   if (error != base::PLATFORM_FILE_OK) {
-    callback_.Run(error);
+    Done(error);
     return;
   }
-  ProcessPendingFiles();
+  ProcessPendingOperations();
 }
 
 void RecursiveOperationDelegate::DidProcessDirectory(
     const FileSystemURL& url,
     base::PlatformFileError error) {
+  if (callback_.is_null()) {
+    inflight_operations_--;
+    return;
+  }
   if (error != base::PLATFORM_FILE_OK) {
-    callback_.Run(error);
+    DidProcessFile(error);
     return;
   }
   LocalFileSystemOperation* operation = NewOperation(url, &error);
   if (!operation) {
-    callback_.Run(error);
+    DidProcessFile(error);
     return;
   }
   operation->ReadDirectory(
@@ -131,6 +139,11 @@ void RecursiveOperationDelegate::DidReadDirectory(
     base::PlatformFileError error,
     const FileEntryList& entries,
     bool has_more) {
+  if (callback_.is_null()) {
+    if (!has_more)
+      inflight_operations_--;
+    return;
+  }
   if (error != base::PLATFORM_FILE_OK) {
     if (error == base::PLATFORM_FILE_ERROR_NOT_A_DIRECTORY) {
       // The given path may have been a file, so try RemoveFile now.
@@ -139,7 +152,7 @@ void RecursiveOperationDelegate::DidReadDirectory(
                              AsWeakPtr(), error));
       return;
     }
-    callback_.Run(error);
+    DidProcessFile(error);
     return;
   }
   for (size_t i = 0; i < entries.size(); i++) {
@@ -157,7 +170,7 @@ void RecursiveOperationDelegate::DidReadDirectory(
 
   inflight_operations_--;
   DCHECK_GE(inflight_operations_, 0);
-  ProcessPendingFiles();
+  ProcessPendingOperations();
 }
 
 void RecursiveOperationDelegate::DidTryProcessFile(
@@ -165,10 +178,20 @@ void RecursiveOperationDelegate::DidTryProcessFile(
     base::PlatformFileError error) {
   if (error == base::PLATFORM_FILE_ERROR_NOT_A_FILE) {
     // It wasn't a file either; returns with the previous error.
-    callback_.Run(previous_error);
-    return;
+    error = previous_error;
   }
   DidProcessFile(error);
 }
 
+void RecursiveOperationDelegate::Done(base::PlatformFileError error) {
+  // Drop whatever is still queued so that the operations in flight, if any,
+  // wind down without starting new ones or running the callback again.
+  pending_directories_ = std::queue<FileSystemURL>();
+  pending_files_ = std::queue<FileSystemURL>();
+  StatusCallback callback = callback_;
+  callback_.Reset();
+  // This may delete |this|.
+  callback.Run(error);
+}
+
 }  // namespace fileapi
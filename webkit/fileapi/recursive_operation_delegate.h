@@ -60,6 +60,9 @@ class RecursiveOperationDelegate
   // This will call ProcessFile and ProcessDirectory on each directory or file.
   // If the given |root| is a file this simply calls ProcessFile and exits.
   //
+  // Files and directories in independent subtrees may be processed in
+  // parallel, but a directory is always processed before its entries.
+  //
   // |callback| is fired with base::PLATFORM_FILE_OK when every file/directory
   // under |root| is processed, or fired earlier when any suboperation fails.
   void StartRecursiveOperation(const FileSystemURL& root,
@@ -75,8 +78,9 @@ class RecursiveOperationDelegate
   const FileSystemContext* file_system_context() const;
 
  private:
-  void ProcessNextDirectory();
-  void ProcessPendingFiles();
+  // Starts queued files and directories until kMaxInflightOperations are
+  // running, and finishes once nothing is queued or running.
+  void ProcessPendingOperations();
   void DidProcessFile(base::PlatformFileError error);
   void DidProcessDirectory(const FileSystemURL& url,
                            base::PlatformFileError error);
@@ -87,6 +91,9 @@ class RecursiveOperationDelegate
       bool has_more);
   void DidTryProcessFile(base::PlatformFileError previous_error,
                          base::PlatformFileError error);
+  // Runs |callback_| once, either on the first error or when every entry has
+  // been processed.
+  void Done(base::PlatformFileError error);
 
   LocalFileSystemOperation* original_operation_;
   StatusCallback callback_;
@@ -87,6 +87,8 @@ BufferedDataSource::BufferedDataSource(
       assume_fully_buffered_(false),
       streaming_(false),
       frame_(frame),
+      prefetch_loader_started_(false),
+      prefetch_loading_state_(BufferedResourceLoader::kLoading),
       intermediate_read_buffer_(new uint8[kInitialReadBufferSize]),
       intermediate_read_buffer_size_(kInitialReadBufferSize),
       render_loop_(render_loop),
@@ -213,6 +215,11 @@ void BufferedDataSource::SetBitrate(int bitrate) {
       &BufferedDataSource::SetBitrateTask, this, bitrate));
 }
 
+void BufferedDataSource::Prefetch(int64 position) {
+  render_loop_->PostTask(FROM_HERE, base::Bind(
+      &BufferedDataSource::PrefetchTask, this, position));
+}
+
 void BufferedDataSource::Read(
     int64 position, int size, uint8* data,
     const media::DataSource::ReadCB& read_cb) {
@@ -275,6 +282,9 @@ void BufferedDataSource::StopLoader() {
 
   if (loader_.get())
     loader_->Stop();
+
+  if (prefetch_loader_.get())
+    prefetch_loader_->Stop();
 }
 
 void BufferedDataSource::SetPlaybackRateTask(float playback_rate) {
@@ -286,6 +296,8 @@ void BufferedDataSource::SetPlaybackRateTask(float playback_rate) {
 
   playback_rate_ = playback_rate;
   loader_->SetPlaybackRate(playback_rate);
+  if (prefetch_loader_.get())
+    prefetch_loader_->SetPlaybackRate(playback_rate);
 
   if (!loader_->range_supported()) {
     // 200 responses end up not being reused to satisfy future range requests,
@@ -312,6 +324,42 @@ void BufferedDataSource::SetBitrateTask(int bitrate) {
 
   bitrate_ = bitrate;
   loader_->SetBitrate(bitrate);
+  if (prefetch_loader_.get())
+    prefetch_loader_->SetBitrate(bitrate);
+}
+
+void BufferedDataSource::PrefetchTask(int64 position) {
+  DCHECK(MessageLoop::current() == render_loop_);
+  {
+    base::AutoLock auto_lock(lock_);
+    if (stop_signal_received_ || !init_cb_.is_null())
+      return;
+  }
+
+  // Streaming resources can't be fetched by range, and there's no point in a
+  // second request if the data is already on its way.
+  if (!loader_.get() || !frame_ || streaming_ || loader_->CanReadAt(position))
+    return;
+
+  if (prefetch_loader_.get()) {
+    if (prefetch_loader_->CanReadAt(position))
+      return;
+    prefetch_loader_->Stop();
+  }
+
+  prefetch_loader_.reset(CreateResourceLoader(position, kPositionNotSpecified));
+  prefetch_loader_started_ = false;
+  // Don't let a state reported by a previous prefetch loader be forwarded
+  // when this one replaces |loader_|.
+  prefetch_loading_state_ = BufferedResourceLoader::kLoading;
+
+  BufferedResourceLoader* loader = prefetch_loader_.get();
+  loader->Start(
+      base::Bind(&BufferedDataSource::PrefetchStartCallback, this, loader),
+      base::Bind(&BufferedDataSource::PrefetchLoadingStateChangedCallback,
+                 this, loader),
+      base::Bind(&BufferedDataSource::PrefetchProgressCallback, this, loader),
+      frame_);
 }
 
 // This method is the place where actual read happens, |loader_| must be valid
@@ -426,6 +474,22 @@ void BufferedDataSource::ReadCallback(
     // Stop the resource load if it failed.
     loader_->Stop();
 
+    // Continue from the prefetch if it covers the read, e.g. because the
+    // demuxer hinted the position before seeking there.
+    if (status == BufferedResourceLoader::kCacheMiss &&
+        prefetch_loader_.get() &&
+        prefetch_loader_->CanReadAt(read_op_->position())) {
+      loader_.reset(prefetch_loader_.release());
+      LoadingStateChangedCallback(prefetch_loading_state_);
+
+      // Otherwise the read is issued by PrefetchStartCallback().
+      if (prefetch_loader_started_) {
+        render_loop_->PostTask(FROM_HERE, base::Bind(
+            &BufferedDataSource::ReadTask, this));
+      }
+      return;
+    }
+
     if (status == BufferedResourceLoader::kCacheMiss &&
         read_op_->retries() < kNumCacheMissRetries) {
       read_op_->IncrementRetries();
@@ -507,6 +571,48 @@ void BufferedDataSource::ProgressCallback(int64 position) {
   ReportOrQueueBufferedBytes(loader_->first_byte_position(), position);
 }
 
+void BufferedDataSource::PrefetchStartCallback(
+    BufferedResourceLoader* loader,
+    BufferedResourceLoader::Status status) {
+  DCHECK(MessageLoop::current() == render_loop_);
+
+  // A read has already been handed over to |loader| and is waiting for it.
+  if (loader == loader_.get()) {
+    PartialReadStartCallback(status);
+    return;
+  }
+
+  DCHECK_EQ(loader, prefetch_loader_.get());
+  if (status != BufferedResourceLoader::kOk) {
+    prefetch_loader_->Stop();
+    return;
+  }
+  prefetch_loader_started_ = true;
+}
+
+void BufferedDataSource::PrefetchLoadingStateChangedCallback(
+    BufferedResourceLoader* loader,
+    BufferedResourceLoader::LoadingState state) {
+  DCHECK(MessageLoop::current() == render_loop_);
+
+  if (loader == loader_.get()) {
+    LoadingStateChangedCallback(state);
+    return;
+  }
+
+  // Reported if and when |loader| replaces |loader_|.
+  prefetch_loading_state_ = state;
+}
+
+void BufferedDataSource::PrefetchProgressCallback(
+    BufferedResourceLoader* loader,
+    int64 position) {
+  DCHECK(MessageLoop::current() == render_loop_);
+
+  if (loader == loader_.get())
+    ProgressCallback(position);
+}
+
 void BufferedDataSource::ReportOrQueueBufferedBytes(int64 start, int64 end) {
   if (host())
     host()->AddBufferedByteRange(start, end);
@@ -74,6 +74,7 @@ class BufferedDataSource : public media::DataSource {
   virtual void set_host(media::DataSourceHost* host) OVERRIDE;
   virtual void Stop(const base::Closure& closure) OVERRIDE;
   virtual void SetPlaybackRate(float playback_rate) OVERRIDE;
+  virtual void Prefetch(int64 position) OVERRIDE;
 
   virtual void Read(int64 position, int size, uint8* data,
                     const media::DataSource::ReadCB& read_cb) OVERRIDE;
@@ -111,6 +112,10 @@ class BufferedDataSource : public media::DataSource {
   // Tells |loader_| the bitrate of the media.
   void SetBitrateTask(int bitrate);
 
+  // Starts |prefetch_loader_| at |position| unless |loader_| will already
+  // serve reads from there.
+  void PrefetchTask(int64 position);
+
   // The method that performs actual read. This method can only be executed on
   // the render thread.
   void ReadInternal();
@@ -127,6 +132,16 @@ class BufferedDataSource : public media::DataSource {
   void LoadingStateChangedCallback(BufferedResourceLoader::LoadingState state);
   void ProgressCallback(int64 position);
 
+  // Callbacks for a loader started by PrefetchTask(). They are forwarded to
+  // the callbacks above once |loader| has been handed over to |loader_|.
+  void PrefetchStartCallback(BufferedResourceLoader* loader,
+                             BufferedResourceLoader::Status status);
+  void PrefetchLoadingStateChangedCallback(
+      BufferedResourceLoader* loader,
+      BufferedResourceLoader::LoadingState state);
+  void PrefetchProgressCallback(BufferedResourceLoader* loader,
+                                int64 position);
+
   // Report a buffered byte range [start,end] or queue it for later
   // reporting if set_host() hasn't been called yet.
   void ReportOrQueueBufferedBytes(int64 start, int64 end);
@@ -157,6 +172,14 @@ class BufferedDataSource : public media::DataSource {
   // A resource loader for the media resource.
   scoped_ptr<BufferedResourceLoader> loader_;
 
+  // A second resource loader, running in parallel with |loader_|, started at
+  // the position passed to Prefetch(). It replaces |loader_| when a read
+  // misses |loader_| but falls within what this loader will fetch, so that a
+  // seek does not wait for a new request to start.
+  scoped_ptr<BufferedResourceLoader> prefetch_loader_;
+  bool prefetch_loader_started_;
+  BufferedResourceLoader::LoadingState prefetch_loading_state_;
+
   // Callback method from the pipeline for initialization.
   InitializeCB init_cb_;
 
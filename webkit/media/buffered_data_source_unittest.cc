@@ -66,6 +66,18 @@ class MockBufferedDataSource : public BufferedDataSource {
     return loader;
   }
 
+  // Prefetch loaders run alongside the current loader, so their loading state
+  // isn't tracked.
+  BufferedResourceLoader* CreateMockPrefetchLoader(int64 first_byte_position,
+                                                   int64 last_byte_position) {
+    BufferedResourceLoader* loader =
+        BufferedDataSource::CreateResourceLoader(first_byte_position,
+                                                 last_byte_position);
+    loader->test_loader_ =
+        scoped_ptr<WebURLLoader>(new NiceMock<MockWebURLLoader>());
+    return loader;
+  }
+
   bool loading() { return loading_; }
   void set_loading(bool loading) { loading_ = loading; }
   bool downloading() { return downloading_; }
@@ -160,6 +172,23 @@ class BufferedDataSourceTest : public testing::Test {
     message_loop_.RunUntilIdle();
   }
 
+  void ExpectCreatePrefetchLoader() {
+    EXPECT_CALL(*data_source_, CreateResourceLoader(_, _))
+        .WillOnce(Invoke(data_source_.get(),
+                         &MockBufferedDataSource::CreateMockPrefetchLoader));
+  }
+
+  void Prefetch(int64 position) {
+    data_source_->Prefetch(position);
+    message_loop_.RunUntilIdle();
+  }
+
+  void RespondToPrefetch(const WebURLResponse& response) {
+    prefetch_loader()->didReceiveResponse(
+        prefetch_loader()->active_loader_->loader_.get(), response);
+    message_loop_.RunUntilIdle();
+  }
+
   void Respond(const WebURLResponse& response) {
     loader()->didReceiveResponse(url_loader(), response);
     message_loop_.RunUntilIdle();
@@ -195,6 +224,9 @@ class BufferedDataSourceTest : public testing::Test {
   WebURLLoader* url_loader() {
     return loader()->active_loader_->loader_.get();
   }
+  BufferedResourceLoader* prefetch_loader() {
+    return data_source_->prefetch_loader_.get();
+  }
 
   Preload preload() { return data_source_->preload_; }
   BufferedResourceLoader::DeferStrategy defer_strategy() {
@@ -653,4 +685,70 @@ TEST_F(BufferedDataSourceTest, File_FinishLoading) {
   Stop();
 }
 
+TEST_F(BufferedDataSourceTest, Http_Prefetch_Seek) {
+  InitializeWith206Response();
+
+  // Hint a position far outside of what the current request will deliver.
+  ExpectCreatePrefetchLoader();
+  Prefetch(kFarReadPosition);
+  BufferedResourceLoader* prefetch = prefetch_loader();
+  ASSERT_TRUE(prefetch);
+  EXPECT_NE(prefetch, loader());
+  RespondToPrefetch(response_generator_->Generate206(kFarReadPosition));
+
+  // Seeking there continues from the prefetch instead of starting over.
+  ReadAt(kFarReadPosition);
+  EXPECT_EQ(prefetch, loader());
+  EXPECT_FALSE(prefetch_loader());
+
+  EXPECT_CALL(*this, ReadCallback(kDataSize));
+  EXPECT_CALL(host_, AddBufferedByteRange(kFarReadPosition,
+                                          kFarReadPosition + kDataSize - 1));
+  ReceiveData(kDataSize);
+
+  EXPECT_TRUE(data_source_->downloading());
+  Stop();
+}
+
+TEST_F(BufferedDataSourceTest, Http_Prefetch_SeekBeforeResponse) {
+  InitializeWith206Response();
+
+  ExpectCreatePrefetchLoader();
+  Prefetch(kFarReadPosition);
+  BufferedResourceLoader* prefetch = prefetch_loader();
+  ASSERT_TRUE(prefetch);
+
+  // The read is handed over while the prefetch is still starting and is
+  // issued once the response arrives.
+  ReadAt(kFarReadPosition);
+  EXPECT_EQ(prefetch, loader());
+  Respond(response_generator_->Generate206(kFarReadPosition));
+
+  EXPECT_CALL(*this, ReadCallback(kDataSize));
+  EXPECT_CALL(host_, AddBufferedByteRange(kFarReadPosition,
+                                          kFarReadPosition + kDataSize - 1));
+  ReceiveData(kDataSize);
+  Stop();
+}
+
+TEST_F(BufferedDataSourceTest, Http_Prefetch_AlreadyLoading) {
+  InitializeWith206Response();
+
+  // The current request will reach this position shortly.
+  Prefetch(kDataSize);
+  EXPECT_FALSE(prefetch_loader());
+  Stop();
+}
+
+TEST_F(BufferedDataSourceTest, Http_Prefetch_Streaming) {
+  Initialize(kHttpUrl, true);
+  EXPECT_CALL(host_, SetTotalBytes(response_generator_->content_length()));
+  Respond(response_generator_->Generate200());
+  EXPECT_TRUE(data_source_->IsStreaming());
+
+  Prefetch(kFarReadPosition);
+  EXPECT_FALSE(prefetch_loader());
+  Stop();
+}
+
 }  // namespace webkit_media
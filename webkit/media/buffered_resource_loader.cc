@@ -321,6 +321,21 @@ bool BufferedResourceLoader::range_supported() {
   return range_supported_;
 }
 
+bool BufferedResourceLoader::CanReadAt(int64 position) const {
+  if (loader_failed_)
+    return false;
+
+  int64 offset = position - offset_;
+  if (offset < -buffer_.backward_bytes())
+    return false;
+
+  if (offset < buffer_.forward_bytes())
+    return true;
+
+  return active_loader_.get() &&
+      offset - buffer_.forward_bytes() < kForwardWaitThreshold;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // WebKit::WebURLLoaderClient implementation.
 void BufferedResourceLoader::willSendRequest(
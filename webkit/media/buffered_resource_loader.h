@@ -136,6 +136,11 @@ class BufferedResourceLoader : public WebKit::WebURLLoaderClient {
   // Returns true if the server supports byte range requests.
   bool range_supported();
 
+  // Returns true if a Read() starting at |position| can be served from what
+  // is buffered or is about to arrive on the current request, i.e. it would
+  // not result in kCacheMiss. Also true for a loader that is still starting.
+  bool CanReadAt(int64 position) const;
+
   // WebKit::WebURLLoaderClient implementation.
   virtual void willSendRequest(
       WebKit::WebURLLoader* loader,
@@ -28,6 +28,7 @@ namespace webkit_media {
 // stream. Some decoder may only accept certain types of streams.
 static void AddDefaultDecodersToCollection(
     const scoped_refptr<base::MessageLoopProxy>& message_loop,
+    const scoped_refptr<media::MediaScheduler::Player>& scheduler_player,
     media::FilterCollection* filter_collection) {
 
   scoped_refptr<media::FFmpegAudioDecoder> ffmpeg_audio_decoder =
@@ -43,6 +44,7 @@ static void AddDefaultDecodersToCollection(
 
   scoped_refptr<media::FFmpegVideoDecoder> ffmpeg_video_decoder =
       new media::FFmpegVideoDecoder(message_loop);
+  ffmpeg_video_decoder->set_scheduler_player(scheduler_player);
   filter_collection->GetVideoDecoders()->push_back(ffmpeg_video_decoder);
 
   if (cmd_line->HasSwitch(switches::kEnableVp9Playback)) {
@@ -79,6 +81,7 @@ bool BuildMediaStreamCollection(
 void BuildMediaSourceCollection(
     const scoped_refptr<media::ChunkDemuxer>& demuxer,
     const scoped_refptr<base::MessageLoopProxy>& message_loop,
+    const scoped_refptr<media::MediaScheduler::Player>& scheduler_player,
     media::FilterCollection* filter_collection) {
   DCHECK(demuxer);
   filter_collection->SetDemuxer(demuxer);
@@ -88,17 +91,20 @@ void BuildMediaSourceCollection(
   DCHECK_LE(filter_collection->GetVideoDecoders()->size(), 1u);
   filter_collection->GetVideoDecoders()->clear();
 
-  AddDefaultDecodersToCollection(message_loop, filter_collection);
+  AddDefaultDecodersToCollection(message_loop, scheduler_player,
+                                 filter_collection);
 }
 
 void BuildDefaultCollection(
     const scoped_refptr<media::DataSource>& data_source,
     const scoped_refptr<base::MessageLoopProxy>& message_loop,
+    const scoped_refptr<media::MediaScheduler::Player>& scheduler_player,
     media::FilterCollection* filter_collection) {
   filter_collection->SetDemuxer(new media::FFmpegDemuxer(
       message_loop, data_source));
 
-  AddDefaultDecodersToCollection(message_loop, filter_collection);
+  AddDefaultDecodersToCollection(message_loop, scheduler_player,
+                                 filter_collection);
 }
 
 }  // webkit_media
@@ -7,6 +7,7 @@
 
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
+#include "media/base/media_scheduler.h"
 
 namespace base {
 class MessageLoopProxy;
@@ -38,17 +39,21 @@ bool BuildMediaStreamCollection(
     media::FilterCollection* filter_collection);
 
 // Builds the required filters for handling media source URLs, adds them to
-// |filter_collection|.
+// |filter_collection|.  The software video decoder follows the policy given
+// to |scheduler_player|.
 void BuildMediaSourceCollection(
     const scoped_refptr<media::ChunkDemuxer>& demuxer,
     const scoped_refptr<base::MessageLoopProxy>& message_loop,
+    const scoped_refptr<media::MediaScheduler::Player>& scheduler_player,
     media::FilterCollection* filter_collection);
 
 // Builds the required filters for handling regular URLs and adds them to
 // |filter_collection| and fills |video_decoder| returning true if successful.
+// The software video decoder follows the policy given to |scheduler_player|.
 void BuildDefaultCollection(
     const scoped_refptr<media::DataSource>& data_source,
     const scoped_refptr<base::MessageLoopProxy>& message_loop,
+    const scoped_refptr<media::MediaScheduler::Player>& scheduler_player,
     media::FilterCollection* filter_collection);
 
 }  // webkit_media
@@ -20,6 +20,7 @@
 #include "media/base/filter_collection.h"
 #include "media/base/limits.h"
 #include "media/base/media_log.h"
+#include "media/base/media_scheduler.h"
 #include "media/base/pipeline.h"
 #include "media/base/video_frame.h"
 #include "media/filters/audio_renderer_impl.h"
@@ -137,6 +138,8 @@ WebMediaPlayerImpl::WebMediaPlayerImpl(
       client_(client),
       proxy_(new WebMediaPlayerProxy(main_loop_->message_loop_proxy(), this)),
       delegate_(delegate),
+      scheduler_player_(media::MediaScheduler::GetInstance()->AddPlayer(
+          delegate.get())),
       media_stream_client_(params.media_stream_client()),
       media_log_(params.media_log()),
       accelerated_compositing_reported_(false),
@@ -290,6 +293,7 @@ void WebMediaPlayerImpl::load(const WebKit::WebURL& url, CORSMode cors_mode) {
 
     BuildMediaSourceCollection(chunk_demuxer_,
                                media_thread_.message_loop_proxy(),
+                               scheduler_player_,
                                filter_collection_.get());
     supports_save_ = false;
     StartPipeline();
@@ -311,6 +315,7 @@ void WebMediaPlayerImpl::load(const WebKit::WebURL& url, CORSMode cors_mode) {
 
   BuildDefaultCollection(proxy_->data_source(),
                          media_thread_.message_loop_proxy(),
+                         scheduler_player_,
                          filter_collection_.get());
 }
 
@@ -323,6 +328,7 @@ void WebMediaPlayerImpl::play() {
 
   paused_ = false;
   pipeline_->SetPlaybackRate(playback_rate_);
+  scheduler_player_->SetPlaying(true);
 
   media_log_->AddEvent(media_log_->CreateEvent(media::MediaLogEvent::PLAY));
 
@@ -336,6 +342,7 @@ void WebMediaPlayerImpl::pause() {
   paused_ = true;
   pipeline_->SetPlaybackRate(0.0f);
   paused_time_ = pipeline_->GetMediaTime();
+  scheduler_player_->SetPlaying(false);
 
   media_log_->AddEvent(media_log_->CreateEvent(media::MediaLogEvent::PAUSE));
 
@@ -374,6 +381,9 @@ void WebMediaPlayerImpl::seek(float seconds) {
 
   seeking_ = true;
 
+  // Playback resumes after seeking past the end, e.g. when looping.
+  scheduler_player_->SetPlaying(!paused_);
+
   if (chunk_demuxer_)
     chunk_demuxer_->StartWaitingForSeek();
 
@@ -574,7 +584,9 @@ unsigned long long WebMediaPlayerImpl::totalBytes() const {
 void WebMediaPlayerImpl::setSize(const WebSize& size) {
   DCHECK_EQ(main_loop_, MessageLoop::current());
 
-  // Don't need to do anything as we use the dimensions passed in via paint().
+  // Painting uses the dimensions passed in via paint(), the size only helps
+  // to share the cores between players.
+  scheduler_player_->SetSize(gfx::Size(size.width, size.height));
 }
 
 void WebMediaPlayerImpl::paint(WebCanvas* canvas,
@@ -926,6 +938,7 @@ void WebMediaPlayerImpl::OnPipelineSeek(PipelineStatus status) {
 
 void WebMediaPlayerImpl::OnPipelineEnded() {
   DCHECK_EQ(main_loop_, MessageLoop::current());
+  scheduler_player_->SetPlaying(false);
   GetClient()->timeChanged();
 }
 
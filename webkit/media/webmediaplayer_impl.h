@@ -58,6 +58,7 @@
 #include "googleurl/src/gurl.h"
 #include "media/base/audio_renderer_sink.h"
 #include "media/base/decryptor.h"
+#include "media/base/media_scheduler.h"
 #include "media/base/pipeline.h"
 #include "skia/ext/platform_canvas.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebAudioSourceProvider.h"
@@ -322,6 +323,9 @@ class WebMediaPlayerImpl
 
   base::WeakPtr<WebMediaPlayerDelegate> delegate_;
 
+  // Entry in the process-wide MediaScheduler, on the page of |delegate_|.
+  scoped_refptr<media::MediaScheduler::Player> scheduler_player_;
+
   MediaStreamClient* media_stream_client_;
 
   scoped_refptr<media::MediaLog> media_log_;
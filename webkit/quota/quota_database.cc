@@ -9,6 +9,7 @@
 #include "base/auto_reset.h"
 #include "base/bind.h"
 #include "base/file_util.h"
+#include "base/string_number_conversions.h"
 #include "base/time.h"
 #include "googleurl/src/gurl.h"
 #include "sql/connection.h"
@@ -22,12 +23,18 @@ namespace {
 
 // Definitions for database schema.
 
-const int kCurrentVersion = 4;
+const int kCurrentVersion = 5;
 const int kCompatibleVersion = 2;
 
 const char kHostQuotaTable[] = "HostQuotaTable";
 const char kOriginInfoTable[] = "OriginInfoTable";
+const char kOriginUsageTable[] = "OriginUsageTable";
 const char kIsOriginTableBootstrapped[] = "IsOriginTableBootstrapped";
+const char kUsageLedgerClientMaskPrefix[] = "UsageLedgerClientMask";
+
+std::string UsageLedgerClientMaskKey(StorageType type) {
+  return kUsageLedgerClientMaskPrefix + base::IntToString(type);
+}
 
 bool VerifyValidQuotaConfig(const char* key) {
   return (key != NULL &&
@@ -57,6 +64,12 @@ const QuotaDatabase::TableSchema QuotaDatabase::kTables[] = {
     " last_access_time INTEGER DEFAULT 0,"
     " last_modified_time INTEGER DEFAULT 0,"
     " UNIQUE(origin, type))" },
+  { kOriginUsageTable,
+    "(origin TEXT NOT NULL,"
+    " type INTEGER NOT NULL,"
+    " client_id INTEGER NOT NULL,"
+    " usage INTEGER DEFAULT 0,"
+    " UNIQUE(origin, type, client_id))" },
 };
 
 // static
@@ -120,6 +133,23 @@ QuotaDatabase::OriginInfoTableEntry::OriginInfoTableEntry(
       last_modified_time(last_modified_time) {
 }
 
+QuotaDatabase::OriginUsageTableEntry::OriginUsageTableEntry()
+    : type(kStorageTypeUnknown),
+      client_id(QuotaClient::kUnknown),
+      usage(0) {
+}
+
+QuotaDatabase::OriginUsageTableEntry::OriginUsageTableEntry(
+    const GURL& origin,
+    StorageType type,
+    QuotaClient::ID client_id,
+    int64 usage)
+    : origin(origin),
+      type(type),
+      client_id(client_id),
+      usage(usage) {
+}
+
 // QuotaDatabase ------------------------------------------------------------
 QuotaDatabase::QuotaDatabase(const base::FilePath& path)
     : db_file_path_(path),
@@ -355,6 +385,37 @@ bool QuotaDatabase::GetLRUOrigin(
   return statement.Succeeded();
 }
 
+bool QuotaDatabase::GetLRUOrigins(
+    StorageType type,
+    const std::set<GURL>& exceptions,
+    SpecialStoragePolicy* special_storage_policy,
+    size_t max_origins,
+    std::vector<GURL>* origins) {
+  DCHECK(origins);
+  origins->clear();
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql = "SELECT origin FROM OriginInfoTable"
+                     " WHERE type = ?"
+                     " ORDER BY last_access_time ASC";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindInt(0, static_cast<int>(type));
+
+  while (origins->size() < max_origins && statement.Step()) {
+    GURL url(statement.ColumnString(0));
+    if (exceptions.find(url) != exceptions.end())
+      continue;
+    if (special_storage_policy &&
+        special_storage_policy->IsStorageUnlimited(url))
+      continue;
+    origins->push_back(url);
+  }
+
+  return statement.Succeeded();
+}
+
 bool QuotaDatabase::GetOriginsModifiedSince(
     StorageType type, std::set<GURL>* origins, base::Time modified_since) {
   DCHECK(origins);
@@ -390,6 +451,106 @@ bool QuotaDatabase::SetOriginDatabaseBootstrapped(bool bootstrap_flag) {
   return meta_table_->SetValue(kIsOriginTableBootstrapped, bootstrap_flag);
 }
 
+bool QuotaDatabase::GetOriginUsages(
+    StorageType type, OriginUsageTableEntries* entries) {
+  DCHECK(entries);
+  entries->clear();
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql = "SELECT origin, client_id, usage FROM OriginUsageTable"
+                     " WHERE type = ?";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindInt(0, static_cast<int>(type));
+
+  while (statement.Step()) {
+    entries->push_back(OriginUsageTableEntry(
+        GURL(statement.ColumnString(0)),
+        type,
+        static_cast<QuotaClient::ID>(statement.ColumnInt(1)),
+        statement.ColumnInt64(2)));
+  }
+
+  return statement.Succeeded();
+}
+
+bool QuotaDatabase::SetOriginUsages(const OriginUsageTableEntries& entries) {
+  if (entries.empty())
+    return true;
+  if (!LazyOpen(true))
+    return false;
+
+  for (OriginUsageTableEntries::const_iterator itr = entries.begin();
+       itr != entries.end(); ++itr) {
+    sql::Statement statement;
+    int index = 0;
+    if (itr->usage > 0) {
+      const char* kSql =
+          "INSERT OR REPLACE INTO OriginUsageTable"
+          " (usage, origin, type, client_id)"
+          " VALUES (?, ?, ?, ?)";
+      statement.Assign(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+      statement.BindInt64(index++, itr->usage);
+    } else {
+      const char* kSql =
+          "DELETE FROM OriginUsageTable"
+          " WHERE origin = ? AND type = ? AND client_id = ?";
+      statement.Assign(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+    }
+    statement.BindString(index++, itr->origin.spec());
+    statement.BindInt(index++, static_cast<int>(itr->type));
+    statement.BindInt(index++, static_cast<int>(itr->client_id));
+
+    if (!statement.Run())
+      return false;
+  }
+
+  ScheduleCommit();
+  return true;
+}
+
+bool QuotaDatabase::DeleteOriginUsages(StorageType type, int client_mask) {
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql =
+      "DELETE FROM OriginUsageTable"
+      " WHERE type = ? AND (client_id & ?) != 0";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindInt(0, static_cast<int>(type));
+  statement.BindInt(1, client_mask);
+
+  if (!statement.Run())
+    return false;
+
+  ScheduleCommit();
+  return true;
+}
+
+bool QuotaDatabase::GetUsageLedgerClientMask(StorageType type,
+                                             int* client_mask) {
+  DCHECK(client_mask);
+  if (!LazyOpen(false))
+    return false;
+  return meta_table_->GetValue(UsageLedgerClientMaskKey(type).c_str(),
+                               client_mask);
+}
+
+bool QuotaDatabase::SetUsageLedgerClientMask(StorageType type,
+                                             int client_mask) {
+  if (!LazyOpen(true))
+    return false;
+
+  if (!meta_table_->SetValue(UsageLedgerClientMaskKey(type).c_str(),
+                             client_mask)) {
+    return false;
+  }
+  Commit();
+  return true;
+}
+
 void QuotaDatabase::Commit() {
   if (!db_.get())
     return;
@@ -589,9 +750,32 @@ bool QuotaDatabase::UpgradeSchema(int current_version) {
     Commit();
     return true;
   }
+  if (current_version == 4) {
+    // Version 5 adds the usage ledger.
+    sql::Transaction transaction(db_.get());
+    if (!transaction.Begin() || !CreateMissingTables())
+      return false;
+    meta_table_->SetVersionNumber(kCurrentVersion);
+    return transaction.Commit();
+  }
   return false;
 }
 
+bool QuotaDatabase::CreateMissingTables() {
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(kTables); ++i) {
+    if (db_->DoesTableExist(kTables[i].table_name))
+      continue;
+    std::string sql("CREATE TABLE ");
+    sql += kTables[i].table_name;
+    sql += kTables[i].columns;
+    if (!db_->Execute(sql.c_str())) {
+      VLOG(1) << "Failed to execute " << sql;
+      return false;
+    }
+  }
+  return true;
+}
+
 bool QuotaDatabase::DumpQuotaTable(QuotaTableCallback* callback) {
   scoped_ptr<QuotaTableCallback> callback_deleter(callback);
   if (!LazyOpen(true))
@@ -7,6 +7,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/callback.h"
@@ -16,6 +17,7 @@
 #include "base/time.h"
 #include "base/timer.h"
 #include "googleurl/src/gurl.h"
+#include "webkit/quota/quota_client.h"
 #include "webkit/quota/quota_types.h"
 #include "webkit/storage/webkit_storage_export.h"
 
@@ -37,6 +39,20 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE QuotaDatabase {
   static const char kDesiredAvailableSpaceKey[];
   static const char kTemporaryQuotaOverrideKey[];
 
+  struct WEBKIT_STORAGE_EXPORT_PRIVATE OriginUsageTableEntry {
+    OriginUsageTableEntry();
+    OriginUsageTableEntry(
+        const GURL& origin,
+        StorageType type,
+        QuotaClient::ID client_id,
+        int64 usage);
+    GURL origin;
+    StorageType type;
+    QuotaClient::ID client_id;
+    int64 usage;
+  };
+  typedef std::vector<OriginUsageTableEntry> OriginUsageTableEntries;
+
   // If 'path' is empty, an in memory database will be used.
   explicit QuotaDatabase(const base::FilePath& path);
   ~QuotaDatabase();
@@ -75,6 +91,14 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE QuotaDatabase {
                     SpecialStoragePolicy* special_storage_policy,
                     GURL* origin);
 
+  // Like GetLRUOrigin, but populates |origins| with up to |max_origins|
+  // origins, least recently used first.
+  bool GetLRUOrigins(StorageType type,
+                     const std::set<GURL>& exceptions,
+                     SpecialStoragePolicy* special_storage_policy,
+                     size_t max_origins,
+                     std::vector<GURL>* origins);
+
   // Populates |origins| with the ones that have been modified since
   // the |modified_since|.
   bool GetOriginsModifiedSince(StorageType type,
@@ -87,6 +111,24 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE QuotaDatabase {
   bool IsOriginDatabaseBootstrapped();
   bool SetOriginDatabaseBootstrapped(bool bootstrap_flag);
 
+  // The usage ledger keeps the last known usage of each origin per client,
+  // so that the usage cache can be restored without asking the clients.
+  bool GetOriginUsages(StorageType type, OriginUsageTableEntries* entries);
+
+  // Entries with no usage are removed from the ledger.
+  bool SetOriginUsages(const OriginUsageTableEntries& entries);
+
+  // Deletes the entries of |type| that belong to the clients in
+  // |client_mask|.
+  bool DeleteOriginUsages(StorageType type, int client_mask);
+
+  // The client mask of a ledger tells which clients it accounts for
+  // completely. It is set when a session closes the ledger and cleared
+  // when the next one starts updating it. Setting it commits right away,
+  // so that a crash leaves it cleared.
+  bool GetUsageLedgerClientMask(StorageType type, int* client_mask);
+  bool SetUsageLedgerClientMask(StorageType type, int client_mask);
+
  private:
   struct WEBKIT_STORAGE_EXPORT_PRIVATE QuotaTableEntry {
     QuotaTableEntry();
@@ -163,6 +205,9 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE QuotaDatabase {
   bool DumpQuotaTable(QuotaTableCallback* callback);
   bool DumpOriginInfoTable(OriginInfoTableCallback* callback);
 
+  // Creates the tables of the current schema that don't exist yet.
+  bool CreateMissingTables();
+
   base::FilePath db_file_path_;
 
   scoped_ptr<sql::Connection> db_;
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <iterator>
 #include <set>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/callback.h"
@@ -45,6 +46,8 @@ class QuotaDatabaseTest : public testing::Test {
   typedef QuotaDatabase::QuotaTableCallback QuotaTableCallback;
   typedef QuotaDatabase::OriginInfoTableCallback
       OriginInfoTableCallback;
+  typedef QuotaDatabase::OriginUsageTableEntry OriginUsageTableEntry;
+  typedef QuotaDatabase::OriginUsageTableEntries OriginUsageTableEntries;
 
   void LazyOpen(const base::FilePath& kDbFile) {
     QuotaDatabase db(kDbFile);
@@ -76,6 +79,35 @@ class QuotaDatabaseTest : public testing::Test {
     EXPECT_TRUE(verifier.table.empty());
   }
 
+  void UpgradeSchemaV4toV5(const base::FilePath& kDbFile) {
+    {
+      QuotaDatabase db(kDbFile);
+      ASSERT_TRUE(db.LazyOpen(true));
+    }
+    {
+      // Turn it back into a version 4 database, which has no usage ledger.
+      sql::Connection connection;
+      ASSERT_TRUE(connection.Open(kDbFile));
+      ASSERT_TRUE(connection.Execute("DROP TABLE OriginUsageTable"));
+      sql::MetaTable meta_table;
+      ASSERT_TRUE(meta_table.Init(&connection, 4, 2));
+      meta_table.SetVersionNumber(4);
+    }
+
+    QuotaDatabase db(kDbFile);
+    ASSERT_TRUE(db.LazyOpen(false));
+    EXPECT_TRUE(db.db_->DoesTableExist("OriginUsageTable"));
+    EXPECT_EQ(5, db.meta_table_->GetVersionNumber());
+
+    OriginUsageTableEntries entries;
+    entries.push_back(OriginUsageTableEntry(
+        GURL("http://a/"), kStorageTypeTemporary, QuotaClient::kDatabase, 7));
+    EXPECT_TRUE(db.SetOriginUsages(entries));
+    EXPECT_TRUE(db.GetOriginUsages(kStorageTypeTemporary, &entries));
+    ASSERT_EQ(1U, entries.size());
+    EXPECT_EQ(7, entries[0].usage);
+  }
+
   void HostQuota(const base::FilePath& kDbFile) {
     QuotaDatabase db(kDbFile);
     ASSERT_TRUE(db.LazyOpen(true));
@@ -211,6 +243,113 @@ class QuotaDatabaseTest : public testing::Test {
     EXPECT_TRUE(origin.is_empty());
   }
 
+  void OriginLastAccessTimeLRUBatch(const base::FilePath& kDbFile) {
+    QuotaDatabase db(kDbFile);
+    ASSERT_TRUE(db.LazyOpen(true));
+
+    std::set<GURL> exceptions;
+    std::vector<GURL> origins;
+    EXPECT_TRUE(db.GetLRUOrigins(kStorageTypeTemporary, exceptions,
+                                 NULL, 10, &origins));
+    EXPECT_TRUE(origins.empty());
+
+    const GURL kOrigin1("http://a/");
+    const GURL kOrigin2("http://b/");
+    const GURL kOrigin3("http://c/");
+    const GURL kOrigin4("http://p/");
+    EXPECT_TRUE(db.SetOriginLastAccessTime(
+        kOrigin3, kStorageTypeTemporary, base::Time::FromInternalValue(30)));
+    EXPECT_TRUE(db.SetOriginLastAccessTime(
+        kOrigin1, kStorageTypeTemporary, base::Time::FromInternalValue(10)));
+    EXPECT_TRUE(db.SetOriginLastAccessTime(
+        kOrigin2, kStorageTypeTemporary, base::Time::FromInternalValue(20)));
+    EXPECT_TRUE(db.SetOriginLastAccessTime(
+        kOrigin4, kStorageTypePersistent, base::Time::FromInternalValue(5)));
+
+    EXPECT_TRUE(db.GetLRUOrigins(kStorageTypeTemporary, exceptions,
+                                 NULL, 10, &origins));
+    ASSERT_EQ(3U, origins.size());
+    EXPECT_EQ(kOrigin1.spec(), origins[0].spec());
+    EXPECT_EQ(kOrigin2.spec(), origins[1].spec());
+    EXPECT_EQ(kOrigin3.spec(), origins[2].spec());
+
+    EXPECT_TRUE(db.GetLRUOrigins(kStorageTypeTemporary, exceptions,
+                                 NULL, 2, &origins));
+    ASSERT_EQ(2U, origins.size());
+    EXPECT_EQ(kOrigin1.spec(), origins[0].spec());
+    EXPECT_EQ(kOrigin2.spec(), origins[1].spec());
+
+    // Exceptions and unlimited origins are skipped without counting
+    // against the limit.
+    scoped_refptr<MockSpecialStoragePolicy> policy(
+        new MockSpecialStoragePolicy);
+    policy->AddUnlimited(kOrigin2);
+    exceptions.insert(kOrigin1);
+    EXPECT_TRUE(db.GetLRUOrigins(kStorageTypeTemporary, exceptions,
+                                 policy, 2, &origins));
+    ASSERT_EQ(1U, origins.size());
+    EXPECT_EQ(kOrigin3.spec(), origins[0].spec());
+  }
+
+  void OriginUsage(const base::FilePath& kDbFile) {
+    const GURL kOrigin1("http://a/");
+    const GURL kOrigin2("http://b/");
+    const StorageType kTemp = kStorageTypeTemporary;
+    const StorageType kPerm = kStorageTypePersistent;
+    const QuotaClient::ID kFileSystem = QuotaClient::kFileSystem;
+    const QuotaClient::ID kDatabase = QuotaClient::kDatabase;
+
+    QuotaDatabase db(kDbFile);
+    int client_mask = -1;
+    EXPECT_FALSE(db.GetUsageLedgerClientMask(kTemp, &client_mask));
+    OriginUsageTableEntries entries;
+    EXPECT_FALSE(db.GetOriginUsages(kTemp, &entries));
+
+    OriginUsageTableEntries updates;
+    updates.push_back(OriginUsageTableEntry(kOrigin1, kTemp, kFileSystem, 1));
+    updates.push_back(OriginUsageTableEntry(kOrigin1, kTemp, kDatabase, 2));
+    updates.push_back(OriginUsageTableEntry(kOrigin2, kTemp, kDatabase, 4));
+    updates.push_back(OriginUsageTableEntry(kOrigin1, kPerm, kFileSystem, 8));
+    EXPECT_TRUE(db.SetOriginUsages(updates));
+    EXPECT_TRUE(db.GetOriginUsages(kTemp, &entries));
+    EXPECT_EQ(3U, entries.size());
+    int64 total_usage = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      EXPECT_EQ(kTemp, entries[i].type);
+      total_usage += entries[i].usage;
+    }
+    EXPECT_EQ(1 + 2 + 4, total_usage);
+
+    // Updates replace the entries, no usage removes them.
+    updates.clear();
+    updates.push_back(OriginUsageTableEntry(kOrigin1, kTemp, kFileSystem, 16));
+    updates.push_back(OriginUsageTableEntry(kOrigin2, kTemp, kDatabase, 0));
+    EXPECT_TRUE(db.SetOriginUsages(updates));
+    EXPECT_TRUE(db.GetOriginUsages(kTemp, &entries));
+    EXPECT_EQ(2U, entries.size());
+    total_usage = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+      total_usage += entries[i].usage;
+    EXPECT_EQ(16 + 2, total_usage);
+
+    EXPECT_TRUE(db.DeleteOriginUsages(kTemp, kDatabase));
+    EXPECT_TRUE(db.GetOriginUsages(kTemp, &entries));
+    ASSERT_EQ(1U, entries.size());
+    EXPECT_EQ(kOrigin1, entries[0].origin);
+    EXPECT_EQ(kFileSystem, entries[0].client_id);
+    EXPECT_EQ(16, entries[0].usage);
+    EXPECT_TRUE(db.GetOriginUsages(kPerm, &entries));
+    EXPECT_EQ(1U, entries.size());
+
+    EXPECT_TRUE(db.SetUsageLedgerClientMask(kTemp, kFileSystem | kDatabase));
+    EXPECT_TRUE(db.GetUsageLedgerClientMask(kTemp, &client_mask));
+    EXPECT_EQ(kFileSystem | kDatabase, client_mask);
+    EXPECT_FALSE(db.GetUsageLedgerClientMask(kPerm, &client_mask));
+    EXPECT_TRUE(db.SetUsageLedgerClientMask(kTemp, 0));
+    EXPECT_TRUE(db.GetUsageLedgerClientMask(kTemp, &client_mask));
+    EXPECT_EQ(0, client_mask);
+  }
+
   void OriginLastModifiedSince(const base::FilePath& kDbFile) {
     QuotaDatabase db(kDbFile);
     ASSERT_TRUE(db.LazyOpen(true));
@@ -507,6 +646,13 @@ TEST_F(QuotaDatabaseTest, UpgradeSchema) {
   UpgradeSchemaV2toV3(kDbFile);
 }
 
+TEST_F(QuotaDatabaseTest, UpgradeSchemaV4toV5) {
+  base::ScopedTempDir data_dir;
+  ASSERT_TRUE(data_dir.CreateUniqueTempDir());
+  const base::FilePath kDbFile = data_dir.path().AppendASCII("quota_manager.db");
+  UpgradeSchemaV4toV5(kDbFile);
+}
+
 TEST_F(QuotaDatabaseTest, HostQuota) {
   base::ScopedTempDir data_dir;
   ASSERT_TRUE(data_dir.CreateUniqueTempDir());
@@ -531,6 +677,22 @@ TEST_F(QuotaDatabaseTest, OriginLastAccessTimeLRU) {
   OriginLastAccessTimeLRU(base::FilePath());
 }
 
+TEST_F(QuotaDatabaseTest, OriginLastAccessTimeLRUBatch) {
+  base::ScopedTempDir data_dir;
+  ASSERT_TRUE(data_dir.CreateUniqueTempDir());
+  const base::FilePath kDbFile = data_dir.path().AppendASCII("quota_manager.db");
+  OriginLastAccessTimeLRUBatch(kDbFile);
+  OriginLastAccessTimeLRUBatch(base::FilePath());
+}
+
+TEST_F(QuotaDatabaseTest, OriginUsage) {
+  base::ScopedTempDir data_dir;
+  ASSERT_TRUE(data_dir.CreateUniqueTempDir());
+  const base::FilePath kDbFile = data_dir.path().AppendASCII("quota_manager.db");
+  OriginUsage(kDbFile);
+  OriginUsage(base::FilePath());
+}
+
 TEST_F(QuotaDatabaseTest, OriginLastModifiedSince) {
   base::ScopedTempDir data_dir;
   ASSERT_TRUE(data_dir.CreateUniqueTempDir());
@@ -44,6 +44,20 @@ const int64 kIncognitoDefaultTemporaryQuota = 50 * kMBytes;
 const int64 kReportHistogramInterval = 60 * 60 * 1000;  // 1 hour
 const double kTemporaryQuotaRatioToAvail = 0.5;  // 50%
 
+// The usage ledger is written back and a few origins of each client are
+// verified against the client at this interval.
+const int64 kUsageLedgerInterval = 5 * kMinutesInMilliSeconds;
+const size_t kOriginsToVerifyPerClient = 100;
+
+// Upper bound of the number of origins evicted in one round.
+const size_t kMaxOriginsPerEvictionRound = 20;
+
+const StorageType kUsageLedgerTypes[] = {
+  kStorageTypeTemporary,
+  kStorageTypePersistent,
+  kStorageTypeSyncable,
+};
+
 void CountOriginType(const std::set<GURL>& origins,
                      SpecialStoragePolicy* policy,
                      size_t* protected_origins,
@@ -114,6 +128,17 @@ bool GetLRUOriginOnDBThread(StorageType type,
   return true;
 }
 
+bool GetLRUOriginsOnDBThread(StorageType type,
+                             std::set<GURL>* exceptions,
+                             SpecialStoragePolicy* policy,
+                             size_t max_origins,
+                             std::vector<GURL>* urls,
+                             QuotaDatabase* database) {
+  DCHECK(database);
+  database->GetLRUOrigins(type, *exceptions, policy, max_origins, urls);
+  return true;
+}
+
 bool DeleteOriginInfoOnDBThread(const GURL& origin,
                                 StorageType type,
                                 QuotaDatabase* database) {
@@ -151,6 +176,45 @@ bool UpdateModifiedTimeOnDBThread(const GURL& origin,
   return database->SetOriginLastModifiedTime(origin, type, modified_time);
 }
 
+bool LoadUsageLedgerOnDBThread(
+    StorageType type,
+    int* client_mask,
+    QuotaDatabase::OriginUsageTableEntries* entries,
+    QuotaDatabase* database) {
+  DCHECK(database);
+  // Only the clients the last session accounted for completely can be
+  // restored from the ledger, the entries of the others would go stale.
+  if (!database->GetUsageLedgerClientMask(type, client_mask))
+    *client_mask = 0;
+  database->DeleteOriginUsages(type, ~*client_mask);
+  if (!*client_mask)
+    return true;
+
+  database->GetOriginUsages(type, entries);
+  // The ledger is incomplete until this session closes it.
+  if (database->SetUsageLedgerClientMask(type, 0))
+    return true;
+  *client_mask = 0;
+  return false;
+}
+
+bool SaveUsageLedgerOnDBThread(
+    const QuotaDatabase::OriginUsageTableEntries* entries,
+    QuotaDatabase* database) {
+  DCHECK(database);
+  return database->SetOriginUsages(*entries);
+}
+
+bool CloseUsageLedgerOnDBThread(
+    StorageType type,
+    const QuotaDatabase::OriginUsageTableEntries* entries,
+    int client_mask,
+    QuotaDatabase* database) {
+  DCHECK(database);
+  return database->SetOriginUsages(*entries) &&
+         database->SetUsageLedgerClientMask(type, client_mask);
+}
+
 int64 CallSystemGetAmountOfFreeDiskSpace(const base::FilePath& profile_path) {
   // Ensure the profile path exists.
   if(!file_util::CreateDirectory(profile_path)) {
@@ -1138,6 +1202,9 @@ bool QuotaManager::ResetUsageTracker(StorageType type) {
   DCHECK(GetUsageTracker(type));
   if (GetUsageTracker(type)->IsWorking())
     return false;
+  // Write back what the old tracker knows, the new one only writes what
+  // it learns.
+  SaveUsageLedger(type);
   switch (type) {
     case kStorageTypeTemporary:
       temporary_usage_tracker_.reset(
@@ -1162,6 +1229,8 @@ bool QuotaManager::ResetUsageTracker(StorageType type) {
 
 QuotaManager::~QuotaManager() {
   proxy_->manager_ = NULL;
+  if (database_.get())
+    CloseUsageLedger();
   std::for_each(clients_.begin(), clients_.end(),
                 std::mem_fun(&QuotaClient::OnQuotaManagerDestroyed));
   if (database_.get())
@@ -1196,6 +1265,26 @@ void QuotaManager::LazyInitialize() {
       new UsageTracker(clients_, kStorageTypeSyncable,
                        special_storage_policy_));
 
+  // Seed the trackers from the usage ledger before DidInitialize kicks the
+  // first global usage query.
+  if (!is_incognito_) {
+    for (size_t i = 0; i < arraysize(kUsageLedgerTypes); ++i) {
+      int* client_mask = new int(0);
+      OriginUsageTableEntries* entries = new OriginUsageTableEntries;
+      PostTaskAndReplyWithResultForDBThread(
+          FROM_HERE,
+          base::Bind(&LoadUsageLedgerOnDBThread,
+                     kUsageLedgerTypes[i],
+                     base::Unretained(client_mask),
+                     base::Unretained(entries)),
+          base::Bind(&QuotaManager::DidLoadUsageLedger,
+                     weak_factory_.GetWeakPtr(),
+                     kUsageLedgerTypes[i],
+                     base::Owned(client_mask),
+                     base::Owned(entries)));
+    }
+  }
+
   int64* temporary_quota_override = new int64(-1);
   int64* desired_available_space = new int64(-1);
   PostTaskAndReplyWithResultForDBThread(
@@ -1241,9 +1330,12 @@ void QuotaManager::NotifyStorageAccessedInternal(
     const GURL& origin, StorageType type,
     base::Time accessed_time) {
   LazyInitialize();
-  if (type == kStorageTypeTemporary && !lru_origin_callback_.is_null()) {
-    // Record the accessed origins while GetLRUOrigin task is runing
-    // to filter out them from eviction.
+  if (type == kStorageTypeTemporary &&
+      (!lru_origin_callback_.is_null() || !lru_origins_callback_.is_null() ||
+       !lru_origins_to_evict_.empty())) {
+    // Record the accessed origins while GetLRUOrigin(s) task is runing
+    // and until the origins it picked are evicted to filter out them from
+    // eviction.
     access_notified_origins_.insert(origin);
   }
 
@@ -1277,7 +1369,6 @@ void QuotaManager::GetUsageAndQuotaInternal(
     const UsageAndQuotaDispatcherCallback& callback) {
   LazyInitialize();
 
-  StorageType requested_type = type;
   if (type == kStorageTypeUnknown) {
     // Quota only supports temporary/persistent types.
     callback.Run(kQuotaErrorNotSupported, QuotaAndUsage());
@@ -1301,15 +1392,12 @@ void QuotaManager::GetUsageAndQuotaInternal(
     found = usage_and_quota_dispatchers_.insert(
         std::make_pair(host_and_type, dispatcher)).first;
   }
-  // Start the dispatcher if it is the first one and temporary_quota_override
-  // is already initialized iff the requested type is temporary.
-  // (The first dispatcher task for temporary will be kicked in
-  // DidInitialize if temporary_quota_initialized_ is false here.)
-  if (found->second->AddCallback(callback) &&
-      (requested_type != kStorageTypeTemporary ||
-       temporary_quota_initialized_)) {
+  // Start the dispatcher if it is the first one and the initialization is
+  // done, i.e. temporary_quota_override is known and the usage trackers are
+  // seeded from the usage ledger. (The first dispatcher tasks will be kicked
+  // in DidInitialize if temporary_quota_initialized_ is false here.)
+  if (found->second->AddCallback(callback) && temporary_quota_initialized_)
     found->second->Start();
-  }
 }
 
 void QuotaManager::DumpQuotaTable(const DumpQuotaTableCallback& callback) {
@@ -1360,6 +1448,64 @@ void QuotaManager::DeleteOriginFromDatabase(
                  weak_factory_.GetWeakPtr()));
 }
 
+void QuotaManager::GetLRUOrigin(
+    StorageType type,
+    const GetLRUOriginCallback& callback) {
+  LazyInitialize();
+  // This must not be called while there's an in-flight task.
+  DCHECK(lru_origin_callback_.is_null());
+  lru_origin_callback_ = callback;
+  if (db_disabled_) {
+    lru_origin_callback_.Run(GURL());
+    lru_origin_callback_.Reset();
+    return;
+  }
+
+  std::set<GURL>* exceptions = new std::set<GURL>;
+  GetEvictionExceptions(exceptions);
+
+  GURL* url = new GURL;
+  PostTaskAndReplyWithResultForDBThread(
+      FROM_HERE,
+      base::Bind(&GetLRUOriginOnDBThread,
+                 type,
+                 base::Owned(exceptions),
+                 special_storage_policy_,
+                 base::Unretained(url)),
+      base::Bind(&QuotaManager::DidGetLRUOrigin,
+                 weak_factory_.GetWeakPtr(),
+                 base::Owned(url)));
+}
+
+void QuotaManager::GetEvictionExceptions(std::set<GURL>* exceptions) const {
+  DCHECK(exceptions);
+  for (std::map<GURL, int>::const_iterator p = origins_in_use_.begin();
+       p != origins_in_use_.end();
+       ++p) {
+    if (p->second > 0)
+      exceptions->insert(p->first);
+  }
+  for (std::map<GURL, int>::const_iterator p = origins_in_error_.begin();
+       p != origins_in_error_.end();
+       ++p) {
+    if (p->second > QuotaManager::kThresholdOfErrorsToBeBlacklisted)
+      exceptions->insert(p->first);
+  }
+}
+
+bool QuotaManager::IsOriginInUseOrAccessed(const GURL& origin) const {
+  return origins_in_use_.find(origin) != origins_in_use_.end() ||
+         access_notified_origins_.find(origin) !=
+             access_notified_origins_.end();
+}
+
+void QuotaManager::MaybeClearAccessNotifiedOrigins() {
+  if (lru_origin_callback_.is_null() && lru_origins_callback_.is_null() &&
+      lru_origins_to_evict_.empty()) {
+    access_notified_origins_.clear();
+  }
+}
+
 void QuotaManager::DidOriginDataEvicted(QuotaStatusCode status) {
   DCHECK(io_thread_->BelongsToCurrentThread());
 
@@ -1367,8 +1513,12 @@ void QuotaManager::DidOriginDataEvicted(QuotaStatusCode status) {
   // deletion attempt for eviction should not fail.  Let's record
   // the origin if we get error and exclude it from future eviction
   // if the error happens consistently (> kThresholdOfErrorsToBeBlacklisted).
-  if (status != kQuotaStatusOk)
+  // The evictor gives up the rest of the round on errors.
+  if (status != kQuotaStatusOk) {
     origins_in_error_[eviction_context_.evicted_origin]++;
+    lru_origins_to_evict_.clear();
+    MaybeClearAccessNotifiedOrigins();
+  }
 
   eviction_context_.evict_origin_data_callback.Run(status);
   eviction_context_.evict_origin_data_callback.Reset();
@@ -1431,44 +1581,123 @@ void QuotaManager::DidGetPersistentGlobalUsageForHistogram(
                        unlimited_origins);
 }
 
-void QuotaManager::GetLRUOrigin(
+void QuotaManager::UpdateUsageLedger() {
+  for (size_t i = 0; i < arraysize(kUsageLedgerTypes); ++i) {
+    // Corrections show up in the next update.
+    GetUsageTracker(kUsageLedgerTypes[i])->VerifyCachedUsage(
+        kOriginsToVerifyPerClient);
+    SaveUsageLedger(kUsageLedgerTypes[i]);
+  }
+}
+
+void QuotaManager::SaveUsageLedger(StorageType type) {
+  if (is_incognito_ || db_disabled_)
+    return;
+
+  scoped_ptr<OriginUsageTableEntries> entries(new OriginUsageTableEntries);
+  TakeUsageLedgerUpdates(type, entries.get());
+  if (entries->empty())
+    return;
+  int client_mask = 0;
+  for (size_t i = 0; i < entries->size(); ++i)
+    client_mask |= (*entries)[i].client_id;
+  PostTaskAndReplyWithResultForDBThread(
+      FROM_HERE,
+      base::Bind(&SaveUsageLedgerOnDBThread,
+                 base::Owned(entries.release())),
+      base::Bind(&QuotaManager::DidSaveUsageLedger,
+                 weak_factory_.GetWeakPtr(), type, client_mask));
+}
+
+void QuotaManager::DidSaveUsageLedger(StorageType type,
+                                      int client_mask,
+                                      bool success) {
+  DidDatabaseWork(success);
+  // The updates were taken from the tracker, so they are lost.
+  if (!success)
+    usage_ledger_failed_client_masks_[type] |= client_mask;
+}
+
+void QuotaManager::CloseUsageLedger() {
+  if (is_incognito_ || db_disabled_)
+    return;
+
+  // The database is deleted by a task posted after these, so it outlives
+  // them.
+  for (size_t i = 0; i < arraysize(kUsageLedgerTypes); ++i) {
+    StorageType type = kUsageLedgerTypes[i];
+    OriginUsageTableEntries* entries = new OriginUsageTableEntries;
+    TakeUsageLedgerUpdates(type, entries);
+    db_thread_->PostTask(
+        FROM_HERE,
+        base::Bind(base::IgnoreResult(&CloseUsageLedgerOnDBThread),
+                   type,
+                   base::Owned(entries),
+                   GetUsageTracker(type)->GetGlobalUsageRetrievedClientMask() &
+                       ~usage_ledger_failed_client_masks_[type],
+                   base::Unretained(database_.get())));
+  }
+}
+
+void QuotaManager::TakeUsageLedgerUpdates(StorageType type,
+                                          OriginUsageTableEntries* entries) {
+  DCHECK(entries);
+  UsageTracker::ClientOriginUsageMap usage;
+  GetUsageTracker(type)->TakeDirtyOriginUsage(&usage);
+  for (UsageTracker::ClientOriginUsageMap::const_iterator client_iter =
+           usage.begin();
+       client_iter != usage.end(); ++client_iter) {
+    const UsageTracker::OriginUsageMap& origins = client_iter->second;
+    for (UsageTracker::OriginUsageMap::const_iterator iter = origins.begin();
+         iter != origins.end(); ++iter) {
+      entries->push_back(QuotaDatabase::OriginUsageTableEntry(
+          iter->first, type, client_iter->first, iter->second));
+    }
+  }
+}
+
+void QuotaManager::GetLRUOrigins(
     StorageType type,
-    const GetLRUOriginCallback& callback) {
+    int64 amount_to_evict,
+    const GetLRUOriginsCallback& callback) {
   LazyInitialize();
   // This must not be called while there's an in-flight task.
-  DCHECK(lru_origin_callback_.is_null());
-  lru_origin_callback_ = callback;
+  DCHECK(lru_origins_callback_.is_null());
+  lru_origins_callback_ = callback;
+  // Drop what is left of the previous round, if the evictor gave it up.
+  lru_origins_to_evict_.clear();
   if (db_disabled_) {
-    lru_origin_callback_.Run(GURL());
-    lru_origin_callback_.Reset();
+    lru_origins_callback_.Run(std::vector<GURL>());
+    lru_origins_callback_.Reset();
     return;
   }
 
   std::set<GURL>* exceptions = new std::set<GURL>;
-  for (std::map<GURL, int>::const_iterator p = origins_in_use_.begin();
-       p != origins_in_use_.end();
-       ++p) {
-    if (p->second > 0)
-      exceptions->insert(p->first);
-  }
-  for (std::map<GURL, int>::const_iterator p = origins_in_error_.begin();
-       p != origins_in_error_.end();
-       ++p) {
-    if (p->second > QuotaManager::kThresholdOfErrorsToBeBlacklisted)
-      exceptions->insert(p->first);
-  }
+  GetEvictionExceptions(exceptions);
 
-  GURL* url = new GURL;
+  std::vector<GURL>* urls = new std::vector<GURL>;
   PostTaskAndReplyWithResultForDBThread(
       FROM_HERE,
-      base::Bind(&GetLRUOriginOnDBThread,
+      base::Bind(&GetLRUOriginsOnDBThread,
                  type,
                  base::Owned(exceptions),
                  special_storage_policy_,
-                 base::Unretained(url)),
-      base::Bind(&QuotaManager::DidGetLRUOrigin,
+                 kMaxOriginsPerEvictionRound,
+                 base::Unretained(urls)),
+      base::Bind(&QuotaManager::DidGetLRUOrigins,
                  weak_factory_.GetWeakPtr(),
-                 base::Owned(url)));
+                 type,
+                 amount_to_evict,
+                 base::Owned(urls)));
+}
+
+bool QuotaManager::IsOriginEvictable(const GURL& origin) {
+  DCHECK(io_thread_->BelongsToCurrentThread());
+  if (!IsOriginInUseOrAccessed(origin))
+    return true;
+  lru_origins_to_evict_.erase(origin);
+  MaybeClearAccessNotifiedOrigins();
+  return false;
 }
 
 void QuotaManager::EvictOriginData(
@@ -1478,6 +1707,9 @@ void QuotaManager::EvictOriginData(
   DCHECK(io_thread_->BelongsToCurrentThread());
   DCHECK_EQ(type, kStorageTypeTemporary);
 
+  lru_origins_to_evict_.erase(origin);
+  MaybeClearAccessNotifiedOrigins();
+
   eviction_context_.evicted_origin = origin;
   eviction_context_.evicted_type = type;
   eviction_context_.evict_origin_data_callback = callback;
@@ -1539,6 +1771,12 @@ void QuotaManager::DidInitialize(int64* temporary_quota_override,
                          base::TimeDelta::FromMilliseconds(
                              kReportHistogramInterval),
                          this, &QuotaManager::ReportHistogram);
+  if (!is_incognito_) {
+    usage_ledger_timer_.Start(FROM_HERE,
+                              base::TimeDelta::FromMilliseconds(
+                                  kUsageLedgerInterval),
+                              this, &QuotaManager::UpdateUsageLedger);
+  }
 
   DCHECK(temporary_quota_initialized_);
 
@@ -1558,18 +1796,66 @@ void QuotaManager::DidInitialize(int64* temporary_quota_override,
                  weak_factory_.GetWeakPtr()));
 }
 
+void QuotaManager::DidLoadUsageLedger(StorageType type,
+                                      const int* client_mask,
+                                      const OriginUsageTableEntries* entries,
+                                      bool success) {
+  DidDatabaseWork(success);
+  if (!*client_mask)
+    return;
+
+  UsageTracker::ClientOriginUsageMap usage;
+  for (OriginUsageTableEntries::const_iterator iter = entries->begin();
+       iter != entries->end(); ++iter) {
+    usage[iter->client_id][iter->origin] = iter->usage;
+  }
+  // A client the ledger accounts for may have no entries at all.
+  for (QuotaClientList::const_iterator iter = clients_.begin();
+       iter != clients_.end(); ++iter) {
+    QuotaClient::ID client_id = (*iter)->id();
+    if (*client_mask & client_id)
+      GetUsageTracker(type)->SeedUsageCache(client_id, usage[client_id]);
+  }
+}
+
 void QuotaManager::DidGetLRUOrigin(const GURL* origin,
                                    bool success) {
   DidDatabaseWork(success);
   // Make sure the returned origin is (still) not in the origin_in_use_ set
   // and has not been accessed since we posted the task.
-  if (origins_in_use_.find(*origin) != origins_in_use_.end() ||
-      access_notified_origins_.find(*origin) != access_notified_origins_.end())
+  if (IsOriginInUseOrAccessed(*origin))
     lru_origin_callback_.Run(GURL());
   else
     lru_origin_callback_.Run(*origin);
-  access_notified_origins_.clear();
   lru_origin_callback_.Reset();
+  MaybeClearAccessNotifiedOrigins();
+}
+
+void QuotaManager::DidGetLRUOrigins(StorageType type,
+                                    int64 amount_to_evict,
+                                    const std::vector<GURL>* origins,
+                                    bool success) {
+  DidDatabaseWork(success);
+  // Take the origins in LRU order until their cached usage adds up to the
+  // amount to evict. Skip the ones that are (now) in use or have been
+  // accessed since we posted the task.
+  std::vector<GURL> origins_to_evict;
+  int64 usage_to_evict = 0;
+  for (std::vector<GURL>::const_iterator iter = origins->begin();
+       iter != origins->end() && usage_to_evict < amount_to_evict; ++iter) {
+    if (IsOriginInUseOrAccessed(*iter))
+      continue;
+    origins_to_evict.push_back(*iter);
+    usage_to_evict += GetUsageTracker(type)->GetCachedOriginUsage(*iter);
+  }
+  // Keep recording accesses until each of these is evicted or skipped by
+  // IsOriginEvictable().
+  lru_origins_to_evict_.insert(origins_to_evict.begin(),
+                               origins_to_evict.end());
+  GetLRUOriginsCallback callback = lru_origins_callback_;
+  lru_origins_callback_.Reset();
+  MaybeClearAccessNotifiedOrigins();
+  callback.Run(origins_to_evict);
 }
 
 void QuotaManager::DidGetInitialTemporaryGlobalQuota(
@@ -56,17 +56,25 @@ struct QuotaAndUsage {
 // An interface called by QuotaTemporaryStorageEvictor.
 class WEBKIT_STORAGE_EXPORT QuotaEvictionHandler {
  public:
-  typedef base::Callback<void(const GURL&)> GetLRUOriginCallback;
+  typedef base::Callback<void(const std::vector<GURL>&)>
+      GetLRUOriginsCallback;
   typedef StatusCallback EvictOriginDataCallback;
   typedef base::Callback<void(QuotaStatusCode,
                               const QuotaAndUsage& quota_and_usage)>
       GetUsageAndQuotaForEvictionCallback;
 
-  // Returns the least recently used origin.  It might return empty
-  // GURL when there are no evictable origins.
-  virtual void GetLRUOrigin(
+  // Returns the least recently used origins, oldest first, that are to be
+  // evicted in one round to free up |amount_to_evict| bytes.  It might
+  // return an empty list when there are no evictable origins.
+  virtual void GetLRUOrigins(
       StorageType type,
-      const GetLRUOriginCallback& callback) = 0;
+      int64 amount_to_evict,
+      const GetLRUOriginsCallback& callback) = 0;
+
+  // Returns false if |origin|, picked by GetLRUOrigins(), has been put in
+  // use or accessed since, in which case it is dropped from the round and
+  // must not be evicted.  Called right before each EvictOriginData().
+  virtual bool IsOriginEvictable(const GURL& origin) = 0;
 
   virtual void EvictOriginData(
       const GURL& origin,
@@ -242,6 +250,9 @@ class WEBKIT_STORAGE_EXPORT QuotaManager
   typedef QuotaDatabase::OriginInfoTableEntry OriginInfoTableEntry;
   typedef std::vector<QuotaTableEntry> QuotaTableEntries;
   typedef std::vector<OriginInfoTableEntry> OriginInfoTableEntries;
+  typedef QuotaDatabase::OriginUsageTableEntries OriginUsageTableEntries;
+
+  typedef base::Callback<void(const GURL&)> GetLRUOriginCallback;
 
   // Function pointer type used to store the function which returns the
   // available disk space for the disk containing the given FilePath.
@@ -312,6 +323,13 @@ class WEBKIT_STORAGE_EXPORT QuotaManager
   void StartEviction();
   void DeleteOriginFromDatabase(const GURL& origin, StorageType type);
 
+  // Returns the least recently used origin.  It might return empty
+  // GURL when there are no evictable origins.
+  void GetLRUOrigin(StorageType type, const GetLRUOriginCallback& callback);
+  void GetEvictionExceptions(std::set<GURL>* exceptions) const;
+  bool IsOriginInUseOrAccessed(const GURL& origin) const;
+  void MaybeClearAccessNotifiedOrigins();
+
   void DidOriginDataEvicted(QuotaStatusCode status);
 
   void ReportHistogram();
@@ -322,10 +340,22 @@ class WEBKIT_STORAGE_EXPORT QuotaManager
                                                int64 usage,
                                                int64 unlimited_usage);
 
+  // Methods for the usage ledger, which persists the usage cache of the
+  // trackers so that the clients don't have to be asked for the usage of
+  // every origin again on the next startup.
+  void UpdateUsageLedger();
+  void SaveUsageLedger(StorageType type);
+  void DidSaveUsageLedger(StorageType type, int client_mask, bool success);
+  void CloseUsageLedger();
+  void TakeUsageLedgerUpdates(StorageType type,
+                              OriginUsageTableEntries* entries);
+
   // QuotaEvictionHandler.
-  virtual void GetLRUOrigin(
+  virtual void GetLRUOrigins(
       StorageType type,
-      const GetLRUOriginCallback& callback) OVERRIDE;
+      int64 amount_to_evict,
+      const GetLRUOriginsCallback& callback) OVERRIDE;
+  virtual bool IsOriginEvictable(const GURL& origin) OVERRIDE;
   virtual void EvictOriginData(
       const GURL& origin,
       StorageType type,
@@ -347,8 +377,16 @@ class WEBKIT_STORAGE_EXPORT QuotaManager
   void DidInitialize(int64* temporary_quota_override,
                      int64* desired_available_space,
                      bool success);
+  void DidLoadUsageLedger(StorageType type,
+                          const int* client_mask,
+                          const OriginUsageTableEntries* entries,
+                          bool success);
   void DidGetLRUOrigin(const GURL* origin,
                        bool success);
+  void DidGetLRUOrigins(StorageType type,
+                        int64 amount_to_evict,
+                        const std::vector<GURL>* origins,
+                        bool success);
   void DidGetInitialTemporaryGlobalQuota(QuotaStatusCode status,
                                          int64 quota_unused);
   void DidInitializeTemporaryOriginsInfo(bool success);
@@ -374,7 +412,11 @@ class WEBKIT_STORAGE_EXPORT QuotaManager
   mutable scoped_ptr<QuotaDatabase> database_;
 
   GetLRUOriginCallback lru_origin_callback_;
+  GetLRUOriginsCallback lru_origins_callback_;
   std::set<GURL> access_notified_origins_;
+  // The origins returned by GetLRUOrigins() that the evictor has yet to
+  // check or evict.  Accesses are recorded until this is empty.
+  std::set<GURL> lru_origins_to_evict_;
 
   QuotaClientList clients_;
 
@@ -403,6 +445,11 @@ class WEBKIT_STORAGE_EXPORT QuotaManager
 
   base::WeakPtrFactory<QuotaManager> weak_factory_;
   base::RepeatingTimer<QuotaManager> histogram_timer_;
+  base::RepeatingTimer<QuotaManager> usage_ledger_timer_;
+  // Map from type to the mask of the clients whose usage ledger updates
+  // failed to be saved at least once.  Their ledger is incomplete, so they
+  // are not marked as trusted when it is closed.
+  std::map<StorageType, int> usage_ledger_failed_client_masks_;
 
   // Pointer to the function used to get the available disk space. This is
   // overwritten by QuotaManagerTest in order to attain a deterministic reported
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "base/bind.h"
+#include "base/command_line.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/memory/scoped_ptr.h"
@@ -14,6 +15,8 @@
 #include "base/message_loop.h"
 #include "base/message_loop_proxy.h"
 #include "base/stl_util.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
 #include "base/sys_info.h"
 #include "base/time.h"
 #include "googleurl/src/gurl.h"
@@ -34,6 +37,10 @@ const StorageType kSync = kStorageTypeSyncable;
 
 const int kAllClients = QuotaClient::kAllClientsMask;
 
+// Command line switch for the number of origins in the benchmark.
+const char kBenchmarkOrigins[] = "quota-benchmark-origins";
+const int kDefaultBenchmarkOrigins = 100;
+
 // Returns a deterministic value for the amount of available disk space.
 int64 GetAvailableDiskSpaceForTest(const base::FilePath&) {
   return 13377331;
@@ -54,6 +61,18 @@ class QuotaManagerTest : public testing::Test {
   virtual void SetUp() {
     ASSERT_TRUE(data_dir_.CreateUniqueTempDir());
     mock_special_storage_policy_ = new MockSpecialStoragePolicy;
+    CreateQuotaManager();
+    additional_callback_count_ = 0;
+  }
+
+  virtual void TearDown() {
+    // Make sure the quota manager cleans up correctly.
+    quota_manager_ = NULL;
+    MessageLoop::current()->RunUntilIdle();
+  }
+
+ protected:
+  void CreateQuotaManager() {
     quota_manager_ = new QuotaManager(
         false /* is_incognito */,
         data_dir_.path(),
@@ -64,16 +83,16 @@ class QuotaManagerTest : public testing::Test {
     quota_manager_->eviction_disabled_ = true;
     // Don't query the hard disk for remaining capacity.
     quota_manager_->get_disk_space_fn_ = &GetAvailableDiskSpaceForTest;
-    additional_callback_count_ = 0;
   }
 
-  virtual void TearDown() {
-    // Make sure the quota manager cleans up correctly.
+  // Shuts the quota manager down and creates a new one on the same
+  // profile. The clients have to be registered again.
+  void RestartQuotaManager() {
     quota_manager_ = NULL;
     MessageLoop::current()->RunUntilIdle();
+    CreateQuotaManager();
   }
 
- protected:
   MockStorageClient* CreateClient(
       const MockOriginData* mock_data,
       size_t mock_data_size,
@@ -254,6 +273,22 @@ class QuotaManagerTest : public testing::Test {
                    weak_factory_.GetWeakPtr()));
   }
 
+  void GetLRUOrigins(StorageType type, int64 amount_to_evict) {
+    lru_origins_.clear();
+    quota_manager_->GetLRUOrigins(
+        type, amount_to_evict,
+        base::Bind(&QuotaManagerTest::DidGetLRUOrigins,
+                   weak_factory_.GetWeakPtr()));
+  }
+
+  bool IsOriginEvictable(const GURL& origin) {
+    return quota_manager_->IsOriginEvictable(origin);
+  }
+
+  void UpdateUsageLedger() {
+    quota_manager_->UpdateUsageLedger();
+  }
+
   void NotifyOriginInUse(const GURL& origin) {
     quota_manager_->NotifyOriginInUse(origin);
   }
@@ -347,6 +382,10 @@ class QuotaManagerTest : public testing::Test {
     lru_origin_ = origin;
   }
 
+  void DidGetLRUOrigins(const std::vector<GURL>& origins) {
+    lru_origins_ = origins;
+  }
+
   void DidGetModifiedOrigins(const std::set<GURL>& origins, StorageType type) {
     modified_origins_ = origins;
     modified_origins_type_ = type;
@@ -387,6 +426,7 @@ class QuotaManagerTest : public testing::Test {
   int64 quota() const { return quota_; }
   int64 available_space() const { return available_space_; }
   const GURL& lru_origin() const { return lru_origin_; }
+  const std::vector<GURL>& lru_origins() const { return lru_origins_; }
   const std::set<GURL>& modified_origins() const { return modified_origins_; }
   StorageType modified_origins_type() const { return modified_origins_type_; }
   const QuotaTableEntries& quota_entries() const { return quota_entries_; }
@@ -419,6 +459,7 @@ class QuotaManagerTest : public testing::Test {
   int64 quota_;
   int64 available_space_;
   GURL lru_origin_;
+  std::vector<GURL> lru_origins_;
   std::set<GURL> modified_origins_;
   StorageType modified_origins_type_;
   QuotaTableEntries quota_entries_;
@@ -1716,6 +1757,225 @@ TEST_F(QuotaManagerTest, GetLRUOriginWithOriginInUse) {
   EXPECT_EQ("http://a.com/", lru_origin().spec());
 }
 
+TEST_F(QuotaManagerTest, UsageLedger) {
+  static const MockOriginData kData[] = {
+    { "http://foo.com/",   kTemp, 10 },
+    { "http://foo.com:1/", kTemp, 20 },
+    { "http://bar.com/",   kTemp,  5 },
+    { "http://foo.com/",   kPerm, 40 },
+  };
+  MockStorageClient* client = CreateClient(kData, ARRAYSIZE_UNSAFE(kData),
+      QuotaClient::kFileSystem);
+  RegisterClient(client);
+
+  GetUsageAndQuota(GURL("http://foo.com/"), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(10 + 20, usage());
+  GetGlobalUsage(kPerm);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(40, usage());
+  client->ModifyOriginAndNotify(GURL("http://bar.com/"), kTemp, 100);
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(10 + 20 + 5 + 100, usage());
+
+  // The new client has no data, so all the usage it reports after the
+  // restart comes from the ledger.
+  RestartQuotaManager();
+  RegisterClient(CreateClient(NULL, 0, QuotaClient::kFileSystem));
+  GetUsageAndQuota(GURL("http://foo.com/"), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(kQuotaStatusOk, status());
+  EXPECT_EQ(10 + 20, usage());
+  GetUsageAndQuota(GURL("http://foo.com/"), kPerm);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(40, usage());
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(10 + 20 + 5 + 100, usage());
+
+  // The background verification finds out that the data is gone.
+  UpdateUsageLedger();
+  MessageLoop::current()->RunUntilIdle();
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(0, usage());
+  GetGlobalUsage(kPerm);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(0, usage());
+}
+
+TEST_F(QuotaManagerTest, UsageLedgerWithIncompleteClient) {
+  static const MockOriginData kData[] = {
+    { "http://foo.com/", kTemp, 10 },
+    { "http://foo.com/", kPerm, 40 },
+    { "http://bar.com/", kPerm, 50 },
+  };
+  static const MockOriginData kData2[] = {
+    { "http://foo.com/", kTemp,  1 },
+    { "http://foo.com/", kPerm,  2 },
+    { "http://bar.com/", kPerm,  3 },
+  };
+  RegisterClient(CreateClient(kData, ARRAYSIZE_UNSAFE(kData),
+      QuotaClient::kFileSystem));
+
+  // Only the persistent usage of foo.com is known when shutting down.
+  GetUsageAndQuota(GURL("http://foo.com/"), kPerm);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(40, usage());
+
+  RestartQuotaManager();
+  RegisterClient(CreateClient(kData2, ARRAYSIZE_UNSAFE(kData2),
+      QuotaClient::kFileSystem));
+  GetUsageAndQuota(GURL("http://foo.com/"), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(10, usage());
+  // The persistent entries are not trusted, the client is asked again.
+  GetUsageAndQuota(GURL("http://foo.com/"), kPerm);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, usage());
+  GetGlobalUsage(kPerm);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2 + 3, usage());
+}
+
+TEST_F(QuotaManagerTest, GetLRUOrigins) {
+  static const MockOriginData kData[] = {
+    { "http://a.com/", kTemp, 100 },
+    { "http://b.com/", kTemp, 200 },
+    { "http://c.com/", kTemp, 300 },
+    { "http://d.com/", kTemp, 400 },
+  };
+  MockStorageClient* client = CreateClient(kData, ARRAYSIZE_UNSAFE(kData),
+      QuotaClient::kFileSystem);
+  RegisterClient(client);
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(kData); ++i)
+    NotifyStorageAccessed(client, GURL(kData[i].origin), kTemp);
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunUntilIdle();
+
+  // Enough origins to cover the amount, least recently used first.
+  GetLRUOrigins(kTemp, 250);
+  MessageLoop::current()->RunUntilIdle();
+  ASSERT_EQ(2U, lru_origins().size());
+  EXPECT_EQ("http://a.com/", lru_origins()[0].spec());
+  EXPECT_EQ("http://b.com/", lru_origins()[1].spec());
+
+  GetLRUOrigins(kTemp, 10000);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(4U, lru_origins().size());
+
+  NotifyOriginInUse(GURL("http://a.com/"));
+  GetLRUOrigins(kTemp, 250);
+  MessageLoop::current()->RunUntilIdle();
+  ASSERT_EQ(2U, lru_origins().size());
+  EXPECT_EQ("http://b.com/", lru_origins()[0].spec());
+  EXPECT_EQ("http://c.com/", lru_origins()[1].spec());
+
+  // Origins accessed while the task is running are skipped too.
+  GetLRUOrigins(kTemp, 250);
+  NotifyStorageAccessed(client, GURL("http://b.com/"), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  ASSERT_EQ(1U, lru_origins().size());
+  EXPECT_EQ("http://c.com/", lru_origins()[0].spec());
+  NotifyOriginNoLongerInUse(GURL("http://a.com/"));
+}
+
+TEST_F(QuotaManagerTest, GetLRUOriginsRecheckedBeforeEviction) {
+  static const MockOriginData kData[] = {
+    { "http://a.com/", kTemp, 100 },
+    { "http://b.com/", kTemp, 100 },
+    { "http://c.com/", kTemp, 100 },
+  };
+  MockStorageClient* client = CreateClient(kData, ARRAYSIZE_UNSAFE(kData),
+      QuotaClient::kFileSystem);
+  RegisterClient(client);
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(kData); ++i)
+    NotifyStorageAccessed(client, GURL(kData[i].origin), kTemp);
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunUntilIdle();
+
+  GetLRUOrigins(kTemp, 250);
+  MessageLoop::current()->RunUntilIdle();
+  ASSERT_EQ(3U, lru_origins().size());
+
+  EXPECT_TRUE(IsOriginEvictable(GURL("http://a.com/")));
+  EvictOriginData(GURL("http://a.com/"), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(kQuotaStatusOk, status());
+
+  // Origins accessed or put in use while the round is under way are not
+  // evicted.
+  NotifyStorageAccessed(client, GURL("http://b.com/"), kTemp);
+  NotifyOriginInUse(GURL("http://c.com/"));
+  EXPECT_FALSE(IsOriginEvictable(GURL("http://b.com/")));
+  EXPECT_FALSE(IsOriginEvictable(GURL("http://c.com/")));
+  NotifyOriginNoLongerInUse(GURL("http://c.com/"));
+
+  // Accesses are no longer recorded once the round is over.
+  EXPECT_TRUE(IsOriginEvictable(GURL("http://b.com/")));
+}
+
+// Measures GetUsageAndQuota before and after a restart. Disabled by
+// default; run with
+// --gtest_also_run_disabled_tests --quota-benchmark-origins=N.
+TEST_F(QuotaManagerTest, DISABLED_Benchmark) {
+  int origin_count = kDefaultBenchmarkOrigins;
+  std::string origins_switch(CommandLine::ForCurrentProcess()->
+      GetSwitchValueASCII(kBenchmarkOrigins));
+  base::StringToInt(origins_switch, &origin_count);
+  if (origin_count < 1)
+    origin_count = kDefaultBenchmarkOrigins;
+
+  std::vector<std::string> origins;
+  for (int i = 0; i < origin_count; ++i)
+    origins.push_back(base::StringPrintf("http://host%d.com/", i));
+  std::vector<MockOriginData> data;
+  for (int i = 0; i < origin_count; ++i) {
+    MockOriginData entry = { origins[i].c_str(), kTemp, 10 + i % 100 };
+    data.push_back(entry);
+  }
+  printf("Benchmarking GetUsageAndQuota with %d origins:\n", origin_count);
+
+  // The first query makes the manager compute the usage of every origin.
+  RegisterClient(CreateClient(&data[0], data.size(),
+                              QuotaClient::kFileSystem));
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  GetUsageAndQuota(GURL(origins[0]), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  const double cold_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  EXPECT_EQ(kQuotaStatusOk, status());
+  EXPECT_EQ(10, usage());
+
+  const int kQueries = 1000;
+  start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < kQueries; ++i) {
+    GetUsageAndQuota(GURL(origins[i % origin_count]), kTemp);
+    MessageLoop::current()->RunUntilIdle();
+  }
+  const double warm_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  EXPECT_EQ(kQuotaStatusOk, status());
+
+  // After a restart the manager starts from the usage ledger.
+  RestartQuotaManager();
+  RegisterClient(CreateClient(&data[0], data.size(),
+                              QuotaClient::kFileSystem));
+  start = base::TimeTicks::HighResNow();
+  GetUsageAndQuota(GURL(origins[0]), kTemp);
+  MessageLoop::current()->RunUntilIdle();
+  const double ledger_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  EXPECT_EQ(kQuotaStatusOk, status());
+  EXPECT_EQ(10, usage());
+
+  printf("  first query, computing the usage: %.1f ms\n", cold_ms);
+  printf("  cached query: %.3f ms\n", warm_ms / kQueries);
+  printf("  first query after restart, from the ledger: %.1f ms\n",
+         ledger_ms);
+}
+
 TEST_F(QuotaManagerTest, GetOriginsModifiedSince) {
   static const MockOriginData kData[] = {
     { "http://a.com/",   kTemp,  0 },
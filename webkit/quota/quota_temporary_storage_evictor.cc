@@ -8,7 +8,6 @@
 
 #include "base/bind.h"
 #include "base/metrics/histogram.h"
-#include "googleurl/src/gurl.h"
 #include "webkit/quota/quota_manager.h"
 
 #define UMA_HISTOGRAM_MBYTES(name, sample)          \
@@ -194,12 +193,14 @@ void QuotaTemporaryStorageEvictor::OnGotUsageAndQuotaForEviction(
 
   int64 amount_to_evict = std::max(usage_overage, diskspace_shortage);
   if (status == kQuotaStatusOk && amount_to_evict > 0) {
-    // Space is getting tight. Get the least recently used origin and continue.
+    // Space is getting tight. Get the least recently used origins that free
+    // up enough space and continue.
     // TODO(michaeln): if the reason for eviction is low physical disk space,
     // make 'unlimited' origins subject to eviction too.
-    quota_eviction_handler_->GetLRUOrigin(
+    quota_eviction_handler_->GetLRUOrigins(
         kStorageTypeTemporary,
-        base::Bind(&QuotaTemporaryStorageEvictor::OnGotLRUOrigin,
+        amount_to_evict,
+        base::Bind(&QuotaTemporaryStorageEvictor::OnGotLRUOrigins,
                    weak_factory_.GetWeakPtr()));
   } else {
     if (repeated_eviction_) {
@@ -219,16 +220,38 @@ void QuotaTemporaryStorageEvictor::OnGotUsageAndQuotaForEviction(
   // TODO(dmikurube): Add error handling for the case status != kQuotaStatusOk.
 }
 
-void QuotaTemporaryStorageEvictor::OnGotLRUOrigin(const GURL& origin) {
+void QuotaTemporaryStorageEvictor::OnGotLRUOrigins(
+    const std::vector<GURL>& origins) {
   DCHECK(CalledOnValidThread());
 
-  if (origin.is_empty()) {
+  if (origins.empty()) {
     if (repeated_eviction_)
       StartEvictionTimerWithDelay(interval_ms_);
     OnEvictionRoundFinished();
     return;
   }
 
+  DCHECK(origins_to_evict_.empty());
+  origins_to_evict_.assign(origins.begin(), origins.end());
+  EvictNextOrigin();
+}
+
+void QuotaTemporaryStorageEvictor::EvictNextOrigin() {
+  DCHECK(!origins_to_evict_.empty());
+  // Skip the origins that have been put in use or accessed since they were
+  // picked.
+  GURL origin;
+  while (!origins_to_evict_.empty() && origin.is_empty()) {
+    if (quota_eviction_handler_->IsOriginEvictable(origins_to_evict_.front()))
+      origin = origins_to_evict_.front();
+    origins_to_evict_.pop_front();
+  }
+  if (origin.is_empty()) {
+    // Nothing left to evict in this round; the usage decides whether
+    // another one is needed.
+    ConsiderEviction();
+    return;
+  }
   quota_eviction_handler_->EvictOriginData(origin, kStorageTypeTemporary,
       base::Bind(
           &QuotaTemporaryStorageEvictor::OnEvictionComplete,
@@ -248,10 +271,15 @@ void QuotaTemporaryStorageEvictor::OnEvictionComplete(
   if (status == kQuotaStatusOk) {
     ++statistics_.num_evicted_origins;
     ++round_statistics_.num_evicted_origins_in_round;
+    if (!origins_to_evict_.empty()) {
+      EvictNextOrigin();
+      return;
+    }
     // We many need to get rid of more space so reconsider immediately.
     ConsiderEviction();
   } else {
     ++statistics_.num_errors_on_evicting_origin;
+    origins_to_evict_.clear();
     if (repeated_eviction_) {
       // Sleep for a while and retry again until we see too many errors.
       StartEvictionTimerWithDelay(interval_ms_);
@@ -5,17 +5,18 @@
 #ifndef WEBKIT_QUOTA_QUOTA_TEMPORARY_STORAGE_EVICTOR_H_
 #define WEBKIT_QUOTA_QUOTA_TEMPORARY_STORAGE_EVICTOR_H_
 
+#include <deque>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "base/memory/weak_ptr.h"
 #include "base/threading/non_thread_safe.h"
 #include "base/timer.h"
+#include "googleurl/src/gurl.h"
 #include "webkit/quota/quota_types.h"
 #include "webkit/storage/webkit_storage_export.h"
 
-class GURL;
-
 namespace quota {
 
 class QuotaEvictionHandler;
@@ -91,7 +92,8 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE QuotaTemporaryStorageEvictor
   void OnGotUsageAndQuotaForEviction(
       QuotaStatusCode status,
       const QuotaAndUsage& quota_and_usage);
-  void OnGotLRUOrigin(const GURL& origin);
+  void OnGotLRUOrigins(const std::vector<GURL>& origins);
+  void EvictNextOrigin();
   void OnEvictionComplete(QuotaStatusCode status);
 
   void OnEvictionRoundStarted();
@@ -118,6 +120,9 @@ class WEBKIT_STORAGE_EXPORT_PRIVATE QuotaTemporaryStorageEvictor
   int64 interval_ms_;
   bool repeated_eviction_;
 
+  // The origins picked for the current round that are yet to be evicted.
+  std::deque<GURL> origins_to_evict_;
+
   base::OneShotTimer<QuotaTemporaryStorageEvictor> eviction_timer_;
   base::RepeatingTimer<QuotaTemporaryStorageEvictor> histogram_timer_;
   base::WeakPtrFactory<QuotaTemporaryStorageEvictor> weak_factory_;
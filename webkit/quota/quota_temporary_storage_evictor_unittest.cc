@@ -4,7 +4,9 @@
 
 #include <list>
 #include <map>
+#include <set>
 #include <utility>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/callback.h"
@@ -29,13 +31,19 @@ class MockQuotaEvictionHandler : public quota::QuotaEvictionHandler {
       : quota_(0),
         unlimited_usage_(0),
         available_space_(0),
+        max_lru_origins_(1),
         error_on_evict_origin_data_(false),
         error_on_get_usage_and_quota_(false) {}
 
+  virtual bool IsOriginEvictable(const GURL& origin) OVERRIDE {
+    return unevictable_origins_.find(origin) == unevictable_origins_.end();
+  }
+
   virtual void EvictOriginData(
       const GURL& origin,
       StorageType type,
       const EvictOriginDataCallback& callback) OVERRIDE {
+    EXPECT_TRUE(IsOriginEvictable(origin));
     if (error_on_evict_origin_data_) {
       callback.Run(quota::kQuotaErrorInvalidModification);
       return;
@@ -59,13 +67,21 @@ class MockQuotaEvictionHandler : public quota::QuotaEvictionHandler {
     callback.Run(quota::kQuotaStatusOk, quota_and_usage);
   }
 
-  virtual void GetLRUOrigin(
+  virtual void GetLRUOrigins(
       StorageType type,
-      const GetLRUOriginCallback& callback) OVERRIDE {
-    if (origin_order_.empty())
-      callback.Run(GURL());
-    else
-      callback.Run(GURL(origin_order_.front()));
+      int64 amount_to_evict,
+      const GetLRUOriginsCallback& callback) OVERRIDE {
+    std::vector<GURL> origins;
+    int64 total_usage = 0;
+    for (std::list<GURL>::const_iterator it = origin_order_.begin();
+         it != origin_order_.end() &&
+             origins.size() < max_lru_origins_ &&
+             total_usage < amount_to_evict;
+         ++it) {
+      origins.push_back(*it);
+      total_usage += origins_[*it];
+    }
+    callback.Run(origins);
   }
 
   int64 GetUsage() const {
@@ -86,6 +102,9 @@ class MockQuotaEvictionHandler : public quota::QuotaEvictionHandler {
   void set_available_space(int64 available_space) {
     available_space_ = available_space;
   }
+  void set_max_lru_origins(size_t max_lru_origins) {
+    max_lru_origins_ = max_lru_origins;
+  }
   void set_task_for_get_usage_and_quota(const base::Closure& task) {
     task_for_get_usage_and_quota_= task;
   }
@@ -95,6 +114,10 @@ class MockQuotaEvictionHandler : public quota::QuotaEvictionHandler {
   void set_error_on_get_usage_and_quota(bool error_on_get_usage_and_quota) {
     error_on_get_usage_and_quota_ = error_on_get_usage_and_quota;
   }
+  // Simulates |origin| being put in use after it is picked for eviction.
+  void set_origin_unevictable(const GURL& origin) {
+    unevictable_origins_.insert(origin);
+  }
 
   // Simulates an access to |origin|.  It reorders the internal LRU list.
   // It internally uses AddOrigin().
@@ -129,8 +152,10 @@ class MockQuotaEvictionHandler : public quota::QuotaEvictionHandler {
   int64 quota_;
   int64 unlimited_usage_;
   int64 available_space_;
+  size_t max_lru_origins_;
   std::list<GURL> origin_order_;
   std::map<GURL, int64> origins_;
+  std::set<GURL> unevictable_origins_;
   bool error_on_evict_origin_data_;
   bool error_on_get_usage_and_quota_;
 
@@ -184,6 +209,10 @@ class QuotaTemporaryStorageEvictorTest : public testing::Test {
     ++num_get_usage_and_quota_for_eviction_;
   }
 
+  void CountGetUsageAndQuota() {
+    ++num_get_usage_and_quota_for_eviction_;
+  }
+
  protected:
   MockQuotaEvictionHandler* quota_eviction_handler() const {
     return static_cast<MockQuotaEvictionHandler*>(
@@ -270,6 +299,56 @@ TEST_F(QuotaTemporaryStorageEvictorTest, MultipleEvictionTest) {
   EXPECT_EQ(0, statistics().num_skipped_eviction_rounds);
 }
 
+TEST_F(QuotaTemporaryStorageEvictorTest, BatchedEvictionTest) {
+  quota_eviction_handler()->AddOrigin(GURL("http://www.a.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.b.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.c.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.d.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.e.com"), 200);
+  quota_eviction_handler()->set_quota(1000);
+  quota_eviction_handler()->set_available_space(1000000000);
+  quota_eviction_handler()->set_max_lru_origins(20);
+  quota_eviction_handler()->set_task_for_get_usage_and_quota(
+      base::Bind(&QuotaTemporaryStorageEvictorTest::CountGetUsageAndQuota,
+                 weak_factory_.GetWeakPtr()));
+  set_repeated_eviction(false);
+  temporary_storage_evictor()->Start();
+  MessageLoop::current()->RunUntilIdle();
+  // Both origins needed to get under 70% of the quota are evicted with a
+  // single lookup of the usage and the LRU origins.
+  EXPECT_EQ(600, quota_eviction_handler()->GetUsage());
+  EXPECT_EQ(2, num_get_usage_and_quota_for_eviction());
+
+  EXPECT_EQ(0, statistics().num_errors_on_evicting_origin);
+  EXPECT_EQ(0, statistics().num_errors_on_getting_usage_and_quota);
+  EXPECT_EQ(2, statistics().num_evicted_origins);
+  EXPECT_EQ(1, statistics().num_eviction_rounds);
+  EXPECT_EQ(0, statistics().num_skipped_eviction_rounds);
+}
+
+TEST_F(QuotaTemporaryStorageEvictorTest, BatchedEvictionSkipsInUseOrigin) {
+  const GURL kInUseOrigin("http://www.a.com");
+  quota_eviction_handler()->AddOrigin(kInUseOrigin, 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.b.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.c.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.d.com"), 200);
+  quota_eviction_handler()->AddOrigin(GURL("http://www.e.com"), 200);
+  quota_eviction_handler()->set_quota(1000);
+  quota_eviction_handler()->set_available_space(1000000000);
+  quota_eviction_handler()->set_max_lru_origins(20);
+  quota_eviction_handler()->set_origin_unevictable(kInUseOrigin);
+  set_repeated_eviction(false);
+  temporary_storage_evictor()->Start();
+  MessageLoop::current()->RunUntilIdle();
+  // The least recently used origin is skipped and the next ones are evicted
+  // in its place.
+  EXPECT_EQ(600, quota_eviction_handler()->GetUsage());
+  quota_eviction_handler()->AccessOrigin(kInUseOrigin);
+
+  EXPECT_EQ(0, statistics().num_errors_on_evicting_origin);
+  EXPECT_EQ(2, statistics().num_evicted_origins);
+}
+
 TEST_F(QuotaTemporaryStorageEvictorTest, RepeatedEvictionTest) {
   const int64 a_size = 400;
   const int64 b_size = 150;
@@ -303,6 +303,52 @@ void UsageTracker::GetCachedOrigins(std::set<GURL>* origins) const {
   }
 }
 
+int64 UsageTracker::GetCachedOriginUsage(const GURL& origin) const {
+  int64 usage = 0;
+  for (ClientTrackerMap::const_iterator iter = client_tracker_map_.begin();
+       iter != client_tracker_map_.end(); ++iter) {
+    usage += iter->second->GetCachedOriginUsage(origin);
+  }
+  return usage;
+}
+
+void UsageTracker::SeedUsageCache(QuotaClient::ID client_id,
+                                  const OriginUsageMap& usage) {
+  // The ledger may have entries of clients that aren't registered anymore.
+  ClientUsageTracker* client_tracker = GetClientTracker(client_id);
+  if (client_tracker)
+    client_tracker->SeedUsageCache(usage);
+}
+
+int UsageTracker::GetGlobalUsageRetrievedClientMask() const {
+  int client_mask = 0;
+  for (ClientTrackerMap::const_iterator iter = client_tracker_map_.begin();
+       iter != client_tracker_map_.end(); ++iter) {
+    if (iter->second->global_usage_retrieved())
+      client_mask |= iter->first;
+  }
+  return client_mask;
+}
+
+void UsageTracker::TakeDirtyOriginUsage(ClientOriginUsageMap* usage) {
+  DCHECK(usage);
+  usage->clear();
+  for (ClientTrackerMap::iterator iter = client_tracker_map_.begin();
+       iter != client_tracker_map_.end(); ++iter) {
+    OriginUsageMap client_usage;
+    iter->second->TakeDirtyOriginUsage(&client_usage);
+    if (!client_usage.empty())
+      (*usage)[iter->first].swap(client_usage);
+  }
+}
+
+void UsageTracker::VerifyCachedUsage(size_t max_origins) {
+  for (ClientTrackerMap::iterator iter = client_tracker_map_.begin();
+       iter != client_tracker_map_.end(); ++iter) {
+    iter->second->VerifyCachedUsage(max_origins);
+  }
+}
+
 void UsageTracker::DidGetClientGlobalUsage(StorageType type,
                                            int64 usage,
                                            int64 unlimited_usage) {
@@ -400,6 +446,8 @@ void ClientUsageTracker::UpdateUsageCache(
   std::string host = net::GetHostOrSpecFromURL(origin);
   if (cached_hosts_.find(host) != cached_hosts_.end()) {
     cached_usage_[host][origin] += delta;
+    dirty_origins_.insert(origin);
+    verifying_origins_.erase(origin);
     global_usage_ += delta;
     if (global_unlimited_usage_is_valid_ && IsStorageUnlimited(origin))
       global_unlimited_usage_ += delta;
@@ -436,6 +484,70 @@ void ClientUsageTracker::GetCachedOrigins(std::set<GURL>* origins) const {
   }
 }
 
+int64 ClientUsageTracker::GetCachedOriginUsage(const GURL& origin) const {
+  HostUsageMap::const_iterator found =
+      cached_usage_.find(net::GetHostOrSpecFromURL(origin));
+  if (found == cached_usage_.end())
+    return 0;
+  UsageMap::const_iterator usage = found->second.find(origin);
+  if (usage == found->second.end())
+    return 0;
+  return usage->second;
+}
+
+void ClientUsageTracker::SeedUsageCache(const UsageMap& usage) {
+  // Gathering fills the cache with fresher values anyway.
+  if (global_usage_retrieved_ || global_usage_task_ ||
+      !host_usage_tasks_.empty()) {
+    return;
+  }
+
+  HostSet seeded_hosts;
+  for (UsageMap::const_iterator iter = usage.begin();
+       iter != usage.end(); ++iter) {
+    std::string host = net::GetHostOrSpecFromURL(iter->first);
+    if (cached_hosts_.find(host) != cached_hosts_.end())
+      continue;
+    AddCachedOrigin(iter->first, iter->second);
+    // The ledger has this value already.
+    dirty_origins_.erase(iter->first);
+    seeded_hosts.insert(host);
+  }
+  cached_hosts_.insert(seeded_hosts.begin(), seeded_hosts.end());
+  global_usage_retrieved_ = true;
+}
+
+void ClientUsageTracker::TakeDirtyOriginUsage(UsageMap* usage) {
+  DCHECK(usage);
+  for (std::set<GURL>::const_iterator iter = dirty_origins_.begin();
+       iter != dirty_origins_.end(); ++iter) {
+    (*usage)[*iter] = GetCachedOriginUsage(*iter);
+  }
+  dirty_origins_.clear();
+}
+
+void ClientUsageTracker::VerifyCachedUsage(size_t max_origins) {
+  std::set<GURL> origins;
+  GetCachedOrigins(&origins);
+  if (origins.empty())
+    return;
+
+  size_t count = std::min(max_origins, origins.size());
+  std::set<GURL>::const_iterator iter =
+      origins.upper_bound(last_verified_origin_);
+  for (size_t i = 0; i < count; ++i) {
+    if (iter == origins.end())
+      iter = origins.begin();
+    last_verified_origin_ = *iter++;
+    if (!verifying_origins_.insert(last_verified_origin_).second)
+      continue;
+    client_->GetOriginUsage(
+        last_verified_origin_, type_,
+        base::Bind(&ClientUsageTracker::DidVerifyOriginUsage, AsWeakPtr(),
+                   last_verified_origin_));
+  }
+}
+
 void ClientUsageTracker::AddCachedOrigin(
     const GURL& origin, int64 usage) {
   std::string host = net::GetHostOrSpecFromURL(origin);
@@ -445,6 +557,7 @@ void ClientUsageTracker::AddCachedOrigin(
   iter->second = usage;
   int64 delta = usage - old_usage;
   if (delta) {
+    dirty_origins_.insert(origin);
     global_usage_ += delta;
     if (global_unlimited_usage_is_valid_ && IsStorageUnlimited(origin))
       global_unlimited_usage_ += delta;
@@ -518,6 +631,19 @@ void ClientUsageTracker::OnSpecialStoragePolicyChanged() {
 
 void ClientUsageTracker::NoopHostUsageCallback(int64 usage) {}
 
+void ClientUsageTracker::DidVerifyOriginUsage(const GURL& origin,
+                                              int64 usage) {
+  // Drop the result if the usage changed while it was being computed.
+  if (!verifying_origins_.erase(origin))
+    return;
+
+  // Defend against confusing inputs from QuotaClients.
+  DCHECK_GE(usage, 0);
+  if (usage < 0)
+    usage = 0;
+  AddCachedOrigin(origin, usage);
+}
+
 bool ClientUsageTracker::IsStorageUnlimited(const GURL& origin) const {
   if (type_ == kStorageTypeSyncable)
     return false;
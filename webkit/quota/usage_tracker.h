@@ -29,6 +29,9 @@ class ClientUsageTracker;
 // An instance of this class is created per storage type.
 class UsageTracker : public QuotaTaskObserver {
  public:
+  typedef std::map<GURL, int64> OriginUsageMap;
+  typedef std::map<QuotaClient::ID, OriginUsageMap> ClientOriginUsageMap;
+
   UsageTracker(const QuotaClientList& clients, StorageType type,
                SpecialStoragePolicy* special_storage_policy);
   virtual ~UsageTracker();
@@ -43,11 +46,26 @@ class UsageTracker : public QuotaTaskObserver {
                         int64 delta);
   void GetCachedHostsUsage(std::map<std::string, int64>* host_usage) const;
   void GetCachedOrigins(std::set<GURL>* origins) const;
+  int64 GetCachedOriginUsage(const GURL& origin) const;
   bool IsWorking() const {
     return global_usage_callbacks_.HasCallbacks() ||
            host_usage_callbacks_.HasAnyCallbacks();
   }
 
+  // Methods for the usage ledger kept by the QuotaManager.
+  // Fills the cache of a client that hasn't gathered its usage yet with the
+  // usage recorded by the ledger, so the client doesn't have to be asked.
+  void SeedUsageCache(QuotaClient::ID client_id, const OriginUsageMap& usage);
+  // Returns the mask of the clients that have the usage of all their
+  // origins cached.
+  int GetGlobalUsageRetrievedClientMask() const;
+  // Moves the usage of the origins that changed since the last call to
+  // |usage|.
+  void TakeDirtyOriginUsage(ClientOriginUsageMap* usage);
+  // Asks each client for the actual usage of up to |max_origins| cached
+  // origins, in turns, and corrects the cache where it drifted.
+  void VerifyCachedUsage(size_t max_origins);
+
  private:
   struct TrackingInfo {
     TrackingInfo() : pending_clients(0), usage(0), unlimited_usage(0) {}
@@ -94,6 +112,12 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   void UpdateUsageCache(const GURL& origin, int64 delta);
   void GetCachedHostsUsage(std::map<std::string, int64>* host_usage) const;
   void GetCachedOrigins(std::set<GURL>* origins) const;
+  int64 GetCachedOriginUsage(const GURL& origin) const;
+
+  void SeedUsageCache(const std::map<GURL, int64>& usage);
+  bool global_usage_retrieved() const { return global_usage_retrieved_; }
+  void TakeDirtyOriginUsage(std::map<GURL, int64>* usage);
+  void VerifyCachedUsage(size_t max_origins);
 
  private:
   typedef std::set<std::string> HostSet;
@@ -115,6 +139,7 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   int64 GetCachedGlobalUnlimitedUsage();
   virtual void OnSpecialStoragePolicyChanged() OVERRIDE;
   void NoopHostUsageCallback(int64 usage);
+  void DidVerifyOriginUsage(const GURL& origin, int64 usage);
   bool IsStorageUnlimited(const GURL& origin) const;
 
   UsageTracker* tracker_;
@@ -128,6 +153,14 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   HostSet cached_hosts_;
   HostUsageMap cached_usage_;
 
+  // Origins whose cached usage changed since TakeDirtyOriginUsage.
+  std::set<GURL> dirty_origins_;
+  // Origins being verified. An origin is dropped when its usage changes
+  // while the client computes it, as the result may predate the change.
+  std::set<GURL> verifying_origins_;
+  // The last origin verified, where the next verification resumes.
+  GURL last_verified_origin_;
+
   GatherGlobalUsageTask* global_usage_task_;
   GlobalUsageCallbackQueue global_usage_callback_;
   std::map<std::string, GatherHostUsageTask*> host_usage_tasks_;